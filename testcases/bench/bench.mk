@@ -0,0 +1,106 @@
+noinst_PROGRAMS += testcases/bench/stdllbench
+
+noinst_HEADERS += testcases/bench/mock_specific.h
+
+testcases_bench_stdllbench_CFLAGS =					\
+	-DDEV -D_THREAD_SAFE -DSHALLOW=0 -DSWTOK=1 -DLITE=0		\
+	-DNOMD2 -DNODSA -DNORIPE -I${srcdir}/testcases/bench		\
+	-DTOK_NEW_DATA_STORE=0x0003000c					\
+	-I${srcdir}/usr/lib/common -I${srcdir}/usr/include		\
+	-DSTDLL_NAME=\"stdllbench\" -I${top_builddir}/usr/lib/api	\
+	-I${srcdir}/usr/lib/api -I${srcdir}/usr/lib/config		\
+	-I${top_builddir}/usr/lib/config
+
+testcases_bench_stdllbench_LDFLAGS = -lpthread -lcrypto -lrt -llber
+
+testcases_bench_stdllbench_SOURCES =					\
+	testcases/bench/stdllbench.c testcases/bench/mock_specific.c	\
+	usr/lib/common/asn1.c usr/lib/common/cert.c			\
+	usr/lib/common/hwf_obj.c usr/lib/common/dp_obj.c		\
+	usr/lib/common/data_obj.c usr/lib/common/decr_mgr.c		\
+	usr/lib/common/dig_mgr.c usr/lib/common/encr_mgr.c		\
+	usr/lib/common/globals.c usr/lib/common/sw_crypt.c		\
+	usr/lib/common/loadsave.c usr/lib/common/key.c			\
+	usr/lib/common/key_mgr.c usr/lib/common/mech_aes.c		\
+	usr/lib/common/mech_des.c usr/lib/common/mech_des3.c		\
+	usr/lib/common/mech_dh.c usr/lib/common/mech_md5.c		\
+	usr/lib/common/mech_md2.c usr/lib/common/mech_rng.c		\
+	usr/lib/common/mech_rsa.c usr/lib/common/mech_sha.c		\
+	usr/lib/common/mech_ssl3.c usr/lib/common/mech_ec.c		\
+	usr/lib/common/new_host.c usr/lib/common/obj_mgr.c		\
+	usr/lib/common/object.c usr/lib/common/sign_mgr.c		\
+	usr/lib/common/template.c usr/lib/common/p11util.c		\
+	usr/lib/common/utility.c usr/lib/common/verify_mgr.c		\
+	usr/lib/common/trace.c usr/lib/common/mech_list.c		\
+	usr/lib/common/shared_memory.c usr/lib/common/profile_obj.c	\
+	usr/lib/common/attributes.c usr/lib/common/dlist.c		\
+	usr/lib/common/mech_openssl.c usr/lib/common/utility_common.c	\
+	usr/lib/common/ec_supported.c usr/lib/api/policyhelper.c	\
+	usr/lib/common/pqc_supported.c usr/lib/common/btree.c		\
+	usr/lib/common/sess_mgr.c usr/lib/common/slab.c			\
+	usr/lib/common/obj_cache.c usr/lib/common/mech_pqc.c		\
+	usr/lib/common/login_cache.c					\
+	usr/lib/common/async_mgr.c usr/lib/api/policy.c			\
+	usr/lib/api/supportedstrengths.c				\
+	usr/lib/common/ec_curve_translation.c				\
+	usr/lib/common/kdf_translation.c				\
+	usr/lib/common/mgf_translation.c				\
+	usr/lib/config/configuration.c					\
+	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l
+
+nodist_testcases_bench_stdllbench_SOURCES = usr/lib/api/mechtable.c
+
+if ENABLE_ICSFTOK
+noinst_PROGRAMS += testcases/bench/icsfbench
+
+noinst_HEADERS += testcases/bench/mock_ldap.h
+
+testcases_bench_icsfbench_CFLAGS =					\
+	-DNODSA -DNODH -DMMAP -I${srcdir}/usr/lib/icsf_stdll		\
+	-I${srcdir}/testcases/bench					\
+	-I${srcdir}/usr/lib/common -I${srcdir}/usr/include		\
+	-DSTDLL_NAME=\"icsfbench\"					\
+	-DTOK_NEW_DATA_STORE=0xffffffff					\
+	-I${top_builddir}/usr/lib/icsf_stdll				\
+	-I${top_builddir}/usr/lib/api -I${srcdir}/usr/lib/api		\
+	-I${top_builddir}/usr/lib/config -I${srcdir}/usr/lib/config
+
+# The libldap client calls are provided by mock_ldap.c, only liblber is used
+testcases_bench_icsfbench_LDFLAGS = -lpthread -lcrypto -lrt -llber
+
+testcases_bench_icsfbench_SOURCES =					\
+	testcases/bench/icsfbench.c testcases/bench/mock_ldap.c	\
+	usr/lib/common/asn1.c						\
+	usr/lib/common/dig_mgr.c usr/lib/common/hwf_obj.c		\
+	usr/lib/common/trace.c usr/lib/common/key.c			\
+	usr/lib/common/mech_dh.c usr/lib/common/mech_rng.c		\
+	usr/lib/common/sign_mgr.c usr/lib/common/cert.c			\
+	usr/lib/common/dp_obj.c usr/lib/common/mech_aes.c		\
+	usr/lib/common/mech_rsa.c usr/lib/common/mech_ec.c		\
+	usr/lib/common/obj_mgr.c usr/lib/common/template.c		\
+	usr/lib/common/p11util.c usr/lib/common/data_obj.c		\
+	usr/lib/common/encr_mgr.c usr/lib/common/key_mgr.c		\
+	usr/lib/common/mech_md2.c usr/lib/common/mech_sha.c		\
+	usr/lib/common/object.c usr/lib/common/decr_mgr.c		\
+	usr/lib/common/globals.c usr/lib/common/sw_crypt.c		\
+	usr/lib/common/loadsave.c usr/lib/common/utility.c		\
+	usr/lib/common/mech_des.c usr/lib/common/mech_des3.c		\
+	usr/lib/common/mech_md5.c usr/lib/common/mech_ssl3.c		\
+	usr/lib/common/verify_mgr.c usr/lib/common/mech_list.c		\
+	usr/lib/common/shared_memory.c usr/lib/common/attributes.c	\
+	usr/lib/icsf_stdll/new_host.c usr/lib/common/profile_obj.c	\
+	usr/lib/common/dlist.c usr/lib/icsf_stdll/pbkdf.c		\
+	usr/lib/icsf_stdll/icsf_specific.c usr/lib/common/mech_pqc.c	\
+	usr/lib/icsf_stdll/icsf.c usr/lib/common/utility_common.c	\
+	usr/lib/common/ec_supported.c usr/lib/api/policyhelper.c	\
+	usr/lib/config/configuration.c usr/lib/common/pqc_supported.c	\
+	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l		\
+	usr/lib/common/mech_openssl.c					\
+	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
+	usr/lib/common/slab.c usr/lib/common/obj_cache.c		\
+	usr/lib/common/login_cache.c
+
+nodist_testcases_bench_icsfbench_SOURCES = usr/lib/api/mechtable.c
+
+usr/lib/icsf_stdll/testcases_bench_icsfbench-icsf_specific.$(OBJEXT): usr/lib/config/cfgparse.h
+endif
@@ -0,0 +1,719 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: icsfbench.c
+ *
+ * Micro-benchmark for the attribute cache of the ICSF token. The ICSF STDLL
+ * is linked into this program together with a mock of the libldap client
+ * calls, which serves the ICSF services from memory instead of a z/OS LDAP
+ * server, and its SC_* entry points are called directly. Every remote call
+ * is delayed by a configurable latency. The token lives in a temporary
+ * directory that is removed when the program ends.
+ *
+ * Each thread opens its own session and runs the phases create, find,
+ * getattr, setattr and destroy on its own objects. The getattr phase reads
+ * the label, the application and the value of random objects. The setattr
+ * phase changes the label of every object and reads it back, a stale cached
+ * label is counted as an error. For every phase the number of ICSF calls per
+ * operation is printed, compare a run with -cache-size 0 (the default of the
+ * token) with a run that caches all objects.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <grp.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "local_types.h"
+#include "apictl.h"
+#include "policy.h"
+#include "mechtable.h"
+#include "shared_memory.h"
+#include "trace.h"
+#include "slotmgr.h" // for ock_snprintf
+
+#include "mock_ldap.h"
+
+#define BENCH_SLOT_ID           0
+#define BENCH_SO_PIN            "87654321"
+#define BENCH_USER_PIN          "12345678"
+#define BENCH_TOKEN_NAME        "ICSFBENCH"
+#define BENCH_DATA_LEN          64
+
+CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
+                    SLOT_INFO *sinfp, struct trace_handle_t t);
+CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
+                  struct trace_handle_t *t, CK_BBOOL in_fork_initializer);
+
+struct bench_thread {
+    pthread_t thread;
+    unsigned long id;
+    ST_SESSION_T session;
+    CK_OBJECT_HANDLE *objs;
+    unsigned int seed;
+    unsigned long ops;
+    unsigned long errors;
+};
+
+static API_Slot_t slot;
+static STDLL_TokData_t *tokdata;
+static STDLL_FcnList_t *fcn;
+static SLOT_INFO slot_info;
+static struct policy bench_policy;
+static struct statistics bench_statistics;
+static char tmpdir[] = "/tmp/icsfbench.XXXXXX";
+static char shm_name[SM_NAME_LEN + 1];
+static uint32_t tokspec_count;
+
+static unsigned long num_threads = 1;
+static unsigned long num_objects = 100;
+static unsigned long num_iterations = 1000;
+static unsigned long cache_size;
+static unsigned long cache_ttl = 30;
+static CK_BBOOL keep = FALSE;
+
+/*
+ * Policy, statistics and token specific counters are provided by the API
+ * layer of a real process. The harness uses an empty policy, which allows
+ * everything. Statistics are disabled.
+ */
+static CK_RV bench_store_object_strength(policy_t p, struct objstrength *s,
+                                         get_attr_val_f get_attr_val, void *d,
+                                         free_attr_f free_attr,
+                                         struct _SESSION *session)
+{
+    UNUSED(p);
+    UNUSED(get_attr_val);
+    UNUSED(d);
+    UNUSED(free_attr);
+    UNUSED(session);
+
+    s->strength = POLICY_STRENGTH_IDX_0;
+    s->allowed = CK_TRUE;
+    return CKR_OK;
+}
+
+static CK_RV bench_is_key_allowed(policy_t p, struct objstrength *s,
+                                  struct _SESSION *session)
+{
+    UNUSED(p);
+    UNUSED(s);
+    UNUSED(session);
+
+    return CKR_OK;
+}
+
+static CK_RV bench_is_mech_allowed(policy_t p, CK_MECHANISM_PTR mech,
+                                   struct objstrength *s, int check,
+                                   struct _SESSION *session)
+{
+    UNUSED(p);
+    UNUSED(mech);
+    UNUSED(s);
+    UNUSED(check);
+    UNUSED(session);
+
+    return CKR_OK;
+}
+
+static CK_RV bench_update_mech_info(policy_t p, CK_MECHANISM_TYPE mech,
+                                    CK_MECHANISM_INFO_PTR info)
+{
+    UNUSED(p);
+    UNUSED(mech);
+    UNUSED(info);
+
+    return CKR_OK;
+}
+
+static CK_RV bench_check_token_store(policy_t p, CK_BBOOL newversion,
+                                     CK_MECHANISM_TYPE encalgo,
+                                     CK_SLOT_ID slot,
+                                     struct tokstore_strength *ts)
+{
+    UNUSED(p);
+    UNUSED(newversion);
+    UNUSED(encalgo);
+    UNUSED(slot);
+
+    memset(ts, 0, sizeof(*ts));
+    return CKR_OK;
+}
+
+static uint32_t bench_get_tokspec_count(STDLL_TokData_t *tokdata)
+{
+    UNUSED(tokdata);
+
+    return __atomic_load_n(&tokspec_count, __ATOMIC_RELAXED);
+}
+
+static void bench_incr_tokspec_count(STDLL_TokData_t *tokdata)
+{
+    UNUSED(tokdata);
+
+    __atomic_add_fetch(&tokspec_count, 1, __ATOMIC_RELAXED);
+}
+
+static void bench_decr_tokspec_count(STDLL_TokData_t *tokdata)
+{
+    UNUSED(tokdata);
+
+    __atomic_sub_fetch(&tokspec_count, 1, __ATOMIC_RELAXED);
+}
+
+/* The lock file lives in the token directory, not in the lock directory */
+static int bench_creatlock(STDLL_TokData_t *tokdata)
+{
+    char lockfile[PATH_MAX];
+    int fd;
+
+    if (ock_snprintf(lockfile, sizeof(lockfile), "%s/LCK..%s",
+                     tokdata->pk_dir, token_specific.token_subdir) != 0) {
+        TRACE_ERROR("lock file path too long\n");
+        return -1;
+    }
+
+    fd = open(lockfile, O_CREAT | O_RDONLY, S_IRUSR | S_IWUSR);
+    if (fd == -1)
+        TRACE_ERROR("open(%s): %s\n", lockfile, strerror(errno));
+
+    return fd;
+}
+
+static double elapsed_sec(const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) +
+           (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+                        struct FTW *ftwbuf)
+{
+    UNUSED(sb);
+    UNUSED(flag);
+    UNUSED(ftwbuf);
+
+    return remove(path);
+}
+
+/*
+ * Writes the ICSF token config file. SASL is used, so that no master key
+ * and RACF password files are needed.
+ */
+static CK_RV bench_write_config(void)
+{
+    FILE *fp;
+
+    if (ock_snprintf(slot_info.confname, sizeof(slot_info.confname),
+                     "%s/icsfbench.conf", tmpdir) != 0)
+        return CKR_FUNCTION_FAILED;
+
+    fp = fopen(slot_info.confname, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "fopen(%s): %s\n", slot_info.confname,
+                strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    fprintf(fp, "slot %d {\n", BENCH_SLOT_ID);
+    fprintf(fp, "TOKEN_NAME = \"%s\"\n", BENCH_TOKEN_NAME);
+    fprintf(fp, "TOKEN_MANUFACTURE = \"IBM\"\n");
+    fprintf(fp, "TOKEN_MODEL = \"Mock\"\n");
+    fprintf(fp, "TOKEN_SERIAL = \"0\"\n");
+    fprintf(fp, "MECH = \"SASL\"\n");
+    fprintf(fp, "ATTR_CACHE_SIZE = %lu\n", cache_size);
+    fprintf(fp, "ATTR_CACHE_TTL = %lu\n", cache_ttl);
+    fprintf(fp, "}\n");
+    fclose(fp);
+
+    return CKR_OK;
+}
+
+/*
+ * Sets up the token data like the API layer does it, and initializes the
+ * STDLL with the token directory in tmpdir.
+ */
+static CK_RV bench_init(void)
+{
+    char path[PATH_MAX];
+    struct trace_handle_t trace_handle = { .fd = -1, .level = TRACE_LEVEL_NONE };
+    struct group *grp;
+    CK_RV rc;
+
+    if (mkdtemp(tmpdir) == NULL) {
+        fprintf(stderr, "mkdtemp(%s): %s\n", tmpdir, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ock_snprintf(path, sizeof(path), "%s/%s", tmpdir,
+                     token_specific.token_subdir) != 0 ||
+        mkdir(path, S_IRWXU | S_IRWXG) != 0) {
+        fprintf(stderr, "mkdir(%s): %s\n", path, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    setenv("PKCS_APP_STORE", tmpdir, 1);
+
+    grp = getgrgid(getegid());
+    if (grp == NULL) {
+        fprintf(stderr, "getgrgid: %s\n", strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    bench_policy.store_object_strength = bench_store_object_strength;
+    bench_policy.is_key_allowed = bench_is_key_allowed;
+    bench_policy.is_mech_allowed = bench_is_mech_allowed;
+    bench_policy.update_mech_info = bench_update_mech_info;
+    bench_policy.check_token_store = bench_check_token_store;
+
+    slot_info.slot_number = BENCH_SLOT_ID;
+    slot_info.present = TRUE;
+    strncpy(slot_info.usergroup, grp->gr_name,
+            sizeof(slot_info.usergroup) - 1);
+    rc = bench_write_config();
+    if (rc != CKR_OK)
+        return rc;
+
+    tokdata = calloc(1, sizeof(STDLL_TokData_t));
+    if (tokdata == NULL)
+        return CKR_HOST_MEMORY;
+    tokdata->slot_id = BENCH_SLOT_ID;
+    tokdata->real_pid = getpid();
+    tokdata->real_uid = getuid();
+    tokdata->real_gid = getgid();
+    strncpy(tokdata->tokgroup, grp->gr_name, sizeof(tokdata->tokgroup) - 1);
+    tokdata->tokspec_counter.get_tokspec_count = bench_get_tokspec_count;
+    tokdata->tokspec_counter.incr_tokspec_count = bench_incr_tokspec_count;
+    tokdata->tokspec_counter.decr_tokspec_count = bench_decr_tokspec_count;
+    tokdata->global_login_state = CKS_RO_PUBLIC_SESSION;
+    tokdata->spinxplfd = -1;
+    if (pthread_rwlock_init(&tokdata->sess_list_rwlock, NULL) != 0 ||
+        pthread_mutex_init(&tokdata->login_mutex, NULL) != 0 ||
+        pthread_mutex_init(&tokdata->sess_obj_list_mutex, NULL) != 0)
+        return CKR_CANT_LOCK;
+    tokdata->policy = &bench_policy;
+    tokdata->mechtable_funcs = &mechtable_funcs;
+    tokdata->statistics = &bench_statistics;
+    slot.TokData = tokdata;
+
+    token_specific.t_creatlock = bench_creatlock;
+
+    rc = ST_Initialize(&slot, BENCH_SLOT_ID, &slot_info, trace_handle);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "ST_Initialize failed: 0x%lx\n", rc);
+        return rc;
+    }
+    fcn = slot.FcnList;
+
+    sm_copy_name(tokdata->global_shm, shm_name, sizeof(shm_name));
+
+    return CKR_OK;
+}
+
+static void bench_final(void)
+{
+    if (fcn != NULL) {
+        SC_Finalize(tokdata, BENCH_SLOT_ID, &slot_info, NULL, FALSE);
+        if (shm_name[0] != '\0')
+            sm_destroy(shm_name);
+    }
+    mock_ldap_final();
+
+    if (keep)
+        printf("Token directory kept in %s\n", tmpdir);
+    else if (strchr(tmpdir, 'X') == NULL)
+        nftw(tmpdir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static CK_RV open_session(ST_SESSION_T *sess)
+{
+    CK_RV rc;
+
+    memset(sess, 0, sizeof(*sess));
+    sess->slotID = BENCH_SLOT_ID;
+    sess->rw_session = TRUE;
+
+    rc = fcn->ST_OpenSession(tokdata, BENCH_SLOT_ID,
+                             CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                             &sess->sessionh);
+    if (rc != CKR_OK)
+        fprintf(stderr, "SC_OpenSession failed: 0x%lx\n", rc);
+
+    return rc;
+}
+
+/*
+ * The sessions must be closed before SC_Finalize, as the API layer does on
+ * C_Finalize, icsftok_final() does not expect any open session.
+ */
+static void close_session(ST_SESSION_T *sess)
+{
+    CK_RV rc;
+
+    rc = fcn->ST_CloseSession(tokdata, sess, FALSE);
+    if (rc != CKR_OK)
+        fprintf(stderr, "SC_CloseSession failed: 0x%lx\n", rc);
+}
+
+/*
+ * Initializes the token, sets the user PIN and logs in the user. The
+ * returned session must be kept open, closing it would log out.
+ */
+static CK_RV bench_login(ST_SESSION_T *sess)
+{
+    CK_CHAR label[32];
+    CK_RV rc;
+
+    memset(label, ' ', sizeof(label));
+    memcpy(label, BENCH_TOKEN_NAME, strlen(BENCH_TOKEN_NAME));
+
+    rc = fcn->ST_InitToken(tokdata, BENCH_SLOT_ID, (CK_CHAR_PTR)BENCH_SO_PIN,
+                           strlen(BENCH_SO_PIN), label);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "SC_InitToken failed: 0x%lx\n", rc);
+        return rc;
+    }
+
+    rc = open_session(sess);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = fcn->ST_Login(tokdata, sess, CKU_SO, (CK_CHAR_PTR)BENCH_SO_PIN,
+                       strlen(BENCH_SO_PIN));
+    if (rc == CKR_OK)
+        rc = fcn->ST_InitPIN(tokdata, sess, (CK_CHAR_PTR)BENCH_USER_PIN,
+                             strlen(BENCH_USER_PIN));
+    if (rc == CKR_OK)
+        rc = fcn->ST_Logout(tokdata, sess);
+    if (rc == CKR_OK)
+        rc = fcn->ST_Login(tokdata, sess, CKU_USER,
+                           (CK_CHAR_PTR)BENCH_USER_PIN,
+                           strlen(BENCH_USER_PIN));
+    if (rc != CKR_OK) {
+        fprintf(stderr, "Login failed: 0x%lx\n", rc);
+        fcn->ST_CloseSession(tokdata, sess, FALSE);
+    }
+
+    return rc;
+}
+
+static void make_label(char *buf, size_t len, const char *prefix,
+                       unsigned long thread, unsigned long obj)
+{
+    snprintf(buf, len, "%s-%lu-%lu", prefix, thread, obj);
+}
+
+static void *phase_create(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_BBOOL token = TRUE;
+    CK_BYTE value[BENCH_DATA_LEN];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_TOKEN, &token, sizeof(token)},
+        {CKA_LABEL, label, 0},
+        {CKA_APPLICATION, "icsfbench", strlen("icsfbench")},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+    unsigned long i;
+
+    memset(value, 0x5a, sizeof(value));
+
+    for (i = 0; i < num_objects; i++) {
+        make_label(label, sizeof(label), "bench", t->id, i);
+        tmpl[2].ulValueLen = strlen(label);
+        if (fcn->ST_CreateObject(tokdata, &t->session, tmpl,
+                                 sizeof(tmpl) / sizeof(CK_ATTRIBUTE),
+                                 &t->objs[i]) != CKR_OK) {
+            t->objs[i] = CK_INVALID_HANDLE;
+            t->errors++;
+        }
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+static void *phase_find(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_OBJECT_HANDLE handles[2];
+    CK_ULONG count;
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_LABEL, label, 0},
+    };
+    unsigned long i, obj;
+
+    for (i = 0; i < num_iterations; i++) {
+        obj = rand_r(&t->seed) % num_objects;
+        make_label(label, sizeof(label), "bench", t->id, obj);
+        tmpl[0].ulValueLen = strlen(label);
+
+        if (fcn->ST_FindObjectsInit(tokdata, &t->session, tmpl, 1) !=
+            CKR_OK) {
+            t->errors++;
+            continue;
+        }
+        if (fcn->ST_FindObjects(tokdata, &t->session, handles, 2,
+                                &count) != CKR_OK ||
+            count != 1 || handles[0] != t->objs[obj])
+            t->errors++;
+        fcn->ST_FindObjectsFinal(tokdata, &t->session);
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+static void *phase_getattr(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_BYTE value[BENCH_DATA_LEN];
+    char label[64], app[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_LABEL, label, sizeof(label)},
+        {CKA_APPLICATION, app, sizeof(app)},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+    unsigned long i, obj;
+
+    for (i = 0; i < num_iterations; i++) {
+        obj = rand_r(&t->seed) % num_objects;
+        tmpl[0].ulValueLen = sizeof(label);
+        tmpl[1].ulValueLen = sizeof(app);
+        tmpl[2].ulValueLen = sizeof(value);
+        if (fcn->ST_GetAttributeValue(tokdata, &t->session, t->objs[obj],
+                                      tmpl, 3) != CKR_OK)
+            t->errors++;
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Changes the label of every object and reads it back, which must return
+ * the new label even if the old attributes are cached.
+ */
+static void *phase_setattr(void *arg)
+{
+    struct bench_thread *t = arg;
+    char label[64], buf[64];
+    CK_ATTRIBUTE set_tmpl[] = {
+        {CKA_LABEL, label, 0},
+    };
+    CK_ATTRIBUTE get_tmpl[] = {
+        {CKA_LABEL, buf, sizeof(buf)},
+    };
+    unsigned long i;
+
+    for (i = 0; i < num_objects; i++) {
+        make_label(label, sizeof(label), "renamed", t->id, i);
+        set_tmpl[0].ulValueLen = strlen(label);
+        get_tmpl[0].ulValueLen = sizeof(buf);
+        if (fcn->ST_SetAttributeValue(tokdata, &t->session, t->objs[i],
+                                      set_tmpl, 1) != CKR_OK ||
+            fcn->ST_GetAttributeValue(tokdata, &t->session, t->objs[i],
+                                      get_tmpl, 1) != CKR_OK ||
+            get_tmpl[0].ulValueLen != set_tmpl[0].ulValueLen ||
+            memcmp(buf, label, set_tmpl[0].ulValueLen) != 0)
+            t->errors++;
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+static void *phase_destroy(void *arg)
+{
+    struct bench_thread *t = arg;
+    unsigned long i;
+
+    for (i = 0; i < num_objects; i++) {
+        if (t->objs[i] == CK_INVALID_HANDLE)
+            continue;
+        if (fcn->ST_DestroyObject(tokdata, &t->session,
+                                  t->objs[i]) != CKR_OK)
+            t->errors++;
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+static int run_phase(const char *name, void *(*fn)(void *),
+                     struct bench_thread *threads)
+{
+    struct timespec start;
+    unsigned long i, ops = 0, errors = 0, calls;
+    double secs;
+
+    calls = mock_ldap_get_calls();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_threads; i++) {
+        threads[i].ops = 0;
+        threads[i].errors = 0;
+        if (pthread_create(&threads[i].thread, NULL, fn, &threads[i]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        ops += threads[i].ops;
+        errors += threads[i].errors;
+    }
+
+    secs = elapsed_sec(&start);
+    calls = mock_ldap_get_calls() - calls;
+    printf("%-10s %10lu ops %10.3f s %12.0f ops/s %8.2f calls/op "
+           "%6lu errors\n", name, ops, secs, secs > 0 ? ops / secs : 0,
+           ops > 0 ? (double)calls / ops : 0, errors);
+
+    return errors > 0 ? -1 : 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("usage:  %s [-threads <num>] [-objects <num>] [-iterations <num>]\n"
+           "        [-latency <usec>] [-cache-size <num>] [-cache-ttl <sec>]\n"
+           "        [-keep] [-h]\n\n", prog);
+    printf("  -threads         number of threads (default 1)\n");
+    printf("  -objects         objects per thread (default 100)\n");
+    printf("  -iterations      find and getattr operations per thread"
+           " (default 1000)\n");
+    printf("  -latency         latency of every call to the mock LDAP"
+           " server\n");
+    printf("  -cache-size      ATTR_CACHE_SIZE of the token (default 0,"
+           " no cache)\n");
+    printf("  -cache-ttl       ATTR_CACHE_TTL of the token (default 30)\n");
+    printf("  -keep            keep the temporary token directory\n");
+}
+
+static unsigned long parse_num(const char *prog, int argc, char **argv, int *i)
+{
+    char *end;
+    unsigned long val;
+
+    if (*i + 1 >= argc) {
+        usage(prog);
+        exit(EXIT_FAILURE);
+    }
+    (*i)++;
+    val = strtoul(argv[*i], &end, 0);
+    if (*end != '\0') {
+        fprintf(stderr, "Invalid number: %s\n", argv[*i]);
+        exit(EXIT_FAILURE);
+    }
+
+    return val;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_thread *threads = NULL;
+    ST_SESSION_T login_sess;
+    CK_BBOOL logged_in = FALSE;
+    unsigned long i, num_open = 0;
+    int ret = EXIT_FAILURE;
+
+    for (i = 1; i < (unsigned long)argc; i++) {
+        int k = i;
+
+        if (strcmp(argv[k], "-threads") == 0) {
+            num_threads = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-objects") == 0) {
+            num_objects = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-iterations") == 0) {
+            num_iterations = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-latency") == 0) {
+            mock_ldap_set_latency(parse_num(argv[0], argc, argv, &k));
+        } else if (strcmp(argv[k], "-cache-size") == 0) {
+            cache_size = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-cache-ttl") == 0) {
+            cache_ttl = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-keep") == 0) {
+            keep = TRUE;
+        } else if (strcmp(argv[k], "-h") == 0) {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i = k;
+    }
+
+    if (num_threads == 0 || num_objects == 0) {
+        fprintf(stderr, "Threads and objects must not be 0\n");
+        return EXIT_FAILURE;
+    }
+
+    if (bench_init() != CKR_OK)
+        goto out;
+    if (bench_login(&login_sess) != CKR_OK)
+        goto out;
+    logged_in = TRUE;
+
+    threads = calloc(num_threads, sizeof(*threads));
+    if (threads == NULL)
+        goto out;
+    for (i = 0; i < num_threads; i++) {
+        threads[i].id = i;
+        threads[i].seed = i;
+        threads[i].objs = calloc(num_objects, sizeof(CK_OBJECT_HANDLE));
+        if (threads[i].objs == NULL)
+            goto out;
+        if (open_session(&threads[i].session) != CKR_OK)
+            goto out;
+        num_open++;
+    }
+
+    printf("threads: %lu objects: %lu iterations: %lu cache size: %lu "
+           "ttl: %lu\n", num_threads, num_threads * num_objects,
+           num_iterations, cache_size, cache_ttl);
+
+    ret = EXIT_SUCCESS;
+    if (run_phase("create", phase_create, threads) != 0 ||
+        run_phase("find", phase_find, threads) != 0 ||
+        run_phase("getattr", phase_getattr, threads) != 0 ||
+        run_phase("setattr", phase_setattr, threads) != 0 ||
+        run_phase("destroy", phase_destroy, threads) != 0)
+        ret = EXIT_FAILURE;
+
+out:
+    if (threads != NULL) {
+        for (i = 0; i < num_threads; i++) {
+            if (i < num_open)
+                close_session(&threads[i].session);
+            free(threads[i].objs);
+        }
+        free(threads);
+    }
+    if (logged_in)
+        close_session(&login_sess);
+    bench_final();
+
+    return ret;
+}
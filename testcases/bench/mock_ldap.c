@@ -0,0 +1,779 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_ldap.c
+//
+// Mock of the libldap client calls used by the ICSF token, for the ICSF
+// benchmark harness. The program is not linked against libldap: binds and the
+// root DSE search always succeed, and the ICSF extended operations are
+// decoded in process and served from an in-memory object store of a single
+// token. Only the services that create, list, read, modify and destroy
+// objects are implemented (CSFPTRC, CSFPTRL, CSFPTRD, CSFPGAV and CSFPSAV),
+// all others fail. Every call that would go over the network is delayed by a
+// configurable latency to simulate the round trip to the z/OS LDAP server.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ldap.h>
+#include <lber.h>
+
+#include "pkcs11types.h"
+#include "icsf.h"
+
+#include "mock_ldap.h"
+
+#define MOCK_LDAP_ROOT_DSE_ATTR "supportedextension"
+
+struct ldap {
+    int version;
+};
+
+struct ldapmsg {
+    int dummy;
+};
+
+struct mock_attr {
+    CK_ATTRIBUTE_TYPE type;
+    CK_BBOOL numeric;
+    ber_int_t ival;
+    struct berval val;
+};
+
+struct mock_object {
+    char id;
+    struct mock_attr *attrs;
+    unsigned long attrs_len;
+};
+
+struct mock_request {
+    char handle[ICSF_HANDLE_LEN];
+    const char *rules;
+    ber_int_t rule_count;
+    BerElement *specific;
+    BerElement *result;
+    int reason;
+};
+
+static pthread_mutex_t mock_ldap_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Objects indexed by their sequence number - 1, NULL once destroyed */
+static struct mock_object **mock_objects;
+static unsigned long mock_objects_len;
+static unsigned long mock_latency;
+static unsigned long mock_calls;
+
+void mock_ldap_set_latency(unsigned long usec)
+{
+    mock_latency = usec;
+}
+
+unsigned long mock_ldap_get_calls(void)
+{
+    return __atomic_load_n(&mock_calls, __ATOMIC_RELAXED);
+}
+
+static void mock_ldap_delay(void)
+{
+    struct timespec ts;
+
+    if (mock_latency == 0)
+        return;
+
+    ts.tv_sec = mock_latency / 1000000;
+    ts.tv_nsec = (mock_latency % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+static void mock_object_free(struct mock_object *obj)
+{
+    unsigned long i;
+
+    if (obj == NULL)
+        return;
+
+    for (i = 0; i < obj->attrs_len; i++)
+        free(obj->attrs[i].val.bv_val);
+    free(obj->attrs);
+    free(obj);
+}
+
+void mock_ldap_final(void)
+{
+    unsigned long i;
+
+    pthread_mutex_lock(&mock_ldap_mutex);
+    for (i = 0; i < mock_objects_len; i++)
+        mock_object_free(mock_objects[i]);
+    free(mock_objects);
+    mock_objects = NULL;
+    mock_objects_len = 0;
+    pthread_mutex_unlock(&mock_ldap_mutex);
+}
+
+static struct mock_attr *mock_object_find_attr(struct mock_object *obj,
+                                               CK_ATTRIBUTE_TYPE type)
+{
+    unsigned long i;
+
+    for (i = 0; i < obj->attrs_len; i++) {
+        if (obj->attrs[i].type == type)
+            return &obj->attrs[i];
+    }
+
+    return NULL;
+}
+
+static int mock_object_set_attr(struct mock_object *obj,
+                                CK_ATTRIBUTE_TYPE type, CK_BBOOL numeric,
+                                ber_int_t ival, const struct berval *val)
+{
+    struct mock_attr *attr, *attrs;
+
+    attr = mock_object_find_attr(obj, type);
+    if (attr == NULL) {
+        attrs = realloc(obj->attrs, (obj->attrs_len + 1) * sizeof(*attrs));
+        if (attrs == NULL)
+            return -1;
+        obj->attrs = attrs;
+        attr = &obj->attrs[obj->attrs_len++];
+        memset(attr, 0, sizeof(*attr));
+        attr->type = type;
+    }
+
+    free(attr->val.bv_val);
+    attr->val.bv_val = NULL;
+    attr->val.bv_len = 0;
+    attr->numeric = numeric;
+    attr->ival = ival;
+    if (!numeric && val->bv_len > 0) {
+        attr->val.bv_val = malloc(val->bv_len);
+        if (attr->val.bv_val == NULL)
+            return -1;
+        memcpy(attr->val.bv_val, val->bv_val, val->bv_len);
+        attr->val.bv_len = val->bv_len;
+    }
+
+    return 0;
+}
+
+/*
+ * Decodes the attributes encoded by icsf_ber_put_attribute_list() up to the
+ * end of the request data into obj. Numeric attributes are sent as integers
+ * with tag [1], all others as octet strings with tag [0].
+ */
+static int mock_decode_attrs(BerElement *ber, struct mock_object *obj)
+{
+    struct berval val;
+    ber_int_t type, ival;
+    ber_tag_t tag;
+    ber_len_t len;
+
+    while (ber_peek_tag(ber, &len) != LBER_DEFAULT) {
+        if (ber_scanf(ber, "{it", &type, &tag) == LBER_ERROR)
+            return -1;
+
+        ival = 0;
+        val.bv_val = NULL;
+        val.bv_len = 0;
+        if ((tag & LBER_BIG_TAG_MASK) == 0) {
+            if (ber_scanf(ber, "m}", &val) == LBER_ERROR)
+                return -1;
+        } else {
+            if (ber_scanf(ber, "i}", &ival) == LBER_ERROR)
+                return -1;
+        }
+
+        if (mock_object_set_attr(obj, (CK_ULONG)type,
+                                 (tag & LBER_BIG_TAG_MASK) != 0, ival, &val))
+            return -1;
+    }
+
+    return 0;
+}
+
+static CK_BBOOL mock_object_match(struct mock_object *obj,
+                                  struct mock_object *tmpl)
+{
+    struct mock_attr *attr;
+    unsigned long i;
+
+    for (i = 0; i < tmpl->attrs_len; i++) {
+        attr = mock_object_find_attr(obj, tmpl->attrs[i].type);
+        if (attr == NULL)
+            return FALSE;
+        if (attr->numeric) {
+            if (attr->ival != tmpl->attrs[i].ival)
+                return FALSE;
+        } else if (attr->val.bv_len != tmpl->attrs[i].val.bv_len ||
+                   (attr->val.bv_len > 0 &&
+                    memcmp(attr->val.bv_val, tmpl->attrs[i].val.bv_val,
+                           attr->val.bv_len) != 0)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static CK_BBOOL mock_has_rule(const struct mock_request *req,
+                              const char *keyword)
+{
+    char item[ICSF_RULE_ITEM_LEN];
+    ber_int_t i;
+
+    memset(item, ' ', sizeof(item));
+    memcpy(item, keyword, strlen(keyword));
+
+    for (i = 0; i < req->rule_count; i++) {
+        if (memcmp(req->rules + i * ICSF_RULE_ITEM_LEN, item,
+                   ICSF_RULE_ITEM_LEN) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Object handles are the token name, the sequence number in hex and the
+ * object type ('T' or 'S'), padded with blanks. Token handles have blanks
+ * instead of the sequence number, which makes them sequence number 0.
+ */
+static void mock_object_handle(char *handle, const char *token_handle,
+                               unsigned long seq, char id)
+{
+    char hex[ICSF_SEQUENCE_LEN + 1];
+
+    memmove(handle, token_handle, ICSF_TOKEN_NAME_LEN);
+    snprintf(hex, sizeof(hex), "%0*X", ICSF_SEQUENCE_LEN, (unsigned int)seq);
+    memcpy(handle + ICSF_TOKEN_NAME_LEN, hex, ICSF_SEQUENCE_LEN);
+    memset(handle + ICSF_TOKEN_NAME_LEN + ICSF_SEQUENCE_LEN, ' ',
+           ICSF_HANDLE_LEN - ICSF_TOKEN_NAME_LEN - ICSF_SEQUENCE_LEN);
+    handle[ICSF_TOKEN_NAME_LEN + ICSF_SEQUENCE_LEN] = id;
+}
+
+static unsigned long mock_handle_seq(const char *handle)
+{
+    char hex[ICSF_SEQUENCE_LEN + 1];
+
+    memcpy(hex, handle + ICSF_TOKEN_NAME_LEN, ICSF_SEQUENCE_LEN);
+    hex[ICSF_SEQUENCE_LEN] = '\0';
+
+    return strtoul(hex, NULL, 16);
+}
+
+static struct mock_object *mock_handle_object(const char *handle)
+{
+    unsigned long seq = mock_handle_seq(handle);
+
+    if (seq == 0 || seq > mock_objects_len)
+        return NULL;
+
+    return mock_objects[seq - 1];
+}
+
+/* CSFPTRC: create a token or an object */
+static int mock_trc(struct mock_request *req)
+{
+    static const CK_BBOOL false_value = FALSE;
+    const struct berval false_val = { sizeof(false_value),
+                                      (char *)&false_value };
+    struct mock_object *obj, **objs;
+    struct mock_attr *token;
+
+    /* The only token always exists, recreating it is a no-op */
+    if (mock_has_rule(req, "TOKEN"))
+        return ICSF_RC_SUCCESS;
+    if (!mock_has_rule(req, "OBJECT") || mock_has_rule(req, "COPY") ||
+        req->specific == NULL)
+        return ICSF_RC_ERROR;
+
+    obj = calloc(1, sizeof(*obj));
+    if (obj == NULL)
+        return ICSF_RC_ERROR;
+
+    if (ber_scanf(req->specific, "{") == LBER_ERROR ||
+        mock_decode_attrs(req->specific, obj) != 0)
+        goto err;
+
+    /* ICSF returns CKA_TOKEN and CKA_PRIVATE for every object */
+    if ((mock_object_find_attr(obj, CKA_TOKEN) == NULL &&
+         mock_object_set_attr(obj, CKA_TOKEN, FALSE, 0, &false_val) != 0) ||
+        (mock_object_find_attr(obj, CKA_PRIVATE) == NULL &&
+         mock_object_set_attr(obj, CKA_PRIVATE, FALSE, 0, &false_val) != 0))
+        goto err;
+
+    token = mock_object_find_attr(obj, CKA_TOKEN);
+    obj->id = (token->val.bv_len > 0 && token->val.bv_val[0]) ?
+                    ICSF_TOKEN_OBJECT : ICSF_SESSION_OBJECT;
+
+    objs = realloc(mock_objects, (mock_objects_len + 1) * sizeof(*objs));
+    if (objs == NULL)
+        goto err;
+    mock_objects = objs;
+    mock_objects[mock_objects_len++] = obj;
+
+    mock_object_handle(req->handle, req->handle, mock_objects_len, obj->id);
+
+    return ICSF_RC_SUCCESS;
+
+err:
+    mock_object_free(obj);
+    req->reason = 3030; /* CKR_ATTRIBUTE_VALUE_INVALID */
+    return ICSF_RC_ERROR;
+}
+
+/* CSFPTRD: destroy a token or an object */
+static int mock_trd(struct mock_request *req)
+{
+    unsigned long seq;
+
+    if (mock_has_rule(req, "TOKEN"))
+        return ICSF_RC_SUCCESS;
+
+    if (mock_handle_object(req->handle) == NULL)
+        return ICSF_RC_ERROR;
+
+    seq = mock_handle_seq(req->handle);
+    mock_object_free(mock_objects[seq - 1]);
+    mock_objects[seq - 1] = NULL;
+
+    return ICSF_RC_SUCCESS;
+}
+
+/*
+ * CSFPTRL: list the objects matching the search template, starting after the
+ * object of the handle. There are no other tokens to list.
+ */
+static int mock_trl(struct mock_request *req)
+{
+    struct mock_object *tmpl = NULL;
+    ber_int_t in_len, max_count, count = 0;
+    ber_len_t len;
+    unsigned long seq;
+    char *list = NULL;
+    int rc = ICSF_RC_ERROR;
+
+    if (req->specific == NULL ||
+        ber_scanf(req->specific, "ii", &in_len, &max_count) == LBER_ERROR ||
+        max_count < 0)
+        return ICSF_RC_ERROR;
+
+    tmpl = calloc(1, sizeof(*tmpl));
+    list = malloc(max_count * ICSF_HANDLE_LEN + 1);
+    if (tmpl == NULL || list == NULL)
+        goto done;
+
+    if (ber_peek_tag(req->specific, &len) != LBER_DEFAULT &&
+        (ber_scanf(req->specific, "{") == LBER_ERROR ||
+         mock_decode_attrs(req->specific, tmpl) != 0))
+        goto done;
+
+    if (mock_has_rule(req, "OBJECT")) {
+        for (seq = mock_handle_seq(req->handle);
+             seq < mock_objects_len && count < max_count; seq++) {
+            if (mock_objects[seq] == NULL ||
+                !mock_object_match(mock_objects[seq], tmpl))
+                continue;
+            mock_object_handle(list + count * ICSF_HANDLE_LEN, req->handle,
+                               seq + 1, mock_objects[seq]->id);
+            count++;
+        }
+    }
+
+    /*
+     * TRLOutput ::= SEQUENCE {
+     *      handleList      [1] OCTET STRING,
+     *      outListLen      INTEGER
+     * }
+     */
+    req->result = ber_alloc_t(LBER_USE_DER);
+    if (req->result == NULL ||
+        ber_printf(req->result, "toi", 1 | LBER_CLASS_CONTEXT, list,
+                   (ber_len_t)count * ICSF_HANDLE_LEN,
+                   count * ICSF_HANDLE_LEN) < 0)
+        goto done;
+
+    rc = ICSF_RC_SUCCESS;
+
+done:
+    mock_object_free(tmpl);
+    free(list);
+
+    return rc;
+}
+
+/* CSFPGAV: return all attributes of an object */
+static int mock_gav(struct mock_request *req)
+{
+    struct mock_object *obj;
+    struct mock_attr *attr;
+    unsigned long i;
+
+    obj = mock_handle_object(req->handle);
+    if (obj == NULL)
+        return ICSF_RC_ERROR;
+
+    /*
+     * GAVOutput ::= SEQUENCE {
+     *    attrList          Attributes,
+     *    attrListLen       INTEGER
+     * }
+     */
+    req->result = ber_alloc_t(LBER_USE_DER);
+    if (req->result == NULL || ber_printf(req->result, "{") < 0)
+        return ICSF_RC_ERROR;
+
+    for (i = 0; i < obj->attrs_len; i++) {
+        attr = &obj->attrs[i];
+        if (attr->numeric) {
+            if (ber_printf(req->result, "{iti}", (ber_int_t)attr->type,
+                           1 | LBER_CLASS_CONTEXT, attr->ival) < 0)
+                return ICSF_RC_ERROR;
+        } else {
+            if (ber_printf(req->result, "{ito}", (ber_int_t)attr->type,
+                           0 | LBER_CLASS_CONTEXT,
+                           attr->val.bv_val ? attr->val.bv_val : "",
+                           attr->val.bv_len) < 0)
+                return ICSF_RC_ERROR;
+        }
+    }
+
+    if (ber_printf(req->result, "}i", (ber_int_t)obj->attrs_len) < 0)
+        return ICSF_RC_ERROR;
+
+    return ICSF_RC_SUCCESS;
+}
+
+/* CSFPSAV: set attributes of an object */
+static int mock_sav(struct mock_request *req)
+{
+    struct mock_object *obj;
+
+    obj = mock_handle_object(req->handle);
+    if (obj == NULL || req->specific == NULL)
+        return ICSF_RC_ERROR;
+
+    if (mock_decode_attrs(req->specific, obj) != 0) {
+        req->reason = 3030; /* CKR_ATTRIBUTE_VALUE_INVALID */
+        return ICSF_RC_ERROR;
+    }
+
+    return ICSF_RC_SUCCESS;
+}
+
+int ldap_initialize(LDAP **ldp, const char *url)
+{
+    (void)url;
+
+    *ldp = calloc(1, sizeof(**ldp));
+    if (*ldp == NULL)
+        return LDAP_NO_MEMORY;
+    (*ldp)->version = LDAP_VERSION3;
+
+    return LDAP_SUCCESS;
+}
+
+int ldap_get_option(LDAP *ld, int option, void *outvalue)
+{
+    switch (option) {
+    case LDAP_OPT_PROTOCOL_VERSION:
+        if (ld == NULL)
+            return LDAP_OPERATIONS_ERROR;
+        *(int *)outvalue = ld->version;
+        break;
+    case LDAP_OPT_DIAGNOSTIC_MESSAGE:
+        *(char **)outvalue = NULL;
+        break;
+    default:
+        return LDAP_OPERATIONS_ERROR;
+    }
+
+    return LDAP_OPT_SUCCESS;
+}
+
+int ldap_set_option(LDAP *ld, int option, const void *invalue)
+{
+    if (option == LDAP_OPT_PROTOCOL_VERSION) {
+        if (ld == NULL)
+            return LDAP_OPERATIONS_ERROR;
+        ld->version = *(const int *)invalue;
+    }
+
+    /* The TLS options are accepted and ignored */
+    return LDAP_OPT_SUCCESS;
+}
+
+int ldap_sasl_bind_s(LDAP *ld, const char *dn, const char *mechanism,
+                     struct berval *cred, LDAPControl **sctrls,
+                     LDAPControl **cctrls, struct berval **servercredp)
+{
+    (void)dn;
+    (void)mechanism;
+    (void)cred;
+    (void)sctrls;
+    (void)cctrls;
+
+    if (servercredp != NULL)
+        *servercredp = NULL;
+
+    mock_ldap_delay();
+
+    return ld != NULL ? LDAP_SUCCESS : LDAP_OPERATIONS_ERROR;
+}
+
+int ldap_unbind_ext_s(LDAP *ld, LDAPControl **sctrls, LDAPControl **cctrls)
+{
+    (void)sctrls;
+    (void)cctrls;
+
+    free(ld);
+
+    return LDAP_SUCCESS;
+}
+
+/*
+ * Only the search of the root DSE is supported, which returns a single entry
+ * with the ICSF extension as the only attribute.
+ */
+int ldap_search_ext_s(LDAP *ld, const char *base, int scope,
+                      const char *filter, char **attrs, int attrsonly,
+                      LDAPControl **sctrls, LDAPControl **cctrls,
+                      struct timeval *timeout, int sizelimit,
+                      LDAPMessage **res)
+{
+    (void)filter;
+    (void)attrs;
+    (void)attrsonly;
+    (void)sctrls;
+    (void)cctrls;
+    (void)timeout;
+    (void)sizelimit;
+
+    mock_ldap_delay();
+
+    if (ld == NULL || base == NULL || base[0] != '\0' ||
+        scope != LDAP_SCOPE_BASE)
+        return LDAP_OPERATIONS_ERROR;
+
+    *res = calloc(1, sizeof(**res));
+
+    return *res != NULL ? LDAP_SUCCESS : LDAP_NO_MEMORY;
+}
+
+LDAPMessage *ldap_first_entry(LDAP *ld, LDAPMessage *chain)
+{
+    (void)ld;
+
+    return chain;
+}
+
+char *ldap_first_attribute(LDAP *ld, LDAPMessage *entry, BerElement **berout)
+{
+    (void)ld;
+    (void)entry;
+
+    /* The caller frees the element with ber_free() */
+    *berout = ber_alloc_t(LBER_USE_DER);
+    if (*berout == NULL)
+        return NULL;
+
+    return strdup(MOCK_LDAP_ROOT_DSE_ATTR);
+}
+
+char *ldap_next_attribute(LDAP *ld, LDAPMessage *entry, BerElement *ber)
+{
+    (void)ld;
+    (void)entry;
+    (void)ber;
+
+    return NULL;
+}
+
+struct berval **ldap_get_values_len(LDAP *ld, LDAPMessage *entry,
+                                    const char *target)
+{
+    struct berval **vals;
+
+    (void)ld;
+    (void)entry;
+
+    if (strcmp(target, MOCK_LDAP_ROOT_DSE_ATTR) != 0)
+        return NULL;
+
+    vals = calloc(2, sizeof(*vals));
+    if (vals == NULL)
+        return NULL;
+    vals[0] = calloc(1, sizeof(**vals));
+    if (vals[0] == NULL ||
+        (vals[0]->bv_val = strdup(ICSF_REQ_OID)) == NULL) {
+        ldap_value_free_len(vals);
+        return NULL;
+    }
+    vals[0]->bv_len = strlen(ICSF_REQ_OID);
+
+    return vals;
+}
+
+void ldap_value_free_len(struct berval **vals)
+{
+    struct berval **it;
+
+    if (vals == NULL)
+        return;
+
+    for (it = vals; *it != NULL; it++) {
+        free((*it)->bv_val);
+        free(*it);
+    }
+    free(vals);
+}
+
+void ldap_memfree(void *p)
+{
+    free(p);
+}
+
+int ldap_msgfree(LDAPMessage *lm)
+{
+    free(lm);
+
+    return 0;
+}
+
+char *ldap_err2string(int err)
+{
+    return err == LDAP_SUCCESS ? "Success" : "Mock LDAP error";
+}
+
+/*
+ * Decodes the ICSF request built by icsf_call(), runs the service and encodes
+ * the response the way icsf_call() decodes it:
+ *
+ * responseValue ::= SEQUENCE {
+ *      version         INTEGER,
+ *      returnCode      INTEGER,
+ *      reasonCode      INTEGER,
+ *      exitData        OCTET STRING,
+ *      handle          OCTET STRING,
+ *      responseData    CSFPOutput
+ * }
+ */
+int ldap_extended_operation_s(LDAP *ld, const char *reqoid,
+                              struct berval *reqdata, LDAPControl **sctrls,
+                              LDAPControl **cctrls, char **retoidp,
+                              struct berval **retdatap)
+{
+    struct mock_request req;
+    struct berval exit_data, handle, rules, specific;
+    struct berval *raw_result = NULL;
+    BerElement *ber_req = NULL, *ber_res = NULL;
+    ber_int_t version;
+    ber_tag_t tag;
+    int icsf_rc, rc = LDAP_OPERATIONS_ERROR;
+
+    (void)sctrls;
+    (void)cctrls;
+
+    __atomic_add_fetch(&mock_calls, 1, __ATOMIC_RELAXED);
+    mock_ldap_delay();
+
+    if (retoidp != NULL)
+        *retoidp = NULL;
+    *retdatap = NULL;
+    memset(&req, 0, sizeof(req));
+
+    if (ld == NULL || reqdata == NULL || strcmp(reqoid, ICSF_REQ_OID) != 0)
+        return LDAP_PROTOCOL_ERROR;
+
+    ber_req = ber_init(reqdata);
+    if (ber_req == NULL)
+        return LDAP_NO_MEMORY;
+
+    if (ber_scanf(ber_req, "{imm{im}tm", &version, &exit_data, &handle,
+                  &req.rule_count, &rules, &tag, &specific) == LBER_ERROR ||
+        handle.bv_len != ICSF_HANDLE_LEN || req.rule_count < 0 ||
+        rules.bv_len < (ber_len_t)req.rule_count * ICSF_RULE_ITEM_LEN) {
+        rc = LDAP_PROTOCOL_ERROR;
+        goto done;
+    }
+    memcpy(req.handle, handle.bv_val, ICSF_HANDLE_LEN);
+    req.rules = rules.bv_val;
+    if (specific.bv_len > 0) {
+        req.specific = ber_init(&specific);
+        if (req.specific == NULL) {
+            rc = LDAP_NO_MEMORY;
+            goto done;
+        }
+    }
+
+    pthread_mutex_lock(&mock_ldap_mutex);
+    switch (tag & LBER_BIG_TAG_MASK) {
+    case ICSF_TAG_CSFPTRC:
+        icsf_rc = mock_trc(&req);
+        break;
+    case ICSF_TAG_CSFPTRD:
+        icsf_rc = mock_trd(&req);
+        break;
+    case ICSF_TAG_CSFPTRL:
+        icsf_rc = mock_trl(&req);
+        break;
+    case ICSF_TAG_CSFPGAV:
+        icsf_rc = mock_gav(&req);
+        break;
+    case ICSF_TAG_CSFPSAV:
+        icsf_rc = mock_sav(&req);
+        break;
+    default:
+        icsf_rc = ICSF_RC_ERROR;
+        break;
+    }
+    pthread_mutex_unlock(&mock_ldap_mutex);
+
+    ber_res = ber_alloc_t(LBER_USE_DER);
+    if (ber_res == NULL) {
+        rc = LDAP_NO_MEMORY;
+        goto done;
+    }
+
+    if (ber_printf(ber_res, "{iiioo", version, icsf_rc, req.reason, "",
+                   (ber_len_t)0, req.handle, (ber_len_t)ICSF_HANDLE_LEN) < 0)
+        goto done;
+
+    if (icsf_rc == ICSF_RC_SUCCESS && req.result != NULL) {
+        if (ber_flatten(req.result, &raw_result) != 0 ||
+            ber_printf(ber_res, "to", (tag & LBER_BIG_TAG_MASK) |
+                       LBER_CLASS_CONTEXT | LBER_CONSTRUCTED,
+                       raw_result->bv_val, raw_result->bv_len) < 0)
+            goto done;
+    }
+
+    if (ber_printf(ber_res, "}") < 0 || ber_flatten(ber_res, retdatap) != 0)
+        goto done;
+
+    rc = LDAP_SUCCESS;
+
+done:
+    if (raw_result != NULL)
+        ber_bvfree(raw_result);
+    if (req.result != NULL)
+        ber_free(req.result, 1);
+    if (req.specific != NULL)
+        ber_free(req.specific, 1);
+    if (ber_res != NULL)
+        ber_free(ber_res, 1);
+    ber_free(ber_req, 1);
+
+    return rc;
+}
@@ -0,0 +1,18 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef MOCK_LDAP_H
+#define MOCK_LDAP_H
+
+void mock_ldap_set_latency(unsigned long usec);
+unsigned long mock_ldap_get_calls(void);
+void mock_ldap_final(void);
+
+#endif
@@ -0,0 +1,353 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_specific.c
+//
+// Mock token specific backend for the STDLL benchmark harness. It supports
+// a small set of clear key AES, SHA and RSA mechanisms implemented with
+// OpenSSL, and delays every operation by a configurable latency to simulate
+// the time a request spends in a crypto adapter. The lock file lives in the token
+// directory, so that no installed lock directory is needed.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#include <openssl/crypto.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "tok_spec_struct.h"
+#include "trace.h"
+#include "slotmgr.h" // for ock_snprintf
+
+#include "mock_specific.h"
+
+const char manuf[] = "IBM";
+const char model[] = "Mock";
+const char descr[] = "IBM Mock token";
+const char label[] = "mocktok";
+
+static const MECH_LIST_ELEMENT mock_mech_list[] = {
+    {CKM_AES_KEY_GEN, {16, 32, CKF_GENERATE}},
+    {CKM_AES_ECB, {16, 32, CKF_ENCRYPT | CKF_DECRYPT | CKF_WRAP | CKF_UNWRAP}},
+    {CKM_AES_CBC, {16, 32, CKF_ENCRYPT | CKF_DECRYPT | CKF_WRAP | CKF_UNWRAP}},
+    {CKM_AES_CBC_PAD,
+     {16, 32, CKF_ENCRYPT | CKF_DECRYPT | CKF_WRAP | CKF_UNWRAP}},
+    {CKM_GENERIC_SECRET_KEY_GEN, {80, 2048, CKF_GENERATE}},
+    {CKM_SHA_1, {0, 0, CKF_DIGEST}},
+    {CKM_SHA256, {0, 0, CKF_DIGEST}},
+    {CKM_RSA_PKCS_KEY_PAIR_GEN, {512, 4096, CKF_GENERATE_KEY_PAIR}},
+    {CKM_RSA_PKCS, {512, 4096, CKF_SIGN | CKF_VERIFY}},
+    {CKM_SHA256_RSA_PKCS, {512, 4096, CKF_SIGN | CKF_VERIFY}},
+};
+
+static const CK_ULONG mock_mech_list_len =
+                    (sizeof(mock_mech_list) / sizeof(MECH_LIST_ELEMENT));
+
+static unsigned long mock_latency[MOCK_OP_NUM];
+static unsigned long mock_calls[MOCK_OP_NUM];
+
+void mock_set_latency(enum mock_op op, unsigned long usec)
+{
+    mock_latency[op] = usec;
+}
+
+unsigned long mock_get_latency(enum mock_op op)
+{
+    return mock_latency[op];
+}
+
+unsigned long mock_get_calls(enum mock_op op)
+{
+    return __atomic_load_n(&mock_calls[op], __ATOMIC_RELAXED);
+}
+
+static void mock_delay(enum mock_op op)
+{
+    struct timespec ts;
+
+    __atomic_add_fetch(&mock_calls[op], 1, __ATOMIC_RELAXED);
+
+    if (mock_latency[op] == 0)
+        return;
+
+    ts.tv_sec = mock_latency[op] / 1000000;
+    ts.tv_nsec = (mock_latency[op] % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+/*
+ * Re-encipher callback for obj_mgr_reencipher_secure_key(). The secure keys
+ * of the mock are opaque byte strings, re-enciphering inverts all bits.
+ */
+CK_RV mock_reencipher_key(CK_BYTE *sec_key, CK_BYTE *reenc_sec_key,
+                          CK_ULONG sec_key_len, void *private)
+{
+    CK_ULONG i;
+
+    UNUSED(private);
+
+    mock_delay(MOCK_OP_REENC);
+
+    for (i = 0; i < sec_key_len; i++)
+        reenc_sec_key[i] = ~sec_key[i];
+
+    return CKR_OK;
+}
+
+static int mock_creatlock(STDLL_TokData_t *tokdata)
+{
+    char lockfile[PATH_MAX];
+    int fd;
+
+    if (ock_snprintf(lockfile, sizeof(lockfile), "%s/LCK..%s",
+                     tokdata->pk_dir, MOCK_TOKEN_SUBDIR) != 0) {
+        TRACE_ERROR("lock file path too long\n");
+        return -1;
+    }
+
+    fd = open(lockfile, O_CREAT | O_RDONLY, S_IRUSR | S_IWUSR);
+    if (fd == -1)
+        TRACE_ERROR("open(%s): %s\n", lockfile, strerror(errno));
+
+    return fd;
+}
+
+static CK_RV mock_init(STDLL_TokData_t *tokdata, CK_SLOT_ID slot_id,
+                       char *conf_name)
+{
+    long cpus;
+
+    UNUSED(conf_name);
+
+    TRACE_INFO("mock %s slot=%lu running\n", __func__, slot_id);
+
+    /* Like the soft token, spread batch and async requests over all CPUs */
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    tokdata->batch_threads = (cpus > 0 ? (CK_ULONG)cpus : 1);
+    tokdata->async_threads = tokdata->batch_threads;
+
+    return ock_generic_filter_mechanism_list(tokdata,
+                                             mock_mech_list,
+                                             mock_mech_list_len,
+                                             &(tokdata->mech_list),
+                                             &(tokdata->mech_list_len));
+}
+
+static CK_RV mock_final(STDLL_TokData_t *tokdata, CK_BBOOL in_fork_initializer)
+{
+    UNUSED(in_fork_initializer);
+
+    TRACE_INFO("mock %s running\n", __func__);
+
+    free(tokdata->mech_list);
+    tokdata->mech_list = NULL;
+    tokdata->mech_list_len = 0;
+
+    return CKR_OK;
+}
+
+static CK_RV mock_aes_key_gen(STDLL_TokData_t *tokdata, TEMPLATE *tmpl,
+                              CK_BYTE **key, CK_ULONG *len, CK_ULONG keysize,
+                              CK_BBOOL *is_opaque)
+{
+    UNUSED(tmpl);
+
+    mock_delay(MOCK_OP_KEYGEN);
+
+    *key = malloc(keysize);
+    if (*key == NULL)
+        return CKR_HOST_MEMORY;
+    *len = keysize;
+    *is_opaque = FALSE;
+
+    return rng_generate(tokdata, *key, keysize);
+}
+
+static CK_RV mock_aes_ecb(STDLL_TokData_t *tokdata, SESSION *sess,
+                          CK_BYTE *in_data, CK_ULONG in_data_len,
+                          CK_BYTE *out_data, CK_ULONG *out_data_len,
+                          OBJECT *key, CK_BYTE encrypt)
+{
+    UNUSED(sess);
+
+    mock_delay(MOCK_OP_CIPHER);
+
+    return openssl_specific_aes_ecb(tokdata, in_data, in_data_len,
+                                    out_data, out_data_len, key, encrypt);
+}
+
+static CK_RV mock_aes_cbc(STDLL_TokData_t *tokdata, SESSION *sess,
+                          CK_BYTE *in_data, CK_ULONG in_data_len,
+                          CK_BYTE *out_data, CK_ULONG *out_data_len,
+                          OBJECT *key, CK_BYTE *init_v, CK_BYTE encrypt)
+{
+    UNUSED(sess);
+
+    mock_delay(MOCK_OP_CIPHER);
+
+    return openssl_specific_aes_cbc(tokdata, in_data, in_data_len,
+                                    out_data, out_data_len, key,
+                                    init_v, encrypt);
+}
+
+static CK_RV mock_generic_secret_key_gen(STDLL_TokData_t *tokdata,
+                                         TEMPLATE *tmpl)
+{
+    CK_ATTRIBUTE *value_attr = NULL;
+    CK_BYTE secret_key[256];
+    CK_ULONG key_length;
+    CK_RV rc;
+
+    mock_delay(MOCK_OP_KEYGEN);
+
+    rc = template_attribute_get_ulong(tmpl, CKA_VALUE_LEN, &key_length);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("CKA_VALUE_LEN missing in (HMAC) key template\n");
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+    if (key_length < 10 || key_length > sizeof(secret_key)) {
+        TRACE_ERROR("Generic secret key size of %lu bytes not supported\n",
+                    key_length);
+        return CKR_KEY_SIZE_RANGE;
+    }
+
+    rc = rng_generate(tokdata, secret_key, key_length);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = build_attribute(CKA_VALUE, secret_key, key_length, &value_attr);
+    OPENSSL_cleanse(secret_key, sizeof(secret_key));
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = template_update_attribute(tmpl, value_attr);
+    if (rc != CKR_OK)
+        free(value_attr);
+
+    return rc;
+}
+
+static CK_RV mock_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
+                           CK_MECHANISM *mech)
+{
+    return openssl_specific_sha_init(tokdata, ctx, mech);
+}
+
+static CK_RV mock_sha(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
+                      CK_BYTE *in_data, CK_ULONG in_data_len,
+                      CK_BYTE *out_data, CK_ULONG *out_data_len)
+{
+    mock_delay(MOCK_OP_DIGEST);
+
+    return openssl_specific_sha(tokdata, ctx, in_data, in_data_len,
+                                out_data, out_data_len);
+}
+
+static CK_RV mock_sha_update(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
+                             CK_BYTE *in_data, CK_ULONG in_data_len)
+{
+    mock_delay(MOCK_OP_DIGEST);
+
+    return openssl_specific_sha_update(tokdata, ctx, in_data, in_data_len);
+}
+
+static CK_RV mock_sha_final(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
+                            CK_BYTE *out_data, CK_ULONG *out_data_len)
+{
+    return openssl_specific_sha_final(tokdata, ctx, out_data, out_data_len);
+}
+
+static CK_RV mock_rsa_generate_keypair(STDLL_TokData_t *tokdata,
+                                       TEMPLATE *publ_tmpl,
+                                       TEMPLATE *priv_tmpl)
+{
+    UNUSED(tokdata);
+
+    mock_delay(MOCK_OP_KEYGEN);
+
+    return openssl_specific_rsa_keygen(publ_tmpl, priv_tmpl);
+}
+
+static CK_RV mock_rsa_sign(STDLL_TokData_t *tokdata, SESSION *sess,
+                           CK_BYTE *in_data, CK_ULONG in_data_len,
+                           CK_BYTE *out_data, CK_ULONG *out_data_len,
+                           OBJECT *key_obj)
+{
+    mock_delay(MOCK_OP_SIGN);
+
+    return openssl_specific_rsa_pkcs_sign(tokdata, sess, in_data, in_data_len,
+                                          out_data, out_data_len, key_obj,
+                                          openssl_specific_rsa_decrypt);
+}
+
+static CK_RV mock_rsa_verify(STDLL_TokData_t *tokdata, SESSION *sess,
+                             CK_BYTE *in_data, CK_ULONG in_data_len,
+                             CK_BYTE *signature, CK_ULONG sig_len,
+                             OBJECT *key_obj)
+{
+    mock_delay(MOCK_OP_SIGN);
+
+    return openssl_specific_rsa_pkcs_verify(tokdata, sess, in_data,
+                                            in_data_len, signature, sig_len,
+                                            key_obj,
+                                            openssl_specific_rsa_encrypt);
+}
+
+static CK_RV mock_get_mechanism_list(STDLL_TokData_t *tokdata,
+                                     CK_MECHANISM_TYPE_PTR pMechanismList,
+                                     CK_ULONG_PTR pulCount)
+{
+    return ock_generic_get_mechanism_list(tokdata, pMechanismList, pulCount,
+                                          NULL);
+}
+
+static CK_RV mock_get_mechanism_info(STDLL_TokData_t *tokdata,
+                                     CK_MECHANISM_TYPE type,
+                                     CK_MECHANISM_INFO_PTR pInfo)
+{
+    return ock_generic_get_mechanism_info(tokdata, type, pInfo, NULL);
+}
+
+token_spec_t token_specific = {
+    .token_directory = "",
+    .token_subdir = MOCK_TOKEN_SUBDIR,
+    .secure_key_token = FALSE,
+    .data_store = {
+        .per_user = FALSE,
+        .use_master_key = TRUE,
+        .encryption_algorithm = CKM_AES_CBC,
+        .pin_initial_vector = (CK_BYTE *)"12345678abcdefgh",
+        .obj_initial_vector = (CK_BYTE *)"10293847abcdefgh",
+    },
+    .t_creatlock = &mock_creatlock,
+    .t_init = &mock_init,
+    .t_final = &mock_final,
+    .t_sha_init = &mock_sha_init,
+    .t_sha = &mock_sha,
+    .t_sha_update = &mock_sha_update,
+    .t_sha_final = &mock_sha_final,
+    .t_generic_secret_key_gen = &mock_generic_secret_key_gen,
+    .t_aes_key_gen = &mock_aes_key_gen,
+    .t_aes_ecb = &mock_aes_ecb,
+    .t_aes_cbc = &mock_aes_cbc,
+    .t_rsa_generate_keypair = &mock_rsa_generate_keypair,
+    .t_rsa_sign = &mock_rsa_sign,
+    .t_rsa_verify = &mock_rsa_verify,
+    .t_get_mechanism_list = &mock_get_mechanism_list,
+    .t_get_mechanism_info = &mock_get_mechanism_info,
+};
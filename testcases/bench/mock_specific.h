@@ -0,0 +1,32 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef MOCK_SPECIFIC_H
+#define MOCK_SPECIFIC_H
+
+#define MOCK_TOKEN_SUBDIR       "mocktok"
+
+/* Classes of token specific operations with a configurable latency */
+enum mock_op {
+    MOCK_OP_KEYGEN,
+    MOCK_OP_CIPHER,
+    MOCK_OP_DIGEST,
+    MOCK_OP_SIGN,
+    MOCK_OP_REENC,
+    MOCK_OP_NUM,
+};
+
+void mock_set_latency(enum mock_op op, unsigned long usec);
+unsigned long mock_get_latency(enum mock_op op);
+unsigned long mock_get_calls(enum mock_op op);
+CK_RV mock_reencipher_key(CK_BYTE *sec_key, CK_BYTE *reenc_sec_key,
+                          CK_ULONG sec_key_len, void *private);
+
+#endif
@@ -0,0 +1,1776 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: stdllbench.c
+ *
+ * Micro-benchmark and fuzz driver for the common STDLL code. The STDLL is
+ * linked into this program together with a mock token specific backend, and
+ * its SC_* entry points are called directly, without the API layer, the
+ * slot daemon or any crypto hardware. The token lives in a temporary
+ * directory that is removed when the program ends.
+ *
+ * In benchmark mode, each thread opens its sessions and runs the phases
+ * create, find, getattr, certattr, encrypt, digest, signbatch and destroy on
+ * its own objects. The certattr phase creates certificates and fetches all
+ * their attributes with one call per certificate, like a certificate store
+ * does. The signbatch phase signs with CKM_SHA256_RSA_PKCS in batches, which
+ * the STDLL spreads over several worker threads of the same session, and
+ * verifies every signature afterwards. Build the harness with
+ * -fsanitize=thread to check the session state shared by the workers.
+ * With -strength and -policy, the real policy is loaded from the given
+ * files, so that the policy overhead of the operation initializations can
+ * be compared with the empty policy.
+ * In fuzz mode, each thread creates, copies, reads and modifies objects with
+ * random templates. Only crashes and sanitizer findings are errors then.
+ * In re-encipher mode, the threads create token keys with a secure key, which
+ * are then re-enciphered by obj_mgr_iterate_key_objects() as during an HSM
+ * master key change, with -threads worker threads. The first run fails on
+ * an injected error, the second run must only re-encipher the keys not done
+ * by the first run, and a third run for another operation all keys. Every
+ * key must be saved exactly once per run.
+ * In login cache mode, the user logs in with the 'logincache' slot option,
+ * and the logins with and without a cached wrapping key are timed. Wrong
+ * PINs must fail while an entry exists, and C_Logout, C_SetPIN and
+ * C_InitToken must remove the entry.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ftw.h>
+#include <grp.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/keyctl.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "local_types.h"
+#include "apictl.h"
+#include "policy.h"
+#include "mechtable.h"
+#include "shared_memory.h"
+#include "trace.h"
+#include "slotmgr.h" // for ock_snprintf
+
+#include "mock_specific.h"
+
+#define BENCH_SLOT_ID           0
+#define BENCH_SO_PIN            "87654321"
+#define BENCH_USER_PIN          "12345678"
+#define BENCH_NEW_USER_PIN      "23456789"
+#define BENCH_BAD_PIN           "99999999"
+#define BENCH_LOGIN_CACHE_TIME  60
+#define BENCH_DATA_LEN          64
+#define BENCH_CERT_LEN          2048
+#define BENCH_BATCH_LEN         64
+#define BENCH_RSA_BITS          2048
+#define BENCH_FUZZ_MAX_ATTRS    12
+#define BENCH_FUZZ_MAX_LEN      72
+#define BENCH_SECURE_KEY_LEN    64
+#define BENCH_ASYNC_DEPTH       16
+
+CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
+                    SLOT_INFO *sinfp, struct trace_handle_t t);
+CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
+                  struct trace_handle_t *t, CK_BBOOL in_fork_initializer);
+
+/* Loading functions (in usr/lib/api/policy.c) */
+struct policy_private;
+extern void policy_init_policy(struct policy *p);
+extern CK_RV policy_load_strength_cfg(struct policy_private *pp,
+                                      FILE *fp);
+extern CK_RV policy_load_policy_cfg(struct policy_private *pp,
+                                    FILE *fp, CK_BBOOL *restricting);
+extern struct policy_private *policy_private_alloc(void);
+
+struct bench_thread {
+    pthread_t thread;
+    unsigned long id;
+    ST_SESSION_T *sessions;
+    CK_OBJECT_HANDLE *objs;
+    CK_OBJECT_HANDLE key;
+    unsigned int seed;
+    unsigned long ops;
+    unsigned long errors;
+    unsigned long created;
+};
+
+static API_Slot_t slot;
+static STDLL_TokData_t *tokdata;
+static STDLL_FcnList_t *fcn;
+static SLOT_INFO slot_info;
+static struct policy bench_policy;
+static struct statistics bench_statistics;
+static char tmpdir[] = "/tmp/stdllbench.XXXXXX";
+static char shm_name[SM_NAME_LEN + 1];
+static uint32_t tokspec_count;
+
+static unsigned long num_threads = 1;
+static unsigned long num_sessions = 1;
+static unsigned long num_objects = 100;
+static unsigned long num_iterations = 1000;
+static unsigned long digest_size = BENCH_DATA_LEN;
+static unsigned long cert_size = BENCH_CERT_LEN;
+static unsigned long batch_size = BENCH_BATCH_LEN;
+static unsigned long batch_threads;
+static unsigned long async_depth = BENCH_ASYNC_DEPTH;
+static unsigned long async_threads;
+static CK_BBOOL token_objects = FALSE;
+static CK_BBOOL fuzz = FALSE;
+static CK_BBOOL reenc = FALSE;
+static CK_BBOOL logincache = FALSE;
+static unsigned int fuzz_seed;
+static CK_BBOOL keep = FALSE;
+static CK_BBOOL verbose = FALSE;
+static const char *strength_file;
+static const char *policy_file;
+
+/*
+ * Policy, statistics and token specific counters are provided by the API
+ * layer of a real process. Unless a policy is given, the harness uses an
+ * empty policy, which allows everything. Statistics are disabled.
+ */
+static CK_RV bench_store_object_strength(policy_t p, struct objstrength *s,
+                                         get_attr_val_f get_attr_val, void *d,
+                                         free_attr_f free_attr,
+                                         struct _SESSION *session)
+{
+    UNUSED(p);
+    UNUSED(get_attr_val);
+    UNUSED(d);
+    UNUSED(free_attr);
+    UNUSED(session);
+
+    s->strength = POLICY_STRENGTH_IDX_0;
+    s->allowed = CK_TRUE;
+    return CKR_OK;
+}
+
+static CK_RV bench_is_key_allowed(policy_t p, struct objstrength *s,
+                                  struct _SESSION *session)
+{
+    UNUSED(p);
+    UNUSED(s);
+    UNUSED(session);
+
+    return CKR_OK;
+}
+
+static CK_RV bench_is_mech_allowed(policy_t p, CK_MECHANISM_PTR mech,
+                                   struct objstrength *s, int check,
+                                   struct _SESSION *session)
+{
+    UNUSED(p);
+    UNUSED(mech);
+    UNUSED(s);
+    UNUSED(check);
+    UNUSED(session);
+
+    return CKR_OK;
+}
+
+static CK_RV bench_update_mech_info(policy_t p, CK_MECHANISM_TYPE mech,
+                                    CK_MECHANISM_INFO_PTR info)
+{
+    UNUSED(p);
+    UNUSED(mech);
+    UNUSED(info);
+
+    return CKR_OK;
+}
+
+static CK_RV bench_check_token_store(policy_t p, CK_BBOOL newversion,
+                                     CK_MECHANISM_TYPE encalgo,
+                                     CK_SLOT_ID slot,
+                                     struct tokstore_strength *ts)
+{
+    UNUSED(p);
+    UNUSED(newversion);
+    UNUSED(encalgo);
+    UNUSED(slot);
+
+    memset(ts, 0, sizeof(*ts));
+    ts->mk_keygen.mechanism = CKM_AES_KEY_GEN;
+    ts->mk_crypt.mechanism = CKM_AES_GCM;
+    ts->wrap_crypt.mechanism = CKM_AES_GCM;
+    ts->mk_strength = ts->wrap_strength = POLICY_STRENGTH_IDX_0;
+    return CKR_OK;
+}
+
+/*
+ * Loads the strength definition and the policy from the given files, like
+ * policy_load() does it with the installed ones.
+ */
+static CK_RV bench_load_policy(void)
+{
+    struct policy_private *pp;
+    CK_BBOOL restricting = CK_FALSE;
+    FILE *fp;
+    CK_RV rc;
+
+    policy_init_policy(&bench_policy);
+    pp = policy_private_alloc();
+    if (pp == NULL)
+        return CKR_HOST_MEMORY;
+    bench_policy.priv = pp;
+
+    fp = fopen(strength_file, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "fopen(%s): %s\n", strength_file, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    rc = policy_load_strength_cfg(pp, fp);
+    fclose(fp);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "Failed to load %s: 0x%lx\n", strength_file, rc);
+        return rc;
+    }
+
+    fp = fopen(policy_file, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "fopen(%s): %s\n", policy_file, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    rc = policy_load_policy_cfg(pp, fp, &restricting);
+    fclose(fp);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "Failed to load %s: 0x%lx\n", policy_file, rc);
+        return rc;
+    }
+    bench_policy.active = restricting;
+
+    return CKR_OK;
+}
+
+static uint32_t bench_get_tokspec_count(STDLL_TokData_t *tokdata)
+{
+    UNUSED(tokdata);
+
+    return __atomic_load_n(&tokspec_count, __ATOMIC_RELAXED);
+}
+
+static void bench_incr_tokspec_count(STDLL_TokData_t *tokdata)
+{
+    UNUSED(tokdata);
+
+    __atomic_add_fetch(&tokspec_count, 1, __ATOMIC_RELAXED);
+}
+
+static void bench_decr_tokspec_count(STDLL_TokData_t *tokdata)
+{
+    UNUSED(tokdata);
+
+    __atomic_sub_fetch(&tokspec_count, 1, __ATOMIC_RELAXED);
+}
+
+static double elapsed_sec(const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) +
+           (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+                        struct FTW *ftwbuf)
+{
+    UNUSED(sb);
+    UNUSED(flag);
+    UNUSED(ftwbuf);
+
+    return remove(path);
+}
+
+/*
+ * Sets up the token data like the API layer does it, and initializes the
+ * STDLL with the token directory in tmpdir.
+ */
+static CK_RV bench_init(void)
+{
+    char path[PATH_MAX];
+    struct trace_handle_t trace_handle = { .fd = -1, .level = TRACE_LEVEL_NONE };
+    struct group *grp;
+    CK_RV rc;
+
+    if (mkdtemp(tmpdir) == NULL) {
+        fprintf(stderr, "mkdtemp(%s): %s\n", tmpdir, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ock_snprintf(path, sizeof(path), "%s/%s", tmpdir,
+                     MOCK_TOKEN_SUBDIR) != 0 ||
+        mkdir(path, S_IRWXU | S_IRWXG) != 0 ||
+        ock_snprintf(path, sizeof(path), "%s/%s/%s", tmpdir,
+                     MOCK_TOKEN_SUBDIR, PK_LITE_OBJ_DIR) != 0 ||
+        mkdir(path, S_IRWXU | S_IRWXG) != 0) {
+        fprintf(stderr, "mkdir(%s): %s\n", path, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+    setenv("PKCS_APP_STORE", tmpdir, 1);
+
+    grp = getgrgid(getegid());
+    if (grp == NULL) {
+        fprintf(stderr, "getgrgid: %s\n", strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (policy_file != NULL) {
+        rc = bench_load_policy();
+        if (rc != CKR_OK)
+            return rc;
+    } else {
+        bench_policy.store_object_strength = bench_store_object_strength;
+        bench_policy.is_key_allowed = bench_is_key_allowed;
+        bench_policy.is_mech_allowed = bench_is_mech_allowed;
+        bench_policy.update_mech_info = bench_update_mech_info;
+        bench_policy.check_token_store = bench_check_token_store;
+    }
+
+    slot_info.slot_number = BENCH_SLOT_ID;
+    slot_info.present = TRUE;
+    slot_info.version = TOK_NEW_DATA_STORE;
+    slot_info.logincache = logincache ? BENCH_LOGIN_CACHE_TIME : 0;
+    strncpy(slot_info.usergroup, grp->gr_name,
+            sizeof(slot_info.usergroup) - 1);
+
+    tokdata = calloc(1, sizeof(STDLL_TokData_t));
+    if (tokdata == NULL)
+        return CKR_HOST_MEMORY;
+    tokdata->slot_id = BENCH_SLOT_ID;
+    tokdata->real_pid = getpid();
+    tokdata->real_uid = getuid();
+    tokdata->real_gid = getgid();
+    strncpy(tokdata->tokgroup, grp->gr_name, sizeof(tokdata->tokgroup) - 1);
+    tokdata->tokspec_counter.get_tokspec_count = bench_get_tokspec_count;
+    tokdata->tokspec_counter.incr_tokspec_count = bench_incr_tokspec_count;
+    tokdata->tokspec_counter.decr_tokspec_count = bench_decr_tokspec_count;
+    tokdata->global_login_state = CKS_RO_PUBLIC_SESSION;
+    tokdata->spinxplfd = -1;
+    if (pthread_rwlock_init(&tokdata->sess_list_rwlock, NULL) != 0 ||
+        pthread_mutex_init(&tokdata->login_mutex, NULL) != 0 ||
+        pthread_mutex_init(&tokdata->sess_obj_list_mutex, NULL) != 0)
+        return CKR_CANT_LOCK;
+    tokdata->policy = &bench_policy;
+    tokdata->mechtable_funcs = &mechtable_funcs;
+    tokdata->statistics = &bench_statistics;
+    slot.TokData = tokdata;
+
+    rc = ST_Initialize(&slot, BENCH_SLOT_ID, &slot_info, trace_handle);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "ST_Initialize failed: 0x%lx\n", rc);
+        return rc;
+    }
+    fcn = slot.FcnList;
+
+    sm_copy_name(tokdata->global_shm, shm_name, sizeof(shm_name));
+
+    return CKR_OK;
+}
+
+static void bench_final(void)
+{
+    if (fcn != NULL) {
+        SC_Finalize(tokdata, BENCH_SLOT_ID, &slot_info, NULL, FALSE);
+        if (shm_name[0] != '\0')
+            sm_destroy(shm_name);
+    }
+    if (policy_file != NULL)
+        policy_unload(&bench_policy);
+
+    if (keep)
+        printf("Token directory kept in %s\n", tmpdir);
+    else if (strchr(tmpdir, 'X') == NULL)
+        nftw(tmpdir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static CK_RV open_session(ST_SESSION_T *sess)
+{
+    CK_RV rc;
+
+    memset(sess, 0, sizeof(*sess));
+    sess->slotID = BENCH_SLOT_ID;
+    sess->rw_session = TRUE;
+
+    rc = fcn->ST_OpenSession(tokdata, BENCH_SLOT_ID,
+                             CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                             &sess->sessionh);
+    if (rc != CKR_OK)
+        fprintf(stderr, "SC_OpenSession failed: 0x%lx\n", rc);
+
+    return rc;
+}
+
+/*
+ * Initializes the token, sets the user PIN and logs in the user. The
+ * returned session must be kept open, closing it would log out.
+ */
+static CK_RV bench_login(ST_SESSION_T *sess)
+{
+    CK_CHAR label[32];
+    CK_RV rc;
+
+    memset(label, ' ', sizeof(label));
+    memcpy(label, "stdllbench", strlen("stdllbench"));
+
+    rc = fcn->ST_InitToken(tokdata, BENCH_SLOT_ID, (CK_CHAR_PTR)BENCH_SO_PIN,
+                           strlen(BENCH_SO_PIN), label);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "SC_InitToken failed: 0x%lx\n", rc);
+        return rc;
+    }
+
+    rc = open_session(sess);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = fcn->ST_Login(tokdata, sess, CKU_SO, (CK_CHAR_PTR)BENCH_SO_PIN,
+                       strlen(BENCH_SO_PIN));
+    if (rc == CKR_OK)
+        rc = fcn->ST_InitPIN(tokdata, sess, (CK_CHAR_PTR)BENCH_USER_PIN,
+                             strlen(BENCH_USER_PIN));
+    if (rc == CKR_OK)
+        rc = fcn->ST_Logout(tokdata, sess);
+    if (rc == CKR_OK)
+        rc = fcn->ST_Login(tokdata, sess, CKU_USER,
+                           (CK_CHAR_PTR)BENCH_USER_PIN,
+                           strlen(BENCH_USER_PIN));
+    if (rc != CKR_OK)
+        fprintf(stderr, "Login failed: 0x%lx\n", rc);
+
+    return rc;
+}
+
+static ST_SESSION_T *thread_session(struct bench_thread *t, unsigned long i)
+{
+    return &t->sessions[i % num_sessions];
+}
+
+static void make_label(char *buf, size_t len, unsigned long thread,
+                       unsigned long obj)
+{
+    snprintf(buf, len, "bench-%lu-%lu", thread, obj);
+}
+
+static void *phase_create(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_BBOOL token = token_objects;
+    CK_BYTE value[BENCH_DATA_LEN];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_TOKEN, &token, sizeof(token)},
+        {CKA_LABEL, label, 0},
+        {CKA_APPLICATION, "stdllbench", strlen("stdllbench")},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+    unsigned long i;
+
+    memset(value, 0x5a, sizeof(value));
+
+    for (i = 0; i < num_objects; i++) {
+        make_label(label, sizeof(label), t->id, i);
+        tmpl[2].ulValueLen = strlen(label);
+        if (fcn->ST_CreateObject(tokdata, thread_session(t, i), tmpl,
+                                 sizeof(tmpl) / sizeof(CK_ATTRIBUTE),
+                                 &t->objs[i]) != CKR_OK) {
+            t->objs[i] = CK_INVALID_HANDLE;
+            t->errors++;
+        }
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Creates token AES keys with a (mock) secure key in CKA_IBM_OPAQUE, for the
+ * re-encipher mode. Every other key is public, both token object trees are
+ * re-enciphered, and MAX_TOK_OBJS applies to each of them.
+ */
+static void *phase_create_keys(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_OBJECT_CLASS class = CKO_SECRET_KEY;
+    CK_KEY_TYPE key_type = CKK_AES;
+    CK_BBOOL true = TRUE, private;
+    CK_BYTE value[16], sec_key[BENCH_SECURE_KEY_LEN];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_KEY_TYPE, &key_type, sizeof(key_type)},
+        {CKA_TOKEN, &true, sizeof(true)},
+        {CKA_PRIVATE, &private, sizeof(private)},
+        {CKA_LABEL, label, 0},
+        {CKA_VALUE, value, sizeof(value)},
+        {CKA_IBM_OPAQUE, sec_key, sizeof(sec_key)},
+    };
+    unsigned long i, j;
+
+    memset(value, 0x5a, sizeof(value));
+
+    for (i = 0; i < num_objects; i++) {
+        private = (i % 2 == 0);
+        make_label(label, sizeof(label), t->id, i);
+        tmpl[4].ulValueLen = strlen(label);
+        for (j = 0; j < sizeof(sec_key); j++)
+            sec_key[j] = rand_r(&t->seed);
+        if (fcn->ST_CreateObject(tokdata, thread_session(t, i), tmpl,
+                                 sizeof(tmpl) / sizeof(CK_ATTRIBUTE),
+                                 &t->objs[i]) != CKR_OK) {
+            t->objs[i] = CK_INVALID_HANDLE;
+            t->errors++;
+        }
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+static void *phase_find(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_OBJECT_HANDLE handles[2];
+    CK_ULONG count;
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_LABEL, label, 0},
+    };
+    ST_SESSION_T *sess;
+    unsigned long i, obj;
+
+    for (i = 0; i < num_iterations; i++) {
+        obj = rand_r(&t->seed) % num_objects;
+        make_label(label, sizeof(label), t->id, obj);
+        tmpl[0].ulValueLen = strlen(label);
+        sess = thread_session(t, i);
+
+        if (fcn->ST_FindObjectsInit(tokdata, sess, tmpl, 1) != CKR_OK) {
+            t->errors++;
+            continue;
+        }
+        if (fcn->ST_FindObjects(tokdata, sess, handles, 2, &count) != CKR_OK ||
+            count != 1 || handles[0] != t->objs[obj])
+            t->errors++;
+        fcn->ST_FindObjectsFinal(tokdata, sess);
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+static void *phase_getattr(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_BYTE value[BENCH_DATA_LEN];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_LABEL, label, sizeof(label)},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+    unsigned long i, obj;
+
+    for (i = 0; i < num_iterations; i++) {
+        obj = rand_r(&t->seed) % num_objects;
+        tmpl[0].ulValueLen = sizeof(label);
+        tmpl[1].ulValueLen = sizeof(value);
+        if (fcn->ST_GetAttributeValue(tokdata, thread_session(t, i),
+                                      t->objs[obj], tmpl, 2) != CKR_OK)
+            t->errors++;
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Certificate attributes fetched by the certattr phase, all of them are
+ * set or defaulted for X.509 certificates.
+ */
+static const CK_ATTRIBUTE_TYPE cert_attr_types[] = {
+    CKA_CLASS, CKA_TOKEN, CKA_PRIVATE, CKA_MODIFIABLE, CKA_LABEL,
+    CKA_COPYABLE, CKA_DESTROYABLE, CKA_CERTIFICATE_TYPE, CKA_TRUSTED,
+    CKA_CERTIFICATE_CATEGORY, CKA_CHECK_VALUE, CKA_START_DATE, CKA_END_DATE,
+    CKA_PUBLIC_KEY_INFO, CKA_SUBJECT, CKA_ID, CKA_ISSUER, CKA_SERIAL_NUMBER,
+    CKA_VALUE, CKA_URL, CKA_HASH_OF_SUBJECT_PUBLIC_KEY,
+    CKA_HASH_OF_ISSUER_PUBLIC_KEY, CKA_JAVA_MIDP_SECURITY_DOMAIN,
+    CKA_NAME_HASH_ALGORITHM,
+};
+
+#define NUM_CERT_ATTRS  (sizeof(cert_attr_types) / sizeof(CK_ATTRIBUTE_TYPE))
+
+static void *phase_certattr(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_OBJECT_CLASS class = CKO_CERTIFICATE;
+    CK_CERTIFICATE_TYPE cert_type = CKC_X_509;
+    CK_BBOOL token = token_objects;
+    CK_BYTE subject[64], id[20], serial[16];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_CERTIFICATE_TYPE, &cert_type, sizeof(cert_type)},
+        {CKA_TOKEN, &token, sizeof(token)},
+        {CKA_LABEL, label, 0},
+        {CKA_SUBJECT, subject, sizeof(subject)},
+        {CKA_ISSUER, subject, sizeof(subject)},
+        {CKA_ID, id, sizeof(id)},
+        {CKA_SERIAL_NUMBER, serial, sizeof(serial)},
+        {CKA_VALUE, NULL, cert_size},
+    };
+    CK_ATTRIBUTE attrs[NUM_CERT_ATTRS];
+    CK_OBJECT_HANDLE *certs = NULL;
+    CK_BYTE *value = NULL, *buf = NULL;
+    unsigned long i, j, obj;
+
+    memset(subject, 0x30, sizeof(subject));
+    memset(id, 0x11, sizeof(id));
+    memset(serial, 0x02, sizeof(serial));
+
+    /* Every attribute gets a buffer large enough for the certificate */
+    certs = calloc(num_objects, sizeof(CK_OBJECT_HANDLE));
+    value = malloc(cert_size);
+    buf = malloc(NUM_CERT_ATTRS * cert_size);
+    if (certs == NULL || value == NULL || buf == NULL) {
+        t->errors++;
+        goto out;
+    }
+    memset(value, 0x30, cert_size);
+    tmpl[8].pValue = value;
+
+    for (obj = 0; obj < num_objects; obj++) {
+        make_label(label, sizeof(label), t->id, obj);
+        tmpl[3].ulValueLen = strlen(label);
+        if (fcn->ST_CreateObject(tokdata, thread_session(t, obj), tmpl,
+                                 sizeof(tmpl) / sizeof(CK_ATTRIBUTE),
+                                 &certs[obj]) != CKR_OK) {
+            certs[obj] = CK_INVALID_HANDLE;
+            t->errors++;
+        }
+    }
+
+    /* Each iteration fetches all certificates, like listing a store */
+    for (i = 0; i < num_iterations; i++) {
+        for (obj = 0; obj < num_objects; obj++) {
+            for (j = 0; j < NUM_CERT_ATTRS; j++) {
+                attrs[j].type = cert_attr_types[j];
+                attrs[j].pValue = buf + j * cert_size;
+                attrs[j].ulValueLen = cert_size;
+            }
+            if (fcn->ST_GetAttributeValue(tokdata, thread_session(t, obj),
+                                          certs[obj], attrs,
+                                          NUM_CERT_ATTRS) != CKR_OK)
+                t->errors++;
+            t->ops++;
+        }
+    }
+
+    for (obj = 0; obj < num_objects; obj++) {
+        if (certs[obj] == CK_INVALID_HANDLE)
+            continue;
+        if (fcn->ST_DestroyObject(tokdata, thread_session(t, obj),
+                                  certs[obj]) != CKR_OK)
+            t->errors++;
+    }
+
+out:
+    free(certs);
+    free(value);
+    free(buf);
+
+    return NULL;
+}
+
+static void *phase_encrypt(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_BYTE iv[AES_BLOCK_SIZE] = { 0 };
+    CK_MECHANISM mech = { CKM_AES_CBC, iv, sizeof(iv) };
+    CK_MECHANISM keygen_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_ULONG key_len = 32;
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE key_tmpl[] = {
+        {CKA_VALUE_LEN, &key_len, sizeof(key_len)},
+        {CKA_ENCRYPT, &true, sizeof(true)},
+    };
+    CK_BYTE data[BENCH_DATA_LEN], enc[BENCH_DATA_LEN];
+    CK_ULONG enc_len;
+    ST_SESSION_T *sess;
+    unsigned long i;
+
+    memset(data, 0xa5, sizeof(data));
+
+    if (fcn->ST_GenerateKey(tokdata, thread_session(t, 0), &keygen_mech,
+                            key_tmpl, 2, &t->key) != CKR_OK) {
+        t->errors++;
+        return NULL;
+    }
+
+    for (i = 0; i < num_iterations; i++) {
+        sess = thread_session(t, i);
+        enc_len = sizeof(enc);
+        if (fcn->ST_EncryptInit(tokdata, sess, &mech, t->key) != CKR_OK ||
+            fcn->ST_Encrypt(tokdata, sess, data, sizeof(data),
+                            enc, &enc_len) != CKR_OK)
+            t->errors++;
+        t->ops++;
+    }
+
+    if (fcn->ST_DestroyObject(tokdata, thread_session(t, 0),
+                              t->key) != CKR_OK)
+        t->errors++;
+
+    return NULL;
+}
+
+static void *phase_digest(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_MECHANISM mech = { CKM_SHA256, NULL, 0 };
+    CK_BYTE *data, hash[SHA256_HASH_SIZE];
+    CK_ULONG hash_len;
+    ST_SESSION_T *sess;
+    unsigned long i;
+
+    data = malloc(digest_size);
+    if (data == NULL) {
+        t->errors++;
+        return NULL;
+    }
+    memset(data, 0x3c, digest_size);
+
+    for (i = 0; i < num_iterations; i++) {
+        sess = thread_session(t, i);
+        hash_len = sizeof(hash);
+        if (fcn->ST_DigestInit(tokdata, sess, &mech) != CKR_OK ||
+            fcn->ST_Digest(tokdata, sess, data, digest_size,
+                           hash, &hash_len) != CKR_OK)
+            t->errors++;
+        t->ops++;
+    }
+
+    free(data);
+
+    return NULL;
+}
+
+/*
+ * Signs num_iterations messages in batches of batch_size, and verifies all
+ * signatures one by one afterwards. Only the signatures are counted.
+ */
+static void *phase_signbatch(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_MECHANISM keygen_mech = { CKM_RSA_PKCS_KEY_PAIR_GEN, NULL, 0 };
+    CK_MECHANISM mech = { CKM_SHA256_RSA_PKCS, NULL, 0 };
+    CK_ULONG mod_bits = BENCH_RSA_BITS;
+    CK_BYTE publ_exp[] = { 0x01, 0x00, 0x01 };
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_MODULUS_BITS, &mod_bits, sizeof(mod_bits)},
+        {CKA_PUBLIC_EXPONENT, publ_exp, sizeof(publ_exp)},
+        {CKA_VERIFY, &true, sizeof(true)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_OBJECT_HANDLE publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_IBM_BATCH_ITEM *items = NULL;
+    CK_BYTE *data = NULL, *sigs = NULL;
+    ST_SESSION_T *sess = thread_session(t, 0);
+    unsigned long i, j, count;
+
+    items = calloc(batch_size, sizeof(*items));
+    data = malloc(batch_size * BENCH_DATA_LEN);
+    sigs = malloc(batch_size * BENCH_RSA_BITS / 8);
+    if (items == NULL || data == NULL || sigs == NULL) {
+        t->errors++;
+        goto out;
+    }
+
+    if (fcn->ST_GenerateKeyPair(tokdata, sess, &keygen_mech, publ_tmpl,
+                                sizeof(publ_tmpl) / sizeof(CK_ATTRIBUTE),
+                                priv_tmpl,
+                                sizeof(priv_tmpl) / sizeof(CK_ATTRIBUTE),
+                                &publ_key, &priv_key) != CKR_OK) {
+        t->errors++;
+        goto out;
+    }
+
+    for (i = 0; i < num_iterations; i += count) {
+        count = num_iterations - i;
+        if (count > batch_size)
+            count = batch_size;
+
+        for (j = 0; j < count; j++) {
+            items[j].pData = data + j * BENCH_DATA_LEN;
+            items[j].ulDataLen = BENCH_DATA_LEN;
+            items[j].pResult = sigs + j * BENCH_RSA_BITS / 8;
+            items[j].ulResultLen = BENCH_RSA_BITS / 8;
+            memset(items[j].pData, 0, BENCH_DATA_LEN);
+            snprintf((char *)items[j].pData, BENCH_DATA_LEN, "%lu-%lu",
+                     t->id, i + j);
+        }
+
+        if (fcn->ST_IBM_SignBatch(tokdata, sess, &mech, priv_key,
+                                  items, count) != CKR_OK) {
+            t->errors++;
+            continue;
+        }
+        t->ops += count;
+
+        for (j = 0; j < count; j++) {
+            if (fcn->ST_VerifyInit(tokdata, sess, &mech, publ_key) != CKR_OK ||
+                fcn->ST_Verify(tokdata, sess, items[j].pData,
+                               items[j].ulDataLen, items[j].pResult,
+                               items[j].ulResultLen) != CKR_OK)
+                t->errors++;
+        }
+    }
+
+out:
+    if (publ_key != CK_INVALID_HANDLE &&
+        fcn->ST_DestroyObject(tokdata, sess, publ_key) != CKR_OK)
+        t->errors++;
+    if (priv_key != CK_INVALID_HANDLE &&
+        fcn->ST_DestroyObject(tokdata, sess, priv_key) != CKR_OK)
+        t->errors++;
+    free(items);
+    free(data);
+    free(sigs);
+
+    return NULL;
+}
+
+/*
+ * An outstanding request of the async phase. The completion callback runs
+ * in a worker thread of the token's async executor.
+ */
+struct bench_async_slot {
+    struct bench_async *async;
+    CK_IBM_ASYNC_REQUEST request;
+    CK_IBM_BATCH_ITEM item;
+    CK_BYTE enc[BENCH_DATA_LEN];
+    CK_BBOOL busy;
+    CK_BBOOL done;
+};
+
+struct bench_async {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct bench_async_slot *slots;
+    unsigned long finished;
+};
+
+static void bench_async_completion(CK_IBM_ASYNC_REQUEST_PTR request,
+                                   void *context)
+{
+    struct bench_async_slot *slot = context;
+
+    UNUSED(request);
+
+    pthread_mutex_lock(&slot->async->mutex);
+    slot->done = TRUE;
+    slot->async->finished++;
+    pthread_cond_broadcast(&slot->async->cond);
+    pthread_mutex_unlock(&slot->async->mutex);
+}
+
+/*
+ * Encrypts num_iterations messages with single element async requests,
+ * keeping up to async_depth requests outstanding, and compares every result
+ * with the ciphertext of a synchronous encryption.
+ */
+static void *phase_async(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_MECHANISM mech = { CKM_AES_ECB, NULL, 0 };
+    CK_MECHANISM keygen_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_ULONG key_len = 32;
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE key_tmpl[] = {
+        {CKA_VALUE_LEN, &key_len, sizeof(key_len)},
+        {CKA_ENCRYPT, &true, sizeof(true)},
+    };
+    CK_BYTE data[BENCH_DATA_LEN], enc[BENCH_DATA_LEN];
+    CK_ULONG enc_len = sizeof(enc);
+    ST_SESSION_T *sess = thread_session(t, 0);
+    struct bench_async async;
+    struct bench_async_slot *slot;
+    unsigned long submitted = 0, completed = 0, outstanding = 0, i;
+
+    memset(data, 0x5a, sizeof(data));
+    memset(&async, 0, sizeof(async));
+    pthread_mutex_init(&async.mutex, NULL);
+    pthread_cond_init(&async.cond, NULL);
+
+    async.slots = calloc(async_depth, sizeof(*async.slots));
+    if (async.slots == NULL) {
+        t->errors++;
+        goto out;
+    }
+
+    if (fcn->ST_GenerateKey(tokdata, sess, &keygen_mech, key_tmpl, 2,
+                            &t->key) != CKR_OK) {
+        t->errors++;
+        goto out;
+    }
+    if (fcn->ST_EncryptInit(tokdata, sess, &mech, t->key) != CKR_OK ||
+        fcn->ST_Encrypt(tokdata, sess, data, sizeof(data),
+                        enc, &enc_len) != CKR_OK) {
+        t->errors++;
+        goto destroy;
+    }
+
+    pthread_mutex_lock(&async.mutex);
+    while (completed < num_iterations) {
+        for (i = 0; i < async_depth; i++) {
+            slot = &async.slots[i];
+            if (slot->busy && slot->done) {
+                if (slot->request.rv != CKR_OK ||
+                    slot->item.rv != CKR_OK ||
+                    slot->item.ulResultLen != enc_len ||
+                    memcmp(slot->enc, enc, enc_len) != 0)
+                    t->errors++;
+                t->ops++;
+                slot->busy = FALSE;
+                async.finished--;
+                completed++;
+                outstanding--;
+            }
+            if (!slot->busy && submitted < num_iterations) {
+                slot->async = &async;
+                slot->item.pData = data;
+                slot->item.ulDataLen = sizeof(data);
+                slot->item.pResult = slot->enc;
+                slot->item.ulResultLen = sizeof(slot->enc);
+                slot->request.operation = CK_IBM_ASYNC_ENCRYPT;
+                slot->request.pMechanism = &mech;
+                slot->request.hKey = t->key;
+                slot->request.pItems = &slot->item;
+                slot->request.ulCount = 1;
+                slot->busy = TRUE;
+                slot->done = FALSE;
+                submitted++;
+                outstanding++;
+
+                /* The completion may run before the submit returns */
+                pthread_mutex_unlock(&async.mutex);
+                if (fcn->ST_IBM_AsyncSubmit(tokdata, sess, &slot->request,
+                                            bench_async_completion,
+                                            slot) != CKR_OK) {
+                    pthread_mutex_lock(&async.mutex);
+                    t->errors++;
+                    slot->busy = FALSE;
+                    completed++;
+                    outstanding--;
+                    continue;
+                }
+                pthread_mutex_lock(&async.mutex);
+            }
+        }
+        if (async.finished == 0 && outstanding > 0 &&
+            (outstanding == async_depth || submitted == num_iterations))
+            pthread_cond_wait(&async.cond, &async.mutex);
+    }
+    pthread_mutex_unlock(&async.mutex);
+
+destroy:
+    if (fcn->ST_DestroyObject(tokdata, sess, t->key) != CKR_OK)
+        t->errors++;
+out:
+    free(async.slots);
+    pthread_cond_destroy(&async.cond);
+    pthread_mutex_destroy(&async.mutex);
+
+    return NULL;
+}
+
+static void *phase_destroy(void *arg)
+{
+    struct bench_thread *t = arg;
+    unsigned long i;
+
+    for (i = 0; i < num_objects; i++) {
+        if (t->objs[i] == CK_INVALID_HANDLE)
+            continue;
+        if (fcn->ST_DestroyObject(tokdata, thread_session(t, i),
+                                  t->objs[i]) != CKR_OK)
+            t->errors++;
+        t->ops++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Attribute types used by the fuzzer: common, storage, data, key and
+ * certificate attributes, and some that are invalid for every object.
+ */
+static const CK_ATTRIBUTE_TYPE fuzz_attr_types[] = {
+    CKA_CLASS, CKA_TOKEN, CKA_PRIVATE, CKA_LABEL, CKA_APPLICATION,
+    CKA_VALUE, CKA_OBJECT_ID, CKA_MODIFIABLE, CKA_COPYABLE, CKA_DESTROYABLE,
+    CKA_KEY_TYPE, CKA_ID, CKA_VALUE_LEN, CKA_ENCRYPT, CKA_DECRYPT,
+    CKA_SIGN, CKA_SENSITIVE, CKA_EXTRACTABLE, CKA_CERTIFICATE_TYPE,
+    CKA_SUBJECT, CKA_ISSUER, CKA_SERIAL_NUMBER, CKA_START_DATE,
+    CKA_END_DATE, CKA_IBM_PROTKEY_EXTRACTABLE, CKA_VENDOR_DEFINED | 0x1234,
+    0x7fffffff,
+};
+
+static const CK_ULONG fuzz_ulong_values[] = {
+    CKO_DATA, CKO_SECRET_KEY, CKO_CERTIFICATE, CKO_PROFILE, CKK_AES,
+    CKK_GENERIC_SECRET, CKC_X_509, 16, 32, 0, (CK_ULONG)-1,
+};
+
+static void fuzz_fill_attr(struct bench_thread *t, CK_ATTRIBUTE *attr,
+                           CK_BYTE *buf)
+{
+    CK_ULONG i, ulong_value;
+
+    attr->type = fuzz_attr_types[rand_r(&t->seed) %
+                                 (sizeof(fuzz_attr_types) /
+                                  sizeof(CK_ATTRIBUTE_TYPE))];
+    attr->pValue = buf;
+
+    switch (rand_r(&t->seed) % 4) {
+    case 0:
+        /* CK_ULONG sized value, mostly meaningful */
+        ulong_value = fuzz_ulong_values[rand_r(&t->seed) %
+                                        (sizeof(fuzz_ulong_values) /
+                                         sizeof(CK_ULONG))];
+        memcpy(buf, &ulong_value, sizeof(ulong_value));
+        attr->ulValueLen = sizeof(ulong_value);
+        break;
+    case 1:
+        /* CK_BBOOL sized value */
+        buf[0] = rand_r(&t->seed) % 3;
+        attr->ulValueLen = sizeof(CK_BBOOL);
+        break;
+    case 2:
+        attr->pValue = NULL;
+        attr->ulValueLen = 0;
+        break;
+    default:
+        attr->ulValueLen = rand_r(&t->seed) % BENCH_FUZZ_MAX_LEN;
+        for (i = 0; i < attr->ulValueLen; i++)
+            buf[i] = rand_r(&t->seed);
+        break;
+    }
+}
+
+static void fuzz_fill_template(struct bench_thread *t, CK_ATTRIBUTE *tmpl,
+                               CK_ULONG *count,
+                               CK_BYTE bufs[][BENCH_FUZZ_MAX_LEN])
+{
+    CK_ULONG i;
+
+    *count = rand_r(&t->seed) % (BENCH_FUZZ_MAX_ATTRS + 1);
+    for (i = 0; i < *count; i++)
+        fuzz_fill_attr(t, &tmpl[i], bufs[i]);
+}
+
+/*
+ * Most create templates get a valid class, otherwise hardly any object
+ * would be created.
+ */
+static void fuzz_fill_create_template(struct bench_thread *t,
+                                      CK_ATTRIBUTE *tmpl, CK_ULONG *count,
+                                      CK_BYTE bufs[][BENCH_FUZZ_MAX_LEN])
+{
+    static const CK_OBJECT_CLASS classes[] = {
+        CKO_DATA, CKO_SECRET_KEY, CKO_CERTIFICATE,
+    };
+    CK_OBJECT_CLASS class;
+
+    fuzz_fill_template(t, tmpl, count, bufs);
+    if (rand_r(&t->seed) % 4 == 0)
+        return;
+
+    if (*count == 0)
+        *count = 1;
+    class = classes[rand_r(&t->seed) % (sizeof(classes) / sizeof(classes[0]))];
+    memcpy(bufs[0], &class, sizeof(class));
+    tmpl[0].type = CKA_CLASS;
+    tmpl[0].pValue = bufs[0];
+    tmpl[0].ulValueLen = sizeof(class);
+}
+
+static void *phase_fuzz(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_ATTRIBUTE tmpl[BENCH_FUZZ_MAX_ATTRS];
+    CK_BYTE bufs[BENCH_FUZZ_MAX_ATTRS][BENCH_FUZZ_MAX_LEN];
+    CK_OBJECT_HANDLE obj, copy;
+    CK_ULONG count, i;
+    ST_SESSION_T *sess;
+    unsigned long n;
+    CK_RV rc;
+
+    for (n = 0; n < num_iterations; n++) {
+        sess = thread_session(t, n);
+
+        fuzz_fill_create_template(t, tmpl, &count, bufs);
+        t->ops++;
+        if (fcn->ST_CreateObject(tokdata, sess, tmpl, count, &obj) != CKR_OK)
+            continue;
+        t->created++;
+
+        fuzz_fill_template(t, tmpl, &count, bufs);
+        if (fcn->ST_CopyObject(tokdata, sess, obj, tmpl, count,
+                               &copy) == CKR_OK)
+            fcn->ST_DestroyObject(tokdata, sess, copy);
+
+        fuzz_fill_template(t, tmpl, &count, bufs);
+        fcn->ST_SetAttributeValue(tokdata, sess, obj, tmpl, count);
+
+        /* Query the lengths first, then read into too small buffers */
+        fuzz_fill_template(t, tmpl, &count, bufs);
+        for (i = 0; i < count; i++) {
+            tmpl[i].pValue = NULL;
+            tmpl[i].ulValueLen = 0;
+        }
+        fcn->ST_GetAttributeValue(tokdata, sess, obj, tmpl, count);
+        for (i = 0; i < count; i++) {
+            tmpl[i].pValue = bufs[i];
+            tmpl[i].ulValueLen = rand_r(&t->seed) % BENCH_FUZZ_MAX_LEN;
+        }
+        fcn->ST_GetAttributeValue(tokdata, sess, obj, tmpl, count);
+
+        /* The object may have become non-destroyable */
+        rc = fcn->ST_DestroyObject(tokdata, sess, obj);
+        if (rc != CKR_OK && rc != CKR_ACTION_PROHIBITED) {
+            fprintf(stderr, "SC_DestroyObject failed: 0x%lx\n", rc);
+            t->errors++;
+        }
+    }
+
+    return NULL;
+}
+
+static int run_phase(const char *name, void *(*fn)(void *),
+                     struct bench_thread *threads)
+{
+    struct timespec start;
+    unsigned long i, ops = 0, errors = 0, created = 0, cipher_calls;
+    double secs;
+
+    cipher_calls = mock_get_calls(MOCK_OP_CIPHER);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_threads; i++) {
+        threads[i].ops = 0;
+        threads[i].errors = 0;
+        threads[i].created = 0;
+        if (pthread_create(&threads[i].thread, NULL, fn, &threads[i]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        ops += threads[i].ops;
+        errors += threads[i].errors;
+        created += threads[i].created;
+    }
+
+    secs = elapsed_sec(&start);
+    printf("%-10s %10lu ops %10.3f s %12.0f ops/s %10.2f us/op %6lu errors\n",
+           name, ops, secs, secs > 0 ? ops / secs : 0,
+           ops > 0 ? secs * 1e6 * num_threads / ops : 0, errors);
+    if (fn == phase_fuzz)
+        printf("%-10s %10lu objects created\n", "", created);
+    /* The average number of mock cipher operations running concurrently */
+    if (fn == phase_async && secs > 0)
+        printf("%-10s %10.1f cipher operations in flight\n", "",
+               (mock_get_calls(MOCK_OP_CIPHER) - cipher_calls) *
+               mock_get_latency(MOCK_OP_CIPHER) / 1e6 / secs);
+
+    return errors > 0 ? -1 : 0;
+}
+
+struct bench_reenc {
+    const char *op_id;          /* MK change operation ID */
+    unsigned long calls;        /* callback calls */
+    unsigned long fail_at;      /* callback call that fails, 0 for none */
+    CK_ULONG done;              /* last progress reported */
+    CK_ULONG total;
+};
+
+static CK_RV bench_reenc_cb(STDLL_TokData_t *tokdata, OBJECT *obj,
+                            void *cb_data)
+{
+    struct bench_reenc *r = cb_data;
+
+    if (__atomic_add_fetch(&r->calls, 1, __ATOMIC_RELAXED) == r->fail_at)
+        return CKR_DEVICE_ERROR;
+
+    return obj_mgr_reencipher_secure_key(tokdata, obj, r->op_id,
+                                         mock_reencipher_key, NULL);
+}
+
+static void bench_reenc_progress(STDLL_TokData_t *tokdata, CK_ULONG done,
+                                 CK_ULONG total, void *cb_data)
+{
+    struct bench_reenc *r = cb_data;
+
+    UNUSED(tokdata);
+
+    r->done = done;
+    r->total = total;
+}
+
+/*
+ * Checks the keys after a re-encipher run: a key that has a re-enciphered
+ * secure key must have been saved exactly once since the keys were created,
+ * all others not at all. Returns the number of re-enciphered keys.
+ */
+static unsigned long bench_reenc_check(struct bench_thread *threads,
+                                       const CK_ULONG *save_counts,
+                                       unsigned long *errors)
+{
+    CK_ATTRIBUTE *opaque, *reenc_attr;
+    unsigned long i, j, k, num_reenc = 0, saves;
+    CK_BBOOL done;
+    OBJECT *obj;
+
+    for (i = 0; i < num_threads; i++) {
+        for (j = 0; j < num_objects; j++) {
+            if (threads[i].objs[j] == CK_INVALID_HANDLE)
+                continue;
+            if (object_mgr_find_in_map1(tokdata, threads[i].objs[j], &obj,
+                                        READ_LOCK) != CKR_OK) {
+                (*errors)++;
+                continue;
+            }
+
+            done = template_attribute_find(obj->template,
+                                           CKA_IBM_OPAQUE_REENC, &reenc_attr);
+            if (done) {
+                num_reenc++;
+                if (!template_attribute_find(obj->template, CKA_IBM_OPAQUE,
+                                             &opaque) ||
+                    opaque->ulValueLen != reenc_attr->ulValueLen) {
+                    (*errors)++;
+                } else {
+                    for (k = 0; k < opaque->ulValueLen; k++) {
+                        if ((((CK_BYTE *)reenc_attr->pValue)[k] ^
+                             ((CK_BYTE *)opaque->pValue)[k]) != 0xff) {
+                            (*errors)++;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            saves = obj->count_lo - save_counts[i * num_objects + j];
+            if (saves != (done ? 1 : 0)) {
+                fprintf(stderr, "Key %s saved %lu times\n", obj->name, saves);
+                (*errors)++;
+            }
+
+            object_put(tokdata, obj, TRUE);
+        }
+    }
+
+    return num_reenc;
+}
+
+static CK_RV bench_reenc_run(const char *name, struct bench_reenc *r)
+{
+    struct timespec start;
+    unsigned long reenc_calls;
+    double secs;
+    CK_RV rc;
+
+    reenc_calls = mock_get_calls(MOCK_OP_REENC);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    rc = obj_mgr_iterate_key_objects(tokdata, FALSE, TRUE, NULL, NULL,
+                                     bench_reenc_cb, r, bench_reenc_progress,
+                                     FALSE, "re-encipher");
+
+    secs = elapsed_sec(&start);
+    reenc_calls = mock_get_calls(MOCK_OP_REENC) - reenc_calls;
+    printf("%-10s %10lu ops %10.3f s %12.0f ops/s %10.2f us/op rc=0x%lx\n",
+           name, reenc_calls, secs, secs > 0 ? reenc_calls / secs : 0,
+           reenc_calls > 0 ?
+                secs * 1e6 * tokdata->hsm_mk_change_threads / reenc_calls : 0,
+           rc);
+
+    return rc;
+}
+
+/* Stores the save counters of the keys, returns the number of keys */
+static unsigned long bench_reenc_save_counts(struct bench_thread *threads,
+                                             CK_ULONG *save_counts,
+                                             unsigned long *errors)
+{
+    unsigned long i, j, total = 0;
+    OBJECT *obj;
+
+    for (i = 0; i < num_threads; i++) {
+        for (j = 0; j < num_objects; j++) {
+            if (threads[i].objs[j] == CK_INVALID_HANDLE)
+                continue;
+            if (object_mgr_find_in_map1(tokdata, threads[i].objs[j], &obj,
+                                        READ_LOCK) != CKR_OK) {
+                (*errors)++;
+                continue;
+            }
+            save_counts[i * num_objects + j] = obj->count_lo;
+            object_put(tokdata, obj, TRUE);
+            total++;
+        }
+    }
+
+    return total;
+}
+
+/*
+ * Re-enciphers the keys created by phase_create_keys(). The first run fails
+ * on the callback call after a third of the keys, the other threads must
+ * stop after their current key. The second run must only re-encipher the
+ * remaining keys, since the keys re-enciphered by the first run have been
+ * saved with CKA_IBM_OPAQUE_REENC and the operation ID. A third run for
+ * another operation, as after an aborted one, must re-encipher all keys.
+ */
+static int bench_reenc(struct bench_thread *threads)
+{
+    struct bench_reenc r;
+    CK_ULONG *save_counts;
+    unsigned long total, errors = 0, reenc_calls, num_reenc;
+    CK_RV rc;
+
+    save_counts = calloc(num_threads * num_objects, sizeof(CK_ULONG));
+    if (save_counts == NULL)
+        return -1;
+
+    total = bench_reenc_save_counts(threads, save_counts, &errors);
+
+    tokdata->hsm_mk_change_threads = num_threads;
+
+    memset(&r, 0, sizeof(r));
+    r.op_id = "bench1";
+    r.fail_at = total / 3 + 1;
+    reenc_calls = mock_get_calls(MOCK_OP_REENC);
+    rc = bench_reenc_run("reenc-err", &r);
+    if (rc != CKR_DEVICE_ERROR) {
+        fprintf(stderr, "Injected error not returned: 0x%lx\n", rc);
+        errors++;
+    }
+    /* Each thread finishes at most its current key and one more */
+    if (r.calls > r.fail_at + 2 * num_threads) {
+        fprintf(stderr, "%lu keys processed after the error\n",
+                r.calls - r.fail_at);
+        errors++;
+    }
+    num_reenc = bench_reenc_check(threads, save_counts, &errors);
+    if (num_reenc != mock_get_calls(MOCK_OP_REENC) - reenc_calls) {
+        fprintf(stderr, "%lu of %lu re-enciphered keys were not kept\n",
+                mock_get_calls(MOCK_OP_REENC) - reenc_calls - num_reenc,
+                mock_get_calls(MOCK_OP_REENC) - reenc_calls);
+        errors++;
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.op_id = "bench1";
+    reenc_calls = mock_get_calls(MOCK_OP_REENC);
+    rc = bench_reenc_run("reenc", &r);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "obj_mgr_iterate_key_objects failed: 0x%lx\n", rc);
+        errors++;
+    }
+    if (mock_get_calls(MOCK_OP_REENC) - reenc_calls != total - num_reenc) {
+        fprintf(stderr, "%lu keys re-enciphered, expected %lu\n",
+                mock_get_calls(MOCK_OP_REENC) - reenc_calls,
+                total - num_reenc);
+        errors++;
+    }
+    if (r.done != total || r.total != total) {
+        fprintf(stderr, "Progress %lu of %lu, expected %lu\n", r.done,
+                r.total, total);
+        errors++;
+    }
+    if (bench_reenc_check(threads, save_counts, &errors) != total)
+        errors++;
+
+    bench_reenc_save_counts(threads, save_counts, &errors);
+    memset(&r, 0, sizeof(r));
+    r.op_id = "bench2";
+    reenc_calls = mock_get_calls(MOCK_OP_REENC);
+    rc = bench_reenc_run("reenc-new", &r);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "obj_mgr_iterate_key_objects failed: 0x%lx\n", rc);
+        errors++;
+    }
+    if (mock_get_calls(MOCK_OP_REENC) - reenc_calls != total) {
+        fprintf(stderr, "%lu keys re-enciphered for a new operation, "
+                "expected %lu\n", mock_get_calls(MOCK_OP_REENC) - reenc_calls,
+                total);
+        errors++;
+    }
+    if (bench_reenc_check(threads, save_counts, &errors) != total)
+        errors++;
+
+    printf("%-10s %10lu keys %10lu re-enciphered by the first run"
+           " %6lu errors\n", "", total, num_reenc, errors);
+
+    free(save_counts);
+
+    return errors > 0 ? -1 : 0;
+}
+
+/* Returns TRUE if the keyring holds a login cache entry of the user */
+static CK_BBOOL bench_login_cache_entry(void)
+{
+    char desc[PATH_MAX];
+
+    if (ock_snprintf(desc, sizeof(desc), "opencryptoki:login:user:%s",
+                     tokdata->data_store) != 0)
+        return FALSE;
+
+    return syscall(__NR_keyctl, KEYCTL_SEARCH, KEY_SPEC_USER_KEYRING,
+                   (unsigned long)"user", (unsigned long)desc, 0UL) >= 0;
+}
+
+static CK_RV bench_timed_login(ST_SESSION_T *sess, const char *pin,
+                               double *msecs)
+{
+    struct timespec start;
+    CK_RV rc;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = fcn->ST_Login(tokdata, sess, CKU_USER, (CK_CHAR_PTR)pin,
+                       strlen(pin));
+    if (msecs != NULL)
+        *msecs = elapsed_sec(&start) * 1e3;
+
+    return rc;
+}
+
+static void bench_login_cache_expect(const char *what, CK_RV rc,
+                                     CK_RV expected, CK_BBOOL entry,
+                                     unsigned long *errors)
+{
+    if (rc != expected) {
+        fprintf(stderr, "%s: rc=0x%lx, expected 0x%lx\n", what, rc,
+                expected);
+        (*errors)++;
+    }
+    if (bench_login_cache_entry() != entry) {
+        fprintf(stderr, "%s: cache entry %s\n", what,
+                entry ? "missing" : "not removed");
+        (*errors)++;
+    }
+}
+
+/*
+ * Checks the login cache with the user logged in by bench_login(). Closing
+ * the last session logs out without removing the entry, like a process
+ * that ends without C_Logout.
+ */
+static int bench_login_cache(ST_SESSION_T *sess)
+{
+    unsigned long errors = 0;
+    double uncached, cached;
+    CK_CHAR label[32];
+    CK_RV rc;
+
+    bench_login_cache_expect("login", CKR_OK, CKR_OK, TRUE, &errors);
+
+    rc = fcn->ST_Logout(tokdata, sess);
+    bench_login_cache_expect("logout", rc, CKR_OK, FALSE, &errors);
+
+    rc = bench_timed_login(sess, BENCH_USER_PIN, &uncached);
+    bench_login_cache_expect("uncached login", rc, CKR_OK, TRUE, &errors);
+    fcn->ST_CloseSession(tokdata, sess, FALSE);
+    if (open_session(sess) != CKR_OK)
+        return -1;
+
+    rc = bench_timed_login(sess, BENCH_BAD_PIN, NULL);
+    bench_login_cache_expect("wrong PIN", rc, CKR_PIN_INCORRECT, TRUE,
+                             &errors);
+    rc = bench_timed_login(sess, BENCH_USER_PIN, &cached);
+    bench_login_cache_expect("cached login", rc, CKR_OK, TRUE, &errors);
+
+    rc = fcn->ST_SetPIN(tokdata, sess, (CK_CHAR_PTR)BENCH_USER_PIN,
+                        strlen(BENCH_USER_PIN),
+                        (CK_CHAR_PTR)BENCH_NEW_USER_PIN,
+                        strlen(BENCH_NEW_USER_PIN));
+    bench_login_cache_expect("set PIN", rc, CKR_OK, FALSE, &errors);
+    fcn->ST_Logout(tokdata, sess);
+    rc = bench_timed_login(sess, BENCH_USER_PIN, NULL);
+    bench_login_cache_expect("old PIN", rc, CKR_PIN_INCORRECT, FALSE,
+                             &errors);
+    rc = bench_timed_login(sess, BENCH_NEW_USER_PIN, NULL);
+    bench_login_cache_expect("new PIN", rc, CKR_OK, TRUE, &errors);
+    fcn->ST_CloseSession(tokdata, sess, FALSE);
+
+    memset(label, ' ', sizeof(label));
+    rc = fcn->ST_InitToken(tokdata, BENCH_SLOT_ID, (CK_CHAR_PTR)BENCH_SO_PIN,
+                           strlen(BENCH_SO_PIN), label);
+    bench_login_cache_expect("init token", rc, CKR_OK, FALSE, &errors);
+    if (open_session(sess) != CKR_OK)
+        return -1;
+    rc = bench_timed_login(sess, BENCH_NEW_USER_PIN, NULL);
+    bench_login_cache_expect("PIN before init token", rc,
+                             CKR_USER_PIN_NOT_INITIALIZED, FALSE, &errors);
+
+    printf("%-10s %10.2f ms uncached login %10.2f ms cached login"
+           " %6lu errors\n", "logincache", uncached, cached, errors);
+
+    return errors > 0 ? -1 : 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("usage:  %s [-threads <num>] [-sessions <num>] [-objects <num>]\n"
+           "        [-iterations <num>] [-token] [-latency <usec>]\n"
+           "        [-keygen-latency <usec>] [-cipher-latency <usec>]\n"
+           "        [-digest-latency <usec>] [-digest-size <bytes>]\n"
+           "        [-sign-latency <usec>] [-cert-size <bytes>]\n"
+           "        [-batch-size <num>] [-batch-threads <num>]\n"
+           "        [-async-depth <num>] [-async-threads <num>]\n"
+           "        [-strength <file> -policy <file>]\n"
+           "        [-fuzz <seed>] [-reenc] [-reenc-latency <usec>]\n"
+           "        [-logincache] [-keep] [-v] [-h]\n\n", prog);
+    printf("  -threads         number of threads (default 1)\n");
+    printf("  -sessions        sessions per thread (default 1)\n");
+    printf("  -objects         objects per thread (default 100)\n");
+    printf("  -iterations      operations per thread and phase"
+           " (default 1000)\n");
+    printf("  -token           create token objects instead of session"
+           " objects\n");
+    printf("  -latency         latency of every mock token operation\n");
+    printf("  -*-latency       latency of the mock key generation, cipher,"
+           " digest or sign\n"
+           "                   operations\n");
+    printf("  -digest-size     data length of the digest operations"
+           " (default %d)\n", BENCH_DATA_LEN);
+    printf("  -cert-size       value length of the certificates of the"
+           " certattr phase\n"
+           "                   (default %d)\n", BENCH_CERT_LEN);
+    printf("  -batch-size      signatures per batch of the signbatch phase"
+           " (default %d)\n", BENCH_BATCH_LEN);
+    printf("  -batch-threads   worker threads of a batch request (default:"
+           " online CPUs)\n");
+    printf("  -async-depth     outstanding requests per thread of the async"
+           " phase (default %d)\n", BENCH_ASYNC_DEPTH);
+    printf("  -async-threads   worker threads of the async executor (default:"
+           " online CPUs)\n");
+    printf("  -strength        strength definition for -policy\n");
+    printf("  -policy          enforce the policy from the file instead of"
+           " an empty policy\n");
+    printf("  -fuzz            create objects with random templates, using"
+           " the seed\n");
+    printf("  -reenc           re-encipher token keys as during an HSM MK"
+           " change\n");
+    printf("  -reenc-latency   latency of the mock re-encipher operation\n");
+    printf("  -logincache      time the user login with the login cache and"
+           " check its\n"
+           "                   invalidation\n");
+    printf("  -keep            keep the temporary token directory\n");
+    printf("  -v               print the mock token operation counts\n");
+}
+
+static unsigned long parse_num(const char *prog, int argc, char **argv, int *i)
+{
+    char *end;
+    unsigned long val;
+
+    if (*i + 1 >= argc) {
+        usage(prog);
+        exit(EXIT_FAILURE);
+    }
+    (*i)++;
+    val = strtoul(argv[*i], &end, 0);
+    if (*end != '\0') {
+        fprintf(stderr, "Invalid number: %s\n", argv[*i]);
+        exit(EXIT_FAILURE);
+    }
+
+    return val;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_thread *threads = NULL;
+    ST_SESSION_T login_sess;
+    unsigned long i, j, latency;
+    enum mock_op op;
+    int ret = EXIT_FAILURE;
+
+    for (i = 1; i < (unsigned long)argc; i++) {
+        int k = i;
+
+        if (strcmp(argv[k], "-threads") == 0) {
+            num_threads = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-sessions") == 0) {
+            num_sessions = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-objects") == 0) {
+            num_objects = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-iterations") == 0) {
+            num_iterations = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-token") == 0) {
+            token_objects = TRUE;
+        } else if (strcmp(argv[k], "-latency") == 0) {
+            latency = parse_num(argv[0], argc, argv, &k);
+            for (op = 0; op < MOCK_OP_NUM; op++)
+                mock_set_latency(op, latency);
+        } else if (strcmp(argv[k], "-keygen-latency") == 0) {
+            mock_set_latency(MOCK_OP_KEYGEN,
+                             parse_num(argv[0], argc, argv, &k));
+        } else if (strcmp(argv[k], "-cipher-latency") == 0) {
+            mock_set_latency(MOCK_OP_CIPHER,
+                             parse_num(argv[0], argc, argv, &k));
+        } else if (strcmp(argv[k], "-digest-latency") == 0) {
+            mock_set_latency(MOCK_OP_DIGEST,
+                             parse_num(argv[0], argc, argv, &k));
+        } else if (strcmp(argv[k], "-sign-latency") == 0) {
+            mock_set_latency(MOCK_OP_SIGN,
+                             parse_num(argv[0], argc, argv, &k));
+        } else if (strcmp(argv[k], "-digest-size") == 0) {
+            digest_size = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-cert-size") == 0) {
+            cert_size = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-batch-size") == 0) {
+            batch_size = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-batch-threads") == 0) {
+            batch_threads = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-async-depth") == 0) {
+            async_depth = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-async-threads") == 0) {
+            async_threads = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-strength") == 0 && k + 1 < argc) {
+            strength_file = argv[++k];
+        } else if (strcmp(argv[k], "-policy") == 0 && k + 1 < argc) {
+            policy_file = argv[++k];
+        } else if (strcmp(argv[k], "-fuzz") == 0) {
+            fuzz = TRUE;
+            fuzz_seed = parse_num(argv[0], argc, argv, &k);
+        } else if (strcmp(argv[k], "-reenc") == 0) {
+            reenc = TRUE;
+        } else if (strcmp(argv[k], "-reenc-latency") == 0) {
+            mock_set_latency(MOCK_OP_REENC,
+                             parse_num(argv[0], argc, argv, &k));
+        } else if (strcmp(argv[k], "-logincache") == 0) {
+            logincache = TRUE;
+        } else if (strcmp(argv[k], "-keep") == 0) {
+            keep = TRUE;
+        } else if (strcmp(argv[k], "-v") == 0) {
+            verbose = TRUE;
+        } else if (strcmp(argv[k], "-h") == 0) {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i = k;
+    }
+
+    if (num_threads == 0 || num_sessions == 0 || num_objects == 0 ||
+        digest_size == 0 || cert_size == 0 || batch_size == 0 ||
+        async_depth == 0) {
+        fprintf(stderr, "Threads, sessions, objects, digest, certificate, "
+                "batch size and async depth must not be 0\n");
+        return EXIT_FAILURE;
+    }
+    if ((strength_file == NULL) != (policy_file == NULL)) {
+        fprintf(stderr, "-strength and -policy must be used together\n");
+        return EXIT_FAILURE;
+    }
+
+    if (bench_init() != CKR_OK)
+        goto out;
+    if (bench_login(&login_sess) != CKR_OK)
+        goto out;
+    if (logincache) {
+        if (bench_login_cache(&login_sess) == 0)
+            ret = EXIT_SUCCESS;
+        goto out;
+    }
+    if (batch_threads != 0)
+        tokdata->batch_threads = batch_threads;
+    if (async_threads != 0)
+        tokdata->async_threads = async_threads;
+
+    threads = calloc(num_threads, sizeof(*threads));
+    if (threads == NULL)
+        goto out;
+    for (i = 0; i < num_threads; i++) {
+        threads[i].id = i;
+        threads[i].seed = fuzz_seed + i;
+        threads[i].sessions = calloc(num_sessions, sizeof(ST_SESSION_T));
+        threads[i].objs = calloc(num_objects, sizeof(CK_OBJECT_HANDLE));
+        if (threads[i].sessions == NULL || threads[i].objs == NULL)
+            goto out;
+        for (j = 0; j < num_sessions; j++) {
+            if (open_session(&threads[i].sessions[j]) != CKR_OK)
+                goto out;
+        }
+    }
+
+    printf("threads: %lu sessions: %lu objects: %lu iterations: %lu "
+           "%s objects\n", num_threads, num_threads * num_sessions,
+           num_threads * num_objects, num_iterations,
+           token_objects || reenc ? "token" : "session");
+    if (policy_file != NULL)
+        printf("policy: %s\n", policy_file);
+
+    ret = EXIT_SUCCESS;
+    if (fuzz) {
+        printf("fuzz seed: %u\n", fuzz_seed);
+        if (run_phase("fuzz", phase_fuzz, threads) != 0)
+            ret = EXIT_FAILURE;
+    } else if (reenc) {
+        if (run_phase("create", phase_create_keys, threads) != 0 ||
+            bench_reenc(threads) != 0 ||
+            run_phase("destroy", phase_destroy, threads) != 0)
+            ret = EXIT_FAILURE;
+    } else {
+        if (run_phase("create", phase_create, threads) != 0 ||
+            run_phase("find", phase_find, threads) != 0 ||
+            run_phase("getattr", phase_getattr, threads) != 0 ||
+            run_phase("certattr", phase_certattr, threads) != 0 ||
+            run_phase("encrypt", phase_encrypt, threads) != 0 ||
+            run_phase("digest", phase_digest, threads) != 0 ||
+            run_phase("signbatch", phase_signbatch, threads) != 0 ||
+            run_phase("async", phase_async, threads) != 0 ||
+            run_phase("destroy", phase_destroy, threads) != 0)
+            ret = EXIT_FAILURE;
+    }
+
+    if (verbose)
+        printf("mock operations: keygen: %lu cipher: %lu digest: %lu "
+               "sign: %lu\n",
+               mock_get_calls(MOCK_OP_KEYGEN), mock_get_calls(MOCK_OP_CIPHER),
+               mock_get_calls(MOCK_OP_DIGEST), mock_get_calls(MOCK_OP_SIGN));
+
+out:
+    if (threads != NULL) {
+        for (i = 0; i < num_threads; i++) {
+            free(threads[i].sessions);
+            free(threads[i].objs);
+        }
+        free(threads);
+    }
+    bench_final();
+
+    return ret;
+}
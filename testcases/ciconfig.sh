@@ -159,3 +159,14 @@ if genlatestep11cfg 46 "PKEY_MODE ENABLE4ALL"; then
     echo "46" > $COMBINED_EXTRACT_FILE
 fi
 
+# 7:
+# HOST_PUBLIC_KEY_OPERATIONS
+# APQN_ANY
+genep11cfg 47 "HOST_PUBLIC_KEY_OPERATIONS"
+addslot 47 libpkcs11_ep11.so ep7 ep11tok47.conf
+
+# 8:
+# APQN_LOAD_BALANCING
+# APQN_ANY
+genep11cfg 48 "APQN_LOAD_BALANCING"
+addslot 48 libpkcs11_ep11.so ep8 ep11tok48.conf
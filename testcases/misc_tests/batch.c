@@ -0,0 +1,650 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: batch.c
+ *
+ * Test driver for the batch functions of the "Vendor IBM" interface:
+ * C_IBM_SignBatch, C_IBM_VerifyBatch and C_IBM_EncryptBatch, and for
+ * submitting them asynchronously with C_IBM_AsyncSubmit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "mech_to_str.h"
+#include "common.c"
+
+/* Large enough to be spread over multiple threads by the soft token */
+#define NUM_BATCH_ITEMS     100
+#define BATCH_DATA_LEN      64
+#define BATCH_RESULT_LEN    512
+#define NUM_ASYNC_REQUESTS  4
+
+CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+CK_ULONG user_pin_len;
+CK_SLOT_ID slot_id = 1;
+
+CK_SESSION_HANDLE session;
+CK_IBM_FUNCTION_LIST_1_1 *ibm_funcs;
+CK_IBM_FUNCTION_LIST_1_2 *ibm_funcs_1_2;
+
+CK_BYTE batch_data[NUM_BATCH_ITEMS][BATCH_DATA_LEN];
+CK_BYTE batch_result[NUM_BATCH_ITEMS][BATCH_RESULT_LEN];
+CK_IBM_BATCH_ITEM batch_items[NUM_BATCH_ITEMS];
+
+CK_BYTE aes_iv[16] = { 0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+                       0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f };
+
+static void setup_batch_items(CK_BBOOL length_only)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+        memset(batch_data[i], (int)i, BATCH_DATA_LEN);
+        batch_items[i].pData = batch_data[i];
+        batch_items[i].ulDataLen = BATCH_DATA_LEN;
+        batch_items[i].pResult = length_only ? NULL : batch_result[i];
+        batch_items[i].ulResultLen = BATCH_RESULT_LEN;
+        batch_items[i].rv = CKR_GENERAL_ERROR;
+    }
+}
+
+static CK_RV generate_rsa_key_pair(CK_OBJECT_HANDLE *publ_key,
+                                   CK_OBJECT_HANDLE *priv_key)
+{
+    CK_MECHANISM mech = { CKM_RSA_PKCS_KEY_PAIR_GEN, NULL, 0 };
+    CK_ULONG modulus_bits = 2048;
+    CK_BYTE publ_exp[] = { 0x01, 0x00, 0x01 };
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_MODULUS_BITS, &modulus_bits, sizeof(modulus_bits)},
+        {CKA_PUBLIC_EXPONENT, publ_exp, sizeof(publ_exp)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_PRIVATE, &true, sizeof(true)},
+        {CKA_SENSITIVE, &true, sizeof(true)},
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+
+    return funcs->C_GenerateKeyPair(session, &mech,
+                                    publ_tmpl, sizeof(publ_tmpl) /
+                                                    sizeof(CK_ATTRIBUTE),
+                                    priv_tmpl, sizeof(priv_tmpl) /
+                                                    sizeof(CK_ATTRIBUTE),
+                                    publ_key, priv_key);
+}
+
+CK_RV do_sign_verify_batch(void)
+{
+    CK_MECHANISM mech = { CKM_SHA256_RSA_PKCS, NULL, 0 };
+    CK_OBJECT_HANDLE publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_ULONG i;
+    CK_RV rc, loc_rc;
+
+    testcase_begin("Sign and verify batch with %s", mech_to_str(mech.mechanism));
+
+    if (!mech_supported(slot_id, CKM_RSA_PKCS_KEY_PAIR_GEN) ||
+        !mech_supported(slot_id, mech.mechanism)) {
+        testcase_skip("Slot %u doesn't support %s (0x%x)",
+                      (unsigned int)slot_id, mech_to_str(mech.mechanism),
+                      (unsigned int)mech.mechanism);
+        return CKR_OK;
+    }
+
+    rc = generate_rsa_key_pair(&publ_key, &priv_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("RSA key generation is not allowed by policy");
+            return CKR_OK;
+        }
+        testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    testcase_new_assertion();
+    setup_batch_items(TRUE);
+    rc = ibm_funcs->C_IBM_SignBatch(session, &mech, priv_key,
+                                    batch_items, NUM_BATCH_ITEMS);
+    if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+        testcase_skip("Slot %lu does not support C_IBM_SignBatch", slot_id);
+        rc = CKR_OK;
+        goto testcase_cleanup;
+    }
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_SignBatch (length only) rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+        if (batch_items[i].rv != CKR_OK || batch_items[i].ulResultLen != 256) {
+            testcase_fail("Item %lu: rv=%s, length=%lu", i,
+                          p11_get_ckr(batch_items[i].rv),
+                          batch_items[i].ulResultLen);
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("C_IBM_SignBatch returns the signature length");
+
+    testcase_new_assertion();
+    setup_batch_items(FALSE);
+    rc = ibm_funcs->C_IBM_SignBatch(session, &mech, priv_key,
+                                    batch_items, NUM_BATCH_ITEMS);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_SignBatch rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+        rc = funcs->C_VerifyInit(session, &mech, publ_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_VerifyInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        rc = funcs->C_Verify(session, batch_items[i].pData,
+                             batch_items[i].ulDataLen,
+                             batch_items[i].pResult,
+                             batch_items[i].ulResultLen);
+        if (rc != CKR_OK) {
+            testcase_fail("C_Verify of item %lu rc=%s", i, p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("C_IBM_SignBatch creates valid signatures");
+
+    testcase_new_assertion();
+    rc = ibm_funcs->C_IBM_VerifyBatch(session, &mech, publ_key,
+                                      batch_items, NUM_BATCH_ITEMS);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_VerifyBatch rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    testcase_pass("C_IBM_VerifyBatch verifies the signatures");
+
+    testcase_new_assertion();
+    batch_items[NUM_BATCH_ITEMS / 2].pResult[0] ^= 0xff;
+    rc = ibm_funcs->C_IBM_VerifyBatch(session, &mech, publ_key,
+                                      batch_items, NUM_BATCH_ITEMS);
+    if (rc != CKR_SIGNATURE_INVALID) {
+        testcase_fail("C_IBM_VerifyBatch with a bad signature rc=%s",
+                      p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+        if (batch_items[i].rv != (i == NUM_BATCH_ITEMS / 2 ?
+                                    CKR_SIGNATURE_INVALID : CKR_OK)) {
+            testcase_fail("Item %lu: rv=%s", i,
+                          p11_get_ckr(batch_items[i].rv));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("C_IBM_VerifyBatch reports the bad signature");
+    rc = CKR_OK;
+
+testcase_cleanup:
+    loc_rc = funcs->C_DestroyObject(session, publ_key);
+    if (loc_rc != CKR_OK)
+        testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+    loc_rc = funcs->C_DestroyObject(session, priv_key);
+    if (loc_rc != CKR_OK)
+        testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+
+    return rc;
+}
+
+CK_RV do_encrypt_batch(void)
+{
+    CK_MECHANISM keygen_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_MECHANISM mech = { CKM_AES_ECB, NULL, 0 };
+    CK_AES_CTR_PARAMS ctr_param = { 128, { 0 } };
+    CK_MECHANISM iv_mechs[] = {
+        { CKM_AES_CBC, aes_iv, sizeof(aes_iv) },
+        { CKM_AES_CBC_PAD, aes_iv, sizeof(aes_iv) },
+        { CKM_AES_CTR, &ctr_param, sizeof(ctr_param) },
+    };
+    CK_OBJECT_HANDLE key = CK_INVALID_HANDLE;
+    CK_BYTE encrypted[BATCH_RESULT_LEN];
+    CK_ULONG encrypted_len, i;
+    CK_RV rc, loc_rc;
+
+    testcase_begin("Encrypt batch with %s", mech_to_str(mech.mechanism));
+
+    if (!mech_supported(slot_id, keygen_mech.mechanism) ||
+        !mech_supported(slot_id, mech.mechanism)) {
+        testcase_skip("Slot %u doesn't support %s (0x%x)",
+                      (unsigned int)slot_id, mech_to_str(mech.mechanism),
+                      (unsigned int)mech.mechanism);
+        return CKR_OK;
+    }
+
+    rc = generate_AESKey(session, 32, TRUE, &keygen_mech, &key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("AES key generation is not allowed by policy");
+            return CKR_OK;
+        }
+        return rc;
+    }
+
+    testcase_new_assertion();
+    setup_batch_items(FALSE);
+    rc = ibm_funcs->C_IBM_EncryptBatch(session, &mech, key,
+                                       batch_items, NUM_BATCH_ITEMS);
+    if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+        testcase_skip("Slot %lu does not support C_IBM_EncryptBatch",
+                      slot_id);
+        rc = CKR_OK;
+        goto testcase_cleanup;
+    }
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_EncryptBatch rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+        rc = funcs->C_EncryptInit(session, &mech, key);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        encrypted_len = sizeof(encrypted);
+        rc = funcs->C_Encrypt(session, batch_items[i].pData,
+                              batch_items[i].ulDataLen,
+                              encrypted, &encrypted_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_Encrypt rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        if (encrypted_len != batch_items[i].ulResultLen ||
+            memcmp(encrypted, batch_items[i].pResult, encrypted_len) != 0) {
+            testcase_fail("Item %lu differs from the C_Encrypt result", i);
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("C_IBM_EncryptBatch matches C_Encrypt");
+
+    testcase_new_assertion();
+    setup_batch_items(FALSE);
+    batch_items[1].ulResultLen = 1;
+    rc = ibm_funcs->C_IBM_EncryptBatch(session, &mech, key,
+                                       batch_items, NUM_BATCH_ITEMS);
+    if (rc != CKR_BUFFER_TOO_SMALL || batch_items[0].rv != CKR_OK ||
+        batch_items[1].rv != CKR_BUFFER_TOO_SMALL ||
+        batch_items[1].ulResultLen != BATCH_DATA_LEN) {
+        testcase_fail("C_IBM_EncryptBatch with a short buffer rc=%s",
+                      p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    testcase_pass("C_IBM_EncryptBatch reports a short buffer per item");
+
+    /* All items would be encrypted with the same IV or counter */
+    testcase_new_assertion();
+    for (i = 0; i < sizeof(iv_mechs) / sizeof(CK_MECHANISM); i++) {
+        setup_batch_items(FALSE);
+        rc = ibm_funcs->C_IBM_EncryptBatch(session, &iv_mechs[i], key,
+                                           batch_items, NUM_BATCH_ITEMS);
+        if (rc != CKR_MECHANISM_INVALID) {
+            testcase_fail("C_IBM_EncryptBatch with %s rc=%s",
+                          mech_to_str(iv_mechs[i].mechanism),
+                          p11_get_ckr(rc));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("C_IBM_EncryptBatch rejects mechanisms with an IV");
+    rc = CKR_OK;
+
+testcase_cleanup:
+    loc_rc = funcs->C_DestroyObject(session, key);
+    if (loc_rc != CKR_OK)
+        testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+
+    return rc;
+}
+
+/*
+ * Waits for all submitted requests and checks that each one is returned
+ * exactly once. The first request is expected to complete with first_rv,
+ * all others with CKR_OK.
+ */
+static CK_RV wait_async_requests(CK_IBM_QUEUE_HANDLE queue,
+                                 CK_IBM_ASYNC_REQUEST *requests,
+                                 CK_ULONG num_requests, CK_RV first_rv)
+{
+    CK_IBM_ASYNC_REQUEST_PTR completed[NUM_ASYNC_REQUESTS];
+    CK_BBOOL seen[NUM_ASYNC_REQUESTS] = { 0 };
+    CK_ULONG done = 0, count, i, idx;
+    CK_RV rc;
+
+    while (done < num_requests) {
+        rc = ibm_funcs_1_2->C_IBM_AsyncWait(queue, completed,
+                                            NUM_ASYNC_REQUESTS, &count,
+                                            10000);
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_AsyncWait rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        if (count == 0) {
+            testcase_fail("C_IBM_AsyncWait timed out");
+            return CKR_FUNCTION_FAILED;
+        }
+        for (i = 0; i < count; i++) {
+            idx = (CK_ULONG)(completed[i] - requests);
+            if (idx >= num_requests || seen[idx] ||
+                completed[i]->pUserData != &requests[idx]) {
+                testcase_fail("Unexpected request returned");
+                return CKR_FUNCTION_FAILED;
+            }
+            if (completed[i]->rv != (idx == 0 ? first_rv : CKR_OK)) {
+                testcase_fail("Request %lu rv=%s", idx,
+                              p11_get_ckr(completed[i]->rv));
+                return CKR_FUNCTION_FAILED;
+            }
+            seen[idx] = TRUE;
+        }
+        done += count;
+    }
+
+    return CKR_OK;
+}
+
+CK_RV do_async_requests(void)
+{
+    CK_MECHANISM mech = { CKM_SHA256_RSA_PKCS, NULL, 0 };
+    CK_MECHANISM cbc_mech = { CKM_AES_CBC, aes_iv, sizeof(aes_iv) };
+    CK_OBJECT_HANDLE publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_IBM_QUEUE_HANDLE queue = CK_INVALID_HANDLE;
+    CK_IBM_QUEUE_HANDLE destroyed;
+    CK_IBM_ASYNC_REQUEST requests[NUM_ASYNC_REQUESTS];
+    CK_IBM_ASYNC_REQUEST_PTR completed[NUM_ASYNC_REQUESTS];
+    CK_ULONG per_request = NUM_BATCH_ITEMS / NUM_ASYNC_REQUESTS;
+    CK_ULONG count, i;
+    CK_RV rc, loc_rc;
+
+    testcase_begin("Async sign and verify with %s",
+                   mech_to_str(mech.mechanism));
+
+    if (ibm_funcs_1_2 == NULL) {
+        testcase_skip("Vendor IBM interface version 1.2 not supported");
+        return CKR_OK;
+    }
+
+    if (!mech_supported(slot_id, CKM_RSA_PKCS_KEY_PAIR_GEN) ||
+        !mech_supported(slot_id, mech.mechanism)) {
+        testcase_skip("Slot %u doesn't support %s (0x%x)",
+                      (unsigned int)slot_id, mech_to_str(mech.mechanism),
+                      (unsigned int)mech.mechanism);
+        return CKR_OK;
+    }
+
+    rc = generate_rsa_key_pair(&publ_key, &priv_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("RSA key generation is not allowed by policy");
+            return CKR_OK;
+        }
+        testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = ibm_funcs_1_2->C_IBM_CreateQueue(&queue);
+    if (rc != CKR_OK) {
+        testcase_error("C_IBM_CreateQueue rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    testcase_new_assertion();
+    setup_batch_items(FALSE);
+    for (i = 0; i < NUM_ASYNC_REQUESTS; i++) {
+        requests[i].operation = CK_IBM_ASYNC_SIGN;
+        requests[i].pMechanism = &mech;
+        requests[i].hKey = priv_key;
+        requests[i].pItems = &batch_items[i * per_request];
+        requests[i].ulCount = per_request;
+        requests[i].pUserData = &requests[i];
+        requests[i].rv = CKR_GENERAL_ERROR;
+
+        rc = ibm_funcs_1_2->C_IBM_AsyncSubmit(session, queue, &requests[i]);
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED && i == 0) {
+            testcase_skip("Slot %lu does not support C_IBM_AsyncSubmit",
+                          slot_id);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_AsyncSubmit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+    rc = wait_async_requests(queue, requests, NUM_ASYNC_REQUESTS, CKR_OK);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    testcase_pass("All async sign requests completed");
+
+    testcase_new_assertion();
+    for (i = 0; i < NUM_ASYNC_REQUESTS; i++) {
+        requests[i].operation = CK_IBM_ASYNC_VERIFY;
+        requests[i].hKey = publ_key;
+        requests[i].rv = CKR_GENERAL_ERROR;
+    }
+    batch_items[0].pResult[0] ^= 0xff;
+    for (i = 0; i < NUM_ASYNC_REQUESTS; i++) {
+        rc = ibm_funcs_1_2->C_IBM_AsyncSubmit(session, queue, &requests[i]);
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_AsyncSubmit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+    rc = wait_async_requests(queue, requests, NUM_ASYNC_REQUESTS,
+                             CKR_SIGNATURE_INVALID);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    testcase_pass("Async verify requests report the bad signature");
+
+    /* Rejected at submit time, nothing is queued */
+    testcase_new_assertion();
+    requests[0].operation = CK_IBM_ASYNC_ENCRYPT;
+    requests[0].pMechanism = &cbc_mech;
+    requests[0].rv = CKR_GENERAL_ERROR;
+    rc = ibm_funcs_1_2->C_IBM_AsyncSubmit(session, queue, &requests[0]);
+    if (rc != CKR_MECHANISM_INVALID) {
+        testcase_fail("C_IBM_AsyncSubmit with %s rc=%s",
+                      mech_to_str(cbc_mech.mechanism), p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    testcase_pass("C_IBM_AsyncSubmit rejects encryption with an IV");
+
+    testcase_new_assertion();
+    rc = ibm_funcs_1_2->C_IBM_AsyncPoll(queue, completed, NUM_ASYNC_REQUESTS,
+                                        &count);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_AsyncPoll rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    if (count != 0) {
+        testcase_fail("C_IBM_AsyncPoll returned %lu requests", count);
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    rc = ibm_funcs_1_2->C_IBM_AsyncWait(queue, completed, NUM_ASYNC_REQUESTS,
+                                        &count, 0);
+    if (rc != CKR_OK || count != 0) {
+        testcase_fail("C_IBM_AsyncWait without requests rc=%s count=%lu",
+                      p11_get_ckr(rc), count);
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    testcase_pass("An empty queue returns no requests");
+
+    testcase_new_assertion();
+    destroyed = queue;
+    rc = ibm_funcs_1_2->C_IBM_DestroyQueue(queue);
+    queue = CK_INVALID_HANDLE;
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_DestroyQueue rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = ibm_funcs_1_2->C_IBM_AsyncPoll(destroyed, completed,
+                                        NUM_ASYNC_REQUESTS, &count);
+    if (rc != CKR_ARGUMENTS_BAD) {
+        testcase_fail("C_IBM_AsyncPoll on a destroyed queue rc=%s",
+                      p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    testcase_pass("C_IBM_DestroyQueue destroys the queue");
+    rc = CKR_OK;
+
+testcase_cleanup:
+    /* Waits for requests still in flight, they use the local buffers */
+    if (queue != CK_INVALID_HANDLE)
+        ibm_funcs_1_2->C_IBM_DestroyQueue(queue);
+    loc_rc = funcs->C_DestroyObject(session, publ_key);
+    if (loc_rc != CKR_OK)
+        testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+    loc_rc = funcs->C_DestroyObject(session, priv_key);
+    if (loc_rc != CKR_OK)
+        testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_INTERFACE *interface;
+    CK_VERSION version = { 1, 1 };
+    int i, ret = 1;
+    CK_RV rv;
+    CK_FLAGS flags;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-slot") == 0) {
+            ++i;
+            if (i >= argc) {
+                printf("Slot number missing\n");
+                return -1;
+            }
+            slot_id = atoi(argv[i]);
+        }
+
+        if (strcmp(argv[i], "-h") == 0) {
+            printf("usage:  %s [-slot <num>] [-h]\n\n", argv[0]);
+            printf("By default, Slot #1 is used\n\n");
+            return -1;
+        }
+    }
+
+    if (get_user_pin(user_pin))
+        return CKR_FUNCTION_FAILED;
+    user_pin_len = (CK_ULONG) strlen((char *) user_pin);
+
+    printf("Using slot #%lu...\n\n", slot_id);
+
+    rv = do_GetFunctionList();
+    if (rv != TRUE) {
+        testcase_fail("do_GetFunctionList() rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    rv = funcs3->C_GetInterface((CK_UTF8CHAR *)"Vendor IBM", &version,
+                                &interface, 0);
+    if (rv != CKR_OK) {
+        testcase_skip("Vendor IBM interface version 1.1 not supported");
+        goto out;
+    }
+    ibm_funcs = interface->pFunctionList;
+
+    version.minor = 2;
+    rv = funcs3->C_GetInterface((CK_UTF8CHAR *)"Vendor IBM", &version,
+                                &interface, 0);
+    if (rv == CKR_OK)
+        ibm_funcs_1_2 = interface->pFunctionList;
+
+    testcase_setup();
+    testcase_begin("Starting...");
+
+    // Initialize
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    if ((rv = funcs->C_Initialize(&cinit_args))) {
+        testcase_fail("C_Initialize rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    rv = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_OpenSession rc = %s", p11_get_ckr(rv));
+        goto finalize;
+    }
+
+    rv = funcs->C_Login(session, CKU_USER, user_pin, user_pin_len);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Login rc = %s", p11_get_ckr(rv));
+        goto close_session;
+    }
+
+    rv = do_sign_verify_batch();
+    if (rv != CKR_OK)
+        goto close_session;
+
+    rv = do_encrypt_batch();
+    if (rv != CKR_OK)
+        goto close_session;
+
+    rv = do_async_requests();
+    if (rv != CKR_OK)
+        goto close_session;
+
+    rv = funcs->C_CloseSession(session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession rc = %s", p11_get_ckr(rv));
+        goto finalize;
+    }
+
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Finalize rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    ret = 0;
+    goto out;
+
+close_session:
+    rv = funcs->C_CloseSession(session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+finalize:
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Finalize rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+out:
+    testcase_print_result();
+    return testcase_return(ret);
+}
@@ -0,0 +1,504 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: host_pubkey_ops.c
+ *
+ * Test driver for the HOST_PUBLIC_KEY_OPERATIONS option of the EP11 token.
+ * The verify and encrypt results of public keys in the slot given with
+ * -hostslot, which has the option set, are compared with the results of the
+ * same public key in the slot given with -slot, which uses the crypto
+ * adapter. The key pairs are generated in the host slot. Their public keys
+ * are also imported into the host slot, and both kinds of public keys must
+ * carry a MACed SPKI.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "mech_to_str.h"
+#include "common.c"
+
+#define DATA_LEN            32
+#define RESULT_LEN          512
+
+CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+CK_ULONG user_pin_len;
+CK_SLOT_ID slot_id = 1;
+CK_SLOT_ID host_slot_id = (CK_SLOT_ID)-1;
+
+CK_SESSION_HANDLE session;
+CK_SESSION_HANDLE host_session;
+
+/* DER encoded OID of the NIST P-256 curve */
+CK_BYTE prime256v1[] = { 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03,
+                         0x01, 0x07 };
+
+static CK_RV generate_key_pair(CK_KEY_TYPE key_type,
+                               CK_OBJECT_HANDLE *publ_key,
+                               CK_OBJECT_HANDLE *priv_key)
+{
+    CK_MECHANISM rsa_mech = { CKM_RSA_PKCS_KEY_PAIR_GEN, NULL, 0 };
+    CK_MECHANISM ec_mech = { CKM_EC_KEY_PAIR_GEN, NULL, 0 };
+    CK_ULONG modulus_bits = 2048;
+    CK_BYTE publ_exp[] = { 0x01, 0x00, 0x01 };
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_ATTRIBUTE rsa_publ_tmpl[] = {
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_ENCRYPT, &true, sizeof(true)},
+        {CKA_MODULUS_BITS, &modulus_bits, sizeof(modulus_bits)},
+        {CKA_PUBLIC_EXPONENT, publ_exp, sizeof(publ_exp)},
+    };
+    CK_ATTRIBUTE ec_publ_tmpl[] = {
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_EC_PARAMS, prime256v1, sizeof(prime256v1)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_PRIVATE, &true, sizeof(true)},
+        {CKA_SENSITIVE, &true, sizeof(true)},
+        {CKA_SIGN, &true, sizeof(true)},
+        {CKA_DECRYPT, &true, sizeof(true)},
+    };
+
+    if (key_type == CKK_RSA)
+        return funcs->C_GenerateKeyPair(host_session, &rsa_mech,
+                                        rsa_publ_tmpl, sizeof(rsa_publ_tmpl) /
+                                                        sizeof(CK_ATTRIBUTE),
+                                        priv_tmpl, sizeof(priv_tmpl) /
+                                                        sizeof(CK_ATTRIBUTE),
+                                        publ_key, priv_key);
+
+    /* CKA_DECRYPT is not allowed for EC private keys */
+    return funcs->C_GenerateKeyPair(host_session, &ec_mech,
+                                    ec_publ_tmpl, sizeof(ec_publ_tmpl) /
+                                                    sizeof(CK_ATTRIBUTE),
+                                    priv_tmpl, sizeof(priv_tmpl) /
+                                                    sizeof(CK_ATTRIBUTE) - 1,
+                                    publ_key, priv_key);
+}
+
+/*
+ * Creates a public key object in the session from the public key
+ * attributes of key in the host slot.
+ */
+static CK_RV copy_public_key(CK_KEY_TYPE key_type, CK_OBJECT_HANDLE key,
+                             CK_SESSION_HANDLE sess,
+                             CK_OBJECT_HANDLE *publ_key)
+{
+    CK_OBJECT_CLASS class = CKO_PUBLIC_KEY;
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_BYTE value1[RESULT_LEN], value2[RESULT_LEN];
+    CK_ATTRIBUTE tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_KEY_TYPE, &key_type, sizeof(key_type)},
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_MODULUS, value1, sizeof(value1)},
+        {CKA_PUBLIC_EXPONENT, value2, sizeof(value2)},
+        {CKA_ENCRYPT, &true, sizeof(true)},
+    };
+    CK_ULONG tmpl_len = sizeof(tmpl) / sizeof(CK_ATTRIBUTE);
+    CK_RV rc;
+
+    if (key_type == CKK_EC) {
+        tmpl[4].type = CKA_EC_PARAMS;
+        tmpl[5].type = CKA_EC_POINT;
+        tmpl_len--;
+    }
+
+    rc = funcs->C_GetAttributeValue(host_session, key, &tmpl[4], 2);
+    if (rc != CKR_OK) {
+        testcase_error("C_GetAttributeValue rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_CreateObject(sess, tmpl, tmpl_len, publ_key);
+    if (rc != CKR_OK)
+        testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+/*
+ * Returns TRUE if the key blob of the public key is an SPKI followed by the
+ * MAC of the EP11 adapter.
+ */
+static CK_BBOOL has_maced_spki(CK_OBJECT_HANDLE key)
+{
+    CK_BYTE blob[RESULT_LEN * 2];
+    CK_ATTRIBUTE attr = { CKA_IBM_OPAQUE, blob, sizeof(blob) };
+    CK_ULONG len, hdr_len, i;
+    CK_RV rc;
+
+    rc = funcs->C_GetAttributeValue(host_session, key, &attr, 1);
+    if (rc != CKR_OK) {
+        testcase_error("C_GetAttributeValue rc=%s", p11_get_ckr(rc));
+        return FALSE;
+    }
+
+    if (attr.ulValueLen < 2 || blob[0] != 0x30)
+        return FALSE;
+
+    if (blob[1] < 0x80) {
+        len = blob[1];
+        hdr_len = 2;
+    } else {
+        hdr_len = 2 + (blob[1] & 0x7f);
+        if (hdr_len > 4 || attr.ulValueLen < hdr_len)
+            return FALSE;
+        for (i = 2, len = 0; i < hdr_len; i++)
+            len = (len << 8) | blob[i];
+    }
+
+    return attr.ulValueLen > hdr_len + len;
+}
+
+static CK_RV verify(CK_SESSION_HANDLE sess, CK_MECHANISM *mech,
+                    CK_OBJECT_HANDLE key, CK_BYTE *data,
+                    CK_BYTE *signature, CK_ULONG sig_len)
+{
+    CK_RV rc;
+
+    rc = funcs->C_VerifyInit(sess, mech, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    return funcs->C_Verify(sess, data, DATA_LEN, signature, sig_len);
+}
+
+static CK_RV encrypt(CK_SESSION_HANDLE sess, CK_MECHANISM *mech,
+                     CK_OBJECT_HANDLE key, CK_BYTE *data, CK_ULONG data_len,
+                     CK_BYTE *encrypted, CK_ULONG *encrypted_len)
+{
+    CK_RV rc;
+
+    rc = funcs->C_EncryptInit(sess, mech, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    *encrypted_len = RESULT_LEN;
+    return funcs->C_Encrypt(sess, data, data_len, encrypted, encrypted_len);
+}
+
+CK_RV do_host_pubkey_ops(CK_KEY_TYPE key_type, CK_MECHANISM_TYPE keygen_mech,
+                         CK_MECHANISM_TYPE mech_type)
+{
+    CK_MECHANISM mech = { mech_type, NULL, 0 };
+    CK_OBJECT_HANDLE publ_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE host_keys[2] = { CK_INVALID_HANDLE, CK_INVALID_HANDLE };
+    CK_OBJECT_HANDLE hsm_key = CK_INVALID_HANDLE;
+    CK_BYTE data[DATA_LEN], signature[RESULT_LEN];
+    CK_BYTE encrypted[RESULT_LEN], decrypted[RESULT_LEN];
+    CK_ULONG sig_len, encrypted_len, decrypted_len, i;
+    CK_RV rc, loc_rc, hsm_rc;
+
+    testcase_begin("Host public key operations with %s",
+                   mech_to_str(mech.mechanism));
+
+    if (!mech_supported(host_slot_id, keygen_mech) ||
+        !mech_supported(host_slot_id, mech.mechanism) ||
+        !mech_supported(slot_id, mech.mechanism)) {
+        testcase_skip("Slots %u and %u don't support %s (0x%x)",
+                      (unsigned int)slot_id, (unsigned int)host_slot_id,
+                      mech_to_str(mech.mechanism),
+                      (unsigned int)mech.mechanism);
+        return CKR_OK;
+    }
+
+    rc = generate_key_pair(key_type, &publ_key, &priv_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("Key generation is not allowed by policy");
+            return CKR_OK;
+        }
+        testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    host_keys[0] = publ_key;
+    rc = copy_public_key(key_type, publ_key, host_session, &host_keys[1]);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+    rc = copy_public_key(key_type, publ_key, session, &hsm_key);
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    testcase_new_assertion();
+    for (i = 0; i < 2; i++) {
+        if (!has_maced_spki(host_keys[i])) {
+            testcase_fail("The %s public key has no MACed SPKI",
+                          i == 0 ? "generated" : "imported");
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("The public keys carry a MACed SPKI");
+
+    memset(data, 0x5a, sizeof(data));
+    rc = funcs->C_SignInit(host_session, &mech, priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    sig_len = sizeof(signature);
+    rc = funcs->C_Sign(host_session, data, sizeof(data), signature, &sig_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_Sign rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    testcase_new_assertion();
+    hsm_rc = verify(session, &mech, hsm_key, data, signature, sig_len);
+    for (i = 0; i < 2; i++) {
+        rc = verify(host_session, &mech, host_keys[i], data, signature,
+                    sig_len);
+        if (rc != CKR_OK || hsm_rc != CKR_OK) {
+            testcase_fail("C_Verify rc=%s, adapter rc=%s", p11_get_ckr(rc),
+                          p11_get_ckr(hsm_rc));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("Host and adapter verify the signature");
+
+    testcase_new_assertion();
+    signature[sig_len / 2] ^= 0xff;
+    hsm_rc = verify(session, &mech, hsm_key, data, signature, sig_len);
+    for (i = 0; i < 2; i++) {
+        rc = verify(host_session, &mech, host_keys[i], data, signature,
+                    sig_len);
+        if (rc != CKR_SIGNATURE_INVALID || hsm_rc != CKR_SIGNATURE_INVALID) {
+            testcase_fail("C_Verify with a bad signature rc=%s, adapter "
+                          "rc=%s", p11_get_ckr(rc), p11_get_ckr(hsm_rc));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    signature[sig_len / 2] ^= 0xff;
+    data[0] ^= 0xff;
+    hsm_rc = verify(session, &mech, hsm_key, data, signature, sig_len);
+    for (i = 0; i < 2; i++) {
+        rc = verify(host_session, &mech, host_keys[i], data, signature,
+                    sig_len);
+        if (rc != CKR_SIGNATURE_INVALID || hsm_rc != CKR_SIGNATURE_INVALID) {
+            testcase_fail("C_Verify of modified data rc=%s, adapter rc=%s",
+                          p11_get_ckr(rc), p11_get_ckr(hsm_rc));
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    data[0] ^= 0xff;
+    testcase_pass("Host and adapter reject bad signatures");
+
+    if (key_type != CKK_RSA) {
+        rc = CKR_OK;
+        goto testcase_cleanup;
+    }
+
+    /* RSA PKCS#1 padding is random, compare the decrypted results */
+    testcase_new_assertion();
+    for (i = 0; i < 3; i++) {
+        if (i < 2)
+            rc = encrypt(host_session, &mech, host_keys[i], data,
+                         sizeof(data), encrypted, &encrypted_len);
+        else
+            rc = encrypt(session, &mech, hsm_key, data, sizeof(data),
+                         encrypted, &encrypted_len);
+        if (rc != CKR_OK) {
+            testcase_fail("C_Encrypt rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        rc = funcs->C_DecryptInit(host_session, &mech, priv_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        decrypted_len = sizeof(decrypted);
+        rc = funcs->C_Decrypt(host_session, encrypted, encrypted_len,
+                              decrypted, &decrypted_len);
+        if (rc != CKR_OK) {
+            testcase_fail("C_Decrypt rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        if (decrypted_len != sizeof(data) ||
+            memcmp(decrypted, data, sizeof(data)) != 0) {
+            testcase_fail("The %s decrypts to different data",
+                          i < 2 ? "host encryption" : "adapter encryption");
+            rc = CKR_FUNCTION_FAILED;
+            goto testcase_cleanup;
+        }
+    }
+    testcase_pass("Host and adapter encrypt the data");
+
+    /* Too long for PKCS#1 padding with a 2048 bit key */
+    testcase_new_assertion();
+    hsm_rc = encrypt(session, &mech, hsm_key, encrypted, 256,
+                     decrypted, &decrypted_len);
+    rc = encrypt(host_session, &mech, host_keys[0], encrypted, 256,
+                 decrypted, &decrypted_len);
+    if (rc != CKR_DATA_LEN_RANGE || hsm_rc != CKR_DATA_LEN_RANGE) {
+        testcase_fail("C_Encrypt of too long data rc=%s, adapter rc=%s",
+                      p11_get_ckr(rc), p11_get_ckr(hsm_rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto testcase_cleanup;
+    }
+    testcase_pass("Host and adapter reject too long data");
+    rc = CKR_OK;
+
+testcase_cleanup:
+    for (i = 0; i < 2; i++) {
+        if (host_keys[i] == CK_INVALID_HANDLE)
+            continue;
+        loc_rc = funcs->C_DestroyObject(host_session, host_keys[i]);
+        if (loc_rc != CKR_OK)
+            testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+    }
+    if (hsm_key != CK_INVALID_HANDLE) {
+        loc_rc = funcs->C_DestroyObject(session, hsm_key);
+        if (loc_rc != CKR_OK)
+            testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+    }
+    loc_rc = funcs->C_DestroyObject(host_session, priv_key);
+    if (loc_rc != CKR_OK)
+        testcase_error("C_DestroyObject rc=%s", p11_get_ckr(loc_rc));
+
+    return rc;
+}
+
+static CK_RV open_session(CK_SLOT_ID slot, CK_SESSION_HANDLE *sess)
+{
+    CK_RV rv;
+
+    rv = funcs->C_OpenSession(slot, CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                              NULL, NULL, sess);
+    if (rv != CKR_OK) {
+        testcase_fail("C_OpenSession rc = %s", p11_get_ckr(rv));
+        return rv;
+    }
+
+    rv = funcs->C_Login(*sess, CKU_USER, user_pin, user_pin_len);
+    if (rv != CKR_OK && rv != CKR_USER_ALREADY_LOGGED_IN) {
+        testcase_fail("C_Login rc = %s", p11_get_ckr(rv));
+        funcs->C_CloseSession(*sess);
+        return rv;
+    }
+
+    return CKR_OK;
+}
+
+int main(int argc, char **argv)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    int i, ret = 1;
+    CK_RV rv;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-slot") == 0 ||
+            strcmp(argv[i], "-hostslot") == 0) {
+            ++i;
+            if (i >= argc) {
+                printf("Slot number missing\n");
+                return -1;
+            }
+            if (argv[i - 1][1] == 's')
+                slot_id = atoi(argv[i]);
+            else
+                host_slot_id = atoi(argv[i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "-h") == 0) {
+            printf("usage:  %s [-slot <num>] -hostslot <num> [-h]\n\n",
+                   argv[0]);
+            printf("-slot is an EP11 slot, -hostslot an EP11 slot with "
+                   "HOST_PUBLIC_KEY_OPERATIONS\n");
+            printf("By default, Slot #1 is used\n\n");
+            return -1;
+        }
+    }
+
+    if (host_slot_id == (CK_SLOT_ID)-1) {
+        printf("Host slot number missing\n");
+        return -1;
+    }
+
+    if (get_user_pin(user_pin))
+        return CKR_FUNCTION_FAILED;
+    user_pin_len = (CK_ULONG) strlen((char *) user_pin);
+
+    printf("Using slot #%lu and host slot #%lu...\n\n", slot_id,
+           host_slot_id);
+
+    rv = do_GetFunctionList();
+    if (rv != TRUE) {
+        testcase_fail("do_GetFunctionList() rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    testcase_setup();
+    testcase_begin("Starting...");
+
+    // Initialize
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    if ((rv = funcs->C_Initialize(&cinit_args))) {
+        testcase_fail("C_Initialize rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    if (open_session(slot_id, &session) != CKR_OK)
+        goto finalize;
+
+    if (open_session(host_slot_id, &host_session) != CKR_OK)
+        goto close_session;
+
+    rv = do_host_pubkey_ops(CKK_RSA, CKM_RSA_PKCS_KEY_PAIR_GEN, CKM_RSA_PKCS);
+    if (rv != CKR_OK)
+        goto close_sessions;
+
+    rv = do_host_pubkey_ops(CKK_EC, CKM_EC_KEY_PAIR_GEN, CKM_ECDSA);
+    if (rv != CKR_OK)
+        goto close_sessions;
+
+    ret = 0;
+
+close_sessions:
+    rv = funcs->C_CloseSession(host_session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+close_session:
+    rv = funcs->C_CloseSession(session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+finalize:
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Finalize rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+out:
+    testcase_print_result();
+    return testcase_return(ret);
+}
@@ -7,6 +7,7 @@ noinst_PROGRAMS +=							\
 	testcases/misc_tests/fork testcases/misc_tests/multi_instance   \
 	testcases/misc_tests/obj_lock testcases/misc_tests/tok2tok_transport \
 	testcases/misc_tests/obj_lock testcases/misc_tests/reencrypt    \
+	testcases/misc_tests/batch testcases/misc_tests/host_pubkey_ops	\
 	testcases/misc_tests/cca_export_import_test			\
 	testcases/misc_tests/events testcases/misc_tests/dual_functions \
 	testcases/misc_tests/always_auth
@@ -102,6 +103,15 @@ testcases_misc_tests_reencrypt_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_reencrypt_SOURCES = 			\
 	testcases/misc_tests/reencrypt.c
 
+testcases_misc_tests_batch_CFLAGS = ${testcases_inc}
+testcases_misc_tests_batch_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_batch_SOURCES = testcases/misc_tests/batch.c
+
+testcases_misc_tests_host_pubkey_ops_CFLAGS = ${testcases_inc}
+testcases_misc_tests_host_pubkey_ops_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_host_pubkey_ops_SOURCES =				\
+	testcases/misc_tests/host_pubkey_ops.c
+
 testcases_misc_tests_cca_export_import_test_CFLAGS = ${testcases_inc}
 testcases_misc_tests_cca_export_import_test_LDADD =			\
 	testcases/common/libcommon.la
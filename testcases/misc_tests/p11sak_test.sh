@@ -62,6 +62,7 @@ P11SAK_ALL_SO=p11sak-all-so
 P11SAK_X509_PRE=p11sak-x509-pre.out
 P11SAK_X509_LONG=p11sak-x509-long.out
 P11SAK_X509_POST=p11sak-x509-post.out
+P11SAK_BATCH_MANIFEST=p11sak-batch-manifest.txt
 
 
 echo "** Setting SLOT=30 to the Softtoken unless otherwise set - 'p11sak_test.sh'"
@@ -367,6 +368,24 @@ else
 fi
 
 
+echo "** Now generating and importing keys in batch mode - 'p11sak_test.sh'"
+
+RC_P11SAK_BATCH=0
+cat > $P11SAK_BATCH_MANIFEST <<EOF
+# p11sak batch-key test manifest
+generate-key aes 256 --label "batch-aes 1" --attr sX
+generate-key aes 128 --label batch-aes-2
+generate-key rsa 2048 --label batch-rsa
+generate-key ec prime256v1 --label batch-ec
+import-key aes --label batch-import-aes --file $DIR/aes.key
+import-key rsa public --label batch-import-rsa --file $DIR/rsa-key.pem
+EOF
+${P11SAK} batch-key --slot $SLOT --pin $PKCS11_USER_PIN --file $P11SAK_BATCH_MANIFEST --threads 3
+RC_P11SAK_BATCH=$((RC_P11SAK_BATCH + $?))
+${P11SAK} remove-key --slot $SLOT --pin $PKCS11_USER_PIN --label "batch-*" -f
+RC_P11SAK_BATCH=$((RC_P11SAK_BATCH + $?))
+
+
 echo "** Now exporting keys - 'p11sak_test.sh'"
 
 RC_P11SAK_EXPORT=0
@@ -2033,6 +2052,13 @@ else
 	status=1
 fi
 
+if [ $RC_P11SAK_BATCH = 0 ]; then
+	echo "* TESTCASE batch-key PASS return code check"
+else
+	echo "* TESTCASE batch-key FAIL return code check"
+	status=1
+fi
+
 if [ $RC_P11SAK_EXPORT = 0 ]; then
 	echo "* TESTCASE export-key PASS return code check"
 else
@@ -2208,6 +2234,7 @@ rm -f $P11SAK_ALL_PINENV
 rm -f $P11SAK_ALL_PINCON
 rm -f $P11SAK_ALL_NOLOGIN
 rm -f $P11SAK_ALL_SO
+rm -f $P11SAK_BATCH_MANIFEST
 rm -f export-aes.key
 rm -f export-*.pem
 rm -f export-*.opaque
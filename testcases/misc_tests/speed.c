@@ -14,10 +14,14 @@
  *
  *    RSA keygen (with keylength 1024, 2048, 4096)
  *    RSA sign and verify (with keylength 1024, 2048, 4096)
+ *    RSA sign round robin with 1, 4, 16 and 32 different keys
  *    RSA encrypt and decrypt (with keylength 1024, 2048, 4096)
  *    DES3 encrypt and decrypt (with modes ECB and CBC)
  *    AES encrypt and decrypt (with modes ECB and CBC, with keylength 128, 192,
  *    256), SHA1, SHA256, SHA512
+ *    Session open and close (with 1, 4 and 16 concurrent processes)
+ *    Session close with many session objects in other sessions
+ *    AES encrypt with one key shared by 1, 4 and 16 concurrent threads
  */
 
 
@@ -25,8 +29,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <memory.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <pthread.h>
 
 #include "pkcs11types.h"
 #include "regress.h"
@@ -509,6 +516,131 @@ testcase_cleanup:
     return TRUE;
 }
 
+// Sign round robin with several keys, e.g. to see the cost of loading the
+// keys into a TPM, when the keys in use exceed the cached or loaded keys.
+int do_RSA_PKCS_SignKeys(int num_keys)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_ULONG i, len1, sig_len;
+    CK_BYTE signature[512];
+    CK_BYTE data1[100];
+    CK_OBJECT_HANDLE publ_key, priv_keys[32];
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG diff, avg_time, min_time, max_time, tot_time;
+    CK_ULONG iterations = 256;
+
+    CK_ULONG bits = 1024;
+    CK_BYTE pub_exp[] = { 0x01, 0x00, 0x01 };
+    CK_ATTRIBUTE pub_tmpl[] = {
+        {CKA_MODULUS_BITS, &bits, sizeof(bits)},
+        {CKA_PUBLIC_EXPONENT, &pub_exp, sizeof(pub_exp)}
+    };
+
+    testcase_begin("RSA PKCS Sign with %d keys keylen=%lu datalen=%lu",
+                   num_keys, bits, sizeof(data1));
+
+    if (num_keys > 32) {
+        testcase_error("too many keys");
+        return FALSE;
+    }
+    if (!mech_supported(SLOT_ID, CKM_RSA_PKCS_KEY_PAIR_GEN)) {
+        testcase_skip("Slot %lu doesn't support CKM_RSA_PKCS_KEY_PAIR_GEN (0x%x)",
+                      SLOT_ID, CKM_RSA_PKCS_KEY_PAIR_GEN);
+        return TRUE;
+    }
+    if (!mech_supported(SLOT_ID, CKM_RSA_PKCS)) {
+        testcase_skip("Slot %lu doesn't support CKM_RSA_PKCS (0x%x)",
+                      SLOT_ID, CKM_RSA_PKCS);
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    mech.mechanism = CKM_RSA_PKCS_KEY_PAIR_GEN;
+    mech.ulParameterLen = 0;
+    mech.pParameter = NULL;
+
+    for (i = 0; i < (CK_ULONG)num_keys; i++) {
+        rc = funcs->C_GenerateKeyPair(session, &mech, pub_tmpl, 2, NULL, 0,
+                                      &publ_key, &priv_keys[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    len1 = sizeof(data1);
+    for (i = 0; i < len1; i++)
+        data1[i] = (unsigned char) i;
+
+    mech.mechanism = CKM_RSA_PKCS;
+    mech.ulParameterLen = 0;
+    mech.pParameter = NULL;
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+
+        rc = funcs->C_SignInit(session, &mech, priv_keys[i % num_keys]);
+        if (rc != CKR_OK) {
+            testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        sig_len = sizeof(signature);
+        rc = funcs->C_Sign(session, data1, len1, signature, &sig_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_Sign rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        GetSystemTime(&t2);
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+    min_time /= 1000;
+    max_time /= 1000;
+    avg_time /= 1000;
+
+    printf("%lu iterations: total=%lums min=%lums max=%lums avg=%lums "
+           "op/s=%.3f\n", iterations, tot_time, min_time, max_time,
+           avg_time, (double) (iterations * 1000) / (double) tot_time);
+
+    testcase_pass("RSA PKCS Sign with %d keys keylen=%lu datalen=%lu",
+                  num_keys, bits, sizeof(data1));
+
+testcase_cleanup:
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
 // mode: ECB CBC
 int do_DES3_EncrDecr(const char *mode)
 {
@@ -1009,12 +1141,360 @@ testcase_cleanup:
     return TRUE;
 }
 
+static void do_Sessions_child(int ready_fd, int start_fd,
+                              CK_ULONG iterations)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_ULONG i;
+    CK_RV rc;
+    char c = 0;
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+    rc = funcs->C_Initialize(&cinit_args);
+    if (rc != CKR_OK) {
+        testcase_error("C_Initialize (child) rc=%s", p11_get_ckr(rc));
+        _exit(1);
+    }
+
+    /* Tell the parent we are ready and wait until all processes are */
+    if (write(ready_fd, &c, 1) != 1 || read(start_fd, &c, 1) != 0) {
+        funcs->C_Finalize(NULL);
+        _exit(1);
+    }
+
+    flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    for (i = 0; i < iterations; i++) {
+        rc = funcs->C_OpenSession(SLOT_ID, flags, NULL, NULL, &session);
+        if (rc != CKR_OK) {
+            testcase_error("C_OpenSession (child) rc=%s", p11_get_ckr(rc));
+            break;
+        }
+
+        rc = funcs->C_CloseSession(session);
+        if (rc != CKR_OK) {
+            testcase_error("C_CloseSession (child) rc=%s", p11_get_ckr(rc));
+            break;
+        }
+    }
+
+    funcs->C_Finalize(NULL);
+    _exit(rc == CKR_OK ? 0 : 1);
+}
+
+// processes: number of processes concurrently opening and closing sessions
+int do_Sessions(int processes)
+{
+    int ready_pipe[2], start_pipe[2];
+    int i, status, failed = 0, started = 0;
+    pid_t pid;
+    char c;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG tot_time;
+    CK_ULONG iterations = 20000;
+
+    testcase_begin("Session open/close with %d processes", processes);
+
+    testcase_new_assertion();
+
+    if (pipe(ready_pipe) != 0 || pipe(start_pipe) != 0) {
+        testcase_error("pipe failed");
+        return FALSE;
+    }
+
+    for (i = 0; i < processes; i++) {
+        pid = fork();
+        if (pid < 0) {
+            testcase_error("fork failed");
+            failed = 1;
+            break;
+        }
+        if (pid == 0) {
+            close(ready_pipe[0]);
+            close(start_pipe[1]);
+            do_Sessions_child(ready_pipe[1], start_pipe[0], iterations);
+        }
+        started++;
+    }
+
+    close(ready_pipe[1]);
+    close(start_pipe[0]);
+
+    for (i = 0; i < started; i++) {
+        if (read(ready_pipe[0], &c, 1) != 1) {
+            failed = 1;
+            break;
+        }
+    }
+
+    /* Start all processes at once by closing the start pipe */
+    GetSystemTime(&t1);
+    close(start_pipe[1]);
+
+    for (i = 0; i < started; i++) {
+        if (wait(&status) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0)
+            failed = 1;
+    }
+    GetSystemTime(&t2);
+    close(ready_pipe[0]);
+
+    if (failed) {
+        testcase_fail("Session open/close with %d processes", processes);
+        return FALSE;
+    }
+
+    // us -> ms
+    tot_time = delta_time_us(&t1, &t2) / 1000;
+    if (tot_time == 0)
+        tot_time = 1;
+
+    printf("%lu iterations per process: total=%lums op/s=%.3f\n",
+           iterations, tot_time,
+           (double) (iterations * processes * 1000) / (double) tot_time);
+
+    testcase_pass("Session open/close with %d processes", processes);
+
+    return TRUE;
+}
+
+// Closes sessions one by one, while all other sessions still own objects
+int do_SessionObjects(int num_sessions, int num_objects)
+{
+    CK_SESSION_HANDLE *sessions;
+    CK_OBJECT_HANDLE obj;
+    CK_FLAGS flags;
+    CK_RV rc = CKR_OK;
+    int i, k, opened = 0;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG diff, avg_time, min_time, max_time, tot_time;
+
+    CK_OBJECT_CLASS class = CKO_DATA;
+    CK_BBOOL false = FALSE;
+    CK_BYTE value[32] = { 0 };
+    CK_ATTRIBUTE data_tmpl[] = {
+        {CKA_CLASS, &class, sizeof(class)},
+        {CKA_TOKEN, &false, sizeof(false)},
+        {CKA_VALUE, value, sizeof(value)},
+    };
+
+    testcase_begin("Session close with %d sessions x %d objects",
+                   num_sessions, num_objects);
+
+    testcase_new_assertion();
+
+    sessions = calloc(num_sessions, sizeof(CK_SESSION_HANDLE));
+    if (sessions == NULL) {
+        testcase_error("calloc failed");
+        return FALSE;
+    }
+
+    flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    for (i = 0; i < num_sessions; i++) {
+        rc = funcs->C_OpenSession(SLOT_ID, flags, NULL, NULL, &sessions[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_OpenSession rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        opened++;
+
+        for (k = 0; k < num_objects; k++) {
+            rc = funcs->C_CreateObject(sessions[i], data_tmpl, 3, &obj);
+            if (rc != CKR_OK) {
+                testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+        }
+    }
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < num_sessions; i++) {
+        GetSystemTime(&t1);
+
+        rc = funcs->C_CloseSession(sessions[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_CloseSession rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        opened--;
+
+        GetSystemTime(&t2);
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    avg_time = tot_time / num_sessions;
+
+    // us -> ms
+    tot_time /= 1000;
+
+    printf("%d sessions closed: total=%lums min=%luus max=%luus avg=%luus\n",
+           num_sessions, tot_time, min_time, max_time, avg_time);
+
+    testcase_pass("Session close with %d sessions x %d objects",
+                  num_sessions, num_objects);
+
+testcase_cleanup:
+    if (opened > 0)
+        testcase_closeall_session();
+    free(sessions);
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
+struct shared_key_thread {
+    CK_OBJECT_HANDLE h_key;
+    CK_ULONG iterations;
+    CK_RV rc;
+};
+
+static void *do_SharedKey_thread(void *arg)
+{
+    struct shared_key_thread *th = arg;
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech = { CKM_AES_ECB, NULL, 0 };
+    CK_BYTE clear[16] = { 0 }, cipher[16];
+    CK_ULONG i, cipher_len;
+    CK_RV rc;
+
+    rc = funcs->C_OpenSession(SLOT_ID, CKF_SERIAL_SESSION, NULL, NULL,
+                              &session);
+    if (rc != CKR_OK)
+        goto out;
+
+    for (i = 0; i < th->iterations; i++) {
+        rc = funcs->C_EncryptInit(session, &mech, th->h_key);
+        if (rc != CKR_OK)
+            break;
+
+        cipher_len = sizeof(cipher);
+        rc = funcs->C_Encrypt(session, clear, sizeof(clear), cipher,
+                              &cipher_len);
+        if (rc != CKR_OK)
+            break;
+    }
+
+    funcs->C_CloseSession(session);
+out:
+    th->rc = rc;
+    return NULL;
+}
+
+// Many threads encrypting small blocks with one shared key object
+int do_SharedKey(int num_threads)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_OBJECT_HANDLE h_key;
+    pthread_t threads[16];
+    struct shared_key_thread th[16];
+    CK_ULONG iterations = 20000;
+    int i, started = 0;
+
+    SYSTEMTIME t1, t2;
+    CK_ULONG tot_time;
+
+    testcase_begin("AES encrypt with one key and %d threads", num_threads);
+
+    if (num_threads > 16) {
+        testcase_error("too many threads");
+        return FALSE;
+    }
+    if (!mech_supported(SLOT_ID, CKM_AES_KEY_GEN) ||
+        !mech_supported(SLOT_ID, CKM_AES_ECB)) {
+        testcase_skip("Slot %lu doesn't support CKM_AES_KEY_GEN or "
+                      "CKM_AES_ECB", SLOT_ID);
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    mech.mechanism = CKM_AES_KEY_GEN;
+    mech.ulParameterLen = 0;
+    mech.pParameter = NULL;
+
+    rc = generate_AESKey(session, 16, CK_TRUE, &mech, &h_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("AES key generation is not allowed by policy");
+            goto testcase_cleanup;
+        }
+        testcase_error("C_GenerateKey rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    GetSystemTime(&t1);
+
+    for (i = 0; i < num_threads; i++) {
+        th[i].h_key = h_key;
+        th[i].iterations = iterations;
+        th[i].rc = CKR_OK;
+        if (pthread_create(&threads[i], NULL, do_SharedKey_thread,
+                           &th[i]) != 0) {
+            testcase_error("pthread_create failed");
+            rc = CKR_FUNCTION_FAILED;
+            break;
+        }
+        started++;
+    }
+
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        if (th[i].rc != CKR_OK && rc == CKR_OK) {
+            testcase_error("thread %d rc=%s", i, p11_get_ckr(th[i].rc));
+            rc = th[i].rc;
+        }
+    }
+
+    GetSystemTime(&t2);
+    tot_time = delta_time_us(&t1, &t2);
+
+    if (rc != CKR_OK)
+        goto testcase_cleanup;
+
+    printf("%lu operations with %d threads: total=%lums ops/s=%lu\n",
+           iterations * num_threads, num_threads, tot_time / 1000,
+           (CK_ULONG)((unsigned long long)iterations * num_threads *
+                      1000000 / tot_time));
+
+    testcase_pass("AES encrypt with one key and %d threads", num_threads);
+
+testcase_cleanup:
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
 void speed_usage(char *fct)
 {
     printf("usage:  %s -slot <num>", fct);
-    printf(" [-rsa_keygen] [-rsa_signverify]");
-    printf(" [-rsa_endecrypt] [-des3] [-aes] [-sha]");
-    printf(" [-h] \n\n");
+    printf(" [-rsa_keygen] [-rsa_signverify] [-rsa_signkeys]");
+    printf(" [-rsa_endecrypt] [-des3] [-aes] [-sha] [-sessions] [-sessobj]");
+    printf(" [-sharedkey] [-h] \n\n");
 
     return;
 }
@@ -1025,10 +1505,14 @@ int main(int argc, char **argv)
     int rc, i;
     int do_rsa_keygen = 0;
     int do_rsa_signverify = 0;
+    int do_rsa_signkeys = 0;
     int do_rsa_endecrypt = 0;
     int do_des3_endecrypt = 0;
     int do_aes_endecrypt = 0;
     int do_sha = 0;
+    int do_sessions = 0;
+    int do_sessobj = 0;
+    int do_sharedkey = 0;
 
     SLOT_ID = 1000;
 
@@ -1046,6 +1530,8 @@ int main(int argc, char **argv)
             do_rsa_keygen = 1;
         } else if (strcmp(argv[i], "-rsa_signverify") == 0) {
             do_rsa_signverify = 1;
+        } else if (strcmp(argv[i], "-rsa_signkeys") == 0) {
+            do_rsa_signkeys = 1;
         } else if (strcmp(argv[i], "-rsa_endecrypt") == 0) {
             do_rsa_endecrypt = 1;
         } else if (strcmp(argv[i], "-des3") == 0) {
@@ -1054,6 +1540,12 @@ int main(int argc, char **argv)
             do_aes_endecrypt = 1;
         } else if (strcmp(argv[i], "-sha") == 0) {
             do_sha = 1;
+        } else if (strcmp(argv[i], "-sessions") == 0) {
+            do_sessions = 1;
+        } else if (strcmp(argv[i], "-sessobj") == 0) {
+            do_sessobj = 1;
+        } else if (strcmp(argv[i], "-sharedkey") == 0) {
+            do_sharedkey = 1;
         } else if (strcmp(argv[i], "-h") == 0) {
             speed_usage(argv[0]);
             return 0;
@@ -1071,14 +1563,19 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    if (do_rsa_keygen + do_rsa_signverify + do_rsa_endecrypt
-        + do_des3_endecrypt + do_aes_endecrypt + do_sha == 0) {
+    if (do_rsa_keygen + do_rsa_signverify + do_rsa_signkeys + do_rsa_endecrypt
+        + do_des3_endecrypt + do_aes_endecrypt + do_sha + do_sessions
+        + do_sessobj + do_sharedkey == 0) {
         do_rsa_keygen = 1;
         do_rsa_signverify = 1;
+        do_rsa_signkeys = 1;
         do_rsa_endecrypt = 1;
         do_des3_endecrypt = 1;
         do_aes_endecrypt = 1;
         do_sha = 1;
+        do_sessions = 1;
+        do_sessobj = 1;
+        do_sharedkey = 1;
     }
 
     printf("Using slot #%lu...\n\n", SLOT_ID);
@@ -1120,6 +1617,22 @@ int main(int argc, char **argv)
             goto out;
     }
 
+    if (do_rsa_signkeys) {
+        testsuite_begin("RSA Sign with several keys.");
+        rc = do_RSA_PKCS_SignKeys(1);
+        if (!rc)
+            goto out;
+        rc = do_RSA_PKCS_SignKeys(4);
+        if (!rc)
+            goto out;
+        rc = do_RSA_PKCS_SignKeys(16);
+        if (!rc)
+            goto out;
+        rc = do_RSA_PKCS_SignKeys(32);
+        if (!rc)
+            goto out;
+    }
+
     if (do_rsa_endecrypt) {
         testsuite_begin("RSA Encrypt/Decrypt.");
         rc = do_RSA_PKCS_EncryptDecrypt(1024);
@@ -1178,6 +1691,39 @@ int main(int argc, char **argv)
             goto out;
     }
 
+    if (do_sessions) {
+        testsuite_begin("Session open/close.");
+        rc = do_Sessions(1);
+        if (!rc)
+            goto out;
+        rc = do_Sessions(4);
+        if (!rc)
+            goto out;
+        rc = do_Sessions(16);
+        if (!rc)
+            goto out;
+    }
+
+    if (do_sessobj) {
+        testsuite_begin("Session close with session objects.");
+        rc = do_SessionObjects(200, 50);
+        if (!rc)
+            goto out;
+    }
+
+    if (do_sharedkey) {
+        testsuite_begin("AES encrypt with a shared key.");
+        rc = do_SharedKey(1);
+        if (!rc)
+            goto out;
+        rc = do_SharedKey(4);
+        if (!rc)
+            goto out;
+        rc = do_SharedKey(16);
+        if (!rc)
+            goto out;
+    }
+
 out:
     testcase_print_result();
 
@@ -0,0 +1,38 @@
+if !AIX
+noinst_LTLIBRARIES += testcases/mock/libcsulcca.la testcases/mock/libep11.la
+
+noinst_HEADERS += testcases/mock/mock_common.h
+
+EXTRA_DIST += testcases/mock/mock_tests.sh
+
+# Shared objects, so the CCA and EP11 tokens can load them instead of the
+# real host libraries
+testcases_mock_libcsulcca_la_CFLAGS =					\
+	-I${srcdir}/testcases/mock -I${srcdir}/usr/lib/cca_stdll	\
+	-I${srcdir}/usr/lib/common -I${srcdir}/usr/include		\
+	-I${top_builddir}/usr/lib/api -I${srcdir}/usr/lib/api		\
+	-I${top_builddir}/usr/lib/config -I${srcdir}/usr/lib/config	\
+	-I${srcdir}/usr/lib/hsm_mk_change				\
+	-I${top_builddir}/usr/lib/hsm_mk_change
+
+testcases_mock_libcsulcca_la_LDFLAGS =					\
+	-module -shared -avoid-version -rpath ${abs_builddir}		\
+	-lcrypto -lpthread
+
+testcases_mock_libcsulcca_la_SOURCES =					\
+	testcases/mock/mock_csulcca.c					\
+	testcases/mock/mock_csulcca_unsupported.c			\
+	testcases/mock/mock_common.c
+
+testcases_mock_libep11_la_CFLAGS =					\
+	-I${srcdir}/testcases/mock -I${srcdir}/usr/lib/ep11_stdll	\
+	-I${srcdir}/usr/lib/common -I${srcdir}/usr/include
+
+testcases_mock_libep11_la_LDFLAGS =					\
+	-module -shared -avoid-version -rpath ${abs_builddir}		\
+	-lcrypto -lpthread
+
+testcases_mock_libep11_la_SOURCES =					\
+	testcases/mock/mock_ep11.c testcases/mock/mock_ep11_unsupported.c \
+	testcases/mock/mock_common.c
+endif
@@ -0,0 +1,115 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_common.c
+//
+// Latency and error injection, and call counting, shared by the mock host
+// libraries. Every mock entry point calls mock_enter() first. The settings
+// of an entry point are read from the environment on its first call. When
+// OCK_MOCK_STATS is set, the call counts of all entry points that have been
+// called are printed to stderr when the library is unloaded.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mock_common.h"
+
+static pthread_mutex_t mock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct mock_fn *mock_fns;
+
+static unsigned long mock_getenv_ulong(const char *var, const char *fn,
+                                       unsigned long dflt)
+{
+    char name[64];
+    const char *val;
+
+    if (fn != NULL) {
+        snprintf(name, sizeof(name), "%s_%s", var, fn);
+        val = getenv(name);
+    } else {
+        val = getenv(var);
+    }
+
+    if (val == NULL || *val == '\0')
+        return dflt;
+
+    return strtoul(val, NULL, 0);
+}
+
+static void mock_fn_init(struct mock_fn *fn)
+{
+    pthread_mutex_lock(&mock_mutex);
+
+    if (fn->init == 0) {
+        fn->latency = mock_getenv_ulong(MOCK_ENV_LATENCY, fn->name,
+                            mock_getenv_ulong(MOCK_ENV_LATENCY, NULL, 0));
+        fn->fail_every = mock_getenv_ulong(MOCK_ENV_FAIL_EVERY, fn->name,
+                            mock_getenv_ulong(MOCK_ENV_FAIL_EVERY, NULL, 0));
+        fn->next = mock_fns;
+        mock_fns = fn;
+        __atomic_store_n(&fn->init, 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&mock_mutex);
+}
+
+/*
+ * Counts the call, and delays it by the configured latency. Returns 1 if
+ * the call must fail with the injected error, 0 otherwise.
+ */
+int mock_enter(struct mock_fn *fn)
+{
+    struct timespec ts;
+    unsigned long calls;
+
+    if (__atomic_load_n(&fn->init, __ATOMIC_ACQUIRE) == 0)
+        mock_fn_init(fn);
+
+    calls = __atomic_add_fetch(&fn->calls, 1, __ATOMIC_RELAXED);
+
+    if (fn->latency != 0) {
+        ts.tv_sec = fn->latency / 1000000;
+        ts.tv_nsec = (fn->latency % 1000000) * 1000;
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+            ;
+    }
+
+    if (fn->fail_every != 0 && calls % fn->fail_every == 0) {
+        __atomic_add_fetch(&fn->failed, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Returns the error code to inject, or dflt if none is configured */
+unsigned long mock_fail_code(unsigned long dflt)
+{
+    return mock_getenv_ulong(MOCK_ENV_FAIL_CODE, NULL, dflt);
+}
+
+__attribute__((destructor))
+static void mock_stats(void)
+{
+    struct mock_fn *fn;
+
+    if (getenv(MOCK_ENV_STATS) == NULL)
+        return;
+
+    pthread_mutex_lock(&mock_mutex);
+    for (fn = mock_fns; fn != NULL; fn = fn->next)
+        fprintf(stderr, "mock: %-20s calls: %10lu failed: %10lu\n",
+                fn->name, fn->calls, fn->failed);
+    pthread_mutex_unlock(&mock_mutex);
+}
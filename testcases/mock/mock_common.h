@@ -0,0 +1,42 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef MOCK_COMMON_H
+#define MOCK_COMMON_H
+
+#include <stddef.h>
+
+/*
+ * Environment variables controlling the mock host libraries. The per entry
+ * point variants take precedence, e.g. OCK_MOCK_LATENCY_CSNBSAE=200 delays
+ * every CSNBSAE call by 200 microseconds.
+ */
+#define MOCK_ENV_LATENCY        "OCK_MOCK_LATENCY"      /* usec per call */
+#define MOCK_ENV_FAIL_EVERY     "OCK_MOCK_FAIL_EVERY"   /* fail every n-th */
+#define MOCK_ENV_FAIL_CODE      "OCK_MOCK_FAIL_CODE"    /* injected error */
+#define MOCK_ENV_STATS          "OCK_MOCK_STATS"        /* print call stats */
+
+/* State of one entry point of a mock host library */
+struct mock_fn {
+    const char *name;
+    unsigned long latency;
+    unsigned long fail_every;
+    unsigned long calls;
+    unsigned long failed;
+    struct mock_fn *next;
+    int init;
+};
+
+#define MOCK_FN_INIT(fn)        { #fn, 0, 0, 0, 0, NULL, 0 }
+
+int mock_enter(struct mock_fn *fn);
+unsigned long mock_fail_code(unsigned long dflt);
+
+#endif
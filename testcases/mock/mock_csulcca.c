@@ -0,0 +1,1482 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_csulcca.c
+//
+// Mock CCA host library (libcsulcca.so) for testing the CCA token without
+// a crypto adapter. It emulates a single adapter with one domain and valid
+// current master keys, and implements the verbs needed for AES keys, AES
+// encryption, RSA key generation, RSA PKCS #1 v1.5 signatures, digests and
+// random numbers in software. All other verbs are exported by
+// mock_csulcca_unsupported.c and fail.
+//
+// AES keys are CCA internal AES DATA key tokens of 64 bytes. The key value
+// in the token is encrypted with a fixed mock master key, and the token
+// carries the mock AES master key verification pattern. Thus, tokens are
+// opaque to the CCA token as with a real adapter.
+//
+// The digest chaining vector holds a pointer to an OpenSSL digest context,
+// so multi-part digests can not be continued in another process.
+//
+// RSA private key tokens are internal tokens in ME format that carry the DER
+// encoded private key, encrypted with the mock master key, in place of the
+// private exponent. See mock_cca_rsa_token_build().
+//
+// Return code 8 (error) and 12 (not performed) are used as with the real
+// library, but the reason codes are specific to the mock. Only a bad
+// signature is reported with return code 4 and reason code 429 as with the
+// real library.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <endian.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+
+#include "cca_stdll.h"
+#include "mock_common.h"
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+#include <openssl/core_names.h>
+#include <openssl/param_build.h>
+#endif
+
+#define MOCK_CCA_RC_SIGNATURE       4
+#define MOCK_CCA_RC_ERROR           8
+#define MOCK_CCA_RC_FAILED          12
+
+#define MOCK_CCA_REASON_KEYWORD     1   /* unsupported rule array keyword */
+#define MOCK_CCA_REASON_LENGTH      2   /* invalid data or buffer length */
+#define MOCK_CCA_REASON_TOKEN       3   /* invalid key token */
+#define MOCK_CCA_REASON_CRYPTO      4   /* OpenSSL failure */
+#define MOCK_CCA_REASON_PADDING     5   /* invalid padding */
+#define MOCK_CCA_REASON_SIGNATURE   429 /* signature mismatch */
+
+#define MOCK_CCA_LIB_VERSION        "8.1.0c mock"
+#define MOCK_CCA_CARD_VERSION       "8.1.00  "
+#define MOCK_CCA_SERIALNO           "MOCK0001"
+
+/* Internal AES DATA key token, see analyse_cca_key_token() */
+#define MOCK_CCA_AES_TOKEN_VERSION  0x04
+#define MOCK_CCA_AES_TOKEN_FLAGS    7
+#define MOCK_CCA_AES_TOKEN_MKVP     8
+#define MOCK_CCA_AES_TOKEN_KEY      16
+#define MOCK_CCA_AES_TOKEN_BITS     56
+#define MOCK_CCA_AES_TOKEN_TVV      60
+#define MOCK_CCA_AES_TOKEN_HAS_KEY  0x80
+
+/* Internal RSA private key token, ME format, see mock_cca_rsa_token_build() */
+#define MOCK_CCA_RSA_TOKEN_MKVP     104
+#define MOCK_CCA_RSA_MAX_DER        2560    /* RSA 4096 private key */
+
+#define MOCK_CCA_HASH_MAGIC         "MOCKHASH"
+
+#define MOCK_CCA_ENTER(verb)                                             \
+    static struct mock_fn mock_fn = MOCK_FN_INIT(verb);                  \
+    if (mock_enter(&mock_fn)) {                                          \
+        *return_code = MOCK_CCA_RC_FAILED;                               \
+        *reason_code = mock_fail_code(0);                                \
+        return;                                                          \
+    }                                                                    \
+    *return_code = CCA_SUCCESS;                                          \
+    *reason_code = 0
+
+struct mock_cca_hash_chain {
+    char magic[8];
+    EVP_MD_CTX *ctx;
+};
+
+static const unsigned char mock_cca_aes_mk[32] = {
+    0x6f, 0x63, 0x6b, 0x2d, 0x6d, 0x6f, 0x63, 0x6b,
+    0x2d, 0x63, 0x63, 0x61, 0x2d, 0x61, 0x65, 0x73,
+    0x2d, 0x6d, 0x61, 0x73, 0x74, 0x65, 0x72, 0x2d,
+    0x6b, 0x65, 0x79, 0x2d, 0x30, 0x30, 0x30, 0x31,
+};
+
+static const unsigned char mock_cca_sym_mkvp[CCA_MKVP_LENGTH] = {
+    0x4d, 0x4f, 0x43, 0x4b, 0x2d, 0x53, 0x59, 0x4d,
+};
+
+static const unsigned char mock_cca_aes_mkvp[CCA_MKVP_LENGTH] = {
+    0x4d, 0x4f, 0x43, 0x4b, 0x2d, 0x41, 0x45, 0x53,
+};
+
+static const unsigned char mock_cca_apka_mkvp[CCA_MKVP_LENGTH] = {
+    0x4d, 0x4f, 0x43, 0x4b, 0x2d, 0x50, 0x4b, 0x41,
+};
+
+static int mock_cca_keyword(const unsigned char *rule_array, long count,
+                            const char *keyword)
+{
+    long i;
+
+    for (i = 0; i < count; i++) {
+        if (memcmp(rule_array + i * CCA_KEYWORD_SIZE, keyword,
+                   CCA_KEYWORD_SIZE) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Returns 1 if all keywords of the rule array are in the list */
+static int mock_cca_keywords_valid(const unsigned char *rule_array, long count,
+                                   const char *const *valid)
+{
+    const char *const *kw;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        for (kw = valid; *kw != NULL; kw++) {
+            if (memcmp(rule_array + i * CCA_KEYWORD_SIZE, *kw,
+                       CCA_KEYWORD_SIZE) == 0)
+                break;
+        }
+        if (*kw == NULL)
+            return 0;
+    }
+
+    return 1;
+}
+
+static uint32_t mock_cca_tvv(const unsigned char *token)
+{
+    uint32_t tvv = 0, word;
+    int i;
+
+    for (i = 0; i < MOCK_CCA_AES_TOKEN_TVV; i += 4) {
+        memcpy(&word, token + i, sizeof(word));
+        tvv += be32toh(word);
+    }
+
+    return tvv;
+}
+
+static void mock_cca_aes_token_skeleton(unsigned char *token,
+                                        unsigned int keylen)
+{
+    uint16_t bits = htobe16(keylen * 8);
+    uint32_t tvv;
+
+    memset(token, 0, CCA_KEY_ID_SIZE);
+    token[0] = 0x01;
+    token[4] = MOCK_CCA_AES_TOKEN_VERSION;
+    memcpy(token + MOCK_CCA_AES_TOKEN_MKVP, mock_cca_aes_mkvp,
+           CCA_MKVP_LENGTH);
+    memcpy(token + MOCK_CCA_AES_TOKEN_BITS, &bits, sizeof(bits));
+    tvv = htobe32(mock_cca_tvv(token));
+    memcpy(token + MOCK_CCA_AES_TOKEN_TVV, &tvv, sizeof(tvv));
+}
+
+/* Encrypts or decrypts the 32 byte key field with the mock master key */
+static int mock_cca_aes_token_crypt(const unsigned char *in,
+                                    unsigned char *out, int encrypt)
+{
+    EVP_CIPHER_CTX *ctx;
+    int len, ok;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return 0;
+
+    ok = EVP_CipherInit_ex(ctx, EVP_aes_256_ecb(), NULL, mock_cca_aes_mk,
+                           NULL, encrypt) == 1 &&
+         EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+         EVP_CipherUpdate(ctx, out, &len, in, 32) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return ok;
+}
+
+static long mock_cca_aes_token_set_key(unsigned char *token,
+                                       const unsigned char *key,
+                                       unsigned int keylen)
+{
+    unsigned char buf[32] = { 0 };
+    uint32_t tvv;
+    int ok;
+
+    if (keylen != 16 && keylen != 24 && keylen != 32)
+        return MOCK_CCA_REASON_LENGTH;
+
+    mock_cca_aes_token_skeleton(token, keylen);
+
+    memcpy(buf, key, keylen);
+    ok = mock_cca_aes_token_crypt(buf, token + MOCK_CCA_AES_TOKEN_KEY, 1);
+    OPENSSL_cleanse(buf, sizeof(buf));
+    if (!ok)
+        return MOCK_CCA_REASON_CRYPTO;
+
+    token[MOCK_CCA_AES_TOKEN_FLAGS] = MOCK_CCA_AES_TOKEN_HAS_KEY;
+    tvv = htobe32(mock_cca_tvv(token));
+    memcpy(token + MOCK_CCA_AES_TOKEN_TVV, &tvv, sizeof(tvv));
+
+    return 0;
+}
+
+static long mock_cca_aes_token_get_key(const unsigned char *token, long len,
+                                       unsigned char *key,
+                                       unsigned int *keylen)
+{
+    unsigned char buf[32];
+    uint16_t bits;
+    uint32_t tvv;
+
+    if (len != CCA_KEY_ID_SIZE || token[0] != 0x01 ||
+        token[4] != MOCK_CCA_AES_TOKEN_VERSION ||
+        token[MOCK_CCA_AES_TOKEN_FLAGS] != MOCK_CCA_AES_TOKEN_HAS_KEY ||
+        memcmp(token + MOCK_CCA_AES_TOKEN_MKVP, mock_cca_aes_mkvp,
+               CCA_MKVP_LENGTH) != 0)
+        return MOCK_CCA_REASON_TOKEN;
+
+    memcpy(&tvv, token + MOCK_CCA_AES_TOKEN_TVV, sizeof(tvv));
+    if (be32toh(tvv) != mock_cca_tvv(token))
+        return MOCK_CCA_REASON_TOKEN;
+
+    memcpy(&bits, token + MOCK_CCA_AES_TOKEN_BITS, sizeof(bits));
+    *keylen = be16toh(bits) / 8;
+    if (*keylen != 16 && *keylen != 24 && *keylen != 32)
+        return MOCK_CCA_REASON_TOKEN;
+
+    if (!mock_cca_aes_token_crypt(token + MOCK_CCA_AES_TOKEN_KEY, buf, 0))
+        return MOCK_CCA_REASON_CRYPTO;
+
+    memcpy(key, buf, *keylen);
+    OPENSSL_cleanse(buf, sizeof(buf));
+
+    return 0;
+}
+
+static const EVP_CIPHER *mock_cca_aes_cipher(unsigned int keylen, int ecb)
+{
+    switch (keylen) {
+    case 16:
+        return ecb ? EVP_aes_128_ecb() : EVP_aes_128_cbc();
+    case 24:
+        return ecb ? EVP_aes_192_ecb() : EVP_aes_192_cbc();
+    default:
+        return ecb ? EVP_aes_256_ecb() : EVP_aes_256_cbc();
+    }
+}
+
+/* Common part of CSNBSAE and CSNBSAD */
+static void mock_cca_aes_crypt(long *return_code, long *reason_code,
+                               long rule_array_count,
+                               const unsigned char *rule_array,
+                               long key_length,
+                               const unsigned char *key_identifier,
+                               const long *iv_length, const unsigned char *iv,
+                               long *chain_length, unsigned char *chain,
+                               long in_length, const unsigned char *in,
+                               long *out_length, unsigned char *out,
+                               int encrypt)
+{
+    static const char *const valid[] = {
+        "AES     ", "ECB     ", "CBC     ", "PKCS-PAD", "KEYIDENT",
+        "INITIAL ", "CONTINUE", NULL,
+    };
+    unsigned char key[32], pad[AES_BLOCK_SIZE], icv[AES_BLOCK_SIZE];
+    unsigned int keylen, i;
+    EVP_CIPHER_CTX *ctx = NULL;
+    long needed, reason;
+    int ecb, padding, len1 = 0, len2 = 0;
+
+    if (!mock_cca_keywords_valid(rule_array, rule_array_count, valid)) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    ecb = mock_cca_keyword(rule_array, rule_array_count, "ECB     ");
+    padding = mock_cca_keyword(rule_array, rule_array_count, "PKCS-PAD");
+
+    if (in_length < 0 ||
+        (!(encrypt && padding) && in_length % AES_BLOCK_SIZE != 0) ||
+        (!encrypt && padding && in_length == 0)) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    needed = in_length;
+    if (encrypt && padding)
+        needed = (in_length / AES_BLOCK_SIZE + 1) * AES_BLOCK_SIZE;
+    if (*out_length < needed) {
+        *out_length = needed;
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    if (!ecb) {
+        if (mock_cca_keyword(rule_array, rule_array_count, "CONTINUE")) {
+            if (chain == NULL || *chain_length < AES_BLOCK_SIZE)
+                goto length_error;
+            memcpy(icv, chain, AES_BLOCK_SIZE);
+        } else {
+            if (iv == NULL || *iv_length != AES_BLOCK_SIZE)
+                goto length_error;
+            memcpy(icv, iv, AES_BLOCK_SIZE);
+        }
+    }
+
+    reason = mock_cca_aes_token_get_key(key_identifier, key_length, key,
+                                        &keylen);
+    if (reason != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = reason;
+        return;
+    }
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL ||
+        EVP_CipherInit_ex(ctx, mock_cca_aes_cipher(keylen, ecb), NULL, key,
+                          ecb ? NULL : icv, encrypt) != 1 ||
+        EVP_CIPHER_CTX_set_padding(ctx, 0) != 1 ||
+        EVP_CipherUpdate(ctx, out, &len1, in,
+                         in_length - in_length % AES_BLOCK_SIZE) != 1)
+        goto crypto_error;
+
+    if (encrypt && padding) {
+        memset(pad, AES_BLOCK_SIZE - in_length % AES_BLOCK_SIZE,
+               sizeof(pad));
+        memcpy(pad, in + len1, in_length % AES_BLOCK_SIZE);
+        if (EVP_CipherUpdate(ctx, out + len1, &len2, pad, sizeof(pad)) != 1)
+            goto crypto_error;
+    }
+
+    if (chain != NULL && *chain_length >= AES_BLOCK_SIZE && !ecb)
+        memcpy(chain, encrypt ? out + len1 + len2 - AES_BLOCK_SIZE :
+                                in + in_length - AES_BLOCK_SIZE,
+               AES_BLOCK_SIZE);
+
+    *out_length = len1 + len2;
+
+    if (!encrypt && padding) {
+        pad[0] = out[len1 - 1];
+        if (pad[0] == 0 || pad[0] > AES_BLOCK_SIZE) {
+            *return_code = MOCK_CCA_RC_ERROR;
+            *reason_code = MOCK_CCA_REASON_PADDING;
+            goto out;
+        }
+        for (i = 1; i <= pad[0]; i++) {
+            if (out[len1 - i] != pad[0]) {
+                *return_code = MOCK_CCA_RC_ERROR;
+                *reason_code = MOCK_CCA_REASON_PADDING;
+                goto out;
+            }
+        }
+        *out_length = len1 - pad[0];
+    }
+
+    goto out;
+
+length_error:
+    *return_code = MOCK_CCA_RC_ERROR;
+    *reason_code = MOCK_CCA_REASON_LENGTH;
+    goto out;
+
+crypto_error:
+    *return_code = MOCK_CCA_RC_ERROR;
+    *reason_code = MOCK_CCA_REASON_CRYPTO;
+
+out:
+    OPENSSL_cleanse(key, sizeof(key));
+    EVP_CIPHER_CTX_free(ctx);
+}
+
+void SECURITYAPI CSUACFV(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *version_data_length,
+                         unsigned char *version_data)
+{
+    MOCK_CCA_ENTER(CSUACFV);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+
+    if (*version_data_length < (long)sizeof(MOCK_CCA_LIB_VERSION)) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    memcpy(version_data, MOCK_CCA_LIB_VERSION, sizeof(MOCK_CCA_LIB_VERSION));
+    *version_data_length = sizeof(MOCK_CCA_LIB_VERSION);
+}
+
+static void mock_cca_put_mkvp(unsigned char *verb_data, unsigned int id_offset,
+                              uint16_t id, const unsigned char *mkvp)
+{
+    id = htobe16(id);
+    memcpy(verb_data + id_offset, &id, sizeof(id));
+    if (mkvp != NULL)
+        memcpy(verb_data + id_offset + 2, mkvp, CCA_MKVP_LENGTH);
+}
+
+void SECURITYAPI CSUACFQ(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *verb_data_length, unsigned char *verb_data)
+{
+    uint32_t val;
+
+    MOCK_CCA_ENTER(CSUACFQ);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+
+    if (*rule_array_count != 1) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    if (memcmp(rule_array, "STATCRD2", CCA_KEYWORD_SIZE) == 0) {
+        /* Number of adapters and serial number of the current adapter */
+        memset(rule_array, ' ', CCA_STATCRD2_SERIAL_NUMBER_OFFSET +
+                                CCA_SERIALNO_LENGTH);
+        rule_array[CCA_KEYWORD_SIZE - 1] = '1';
+        memcpy(rule_array + CCA_STATCRD2_SERIAL_NUMBER_OFFSET,
+               MOCK_CCA_SERIALNO, CCA_SERIALNO_LENGTH);
+        *rule_array_count = (CCA_STATCRD2_SERIAL_NUMBER_OFFSET +
+                             CCA_SERIALNO_LENGTH) / CCA_KEYWORD_SIZE;
+    } else if (memcmp(rule_array, "STATCCAE", CCA_KEYWORD_SIZE) == 0 ||
+               memcmp(rule_array, "STATAES ", CCA_KEYWORD_SIZE) == 0 ||
+               memcmp(rule_array, "STATAPKA", CCA_KEYWORD_SIZE) == 0) {
+        /* New master key register empty, current master key valid */
+        memcpy(rule_array, "1       2       ", 2 * CCA_KEYWORD_SIZE);
+        *rule_array_count = 2;
+    } else if (memcmp(rule_array, "STATCCA ", CCA_KEYWORD_SIZE) == 0) {
+        memset(rule_array, ' ', CCA_STATCCA_CCA_VERSION_OFFSET +
+                                CCA_STATCCA_CCA_VERSION_LENGTH);
+        memcpy(rule_array + CCA_STATCCA_CCA_VERSION_OFFSET,
+               MOCK_CCA_CARD_VERSION, CCA_STATCCA_CCA_VERSION_LENGTH);
+        *rule_array_count = (CCA_STATCCA_CCA_VERSION_OFFSET +
+                             CCA_STATCCA_CCA_VERSION_LENGTH) /
+                                                    CCA_KEYWORD_SIZE;
+    } else if (memcmp(rule_array, "STATICSB", CCA_KEYWORD_SIZE) == 0) {
+        if (*verb_data_length < CCA_STATICSB_APKA_NMK_MKVP_OFFSET +
+                                CCA_MKVP_LENGTH) {
+            *return_code = MOCK_CCA_RC_ERROR;
+            *reason_code = MOCK_CCA_REASON_LENGTH;
+            return;
+        }
+        memset(verb_data, 0, *verb_data_length);
+        mock_cca_put_mkvp(verb_data, CCA_STATICSB_SYM_CMK_ID_OFFSET,
+                          CCA_STATICSB_SYM_CMK_ID, mock_cca_sym_mkvp);
+        mock_cca_put_mkvp(verb_data, CCA_STATICSB_SYM_NMK_ID_OFFSET,
+                          CCA_STATICSB_SYM_NMK_ID, NULL);
+        mock_cca_put_mkvp(verb_data, CCA_STATICSB_AES_CMK_ID_OFFSET,
+                          CCA_STATICSB_AES_CMK_ID, mock_cca_aes_mkvp);
+        mock_cca_put_mkvp(verb_data, CCA_STATICSB_AES_NMK_ID_OFFSET,
+                          CCA_STATICSB_AES_NMK_ID, NULL);
+        mock_cca_put_mkvp(verb_data, CCA_STATICSB_APKA_CMK_ID_OFFSET,
+                          CCA_STATICSB_APKA_CMK_ID, mock_cca_apka_mkvp);
+        mock_cca_put_mkvp(verb_data, CCA_STATICSB_APKA_NMK_ID_OFFSET,
+                          CCA_STATICSB_APKA_NMK_ID, NULL);
+        *verb_data_length = CCA_STATICSB_APKA_NMK_MKVP_OFFSET +
+                            CCA_MKVP_LENGTH;
+    } else if (memcmp(rule_array, "DOM-NUMS", CCA_KEYWORD_SIZE) == 0 ||
+               memcmp(rule_array, "DOM-USAG", CCA_KEYWORD_SIZE) == 0) {
+        /* A single usage domain 0 */
+        if (*verb_data_length < (long)sizeof(val)) {
+            *return_code = MOCK_CCA_RC_ERROR;
+            *reason_code = MOCK_CCA_REASON_LENGTH;
+            return;
+        }
+        val = htobe32(rule_array[4] == 'N' ? 1 : 0);
+        memcpy(verb_data, &val, sizeof(val));
+        *verb_data_length = sizeof(val);
+    } else {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+    }
+}
+
+void SECURITYAPI CSUACRA(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *resource_name_length,
+                         unsigned char *resource_name)
+{
+    MOCK_CCA_ENTER(CSUACRA);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(rule_array_count);
+    UNUSED(rule_array);
+    UNUSED(resource_name_length);
+    UNUSED(resource_name);
+}
+
+void SECURITYAPI CSUACRD(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *resource_name_length,
+                         unsigned char *resource_name)
+{
+    MOCK_CCA_ENTER(CSUACRD);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(rule_array_count);
+    UNUSED(rule_array);
+    UNUSED(resource_name_length);
+    UNUSED(resource_name);
+}
+
+void SECURITYAPI CSNBRNG(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         unsigned char *form, unsigned char *random_number)
+{
+    MOCK_CCA_ENTER(CSNBRNG);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(form);
+
+    if (RAND_bytes(random_number, CCA_RNG_SIZE) != 1) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_CRYPTO;
+    }
+}
+
+void SECURITYAPI CSNBRNGL(long *return_code, long *reason_code,
+                          long *exit_data_length, unsigned char *exit_data,
+                          long *rule_array_count, unsigned char *rule_array,
+                          long *reserved_length, unsigned char *reserved,
+                          long *random_number_length,
+                          unsigned char *random_number)
+{
+    MOCK_CCA_ENTER(CSNBRNGL);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(rule_array_count);
+    UNUSED(rule_array);
+    UNUSED(reserved_length);
+    UNUSED(reserved);
+
+    if (*random_number_length < 0 || *random_number_length > 8192) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    if (RAND_bytes(random_number, *random_number_length) != 1) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_CRYPTO;
+    }
+}
+
+void SECURITYAPI CSNBKTB(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         unsigned char *key_token, unsigned char *key_type,
+                         long *rule_array_count, unsigned char *rule_array,
+                         unsigned char *key_value, void *reserved_field_1,
+                         long *reserved_field_2,
+                         unsigned char *reserved_field_3,
+                         unsigned char *control_vector,
+                         unsigned char *reserved_field_4,
+                         long *reserved_field_5,
+                         unsigned char *reserved_field_6,
+                         unsigned char *master_key_verification_number)
+{
+    static const char *const valid[] = {
+        "INTERNAL", "AES     ", "NO-KEY  ", "KEYLN16 ", "KEYLN24 ",
+        "KEYLN32 ", NULL,
+    };
+    unsigned int keylen = 32;
+
+    MOCK_CCA_ENTER(CSNBKTB);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(key_value);
+    UNUSED(reserved_field_1);
+    UNUSED(reserved_field_2);
+    UNUSED(reserved_field_3);
+    UNUSED(control_vector);
+    UNUSED(reserved_field_4);
+    UNUSED(reserved_field_5);
+    UNUSED(reserved_field_6);
+    UNUSED(master_key_verification_number);
+
+    /* Only skeletons of internal AES DATA keys */
+    if (memcmp(key_type, "DATA    ", CCA_KEYWORD_SIZE) != 0 ||
+        !mock_cca_keyword(rule_array, *rule_array_count, "AES     ") ||
+        !mock_cca_keywords_valid(rule_array, *rule_array_count, valid)) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    if (mock_cca_keyword(rule_array, *rule_array_count, "KEYLN16 "))
+        keylen = 16;
+    else if (mock_cca_keyword(rule_array, *rule_array_count, "KEYLN24 "))
+        keylen = 24;
+
+    mock_cca_aes_token_skeleton(key_token, keylen);
+}
+
+void SECURITYAPI CSNBKGN(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         unsigned char *key_form, unsigned char *key_length,
+                         unsigned char *key_type_1, unsigned char *key_type_2,
+                         unsigned char *KEK_key_identifier_1,
+                         unsigned char *KEK_key_identifier_2,
+                         unsigned char *generated_key_identifier_1,
+                         unsigned char *generated_key_identifier_2)
+{
+    unsigned char key[32];
+    unsigned int keylen;
+
+    MOCK_CCA_ENTER(CSNBKGN);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(key_type_2);
+    UNUSED(KEK_key_identifier_1);
+    UNUSED(KEK_key_identifier_2);
+    UNUSED(generated_key_identifier_2);
+
+    /* Only operational AES keys into a skeleton token */
+    if (memcmp(key_form, "OP      ", CCA_KEYWORD_SIZE) != 0 ||
+        memcmp(key_type_1, "AESTOKEN", CCA_KEYWORD_SIZE) != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    if (memcmp(key_length, "KEYLN16 ", CCA_KEYWORD_SIZE) == 0) {
+        keylen = 16;
+    } else if (memcmp(key_length, "KEYLN24 ", CCA_KEYWORD_SIZE) == 0) {
+        keylen = 24;
+    } else if (memcmp(key_length, "KEYLN32 ", CCA_KEYWORD_SIZE) == 0 ||
+               memcmp(key_length, "        ", CCA_KEYWORD_SIZE) == 0) {
+        keylen = 32;
+    } else {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    if (generated_key_identifier_1[0] != 0x01 ||
+        generated_key_identifier_1[4] != MOCK_CCA_AES_TOKEN_VERSION) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_TOKEN;
+        return;
+    }
+
+    if (RAND_bytes(key, keylen) != 1) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_CRYPTO;
+        return;
+    }
+
+    *reason_code = mock_cca_aes_token_set_key(generated_key_identifier_1,
+                                              key, keylen);
+    if (*reason_code != 0)
+        *return_code = MOCK_CCA_RC_ERROR;
+
+    OPENSSL_cleanse(key, sizeof(key));
+}
+
+void SECURITYAPI CSNBCKM(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *clear_key_length, unsigned char *clear_key,
+                         unsigned char *target_key_identifier)
+{
+    MOCK_CCA_ENTER(CSNBCKM);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+
+    /* Only AES DATA keys */
+    if (*rule_array_count != 1 ||
+        memcmp(rule_array, "AES     ", CCA_KEYWORD_SIZE) != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    *reason_code = mock_cca_aes_token_set_key(target_key_identifier,
+                                              clear_key, *clear_key_length);
+    if (*reason_code != 0)
+        *return_code = MOCK_CCA_RC_ERROR;
+}
+
+void SECURITYAPI CSNBSAE(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *key_length, unsigned char *key_identifier,
+                         long *key_parms_length, unsigned char *key_parms,
+                         long *block_size,
+                         long *initialization_vector_length,
+                         unsigned char *initialization_vector,
+                         long *chain_data_length, unsigned char *chain_data,
+                         long *clear_text_length, unsigned char *clear_text,
+                         long *cipher_text_length, unsigned char *cipher_text,
+                         long *optional_data_length,
+                         unsigned char *optional_data)
+{
+    MOCK_CCA_ENTER(CSNBSAE);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(key_parms_length);
+    UNUSED(key_parms);
+    UNUSED(block_size);
+    UNUSED(optional_data_length);
+    UNUSED(optional_data);
+
+    mock_cca_aes_crypt(return_code, reason_code, *rule_array_count,
+                       rule_array, *key_length, key_identifier,
+                       initialization_vector_length, initialization_vector,
+                       chain_data_length, chain_data,
+                       *clear_text_length, clear_text,
+                       cipher_text_length, cipher_text, 1);
+}
+
+void SECURITYAPI CSNBSAD(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *key_length, unsigned char *key_identifier,
+                         long *key_parms_length, unsigned char *key_parms,
+                         long *block_size,
+                         long *initialization_vector_length,
+                         unsigned char *initialization_vector,
+                         long *chain_data_length, unsigned char *chain_data,
+                         long *cipher_text_length, unsigned char *cipher_text,
+                         long *clear_text_length, unsigned char *clear_text,
+                         long *optional_data_length,
+                         unsigned char *optional_data)
+{
+    MOCK_CCA_ENTER(CSNBSAD);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(key_parms_length);
+    UNUSED(key_parms);
+    UNUSED(block_size);
+    UNUSED(optional_data_length);
+    UNUSED(optional_data);
+
+    mock_cca_aes_crypt(return_code, reason_code, *rule_array_count,
+                       rule_array, *key_length, key_identifier,
+                       initialization_vector_length, initialization_vector,
+                       chain_data_length, chain_data,
+                       *cipher_text_length, cipher_text,
+                       clear_text_length, clear_text, 0);
+}
+
+static const EVP_MD *mock_cca_hash_md(const unsigned char *rule_array,
+                                      long count)
+{
+    if (mock_cca_keyword(rule_array, count, "SHA-1   "))
+        return EVP_sha1();
+    if (mock_cca_keyword(rule_array, count, "SHA-224 "))
+        return EVP_sha224();
+    if (mock_cca_keyword(rule_array, count, "SHA-256 "))
+        return EVP_sha256();
+    if (mock_cca_keyword(rule_array, count, "SHA-384 "))
+        return EVP_sha384();
+    if (mock_cca_keyword(rule_array, count, "SHA-512 "))
+        return EVP_sha512();
+    if (mock_cca_keyword(rule_array, count, "SHA3-224"))
+        return EVP_sha3_224();
+    if (mock_cca_keyword(rule_array, count, "SHA3-256"))
+        return EVP_sha3_256();
+    if (mock_cca_keyword(rule_array, count, "SHA3-384"))
+        return EVP_sha3_384();
+    if (mock_cca_keyword(rule_array, count, "SHA3-512"))
+        return EVP_sha3_512();
+    if (mock_cca_keyword(rule_array, count, "MD5     "))
+        return EVP_md5();
+
+    return NULL;
+}
+
+void SECURITYAPI CSNBOWH(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *text_length, unsigned char *text,
+                         long *chaining_vector_length,
+                         unsigned char *chaining_vector,
+                         long *hash_length, unsigned char *hash)
+{
+    struct mock_cca_hash_chain chain;
+    const EVP_MD *md;
+    int first, last;
+
+    MOCK_CCA_ENTER(CSNBOWH);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+
+    md = mock_cca_hash_md(rule_array, *rule_array_count);
+    if (md == NULL) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    first = mock_cca_keyword(rule_array, *rule_array_count, "FIRST   ");
+    last = mock_cca_keyword(rule_array, *rule_array_count, "LAST    ");
+    if (!first && !last &&
+        !mock_cca_keyword(rule_array, *rule_array_count, "MIDDLE  ")) {
+        /* ONLY */
+        first = 1;
+        last = 1;
+    }
+
+    if ((last && *hash_length < EVP_MD_size(md)) ||
+        *chaining_vector_length < (long)sizeof(chain)) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    if (first) {
+        memcpy(chain.magic, MOCK_CCA_HASH_MAGIC, sizeof(chain.magic));
+        chain.ctx = EVP_MD_CTX_new();
+        if (chain.ctx == NULL || EVP_DigestInit_ex(chain.ctx, md, NULL) != 1)
+            goto crypto_error;
+    } else {
+        memcpy(&chain, chaining_vector, sizeof(chain));
+        if (memcmp(chain.magic, MOCK_CCA_HASH_MAGIC,
+                   sizeof(chain.magic)) != 0) {
+            *return_code = MOCK_CCA_RC_ERROR;
+            *reason_code = MOCK_CCA_REASON_TOKEN;
+            return;
+        }
+    }
+
+    if (*text_length > 0 &&
+        EVP_DigestUpdate(chain.ctx, text, *text_length) != 1)
+        goto crypto_error;
+
+    if (last) {
+        if (EVP_DigestFinal_ex(chain.ctx, hash, NULL) != 1)
+            goto crypto_error;
+        *hash_length = EVP_MD_size(md);
+        EVP_MD_CTX_free(chain.ctx);
+        memset(chaining_vector, 0, sizeof(chain));
+    } else {
+        memcpy(chaining_vector, &chain, sizeof(chain));
+    }
+
+    return;
+
+crypto_error:
+    EVP_MD_CTX_free(chain.ctx);
+    memset(chaining_vector, 0, sizeof(chain));
+    *return_code = MOCK_CCA_RC_ERROR;
+    *reason_code = MOCK_CCA_REASON_CRYPTO;
+}
+
+/*
+ * RSA private key tokens are internal tokens with a private key section in
+ * ME format (0x30) and a public key section (0x04), as analyse_cca_key_token()
+ * expects them. The section carries the modulus and the mock APKA master key
+ * verification pattern at the offsets of the real format. Instead of the
+ * private exponent, the section contains the DER encoded private key,
+ * encrypted with the mock master key. The public key tokens are external
+ * tokens with a public key section only.
+ */
+static void mock_cca_put16(unsigned char *p, size_t len)
+{
+    uint16_t val = htobe16((uint16_t)len);
+
+    memcpy(p, &val, sizeof(val));
+}
+
+static size_t mock_cca_get16(const unsigned char *p)
+{
+    uint16_t val;
+
+    memcpy(&val, p, sizeof(val));
+
+    return be16toh(val);
+}
+
+/* Builds the public key section, n is only contained in external tokens */
+static size_t mock_cca_rsa_pubsec(unsigned char *sec, unsigned int n_bits,
+                                  const unsigned char *e, size_t e_len,
+                                  const unsigned char *n, size_t n_len)
+{
+    size_t len = CCA_RSA_INTTOK_PUBKEY_E_OFFSET + e_len + n_len;
+
+    memset(sec, 0, CCA_RSA_INTTOK_PUBKEY_E_OFFSET);
+    sec[0] = 0x04;
+    mock_cca_put16(sec + CCA_RSA_INTTOK_PUBKEY_LENGTH_OFFSET, len);
+    mock_cca_put16(sec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET, e_len);
+    mock_cca_put16(sec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET + 2, n_bits);
+    mock_cca_put16(sec + CCA_RSA_EXTTOK_PUBKEY_N_LENGTH_OFFSET, n_len);
+    memcpy(sec + CCA_RSA_INTTOK_PUBKEY_E_OFFSET, e, e_len);
+    memcpy(sec + CCA_RSA_INTTOK_PUBKEY_E_OFFSET + e_len, n, n_len);
+
+    return len;
+}
+
+/*
+ * Builds a private key token. Without a key, it is the skeleton token of
+ * CSNDPKB with the modulus bits and the public exponent only.
+ */
+static long mock_cca_rsa_token_build(unsigned char *token, long *token_len,
+                                     unsigned int n_bits,
+                                     const unsigned char *e, size_t e_len,
+                                     const unsigned char *n, size_t n_len,
+                                     const unsigned char *der, size_t der_len)
+{
+    unsigned char *sec = token + CCA_RSA_INTTOK_PRIVKEY_OFFSET;
+    unsigned char *enc = sec + CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET + n_len;
+    size_t enc_len = 0, sec_len, len;
+    EVP_CIPHER_CTX *ctx;
+    int len1, len2, ok;
+
+    if (der_len > 0)
+        enc_len = 2 + AES_BLOCK_SIZE +
+                  (der_len / AES_BLOCK_SIZE + 1) * AES_BLOCK_SIZE;
+    sec_len = CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET + n_len + enc_len;
+    len = CCA_RSA_INTTOK_HDR_LENGTH + sec_len +
+          CCA_RSA_INTTOK_PUBKEY_E_OFFSET + e_len;
+    if (*token_len < (long)len) {
+        *token_len = len;
+        return MOCK_CCA_REASON_LENGTH;
+    }
+
+    memset(token, 0, CCA_RSA_INTTOK_HDR_LENGTH + sec_len);
+    token[0] = 0x1f;
+    mock_cca_put16(token + 2, len);
+    sec[0] = 0x30;
+    mock_cca_put16(sec + CCA_RSA_INTTOK_PRIVKEY_LENGTH_OFFSET, sec_len);
+    mock_cca_put16(sec + CCA_RSA_INTTOK_PRIVKEY_ME_N_LENGTH_OFFSET, n_len);
+    memcpy(sec + MOCK_CCA_RSA_TOKEN_MKVP, mock_cca_apka_mkvp,
+           CCA_MKVP_LENGTH);
+    memcpy(sec + CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET, n, n_len);
+
+    if (der_len > 0) {
+        mock_cca_put16(enc, der_len);
+        if (RAND_bytes(enc + 2, AES_BLOCK_SIZE) != 1)
+            return MOCK_CCA_REASON_CRYPTO;
+        ctx = EVP_CIPHER_CTX_new();
+        ok = ctx != NULL &&
+             EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, mock_cca_aes_mk,
+                                enc + 2) == 1 &&
+             EVP_EncryptUpdate(ctx, enc + 2 + AES_BLOCK_SIZE, &len1,
+                               der, der_len) == 1 &&
+             EVP_EncryptFinal_ex(ctx, enc + 2 + AES_BLOCK_SIZE + len1,
+                                 &len2) == 1;
+        EVP_CIPHER_CTX_free(ctx);
+        if (!ok)
+            return MOCK_CCA_REASON_CRYPTO;
+    }
+
+    mock_cca_rsa_pubsec(token + CCA_RSA_INTTOK_HDR_LENGTH + sec_len, n_bits,
+                        e, e_len, NULL, 0);
+    *token_len = len;
+
+    return 0;
+}
+
+/* Returns the private and public key sections of a private key token */
+static long mock_cca_rsa_token_sections(const unsigned char *token, long len,
+                                        const unsigned char **privsec,
+                                        const unsigned char **pubsec)
+{
+    size_t sec_len;
+
+    if (len < CCA_RSA_INTTOK_HDR_LENGTH + CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET ||
+        token[0] != 0x1f || token[CCA_RSA_INTTOK_PRIVKEY_OFFSET] != 0x30)
+        return MOCK_CCA_REASON_TOKEN;
+
+    *privsec = token + CCA_RSA_INTTOK_PRIVKEY_OFFSET;
+    sec_len = mock_cca_get16(*privsec + CCA_RSA_INTTOK_PRIVKEY_LENGTH_OFFSET);
+    if (CCA_RSA_INTTOK_HDR_LENGTH + sec_len + CCA_RSA_INTTOK_PUBKEY_E_OFFSET >
+                                                                (size_t)len ||
+        mock_cca_get16(*privsec + CCA_RSA_INTTOK_PRIVKEY_ME_N_LENGTH_OFFSET) +
+                CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET > sec_len)
+        return MOCK_CCA_REASON_TOKEN;
+
+    *pubsec = *privsec + sec_len;
+    if ((*pubsec)[0] != 0x04 ||
+        CCA_RSA_INTTOK_HDR_LENGTH + sec_len + CCA_RSA_INTTOK_PUBKEY_E_OFFSET +
+                mock_cca_get16(*pubsec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET) >
+                                                                (size_t)len)
+        return MOCK_CCA_REASON_TOKEN;
+
+    return 0;
+}
+
+static EVP_PKEY *mock_cca_rsa_pubkey(const unsigned char *n, size_t n_len,
+                                     const unsigned char *e, size_t e_len)
+{
+    EVP_PKEY *pkey = NULL;
+    BIGNUM *bn_n, *bn_e;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    RSA *rsa;
+#else
+    OSSL_PARAM_BLD *bld = NULL;
+    OSSL_PARAM *params = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+#endif
+
+    bn_n = BN_bin2bn(n, n_len, NULL);
+    bn_e = BN_bin2bn(e, e_len, NULL);
+    if (bn_n == NULL || bn_e == NULL)
+        goto out;
+
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    rsa = RSA_new();
+    if (rsa == NULL || RSA_set0_key(rsa, bn_n, bn_e, NULL) != 1) {
+        RSA_free(rsa);
+        goto out;
+    }
+    bn_n = NULL;
+    bn_e = NULL;
+    pkey = EVP_PKEY_new();
+    if (pkey == NULL || EVP_PKEY_assign_RSA(pkey, rsa) != 1) {
+        RSA_free(rsa);
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+#else
+    bld = OSSL_PARAM_BLD_new();
+    if (bld == NULL ||
+        OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_N, bn_n) != 1 ||
+        OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_E, bn_e) != 1)
+        goto out;
+    params = OSSL_PARAM_BLD_to_param(bld);
+    ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    if (params == NULL || ctx == NULL || EVP_PKEY_fromdata_init(ctx) != 1 ||
+        EVP_PKEY_fromdata(ctx, &pkey, EVP_PKEY_PUBLIC_KEY, params) != 1)
+        pkey = NULL;
+#endif
+
+out:
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    EVP_PKEY_CTX_free(ctx);
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(bld);
+#endif
+    BN_free(bn_n);
+    BN_free(bn_e);
+
+    return pkey;
+}
+
+/* Returns the key of a private key token, or of an external public key token */
+static long mock_cca_rsa_token_get_key(const unsigned char *token, long len,
+                                       int private, EVP_PKEY **pkey)
+{
+    const unsigned char *privsec, *pubsec, *enc, *p;
+    unsigned char der[MOCK_CCA_RSA_MAX_DER + AES_BLOCK_SIZE];
+    size_t n_len, e_len, der_len, enc_len;
+    EVP_CIPHER_CTX *ctx;
+    int len1, len2, ok;
+    long reason;
+
+    if (len > CCA_RSA_EXTTOK_PUBKEY_OFFSET + CCA_RSA_INTTOK_PUBKEY_E_OFFSET &&
+        token[0] == 0x1e && !private) {
+        pubsec = token + CCA_RSA_EXTTOK_PUBKEY_OFFSET;
+        e_len = mock_cca_get16(pubsec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET);
+        n_len = mock_cca_get16(pubsec + CCA_RSA_EXTTOK_PUBKEY_N_LENGTH_OFFSET);
+        if (pubsec[0] != 0x04 ||
+            CCA_RSA_EXTTOK_PUBKEY_OFFSET + CCA_RSA_INTTOK_PUBKEY_E_OFFSET +
+                                            e_len + n_len > (size_t)len)
+            return MOCK_CCA_REASON_TOKEN;
+        *pkey = mock_cca_rsa_pubkey(pubsec + CCA_RSA_INTTOK_PUBKEY_E_OFFSET +
+                                    e_len, n_len,
+                                    pubsec + CCA_RSA_INTTOK_PUBKEY_E_OFFSET,
+                                    e_len);
+        return *pkey != NULL ? 0 : MOCK_CCA_REASON_CRYPTO;
+    }
+
+    reason = mock_cca_rsa_token_sections(token, len, &privsec, &pubsec);
+    if (reason != 0)
+        return reason;
+    if (memcmp(privsec + MOCK_CCA_RSA_TOKEN_MKVP, mock_cca_apka_mkvp,
+               CCA_MKVP_LENGTH) != 0)
+        return MOCK_CCA_REASON_TOKEN;
+
+    /* The encrypted key follows n, a skeleton token has no key */
+    n_len = mock_cca_get16(privsec + CCA_RSA_INTTOK_PRIVKEY_ME_N_LENGTH_OFFSET);
+    enc = privsec + CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET + n_len;
+    if (enc + 2 + AES_BLOCK_SIZE > pubsec)
+        return MOCK_CCA_REASON_TOKEN;
+    der_len = mock_cca_get16(enc);
+    enc_len = pubsec - enc - 2 - AES_BLOCK_SIZE;
+    if (der_len > MOCK_CCA_RSA_MAX_DER || enc_len > sizeof(der) ||
+        enc_len != (der_len / AES_BLOCK_SIZE + 1) * AES_BLOCK_SIZE)
+        return MOCK_CCA_REASON_TOKEN;
+
+    ctx = EVP_CIPHER_CTX_new();
+    ok = ctx != NULL &&
+         EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, mock_cca_aes_mk,
+                            enc + 2) == 1 &&
+         EVP_DecryptUpdate(ctx, der, &len1, enc + 2 + AES_BLOCK_SIZE,
+                           enc_len) == 1 &&
+         EVP_DecryptFinal_ex(ctx, der + len1, &len2) == 1 &&
+         (size_t)(len1 + len2) == der_len;
+    EVP_CIPHER_CTX_free(ctx);
+
+    p = der;
+    *pkey = ok ? d2i_PrivateKey(EVP_PKEY_RSA, NULL, &p, der_len) : NULL;
+    OPENSSL_cleanse(der, sizeof(der));
+
+    return *pkey != NULL ? 0 : MOCK_CCA_REASON_TOKEN;
+}
+
+void SECURITYAPI CSNDPKB(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *key_values_structure_length,
+                         unsigned char *key_values_structure,
+                         long *key_name_ln, unsigned char *key_name,
+                         long *customer_data_length,
+                         unsigned char *customer_data,
+                         long *reserved_2_length, unsigned char *reserved_2,
+                         long *reserved_3_length, unsigned char *reserved_3,
+                         long *reserved_4_length, unsigned char *reserved_4,
+                         long *reserved_5_length, unsigned char *reserved_5,
+                         long *token_length, unsigned char *token)
+{
+    static const char *const valid[] = {
+        "RSA-AESC", "KEY-MGMT", "SIG-ONLY", NULL,
+    };
+    unsigned int n_bits;
+    size_t e_len;
+
+    MOCK_CCA_ENTER(CSNDPKB);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(key_name_ln);
+    UNUSED(key_name);
+    UNUSED(customer_data_length);
+    UNUSED(customer_data);
+    UNUSED(reserved_2_length);
+    UNUSED(reserved_2);
+    UNUSED(reserved_3_length);
+    UNUSED(reserved_3);
+    UNUSED(reserved_4_length);
+    UNUSED(reserved_4);
+    UNUSED(reserved_5_length);
+    UNUSED(reserved_5);
+
+    /* Only skeletons of RSA private keys, see the RSA key generation */
+    if (!mock_cca_keyword(rule_array, *rule_array_count, "RSA-AESC") ||
+        !mock_cca_keywords_valid(rule_array, *rule_array_count, valid)) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    n_bits = mock_cca_get16(key_values_structure);
+    e_len = mock_cca_get16(key_values_structure + CCA_PKB_E_SIZE_OFFSET);
+    if (*key_values_structure_length < (long)(CCA_PKB_E_OFFSET + e_len) ||
+        n_bits < 512 || n_bits > 4096 || e_len > 3) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    *reason_code = mock_cca_rsa_token_build(token, token_length, n_bits,
+                                            key_values_structure +
+                                                        CCA_PKB_E_OFFSET,
+                                            e_len, NULL, 0, NULL, 0);
+    if (*reason_code != 0)
+        *return_code = MOCK_CCA_RC_ERROR;
+}
+
+void SECURITYAPI CSNDPKG(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *regeneration_data_length,
+                         unsigned char *regeneration_data,
+                         long *skeleton_key_token_length,
+                         unsigned char *skeleton_key_token,
+                         unsigned char *transport_key_identifier,
+                         long *generated_key_identifier_length,
+                         unsigned char *generated_key_identifier)
+{
+    unsigned char e[3], n[CCATOK_MAX_N_LEN], *der = NULL;
+    const unsigned char *privsec, *pubsec;
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    unsigned int n_bits;
+    BIGNUM *bn_e = NULL;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    BIGNUM *bn_n = NULL;
+#else
+    const BIGNUM *bn_n;
+#endif
+    size_t e_len, n_len;
+    int der_len;
+
+    MOCK_CCA_ENTER(CSNDPKG);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(regeneration_data);
+    UNUSED(transport_key_identifier);
+
+    /* Only operational keys under the master key, from a skeleton token */
+    if (*rule_array_count != 1 ||
+        memcmp(rule_array, "MASTER  ", CCA_KEYWORD_SIZE) != 0 ||
+        *regeneration_data_length != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    *reason_code = mock_cca_rsa_token_sections(skeleton_key_token,
+                                               *skeleton_key_token_length,
+                                               &privsec, &pubsec);
+    if (*reason_code != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        return;
+    }
+    n_bits = mock_cca_get16(pubsec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET + 2);
+    e_len = mock_cca_get16(pubsec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET);
+    if (e_len > sizeof(e) || n_bits > CCATOK_MAX_N_LEN * 8) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_TOKEN;
+        return;
+    }
+
+    /* A public exponent of 0 means a random one, use 65537 */
+    bn_e = BN_bin2bn(pubsec + CCA_RSA_INTTOK_PUBKEY_E_OFFSET, e_len, NULL);
+    if (bn_e == NULL || (BN_is_zero(bn_e) && BN_set_word(bn_e, 65537) != 1))
+        goto crypto_error;
+    e_len = BN_bn2bin(bn_e, e);
+
+    ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    if (ctx == NULL || EVP_PKEY_keygen_init(ctx) != 1 ||
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, n_bits) != 1)
+        goto crypto_error;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    if (EVP_PKEY_CTX_set_rsa_keygen_pubexp(ctx, bn_e) != 1)
+        goto crypto_error;
+    bn_e = NULL; /* owned by ctx */
+#else
+    if (EVP_PKEY_CTX_set1_rsa_keygen_pubexp(ctx, bn_e) != 1)
+        goto crypto_error;
+#endif
+    if (EVP_PKEY_keygen(ctx, &pkey) != 1)
+        goto crypto_error;
+
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    RSA_get0_key(EVP_PKEY_get0_RSA(pkey), &bn_n, NULL, NULL);
+#else
+    if (EVP_PKEY_get_bn_param(pkey, OSSL_PKEY_PARAM_RSA_N, &bn_n) != 1)
+        goto crypto_error;
+#endif
+    n_len = BN_bn2bin(bn_n, n);
+
+    der_len = i2d_PrivateKey(pkey, &der);
+    if (der_len <= 0 || der_len > MOCK_CCA_RSA_MAX_DER)
+        goto crypto_error;
+
+    *reason_code = mock_cca_rsa_token_build(generated_key_identifier,
+                                            generated_key_identifier_length,
+                                            n_bits, e, e_len, n, n_len,
+                                            der, der_len);
+    if (*reason_code != 0)
+        *return_code = MOCK_CCA_RC_ERROR;
+    goto out;
+
+crypto_error:
+    *return_code = MOCK_CCA_RC_ERROR;
+    *reason_code = MOCK_CCA_REASON_CRYPTO;
+
+out:
+    if (der != NULL)
+        OPENSSL_clear_free(der, der_len);
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    BN_free(bn_n);
+#endif
+    BN_free(bn_e);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(ctx);
+}
+
+void SECURITYAPI CSNDPKX(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *source_key_identifier_length,
+                         unsigned char *source_key_identifier,
+                         long *target_key_token_length,
+                         unsigned char *target_key_token)
+{
+    const unsigned char *privsec, *pubsec;
+    size_t n_len, e_len, len;
+
+    MOCK_CCA_ENTER(CSNDPKX);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+    UNUSED(rule_array);
+
+    if (*rule_array_count != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_KEYWORD;
+        return;
+    }
+
+    *reason_code = mock_cca_rsa_token_sections(source_key_identifier,
+                                               *source_key_identifier_length,
+                                               &privsec, &pubsec);
+    if (*reason_code != 0) {
+        *return_code = MOCK_CCA_RC_ERROR;
+        return;
+    }
+
+    n_len = mock_cca_get16(privsec + CCA_RSA_INTTOK_PRIVKEY_ME_N_LENGTH_OFFSET);
+    e_len = mock_cca_get16(pubsec + CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET);
+    len = CCA_RSA_EXTTOK_PUBKEY_OFFSET + CCA_RSA_INTTOK_PUBKEY_E_OFFSET +
+          e_len + n_len;
+    if (*target_key_token_length < (long)len) {
+        *target_key_token_length = len;
+        *return_code = MOCK_CCA_RC_ERROR;
+        *reason_code = MOCK_CCA_REASON_LENGTH;
+        return;
+    }
+
+    memset(target_key_token, 0, CCA_RSA_EXTTOK_PUBKEY_OFFSET);
+    target_key_token[0] = 0x1e;
+    mock_cca_put16(target_key_token + 2, len);
+    mock_cca_rsa_pubsec(target_key_token + CCA_RSA_EXTTOK_PUBKEY_OFFSET,
+                        mock_cca_get16(pubsec +
+                                       CCA_RSA_INTTOK_PUBKEY_E_LENGTH_OFFSET +
+                                       2),
+                        pubsec + CCA_RSA_INTTOK_PUBKEY_E_OFFSET, e_len,
+                        privsec + CCA_RSA_INTTOK_PRIVKEY_ME_N_OFFSET, n_len);
+    *target_key_token_length = len;
+}
+
+/* Common part of CSNDDSG and CSNDDSV, PKCS #1 v1.5 block type 1 only */
+static long mock_cca_rsa_sigver(long rule_array_count,
+                                const unsigned char *rule_array,
+                                long key_length,
+                                const unsigned char *key_identifier,
+                                long hash_length, const unsigned char *hash,
+                                long *signature_length,
+                                unsigned char *signature, int sign)
+{
+    unsigned char buf[CCATOK_MAX_N_LEN];
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    size_t len = sizeof(buf);
+    long reason;
+    int ok;
+
+    if (rule_array_count != 1 ||
+        memcmp(rule_array, "PKCS-1.1", CCA_KEYWORD_SIZE) != 0)
+        return MOCK_CCA_REASON_KEYWORD;
+
+    reason = mock_cca_rsa_token_get_key(key_identifier, key_length, sign,
+                                        &pkey);
+    if (reason != 0)
+        return reason;
+
+    if (hash_length < 0 || hash_length > EVP_PKEY_size(pkey) - 11 ||
+        (sign && *signature_length < EVP_PKEY_size(pkey)) ||
+        (!sign && *signature_length != EVP_PKEY_size(pkey))) {
+        reason = MOCK_CCA_REASON_LENGTH;
+        goto out;
+    }
+
+    ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    ok = ctx != NULL &&
+         (sign ? EVP_PKEY_sign_init(ctx) :
+                 EVP_PKEY_verify_recover_init(ctx)) == 1 &&
+         EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) == 1;
+    if (ok && sign) {
+        len = *signature_length;
+        ok = EVP_PKEY_sign(ctx, signature, &len, hash, hash_length) == 1;
+        *signature_length = len;
+    } else if (ok) {
+        /* A mismatch is reported with return code 4 by the caller */
+        if (EVP_PKEY_verify_recover(ctx, buf, &len, signature,
+                                    *signature_length) != 1 ||
+            len != (size_t)hash_length || memcmp(buf, hash, len) != 0)
+            reason = MOCK_CCA_REASON_SIGNATURE;
+    }
+    if (!ok)
+        reason = MOCK_CCA_REASON_CRYPTO;
+
+out:
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+
+    return reason;
+}
+
+void SECURITYAPI CSNDDSG(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *PKA_private_key_id_length,
+                         unsigned char *PKA_private_key_id,
+                         long *hash_length, unsigned char *hash,
+                         long *signature_field_length,
+                         long *signature_bit_length,
+                         unsigned char *signature_field)
+{
+    MOCK_CCA_ENTER(CSNDDSG);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+
+    *reason_code = mock_cca_rsa_sigver(*rule_array_count, rule_array,
+                                       *PKA_private_key_id_length,
+                                       PKA_private_key_id,
+                                       *hash_length, hash,
+                                       signature_field_length,
+                                       signature_field, 1);
+    if (*reason_code != 0)
+        *return_code = MOCK_CCA_RC_ERROR;
+    else
+        *signature_bit_length = *signature_field_length * 8;
+}
+
+void SECURITYAPI CSNDDSV(long *return_code, long *reason_code,
+                         long *exit_data_length, unsigned char *exit_data,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *PKA_public_key_id_length,
+                         unsigned char *PKA_public_key_id,
+                         long *hash_length, unsigned char *hash,
+                         long *signature_field_length,
+                         unsigned char *signature_field)
+{
+    MOCK_CCA_ENTER(CSNDDSV);
+
+    UNUSED(exit_data_length);
+    UNUSED(exit_data);
+
+    *reason_code = mock_cca_rsa_sigver(*rule_array_count, rule_array,
+                                       *PKA_public_key_id_length,
+                                       PKA_public_key_id,
+                                       *hash_length, hash,
+                                       signature_field_length,
+                                       signature_field, 0);
+    if (*reason_code == MOCK_CCA_REASON_SIGNATURE)
+        *return_code = MOCK_CCA_RC_SIGNATURE;
+    else if (*reason_code != 0)
+        *return_code = MOCK_CCA_RC_ERROR;
+}
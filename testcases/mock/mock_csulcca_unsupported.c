@@ -0,0 +1,114 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_csulcca_unsupported.c
+//
+// CCA verbs that the mock host library does not implement. The CCA token
+// resolves all of them when it is loaded, so they must be exported. They
+// fail with return code 12 (not performed).
+//
+// All CCA verbs take the return code and reason code as the first two
+// parameters, and these are the only ones the stubs access. Therefore,
+// csulincl.h is not included here, and the stubs are not defined with the
+// full prototypes of the verbs.
+//
+#include "mock_common.h"
+
+#define MOCK_CCA_RC_FAILED          12
+#define MOCK_CCA_REASON_UNSUPPORTED 6   /* verb not implemented by the mock */
+
+#define MOCK_CCA_UNSUPPORTED(verb)                                       \
+    void verb(long *return_code, long *reason_code);                     \
+    void verb(long *return_code, long *reason_code)                      \
+    {                                                                    \
+        static struct mock_fn mock_fn = MOCK_FN_INIT(verb);              \
+                                                                         \
+        *return_code = MOCK_CCA_RC_FAILED;                               \
+        *reason_code = MOCK_CCA_REASON_UNSUPPORTED;                      \
+        if (mock_enter(&mock_fn))                                        \
+            *reason_code = mock_fail_code(MOCK_CCA_REASON_UNSUPPORTED);  \
+    }
+
+MOCK_CCA_UNSUPPORTED(CSNBCKI)
+MOCK_CCA_UNSUPPORTED(CSNBDKX)
+MOCK_CCA_UNSUPPORTED(CSNBDKM)
+MOCK_CCA_UNSUPPORTED(CSNBKEX)
+MOCK_CCA_UNSUPPORTED(CSNBKGN2)
+MOCK_CCA_UNSUPPORTED(CSNBKIM)
+MOCK_CCA_UNSUPPORTED(CSNBKPI)
+MOCK_CCA_UNSUPPORTED(CSNBKPI2)
+MOCK_CCA_UNSUPPORTED(CSNBKSI)
+MOCK_CCA_UNSUPPORTED(CSNBKRC)
+MOCK_CCA_UNSUPPORTED(CSNBAKRC)
+MOCK_CCA_UNSUPPORTED(CSNBKRD)
+MOCK_CCA_UNSUPPORTED(CSNBKRL)
+MOCK_CCA_UNSUPPORTED(CSNBKRR)
+MOCK_CCA_UNSUPPORTED(CSNBKRW)
+MOCK_CCA_UNSUPPORTED(CSNDKRC)
+MOCK_CCA_UNSUPPORTED(CSNDKRD)
+MOCK_CCA_UNSUPPORTED(CSNDKRL)
+MOCK_CCA_UNSUPPORTED(CSNDKRR)
+MOCK_CCA_UNSUPPORTED(CSNDKRW)
+MOCK_CCA_UNSUPPORTED(CSNBKYT)
+MOCK_CCA_UNSUPPORTED(CSNBKYTX)
+MOCK_CCA_UNSUPPORTED(CSNBKTC)
+MOCK_CCA_UNSUPPORTED(CSNBKTC2)
+MOCK_CCA_UNSUPPORTED(CSNBKTR)
+MOCK_CCA_UNSUPPORTED(CSNBDEC)
+MOCK_CCA_UNSUPPORTED(CSNBENC)
+MOCK_CCA_UNSUPPORTED(CSNBMGN)
+MOCK_CCA_UNSUPPORTED(CSNBMVR)
+MOCK_CCA_UNSUPPORTED(CSNBKTB2)
+MOCK_CCA_UNSUPPORTED(CSNDPKI)
+MOCK_CCA_UNSUPPORTED(CSNDKTC)
+MOCK_CCA_UNSUPPORTED(CSNDSYI)
+MOCK_CCA_UNSUPPORTED(CSNDSYX)
+MOCK_CCA_UNSUPPORTED(CSUACFC)
+MOCK_CCA_UNSUPPORTED(CSNDSBC)
+MOCK_CCA_UNSUPPORTED(CSNDSBD)
+MOCK_CCA_UNSUPPORTED(CSUALCT)
+MOCK_CCA_UNSUPPORTED(CSUAACM)
+MOCK_CCA_UNSUPPORTED(CSUAACI)
+MOCK_CCA_UNSUPPORTED(CSNDPKH)
+MOCK_CCA_UNSUPPORTED(CSNDPKR)
+MOCK_CCA_UNSUPPORTED(CSUAMKD)
+MOCK_CCA_UNSUPPORTED(CSNDRKD)
+MOCK_CCA_UNSUPPORTED(CSNDRKL)
+MOCK_CCA_UNSUPPORTED(CSNDSYG)
+MOCK_CCA_UNSUPPORTED(CSNBPTR)
+MOCK_CCA_UNSUPPORTED(CSNBCPE)
+MOCK_CCA_UNSUPPORTED(CSNBCPA)
+MOCK_CCA_UNSUPPORTED(CSNBPGN)
+MOCK_CCA_UNSUPPORTED(CSNBPVR)
+MOCK_CCA_UNSUPPORTED(CSNBDKG)
+MOCK_CCA_UNSUPPORTED(CSNBEPG)
+MOCK_CCA_UNSUPPORTED(CSNBCVE)
+MOCK_CCA_UNSUPPORTED(CSNBCSG)
+MOCK_CCA_UNSUPPORTED(CSNBCSV)
+MOCK_CCA_UNSUPPORTED(CSNBCVG)
+MOCK_CCA_UNSUPPORTED(CSNBKTP)
+MOCK_CCA_UNSUPPORTED(CSNDPKE)
+MOCK_CCA_UNSUPPORTED(CSNDPKD)
+MOCK_CCA_UNSUPPORTED(CSNBPEX)
+MOCK_CCA_UNSUPPORTED(CSNBPEXX)
+MOCK_CCA_UNSUPPORTED(CSUARNT)
+MOCK_CCA_UNSUPPORTED(CSNBCVT)
+MOCK_CCA_UNSUPPORTED(CSNBMDG)
+MOCK_CCA_UNSUPPORTED(CSNBTRV)
+MOCK_CCA_UNSUPPORTED(CSNBSKY)
+MOCK_CCA_UNSUPPORTED(CSNBSPN)
+MOCK_CCA_UNSUPPORTED(CSNBPCU)
+MOCK_CCA_UNSUPPORTED(CSUAPRB)
+MOCK_CCA_UNSUPPORTED(CSNDTBC)
+MOCK_CCA_UNSUPPORTED(CSNDRKX)
+MOCK_CCA_UNSUPPORTED(CSNBKET)
+MOCK_CCA_UNSUPPORTED(CSNBHMG)
+MOCK_CCA_UNSUPPORTED(CSNBHMV)
+MOCK_CCA_UNSUPPORTED(CSNBCTT2)
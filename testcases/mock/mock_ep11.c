@@ -0,0 +1,3071 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_ep11.c
+//
+// Mock EP11 host library (libep11.so) for testing the EP11 token without a
+// crypto adapter. It emulates modules with a valid current wrapping key,
+// and implements AES key generation and import, AES encryption (ECB, CBC,
+// CBC-PAD), RSA and EC key pair generation and import, RSA PKCS#1 v1.5
+// encryption and signatures, ECDSA, digests and random numbers in software.
+// The other functions exported by mock_ep11_unsupported.c fail.
+//
+// Key blobs are opaque: the key value is encrypted with a fixed mock
+// wrapping key, and the blob is protected by an HMAC. The WKID of the mock
+// wrapping key is at the same offset as in real blobs. Public keys are
+// MACed SPKIs: the DER encoded SPKI, followed by the WKID, the key
+// attributes and the HMAC as OCTET STRINGs. Encrypt and decrypt states
+// contain a copy of the key blob and can be copied and reused freely.
+// Digest states, and the states of the hash and sign mechanisms, contain a
+// pointer to an OpenSSL digest context, so they can not be used in another
+// process, and are freed by the final operation.
+//
+// Each APQN added with m_add_module() counts the calls it serves. A target
+// with several APQNs is served by them in turn, as the real library does
+// for a target group. All calls served by an APQN listed in
+// OCK_MOCK_EP11_FAIL_APQN fail, e.g. OCK_MOCK_EP11_FAIL_APQN=02.0005.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <endian.h>
+#include <pthread.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+#include <openssl/x509.h>
+#include <openssl/objects.h>
+
+#include "ep11_func.h"
+#include "defs.h"
+#include "mock_common.h"
+
+#define MOCK_EP11_BLOB_MAGIC        "MOCKBLOB"
+#define MOCK_EP11_PKEY_MAGIC        "MOCKPKEY"
+#define MOCK_EP11_CIPHER_MAGIC      "MOCKCIPH"
+#define MOCK_EP11_PKEY_OP_MAGIC     "MOCKPKOP"
+#define MOCK_EP11_DIGEST_MAGIC      "MOCKDGST"
+#define MOCK_EP11_MAX_KEY           64
+#define MOCK_EP11_MAX_DER           2560    /* RSA 4096 private key */
+#define MOCK_EP11_MAX_APQNS         64
+#define MOCK_EP11_MAX_TARGETS       256
+#define MOCK_EP11_TGT_MASK          0x00ffffffULL   /* without XCP_TGTFL_* */
+#define MOCK_EP11_HOST_VERSION      0x00040100  /* 4.1.0 */
+#define MOCK_EP11_SERIALNO          "MOCK0001MOCK0001"
+#define MOCK_EP11_CSUMSIZE          3
+
+#define MOCK_ENV_EP11_FAIL_APQN     "OCK_MOCK_EP11_FAIL_APQN"
+
+#define MOCK_EP11_ENTER(fn, target)                                      \
+    static struct mock_fn mock_fn = MOCK_FN_INIT(fn);                    \
+    if (mock_enter(&mock_fn) || mock_ep11_target_enter(target))          \
+        return mock_fail_code(CKR_DEVICE_ERROR)
+
+/* Not declared in ep11.h */
+int m_add_backend(const char *name, unsigned int port);
+
+struct mock_ep11_blob {
+    unsigned char session[XCP_WK_BYTES];
+    unsigned char wkid[XCP_WKID_BYTES];     /* EP11_BLOB_WKID_OFFSET */
+    char magic[8];
+    uint32_t key_type;
+    uint32_t value_len;
+    uint32_t attrs;
+    uint32_t reserved;
+    unsigned char iv[AES_BLOCK_SIZE];
+    unsigned char key[MOCK_EP11_MAX_KEY];   /* encrypted with the mock WK */
+    unsigned char mac[XCP_HMAC_BYTES];
+};
+
+/* The private key is kept DER encoded in the blob */
+struct mock_ep11_pkey_blob {
+    unsigned char session[XCP_WK_BYTES];
+    unsigned char wkid[XCP_WKID_BYTES];     /* EP11_BLOB_WKID_OFFSET */
+    char magic[8];
+    uint32_t key_type;
+    uint32_t der_len;
+    uint32_t attrs;
+    uint32_t reserved;
+    unsigned char iv[AES_BLOCK_SIZE];
+    unsigned char der[MOCK_EP11_MAX_DER];   /* encrypted with the mock WK */
+    unsigned char mac[XCP_HMAC_BYTES];
+};
+
+/* Follows the SPKI of a MACed SPKI, the MAC covers the SPKI as well */
+struct mock_ep11_spki_trailer {
+    unsigned char wkid_tag[2];
+    unsigned char wkid[XCP_WKID_BYTES];
+    unsigned char attrs_tag[2];
+    unsigned char attrs[4];
+    unsigned char mac_tag[2];
+    unsigned char mac[XCP_HMAC_BYTES];
+};
+
+struct mock_ep11_cipher_state {
+    char magic[8];
+    uint32_t encrypt;
+    uint32_t buf_len;
+    CK_MECHANISM_TYPE mech;
+    unsigned char iv[AES_BLOCK_SIZE];
+    unsigned char buf[AES_BLOCK_SIZE];
+    struct mock_ep11_blob blob;
+};
+
+/* Sign, verify, encrypt or decrypt state with a private or public key */
+struct mock_ep11_pkey_state {
+    char magic[8];
+    uint32_t key_len;
+    CK_ATTRIBUTE_TYPE usage;
+    CK_MECHANISM_TYPE mech;
+    EVP_MD_CTX *ctx;        /* hash and sign mechanisms only */
+    unsigned char key[sizeof(struct mock_ep11_pkey_blob)];
+};
+
+struct mock_ep11_digest_state {
+    char magic[8];
+    EVP_MD_CTX *ctx;
+};
+
+struct mock_ep11_apqn {
+    uint32_t adapter;
+    uint32_t domain;
+    int fail;
+    unsigned long calls;
+    unsigned long failed;
+};
+
+/*
+ * A target handle is the index of its entry. Entry 0 is not used, target 0
+ * addresses the host library or any module. A target without APQNs, as
+ * created for APQN_ANY, is served by any APQN, which is not counted.
+ */
+struct mock_ep11_target {
+    int used;
+    unsigned int num_apqns;
+    unsigned long next;
+    struct mock_ep11_apqn *apqns[MOCK_EP11_MAX_APQNS];
+};
+
+static pthread_mutex_t mock_ep11_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct mock_ep11_apqn mock_ep11_apqns[MOCK_EP11_MAX_APQNS];
+static unsigned int mock_ep11_num_apqns;
+static struct mock_ep11_target mock_ep11_targets[MOCK_EP11_MAX_TARGETS];
+
+/* Boolean key attributes kept in the blob */
+static const struct {
+    CK_ATTRIBUTE_TYPE type;
+    uint32_t flag;
+} mock_ep11_bool_attrs[] = {
+    { CKA_ENCRYPT, 0x0001 },
+    { CKA_DECRYPT, 0x0002 },
+    { CKA_WRAP, 0x0004 },
+    { CKA_UNWRAP, 0x0008 },
+    { CKA_SIGN, 0x0010 },
+    { CKA_VERIFY, 0x0020 },
+    { CKA_DERIVE, 0x0040 },
+    { CKA_EXTRACTABLE, 0x0080 },
+    { CKA_SENSITIVE, 0x0100 },
+    { CKA_MODIFIABLE, 0x0200 },
+    { CKA_TRUSTED, 0x0400 },
+    { CKA_WRAP_WITH_TRUSTED, 0x0800 },
+    { CKA_LOCAL, 0x1000 },
+    { CKA_NEVER_EXTRACTABLE, 0x2000 },
+    { CKA_ALWAYS_SENSITIVE, 0x4000 },
+};
+
+#define MOCK_EP11_ATTRS_DEFAULT     0x02ff  /* encrypt ... modifiable */
+#define MOCK_EP11_ATTRS_FIXED       0x7400  /* not settable */
+
+static const CK_MECHANISM_TYPE mock_ep11_mechs[] = {
+    CKM_AES_KEY_GEN, CKM_AES_ECB, CKM_AES_CBC, CKM_AES_CBC_PAD,
+    CKM_SHA_1, CKM_SHA224, CKM_SHA256, CKM_SHA384, CKM_SHA512,
+    CKM_SHA3_224, CKM_SHA3_256, CKM_SHA3_384, CKM_SHA3_512,
+    CKM_RSA_PKCS_KEY_PAIR_GEN, CKM_RSA_PKCS, CKM_SHA1_RSA_PKCS,
+    CKM_SHA224_RSA_PKCS, CKM_SHA256_RSA_PKCS, CKM_SHA384_RSA_PKCS,
+    CKM_SHA512_RSA_PKCS,
+    CKM_EC_KEY_PAIR_GEN, CKM_ECDSA, CKM_ECDSA_SHA1, CKM_ECDSA_SHA224,
+    CKM_ECDSA_SHA256, CKM_ECDSA_SHA384, CKM_ECDSA_SHA512,
+};
+
+static const unsigned char mock_ep11_wk[XCP_WK_BYTES] = {
+    0x6f, 0x63, 0x6b, 0x2d, 0x6d, 0x6f, 0x63, 0x6b,
+    0x2d, 0x65, 0x70, 0x31, 0x31, 0x2d, 0x77, 0x72,
+    0x61, 0x70, 0x70, 0x69, 0x6e, 0x67, 0x2d, 0x6b,
+    0x65, 0x79, 0x2d, 0x30, 0x30, 0x30, 0x30, 0x31,
+};
+
+static const unsigned char mock_ep11_mackey[XCP_MACKEY_BYTES] = {
+    0x6f, 0x63, 0x6b, 0x2d, 0x6d, 0x6f, 0x63, 0x6b,
+    0x2d, 0x65, 0x70, 0x31, 0x31, 0x2d, 0x6d, 0x61,
+    0x63, 0x2d, 0x6b, 0x65, 0x79, 0x2d, 0x30, 0x30,
+    0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x31,
+};
+
+static const unsigned char mock_ep11_wkid[XCP_WKID_BYTES] = {
+    0x4d, 0x4f, 0x43, 0x4b, 0x2d, 0x45, 0x50, 0x31,
+    0x31, 0x2d, 0x57, 0x4b, 0x2d, 0x30, 0x30, 0x31,
+};
+
+static const EVP_MD *mock_ep11_digest_md(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+    case CKM_SHA_1:
+        return EVP_sha1();
+    case CKM_SHA224:
+        return EVP_sha224();
+    case CKM_SHA256:
+        return EVP_sha256();
+    case CKM_SHA384:
+        return EVP_sha384();
+    case CKM_SHA512:
+        return EVP_sha512();
+    case CKM_SHA3_224:
+    case CKM_IBM_SHA3_224:
+        return EVP_sha3_224();
+    case CKM_SHA3_256:
+    case CKM_IBM_SHA3_256:
+        return EVP_sha3_256();
+    case CKM_SHA3_384:
+    case CKM_IBM_SHA3_384:
+        return EVP_sha3_384();
+    case CKM_SHA3_512:
+    case CKM_IBM_SHA3_512:
+        return EVP_sha3_512();
+    default:
+        return NULL;
+    }
+}
+
+/* Returns the key type and the hash of an RSA or EC mechanism */
+static CK_RV mock_ep11_pkey_mech(CK_MECHANISM_TYPE mech,
+                                 CK_KEY_TYPE *key_type, const EVP_MD **md)
+{
+    switch (mech) {
+    case CKM_RSA_PKCS:
+    case CKM_SHA1_RSA_PKCS:
+    case CKM_SHA224_RSA_PKCS:
+    case CKM_SHA256_RSA_PKCS:
+    case CKM_SHA384_RSA_PKCS:
+    case CKM_SHA512_RSA_PKCS:
+        *key_type = CKK_RSA;
+        break;
+    case CKM_ECDSA:
+    case CKM_ECDSA_SHA1:
+    case CKM_ECDSA_SHA224:
+    case CKM_ECDSA_SHA256:
+    case CKM_ECDSA_SHA384:
+    case CKM_ECDSA_SHA512:
+        *key_type = CKK_EC;
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    switch (mech) {
+    case CKM_SHA1_RSA_PKCS:
+    case CKM_ECDSA_SHA1:
+        *md = EVP_sha1();
+        break;
+    case CKM_SHA224_RSA_PKCS:
+    case CKM_ECDSA_SHA224:
+        *md = EVP_sha224();
+        break;
+    case CKM_SHA256_RSA_PKCS:
+    case CKM_ECDSA_SHA256:
+        *md = EVP_sha256();
+        break;
+    case CKM_SHA384_RSA_PKCS:
+    case CKM_ECDSA_SHA384:
+        *md = EVP_sha384();
+        break;
+    case CKM_SHA512_RSA_PKCS:
+    case CKM_ECDSA_SHA512:
+        *md = EVP_sha512();
+        break;
+    default:
+        *md = NULL;
+        break;
+    }
+
+    return CKR_OK;
+}
+
+static const EVP_CIPHER *mock_ep11_aes_cipher(CK_MECHANISM_TYPE mech,
+                                              unsigned int keylen)
+{
+    int ecb = (mech == CKM_AES_ECB);
+
+    switch (keylen) {
+    case 16:
+        return ecb ? EVP_aes_128_ecb() : EVP_aes_128_cbc();
+    case 24:
+        return ecb ? EVP_aes_192_ecb() : EVP_aes_192_cbc();
+    case 32:
+        return ecb ? EVP_aes_256_ecb() : EVP_aes_256_cbc();
+    default:
+        return NULL;
+    }
+}
+
+static int mock_ep11_mac(const unsigned char *data, size_t len,
+                         unsigned char *mac)
+{
+    unsigned int mac_len = XCP_HMAC_BYTES;
+
+    return HMAC(EVP_sha256(), mock_ep11_mackey, sizeof(mock_ep11_mackey),
+                data, len, mac, &mac_len) != NULL;
+}
+
+/* Encrypts or decrypts len bytes, a multiple of the block size */
+static int mock_ep11_wk_crypt(const unsigned char *iv,
+                              const unsigned char *in, unsigned char *out,
+                              size_t len, int encrypt)
+{
+    EVP_CIPHER_CTX *ctx;
+    int out_len, ok;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return 0;
+
+    ok = EVP_CipherInit_ex(ctx, EVP_aes_256_cbc(), NULL, mock_ep11_wk,
+                           iv, encrypt) == 1 &&
+         EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+         EVP_CipherUpdate(ctx, out, &out_len, in, len) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return ok;
+}
+
+static int mock_ep11_blob_mac(const struct mock_ep11_blob *blob,
+                              unsigned char *mac)
+{
+    return mock_ep11_mac((const unsigned char *)blob,
+                         offsetof(struct mock_ep11_blob, mac), mac);
+}
+
+/* Encrypts or decrypts the key field of a blob with the mock WK */
+static int mock_ep11_blob_crypt(const struct mock_ep11_blob *blob,
+                                const unsigned char *in, unsigned char *out,
+                                int encrypt)
+{
+    return mock_ep11_wk_crypt(blob->iv, in, out, MOCK_EP11_MAX_KEY, encrypt);
+}
+
+/*
+ * Builds a blob for the given key value, and stores it to (out, *out_len).
+ * The session field is taken from the pin blob, if any.
+ */
+static CK_RV mock_ep11_blob_seal(struct mock_ep11_blob *blob,
+                                 const unsigned char *key,
+                                 const unsigned char *pin, size_t pin_len,
+                                 unsigned char *out, size_t *out_len)
+{
+    unsigned char buf[MOCK_EP11_MAX_KEY] = { 0 };
+    int ok;
+
+    if (*out_len < sizeof(*blob)) {
+        *out_len = sizeof(*blob);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memset(blob->session, 0, sizeof(blob->session));
+    if (pin != NULL && pin_len >= sizeof(blob->session))
+        memcpy(blob->session, pin, sizeof(blob->session));
+    memcpy(blob->wkid, mock_ep11_wkid, sizeof(blob->wkid));
+    memcpy(blob->magic, MOCK_EP11_BLOB_MAGIC, sizeof(blob->magic));
+    blob->reserved = 0;
+
+    memcpy(buf, key, blob->value_len);
+    ok = RAND_bytes(blob->iv, sizeof(blob->iv)) == 1 &&
+         mock_ep11_blob_crypt(blob, buf, blob->key, 1) &&
+         mock_ep11_blob_mac(blob, blob->mac);
+    OPENSSL_cleanse(buf, sizeof(buf));
+    if (!ok)
+        return CKR_FUNCTION_FAILED;
+
+    memcpy(out, blob, sizeof(*blob));
+    *out_len = sizeof(*blob);
+
+    return CKR_OK;
+}
+
+/* Verifies a blob, and optionally returns its key value */
+static CK_RV mock_ep11_blob_open(const unsigned char *in, size_t in_len,
+                                 struct mock_ep11_blob *blob,
+                                 unsigned char *key)
+{
+    unsigned char mac[XCP_HMAC_BYTES], buf[MOCK_EP11_MAX_KEY];
+
+    if (in == NULL || in_len < sizeof(*blob))
+        return CKR_KEY_HANDLE_INVALID;
+
+    memcpy(blob, in, sizeof(*blob));
+    if (memcmp(blob->magic, MOCK_EP11_BLOB_MAGIC, sizeof(blob->magic)) != 0)
+        return CKR_KEY_HANDLE_INVALID;
+    if (memcmp(blob->wkid, mock_ep11_wkid, sizeof(blob->wkid)) != 0)
+        return CKR_IBM_WKID_MISMATCH;
+    if (!mock_ep11_blob_mac(blob, mac) ||
+        CRYPTO_memcmp(mac, blob->mac, sizeof(mac)) != 0 ||
+        blob->value_len > MOCK_EP11_MAX_KEY)
+        return CKR_KEY_HANDLE_INVALID;
+
+    if (key == NULL)
+        return CKR_OK;
+
+    if (!mock_ep11_blob_crypt(blob, blob->key, buf, 0))
+        return CKR_FUNCTION_FAILED;
+    memcpy(key, buf, blob->value_len);
+    OPENSSL_cleanse(buf, sizeof(buf));
+
+    return CKR_OK;
+}
+
+/* Applies a key template to the blob attributes */
+static CK_RV mock_ep11_apply_template(struct mock_ep11_blob *blob,
+                                      const CK_ATTRIBUTE *templ,
+                                      CK_ULONG count, int create)
+{
+    CK_ULONG i;
+    size_t k;
+    uint32_t flag;
+
+    for (i = 0; i < count; i++) {
+        switch (templ[i].type) {
+        case CKA_KEY_TYPE:
+            if (templ[i].ulValueLen != sizeof(CK_KEY_TYPE))
+                return CKR_ATTRIBUTE_VALUE_INVALID;
+            if (!create &&
+                *(CK_KEY_TYPE *)templ[i].pValue != blob->key_type)
+                return CKR_ATTRIBUTE_READ_ONLY;
+            blob->key_type = *(CK_KEY_TYPE *)templ[i].pValue;
+            continue;
+        case CKA_VALUE_LEN:
+            if (templ[i].ulValueLen != sizeof(CK_ULONG))
+                return CKR_ATTRIBUTE_VALUE_INVALID;
+            if (!create)
+                return CKR_ATTRIBUTE_READ_ONLY;
+            blob->value_len = *(CK_ULONG *)templ[i].pValue;
+            continue;
+        default:
+            break;
+        }
+
+        for (k = 0; k < sizeof(mock_ep11_bool_attrs) /
+                        sizeof(mock_ep11_bool_attrs[0]); k++) {
+            if (mock_ep11_bool_attrs[k].type == templ[i].type)
+                break;
+        }
+        if (k == sizeof(mock_ep11_bool_attrs) /
+                 sizeof(mock_ep11_bool_attrs[0]))
+            continue;   /* not kept in the blob */
+
+        if (templ[i].ulValueLen != sizeof(CK_BBOOL))
+            return CKR_ATTRIBUTE_VALUE_INVALID;
+
+        flag = mock_ep11_bool_attrs[k].flag;
+        if (flag & MOCK_EP11_ATTRS_FIXED) {
+            if (create)
+                continue;
+            return CKR_ATTRIBUTE_READ_ONLY;
+        }
+
+        if (*(CK_BBOOL *)templ[i].pValue)
+            blob->attrs |= flag;
+        else
+            blob->attrs &= ~flag;
+    }
+
+    return CKR_OK;
+}
+
+static uint32_t mock_ep11_attr_flag(CK_ATTRIBUTE_TYPE type)
+{
+    size_t k;
+
+    for (k = 0; k < sizeof(mock_ep11_bool_attrs) /
+                    sizeof(mock_ep11_bool_attrs[0]); k++) {
+        if (mock_ep11_bool_attrs[k].type == type)
+            return mock_ep11_bool_attrs[k].flag;
+    }
+
+    return 0;
+}
+
+/* Returns the key check value and the bit length, as the real library */
+static CK_RV mock_ep11_csum(const struct mock_ep11_blob *blob,
+                            const unsigned char *key,
+                            unsigned char *csum, size_t *csum_len)
+{
+    unsigned char zero[AES_BLOCK_SIZE] = { 0 }, out[AES_BLOCK_SIZE];
+    const EVP_CIPHER *cipher;
+    EVP_CIPHER_CTX *ctx;
+    uint32_t bits;
+    int len, ok;
+
+    if (csum == NULL || csum_len == NULL)
+        return CKR_OK;
+    if (*csum_len < MOCK_EP11_CSUMSIZE + sizeof(bits)) {
+        *csum_len = MOCK_EP11_CSUMSIZE + sizeof(bits);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memset(csum, 0, MOCK_EP11_CSUMSIZE);
+    cipher = mock_ep11_aes_cipher(CKM_AES_ECB, blob->value_len);
+    if (blob->key_type == CKK_AES && cipher != NULL) {
+        ctx = EVP_CIPHER_CTX_new();
+        if (ctx == NULL)
+            return CKR_HOST_MEMORY;
+        ok = EVP_EncryptInit_ex(ctx, cipher, NULL, key, NULL) == 1 &&
+             EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+             EVP_EncryptUpdate(ctx, out, &len, zero, sizeof(zero)) == 1;
+        EVP_CIPHER_CTX_free(ctx);
+        if (!ok)
+            return CKR_FUNCTION_FAILED;
+        memcpy(csum, out, MOCK_EP11_CSUMSIZE);
+    }
+
+    bits = htobe32(blob->value_len * 8);
+    memcpy(csum + MOCK_EP11_CSUMSIZE, &bits, sizeof(bits));
+    *csum_len = MOCK_EP11_CSUMSIZE + sizeof(bits);
+
+    return CKR_OK;
+}
+
+/*
+ * Returns the key type of an OpenSSL key, or CK_UNAVAILABLE_INFORMATION if
+ * not supported
+ */
+static CK_KEY_TYPE mock_ep11_pkey_type(const EVP_PKEY *pkey)
+{
+    switch (EVP_PKEY_base_id(pkey)) {
+    case EVP_PKEY_RSA:
+        return CKK_RSA;
+    case EVP_PKEY_EC:
+        return CKK_EC;
+    default:
+        return CK_UNAVAILABLE_INFORMATION;
+    }
+}
+
+/* Returns the length of the DER encoded SEQUENCE at in, or 0 */
+static size_t mock_ep11_der_seq_len(const unsigned char *in, size_t in_len)
+{
+    size_t len, hdr = 2, i, n;
+
+    if (in == NULL || in_len < hdr || in[0] != 0x30)
+        return 0;
+
+    len = in[1];
+    if (len & 0x80) {
+        n = len & 0x7f;
+        if (n == 0 || n > 2 || in_len < hdr + n)
+            return 0;
+        for (len = 0, i = 0; i < n; i++)
+            len = (len << 8) | in[hdr + i];
+        hdr += n;
+    }
+
+    return hdr + len <= in_len ? hdr + len : 0;
+}
+
+/*
+ * Builds a private key blob for the key, and stores it to (out, *out_len).
+ * The session field is taken from the pin blob, if any.
+ */
+static CK_RV mock_ep11_pkey_seal(EVP_PKEY *pkey, uint32_t attrs,
+                                 const unsigned char *pin, size_t pin_len,
+                                 unsigned char *out, size_t *out_len)
+{
+    struct mock_ep11_pkey_blob blob;
+    unsigned char buf[MOCK_EP11_MAX_DER] = { 0 };
+    unsigned char *p = buf;
+    int len, ok;
+
+    if (*out_len < sizeof(blob)) {
+        *out_len = sizeof(blob);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    len = i2d_PrivateKey(pkey, NULL);
+    if (len <= 0 || len > MOCK_EP11_MAX_DER)
+        return CKR_KEY_SIZE_RANGE;
+
+    memset(&blob, 0, sizeof(blob));
+    if (pin != NULL && pin_len >= sizeof(blob.session))
+        memcpy(blob.session, pin, sizeof(blob.session));
+    memcpy(blob.wkid, mock_ep11_wkid, sizeof(blob.wkid));
+    memcpy(blob.magic, MOCK_EP11_PKEY_MAGIC, sizeof(blob.magic));
+    blob.key_type = mock_ep11_pkey_type(pkey);
+    blob.der_len = len;
+    blob.attrs = attrs;
+
+    ok = i2d_PrivateKey(pkey, &p) == len &&
+         RAND_bytes(blob.iv, sizeof(blob.iv)) == 1 &&
+         mock_ep11_wk_crypt(blob.iv, buf, blob.der, sizeof(buf), 1) &&
+         mock_ep11_mac((const unsigned char *)&blob,
+                       offsetof(struct mock_ep11_pkey_blob, mac), blob.mac);
+    OPENSSL_cleanse(buf, sizeof(buf));
+    if (!ok)
+        return CKR_FUNCTION_FAILED;
+
+    memcpy(out, &blob, sizeof(blob));
+    *out_len = sizeof(blob);
+
+    return CKR_OK;
+}
+
+/*
+ * Appends the WKID, the attributes and the MAC to the DER encoded SPKI
+ * (spki, spki_len), and stores the MACed SPKI to (out, *out_len). spki may
+ * point to out.
+ */
+static CK_RV mock_ep11_spki_seal(const unsigned char *spki, size_t spki_len,
+                                 uint32_t attrs,
+                                 unsigned char *out, size_t *out_len)
+{
+    struct mock_ep11_spki_trailer trailer;
+    size_t len = spki_len + sizeof(trailer);
+
+    if (*out_len < len) {
+        *out_len = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memmove(out, spki, spki_len);
+
+    trailer.wkid_tag[0] = 0x04;
+    trailer.wkid_tag[1] = sizeof(trailer.wkid);
+    memcpy(trailer.wkid, mock_ep11_wkid, sizeof(trailer.wkid));
+    trailer.attrs_tag[0] = 0x04;
+    trailer.attrs_tag[1] = sizeof(trailer.attrs);
+    attrs = htobe32(attrs);
+    memcpy(trailer.attrs, &attrs, sizeof(trailer.attrs));
+    trailer.mac_tag[0] = 0x04;
+    trailer.mac_tag[1] = sizeof(trailer.mac);
+    memcpy(out + spki_len, &trailer, sizeof(trailer));
+
+    if (!mock_ep11_mac(out, len - sizeof(trailer.mac),
+                       out + len - sizeof(trailer.mac)))
+        return CKR_FUNCTION_FAILED;
+
+    *out_len = len;
+
+    return CKR_OK;
+}
+
+/* Builds the MACed SPKI of the public part of the key */
+static CK_RV mock_ep11_spki_seal_pkey(EVP_PKEY *pkey, uint32_t attrs,
+                                      unsigned char *out, size_t *out_len)
+{
+    unsigned char spki[MOCK_EP11_MAX_DER], *p = spki;
+    int len;
+
+    len = i2d_PUBKEY(pkey, NULL);
+    if (len <= 0 || len > MOCK_EP11_MAX_DER || i2d_PUBKEY(pkey, &p) != len)
+        return CKR_FUNCTION_FAILED;
+
+    return mock_ep11_spki_seal(spki, len, attrs, out, out_len);
+}
+
+/* Returns 1 if (key, klen) is a blob of the size with the magic */
+static int mock_ep11_has_magic(const unsigned char *key, size_t klen,
+                               size_t size, const char *magic)
+{
+    return key != NULL && klen >= size &&
+           memcmp(key + offsetof(struct mock_ep11_blob, magic), magic,
+                  sizeof(((struct mock_ep11_blob *)NULL)->magic)) == 0;
+}
+
+/* Returns 1 if the key is a secret key blob */
+static int mock_ep11_is_secret(const unsigned char *key, size_t klen)
+{
+    return mock_ep11_has_magic(key, klen, sizeof(struct mock_ep11_blob),
+                               MOCK_EP11_BLOB_MAGIC);
+}
+
+/* Returns 1 if the key is a private key blob, else it may be an SPKI */
+static int mock_ep11_is_private(const unsigned char *key, size_t klen)
+{
+    return mock_ep11_has_magic(key, klen, sizeof(struct mock_ep11_pkey_blob),
+                               MOCK_EP11_PKEY_MAGIC);
+}
+
+/*
+ * Verifies a private key blob or a MACed SPKI, and returns its class, key
+ * type, attributes, and optionally the key. Any of the outputs may be NULL.
+ */
+static CK_RV mock_ep11_pkey_open(const unsigned char *in, size_t in_len,
+                                 CK_OBJECT_CLASS *class, CK_KEY_TYPE *key_type,
+                                 uint32_t *attrs, EVP_PKEY **pkey)
+{
+    struct mock_ep11_pkey_blob blob;
+    struct mock_ep11_spki_trailer trailer;
+    unsigned char mac[XCP_HMAC_BYTES], buf[MOCK_EP11_MAX_DER];
+    const unsigned char *p;
+    EVP_PKEY *key = NULL;
+    CK_KEY_TYPE type;
+    size_t spki_len;
+    uint32_t val;
+
+    spki_len = mock_ep11_is_private(in, in_len) ? 0 :
+                                mock_ep11_der_seq_len(in, in_len);
+    if (spki_len > 0) {
+        if (in_len < spki_len + sizeof(trailer))
+            return CKR_KEY_HANDLE_INVALID;
+        memcpy(&trailer, in + spki_len, sizeof(trailer));
+        if (trailer.wkid_tag[0] != 0x04 ||
+            trailer.wkid_tag[1] != sizeof(trailer.wkid) ||
+            trailer.attrs_tag[0] != 0x04 ||
+            trailer.attrs_tag[1] != sizeof(trailer.attrs) ||
+            trailer.mac_tag[0] != 0x04 ||
+            trailer.mac_tag[1] != sizeof(trailer.mac))
+            return CKR_KEY_HANDLE_INVALID;
+        if (memcmp(trailer.wkid, mock_ep11_wkid, sizeof(trailer.wkid)) != 0)
+            return CKR_IBM_WKID_MISMATCH;
+        if (!mock_ep11_mac(in, spki_len + sizeof(trailer) - sizeof(mac),
+                           mac) ||
+            CRYPTO_memcmp(mac, trailer.mac, sizeof(mac)) != 0)
+            return CKR_KEY_HANDLE_INVALID;
+
+        p = in;
+        key = d2i_PUBKEY(NULL, &p, spki_len);
+        if (key == NULL ||
+            mock_ep11_pkey_type(key) == CK_UNAVAILABLE_INFORMATION) {
+            EVP_PKEY_free(key);
+            return CKR_KEY_HANDLE_INVALID;
+        }
+
+        memcpy(&val, trailer.attrs, sizeof(val));
+        type = mock_ep11_pkey_type(key);
+        if (class != NULL)
+            *class = CKO_PUBLIC_KEY;
+        if (attrs != NULL)
+            *attrs = be32toh(val);
+    } else {
+        if (in == NULL || in_len < sizeof(blob))
+            return CKR_KEY_HANDLE_INVALID;
+        memcpy(&blob, in, sizeof(blob));
+        if (memcmp(blob.magic, MOCK_EP11_PKEY_MAGIC, sizeof(blob.magic)) != 0)
+            return CKR_KEY_HANDLE_INVALID;
+        if (memcmp(blob.wkid, mock_ep11_wkid, sizeof(blob.wkid)) != 0)
+            return CKR_IBM_WKID_MISMATCH;
+        if (!mock_ep11_mac((const unsigned char *)&blob,
+                           offsetof(struct mock_ep11_pkey_blob, mac), mac) ||
+            CRYPTO_memcmp(mac, blob.mac, sizeof(mac)) != 0 ||
+            blob.der_len > MOCK_EP11_MAX_DER)
+            return CKR_KEY_HANDLE_INVALID;
+
+        if (pkey != NULL) {
+            if (!mock_ep11_wk_crypt(blob.iv, blob.der, buf, sizeof(buf), 0))
+                return CKR_FUNCTION_FAILED;
+            p = buf;
+            key = d2i_PrivateKey(blob.key_type == CKK_RSA ? EVP_PKEY_RSA :
+                                                            EVP_PKEY_EC,
+                                 NULL, &p, blob.der_len);
+            OPENSSL_cleanse(buf, sizeof(buf));
+            if (key == NULL)
+                return CKR_KEY_HANDLE_INVALID;
+        }
+
+        type = blob.key_type;
+        if (class != NULL)
+            *class = CKO_PRIVATE_KEY;
+        if (attrs != NULL)
+            *attrs = blob.attrs;
+    }
+
+    if (key_type != NULL)
+        *key_type = type;
+    if (pkey != NULL)
+        *pkey = key;
+    else
+        EVP_PKEY_free(key);
+
+    return CKR_OK;
+}
+
+/* Re-MACs a private key blob or a MACed SPKI with new attributes */
+static CK_RV mock_ep11_pkey_set_attrs(unsigned char *obj, size_t olen,
+                                      uint32_t attrs)
+{
+    struct mock_ep11_pkey_blob blob;
+    size_t len = olen;
+
+    if (!mock_ep11_is_private(obj, olen))
+        return mock_ep11_spki_seal(obj, mock_ep11_der_seq_len(obj, olen),
+                                   attrs, obj, &len);
+
+    memcpy(&blob, obj, sizeof(blob));
+    blob.attrs = attrs;
+    if (!mock_ep11_mac((const unsigned char *)&blob,
+                       offsetof(struct mock_ep11_pkey_blob, mac), blob.mac))
+        return CKR_FUNCTION_FAILED;
+    memcpy(obj, &blob, sizeof(blob));
+
+    return CKR_OK;
+}
+
+int m_init(void)
+{
+    return XCP_OK;
+}
+
+int m_shutdown(void)
+{
+    return XCP_OK;
+}
+
+/* Returns 1 if the APQN is listed in OCK_MOCK_EP11_FAIL_APQN */
+static int mock_ep11_apqn_failing(uint32_t adapter, uint32_t domain)
+{
+    const char *env = getenv(MOCK_ENV_EP11_FAIL_APQN);
+    unsigned int a, d;
+    int n;
+
+    while (env != NULL && sscanf(env, "%x.%x%n", &a, &d, &n) == 2) {
+        if (a == adapter && d == domain)
+            return 1;
+        env += n;
+        if (*env != ',')
+            break;
+        env++;
+    }
+
+    return 0;
+}
+
+/* Returns the state of an APQN, the caller holds mock_ep11_mutex */
+static struct mock_ep11_apqn *mock_ep11_get_apqn(uint32_t adapter,
+                                                 uint32_t domain)
+{
+    struct mock_ep11_apqn *apqn;
+    unsigned int i;
+
+    for (i = 0; i < mock_ep11_num_apqns; i++) {
+        apqn = &mock_ep11_apqns[i];
+        if (apqn->adapter == adapter && apqn->domain == domain)
+            return apqn;
+    }
+    if (mock_ep11_num_apqns == MOCK_EP11_MAX_APQNS)
+        return NULL;
+
+    apqn = &mock_ep11_apqns[mock_ep11_num_apqns++];
+    apqn->adapter = adapter;
+    apqn->domain = domain;
+    apqn->fail = mock_ep11_apqn_failing(adapter, domain);
+
+    return apqn;
+}
+
+/* Selects the APQN serving a call, returns 1 if the call is to fail */
+static int mock_ep11_target_enter(target_t target)
+{
+    struct mock_ep11_target *tgt;
+    struct mock_ep11_apqn *apqn;
+    int fail = 0;
+
+    target &= MOCK_EP11_TGT_MASK;
+    if (target >= MOCK_EP11_MAX_TARGETS)
+        return 0;
+
+    pthread_mutex_lock(&mock_ep11_mutex);
+    tgt = &mock_ep11_targets[target];
+    if (tgt->used && tgt->num_apqns > 0) {
+        apqn = tgt->apqns[tgt->next++ % tgt->num_apqns];
+        apqn->calls++;
+        if (apqn->fail) {
+            apqn->failed++;
+            fail = 1;
+        }
+    }
+    pthread_mutex_unlock(&mock_ep11_mutex);
+
+    return fail;
+}
+
+__attribute__((destructor))
+static void mock_ep11_apqn_stats(void)
+{
+    unsigned int i;
+
+    if (getenv(MOCK_ENV_STATS) == NULL)
+        return;
+
+    pthread_mutex_lock(&mock_ep11_mutex);
+    for (i = 0; i < mock_ep11_num_apqns; i++)
+        fprintf(stderr, "mock: APQN %02x.%04x calls: %10lu failed: %10lu\n",
+                mock_ep11_apqns[i].adapter, mock_ep11_apqns[i].domain,
+                mock_ep11_apqns[i].calls, mock_ep11_apqns[i].failed);
+    pthread_mutex_unlock(&mock_ep11_mutex);
+}
+
+/*
+ * Creates a target if *target is XCP_TGT_INIT, otherwise adds the APQNs of
+ * the module to the target group.
+ */
+int m_add_module(XCP_Module_t module, target_t *target)
+{
+    struct mock_ep11_target *tgt = NULL;
+    struct mock_ep11_apqn *apqn;
+    unsigned int dom;
+    target_t i;
+    int rc = XCP_OK;
+
+    if (module == NULL || target == NULL)
+        return XCP_EARG;
+
+    pthread_mutex_lock(&mock_ep11_mutex);
+
+    if (*target == XCP_TGT_INIT) {
+        for (i = 1; i < MOCK_EP11_MAX_TARGETS; i++) {
+            if (!mock_ep11_targets[i].used)
+                break;
+        }
+        if (i == MOCK_EP11_MAX_TARGETS) {
+            rc = XCP_EMEMORY;
+            goto out;
+        }
+        tgt = &mock_ep11_targets[i];
+        memset(tgt, 0, sizeof(*tgt));
+        tgt->used = 1;
+        *target = i;
+    } else if (*target < MOCK_EP11_MAX_TARGETS &&
+               mock_ep11_targets[*target].used) {
+        tgt = &mock_ep11_targets[*target];
+    } else {
+        rc = XCP_ETARGET;
+        goto out;
+    }
+
+    if (!(module->flags & XCP_MFL_MODULE))
+        goto out;
+
+    for (dom = 0; dom < sizeof(module->domainmask) * 8; dom++) {
+        if (!XCPTGTMASK_DOM_IS_SET(module->domainmask, dom))
+            continue;
+        apqn = mock_ep11_get_apqn(module->module_nr, dom);
+        if (apqn == NULL || tgt->num_apqns == MOCK_EP11_MAX_APQNS) {
+            rc = XCP_EMEMORY;
+            goto out;
+        }
+        tgt->apqns[tgt->num_apqns++] = apqn;
+    }
+
+out:
+    pthread_mutex_unlock(&mock_ep11_mutex);
+
+    return rc;
+}
+
+int m_rm_module(XCP_Module_t module, target_t target)
+{
+    UNUSED(module);
+
+    target &= MOCK_EP11_TGT_MASK;
+    if (target >= MOCK_EP11_MAX_TARGETS)
+        return XCP_ETARGET;
+
+    pthread_mutex_lock(&mock_ep11_mutex);
+    mock_ep11_targets[target].used = 0;
+    pthread_mutex_unlock(&mock_ep11_mutex);
+
+    return XCP_OK;
+}
+
+int m_add_backend(const char *name, unsigned int port)
+{
+    UNUSED(name);
+    UNUSED(port);
+
+    return XCP_OK;
+}
+
+static CK_RV mock_ep11_copy_info(CK_VOID_PTR pinfo, CK_ULONG_PTR infbytes,
+                                 const void *info, size_t len)
+{
+    if (pinfo == NULL) {
+        *infbytes = len;
+        return CKR_OK;
+    }
+    if (*infbytes < len) {
+        *infbytes = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(pinfo, info, len);
+    *infbytes = len;
+
+    return CKR_OK;
+}
+
+CK_RV m_get_xcp_info(CK_VOID_PTR pinfo, CK_ULONG_PTR infbytes,
+                     unsigned int query, unsigned int subquery,
+                     target_t target)
+{
+    CK_IBM_XCP_INFO xcp_info;
+    CK_IBM_DOMAIN_INFO domain_info;
+    unsigned char fnlist[16];
+    uint32_t val;
+
+    MOCK_EP11_ENTER(m_get_xcp_info, target);
+
+    switch (query) {
+    case CK_IBM_XCPHQ_VERSION:
+        val = MOCK_EP11_HOST_VERSION;
+        return mock_ep11_copy_info(pinfo, infbytes, &val, sizeof(val));
+    case CK_IBM_XCPQ_MODULE:
+        if (subquery == CK_IBM_XCPMSQ_FNLIST) {
+            /* All functions, except the extended login and logout */
+            memset(fnlist, 0xff, sizeof(fnlist));
+            fnlist[__FNID_LoginExtended / 8] &=
+                                ~(0x80 >> (__FNID_LoginExtended % 8));
+            fnlist[__FNID_LogoutExtended / 8] &=
+                                ~(0x80 >> (__FNID_LogoutExtended % 8));
+            return mock_ep11_copy_info(pinfo, infbytes, fnlist,
+                                       sizeof(fnlist));
+        }
+        if (subquery != CK_IBM_XCPMSQ_DEFAULT)
+            return CKR_ARGUMENTS_BAD;
+        memset(&xcp_info, 0, sizeof(xcp_info));
+        xcp_info.firmwareApi = 7;
+        xcp_info.firmwareVersion.major = 8;
+        xcp_info.cspVersion.major = 8;
+        memcpy(xcp_info.serialNumber, MOCK_EP11_SERIALNO,
+               sizeof(xcp_info.serialNumber));
+        memset(xcp_info.utcTime, '0', sizeof(xcp_info.utcTime));
+        xcp_info.domains = 1;
+        xcp_info.symmStateBytes = sizeof(struct mock_ep11_cipher_state);
+        xcp_info.digestStateBytes = sizeof(struct mock_ep11_digest_state);
+        xcp_info.pinBlockBytes = XCP_PINBLOB_BYTES;
+        xcp_info.symmKeyBytes = sizeof(struct mock_ep11_blob);
+        xcp_info.controlPoints = XCP_CPCOUNT;
+        xcp_info.cpProfileBytes = XCP_CP_BYTES;
+        return mock_ep11_copy_info(pinfo, infbytes, &xcp_info,
+                                   sizeof(xcp_info));
+    case CK_IBM_XCPQ_DOMAIN:
+        memset(&domain_info, 0, sizeof(domain_info));
+        memcpy(domain_info.wk, mock_ep11_wkid, sizeof(mock_ep11_wkid));
+        domain_info.flags = CK_IBM_DOM_ADMIND | CK_IBM_DOM_CURR_WK |
+                            CK_IBM_DOM_IMPRINTED;
+        return mock_ep11_copy_info(pinfo, infbytes, &domain_info,
+                                   sizeof(domain_info));
+    case CK_IBM_XCPQ_EXT_CAPS:
+        val = 0;
+        return mock_ep11_copy_info(pinfo, infbytes, &val, sizeof(val));
+    case CK_IBM_XCPQ_EXT_CAPLIST:
+        *infbytes = 0;
+        return CKR_OK;
+    default:
+        return CKR_FUNCTION_NOT_SUPPORTED;
+    }
+}
+
+/*
+ * Administrative requests and responses use a private format: the function
+ * id and the domain, followed by the payload. Only the query for the domain
+ * control points is supported, which reports all control points set.
+ */
+long xcpa_queryblock(unsigned char *blk, size_t blen, unsigned int fn,
+                     target_t domain, const unsigned char *payload,
+                     size_t plen)
+{
+    uint32_t hdr[2];
+
+    if (blk == NULL)
+        return sizeof(hdr) + plen;
+    if (blen < sizeof(hdr) + plen)
+        return XCP_ESIZE;
+
+    hdr[0] = fn;
+    hdr[1] = domain & 0xffffffff;
+    memcpy(blk, hdr, sizeof(hdr));
+    if (payload != NULL)
+        memcpy(blk + sizeof(hdr), payload, plen);
+
+    return sizeof(hdr) + plen;
+}
+
+long xcpa_cmdblock(unsigned char *blk, size_t blen, unsigned int fn,
+                   const struct XCPadmresp *minf, const unsigned char *tctr,
+                   const unsigned char *payload, size_t plen)
+{
+    UNUSED(blk);
+    UNUSED(blen);
+    UNUSED(fn);
+    UNUSED(minf);
+    UNUSED(tctr);
+    UNUSED(payload);
+    UNUSED(plen);
+
+    /* Administrative commands are not supported */
+    return XCP_EARG;
+}
+
+CK_RV m_admin(unsigned char *response1, size_t *r1len,
+              unsigned char *response2, size_t *r2len,
+              const unsigned char *cmd, size_t clen,
+              const unsigned char *sigs, size_t slen, target_t target)
+{
+    uint32_t hdr[2];
+
+    MOCK_EP11_ENTER(m_admin, target);
+
+    UNUSED(response2);
+    UNUSED(r2len);
+    UNUSED(sigs);
+    UNUSED(slen);
+
+    if (cmd == NULL || clen < sizeof(hdr))
+        return CKR_ARGUMENTS_BAD;
+
+    memcpy(hdr, cmd, sizeof(hdr));
+    if (hdr[0] != XCP_ADMQ_DOM_CTRLPOINTS)
+        return CKR_FUNCTION_NOT_SUPPORTED;
+
+    if (*r1len < sizeof(hdr) + XCP_CP_BYTES) {
+        *r1len = sizeof(hdr) + XCP_CP_BYTES;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(response1, hdr, sizeof(hdr));
+    memset(response1 + sizeof(hdr), 0xff, XCP_CP_BYTES);
+    *r1len = sizeof(hdr) + XCP_CP_BYTES;
+
+    return CKR_OK;
+}
+
+long xcpa_internal_rv(const unsigned char *rsp, size_t rlen,
+                      struct XCPadmresp *rspblk, CK_RV *rv)
+{
+    uint32_t hdr[2];
+
+    if (rsp == NULL || rspblk == NULL || rv == NULL)
+        return XCP_EARG;
+    if (rlen < sizeof(hdr))
+        return XCP_EINVALID;
+
+    memcpy(hdr, rsp, sizeof(hdr));
+    memset(rspblk, 0, sizeof(*rspblk));
+    rspblk->fn = hdr[0];
+    rspblk->domain = hdr[1];
+    rspblk->rv = CKR_OK;
+    rspblk->payload = rsp + sizeof(hdr);
+    rspblk->pllen = rlen - sizeof(hdr);
+    *rv = CKR_OK;
+
+    return rlen;
+}
+
+CK_RV m_Login(CK_UTF8CHAR_PTR pin, CK_ULONG pinlen,
+              const unsigned char *nonce, size_t nlen,
+              unsigned char *pinblob, size_t *pinbloblen, target_t target)
+{
+    unsigned int len = XCP_HMAC_BYTES;
+
+    MOCK_EP11_ENTER(m_Login, target);
+
+    if (*pinbloblen < XCP_PINBLOB_BYTES) {
+        *pinbloblen = XCP_PINBLOB_BYTES;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    /* Session id, salt and MAC, derived from the nonce and the PIN */
+    memset(pinblob, 0, XCP_PINBLOB_BYTES);
+    if (EVP_Digest(pin, pinlen, pinblob, NULL, EVP_sha256(), NULL) != 1 ||
+        (nonce != NULL && nlen > 0 &&
+         HMAC(EVP_sha256(), nonce, nlen, pinblob, XCP_WK_BYTES,
+              pinblob, &len) == NULL) ||
+        HMAC(EVP_sha256(), mock_ep11_mackey, sizeof(mock_ep11_mackey),
+             pinblob, XCP_WK_BYTES + XCP_PIN_SALT_BYTES,
+             pinblob + XCP_WK_BYTES + XCP_PIN_SALT_BYTES, &len) == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    *pinbloblen = XCP_PINBLOB_BYTES;
+
+    return CKR_OK;
+}
+
+CK_RV m_Logout(const unsigned char *pin, size_t len, target_t target)
+{
+    MOCK_EP11_ENTER(m_Logout, target);
+
+    UNUSED(pin);
+    UNUSED(len);
+
+    return CKR_OK;
+}
+
+CK_RV m_GenerateRandom(CK_BYTE_PTR rnd, CK_ULONG len, target_t target)
+{
+    MOCK_EP11_ENTER(m_GenerateRandom, target);
+
+    if (RAND_bytes(rnd, len) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    return CKR_OK;
+}
+
+CK_RV m_SeedRandom(CK_BYTE_PTR pSeed, CK_ULONG ulSeedLen, target_t target)
+{
+    MOCK_EP11_ENTER(m_SeedRandom, target);
+
+    RAND_seed(pSeed, ulSeedLen);
+
+    return CKR_OK;
+}
+
+CK_RV m_GetMechanismList(CK_SLOT_ID slot, CK_MECHANISM_TYPE_PTR mechs,
+                         CK_ULONG_PTR count, target_t target)
+{
+    CK_ULONG num = sizeof(mock_ep11_mechs) / sizeof(mock_ep11_mechs[0]);
+
+    MOCK_EP11_ENTER(m_GetMechanismList, target);
+
+    UNUSED(slot);
+
+    if (mechs == NULL) {
+        *count = num;
+        return CKR_OK;
+    }
+    if (*count < num) {
+        *count = num;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(mechs, mock_ep11_mechs, sizeof(mock_ep11_mechs));
+    *count = num;
+
+    return CKR_OK;
+}
+
+CK_RV m_GetMechanismInfo(CK_SLOT_ID slot, CK_MECHANISM_TYPE mech,
+                         CK_MECHANISM_INFO_PTR pmechinfo, target_t target)
+{
+    MOCK_EP11_ENTER(m_GetMechanismInfo, target);
+
+    UNUSED(slot);
+
+    memset(pmechinfo, 0, sizeof(*pmechinfo));
+
+    switch (mech) {
+    case CKM_AES_KEY_GEN:
+        pmechinfo->ulMinKeySize = 16;
+        pmechinfo->ulMaxKeySize = 32;
+        pmechinfo->flags = CKF_HW | CKF_GENERATE;
+        return CKR_OK;
+    case CKM_AES_ECB:
+    case CKM_AES_CBC:
+    case CKM_AES_CBC_PAD:
+        pmechinfo->ulMinKeySize = 16;
+        pmechinfo->ulMaxKeySize = 32;
+        pmechinfo->flags = CKF_HW | CKF_ENCRYPT | CKF_DECRYPT |
+                           CKF_WRAP | CKF_UNWRAP;
+        return CKR_OK;
+    case CKM_RSA_PKCS_KEY_PAIR_GEN:
+        pmechinfo->ulMinKeySize = 512;
+        pmechinfo->ulMaxKeySize = 4096;
+        pmechinfo->flags = CKF_HW | CKF_GENERATE_KEY_PAIR;
+        return CKR_OK;
+    case CKM_RSA_PKCS:
+        pmechinfo->ulMinKeySize = 512;
+        pmechinfo->ulMaxKeySize = 4096;
+        pmechinfo->flags = CKF_HW | CKF_ENCRYPT | CKF_DECRYPT |
+                           CKF_SIGN | CKF_VERIFY;
+        return CKR_OK;
+    case CKM_SHA1_RSA_PKCS:
+    case CKM_SHA224_RSA_PKCS:
+    case CKM_SHA256_RSA_PKCS:
+    case CKM_SHA384_RSA_PKCS:
+    case CKM_SHA512_RSA_PKCS:
+        pmechinfo->ulMinKeySize = 512;
+        pmechinfo->ulMaxKeySize = 4096;
+        pmechinfo->flags = CKF_HW | CKF_SIGN | CKF_VERIFY;
+        return CKR_OK;
+    case CKM_EC_KEY_PAIR_GEN:
+        pmechinfo->ulMinKeySize = 192;
+        pmechinfo->ulMaxKeySize = 521;
+        pmechinfo->flags = CKF_HW | CKF_GENERATE_KEY_PAIR | CKF_EC_F_P |
+                           CKF_EC_OID | CKF_EC_UNCOMPRESS;
+        return CKR_OK;
+    case CKM_ECDSA:
+    case CKM_ECDSA_SHA1:
+    case CKM_ECDSA_SHA224:
+    case CKM_ECDSA_SHA256:
+    case CKM_ECDSA_SHA384:
+    case CKM_ECDSA_SHA512:
+        pmechinfo->ulMinKeySize = 192;
+        pmechinfo->ulMaxKeySize = 521;
+        pmechinfo->flags = CKF_HW | CKF_SIGN | CKF_VERIFY | CKF_EC_F_P |
+                           CKF_EC_OID | CKF_EC_UNCOMPRESS;
+        return CKR_OK;
+    default:
+        if (mock_ep11_digest_md(mech) == NULL)
+            return CKR_MECHANISM_INVALID;
+        pmechinfo->flags = CKF_HW | CKF_DIGEST;
+        return CKR_OK;
+    }
+}
+
+/* Adds the attributes that a generated key has */
+static uint32_t mock_ep11_local_attrs(uint32_t attrs)
+{
+    attrs |= mock_ep11_attr_flag(CKA_LOCAL);
+    if (!(attrs & mock_ep11_attr_flag(CKA_EXTRACTABLE)))
+        attrs |= mock_ep11_attr_flag(CKA_NEVER_EXTRACTABLE);
+    if (attrs & mock_ep11_attr_flag(CKA_SENSITIVE))
+        attrs |= mock_ep11_attr_flag(CKA_ALWAYS_SENSITIVE);
+
+    return attrs;
+}
+
+CK_RV m_GenerateKey(CK_MECHANISM_PTR pmech,
+                    CK_ATTRIBUTE_PTR ptempl, CK_ULONG templcount,
+                    const unsigned char *pin, size_t pinlen,
+                    unsigned char *key, size_t *klen,
+                    unsigned char *csum, size_t *clen, target_t target)
+{
+    struct mock_ep11_blob blob;
+    unsigned char value[MOCK_EP11_MAX_KEY];
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_GenerateKey, target);
+
+    if (pmech->mechanism != CKM_AES_KEY_GEN)
+        return CKR_MECHANISM_INVALID;
+
+    memset(&blob, 0, sizeof(blob));
+    blob.key_type = CKK_AES;
+    blob.attrs = MOCK_EP11_ATTRS_DEFAULT;
+    rc = mock_ep11_apply_template(&blob, ptempl, templcount, 1);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (blob.key_type != CKK_AES)
+        return CKR_TEMPLATE_INCONSISTENT;
+    if (blob.value_len != 16 && blob.value_len != 24 &&
+        blob.value_len != 32)
+        return CKR_KEY_SIZE_RANGE;
+
+    blob.attrs = mock_ep11_local_attrs(blob.attrs);
+
+    if (RAND_bytes(value, blob.value_len) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    rc = mock_ep11_blob_seal(&blob, value, pin, pinlen, key, klen);
+    if (rc == CKR_OK)
+        rc = mock_ep11_csum(&blob, value, csum, clen);
+
+    OPENSSL_cleanse(value, sizeof(value));
+
+    return rc;
+}
+
+/* Returns the value of an attribute of a template, or NULL */
+static const CK_ATTRIBUTE *mock_ep11_find_attr(const CK_ATTRIBUTE *templ,
+                                               CK_ULONG count,
+                                               CK_ATTRIBUTE_TYPE type)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < count; i++) {
+        if (templ[i].type == type)
+            return &templ[i];
+    }
+
+    return NULL;
+}
+
+static CK_RV mock_ep11_rsa_keygen_init(EVP_PKEY_CTX *ctx,
+                                       const CK_ATTRIBUTE *templ,
+                                       CK_ULONG count)
+{
+    const CK_ATTRIBUTE *bits, *exp;
+    BIGNUM *e;
+    int ok;
+
+    bits = mock_ep11_find_attr(templ, count, CKA_MODULUS_BITS);
+    exp = mock_ep11_find_attr(templ, count, CKA_PUBLIC_EXPONENT);
+    if (bits == NULL || bits->ulValueLen != sizeof(CK_ULONG))
+        return CKR_TEMPLATE_INCOMPLETE;
+    if (*(CK_ULONG *)bits->pValue < 512 || *(CK_ULONG *)bits->pValue > 4096)
+        return CKR_KEY_SIZE_RANGE;
+
+    e = BN_new();
+    if (e == NULL)
+        return CKR_HOST_MEMORY;
+    if (exp != NULL && exp->ulValueLen > 0)
+        ok = BN_bin2bn(exp->pValue, exp->ulValueLen, e) != NULL;
+    else
+        ok = BN_set_word(e, 65537) == 1;
+
+    ok = ok && EVP_PKEY_CTX_set_rsa_keygen_bits(ctx,
+                                        *(CK_ULONG *)bits->pValue) == 1;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    if (ok && EVP_PKEY_CTX_set_rsa_keygen_pubexp(ctx, e) == 1)
+        e = NULL; /* owned by ctx */
+    else
+        ok = 0;
+#else
+    ok = ok && EVP_PKEY_CTX_set1_rsa_keygen_pubexp(ctx, e) == 1;
+#endif
+    BN_free(e);
+
+    return ok ? CKR_OK : CKR_TEMPLATE_INCONSISTENT;
+}
+
+static CK_RV mock_ep11_ec_keygen_init(EVP_PKEY_CTX *ctx,
+                                      const CK_ATTRIBUTE *templ,
+                                      CK_ULONG count)
+{
+    const CK_ATTRIBUTE *params;
+    const unsigned char *p;
+    ASN1_OBJECT *oid;
+    EC_GROUP *group;
+    int nid;
+
+    params = mock_ep11_find_attr(templ, count, CKA_EC_PARAMS);
+    if (params == NULL || params->ulValueLen == 0)
+        return CKR_TEMPLATE_INCOMPLETE;
+
+    p = params->pValue;
+    oid = d2i_ASN1_OBJECT(NULL, &p, params->ulValueLen);
+    if (oid == NULL)
+        return CKR_CURVE_NOT_SUPPORTED;
+    nid = OBJ_obj2nid(oid);
+    ASN1_OBJECT_free(oid);
+
+    /* Only Weierstrass curves, no Edwards or Montgomery curves */
+    group = nid != NID_undef ? EC_GROUP_new_by_curve_name(nid) : NULL;
+    if (group == NULL)
+        return CKR_CURVE_NOT_SUPPORTED;
+    EC_GROUP_free(group);
+
+    if (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, nid) != 1 ||
+        EVP_PKEY_CTX_set_ec_param_enc(ctx, OPENSSL_EC_NAMED_CURVE) != 1)
+        return CKR_CURVE_NOT_SUPPORTED;
+
+    return CKR_OK;
+}
+
+CK_RV m_GenerateKeyPair(CK_MECHANISM_PTR pmech,
+                        CK_ATTRIBUTE_PTR ppublic, CK_ULONG pubattrs,
+                        CK_ATTRIBUTE_PTR pprivate, CK_ULONG prvattrs,
+                        const unsigned char *pin, size_t pinlen,
+                        unsigned char *key, size_t *klen,
+                        unsigned char *pubkey, size_t *pklen,
+                        target_t target)
+{
+    struct mock_ep11_blob publ, priv;
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    CK_KEY_TYPE key_type;
+    int tries;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_GenerateKeyPair, target);
+
+    switch (pmech->mechanism) {
+    case CKM_RSA_PKCS_KEY_PAIR_GEN:
+        key_type = CKK_RSA;
+        break;
+    case CKM_EC_KEY_PAIR_GEN:
+        key_type = CKK_EC;
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    memset(&publ, 0, sizeof(publ));
+    publ.key_type = key_type;
+    publ.attrs = MOCK_EP11_ATTRS_DEFAULT;
+    priv = publ;
+    rc = mock_ep11_apply_template(&publ, ppublic, pubattrs, 1);
+    if (rc == CKR_OK)
+        rc = mock_ep11_apply_template(&priv, pprivate, prvattrs, 1);
+    if (rc != CKR_OK)
+        return rc;
+    if (publ.key_type != key_type || priv.key_type != key_type)
+        return CKR_TEMPLATE_INCONSISTENT;
+
+    ctx = EVP_PKEY_CTX_new_id(key_type == CKK_RSA ? EVP_PKEY_RSA :
+                                                    EVP_PKEY_EC, NULL);
+    if (ctx == NULL)
+        return CKR_HOST_MEMORY;
+    if (EVP_PKEY_keygen_init(ctx) != 1) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    rc = key_type == CKK_RSA ?
+                mock_ep11_rsa_keygen_init(ctx, ppublic, pubattrs) :
+                mock_ep11_ec_keygen_init(ctx, ppublic, pubattrs);
+    if (rc != CKR_OK)
+        goto out;
+
+    /* RSA key generation may fail with OpenSSL 3.0, retry */
+    for (tries = 0; tries < 10 && pkey == NULL; tries++) {
+        if (EVP_PKEY_keygen(ctx, &pkey) != 1)
+            pkey = NULL;
+    }
+    if (pkey == NULL) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    rc = mock_ep11_pkey_seal(pkey, mock_ep11_local_attrs(priv.attrs),
+                             pin, pinlen, key, klen);
+    if (rc == CKR_OK)
+        rc = mock_ep11_spki_seal_pkey(pkey, mock_ep11_local_attrs(publ.attrs),
+                                      pubkey, pklen);
+
+out:
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(ctx);
+
+    return rc;
+}
+
+static CK_RV mock_ep11_cipher_init(struct mock_ep11_cipher_state *state,
+                                   CK_MECHANISM_PTR pmech,
+                                   const unsigned char *key, size_t klen,
+                                   int encrypt, CK_ATTRIBUTE_TYPE usage)
+{
+    CK_RV rc;
+
+    memset(state, 0, sizeof(*state));
+
+    rc = mock_ep11_blob_open(key, klen, &state->blob, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (state->blob.key_type != CKK_AES)
+        return CKR_KEY_TYPE_INCONSISTENT;
+    if (!(state->blob.attrs & mock_ep11_attr_flag(usage)))
+        return CKR_KEY_FUNCTION_NOT_PERMITTED;
+
+    switch (pmech->mechanism) {
+    case CKM_AES_ECB:
+        break;
+    case CKM_AES_CBC:
+    case CKM_AES_CBC_PAD:
+        if (pmech->pParameter == NULL ||
+            pmech->ulParameterLen != AES_BLOCK_SIZE)
+            return CKR_MECHANISM_PARAM_INVALID;
+        memcpy(state->iv, pmech->pParameter, AES_BLOCK_SIZE);
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    memcpy(state->magic, MOCK_EP11_CIPHER_MAGIC, sizeof(state->magic));
+    state->encrypt = encrypt;
+    state->mech = pmech->mechanism;
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_cipher_state(const unsigned char *in, size_t len,
+                                    struct mock_ep11_cipher_state *state,
+                                    int encrypt)
+{
+    if (in == NULL || len < sizeof(*state))
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    memcpy(state, in, sizeof(*state));
+    if (memcmp(state->magic, MOCK_EP11_CIPHER_MAGIC,
+               sizeof(state->magic)) != 0 ||
+        state->encrypt != (uint32_t)encrypt ||
+        state->buf_len > AES_BLOCK_SIZE)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    return CKR_OK;
+}
+
+/* Copies len bytes at offset off of the concatenation of (a, alen) and b */
+static void mock_ep11_concat_copy(unsigned char *out,
+                                  const unsigned char *a, size_t alen,
+                                  const unsigned char *b,
+                                  size_t off, size_t len)
+{
+    size_t n;
+
+    if (off < alen) {
+        n = alen - off < len ? alen - off : len;
+        memcpy(out, a + off, n);
+        out += n;
+        len -= n;
+        off = alen;
+    }
+    memcpy(out, b + (off - alen), len);
+}
+
+/*
+ * Processes all complete blocks of the buffered data and the input, and
+ * buffers the rest. For decryption with padding, the last complete block is
+ * kept for the final operation. If out is NULL, only the output length is
+ * returned, and the state is not changed.
+ */
+static CK_RV mock_ep11_cipher_update(struct mock_ep11_cipher_state *state,
+                                     const unsigned char *in, size_t in_len,
+                                     unsigned char *out, CK_ULONG_PTR out_len)
+{
+    unsigned char key[MOCK_EP11_MAX_KEY], iv[AES_BLOCK_SIZE];
+    struct mock_ep11_blob blob;
+    EVP_CIPHER_CTX *ctx = NULL;
+    size_t total, process, keep;
+    int len1 = 0, len2 = 0;
+    CK_RV rc;
+
+    total = state->buf_len + in_len;
+    process = total - total % AES_BLOCK_SIZE;
+    if (!state->encrypt && state->mech == CKM_AES_CBC_PAD &&
+        total % AES_BLOCK_SIZE == 0 && process > 0)
+        process -= AES_BLOCK_SIZE;
+    keep = total - process;
+
+    if (out == NULL) {
+        *out_len = process;
+        return CKR_OK;
+    }
+    if (*out_len < process) {
+        *out_len = process;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    if (process == 0) {
+        memcpy(state->buf + state->buf_len, in, in_len);
+        state->buf_len += in_len;
+        *out_len = 0;
+        return CKR_OK;
+    }
+
+    rc = mock_ep11_blob_open((unsigned char *)&state->blob,
+                             sizeof(state->blob), &blob, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (state->mech != CKM_AES_ECB)
+        mock_ep11_concat_copy(iv, state->buf, state->buf_len, in,
+                              process - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL ||
+        EVP_CipherInit_ex(ctx, mock_ep11_aes_cipher(state->mech,
+                                                    state->blob.value_len),
+                          NULL, key,
+                          state->mech == CKM_AES_ECB ? NULL : state->iv,
+                          state->encrypt) != 1 ||
+        EVP_CIPHER_CTX_set_padding(ctx, 0) != 1 ||
+        EVP_CipherUpdate(ctx, out, &len1, state->buf,
+                         state->buf_len) != 1 ||
+        EVP_CipherUpdate(ctx, out + len1, &len2, in,
+                         process - state->buf_len) != 1) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    /* The next chaining value is the last cipher text block */
+    if (state->mech != CKM_AES_ECB)
+        memcpy(state->iv, state->encrypt ?
+                            out + process - AES_BLOCK_SIZE : iv,
+               AES_BLOCK_SIZE);
+
+    memcpy(state->buf, in + in_len - keep, keep);
+    state->buf_len = keep;
+    *out_len = process;
+
+out:
+    OPENSSL_cleanse(key, sizeof(key));
+    EVP_CIPHER_CTX_free(ctx);
+
+    return rc;
+}
+
+/* Processes the buffered data, including padding */
+static CK_RV mock_ep11_cipher_final(struct mock_ep11_cipher_state *state,
+                                    unsigned char *out, CK_ULONG_PTR out_len)
+{
+    unsigned char block[AES_BLOCK_SIZE], res[AES_BLOCK_SIZE];
+    CK_ULONG len = sizeof(res);
+    unsigned int i, pad;
+    CK_RV rc;
+
+    if (state->mech != CKM_AES_CBC_PAD) {
+        if (state->buf_len != 0)
+            return state->encrypt ? CKR_DATA_LEN_RANGE :
+                                    CKR_ENCRYPTED_DATA_LEN_RANGE;
+        *out_len = 0;
+        return CKR_OK;
+    }
+
+    if (out == NULL) {
+        *out_len = AES_BLOCK_SIZE;
+        return CKR_OK;
+    }
+
+    if (state->encrypt) {
+        pad = AES_BLOCK_SIZE - state->buf_len;
+        memcpy(block, state->buf, state->buf_len);
+        memset(block + state->buf_len, pad, pad);
+    } else {
+        if (state->buf_len != AES_BLOCK_SIZE)
+            return CKR_ENCRYPTED_DATA_LEN_RANGE;
+        memcpy(block, state->buf, AES_BLOCK_SIZE);
+    }
+
+    /* Process the last block without padding */
+    state->mech = CKM_AES_CBC;
+    state->buf_len = 0;
+    rc = mock_ep11_cipher_update(state, block, sizeof(block), res, &len);
+    if (rc != CKR_OK)
+        return rc;
+
+    len = AES_BLOCK_SIZE;
+    if (!state->encrypt) {
+        pad = res[AES_BLOCK_SIZE - 1];
+        if (pad == 0 || pad > AES_BLOCK_SIZE)
+            return CKR_ENCRYPTED_DATA_INVALID;
+        for (i = 1; i <= pad; i++) {
+            if (res[AES_BLOCK_SIZE - i] != pad)
+                return CKR_ENCRYPTED_DATA_INVALID;
+        }
+        len -= pad;
+    }
+
+    if (*out_len < len) {
+        *out_len = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(out, res, len);
+    *out_len = len;
+    OPENSSL_cleanse(res, sizeof(res));
+
+    return CKR_OK;
+}
+
+/* Update and final operation in one step */
+static CK_RV mock_ep11_cipher_single(struct mock_ep11_cipher_state *state,
+                                     const unsigned char *in, size_t in_len,
+                                     unsigned char *out, CK_ULONG_PTR out_len)
+{
+    CK_ULONG len1, len2, needed = in_len;
+    CK_RV rc;
+
+    if (state->encrypt && state->mech == CKM_AES_CBC_PAD)
+        needed = (in_len / AES_BLOCK_SIZE + 1) * AES_BLOCK_SIZE;
+
+    if (out == NULL) {
+        *out_len = needed;
+        return CKR_OK;
+    }
+    if (*out_len < needed) {
+        *out_len = needed;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    len1 = *out_len;
+    rc = mock_ep11_cipher_update(state, in, in_len, out, &len1);
+    if (rc != CKR_OK)
+        return rc;
+
+    len2 = *out_len - len1;
+    rc = mock_ep11_cipher_final(state, out + len1, &len2);
+    if (rc != CKR_OK)
+        return rc;
+
+    *out_len = len1 + len2;
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_cipher_init_state(unsigned char *state, size_t *slen,
+                                         CK_MECHANISM_PTR pmech,
+                                         const unsigned char *key,
+                                         size_t klen, int encrypt)
+{
+    struct mock_ep11_cipher_state st;
+    CK_RV rc;
+
+    if (state == NULL) {
+        *slen = sizeof(st);
+        return CKR_OK;
+    }
+    if (*slen < sizeof(st)) {
+        *slen = sizeof(st);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    rc = mock_ep11_cipher_init(&st, pmech, key, klen, encrypt,
+                               encrypt ? CKA_ENCRYPT : CKA_DECRYPT);
+    if (rc != CKR_OK)
+        return rc;
+
+    memcpy(state, &st, sizeof(st));
+    *slen = sizeof(st);
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_cipher_update_state(unsigned char *state, size_t slen,
+                                           CK_BYTE_PTR in, CK_ULONG in_len,
+                                           CK_BYTE_PTR out,
+                                           CK_ULONG_PTR out_len, int encrypt)
+{
+    struct mock_ep11_cipher_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_cipher_state(state, slen, &st, encrypt);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = mock_ep11_cipher_update(&st, in, in_len, out, out_len);
+    if (rc == CKR_OK && out != NULL)
+        memcpy(state, &st, sizeof(st));
+
+    return rc;
+}
+
+static CK_RV mock_ep11_cipher_final_state(const unsigned char *state,
+                                          size_t slen, CK_BYTE_PTR out,
+                                          CK_ULONG_PTR out_len, int encrypt)
+{
+    struct mock_ep11_cipher_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_cipher_state(state, slen, &st, encrypt);
+    if (rc != CKR_OK)
+        return rc;
+
+    return mock_ep11_cipher_final(&st, out, out_len);
+}
+
+static CK_RV mock_ep11_cipher_one_state(const unsigned char *state,
+                                        size_t slen, CK_BYTE_PTR in,
+                                        CK_ULONG in_len, CK_BYTE_PTR out,
+                                        CK_ULONG_PTR out_len, int encrypt)
+{
+    struct mock_ep11_cipher_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_cipher_state(state, slen, &st, encrypt);
+    if (rc != CKR_OK)
+        return rc;
+
+    return mock_ep11_cipher_single(&st, in, in_len, out, out_len);
+}
+
+static CK_RV mock_ep11_cipher_single_key(const unsigned char *key,
+                                         size_t klen, CK_MECHANISM_PTR mech,
+                                         CK_BYTE_PTR in, CK_ULONG in_len,
+                                         CK_BYTE_PTR out,
+                                         CK_ULONG_PTR out_len, int encrypt)
+{
+    struct mock_ep11_cipher_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_cipher_init(&st, mech, key, klen, encrypt,
+                               encrypt ? CKA_ENCRYPT : CKA_DECRYPT);
+    if (rc != CKR_OK)
+        return rc;
+
+    return mock_ep11_cipher_single(&st, in, in_len, out, out_len);
+}
+
+static CK_RV mock_ep11_pkey_init(struct mock_ep11_pkey_state *state,
+                                 CK_MECHANISM_PTR pmech,
+                                 const unsigned char *key, size_t klen,
+                                 CK_ATTRIBUTE_TYPE usage)
+{
+    CK_OBJECT_CLASS class;
+    CK_KEY_TYPE key_type, mech_key_type;
+    const EVP_MD *md;
+    uint32_t attrs;
+    CK_RV rc;
+
+    memset(state, 0, sizeof(*state));
+
+    rc = mock_ep11_pkey_mech(pmech->mechanism, &mech_key_type, &md);
+    if (rc != CKR_OK)
+        return rc;
+    if (md != NULL && (usage == CKA_ENCRYPT || usage == CKA_DECRYPT))
+        return CKR_MECHANISM_INVALID;
+    if (mech_key_type == CKK_EC && (usage == CKA_ENCRYPT ||
+                                    usage == CKA_DECRYPT))
+        return CKR_MECHANISM_INVALID;
+
+    if (klen > sizeof(state->key))
+        return CKR_KEY_HANDLE_INVALID;
+    rc = mock_ep11_pkey_open(key, klen, &class, &key_type, &attrs, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (key_type != mech_key_type)
+        return CKR_KEY_TYPE_INCONSISTENT;
+    if (class != ((usage == CKA_SIGN || usage == CKA_DECRYPT) ?
+                                    CKO_PRIVATE_KEY : CKO_PUBLIC_KEY) ||
+        !(attrs & mock_ep11_attr_flag(usage)))
+        return CKR_KEY_FUNCTION_NOT_PERMITTED;
+
+    if (md != NULL) {
+        state->ctx = EVP_MD_CTX_new();
+        if (state->ctx == NULL)
+            return CKR_HOST_MEMORY;
+        if (EVP_DigestInit_ex(state->ctx, md, NULL) != 1) {
+            EVP_MD_CTX_free(state->ctx);
+            state->ctx = NULL;
+            return CKR_FUNCTION_FAILED;
+        }
+    }
+
+    memcpy(state->magic, MOCK_EP11_PKEY_OP_MAGIC, sizeof(state->magic));
+    state->key_len = klen;
+    state->usage = usage;
+    state->mech = pmech->mechanism;
+    memcpy(state->key, key, klen);
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_pkey_state(const unsigned char *in, size_t len,
+                                  struct mock_ep11_pkey_state *state,
+                                  CK_ATTRIBUTE_TYPE usage)
+{
+    if (in == NULL || len < sizeof(*state))
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    memcpy(state, in, sizeof(*state));
+    if (memcmp(state->magic, MOCK_EP11_PKEY_OP_MAGIC,
+               sizeof(state->magic)) != 0 ||
+        state->usage != usage || state->key_len > sizeof(state->key))
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    return CKR_OK;
+}
+
+/* Returns 1 if the state is a sign, verify, encrypt or decrypt state */
+static int mock_ep11_is_pkey_state(const unsigned char *state, size_t slen)
+{
+    return state != NULL && slen >= sizeof(struct mock_ep11_pkey_state) &&
+           memcmp(state, MOCK_EP11_PKEY_OP_MAGIC,
+                  sizeof(((struct mock_ep11_pkey_state *)NULL)->magic)) == 0;
+}
+
+/* Converts a DER encoded ECDSA signature to r || s of n bytes each */
+static int mock_ep11_ecdsa_sig_raw(const unsigned char *der, size_t der_len,
+                                   unsigned char *out, int n)
+{
+    const BIGNUM *r, *s;
+    ECDSA_SIG *sig;
+    int ok;
+
+    sig = d2i_ECDSA_SIG(NULL, &der, der_len);
+    if (sig == NULL)
+        return 0;
+
+    ECDSA_SIG_get0(sig, &r, &s);
+    ok = BN_bn2binpad(r, out, n) == n && BN_bn2binpad(s, out + n, n) == n;
+    ECDSA_SIG_free(sig);
+
+    return ok;
+}
+
+/* Converts r || s of n bytes each to a DER encoded ECDSA signature */
+static int mock_ep11_ecdsa_sig_der(const unsigned char *raw, int n,
+                                   unsigned char *der, size_t *der_len)
+{
+    BIGNUM *r, *s;
+    ECDSA_SIG *sig;
+    int len;
+
+    sig = ECDSA_SIG_new();
+    r = BN_bin2bn(raw, n, NULL);
+    s = BN_bin2bn(raw + n, n, NULL);
+    if (sig == NULL || r == NULL || s == NULL ||
+        ECDSA_SIG_set0(sig, r, s) != 1) {
+        ECDSA_SIG_free(sig);
+        BN_free(r);
+        BN_free(s);
+        return 0;
+    }
+
+    len = i2d_ECDSA_SIG(sig, NULL);
+    if (len > 0 && (size_t)len <= *der_len)
+        len = i2d_ECDSA_SIG(sig, &der);
+    ECDSA_SIG_free(sig);
+    if (len <= 0 || (size_t)len > *der_len)
+        return 0;
+    *der_len = len;
+
+    return 1;
+}
+
+/*
+ * Signs, verifies, encrypts or decrypts (in, in_len) with the key of the
+ * state, without hashing. For verification, (out, *out_len) is the
+ * signature. If out is NULL, only the output length is returned.
+ */
+static CK_RV mock_ep11_pkey_op(const struct mock_ep11_pkey_state *state,
+                               const unsigned char *in, size_t in_len,
+                               unsigned char *out, CK_ULONG_PTR out_len)
+{
+    unsigned char buf[MOCK_EP11_MAX_DER];
+    size_t len = sizeof(buf), n;
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    CK_KEY_TYPE key_type;
+    const EVP_MD *md;
+    int ok;
+    CK_RV rc;
+
+    rc = mock_ep11_pkey_open(state->key, state->key_len, NULL, &key_type,
+                             NULL, &pkey);
+    if (rc != CKR_OK)
+        return rc;
+    mock_ep11_pkey_mech(state->mech, &key_type, &md);
+
+    /* The modulus size, or the size of r || s */
+    n = key_type == CKK_RSA ? (size_t)EVP_PKEY_size(pkey) :
+                              2 * (((size_t)EVP_PKEY_bits(pkey) + 7) / 8);
+
+    if (state->usage != CKA_VERIFY) {
+        if (out == NULL) {
+            *out_len = n;
+            goto out;
+        }
+        if (*out_len < n && state->usage != CKA_DECRYPT) {
+            *out_len = n;
+            rc = CKR_BUFFER_TOO_SMALL;
+            goto out;
+        }
+    }
+
+    ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    if (ctx == NULL) {
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    switch (state->usage) {
+    case CKA_SIGN:
+        ok = EVP_PKEY_sign_init(ctx) == 1;
+        break;
+    case CKA_VERIFY:
+        /* OpenSSL does not verify an empty message with raw RSA PKCS */
+        if (key_type == CKK_RSA && md == NULL)
+            ok = EVP_PKEY_verify_recover_init(ctx) == 1;
+        else
+            ok = EVP_PKEY_verify_init(ctx) == 1;
+        break;
+    case CKA_ENCRYPT:
+        ok = EVP_PKEY_encrypt_init(ctx) == 1;
+        break;
+    default:
+        ok = EVP_PKEY_decrypt_init(ctx) == 1;
+        break;
+    }
+    if (ok && key_type == CKK_RSA)
+        ok = EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) == 1;
+    if (ok && md != NULL)
+        ok = EVP_PKEY_CTX_set_signature_md(ctx, md) == 1;
+    if (!ok) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    switch (state->usage) {
+    case CKA_SIGN:
+        if (key_type == CKK_RSA && md == NULL && in_len > n - 11) {
+            rc = CKR_DATA_LEN_RANGE;
+            break;
+        }
+        if (key_type == CKK_RSA) {
+            len = n;
+            ok = EVP_PKEY_sign(ctx, out, &len, in, in_len) == 1;
+        } else {
+            ok = EVP_PKEY_sign(ctx, buf, &len, in, in_len) == 1 &&
+                 mock_ep11_ecdsa_sig_raw(buf, len, out, n / 2);
+            len = n;
+        }
+        if (!ok)
+            rc = CKR_FUNCTION_FAILED;
+        *out_len = len;
+        break;
+    case CKA_VERIFY:
+        if (*out_len != n) {
+            rc = CKR_SIGNATURE_LEN_RANGE;
+            break;
+        }
+        if (key_type == CKK_RSA && md == NULL)
+            ok = EVP_PKEY_verify_recover(ctx, buf, &len, out, n) == 1 &&
+                 len == in_len && (in_len == 0 || memcmp(buf, in, len) == 0);
+        else if (key_type == CKK_RSA)
+            ok = EVP_PKEY_verify(ctx, out, n, in, in_len) == 1;
+        else
+            ok = mock_ep11_ecdsa_sig_der(out, n / 2, buf, &len) &&
+                 EVP_PKEY_verify(ctx, buf, len, in, in_len) == 1;
+        if (!ok)
+            rc = CKR_SIGNATURE_INVALID;
+        break;
+    case CKA_ENCRYPT:
+        if (in_len > n - 11) {
+            rc = CKR_DATA_LEN_RANGE;
+            break;
+        }
+        len = n;
+        if (EVP_PKEY_encrypt(ctx, out, &len, in, in_len) != 1)
+            rc = CKR_FUNCTION_FAILED;
+        *out_len = len;
+        break;
+    default:
+        if (in_len != n) {
+            rc = CKR_ENCRYPTED_DATA_LEN_RANGE;
+            break;
+        }
+        if (EVP_PKEY_decrypt(ctx, buf, &len, in, in_len) != 1) {
+            rc = CKR_ENCRYPTED_DATA_INVALID;
+            break;
+        }
+        if (*out_len < len)
+            rc = CKR_BUFFER_TOO_SMALL;
+        else
+            memcpy(out, buf, len);
+        *out_len = len;
+        OPENSSL_cleanse(buf, sizeof(buf));
+        break;
+    }
+
+out:
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
+/*
+ * Completes the operation of the state with the data (in, in_len), which is
+ * hashed first for the hash and sign mechanisms. For verification, (out,
+ * *out_len) is the signature. The digest context is freed, unless only the
+ * output length is returned.
+ */
+static CK_RV mock_ep11_pkey_final(struct mock_ep11_pkey_state *state,
+                                  const unsigned char *in, size_t in_len,
+                                  unsigned char *out, CK_ULONG_PTR out_len)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len;
+    CK_ULONG len;
+    CK_RV rc;
+
+    if (state->ctx == NULL)
+        return mock_ep11_pkey_op(state, in, in_len, out, out_len);
+
+    if (state->usage == CKA_SIGN) {
+        rc = mock_ep11_pkey_op(state, NULL, 0, NULL, &len);
+        if (rc != CKR_OK)
+            return rc;
+        if (out == NULL || *out_len < len) {
+            *out_len = len;
+            return out == NULL ? CKR_OK : CKR_BUFFER_TOO_SMALL;
+        }
+    }
+
+    if ((in_len > 0 && EVP_DigestUpdate(state->ctx, in, in_len) != 1) ||
+        EVP_DigestFinal_ex(state->ctx, digest, &digest_len) != 1)
+        rc = CKR_FUNCTION_FAILED;
+    else
+        rc = mock_ep11_pkey_op(state, digest, digest_len, out, out_len);
+
+    EVP_MD_CTX_free(state->ctx);
+    state->ctx = NULL;
+
+    return rc;
+}
+
+static CK_RV mock_ep11_pkey_init_state(unsigned char *state, size_t *slen,
+                                       CK_MECHANISM_PTR pmech,
+                                       const unsigned char *key, size_t klen,
+                                       CK_ATTRIBUTE_TYPE usage)
+{
+    struct mock_ep11_pkey_state st;
+    CK_RV rc;
+
+    if (state == NULL) {
+        *slen = sizeof(st);
+        return CKR_OK;
+    }
+    if (*slen < sizeof(st)) {
+        *slen = sizeof(st);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    rc = mock_ep11_pkey_init(&st, pmech, key, klen, usage);
+    if (rc != CKR_OK)
+        return rc;
+
+    memcpy(state, &st, sizeof(st));
+    *slen = sizeof(st);
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_pkey_update_state(unsigned char *state, size_t slen,
+                                         CK_BYTE_PTR data, CK_ULONG dlen,
+                                         CK_ATTRIBUTE_TYPE usage)
+{
+    struct mock_ep11_pkey_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_pkey_state(state, slen, &st, usage);
+    if (rc != CKR_OK)
+        return rc;
+
+    /* Multi-part operations with the hash and sign mechanisms only */
+    if (st.ctx == NULL)
+        return CKR_MECHANISM_INVALID;
+    if (dlen > 0 && EVP_DigestUpdate(st.ctx, data, dlen) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_pkey_final_state(const unsigned char *state,
+                                        size_t slen, CK_BYTE_PTR in,
+                                        CK_ULONG in_len, CK_BYTE_PTR out,
+                                        CK_ULONG_PTR out_len,
+                                        CK_ATTRIBUTE_TYPE usage)
+{
+    struct mock_ep11_pkey_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_pkey_state(state, slen, &st, usage);
+    if (rc != CKR_OK)
+        return rc;
+
+    return mock_ep11_pkey_final(&st, in, in_len, out, out_len);
+}
+
+static CK_RV mock_ep11_pkey_single_key(const unsigned char *key, size_t klen,
+                                       CK_MECHANISM_PTR mech,
+                                       CK_BYTE_PTR in, CK_ULONG in_len,
+                                       CK_BYTE_PTR out, CK_ULONG_PTR out_len,
+                                       CK_ATTRIBUTE_TYPE usage)
+{
+    struct mock_ep11_pkey_state st;
+    CK_RV rc;
+
+    rc = mock_ep11_pkey_init(&st, mech, key, klen, usage);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = mock_ep11_pkey_final(&st, in, in_len, out, out_len);
+    EVP_MD_CTX_free(st.ctx);
+
+    return rc;
+}
+
+CK_RV m_EncryptInit(unsigned char *state, size_t *slen,
+                    CK_MECHANISM_PTR pmech,
+                    const unsigned char *key, size_t klen, target_t target)
+{
+    MOCK_EP11_ENTER(m_EncryptInit, target);
+
+    if (!mock_ep11_is_secret(key, klen))
+        return mock_ep11_pkey_init_state(state, slen, pmech, key, klen,
+                                         CKA_ENCRYPT);
+
+    return mock_ep11_cipher_init_state(state, slen, pmech, key, klen, 1);
+}
+
+CK_RV m_DecryptInit(unsigned char *state, size_t *slen,
+                    CK_MECHANISM_PTR pmech,
+                    const unsigned char *key, size_t klen, target_t target)
+{
+    MOCK_EP11_ENTER(m_DecryptInit, target);
+
+    if (!mock_ep11_is_secret(key, klen))
+        return mock_ep11_pkey_init_state(state, slen, pmech, key, klen,
+                                         CKA_DECRYPT);
+
+    return mock_ep11_cipher_init_state(state, slen, pmech, key, klen, 0);
+}
+
+CK_RV m_EncryptUpdate(unsigned char *state, size_t slen,
+                      CK_BYTE_PTR plain, CK_ULONG plen,
+                      CK_BYTE_PTR cipher, CK_ULONG_PTR clen, target_t target)
+{
+    MOCK_EP11_ENTER(m_EncryptUpdate, target);
+
+    return mock_ep11_cipher_update_state(state, slen, plain, plen,
+                                         cipher, clen, 1);
+}
+
+CK_RV m_DecryptUpdate(unsigned char *state, size_t slen,
+                      CK_BYTE_PTR cipher, CK_ULONG clen,
+                      CK_BYTE_PTR plain, CK_ULONG_PTR plen, target_t target)
+{
+    MOCK_EP11_ENTER(m_DecryptUpdate, target);
+
+    return mock_ep11_cipher_update_state(state, slen, cipher, clen,
+                                         plain, plen, 0);
+}
+
+CK_RV m_Encrypt(const unsigned char *state, size_t slen,
+                CK_BYTE_PTR plain, CK_ULONG plen,
+                CK_BYTE_PTR cipher, CK_ULONG_PTR clen, target_t target)
+{
+    MOCK_EP11_ENTER(m_Encrypt, target);
+
+    if (mock_ep11_is_pkey_state(state, slen))
+        return mock_ep11_pkey_final_state(state, slen, plain, plen,
+                                          cipher, clen, CKA_ENCRYPT);
+
+    return mock_ep11_cipher_one_state(state, slen, plain, plen,
+                                      cipher, clen, 1);
+}
+
+CK_RV m_Decrypt(const unsigned char *state, size_t slen,
+                CK_BYTE_PTR cipher, CK_ULONG clen,
+                CK_BYTE_PTR plain, CK_ULONG_PTR plen, target_t target)
+{
+    MOCK_EP11_ENTER(m_Decrypt, target);
+
+    if (mock_ep11_is_pkey_state(state, slen))
+        return mock_ep11_pkey_final_state(state, slen, cipher, clen,
+                                          plain, plen, CKA_DECRYPT);
+
+    return mock_ep11_cipher_one_state(state, slen, cipher, clen,
+                                      plain, plen, 0);
+}
+
+CK_RV m_EncryptFinal(const unsigned char *state, size_t slen,
+                     CK_BYTE_PTR output, CK_ULONG_PTR len, target_t target)
+{
+    MOCK_EP11_ENTER(m_EncryptFinal, target);
+
+    return mock_ep11_cipher_final_state(state, slen, output, len, 1);
+}
+
+CK_RV m_DecryptFinal(const unsigned char *state, size_t slen,
+                     CK_BYTE_PTR output, CK_ULONG_PTR len, target_t target)
+{
+    MOCK_EP11_ENTER(m_DecryptFinal, target);
+
+    return mock_ep11_cipher_final_state(state, slen, output, len, 0);
+}
+
+CK_RV m_EncryptSingle(const unsigned char *key, size_t klen,
+                      CK_MECHANISM_PTR mech,
+                      CK_BYTE_PTR plain, CK_ULONG plen,
+                      CK_BYTE_PTR cipher, CK_ULONG_PTR clen, target_t target)
+{
+    MOCK_EP11_ENTER(m_EncryptSingle, target);
+
+    if (!mock_ep11_is_secret(key, klen))
+        return mock_ep11_pkey_single_key(key, klen, mech, plain, plen,
+                                         cipher, clen, CKA_ENCRYPT);
+
+    return mock_ep11_cipher_single_key(key, klen, mech, plain, plen,
+                                       cipher, clen, 1);
+}
+
+CK_RV m_DecryptSingle(const unsigned char *key, size_t klen,
+                      CK_MECHANISM_PTR mech,
+                      CK_BYTE_PTR cipher, CK_ULONG clen,
+                      CK_BYTE_PTR plain, CK_ULONG_PTR plen, target_t target)
+{
+    MOCK_EP11_ENTER(m_DecryptSingle, target);
+
+    if (!mock_ep11_is_secret(key, klen))
+        return mock_ep11_pkey_single_key(key, klen, mech, cipher, clen,
+                                         plain, plen, CKA_DECRYPT);
+
+    return mock_ep11_cipher_single_key(key, klen, mech, cipher, clen,
+                                       plain, plen, 0);
+}
+
+CK_RV m_SignInit(unsigned char *state, size_t *slen, CK_MECHANISM_PTR alg,
+                 const unsigned char *key, size_t klen, target_t target)
+{
+    MOCK_EP11_ENTER(m_SignInit, target);
+
+    return mock_ep11_pkey_init_state(state, slen, alg, key, klen, CKA_SIGN);
+}
+
+CK_RV m_VerifyInit(unsigned char *state, size_t *slen, CK_MECHANISM_PTR alg,
+                   const unsigned char *key, size_t klen, target_t target)
+{
+    MOCK_EP11_ENTER(m_VerifyInit, target);
+
+    return mock_ep11_pkey_init_state(state, slen, alg, key, klen, CKA_VERIFY);
+}
+
+CK_RV m_SignUpdate(unsigned char *state, size_t slen,
+                   CK_BYTE_PTR data, CK_ULONG dlen, target_t target)
+{
+    MOCK_EP11_ENTER(m_SignUpdate, target);
+
+    return mock_ep11_pkey_update_state(state, slen, data, dlen, CKA_SIGN);
+}
+
+CK_RV m_VerifyUpdate(unsigned char *state, size_t slen,
+                     CK_BYTE_PTR data, CK_ULONG dlen, target_t target)
+{
+    MOCK_EP11_ENTER(m_VerifyUpdate, target);
+
+    return mock_ep11_pkey_update_state(state, slen, data, dlen, CKA_VERIFY);
+}
+
+CK_RV m_SignFinal(const unsigned char *state, size_t stlen,
+                  CK_BYTE_PTR sig, CK_ULONG_PTR siglen, target_t target)
+{
+    struct mock_ep11_pkey_state st;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_SignFinal, target);
+
+    rc = mock_ep11_pkey_state(state, stlen, &st, CKA_SIGN);
+    if (rc != CKR_OK)
+        return rc;
+    if (st.ctx == NULL)
+        return CKR_MECHANISM_INVALID;
+
+    return mock_ep11_pkey_final(&st, NULL, 0, sig, siglen);
+}
+
+CK_RV m_VerifyFinal(const unsigned char *state, size_t stlen,
+                    CK_BYTE_PTR sig, CK_ULONG siglen, target_t target)
+{
+    struct mock_ep11_pkey_state st;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_VerifyFinal, target);
+
+    rc = mock_ep11_pkey_state(state, stlen, &st, CKA_VERIFY);
+    if (rc != CKR_OK)
+        return rc;
+    if (st.ctx == NULL)
+        return CKR_MECHANISM_INVALID;
+
+    return mock_ep11_pkey_final(&st, NULL, 0, sig, &siglen);
+}
+
+CK_RV m_Sign(const unsigned char *state, size_t stlen,
+             CK_BYTE_PTR data, CK_ULONG dlen,
+             CK_BYTE_PTR sig, CK_ULONG_PTR siglen, target_t target)
+{
+    MOCK_EP11_ENTER(m_Sign, target);
+
+    return mock_ep11_pkey_final_state(state, stlen, data, dlen,
+                                      sig, siglen, CKA_SIGN);
+}
+
+CK_RV m_Verify(const unsigned char *state, size_t stlen,
+               CK_BYTE_PTR data, CK_ULONG dlen,
+               CK_BYTE_PTR sig, CK_ULONG siglen, target_t target)
+{
+    MOCK_EP11_ENTER(m_Verify, target);
+
+    return mock_ep11_pkey_final_state(state, stlen, data, dlen,
+                                      sig, &siglen, CKA_VERIFY);
+}
+
+CK_RV m_SignSingle(const unsigned char *key, size_t klen,
+                   CK_MECHANISM_PTR pmech,
+                   CK_BYTE_PTR data, CK_ULONG dlen,
+                   CK_BYTE_PTR sig, CK_ULONG_PTR slen, target_t target)
+{
+    MOCK_EP11_ENTER(m_SignSingle, target);
+
+    return mock_ep11_pkey_single_key(key, klen, pmech, data, dlen,
+                                     sig, slen, CKA_SIGN);
+}
+
+CK_RV m_VerifySingle(const unsigned char *key, size_t klen,
+                     CK_MECHANISM_PTR pmech,
+                     CK_BYTE_PTR data, CK_ULONG dlen,
+                     CK_BYTE_PTR sig, CK_ULONG slen, target_t target)
+{
+    MOCK_EP11_ENTER(m_VerifySingle, target);
+
+    return mock_ep11_pkey_single_key(key, klen, pmech, data, dlen,
+                                     sig, &slen, CKA_VERIFY);
+}
+
+/* Returns the value of a secret key, or the PKCS#8 encoding of a private key */
+static CK_RV mock_ep11_wrap_value(const unsigned char *key, size_t keylen,
+                                  unsigned char *value, size_t *value_len)
+{
+    PKCS8_PRIV_KEY_INFO *p8 = NULL;
+    struct mock_ep11_blob blob;
+    EVP_PKEY *pkey = NULL;
+    uint32_t attrs;
+    int len;
+    CK_RV rc;
+
+    if (mock_ep11_is_secret(key, keylen)) {
+        rc = mock_ep11_blob_open(key, keylen, &blob, value);
+        if (rc != CKR_OK)
+            return rc;
+        if (!(blob.attrs & mock_ep11_attr_flag(CKA_EXTRACTABLE)))
+            return CKR_KEY_UNEXTRACTABLE;
+        *value_len = blob.value_len;
+        return CKR_OK;
+    }
+
+    if (!mock_ep11_is_private(key, keylen))
+        return CKR_KEY_NOT_WRAPPABLE;
+    rc = mock_ep11_pkey_open(key, keylen, NULL, NULL, &attrs, &pkey);
+    if (rc != CKR_OK)
+        return rc;
+    if (!(attrs & mock_ep11_attr_flag(CKA_EXTRACTABLE))) {
+        rc = CKR_KEY_UNEXTRACTABLE;
+        goto out;
+    }
+
+    p8 = EVP_PKEY2PKCS8(pkey);
+    len = p8 != NULL ? i2d_PKCS8_PRIV_KEY_INFO(p8, NULL) : 0;
+    if (len <= 0 || len > MOCK_EP11_MAX_DER ||
+        i2d_PKCS8_PRIV_KEY_INFO(p8, &value) != len) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+    *value_len = len;
+
+out:
+    PKCS8_PRIV_KEY_INFO_free(p8);
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
+/* Secret and private keys are wrapped by encryption with an AES KEK */
+CK_RV m_WrapKey(const unsigned char *key, size_t keylen,
+                const unsigned char *kek, size_t keklen,
+                const unsigned char *mackey, size_t mklen,
+                const CK_MECHANISM_PTR pmech,
+                CK_BYTE_PTR wrapped, CK_ULONG_PTR wlen, target_t target)
+{
+    struct mock_ep11_cipher_state st;
+    unsigned char value[MOCK_EP11_MAX_DER];
+    size_t len = 0;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_WrapKey, target);
+
+    UNUSED(mackey);
+    UNUSED(mklen);
+
+    rc = mock_ep11_cipher_init(&st, pmech, kek, keklen, 1, CKA_WRAP);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = mock_ep11_wrap_value(key, keylen, value, &len);
+    if (rc == CKR_OK) {
+        rc = mock_ep11_cipher_single(&st, value, len, wrapped, wlen);
+        if (rc == CKR_DATA_LEN_RANGE)
+            rc = CKR_KEY_SIZE_RANGE;
+    }
+
+    OPENSSL_cleanse(value, sizeof(value));
+
+    return rc;
+}
+
+/*
+ * Imports a public key, and returns it as MACed SPKI. The SPKI may be a
+ * MACed SPKI already, then it is MACed again with the new attributes.
+ */
+static CK_RV mock_ep11_unwrap_spki(const unsigned char *spki, size_t len,
+                                   const CK_ATTRIBUTE *templ, CK_ULONG count,
+                                   unsigned char *out, size_t *out_len)
+{
+    struct mock_ep11_blob attrs;
+    const unsigned char *p = spki;
+    EVP_PKEY *pkey;
+    CK_RV rc;
+
+    len = mock_ep11_der_seq_len(spki, len);
+    pkey = d2i_PUBKEY(NULL, &p, len);
+    if (pkey == NULL)
+        return CKR_WRAPPED_KEY_INVALID;
+    if (mock_ep11_pkey_type(pkey) == CK_UNAVAILABLE_INFORMATION) {
+        /* Edwards and Montgomery curves are not supported by the mock */
+        EVP_PKEY_free(pkey);
+        return CKR_CURVE_NOT_SUPPORTED;
+    }
+
+    memset(&attrs, 0, sizeof(attrs));
+    attrs.key_type = mock_ep11_pkey_type(pkey);
+    attrs.attrs = MOCK_EP11_ATTRS_DEFAULT;
+    EVP_PKEY_free(pkey);
+
+    rc = mock_ep11_apply_template(&attrs, templ, count, 1);
+    if (rc != CKR_OK)
+        return rc;
+
+    return mock_ep11_spki_seal(spki, len, attrs.attrs, out, out_len);
+}
+
+/* Returns 0 if der is a PKCS#8 EC key on a curve unknown to OpenSSL */
+static int mock_ep11_p8_curve_supported(const unsigned char *der, size_t len)
+{
+    const ASN1_OBJECT *alg_oid, *curve;
+    PKCS8_PRIV_KEY_INFO *p8;
+    const X509_ALGOR *alg;
+    const void *param;
+    EC_GROUP *group;
+    int ptype, ret = 1;
+
+    p8 = d2i_PKCS8_PRIV_KEY_INFO(NULL, &der, len);
+    if (p8 == NULL)
+        return 1;
+
+    if (PKCS8_pkey_get0(NULL, NULL, NULL, &alg, p8) == 1) {
+        X509_ALGOR_get0(&alg_oid, &ptype, &param, alg);
+        if (OBJ_obj2nid(alg_oid) == NID_X9_62_id_ecPublicKey &&
+            ptype == V_ASN1_OBJECT) {
+            curve = param;
+            group = EC_GROUP_new_by_curve_name(OBJ_obj2nid(curve));
+            ret = group != NULL;
+            EC_GROUP_free(group);
+        }
+    }
+
+    PKCS8_PRIV_KEY_INFO_free(p8);
+
+    return ret;
+}
+
+/* Imports a PKCS#8 encoded private key, and returns its MACed SPKI in csum */
+static CK_RV mock_ep11_unwrap_pkey(const unsigned char *der, size_t len,
+                                   const CK_ATTRIBUTE *templ, CK_ULONG count,
+                                   const unsigned char *pin, size_t pinlen,
+                                   unsigned char *out, size_t *out_len,
+                                   unsigned char *csum, size_t *csum_len)
+{
+    struct mock_ep11_blob attrs;
+    const unsigned char *p = der;
+    EVP_PKEY *pkey;
+    CK_RV rc;
+
+    pkey = d2i_AutoPrivateKey(NULL, &p, len);
+    if (pkey == NULL)
+        return mock_ep11_p8_curve_supported(der, len) ?
+                                CKR_WRAPPED_KEY_INVALID :
+                                CKR_CURVE_NOT_SUPPORTED;
+
+    memset(&attrs, 0, sizeof(attrs));
+    attrs.key_type = mock_ep11_pkey_type(pkey);
+    attrs.attrs = MOCK_EP11_ATTRS_DEFAULT;
+    rc = mock_ep11_apply_template(&attrs, templ, count, 1);
+    if (rc != CKR_OK)
+        goto out;
+    if (mock_ep11_pkey_type(pkey) == CK_UNAVAILABLE_INFORMATION) {
+        /* Edwards and Montgomery curves are not supported by the mock */
+        rc = CKR_CURVE_NOT_SUPPORTED;
+        goto out;
+    }
+    if (attrs.key_type != mock_ep11_pkey_type(pkey)) {
+        rc = CKR_WRAPPED_KEY_INVALID;
+        goto out;
+    }
+
+    rc = mock_ep11_pkey_seal(pkey, attrs.attrs, pin, pinlen, out, out_len);
+    if (rc == CKR_OK && csum != NULL)
+        rc = mock_ep11_spki_seal_pkey(pkey, MOCK_EP11_ATTRS_DEFAULT,
+                                      csum, csum_len);
+
+out:
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
+CK_RV m_UnwrapKey(const CK_BYTE_PTR wrapped, CK_ULONG wlen,
+                  const unsigned char *kek, size_t keklen,
+                  const unsigned char *mackey, size_t mklen,
+                  const unsigned char *pin, size_t pinlen,
+                  const CK_MECHANISM_PTR uwmech,
+                  const CK_ATTRIBUTE_PTR ptempl, CK_ULONG pcount,
+                  unsigned char *unwrapped, size_t *uwlen,
+                  CK_BYTE_PTR csum, CK_ULONG *cslen, target_t target)
+{
+    struct mock_ep11_cipher_state st;
+    struct mock_ep11_blob blob;
+    const CK_ATTRIBUTE *class;
+    unsigned char value[MOCK_EP11_MAX_DER + AES_BLOCK_SIZE];
+    CK_ULONG len = sizeof(value);
+    size_t csum_len = *cslen;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_UnwrapKey, target);
+
+    UNUSED(mackey);
+    UNUSED(mklen);
+
+    /* Public keys are imported as MACed SPKI, without a checksum */
+    if (uwmech->mechanism == CKM_IBM_TRANSPORTKEY) {
+        *cslen = 0;
+        return mock_ep11_unwrap_spki(wrapped, wlen, ptempl, pcount,
+                                     unwrapped, uwlen);
+    }
+
+    /* Secret and private keys wrapped by encryption with an AES KEK */
+    rc = mock_ep11_cipher_init(&st, uwmech, kek, keklen, 0, CKA_UNWRAP);
+    if (rc != CKR_OK)
+        return rc;
+    if (wlen > sizeof(value))
+        return CKR_WRAPPED_KEY_LEN_RANGE;
+
+    rc = mock_ep11_cipher_single(&st, wrapped, wlen, value, &len);
+    if (rc != CKR_OK)
+        return rc == CKR_ENCRYPTED_DATA_LEN_RANGE ?
+                                    CKR_WRAPPED_KEY_LEN_RANGE : rc;
+
+    class = mock_ep11_find_attr(ptempl, pcount, CKA_CLASS);
+    if (class != NULL && class->ulValueLen == sizeof(CK_OBJECT_CLASS) &&
+        *(CK_OBJECT_CLASS *)class->pValue == CKO_PRIVATE_KEY) {
+        rc = mock_ep11_unwrap_pkey(value, len, ptempl, pcount, pin, pinlen,
+                                   unwrapped, uwlen, csum, &csum_len);
+        *cslen = csum_len;
+        goto out;
+    }
+
+    memset(&blob, 0, sizeof(blob));
+    blob.key_type = CKK_AES;
+    blob.value_len = len;
+    blob.attrs = MOCK_EP11_ATTRS_DEFAULT;
+    rc = mock_ep11_apply_template(&blob, ptempl, pcount, 1);
+    if (rc != CKR_OK)
+        goto out;
+
+    if (blob.value_len != len || len > MOCK_EP11_MAX_KEY ||
+        (blob.key_type == CKK_AES && len != 16 && len != 24 && len != 32)) {
+        rc = CKR_WRAPPED_KEY_INVALID;
+        goto out;
+    }
+
+    rc = mock_ep11_blob_seal(&blob, value, pin, pinlen, unwrapped, uwlen);
+    if (rc == CKR_OK)
+        rc = mock_ep11_csum(&blob, value, csum, &csum_len);
+    *cslen = csum_len;
+
+out:
+    OPENSSL_cleanse(value, sizeof(value));
+
+    return rc;
+}
+
+CK_RV m_GetAttributeValue(const unsigned char *obj, size_t olen,
+                          CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount,
+                          target_t target)
+{
+    struct mock_ep11_blob blob;
+    CK_OBJECT_CLASS class = CKO_SECRET_KEY;
+    CK_ULONG i, ulval;
+    CK_BBOOL bval;
+    const void *val;
+    size_t len;
+    uint32_t flag;
+    CK_RV rc, ret = CKR_OK;
+
+    MOCK_EP11_ENTER(m_GetAttributeValue, target);
+
+    if (mock_ep11_is_secret(obj, olen)) {
+        rc = mock_ep11_blob_open(obj, olen, &blob, NULL);
+    } else {
+        memset(&blob, 0, sizeof(blob));
+        rc = mock_ep11_pkey_open(obj, olen, &class, &ulval, &blob.attrs,
+                                 NULL);
+        blob.key_type = ulval;
+    }
+    if (rc != CKR_OK)
+        return rc;
+
+    for (i = 0; i < ulCount; i++) {
+        switch (pTemplate[i].type) {
+        case CKA_CLASS:
+            ulval = class;
+            val = &ulval;
+            len = sizeof(ulval);
+            break;
+        case CKA_KEY_TYPE:
+            ulval = blob.key_type;
+            val = &ulval;
+            len = sizeof(ulval);
+            break;
+        case CKA_VALUE_LEN:
+            if (class != CKO_SECRET_KEY) {
+                pTemplate[i].ulValueLen = CK_UNAVAILABLE_INFORMATION;
+                ret = CKR_ATTRIBUTE_TYPE_INVALID;
+                continue;
+            }
+            ulval = blob.value_len;
+            val = &ulval;
+            len = sizeof(ulval);
+            break;
+        case CKA_IBM_STD_COMPLIANCE1:
+            ulval = 0;
+            val = &ulval;
+            len = sizeof(ulval);
+            break;
+        case CKA_IBM_RESTRICTABLE:
+        case CKA_IBM_NEVER_MODIFIABLE:
+        case CKA_IBM_USE_AS_DATA:
+        case CKA_IBM_ATTRBOUND:
+        case CKA_IBM_PROTKEY_EXTRACTABLE:
+        case CKA_IBM_PROTKEY_NEVER_EXTRACTABLE:
+            /* The IBM specific attributes are all off */
+            bval = CK_FALSE;
+            val = &bval;
+            len = sizeof(bval);
+            break;
+        default:
+            flag = mock_ep11_attr_flag(pTemplate[i].type);
+            if (flag == 0) {
+                pTemplate[i].ulValueLen = CK_UNAVAILABLE_INFORMATION;
+                ret = CKR_ATTRIBUTE_TYPE_INVALID;
+                continue;
+            }
+            bval = (blob.attrs & flag) ? CK_TRUE : CK_FALSE;
+            val = &bval;
+            len = sizeof(bval);
+            break;
+        }
+
+        if (pTemplate[i].pValue != NULL) {
+            if (pTemplate[i].ulValueLen < len) {
+                pTemplate[i].ulValueLen = CK_UNAVAILABLE_INFORMATION;
+                ret = CKR_BUFFER_TOO_SMALL;
+                continue;
+            }
+            memcpy(pTemplate[i].pValue, val, len);
+        }
+        pTemplate[i].ulValueLen = len;
+    }
+
+    return ret;
+}
+
+CK_RV m_SetAttributeValue(unsigned char *obj, size_t olen,
+                          CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount,
+                          target_t target)
+{
+    struct mock_ep11_blob blob;
+    CK_KEY_TYPE key_type;
+    uint32_t sensitive, extractable, attrs;
+    int secret;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_SetAttributeValue, target);
+
+    secret = mock_ep11_is_secret(obj, olen);
+    if (secret) {
+        rc = mock_ep11_blob_open(obj, olen, &blob, NULL);
+    } else {
+        memset(&blob, 0, sizeof(blob));
+        rc = mock_ep11_pkey_open(obj, olen, NULL, &key_type, &blob.attrs,
+                                 NULL);
+        blob.key_type = key_type;
+    }
+    if (rc != CKR_OK)
+        return rc;
+
+    sensitive = mock_ep11_attr_flag(CKA_SENSITIVE);
+    extractable = mock_ep11_attr_flag(CKA_EXTRACTABLE);
+    attrs = blob.attrs;
+
+    rc = mock_ep11_apply_template(&blob, pTemplate, ulCount, 0);
+    if (rc != CKR_OK)
+        return rc;
+
+    /* Sensitive can only be turned on, extractable only off */
+    if ((attrs & sensitive & ~blob.attrs) ||
+        (blob.attrs & extractable & ~attrs))
+        return CKR_ATTRIBUTE_READ_ONLY;
+
+    if (!secret)
+        return mock_ep11_pkey_set_attrs(obj, olen, blob.attrs);
+
+    if (!mock_ep11_blob_mac(&blob, blob.mac))
+        return CKR_FUNCTION_FAILED;
+
+    memcpy(obj, &blob, sizeof(blob));
+
+    return CKR_OK;
+}
+
+static CK_RV mock_ep11_digest_state(const unsigned char *state, size_t slen,
+                                    struct mock_ep11_digest_state *st)
+{
+    if (state == NULL || slen < sizeof(*st))
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    memcpy(st, state, sizeof(*st));
+    if (memcmp(st->magic, MOCK_EP11_DIGEST_MAGIC, sizeof(st->magic)) != 0 ||
+        st->ctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    return CKR_OK;
+}
+
+/* Finalizes the digest, and frees the context unless only the length */
+static CK_RV mock_ep11_digest_final(struct mock_ep11_digest_state *st,
+                                    CK_BYTE_PTR digest, CK_ULONG_PTR dlen)
+{
+    CK_ULONG len = EVP_MD_CTX_size(st->ctx);
+
+    if (digest == NULL) {
+        *dlen = len;
+        return CKR_OK;
+    }
+    if (*dlen < len) {
+        *dlen = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    if (EVP_DigestFinal_ex(st->ctx, digest, NULL) != 1) {
+        EVP_MD_CTX_free(st->ctx);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    EVP_MD_CTX_free(st->ctx);
+    *dlen = len;
+
+    return CKR_OK;
+}
+
+CK_RV m_DigestInit(unsigned char *state, size_t *len,
+                   const CK_MECHANISM_PTR pmech, target_t target)
+{
+    struct mock_ep11_digest_state st;
+    const EVP_MD *md;
+
+    MOCK_EP11_ENTER(m_DigestInit, target);
+
+    md = mock_ep11_digest_md(pmech->mechanism);
+    if (md == NULL)
+        return CKR_MECHANISM_INVALID;
+
+    if (state == NULL) {
+        *len = sizeof(st);
+        return CKR_OK;
+    }
+    if (*len < sizeof(st)) {
+        *len = sizeof(st);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(st.magic, MOCK_EP11_DIGEST_MAGIC, sizeof(st.magic));
+    st.ctx = EVP_MD_CTX_new();
+    if (st.ctx == NULL)
+        return CKR_HOST_MEMORY;
+    if (EVP_DigestInit_ex(st.ctx, md, NULL) != 1) {
+        EVP_MD_CTX_free(st.ctx);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    memcpy(state, &st, sizeof(st));
+    *len = sizeof(st);
+
+    return CKR_OK;
+}
+
+CK_RV m_DigestUpdate(unsigned char *state, size_t slen,
+                     CK_BYTE_PTR data, CK_ULONG dlen, target_t target)
+{
+    struct mock_ep11_digest_state st;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_DigestUpdate, target);
+
+    rc = mock_ep11_digest_state(state, slen, &st);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (dlen > 0 && EVP_DigestUpdate(st.ctx, data, dlen) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    return CKR_OK;
+}
+
+CK_RV m_DigestFinal(const unsigned char *state, size_t slen,
+                    CK_BYTE_PTR digest, CK_ULONG_PTR dlen, target_t target)
+{
+    struct mock_ep11_digest_state st;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_DigestFinal, target);
+
+    rc = mock_ep11_digest_state(state, slen, &st);
+    if (rc != CKR_OK)
+        return rc;
+
+    return mock_ep11_digest_final(&st, digest, dlen);
+}
+
+CK_RV m_Digest(const unsigned char *state, size_t slen,
+               CK_BYTE_PTR data, CK_ULONG len,
+               CK_BYTE_PTR digest, CK_ULONG_PTR dglen, target_t target)
+{
+    struct mock_ep11_digest_state st;
+    CK_RV rc;
+
+    MOCK_EP11_ENTER(m_Digest, target);
+
+    rc = mock_ep11_digest_state(state, slen, &st);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (digest == NULL)
+        return mock_ep11_digest_final(&st, NULL, dglen);
+
+    if (len > 0 && EVP_DigestUpdate(st.ctx, data, len) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    return mock_ep11_digest_final(&st, digest, dglen);
+}
+
+CK_RV m_DigestSingle(CK_MECHANISM_PTR pmech,
+                     CK_BYTE_PTR data, CK_ULONG len,
+                     CK_BYTE_PTR digest, CK_ULONG_PTR dlen, target_t target)
+{
+    const EVP_MD *md;
+
+    MOCK_EP11_ENTER(m_DigestSingle, target);
+
+    md = mock_ep11_digest_md(pmech->mechanism);
+    if (md == NULL)
+        return CKR_MECHANISM_INVALID;
+
+    if (digest == NULL) {
+        *dlen = EVP_MD_size(md);
+        return CKR_OK;
+    }
+    if (*dlen < (CK_ULONG)EVP_MD_size(md)) {
+        *dlen = EVP_MD_size(md);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    if (EVP_Digest(data, len, digest, NULL, md, NULL) != 1)
+        return CKR_FUNCTION_FAILED;
+    *dlen = EVP_MD_size(md);
+
+    return CKR_OK;
+}
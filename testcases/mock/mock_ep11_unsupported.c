@@ -0,0 +1,38 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  mock_ep11_unsupported.c
+//
+// EP11 functions that the mock host library does not implement. The EP11
+// token resolves all of them when it is loaded, so they must be exported.
+// They fail with CKR_FUNCTION_NOT_SUPPORTED.
+//
+// The stubs do not access any of their parameters. Therefore, ep11.h is not
+// included here, and the stubs are not defined with the full prototypes of
+// the functions.
+//
+#include "mock_common.h"
+
+#define MOCK_EP11_RV_UNSUPPORTED    0x00000054UL    /* FUNCTION_NOT_SUPPORTED */
+
+#define MOCK_EP11_UNSUPPORTED(fn)                                        \
+    unsigned long fn(void);                                              \
+    unsigned long fn(void)                                               \
+    {                                                                    \
+        static struct mock_fn mock_fn = MOCK_FN_INIT(fn);                \
+                                                                         \
+        if (mock_enter(&mock_fn))                                        \
+            return mock_fail_code(MOCK_EP11_RV_UNSUPPORTED);             \
+        return MOCK_EP11_RV_UNSUPPORTED;                                 \
+    }
+
+MOCK_EP11_UNSUPPORTED(m_DigestKey)
+MOCK_EP11_UNSUPPORTED(m_ReencryptSingle)
+MOCK_EP11_UNSUPPORTED(m_DeriveKey)
@@ -0,0 +1,303 @@
+#!/bin/bash
+#
+# COPYRIGHT (c) International Business Machines Corp. 2026
+#
+# This program is provided under the terms of the Common Public License,
+# version 1.0 (CPL-1.0). Any use, reproduction or distribution for this software
+# constitutes recipient's acceptance of CPL-1.0 terms which can be found
+# in the file LICENSE file or at https://opensource.org/licenses/cpl1.0.php
+#
+#
+# NAME
+#	mock_tests.sh
+#
+# DESCRIPTION
+#	Runs the AES, digest and RSA tests, the batch and async tests and the
+#	throughput benchmark against a CCA or EP11 token, with the mock host
+#	library from testcases/mock instead of the real one. The EC tests only
+#	run against an EP11 token, the CCA mock has no EC support. The mock
+#	library is only used by the test processes. The token must be
+#	configured and initialized as usual.
+#
+#	For a CCA token, the benchmark also encrypts with 1, 4 and 16 threads
+#	while every CSNBSAE call of the mock library takes CCA_LATENCY usec,
+#	with CSU_DEFAULT_DOMAIN=DOM-ANY. The CCA verbs of the threads must
+#	overlap, so 16 threads must get at least 4 times the throughput of one
+#	thread. If statistics are enabled, pkcsstats must report the CCA verbs
+#	in the device counters of the slot.
+#
+#	The mock libraries only implement a subset of the functions, so the
+#	tests of other mechanisms report errors. Only test failures count,
+#	except for the ones listed in EXPECTED_FAILURES.
+#
+#	With -hostslot, the verify and encrypt results of an EP11 token with
+#	HOST_PUBLIC_KEY_OPERATIONS are compared with the ones of the EP11
+#	token in -slot, and the host slot is run again with all mock verify
+#	and encrypt calls failing, to check that they are not used.
+#
+#	With -lbslot, the batch and async tests run against an EP11 token with
+#	APQN_LOAD_BALANCING and several APQNs, of which the APQN given with
+#	-failapqn fails all requests. All tests must run and pass, the failing
+#	APQN must get less than 5% of the calls, and each of the other APQNs
+#	must serve more calls than the failing APQN. If statistics are
+#	enabled, pkcsstats must report errors and an ejection for the failing
+#	APQN.
+#
+#	Latency and error injection of the mock library are controlled with
+#	the OCK_MOCK_* environment variables, see testcases/mock/mock_common.h.
+#
+# USAGE
+#	mock_tests.sh -slot <num> [-nobench] [-hostslot <num>]
+#		[-lbslot <num> -failapqn <card.domain>]
+#
+#	MOCKLIBDIR: directory of the mock libraries (testcases/mock/.libs)
+#	PKCSCONF:   pkcsconf binary used to detect the token type (pkcsconf)
+#	PKCSSTATS:  pkcsstats binary used to check the device statistics (pkcsstats)
+#	CCA_LATENCY: latency of the mock CSNBSAE calls of the CCA benchmark (200)
+##
+
+TESTDIR=$(cd "$(dirname "$0")/.." && pwd)
+MOCKLIBDIR=${MOCKLIBDIR:-$TESTDIR/mock/.libs}
+PKCSCONF=${PKCSCONF:-pkcsconf}
+PKCSSTATS=${PKCSSTATS:-pkcsstats}
+CCA_LATENCY=${CCA_LATENCY:-200}
+TESTS="crypto/aes_tests crypto/digest_tests crypto/rsa_tests misc_tests/batch"
+# Generic secret (HMAC) keys are not supported by the mock libraries
+EXPECTED_FAILURES="TESTCASE generate_SecretKey FAIL"
+SLOT=""
+TOKTYPE=""
+BENCH=1
+HOSTSLOT=""
+LBSLOT=""
+FAILAPQN=""
+RC=0
+
+usage() {
+	echo "usage: $0 -slot <num> [-nobench] [-hostslot <num>]"
+	echo "       [-lbslot <num> -failapqn <card.domain>]"
+	exit 1
+}
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-slot)
+		SLOT="$2"
+		shift
+		;;
+	-nobench)
+		BENCH=0
+		;;
+	-hostslot)
+		HOSTSLOT="$2"
+		shift
+		;;
+	-lbslot)
+		LBSLOT="$2"
+		shift
+		;;
+	-failapqn)
+		FAILAPQN="$2"
+		shift
+		;;
+	*)
+		usage
+		;;
+	esac
+	shift
+done
+
+if [ -z "$SLOT" ] || [ -n "$LBSLOT" -a -z "$FAILAPQN" ]; then
+	usage
+fi
+
+if [ ! -e "$MOCKLIBDIR/libcsulcca.so" ] || [ ! -e "$MOCKLIBDIR/libep11.so" ]; then
+	echo "Mock libraries not found in $MOCKLIBDIR"
+	exit 1
+fi
+
+export LD_LIBRARY_PATH="$MOCKLIBDIR${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH}"
+export OCK_EP11_LIBRARY="$MOCKLIBDIR/libep11.so"
+
+case $($PKCSCONF -c "$SLOT" -t 2>/dev/null | grep "Model:") in
+*EP11*)
+	TESTS="$TESTS crypto/ec_tests"
+	TOKTYPE=EP11
+	;;
+*CCA*)
+	TOKTYPE=CCA
+	;;
+*)
+	echo "Slot $SLOT is not a CCA or EP11 token"
+	exit 1
+	;;
+esac
+
+# RUN_SLOT overrides the slot of a single test run
+run_test() {
+	local log failures slot=${RUN_SLOT:-$SLOT}
+
+	log=$(mktemp) || return 1
+	echo "** Running $* against slot $slot"
+	"$TESTDIR/$@" -slot "$slot" > "$log" 2>&1
+	if [ $? -gt 1 ]; then
+		cat "$log"
+		echo "** $1 terminated abnormally"
+		rm -f "$log"
+		return 1
+	fi
+
+	failures=$(grep " FAIL " "$log" | grep -v "$EXPECTED_FAILURES")
+	grep "^Total=" "$log"
+	grep " operations with .* threads: " "$log"
+	grep "^mock: APQN" "$log"
+	rm -f "$log"
+	if [ -n "$failures" ]; then
+		echo "$failures"
+		echo "** $1 failed"
+		return 1
+	fi
+
+	return 0
+}
+
+for t in $TESTS; do
+	run_test $t -nostop || RC=1
+done
+
+if [ $BENCH -eq 1 ]; then
+	run_test misc_tests/speed -aes -sha || RC=1
+fi
+
+# Checks that 16 threads get at least 4 times the throughput of one thread
+check_thread_scaling() {
+	echo "$1" | awk '
+		$2 == "operations" && $3 == "with" {
+			split($7, f, "=")
+			ops[$4] = f[2]
+		}
+		END {
+			if (ops[1] == "" || ops[16] == "") {
+				print "** No throughput with 1 and 16 threads"
+				exit 1
+			}
+			if (ops[16] < ops[1] * 4) {
+				print "** 16 threads: " ops[16] " ops/s, 1 thread: " \
+				      ops[1] " ops/s"
+				exit 1
+			}
+		}'
+}
+
+# Checks that pkcsstats reports the CCA verbs of the slot without errors
+check_cca_pkcsstats() {
+	$PKCSSTATS -s "$SLOT" | awk '
+		$2 == "|" && $1 ~ /\./ {
+			requests += $3
+			errors += $4
+		}
+		END {
+			if (requests == 0 || errors != 0) {
+				print "** pkcsstats reports " requests \
+				      " CCA requests and " errors " errors"
+				exit 1
+			}
+		}'
+}
+
+if [ $BENCH -eq 1 ] && [ "$TOKTYPE" = "CCA" ]; then
+	stats=1
+	if ! $PKCSSTATS -r -s "$SLOT" > /dev/null 2>&1; then
+		echo "** Statistics are not available, not checking pkcsstats"
+		stats=0
+	fi
+	out=$(CSU_DEFAULT_DOMAIN=DOM-ANY OCK_MOCK_LATENCY_CSNBSAE="$CCA_LATENCY" \
+	      run_test misc_tests/speed -sharedkey) || RC=1
+	echo "$out"
+	check_thread_scaling "$out" || RC=1
+	if [ $stats -eq 1 ]; then
+		check_cca_pkcsstats || RC=1
+	fi
+fi
+
+if [ -n "$HOSTSLOT" ]; then
+	run_test misc_tests/host_pubkey_ops -hostslot "$HOSTSLOT" || RC=1
+	OCK_MOCK_FAIL_EVERY_m_VerifyInit=1 OCK_MOCK_FAIL_EVERY_m_VerifySingle=1 \
+	OCK_MOCK_FAIL_EVERY_m_EncryptInit=1 OCK_MOCK_FAIL_EVERY_m_EncryptSingle=1 \
+	RUN_SLOT="$HOSTSLOT" \
+		run_test misc_tests/host_pubkey_ops -hostslot "$HOSTSLOT" || RC=1
+fi
+
+# Checks the APQN call counts printed by the mock EP11 library
+check_apqn_stats() {
+	echo "$1" | awk -v fail="$(echo "$FAILAPQN" | tr A-F a-f)" '
+		$1 == "mock:" && $2 == "APQN" {
+			if ($3 == fail)
+				failed = $5
+			else
+				calls[$3] = $5
+			total += $5
+		}
+		END {
+			if (failed == "") {
+				print "** APQN " fail " was not used"
+				exit 1
+			}
+			if (failed * 20 >= total) {
+				print "** APQN " fail " got " failed " of " total \
+				      " calls"
+				exit 1
+			}
+			for (apqn in calls) {
+				if (calls[apqn] <= failed) {
+					print "** APQN " apqn " served " calls[apqn] \
+					      " calls, the failing APQN " failed
+					exit 1
+				}
+				n++
+			}
+			if (n < 2) {
+				print "** Less than 2 other APQNs served calls"
+				exit 1
+			}
+		}'
+}
+
+# Checks the device counters of the failing APQN reported by pkcsstats
+check_pkcsstats() {
+	$PKCSSTATS -s "$LBSLOT" | awk -v fail="$(echo "$FAILAPQN" | tr a-f A-F)" '
+		$1 == fail && $2 == "|" {
+			found = 1
+			if ($4 == 0 || $6 == 0) {
+				print "** pkcsstats reports " $4 " errors and " \
+				      $6 " ejections for APQN " fail
+				exit 1
+			}
+		}
+		END {
+			if (!found) {
+				print "** pkcsstats does not report APQN " fail
+				exit 1
+			}
+		}'
+}
+
+if [ -n "$LBSLOT" ]; then
+	stats=1
+	if ! $PKCSSTATS -r -s "$LBSLOT" > /dev/null 2>&1; then
+		echo "** Statistics are not available, not checking pkcsstats"
+		stats=0
+	fi
+	out=$(OCK_MOCK_STATS=1 OCK_MOCK_EP11_FAIL_APQN="$FAILAPQN" \
+	      RUN_SLOT="$LBSLOT" run_test misc_tests/batch) || RC=1
+	echo "$out"
+	if ! echo "$out" | grep -q "Skipped=0, Errors=0"; then
+		echo "** misc_tests/batch did not run all tests"
+		RC=1
+	fi
+	check_apqn_stats "$out" || RC=1
+	if [ $stats -eq 1 ]; then
+		check_pkcsstats || RC=1
+	fi
+fi
+
+exit $RC
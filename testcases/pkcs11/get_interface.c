@@ -110,6 +110,59 @@ static int get_interface_test(void)
     printf("pFunctionList version  %u.%u\n", v->major, v->minor);
     printf("flags                  0x%016lx\n", interface->flags);
 
+    version.major = 1;
+    version.minor = 0;
+    flags = 0ULL;
+    rv = funcs3->C_GetInterface((CK_UTF8CHAR *)"Vendor IBM",
+                                &version, &interface, flags);
+    if (rv != CKR_OK) {
+        testcase_fail("C_GetInterface returned %s.\n", p11_get_ckr(rv));
+        goto ret;
+    }
+    v = (CK_VERSION *)interface->pFunctionList;
+    if (v->major != version.major || v->minor != version.minor) {
+        testcase_fail("Returned version: %u.%u.\n", v->major, v->minor);
+        goto ret;
+    }
+
+    version.major = 1;
+    version.minor = 1;
+    flags = 0ULL;
+    rv = funcs3->C_GetInterface((CK_UTF8CHAR *)"Vendor IBM",
+                                &version, &interface, flags);
+    if (rv != CKR_OK) {
+        testcase_fail("C_GetInterface returned %s.\n", p11_get_ckr(rv));
+        goto ret;
+    }
+    v = (CK_VERSION *)interface->pFunctionList;
+    if (v->major != version.major || v->minor != version.minor) {
+        testcase_fail("Returned version: %u.%u.\n", v->major, v->minor);
+        goto ret;
+    }
+    printf("%s\n", "Vendor defined interface (IBM) version 1.1:");
+    printf("pInterfaceName         %s\n", interface->pInterfaceName);
+    printf("pFunctionList version  %u.%u\n", v->major, v->minor);
+    printf("flags                  0x%016lx\n", interface->flags);
+
+    version.major = 1;
+    version.minor = 2;
+    flags = 0ULL;
+    rv = funcs3->C_GetInterface((CK_UTF8CHAR *)"Vendor IBM",
+                                &version, &interface, flags);
+    if (rv != CKR_OK) {
+        testcase_fail("C_GetInterface returned %s.\n", p11_get_ckr(rv));
+        goto ret;
+    }
+    v = (CK_VERSION *)interface->pFunctionList;
+    if (v->major != version.major || v->minor != version.minor) {
+        testcase_fail("Returned version: %u.%u.\n", v->major, v->minor);
+        goto ret;
+    }
+    printf("%s\n", "Vendor defined interface (IBM) version 1.2:");
+    printf("pInterfaceName         %s\n", interface->pInterfaceName);
+    printf("pFunctionList version  %u.%u\n", v->major, v->minor);
+    printf("flags                  0x%016lx\n", interface->flags);
+
     version.major = 2;
     version.minor = 40;
     flags = 0ULL;
@@ -285,6 +285,29 @@ extern "C" {
                                 CK_OBJECT_HANDLE, CK_MECHANISM_PTR,
                                 CK_OBJECT_HANDLE, CK_BYTE_PTR,
                                 CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+
+    CK_RV C_IBM_SignBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                          CK_OBJECT_HANDLE, CK_IBM_BATCH_ITEM_PTR, CK_ULONG);
+
+    CK_RV C_IBM_VerifyBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                            CK_OBJECT_HANDLE, CK_IBM_BATCH_ITEM_PTR, CK_ULONG);
+
+    CK_RV C_IBM_EncryptBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                             CK_OBJECT_HANDLE, CK_IBM_BATCH_ITEM_PTR,
+                             CK_ULONG);
+
+    CK_RV C_IBM_CreateQueue(CK_IBM_QUEUE_HANDLE_PTR);
+
+    CK_RV C_IBM_DestroyQueue(CK_IBM_QUEUE_HANDLE);
+
+    CK_RV C_IBM_AsyncSubmit(CK_SESSION_HANDLE, CK_IBM_QUEUE_HANDLE,
+                            CK_IBM_ASYNC_REQUEST_PTR);
+
+    CK_RV C_IBM_AsyncPoll(CK_IBM_QUEUE_HANDLE, CK_IBM_ASYNC_REQUEST_PTR_PTR,
+                          CK_ULONG, CK_ULONG_PTR);
+
+    CK_RV C_IBM_AsyncWait(CK_IBM_QUEUE_HANDLE, CK_IBM_ASYNC_REQUEST_PTR_PTR,
+                          CK_ULONG, CK_ULONG_PTR, CK_ULONG);
 #ifdef __cplusplus
 }
 #endif
@@ -69,6 +69,24 @@ struct API_Slot {
 };
 
 
+/*
+ * Completion queue of C_IBM_AsyncSubmit requests. Completed requests are kept
+ * in a ring buffer until they are returned by C_IBM_AsyncPoll or
+ * C_IBM_AsyncWait. The ring has room for all requests in flight, so that a
+ * completion never needs to allocate memory.
+ */
+typedef struct {
+    struct bt_ref_hdr hdr;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    CK_IBM_ASYNC_REQUEST_PTR *completed;
+    CK_ULONG head;              // index of the oldest completed request
+    CK_ULONG num_completed;
+    CK_ULONG size;              // number of entries in 'completed'
+    CK_ULONG in_flight;
+    CK_BBOOL destroyed;
+} API_Async_Queue_t;
+
 // Per process API structure.
 // Allocate one per process on the C_Initialize.  This will be
 // a global type for the API and will be used through out.
@@ -77,6 +95,7 @@ typedef struct {
     key_t shm_tok;
 
     struct btree sess_btree;
+    struct btree async_queue_btree;
     void *SharedMemP;
     Slot_Mgr_Socket_t SocketDataP;
     Slot_Mgr_Client_Cred_t ClientCred;
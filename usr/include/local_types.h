@@ -22,13 +22,22 @@ typedef unsigned int uint32;
 // typedef int            int32;
 
 
+struct btree;
+
 /* Each node value must start with struct bt_ref_hdr */
 struct bt_ref_hdr {
     volatile unsigned long ref;
+    /* epoch based reclamation, see btree.c */
+    struct bt_ref_hdr *retired_next;
+    struct btree *retired_tree;
+    unsigned long retired_epoch;
 };
 
 #define BT_FLAG_FREE 1
 
+/* btree flags */
+#define BT_EPOCH     1
+
 /* Binary tree node
  * - 20 bytes on 32bit platform
  * - 40 bytes on 64bit platform
@@ -38,7 +47,8 @@ struct btnode {
     struct btnode *right;
     struct btnode *parent;
     unsigned long flags;
-    void *value;
+    void *value;                /* NULL while the node is free */
+    struct btnode *free_next;   /* next node in the free list */
 };
 
 /* Binary tree root */
@@ -49,6 +59,7 @@ struct btree {
     unsigned long free_nodes;
     pthread_mutex_t mutex;
     void (*delete_func)(void *);
+    unsigned long flags;
 };
 
 typedef struct _STDLL_TokData_t STDLL_TokData_t;
@@ -68,5 +79,6 @@ void *bt_node_free(struct btree *t, unsigned long node_num,
                    int call_delete_func);
 void bt_destroy(struct btree *t);
 CK_RV bt_init(struct btree *t, void (*delete_func)(void *));
+CK_RV bt_init_epoch(struct btree *t, void (*delete_func)(void *));
 
 #endif
@@ -589,6 +589,8 @@ typedef CK_ULONG CK_ATTRIBUTE_TYPE;
 #define CKA_IBM_OPAQUE         CKA_VENDOR_DEFINED + 1
 #define CKA_IBM_OPAQUE_REENC   CKA_VENDOR_DEFINED + 3
 #define CKA_IBM_OPAQUE_OLD     CKA_VENDOR_DEFINED + 4
+/* ID of the HSM MK change operation that created CKA_IBM_OPAQUE_REENC */
+#define CKA_IBM_OPAQUE_REENC_OP CKA_VENDOR_DEFINED + 5
 
 #define CKA_IBM_RESTRICTABLE      (CKA_VENDOR_DEFINED +0x10001)
 #define CKA_IBM_NEVER_MODIFIABLE  (CKA_VENDOR_DEFINED +0x10002)
@@ -1758,6 +1760,60 @@ typedef struct CK_IBM_FUNCTION_LIST_1_0 CK_IBM_FUNCTION_LIST_1_0;
 typedef struct CK_IBM_FUNCTION_LIST_1_0 CK_PTR CK_IBM_FUNCTION_LIST_1_0_PTR;
 typedef CK_IBM_FUNCTION_LIST_1_0_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_0_PTR_PTR;
 
+typedef struct CK_IBM_FUNCTION_LIST_1_1 CK_IBM_FUNCTION_LIST_1_1;
+typedef struct CK_IBM_FUNCTION_LIST_1_1 CK_PTR CK_IBM_FUNCTION_LIST_1_1_PTR;
+typedef CK_IBM_FUNCTION_LIST_1_1_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_1_PTR_PTR;
+
+/*
+ * One element of a C_IBM_SignBatch, C_IBM_VerifyBatch or C_IBM_EncryptBatch
+ * request. pData/ulDataLen is the input data of the element. pResult and
+ * ulResultLen receive the signature or the encrypted data (if pResult is
+ * NULL, only the length is returned). For C_IBM_VerifyBatch they specify the
+ * signature to verify. rv receives the result of the individual operation.
+ */
+typedef struct CK_IBM_BATCH_ITEM {
+    CK_BYTE_PTR pData;
+    CK_ULONG ulDataLen;
+    CK_BYTE_PTR pResult;
+    CK_ULONG ulResultLen;
+    CK_RV rv;
+} CK_IBM_BATCH_ITEM;
+
+typedef CK_IBM_BATCH_ITEM CK_PTR CK_IBM_BATCH_ITEM_PTR;
+
+typedef struct CK_IBM_FUNCTION_LIST_1_2 CK_IBM_FUNCTION_LIST_1_2;
+typedef struct CK_IBM_FUNCTION_LIST_1_2 CK_PTR CK_IBM_FUNCTION_LIST_1_2_PTR;
+typedef CK_IBM_FUNCTION_LIST_1_2_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_2_PTR_PTR;
+
+typedef CK_ULONG CK_IBM_QUEUE_HANDLE;
+typedef CK_IBM_QUEUE_HANDLE CK_PTR CK_IBM_QUEUE_HANDLE_PTR;
+
+typedef CK_ULONG CK_IBM_ASYNC_OPERATION;
+
+#define CK_IBM_ASYNC_SIGN           1UL
+#define CK_IBM_ASYNC_VERIFY         2UL
+#define CK_IBM_ASYNC_ENCRYPT        3UL
+
+/*
+ * A request submitted with C_IBM_AsyncSubmit. The elements are processed like
+ * with C_IBM_SignBatch, C_IBM_VerifyBatch or C_IBM_EncryptBatch, depending
+ * on the operation. The request, the mechanism and the elements must stay
+ * valid until the request is returned by C_IBM_AsyncPoll or C_IBM_AsyncWait.
+ * rv receives the result of the request.
+ */
+typedef struct CK_IBM_ASYNC_REQUEST {
+    CK_IBM_ASYNC_OPERATION operation;
+    CK_MECHANISM_PTR pMechanism;
+    CK_OBJECT_HANDLE hKey;
+    CK_IBM_BATCH_ITEM_PTR pItems;
+    CK_ULONG ulCount;
+    CK_VOID_PTR pUserData;
+    CK_RV rv;
+} CK_IBM_ASYNC_REQUEST;
+
+typedef CK_IBM_ASYNC_REQUEST CK_PTR CK_IBM_ASYNC_REQUEST_PTR;
+typedef CK_IBM_ASYNC_REQUEST_PTR CK_PTR CK_IBM_ASYNC_REQUEST_PTR_PTR;
+
 typedef CK_RV (CK_PTR CK_C_Initialize) (CK_VOID_PTR pReserved);
 typedef CK_RV (CK_PTR CK_C_Finalize) (CK_VOID_PTR pReserved);
 typedef CK_RV (CK_PTR CK_C_Terminate) (void);
@@ -2121,6 +2177,37 @@ typedef CK_RV (CK_PTR CK_C_IBM_ReencryptSingle) (CK_SESSION_HANDLE hSession,
                                                  CK_ULONG ulEncryptedDataLen,
                                                  CK_BYTE_PTR pReencryptedData,
                                                  CK_ULONG_PTR pulReencryptedDataLen);
+typedef CK_RV (CK_PTR CK_C_IBM_SignBatch) (CK_SESSION_HANDLE hSession,
+                                           CK_MECHANISM_PTR pMechanism,
+                                           CK_OBJECT_HANDLE hKey,
+                                           CK_IBM_BATCH_ITEM_PTR pItems,
+                                           CK_ULONG ulCount);
+typedef CK_RV (CK_PTR CK_C_IBM_VerifyBatch) (CK_SESSION_HANDLE hSession,
+                                             CK_MECHANISM_PTR pMechanism,
+                                             CK_OBJECT_HANDLE hKey,
+                                             CK_IBM_BATCH_ITEM_PTR pItems,
+                                             CK_ULONG ulCount);
+typedef CK_RV (CK_PTR CK_C_IBM_EncryptBatch) (CK_SESSION_HANDLE hSession,
+                                              CK_MECHANISM_PTR pMechanism,
+                                              CK_OBJECT_HANDLE hKey,
+                                              CK_IBM_BATCH_ITEM_PTR pItems,
+                                              CK_ULONG ulCount);
+typedef CK_RV (CK_PTR CK_C_IBM_CreateQueue) (CK_IBM_QUEUE_HANDLE_PTR phQueue);
+typedef CK_RV (CK_PTR CK_C_IBM_DestroyQueue) (CK_IBM_QUEUE_HANDLE hQueue);
+typedef CK_RV (CK_PTR CK_C_IBM_AsyncSubmit) (CK_SESSION_HANDLE hSession,
+                                             CK_IBM_QUEUE_HANDLE hQueue,
+                                             CK_IBM_ASYNC_REQUEST_PTR pRequest);
+typedef CK_RV (CK_PTR CK_C_IBM_AsyncPoll) (CK_IBM_QUEUE_HANDLE hQueue,
+                                           CK_IBM_ASYNC_REQUEST_PTR_PTR
+                                                                ppRequests,
+                                           CK_ULONG ulMaxCount,
+                                           CK_ULONG_PTR pulCount);
+typedef CK_RV (CK_PTR CK_C_IBM_AsyncWait) (CK_IBM_QUEUE_HANDLE hQueue,
+                                           CK_IBM_ASYNC_REQUEST_PTR_PTR
+                                                                ppRequests,
+                                           CK_ULONG ulMaxCount,
+                                           CK_ULONG_PTR pulCount,
+                                           CK_ULONG ulTimeout);
 
 struct CK_FUNCTION_LIST {
     CK_VERSION version;
@@ -2296,6 +2383,27 @@ struct CK_IBM_FUNCTION_LIST_1_0 {
     CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
 };
 
+struct CK_IBM_FUNCTION_LIST_1_1 {
+    CK_VERSION version;
+    CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
+    CK_C_IBM_SignBatch C_IBM_SignBatch;
+    CK_C_IBM_VerifyBatch C_IBM_VerifyBatch;
+    CK_C_IBM_EncryptBatch C_IBM_EncryptBatch;
+};
+
+struct CK_IBM_FUNCTION_LIST_1_2 {
+    CK_VERSION version;
+    CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
+    CK_C_IBM_SignBatch C_IBM_SignBatch;
+    CK_C_IBM_VerifyBatch C_IBM_VerifyBatch;
+    CK_C_IBM_EncryptBatch C_IBM_EncryptBatch;
+    CK_C_IBM_CreateQueue C_IBM_CreateQueue;
+    CK_C_IBM_DestroyQueue C_IBM_DestroyQueue;
+    CK_C_IBM_AsyncSubmit C_IBM_AsyncSubmit;
+    CK_C_IBM_AsyncPoll C_IBM_AsyncPoll;
+    CK_C_IBM_AsyncWait C_IBM_AsyncWait;
+};
+
 #ifdef __cplusplus
 }
 #endif
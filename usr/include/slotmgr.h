@@ -230,6 +230,8 @@ typedef struct {
     LW_SHM_TYPE *shm_addr;      // token specific shm address
     uint32_t version; // version: major<<16|minor
     char usergroup[LOGIN_NAME_MAX]; // group of users having access to the token
+    uint32_t objcache;          // size of the shared object cache in MB
+    uint32_t logincache;        // lifetime of cached login keys in seconds
 } Slot_Info_t_64;
 
 typedef Slot_Info_t_64 SLOT_INFO;
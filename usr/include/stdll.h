@@ -353,6 +353,37 @@ typedef CK_RV (CK_PTR ST_C_IBM_ReencryptSingle)(STDLL_TokData_t *tokdata,
                                                 CK_ULONG ulEncryptedDataLen,
                                                 CK_BYTE_PTR pReencryptedData,
                                             CK_ULONG_PTR pulReencryptedDataLen);
+typedef CK_RV (CK_PTR ST_C_IBM_SignBatch)(STDLL_TokData_t *tokdata,
+                                          ST_SESSION_T *hSession,
+                                          CK_MECHANISM_PTR pMechanism,
+                                          CK_OBJECT_HANDLE hKey,
+                                          CK_IBM_BATCH_ITEM_PTR pItems,
+                                          CK_ULONG ulCount);
+typedef CK_RV (CK_PTR ST_C_IBM_VerifyBatch)(STDLL_TokData_t *tokdata,
+                                            ST_SESSION_T *hSession,
+                                            CK_MECHANISM_PTR pMechanism,
+                                            CK_OBJECT_HANDLE hKey,
+                                            CK_IBM_BATCH_ITEM_PTR pItems,
+                                            CK_ULONG ulCount);
+typedef CK_RV (CK_PTR ST_C_IBM_EncryptBatch)(STDLL_TokData_t *tokdata,
+                                             ST_SESSION_T *hSession,
+                                             CK_MECHANISM_PTR pMechanism,
+                                             CK_OBJECT_HANDLE hKey,
+                                             CK_IBM_BATCH_ITEM_PTR pItems,
+                                             CK_ULONG ulCount);
+
+/*
+ * Called by the token exactly once for every request it accepted with
+ * ST_IBM_AsyncSubmit, after pRequest->rv has been set. This may happen from
+ * another thread, or before ST_IBM_AsyncSubmit returns.
+ */
+typedef void (*ST_AsyncCompletion_t)(CK_IBM_ASYNC_REQUEST_PTR pRequest,
+                                     void *pContext);
+typedef CK_RV (CK_PTR ST_C_IBM_AsyncSubmit)(STDLL_TokData_t *tokdata,
+                                            ST_SESSION_T *hSession,
+                                            CK_IBM_ASYNC_REQUEST_PTR pRequest,
+                                            ST_AsyncCompletion_t completion,
+                                            void *pContext);
 
 typedef CK_RV (CK_PTR ST_C_HandleEvent)(STDLL_TokData_t *tokdata,
                                         unsigned int event_type,
@@ -434,6 +465,10 @@ struct ST_FCN_LIST {
     ST_C_SessionCancel ST_SessionCancel;
 
     ST_C_IBM_ReencryptSingle ST_IBM_ReencryptSingle;
+    ST_C_IBM_SignBatch ST_IBM_SignBatch;
+    ST_C_IBM_VerifyBatch ST_IBM_VerifyBatch;
+    ST_C_IBM_EncryptBatch ST_IBM_EncryptBatch;
+    ST_C_IBM_AsyncSubmit ST_IBM_AsyncSubmit;
 
     /* The functions defined below are not part of the external API */
     ST_C_HandleEvent ST_HandleEvent;
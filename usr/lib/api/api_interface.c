@@ -110,6 +110,27 @@ static CK_IBM_FUNCTION_LIST_1_0 func_list_ibm_1_0 = {
     C_IBM_ReencryptSingle
 };
 
+static CK_IBM_FUNCTION_LIST_1_1 func_list_ibm_1_1 = {
+    {1, 1},
+    C_IBM_ReencryptSingle,
+    C_IBM_SignBatch,
+    C_IBM_VerifyBatch,
+    C_IBM_EncryptBatch
+};
+
+static CK_IBM_FUNCTION_LIST_1_2 func_list_ibm_1_2 = {
+    {1, 2},
+    C_IBM_ReencryptSingle,
+    C_IBM_SignBatch,
+    C_IBM_VerifyBatch,
+    C_IBM_EncryptBatch,
+    C_IBM_CreateQueue,
+    C_IBM_DestroyQueue,
+    C_IBM_AsyncSubmit,
+    C_IBM_AsyncPoll,
+    C_IBM_AsyncWait
+};
+
 static CK_FUNCTION_LIST func_list_pkcs11_2_40 = {
     {2, 40},
     C_Initialize,
@@ -300,6 +321,16 @@ static CK_INTERFACE interface_list[] = {
         &func_list_pkcs11_2_40,
         CKF_INTERFACE_FORK_SAFE /*XXX*/
     },
+    {
+        (CK_UTF8CHAR *)"Vendor IBM",
+        &func_list_ibm_1_2,
+        CKF_INTERFACE_FORK_SAFE /*XXX*/
+    },
+    {
+        (CK_UTF8CHAR *)"Vendor IBM",
+        &func_list_ibm_1_1,
+        CKF_INTERFACE_FORK_SAFE /*XXX*/
+    },
     {
         (CK_UTF8CHAR *)"Vendor IBM",
         &func_list_ibm_1_0,
@@ -1711,6 +1742,7 @@ CK_RV C_Finalize(CK_VOID_PTR pReserved)
     API_UnRegister();
 
     bt_destroy(&Anchor->sess_btree);
+    bt_destroy(&Anchor->async_queue_btree);
 
 #if OPENSSL_VERSION_PREREQ(3, 0)
     /*
@@ -3114,7 +3146,8 @@ CK_RV C_Initialize(CK_VOID_PTR pVoid)
     //if ( Shared Memory Mapped not Successful )
     //                Free allocated Memory
     //                Return CKR_HOST_MEMORY
-    if (bt_init(&Anchor->sess_btree, free) != CKR_OK) {
+    if (bt_init(&Anchor->sess_btree, free) != CKR_OK ||
+        bt_init(&Anchor->async_queue_btree, AsyncQueueFree) != CKR_OK) {
         TRACE_ERROR("Btree init Failed.\n");
         rc = CKR_FUNCTION_FAILED;
         goto error;
@@ -3296,6 +3329,7 @@ error_shm:
 error:
     policy_unload(&policy);
     bt_destroy(&Anchor->sess_btree);
+    bt_destroy(&Anchor->async_queue_btree);
     if (Anchor->socketfd >= 0)
         close(Anchor->socketfd);
 
@@ -5649,6 +5683,357 @@ CK_RV C_IBM_ReencryptSingle(CK_SESSION_HANDLE hSession,
     return rv;
 }
 
+CK_RV C_IBM_SignBatch(CK_SESSION_HANDLE hSession,
+                      CK_MECHANISM_PTR pMechanism,
+                      CK_OBJECT_HANDLE hKey,
+                      CK_IBM_BATCH_ITEM_PTR pItems,
+                      CK_ULONG ulCount)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_SignBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (!pItems && ulCount != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_SignBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_SignBatch(sltp->TokData, &rSession, pMechanism,
+                                   hKey, pItems, ulCount);
+        TRACE_DEVEL("fcn->ST_IBM_SignBatch returned: 0x%lx\n", rv);
+        END_HSM_MK_CHANGE_LOCK(sltp, rv)
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_VerifyBatch(CK_SESSION_HANDLE hSession,
+                        CK_MECHANISM_PTR pMechanism,
+                        CK_OBJECT_HANDLE hKey,
+                        CK_IBM_BATCH_ITEM_PTR pItems,
+                        CK_ULONG ulCount)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_VerifyBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (!pItems && ulCount != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_VerifyBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_VerifyBatch(sltp->TokData, &rSession, pMechanism,
+                                     hKey, pItems, ulCount);
+        TRACE_DEVEL("fcn->ST_IBM_VerifyBatch returned: 0x%lx\n", rv);
+        END_HSM_MK_CHANGE_LOCK(sltp, rv)
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_EncryptBatch(CK_SESSION_HANDLE hSession,
+                         CK_MECHANISM_PTR pMechanism,
+                         CK_OBJECT_HANDLE hKey,
+                         CK_IBM_BATCH_ITEM_PTR pItems,
+                         CK_ULONG ulCount)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_EncryptBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (!pItems && ulCount != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_EncryptBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_EncryptBatch(sltp->TokData, &rSession, pMechanism,
+                                      hKey, pItems, ulCount);
+        TRACE_DEVEL("fcn->ST_IBM_EncryptBatch returned: 0x%lx\n", rv);
+        END_HSM_MK_CHANGE_LOCK(sltp, rv)
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_CreateQueue(CK_IBM_QUEUE_HANDLE_PTR phQueue)
+{
+    CK_RV rv;
+
+    TRACE_INFO("C_IBM_CreateQueue\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!phQueue) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    rv = AsyncQueueCreate(phQueue);
+    TRACE_DEVEL("AsyncQueueCreate returned: 0x%lx\n", rv);
+
+    return rv;
+}
+
+CK_RV C_IBM_DestroyQueue(CK_IBM_QUEUE_HANDLE hQueue)
+{
+    CK_RV rv;
+
+    TRACE_INFO("C_IBM_DestroyQueue\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    rv = AsyncQueueDestroy(hQueue);
+    TRACE_DEVEL("AsyncQueueDestroy returned: 0x%lx\n", rv);
+
+    return rv;
+}
+
+CK_RV C_IBM_AsyncSubmit(CK_SESSION_HANDLE hSession,
+                        CK_IBM_QUEUE_HANDLE hQueue,
+                        CK_IBM_ASYNC_REQUEST_PTR pRequest)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+    API_Async_Queue_t *q;
+
+    TRACE_INFO("C_IBM_AsyncSubmit\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pRequest) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!pRequest->pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (!pRequest->pItems && pRequest->ulCount != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_AsyncSubmit == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        return CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    q = AsyncQueueGet(hQueue);
+    if (q == NULL) {
+        TRACE_ERROR("Invalid queue handle: %lu\n", hQueue);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    /* On success, the queue reference is owned by the request */
+    rv = AsyncQueueReserve(q);
+    if (rv != CKR_OK) {
+        AsyncQueuePut(q);
+        return rv;
+    }
+
+    BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+    BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+    // Map the Session to the slot session
+    rv = fcn->ST_IBM_AsyncSubmit(sltp->TokData, &rSession, pRequest,
+                                 AsyncQueueComplete, q);
+    TRACE_DEVEL("fcn->ST_IBM_AsyncSubmit returned: 0x%lx\n", rv);
+    END_HSM_MK_CHANGE_LOCK(sltp, rv)
+    END_OPENSSL_LIBCTX(rv)
+
+    if (rv != CKR_OK) {
+        AsyncQueueCancel(q);
+        AsyncQueuePut(q);
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_AsyncPoll(CK_IBM_QUEUE_HANDLE hQueue,
+                      CK_IBM_ASYNC_REQUEST_PTR_PTR ppRequests,
+                      CK_ULONG ulMaxCount, CK_ULONG_PTR pulCount)
+{
+    API_Async_Queue_t *q;
+    CK_RV rv;
+
+    TRACE_INFO("C_IBM_AsyncPoll\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!ppRequests || ulMaxCount == 0 || !pulCount) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    q = AsyncQueueGet(hQueue);
+    if (q == NULL) {
+        TRACE_ERROR("Invalid queue handle: %lu\n", hQueue);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    rv = AsyncQueueReap(q, ppRequests, ulMaxCount, pulCount, FALSE, 0);
+    AsyncQueuePut(q);
+
+    return rv;
+}
+
+CK_RV C_IBM_AsyncWait(CK_IBM_QUEUE_HANDLE hQueue,
+                      CK_IBM_ASYNC_REQUEST_PTR_PTR ppRequests,
+                      CK_ULONG ulMaxCount, CK_ULONG_PTR pulCount,
+                      CK_ULONG ulTimeout)
+{
+    API_Async_Queue_t *q;
+    CK_RV rv;
+
+    TRACE_INFO("C_IBM_AsyncWait\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!ppRequests || ulMaxCount == 0 || !pulCount) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    q = AsyncQueueGet(hQueue);
+    if (q == NULL) {
+        TRACE_ERROR("Invalid queue handle: %lu\n", hQueue);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    rv = AsyncQueueReap(q, ppRequests, ulMaxCount, pulCount, TRUE, ulTimeout);
+    AsyncQueuePut(q);
+
+    return rv;
+}
+
 #if defined(__sun) || defined(_AIX)
 #pragma init(api_init)
 #else
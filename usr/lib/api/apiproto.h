@@ -45,6 +45,16 @@ void decr_sess_counts(CK_SLOT_ID, CK_BBOOL rw_session);
 unsigned long AddToSessionList(ST_SESSION_T *);
 void RemoveFromSessionList(CK_SESSION_HANDLE);
 int Valid_Session(CK_SESSION_HANDLE, ST_SESSION_T *);
+void AsyncQueueFree(void *);
+CK_RV AsyncQueueCreate(CK_IBM_QUEUE_HANDLE_PTR);
+CK_RV AsyncQueueDestroy(CK_IBM_QUEUE_HANDLE);
+API_Async_Queue_t *AsyncQueueGet(CK_IBM_QUEUE_HANDLE);
+void AsyncQueuePut(API_Async_Queue_t *);
+CK_RV AsyncQueueReserve(API_Async_Queue_t *);
+void AsyncQueueCancel(API_Async_Queue_t *);
+void AsyncQueueComplete(CK_IBM_ASYNC_REQUEST_PTR, void *);
+CK_RV AsyncQueueReap(API_Async_Queue_t *, CK_IBM_ASYNC_REQUEST_PTR_PTR,
+                     CK_ULONG, CK_ULONG_PTR, CK_BBOOL, CK_ULONG);
 void DL_UnLoad(API_Slot_t *, CK_SLOT_ID, CK_BBOOL inchildforkinit);
 void DL_Unload(API_Slot_t *);
 CK_RV check_user_and_group(const char *group);
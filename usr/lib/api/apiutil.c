@@ -24,6 +24,7 @@
 #include <errno.h>
 #include <sys/syslog.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <sys/ipc.h>
 
@@ -220,6 +221,202 @@ int Valid_Session(CK_SESSION_HANDLE handle, ST_SESSION_T *rSession)
     return rc;
 }
 
+void AsyncQueueFree(void *value)
+{
+    API_Async_Queue_t *q = value;
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->mutex);
+    free(q->completed);
+    free(q);
+}
+
+CK_RV AsyncQueueCreate(CK_IBM_QUEUE_HANDLE_PTR phQueue)
+{
+    API_Async_Queue_t *q;
+    unsigned long handle;
+
+    q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    if (pthread_mutex_init(&q->mutex, NULL) != 0) {
+        free(q);
+        TRACE_ERROR("Initializing the queue mutex failed.\n");
+        return CKR_CANT_LOCK;
+    }
+    if (pthread_cond_init(&q->cond, NULL) != 0) {
+        pthread_mutex_destroy(&q->mutex);
+        free(q);
+        TRACE_ERROR("Initializing the queue condition failed.\n");
+        return CKR_CANT_LOCK;
+    }
+
+    handle = bt_node_add(&(Anchor->async_queue_btree), q);
+    if (handle == 0) {
+        AsyncQueueFree(q);
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    *phQueue = handle;
+    return CKR_OK;
+}
+
+/*
+ * Waits until all requests in flight have completed, and then removes the
+ * queue. Completed requests that were not yet returned are dropped.
+ */
+CK_RV AsyncQueueDestroy(CK_IBM_QUEUE_HANDLE hQueue)
+{
+    API_Async_Queue_t *q;
+
+    q = bt_get_node_value(&(Anchor->async_queue_btree), hQueue);
+    if (q == NULL) {
+        TRACE_ERROR("Invalid queue handle: %lu\n", hQueue);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    pthread_mutex_lock(&q->mutex);
+    q->destroyed = TRUE;
+    pthread_cond_broadcast(&q->cond);
+    while (q->in_flight > 0)
+        pthread_cond_wait(&q->cond, &q->mutex);
+    pthread_mutex_unlock(&q->mutex);
+
+    bt_node_free(&(Anchor->async_queue_btree), hQueue, TRUE);
+    bt_put_node_value(&(Anchor->async_queue_btree), q);
+
+    return CKR_OK;
+}
+
+/*
+ * The returned queue must be put back with AsyncQueuePut(), unless a request
+ * was successfully reserved on it, which then owns the reference.
+ */
+API_Async_Queue_t *AsyncQueueGet(CK_IBM_QUEUE_HANDLE hQueue)
+{
+    return bt_get_node_value(&(Anchor->async_queue_btree), hQueue);
+}
+
+void AsyncQueuePut(API_Async_Queue_t *q)
+{
+    bt_put_node_value(&(Anchor->async_queue_btree), q);
+}
+
+/*
+ * Makes room for the completion of one more request in flight. Must be
+ * undone with AsyncQueueCancel() if the request can not be submitted.
+ */
+CK_RV AsyncQueueReserve(API_Async_Queue_t *q)
+{
+    CK_IBM_ASYNC_REQUEST_PTR *ring;
+    CK_ULONG size, i;
+
+    pthread_mutex_lock(&q->mutex);
+
+    if (q->destroyed) {
+        pthread_mutex_unlock(&q->mutex);
+        TRACE_ERROR("Queue is being destroyed.\n");
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (q->num_completed + q->in_flight + 1 > q->size) {
+        size = (q->size == 0 ? 16 : q->size * 2);
+        ring = malloc(size * sizeof(*ring));
+        if (ring == NULL) {
+            pthread_mutex_unlock(&q->mutex);
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+        for (i = 0; i < q->num_completed; i++)
+            ring[i] = q->completed[(q->head + i) % q->size];
+        free(q->completed);
+        q->completed = ring;
+        q->head = 0;
+        q->size = size;
+    }
+    q->in_flight++;
+
+    pthread_mutex_unlock(&q->mutex);
+
+    return CKR_OK;
+}
+
+void AsyncQueueCancel(API_Async_Queue_t *q)
+{
+    pthread_mutex_lock(&q->mutex);
+    q->in_flight--;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * Completion callback passed to ST_IBM_AsyncSubmit. Releases the queue
+ * reference owned by the request.
+ */
+void AsyncQueueComplete(CK_IBM_ASYNC_REQUEST_PTR pRequest, void *pContext)
+{
+    API_Async_Queue_t *q = pContext;
+
+    pthread_mutex_lock(&q->mutex);
+    q->completed[(q->head + q->num_completed) % q->size] = pRequest;
+    q->num_completed++;
+    q->in_flight--;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+
+    bt_put_node_value(&(Anchor->async_queue_btree), q);
+}
+
+/*
+ * Returns up to ulMaxCount completed requests. If wait is TRUE, and no
+ * completed request is available, waits until one completes, all requests
+ * have completed, or ulTimeout milliseconds have passed (0 = no timeout).
+ */
+CK_RV AsyncQueueReap(API_Async_Queue_t *q,
+                     CK_IBM_ASYNC_REQUEST_PTR_PTR ppRequests,
+                     CK_ULONG ulMaxCount, CK_ULONG_PTR pulCount,
+                     CK_BBOOL wait, CK_ULONG ulTimeout)
+{
+    struct timespec deadline;
+    CK_ULONG i;
+    int rc = 0;
+
+    if (wait && ulTimeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += ulTimeout / 1000;
+        deadline.tv_nsec += (ulTimeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&q->mutex);
+
+    while (wait && q->num_completed == 0 && q->in_flight > 0 &&
+           !q->destroyed && rc != ETIMEDOUT) {
+        if (ulTimeout > 0)
+            rc = pthread_cond_timedwait(&q->cond, &q->mutex, &deadline);
+        else
+            pthread_cond_wait(&q->cond, &q->mutex);
+    }
+
+    for (i = 0; i < ulMaxCount && q->num_completed > 0; i++) {
+        ppRequests[i] = q->completed[q->head];
+        q->head = (q->head + 1) % q->size;
+        q->num_completed--;
+    }
+    *pulCount = i;
+
+    pthread_mutex_unlock(&q->mutex);
+
+    return CKR_OK;
+}
+
 int API_Initialized(void)
 {
     if (Anchor == NULL)
@@ -245,15 +442,42 @@ int slot_present(CK_SLOT_ID id)
     return TRUE;
 }
 
+/*
+ * The session counters in the shared memory are updated with atomic
+ * operations only, without taking the ProcLock. The ProcLock is only used for
+ * structural changes of the process table (register/unregister), and by the
+ * garbage collection of pkcsslotd when it gives back the counts of processes
+ * that have terminated without calling C_Finalize.
+ */
+static inline uint32 shm_counter_get(uint32 *counter)
+{
+    return __sync_fetch_and_add(counter, 0);
+}
+
+static inline void shm_counter_inc(uint32 *counter)
+{
+    __sync_add_and_fetch(counter, 1);
+}
+
+static inline void shm_counter_dec(uint32 *counter)
+{
+    uint32 old;
+
+    /* Never go below zero */
+    do {
+        old = shm_counter_get(counter);
+        if (old == 0)
+            return;
+    } while (!__sync_bool_compare_and_swap(counter, old, old - 1));
+}
+
 void get_sess_counts(CK_SLOT_ID slotID, CK_ULONG *ret, CK_ULONG *rw_ret)
 {
     Slot_Mgr_Shr_t *shm;
 
     shm = Anchor->SharedMemP;
-    ProcLock();
-    *ret = shm->slot_global_sessions[slotID];
-    *rw_ret = shm->slot_global_rw_sessions[slotID];
-    ProcUnLock();
+    *ret = shm_counter_get(&shm->slot_global_sessions[slotID]);
+    *rw_ret = shm_counter_get(&shm->slot_global_rw_sessions[slotID]);
 }
 
 void incr_sess_counts(CK_SLOT_ID slotID, CK_BBOOL rw_session)
@@ -265,21 +489,22 @@ void incr_sess_counts(CK_SLOT_ID slotID, CK_BBOOL rw_session)
     Slot_Mgr_Proc_t *procp;
 #endif
 
-    // Get the slot mutex
     shm = Anchor->SharedMemP;
+    procp = &shm->proc_table[Anchor->MgrProcIndex];
 
-    ProcLock();
-
-    shm->slot_global_sessions[slotID]++;
+    /*
+     * Increment the global counters first, so that the per process counters
+     * never exceed what this process has added to the global counters. If
+     * the process terminates in between, the garbage collection thus never
+     * subtracts sessions of other processes from the global counters.
+     */
+    shm_counter_inc(&shm->slot_global_sessions[slotID]);
     if (rw_session)
-        shm->slot_global_rw_sessions[slotID]++;
+        shm_counter_inc(&shm->slot_global_rw_sessions[slotID]);
 
-    procp = &shm->proc_table[Anchor->MgrProcIndex];
-    procp->slot_session_count[slotID]++;
+    shm_counter_inc(&procp->slot_session_count[slotID]);
     if (rw_session)
-        procp->slot_rw_session_count[slotID]++;
-
-    ProcUnLock();
+        shm_counter_inc(&procp->slot_rw_session_count[slotID]);
 }
 
 void decr_sess_counts(CK_SLOT_ID slotID, CK_BBOOL rw_session)
@@ -291,27 +516,17 @@ void decr_sess_counts(CK_SLOT_ID slotID, CK_BBOOL rw_session)
     Slot_Mgr_Proc_t *procp;
 #endif
 
-    // Get the slot mutex
     shm = Anchor->SharedMemP;
-
-    ProcLock();
-
-    if (shm->slot_global_sessions[slotID] > 0) {
-        shm->slot_global_sessions[slotID]--;
-    }
-    if (rw_session && shm->slot_global_rw_sessions[slotID] > 0) {
-        shm->slot_global_rw_sessions[slotID]--;
-    }
-
     procp = &shm->proc_table[Anchor->MgrProcIndex];
-    if (procp->slot_session_count[slotID] > 0) {
-        procp->slot_session_count[slotID]--;
-    }
-    if (rw_session && procp->slot_rw_session_count[slotID] > 0) {
-        procp->slot_rw_session_count[slotID]--;
-    }
 
-    ProcUnLock();
+    /* Reverse order of incr_sess_counts */
+    shm_counter_dec(&procp->slot_session_count[slotID]);
+    if (rw_session)
+        shm_counter_dec(&procp->slot_rw_session_count[slotID]);
+
+    shm_counter_dec(&shm->slot_global_sessions[slotID]);
+    if (rw_session)
+        shm_counter_dec(&shm->slot_global_rw_sessions[slotID]);
 }
 
 uint32_t get_tokspec_count(STDLL_TokData_t *tokdata)
@@ -388,12 +603,8 @@ int sessions_exist(CK_SLOT_ID slotID)
     Slot_Mgr_Shr_t *shm;
     uint32 numSessions;
 
-    // Get the slot mutex
     shm = Anchor->SharedMemP;
-
-    ProcLock();
-    numSessions = shm->slot_global_sessions[slotID];
-    ProcUnLock();
+    numSessions = shm_counter_get(&shm->slot_global_sessions[slotID]);
 
     return numSessions != 0;
 }
@@ -550,6 +761,7 @@ void DL_UnLoad(API_Slot_t *sltp, CK_SLOT_ID slotID, CK_BBOOL inchildforkinit)
     if (sltp->TokData) {
         pthread_rwlock_destroy(&sltp->TokData->sess_list_rwlock);
         pthread_mutex_destroy(&sltp->TokData->login_mutex);
+        pthread_mutex_destroy(&sltp->TokData->sess_obj_list_mutex);
         if (sltp->TokData->hsm_mk_change_supported)
             pthread_rwlock_destroy(&sltp->TokData->hsm_mk_change_rwlock);
         free(sltp->TokData);
@@ -780,6 +992,12 @@ int DL_Load_and_Init(API_Slot_t *sltp, CK_SLOT_ID slotID, policy_t policy,
         sltp->TokData = NULL;
         return FALSE;
     }
+    if (pthread_mutex_init(&sltp->TokData->sess_obj_list_mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing session object list mutex failed.\n");
+        free(sltp->TokData);
+        sltp->TokData = NULL;
+        return FALSE;
+    }
     sltp->TokData->policy = policy;
     sltp->TokData->mechtable_funcs = &mechtable_funcs;
     sltp->TokData->statistics = statistics;
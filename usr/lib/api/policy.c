@@ -15,7 +15,6 @@
 #include "ock_syslog.h"
 #include <stdlib.h>
 #include <string.h>
-#include "hashmap.h"
 #include <ec_defs.h>
 #include <pkcs11types.h>
 #include <stdio.h>
@@ -62,8 +61,26 @@ struct strength {
     CK_BBOOL set;
 };
 
+/* Compiled verdicts of a mechanism, see policy_compile() */
+#define POLICY_MECH_ALLOWED      (1u << 0)
+#define POLICY_MECH_DIGESTSIZE   (1u << 1) /* digestbits is valid */
+#define POLICY_MECH_SIGSIZE      (1u << 2) /* sigbits is valid */
+#define POLICY_MECH_SIGSIZE_KEY  (1u << 3) /* sigbits is capped by the key */
+#define POLICY_MECH_SIGSIZE_PARM (1u << 4) /* signature size needs the param */
+#define POLICY_MECH_PARAMCHECK   (1u << 5) /* param must be checked */
+
+struct policy_mech {
+    CK_ULONG digestbits;
+    CK_ULONG sigbits;
+    unsigned int flags;
+};
+
+#define POLICY_MECH_WORDS ((MECHTABLE_NUM_ELEMS + 31) / 32)
+
 struct policy_private {
-    struct hashmap   *allowedmechs;
+    /* Indexed by mechtable index.  Only valid if restrictmechs is set. */
+    uint32_t           allowedmechs[POLICY_MECH_WORDS];
+    CK_BBOOL           restrictmechs;
     const struct _ec **allowedcurves;
     unsigned int       minstrengthidx;
     int                numallowedcurves; /* negative if all curves are allowed */
@@ -75,18 +92,31 @@ struct policy_private {
     CK_ULONG           maxcurvesize;
     /* Strength struct ordered from highest to lowest. */
     struct strength strengths[NUM_SUPPORTED_STRENGTHS];
+    /*
+     * Compiled from the above whenever the policy or strength definition
+     * changes.  The policy is immutable afterwards, so the checks done on
+     * every operation initialization only need table lookups.
+     */
+    CK_ULONG           mindigestbits;
+    CK_ULONG           minsigbits;
+    struct policy_mech mechs[MECHTABLE_NUM_ELEMS];
 };
 
+static void policy_compile(struct policy_private *pp);
+
 struct policy_private *policy_private_alloc(void)
 {
-    return calloc(1, sizeof(struct policy_private));
+    struct policy_private *pp;
+
+    pp = calloc(1, sizeof(struct policy_private));
+    if (pp)
+        policy_compile(pp);
+    return pp;
 }
 
 struct policy_private *policy_private_free(struct policy_private *pp)
 {
     if (pp) {
-        if (pp->allowedmechs)
-            hashmap_free(pp->allowedmechs, NULL);
         if (pp->allowedcurves)
             free(pp->allowedcurves);
         free(pp);
@@ -96,9 +126,8 @@ struct policy_private *policy_private_free(struct policy_private *pp)
 
 void policy_private_deactivate(struct policy_private *pp)
 {
-    hashmap_free(pp->allowedmechs, NULL);
-    /* Non-existing hash is universal. */
-    pp->allowedmechs = NULL;
+    /* No mechanism restriction. */
+    pp->restrictmechs = CK_FALSE;
     free(pp->allowedcurves);
     pp->allowedcurves = NULL;
     pp->minstrengthidx = NUM_SUPPORTED_STRENGTHS;
@@ -109,6 +138,28 @@ void policy_private_deactivate(struct policy_private *pp)
     pp->allowedvendorkdfs = ~0lu;
     pp->allowedprfs = ~0lu;
     pp->maxcurvesize = 521u;
+    policy_compile(pp);
+}
+
+static inline CK_BBOOL policy_is_mech_idx_listed(struct policy_private *pp,
+                                                 int idx)
+{
+    if (!pp->restrictmechs)
+        return CK_TRUE;
+    return idx >= 0 &&
+        (pp->allowedmechs[idx / 32] & (1u << (idx % 32))) != 0;
+}
+
+/*
+ * Check if a mechanism is in the list of allowed mechanisms.  Every
+ * mechanism in the list is known to the mechanism table.
+ */
+static inline CK_BBOOL policy_is_mech_listed(struct policy_private *pp,
+                                             CK_MECHANISM_TYPE mech)
+{
+    if (!pp->restrictmechs)
+        return CK_TRUE;
+    return policy_is_mech_idx_listed(pp, mechtable_idx_from_numeric(mech));
 }
 
 static void policy_compute_strength(struct policy_private *pp,
@@ -886,182 +937,286 @@ static CK_RV policy_store_object_strength(policy_t p, struct objstrength *s,
     return rv;
 }
 
+/*
+ * Mechanisms whose parameters are checked by policy_check_mech_param().
+ */
+static CK_BBOOL policy_mech_has_param_check(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+        /* POLICY: New CKM Deep Check */
+    case CKM_RSA_PKCS_PSS:
+    case CKM_SHA1_RSA_PKCS_PSS:
+    case CKM_SHA224_RSA_PKCS_PSS:
+    case CKM_SHA256_RSA_PKCS_PSS:
+    case CKM_SHA384_RSA_PKCS_PSS:
+    case CKM_SHA512_RSA_PKCS_PSS:
+    case CKM_SHA3_224_RSA_PKCS_PSS:
+    case CKM_SHA3_256_RSA_PKCS_PSS:
+    case CKM_SHA3_384_RSA_PKCS_PSS:
+    case CKM_SHA3_512_RSA_PKCS_PSS:
+    case CKM_RSA_PKCS_OAEP:
+    case CKM_ECDH1_DERIVE:
+    case CKM_IBM_ECDSA_OTHER:
+    case CKM_IBM_BTC_DERIVE:
+    case CKM_IBM_KYBER:
+        return CK_TRUE;
+    default:
+        return CK_FALSE;
+    }
+}
+
+static CK_RV policy_check_mech_param(struct policy_private *pp,
+                                     CK_MECHANISM_PTR mech)
+{
+    CK_RV rv = CKR_OK;
+
+    switch (mech->mechanism) {
+        /* POLICY: New CKM Deep Check */
+    case CKM_RSA_PKCS_PSS:
+    case CKM_SHA1_RSA_PKCS_PSS:
+    case CKM_SHA224_RSA_PKCS_PSS:
+    case CKM_SHA256_RSA_PKCS_PSS:
+    case CKM_SHA384_RSA_PKCS_PSS:
+    case CKM_SHA512_RSA_PKCS_PSS:
+    case CKM_SHA3_224_RSA_PKCS_PSS:
+    case CKM_SHA3_256_RSA_PKCS_PSS:
+    case CKM_SHA3_384_RSA_PKCS_PSS:
+    case CKM_SHA3_512_RSA_PKCS_PSS:
+        if (mech->ulParameterLen != sizeof(CK_RSA_PKCS_PSS_PARAMS) ||
+            mech->pParameter == NULL) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        if (!policy_is_mech_listed(pp,
+                                   ((CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter)->hashAlg)) {
+            TRACE_WARNING("POLICY VIOLATION: PSS hash algorithm not allowed by policy.\n");
+            rv = CKR_FUNCTION_FAILED;
+        } else if (policy_is_mgf_allowed(pp,
+                    ((CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter)->mgf) != CKR_OK) {
+            rv = CKR_FUNCTION_FAILED;
+        }
+        break;
+    case CKM_RSA_PKCS_OAEP:
+        if (mech->ulParameterLen != sizeof(CK_RSA_PKCS_OAEP_PARAMS) ||
+            mech->pParameter == NULL) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        if (!policy_is_mech_listed(pp,
+                                   ((CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter)->hashAlg)) {
+            TRACE_WARNING("POLICY VIOLATION: OAEP hash algorithm not allowed by policy.\n");
+            rv = CKR_FUNCTION_FAILED;
+        } else if (policy_is_mgf_allowed(pp,
+                    ((CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter)->mgf) != CKR_OK) {
+            rv = CKR_FUNCTION_FAILED;
+        }
+        break;
+    case CKM_ECDH1_DERIVE:
+        if (mech->ulParameterLen != sizeof(CK_ECDH1_DERIVE_PARAMS) ||
+            mech->pParameter == NULL) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        if (policy_is_kdf_allowed(pp,
+                                  ((CK_ECDH1_DERIVE_PARAMS *)mech->pParameter)->kdf) != CKR_OK)
+            rv = CKR_FUNCTION_FAILED;
+        break;
+    case CKM_IBM_ECDSA_OTHER:
+        if (mech->ulParameterLen != sizeof(CK_IBM_ECDSA_OTHER_PARAMS) ||
+            mech->pParameter == NULL) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        switch (((CK_IBM_ECDSA_OTHER_PARAMS *) mech->pParameter)->submechanism) {
+        case CKM_IBM_ECSDSA_RAND:
+        case CKM_IBM_ECSDSA_COMPR_MULTI:
+            /* Uses SHA-256 internally */
+            if (!policy_is_mech_listed(pp, CKM_SHA256)) {
+                TRACE_WARNING("POLICY VIOLATION: ECDSA OTHER SHA-256 algorithm not allowed by policy.\n");
+                rv = CKR_FUNCTION_FAILED;
+            }
+            break;
+        default:
+            rv = CKR_FUNCTION_FAILED;
+            break;
+        }
+        break;
+    case CKM_IBM_BTC_DERIVE:
+        if (mech->ulParameterLen != sizeof(CK_IBM_BTC_DERIVE_PARAMS) ||
+            mech->pParameter == NULL) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        if (((CK_IBM_BTC_DERIVE_PARAMS *)mech->pParameter)->version !=
+                                CK_IBM_BTC_DERIVE_PARAMS_VERSION_1)
+            break;
+        switch (((CK_IBM_BTC_DERIVE_PARAMS *)mech->pParameter)->type) {
+        case CK_IBM_BTC_BIP0032_PRV2PRV:
+        case CK_IBM_BTC_BIP0032_PRV2PUB:
+        case CK_IBM_BTC_BIP0032_PUB2PUB:
+        case CK_IBM_BTC_BIP0032_MASTERK:
+        case CK_IBM_BTC_SLIP0010_PRV2PRV:
+        case CK_IBM_BTC_SLIP0010_PRV2PUB:
+        case CK_IBM_BTC_SLIP0010_PUB2PUB:
+        case CK_IBM_BTC_SLIP0010_MASTERK:
+            /* Uses SHA-512 internally */
+            if (!policy_is_mech_listed(pp, CKM_SHA512_HMAC)) {
+                TRACE_WARNING("POLICY VIOLATION: BTC SHA-512-HMAC algorithm not allowed by policy.\n");
+                rv = CKR_FUNCTION_FAILED;
+            }
+            break;
+        default:
+            rv = CKR_FUNCTION_FAILED;
+            break;
+        }
+        break;
+    case CKM_IBM_KYBER:
+        /* Only KEM uses a parameter, KeyGen, Encrypt/Decrypt don't */
+        if (mech->ulParameterLen != sizeof(CK_IBM_KYBER_PARAMS) &&
+            mech->ulParameterLen != 0) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        if (mech->ulParameterLen != sizeof(CK_IBM_KYBER_PARAMS))
+            break;
+        if (mech->pParameter == NULL) {
+            TRACE_ERROR("Invalid mechanism parameter\n");
+            rv = CKR_MECHANISM_PARAM_INVALID;
+            break;
+        }
+        if (policy_is_kdf_allowed(pp,
+                                  ((CK_IBM_KYBER_PARAMS *)mech->pParameter)->kdf) != CKR_OK) {
+            rv = CKR_FUNCTION_FAILED;
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+    return rv;
+}
+
+/*
+ * Precompute the parts of policy_is_mech_allowed() that neither depend on
+ * the key nor on the mechanism parameter for all mechanisms of the
+ * mechanism table.
+ */
+static void policy_compile(struct policy_private *pp)
+{
+    /* A key with maximal signature length yields the cap of a mechanism. */
+    struct objstrength s = { 0, ~0ul, CK_TRUE };
+    CK_MECHANISM mech = { 0, NULL, 0 };
+    const struct mechrow *row;
+    struct policy_mech *pm;
+    CK_ULONG size;
+    int i;
+
+    if (pp->minstrengthidx < NUM_SUPPORTED_STRENGTHS) {
+        pp->mindigestbits =
+            pp->strengths[pp->minstrengthidx].strength.details.digests;
+        pp->minsigbits =
+            pp->strengths[pp->minstrengthidx].strength.details.signatures;
+    } else {
+        pp->mindigestbits = 0;
+        pp->minsigbits = 0;
+    }
+
+    for (i = 0; i < MECHTABLE_NUM_ELEMS; ++i) {
+        row = &mechtable_rows[i];
+        pm = &pp->mechs[i];
+        memset(pm, 0, sizeof(*pm));
+        if (policy_is_mech_idx_listed(pp, i))
+            pm->flags |= POLICY_MECH_ALLOWED;
+        if (policy_get_digest_size(row->numeric, &size) == CKR_OK) {
+            pm->flags |= POLICY_MECH_DIGESTSIZE;
+            pm->digestbits = size;
+        }
+        mech.mechanism = row->numeric;
+        if ((row->flags & MCF_MAC_GENERAL) ||
+            row->numeric == CKM_IBM_ECDSA_OTHER) {
+            pm->flags |= POLICY_MECH_SIGSIZE_PARM;
+        } else if (policy_get_sig_size(&mech, &s, &size) == CKR_OK) {
+            pm->flags |= POLICY_MECH_SIGSIZE;
+            if (row->outputsize == MC_KEY_DEPENDENT)
+                pm->flags |= POLICY_MECH_SIGSIZE_KEY;
+            pm->sigbits = size;
+        }
+        if (policy_mech_has_param_check(row->numeric))
+            pm->flags |= POLICY_MECH_PARAMCHECK;
+    }
+}
+
 static CK_RV policy_is_mech_allowed(policy_t p, CK_MECHANISM_PTR mech,
                                     struct objstrength *s, int check,
                                     SESSION *sess)
 {
     struct policy_private *pp = p->priv;
-    CK_ULONG size;
+    const struct policy_mech *pm = NULL;
+    unsigned int flags;
+    CK_ULONG size = 0;
     CK_RV rv = CKR_OK;
+    int idx;
 
     if (pp) {
         if (s && policy_is_key_allowed_i(pp, s) != CKR_OK) {
             rv = CKR_FUNCTION_FAILED;
             goto out;
         }
-        if (hashmap_find(pp->allowedmechs, mech->mechanism, NULL) == 0) {
+        idx = mechtable_idx_from_numeric(mech->mechanism);
+        if (idx >= 0) {
+            pm = &pp->mechs[idx];
+            flags = pm->flags;
+        } else {
+            /* Unknown mechanisms are only allowed without a mech list. */
+            flags = pp->restrictmechs ? 0 : POLICY_MECH_ALLOWED;
+        }
+        if (!(flags & POLICY_MECH_ALLOWED)) {
             TRACE_WARNING("Mechanism 0x%lx not allowed by policy\n",
                           mech->mechanism);
             rv = CKR_FUNCTION_FAILED;
             goto out;
         }
         if (check == POLICY_CHECK_DIGEST) {
-            if (policy_get_digest_size(mech->mechanism, &size) != CKR_OK) {
+            if (!(flags & POLICY_MECH_DIGESTSIZE)) {
                 TRACE_WARNING("POLICY ERROR: Failed to retrieve digest size.\n");
                 rv = CKR_FUNCTION_FAILED;
                 goto out;
             }
-            if (pp->minstrengthidx < NUM_SUPPORTED_STRENGTHS &&
-                size <
-                pp->strengths[pp->minstrengthidx].strength.details.digests) {
+            if (pm->digestbits < pp->mindigestbits) {
                 TRACE_WARNING("Digest output too small for policy.\n");
                 rv = CKR_FUNCTION_FAILED;
                 goto out;
             }
         } else if (check == POLICY_CHECK_SIGNATURE ||
                 check == POLICY_CHECK_VERIFY) {
-            if (policy_get_sig_size(mech, s, &size) != CKR_OK) {
+            if (flags & POLICY_MECH_SIGSIZE_PARM) {
+                rv = policy_get_sig_size(mech, s, &size);
+            } else if ((flags & POLICY_MECH_SIGSIZE) && s) {
+                size = pm->sigbits;
+                if ((flags & POLICY_MECH_SIGSIZE_KEY) && s->siglen < size)
+                    size = s->siglen;
+            } else {
+                rv = CKR_FUNCTION_FAILED;
+            }
+            if (rv != CKR_OK) {
                 TRACE_WARNING("POLICY ERROR: Failed to retrieve signature size.\n");
                 rv = CKR_FUNCTION_FAILED;
                 goto out;
             }
-            if (pp->minstrengthidx < NUM_SUPPORTED_STRENGTHS &&
-                size <
-                pp->strengths[pp->minstrengthidx].strength.details.signatures) {
+            if (size < pp->minsigbits) {
                 TRACE_WARNING("Signature too small for policy.\n");
                 rv = CKR_FUNCTION_FAILED;
                 goto out;
             }
         }
-        switch (mech->mechanism) {
-            /* POLICY: New CKM Deep Check */
-        case CKM_RSA_PKCS_PSS:
-        case CKM_SHA1_RSA_PKCS_PSS:
-        case CKM_SHA224_RSA_PKCS_PSS:
-        case CKM_SHA256_RSA_PKCS_PSS:
-        case CKM_SHA384_RSA_PKCS_PSS:
-        case CKM_SHA512_RSA_PKCS_PSS:
-        case CKM_SHA3_224_RSA_PKCS_PSS:
-        case CKM_SHA3_256_RSA_PKCS_PSS:
-        case CKM_SHA3_384_RSA_PKCS_PSS:
-        case CKM_SHA3_512_RSA_PKCS_PSS:
-            if (mech->ulParameterLen != sizeof(CK_RSA_PKCS_PSS_PARAMS) ||
-                mech->pParameter == NULL) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            if (hashmap_find(pp->allowedmechs,
-                             ((CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter)->hashAlg, NULL) == 0) {
-                TRACE_WARNING("POLICY VIOLATION: PSS hash algorithm not allowed by policy.\n");
-                rv = CKR_FUNCTION_FAILED;
-            } else if (policy_is_mgf_allowed(pp,
-                        ((CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter)->mgf) != CKR_OK) {
-                rv = CKR_FUNCTION_FAILED;
-            }
-            break;
-        case CKM_RSA_PKCS_OAEP:
-            if (mech->ulParameterLen != sizeof(CK_RSA_PKCS_OAEP_PARAMS) ||
-                mech->pParameter == NULL) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            if (hashmap_find(pp->allowedmechs,
-                             ((CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter)->hashAlg, NULL) == 0) {
-                TRACE_WARNING("POLICY VIOLATION: OAEP hash algorithm not allowed by policy.\n");
-                rv = CKR_FUNCTION_FAILED;
-            } else if (policy_is_mgf_allowed(pp,
-                        ((CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter)->mgf) != CKR_OK) {
-                rv = CKR_FUNCTION_FAILED;
-            }
-            break;
-        case CKM_ECDH1_DERIVE:
-            if (mech->ulParameterLen != sizeof(CK_ECDH1_DERIVE_PARAMS) ||
-                mech->pParameter == NULL) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            if (policy_is_kdf_allowed(pp,
-                                      ((CK_ECDH1_DERIVE_PARAMS *)mech->pParameter)->kdf) != CKR_OK)
-                rv = CKR_FUNCTION_FAILED;
-            break;
-        case CKM_IBM_ECDSA_OTHER:
-            if (mech->ulParameterLen != sizeof(CK_IBM_ECDSA_OTHER_PARAMS) ||
-                mech->pParameter == NULL) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            switch (((CK_IBM_ECDSA_OTHER_PARAMS *) mech->pParameter)->submechanism) {
-            case CKM_IBM_ECSDSA_RAND:
-            case CKM_IBM_ECSDSA_COMPR_MULTI:
-                /* Uses SHA-256 internally */
-                if (hashmap_find(pp->allowedmechs, CKM_SHA256, NULL) == 0) {
-                    TRACE_WARNING("POLICY VIOLATION: ECDSA OTHER SHA-256 algorithm not allowed by policy.\n");
-                    rv = CKR_FUNCTION_FAILED;
-                }
-                break;
-            default:
-                rv = CKR_FUNCTION_FAILED;
-                break;
-            }
-            break;
-        case CKM_IBM_BTC_DERIVE:
-            if (mech->ulParameterLen != sizeof(CK_IBM_BTC_DERIVE_PARAMS) ||
-                mech->pParameter == NULL) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            if (((CK_IBM_BTC_DERIVE_PARAMS *)mech->pParameter)->version !=
-                                    CK_IBM_BTC_DERIVE_PARAMS_VERSION_1)
-                break;
-            switch (((CK_IBM_BTC_DERIVE_PARAMS *)mech->pParameter)->type) {
-            case CK_IBM_BTC_BIP0032_PRV2PRV:
-            case CK_IBM_BTC_BIP0032_PRV2PUB:
-            case CK_IBM_BTC_BIP0032_PUB2PUB:
-            case CK_IBM_BTC_BIP0032_MASTERK:
-            case CK_IBM_BTC_SLIP0010_PRV2PRV:
-            case CK_IBM_BTC_SLIP0010_PRV2PUB:
-            case CK_IBM_BTC_SLIP0010_PUB2PUB:
-            case CK_IBM_BTC_SLIP0010_MASTERK:
-                /* Uses SHA-512 internally */
-                if (hashmap_find(pp->allowedmechs, CKM_SHA512_HMAC, NULL) == 0) {
-                    TRACE_WARNING("POLICY VIOLATION: BTC SHA-512-HMAC algorithm not allowed by policy.\n");
-                    rv = CKR_FUNCTION_FAILED;
-                }
-                break;
-            default:
-                rv = CKR_FUNCTION_FAILED;
-                break;
-            }
-            break;
-        case CKM_IBM_KYBER:
-            /* Only KEM uses a parameter, KeyGen, Encrypt/Decrypt don't */
-            if (mech->ulParameterLen != sizeof(CK_IBM_KYBER_PARAMS) &&
-                mech->ulParameterLen != 0) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            if (mech->ulParameterLen != sizeof(CK_IBM_KYBER_PARAMS))
-                break;
-            if (mech->pParameter == NULL) {
-                TRACE_ERROR("Invalid mechanism parameter\n");
-                rv = CKR_MECHANISM_PARAM_INVALID;
-                break;
-            }
-            if (policy_is_kdf_allowed(pp,
-                                      ((CK_IBM_KYBER_PARAMS *)mech->pParameter)->kdf) != CKR_OK) {
-                rv = CKR_FUNCTION_FAILED;
-                break;
-            }
-            break;
-        default:
-            break;
-        }
+        if (flags & POLICY_MECH_PARAMCHECK)
+            rv = policy_check_mech_param(pp, mech);
     }
  out:
     if (rv != CKR_OK && sess)
@@ -1079,7 +1234,7 @@ static CK_RV policy_update_mech_info(policy_t p, CK_MECHANISM_TYPE mech,
     CK_BBOOL isaesxts = CK_FALSE;
 
     if (pp) {
-        if (hashmap_find(pp->allowedmechs, mech, NULL) == 0)
+        if (!policy_is_mech_listed(pp, mech))
             return CKR_MECHANISM_INVALID;
         switch (mech) {
             /* POLICY: New CKM */
@@ -1326,23 +1481,23 @@ static CK_RV policy_check_token_store(policy_t p, CK_BBOOL newversion,
     if (pp) {
         s.allowed = CK_TRUE;
         if (newversion) {
-            if (hashmap_find(pp->allowedmechs, CKM_AES_KEY_GEN, NULL) == 0) {
+            if (!policy_is_mech_listed(pp, CKM_AES_KEY_GEN)) {
                 TRACE_WARNING("POLICY VIOLATION: CKM_AES_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_AES_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                 return CKR_GENERAL_ERROR;
             }
-            if (hashmap_find(pp->allowedmechs, CKM_AES_KEY_WRAP, NULL) == 0) {
+            if (!policy_is_mech_listed(pp, CKM_AES_KEY_WRAP)) {
                 TRACE_WARNING("POLICY VIOLATION: CKM_AES_KEY_WRAP needed by Token-Store for slot %lu\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_AES_KEY_WRAP needed by Token-Store for slot %lu\n", slot);
                 return CKR_GENERAL_ERROR;
             }
-            if (hashmap_find(pp->allowedmechs, CKM_AES_GCM, NULL) == 0) {
+            if (!policy_is_mech_listed(pp, CKM_AES_GCM)) {
                 TRACE_WARNING("POLICY VIOLATION: CKM_AES_GCM needed by Token-Store for slot %lu\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_AES_GCM needed by Token-Store for slot %lu\n", slot);
                 return CKR_GENERAL_ERROR;
             }
             policy_compute_strength(pp, &s, 256, COMPARE_SYMMETRIC);
-            if (hashmap_find(pp->allowedmechs, CKM_PKCS5_PBKD2, NULL) == 0) {
+            if (!policy_is_mech_listed(pp, CKM_PKCS5_PBKD2)) {
                 TRACE_WARNING("POLICY VIOLATION: CKM_PKCS5_PBKD2 needed by Token-Store for slot %lu\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_PKCS5_PBKD2 needed by Token-Store for slot %lu\n", slot);
                 return CKR_GENERAL_ERROR;
@@ -1364,25 +1519,25 @@ static CK_RV policy_check_token_store(policy_t p, CK_BBOOL newversion,
             }
         } else {
             /* ICSF does not use a datastore, so encalgo is 0. */
-            if (encalgo && hashmap_find(pp->allowedmechs, encalgo, NULL) == 0) {
+            if (encalgo && !policy_is_mech_listed(pp, encalgo)) {
                 TRACE_WARNING("POLICY VIOLATION: Token-Store encryption method not allowed for slot %lu!\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: Token-Store encryption method not allowed for slot %lu!\n", slot);
                 return CKR_GENERAL_ERROR;
             }
             /* SO pin hash */
-            if (hashmap_find(pp->allowedmechs, CKM_SHA_1, NULL) == 0) {
+            if (!policy_is_mech_listed(pp, CKM_SHA_1)) {
                 TRACE_WARNING("POLICY VIOLATION: Token-Store requires SHA1 for slot %lu!\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: Token-Store requires SHA1 for slot %lu!\n", slot);
                 return CKR_GENERAL_ERROR;
             }
             /* User pin hash */
-            if (hashmap_find(pp->allowedmechs, CKM_MD5, NULL) == 0) {
+            if (!policy_is_mech_listed(pp, CKM_MD5)) {
                 TRACE_WARNING("POLICY VIOLATION: Token-Store requires MD5 for slot %lu!\n", slot);
                 OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: Token-Store requires MD5 for slot %lu!\n", slot);
                 return CKR_GENERAL_ERROR;
             }
             if (encalgo == CKM_DES3_CBC) {
-                if (hashmap_find(pp->allowedmechs, CKM_DES3_KEY_GEN, NULL) == 0) {
+                if (!policy_is_mech_listed(pp, CKM_DES3_KEY_GEN)) {
                     TRACE_WARNING("POLICY VIOLATION: CKM_DES3_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                     OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_DES3_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                     return CKR_GENERAL_ERROR;
@@ -1403,7 +1558,7 @@ static CK_RV policy_check_token_store(policy_t p, CK_BBOOL newversion,
                     ts->wrap_strength = s.strength;
                 }
             } else if (encalgo == CKM_AES_CBC) {
-                if (hashmap_find(pp->allowedmechs, CKM_AES_KEY_GEN, NULL) == 0) {
+                if (!policy_is_mech_listed(pp, CKM_AES_KEY_GEN)) {
                     TRACE_WARNING("POLICY VIOLATION: CKM_AES_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                     OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_AES_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                     return CKR_GENERAL_ERROR;
@@ -1424,18 +1579,18 @@ static CK_RV policy_check_token_store(policy_t p, CK_BBOOL newversion,
                 return CKR_GENERAL_ERROR;
             } else {
                 /* ICSF token */
-                if (hashmap_find(pp->allowedmechs, CKM_AES_KEY_GEN, NULL) == 0) {
+                if (!policy_is_mech_listed(pp, CKM_AES_KEY_GEN)) {
                     TRACE_WARNING("POLICY VIOLATION: CKM_AES_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                     OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_AES_KEY_GEN needed by Token-Store for slot %lu\n", slot);
                     return CKR_GENERAL_ERROR;
                 }
-                if (hashmap_find(pp->allowedmechs, CKM_AES_CBC, NULL) == 0) {
+                if (!policy_is_mech_listed(pp, CKM_AES_CBC)) {
                     TRACE_WARNING("POLICY VIOLATION: CKM_AES_CBC needed by Token-Store for slot %lu\n", slot);
                     OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_AES_CBC needed by Token-Store for slot %lu\n", slot);
                     return CKR_GENERAL_ERROR;
                 }
                 policy_compute_strength(pp, &s, 256, COMPARE_SYMMETRIC);
-                if (hashmap_find(pp->allowedmechs, CKM_PKCS5_PBKD2, NULL) == 0) {
+                if (!policy_is_mech_listed(pp, CKM_PKCS5_PBKD2)) {
                     TRACE_WARNING("POLICY VIOLATION: CKM_PKCS5_PBKD2 needed by Token-Store for slot %lu\n", slot);
                     OCK_SYSLOG(LOG_ERR, "POLICY VIOLATION: CKM_PKCS5_PBKD2 needed by Token-Store for slot %lu\n", slot);
                     return CKR_GENERAL_ERROR;
@@ -1590,34 +1745,27 @@ static CK_RV policy_check_unmarked(struct ConfigBaseNode *n)
 static CK_RV policy_parse_mechlist(struct policy_private *pp,
                                    struct ConfigBaseNode *list)
 {
-    union hashmap_value val = { .ulVal = 0 };
     struct ConfigBaseNode *i;
     const char *mechstr;
-    struct hashmap *h;
     CK_RV rc = CKR_OK;
-    CK_ULONG mech;
+    int idx;
     int f;
 
-    h = hashmap_new();
-    if (!h)
-        return CKR_HOST_MEMORY;
+    memset(pp->allowedmechs, 0, sizeof(pp->allowedmechs));
+    pp->restrictmechs = CK_TRUE;
     if (list) {
         confignode_foreach(i, list, f) {
             mechstr = i->key;
-            rc = translate_string_to_mech(mechstr, strlen(mechstr), &mech);
-            if (rc != CKR_OK) {
+            idx = mechtable_idx_from_string(mechstr);
+            if (idx < 0) {
                 TRACE_ERROR("POLICY: Unknown mechanism: %s (line %hd)\n",
                             mechstr, i->line);
+                rc = CKR_FUNCTION_FAILED;
                 break;
             }
-            if (hashmap_add(h, mech, val, NULL)) {
-                TRACE_ERROR("POLICY: failed to add mechanism to hash!\n");
-                rc = CKR_HOST_MEMORY;
-                break;
-            }
+            pp->allowedmechs[idx / 32] |= 1u << (idx % 32);
         }
     }
-    pp->allowedmechs = h;
     return rc;
 }
 
@@ -1829,6 +1977,7 @@ CK_RV policy_load_strength_cfg(struct policy_private *pp,
     if (rc == CKR_OK)
         rc = policy_check_unmarked(cfg);
     confignode_deepfree(cfg);
+    policy_compile(pp);
     return rc;
 }
 
@@ -1974,6 +2123,7 @@ CK_RV policy_load_policy_cfg(struct policy_private *pp,
     if (rc == CKR_FUNCTION_FAILED)
         rc = CKR_GENERAL_ERROR;
     confignode_deepfree(cfg);
+    policy_compile(pp);
     return rc;
 }
 
@@ -196,6 +196,41 @@ static CK_RV statistics_increment(struct statistics *statistics,
     return CKR_OK;
 }
 
+static struct stat_device *statistics_device(struct statistics *statistics,
+                                             CK_SLOT_ID slot,
+                                             CK_ULONG adapter, CK_ULONG domain)
+{
+    struct stat_device *dev;
+    CK_ULONG ofs, id = STAT_DEVICE_ID(adapter, domain);
+    unsigned int i;
+
+    if (slot >= NUMBER_SLOTS_MANAGED)
+        return NULL;
+
+    ofs = statistics->slot_shm_offsets[slot];
+    if (ofs > statistics->shm_size)
+        return NULL;
+
+    ofs = statistics->num_slots * STAT_SLOT_SIZE +
+                            (ofs / STAT_SLOT_SIZE) * STAT_DEV_SIZE;
+    if (ofs + STAT_DEV_SIZE > statistics->shm_size)
+        return NULL;
+
+    dev = (struct stat_device *)(statistics->shm_data + ofs);
+
+    /* Other processes of the user may claim device blocks concurrently */
+    for (i = 0; i < STAT_MAX_DEVICES; i++) {
+        if (dev[i].id == id ||
+            __sync_bool_compare_and_swap(&dev[i].id, 0, id) ||
+            dev[i].id == id)
+            return &dev[i];
+    }
+
+    TRACE_WARNING("No statistics device block available for slot %lu\n",
+                  slot);
+    return NULL;
+}
+
 /*
  * Open the statistics shared memory segment for the specified user.
  * If user is -1, then it is opened for the current user.
@@ -368,7 +403,8 @@ CK_RV statistics_init(struct statistics *statistics,
             statistics->slot_shm_offsets[i] = (CK_ULONG)-1;
         }
     }
-    statistics->shm_size = statistics->num_slots * STAT_SLOT_SIZE;
+    statistics->shm_size = statistics->num_slots *
+                                    (STAT_SLOT_SIZE + STAT_DEV_SIZE);
 
     TRACE_INFO("%lu slots defined\n", statistics->num_slots);
     TRACE_INFO("Statistics SHM size: %lu\n", statistics->shm_size);
@@ -378,6 +414,7 @@ CK_RV statistics_init(struct statistics *statistics,
         goto error;
 
     statistics->increment_func = statistics_increment;
+    statistics->device_func = statistics_device;
 
     return CKR_OK;
 
@@ -23,9 +23,17 @@
  *       - one counter (counter_t) for non-key mechanisms (strength=0)
  *       - one counter for each supported strength (counter_t each)
  *
+ * - For each configured slot:
+ *    - STAT_MAX_DEVICES device counter blocks (struct stat_device)
+ *
  * The size of the shared segment therefore is:
  *   Num configured slots * num supp.mechanisms * (num supp. strength + 1) *
- *                                                  size of a counter
+ *                                                  size of a counter +
+ *   Num configured slots * STAT_MAX_DEVICES * size of a device block
+ *
+ * Tokens that distribute requests across several crypto devices (APQNs)
+ * count the requests per device in the device counter blocks of their slot.
+ * A device block is in use if its id is not zero.
  */
 
 typedef CK_ULONG counter_t;
@@ -33,6 +41,26 @@ typedef CK_ULONG counter_t;
 #define STAT_MECH_SIZE  ((NUM_SUPPORTED_STRENGTHS + 1) * sizeof(counter_t))
 #define STAT_SLOT_SIZE  (MECHTABLE_NUM_ELEMS * STAT_MECH_SIZE)
 
+struct stat_device {
+    counter_t id;           /* STAT_DEVICE_ID(adapter, domain), 0 = unused */
+    counter_t requests;
+    counter_t errors;
+    counter_t timeouts;
+    counter_t ejections;
+    counter_t usec;         /* accumulated latency of the requests */
+};
+
+#define STAT_MAX_DEVICES        32
+#define STAT_DEV_SIZE   (STAT_MAX_DEVICES * sizeof(struct stat_device))
+
+#define STAT_DEVICE_ANY         0x7fff /* adapter or domain not known */
+#define STAT_DEVICE_USED        0x80000000UL
+#define STAT_DEVICE_ID(adapter, domain)                                     \
+                (STAT_DEVICE_USED | (((adapter) & 0x7fffUL) << 16) |        \
+                 ((domain) & 0x7fffUL))
+#define STAT_DEVICE_ADAPTER(id) (((id) >> 16) & 0x7fffUL)
+#define STAT_DEVICE_DOMAIN(id)  ((id) & 0x7fffUL)
+
 struct statistics;
 typedef struct statistics *statistics_t;
 
@@ -41,6 +69,11 @@ typedef CK_RV (*statistics_increment_f)(struct statistics *statistics,
                                         const CK_MECHANISM *mech,
                                         CK_ULONG strength);
 
+typedef struct stat_device *(*statistics_device_f)(
+                                        struct statistics *statistics,
+                                        CK_SLOT_ID slot,
+                                        CK_ULONG adapter, CK_ULONG domain);
+
 #define STATISTICS_FLAG_COUNT_IMPLICIT      (1 << 0)
 #define STATISTICS_FLAG_COUNT_INTERNAL      (1 << 1)
 
@@ -52,6 +85,7 @@ struct statistics {
     char shm_name[PATH_MAX];
     CK_BYTE *shm_data;
     statistics_increment_f increment_func; /* NULL if statistics disabled */
+    statistics_device_f device_func; /* NULL if statistics disabled */
 };
 
 #define INC_COUNTER(tokdata, sess, mech, key, no_key_strength)              \
@@ -62,6 +96,17 @@ struct statistics {
                   ((OBJECT *)(key))->strength.strength : (no_key_strength));\
     } while (0)
 
+/*
+ * Returns the device counter block of a slot for the specified adapter and
+ * domain, or NULL if statistics are disabled or no block is available. The
+ * counters must be incremented atomically.
+ */
+#define STAT_DEVICE(tokdata, adapter, domain)                               \
+    ((tokdata)->statistics->device_func != NULL ?                           \
+        (tokdata)->statistics->device_func((tokdata)->statistics,           \
+                                           (tokdata)->slot_id,              \
+                                           (adapter), (domain)) : NULL)
+
 CK_RV statistics_init(struct statistics *statistics,
                       Slot_Mgr_Socket_t *slots_infos, CK_ULONG flags,
                       uid_t uid);
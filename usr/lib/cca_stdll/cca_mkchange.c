@@ -245,7 +245,7 @@ retry:
         sprintf((char *)(rule_array + CCA_KEYWORD_SIZE), "DOMN%04u", ssd.domain);
         rule_array_count = 2;
 
-        if (pthread_rwlock_wrlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_lock_write() != CKR_OK) {
             TRACE_DEVEL("CCA adapter WR-Lock failed.\n");
             return CKR_CANT_LOCK;
         }
@@ -260,7 +260,7 @@ retry:
         TRACE_ERROR("CSUACRA failed. return:%ld, reason:%ld\n",
                     return_code, reason_code);
 
-        if (pthread_rwlock_unlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_unlock() != CKR_OK) {
             TRACE_DEVEL("CCA adapter Unlock failed.\n");
             return CKR_CANT_LOCK;
         }
@@ -381,7 +381,7 @@ retry:
 
     /* cca_select_single_apqn() got the WRITE lock, unlock it now */
     if (cca_private->dom_any) {
-        if (pthread_rwlock_unlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_unlock() != CKR_OK) {
             TRACE_ERROR("CCA adapter Unlock failed.\n");
             return CKR_CANT_LOCK;
         }
@@ -489,7 +489,7 @@ CK_BBOOL cca_check_blob_select_single_apqn(STDLL_TokData_t *tokdata,
      * get WRITE lock.
      */
     if (cca_private->dom_any) {
-        if (pthread_rwlock_unlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_unlock() != CKR_OK) {
             TRACE_ERROR("CCA adapter Unlock failed.\n");
             return FALSE;
         }
@@ -505,7 +505,7 @@ CK_BBOOL cca_check_blob_select_single_apqn(STDLL_TokData_t *tokdata,
 
     /* Need to get RD-lock again in case no new APQN was selected */
     if (!new_selected && cca_private->dom_any) {
-        if (pthread_rwlock_rdlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_lock_read() != CKR_OK) {
             TRACE_ERROR("CCA adapter RD-Lock failed.\n");
             return FALSE;
         }
@@ -1567,6 +1567,7 @@ static CK_RV cca_reencipher_sec_key(STDLL_TokData_t *tokdata,
 struct reencipher_data {
     STDLL_TokData_t *tokdata;
     struct cca_mk_change_op *mk_change_op;
+    const char *op_id;
 };
 
 static CK_RV cca_reencipher_objects_reenc(CK_BYTE *sec_key,
@@ -1586,7 +1587,7 @@ static CK_RV cca_reencipher_objects_cb(STDLL_TokData_t *tokdata,
     struct reencipher_data *rd = cb_data;
     CK_RV rc;
 
-    rc = obj_mgr_reencipher_secure_key(tokdata, obj,
+    rc = obj_mgr_reencipher_secure_key(tokdata, obj, rd->op_id,
                                        cca_reencipher_objects_reenc, rd);
     if (rc == CKR_OBJECT_HANDLE_INVALID) /* Obj was deleted by other proc */
         rc = CKR_OK;
@@ -1594,6 +1595,38 @@ static CK_RV cca_reencipher_objects_cb(STDLL_TokData_t *tokdata,
     return rc;
 }
 
+static void cca_reencipher_progress_cb(STDLL_TokData_t *tokdata,
+                                       CK_ULONG done, CK_ULONG total,
+                                       void *cb_data)
+{
+    struct reencipher_data *rd = cb_data;
+    struct hsm_mk_change_progress progress;
+    CK_RV rc;
+
+    TRACE_INFO("%s %lu of %lu token objects processed\n", __func__,
+               done, total);
+
+    progress.done = done;
+    progress.total = total;
+
+    rc = hsm_mk_change_lock_create();
+    if (rc != CKR_OK)
+        return;
+
+    rc = hsm_mk_change_lock(TRUE);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = hsm_mk_change_progress_save(rd->op_id, tokdata->slot_id, &progress);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("%s failed to save the progress: 0x%lx\n", __func__, rc);
+
+    hsm_mk_change_unlock();
+
+out:
+    hsm_mk_change_lock_destroy();
+}
+
 static CK_BBOOL cca_reencipher_filter_cb(STDLL_TokData_t *tokdata,
                                          OBJECT *obj, void *filter_data)
 {
@@ -1919,16 +1952,19 @@ static CK_RV cca_mk_change_reencipher(STDLL_TokData_t *tokdata,
     /* Re-encipher key objects */
     rd.tokdata = tokdata;
     rd.mk_change_op = mk_change_op;
+    rd.op_id = op->id;
 
     rc = obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
                                      cca_reencipher_filter_cb, mk_change_op,
                                      cca_reencipher_objects_cb, &rd,
+                                     token_objs ?
+                                        cca_reencipher_progress_cb : NULL,
                                      TRUE, "re-encipher");
     if (rc != CKR_OK) {
         obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
                                     cca_reencipher_cancel_filter_cb, mk_change_op,
                                     cca_reencipher_cancel_objects_cb, NULL,
-                                    TRUE, "cancel");
+                                    NULL, TRUE, "cancel");
         /*
          * The pkcshsm_mk_change tool will send a CANCEL event, so leave the
          * operation active for now.
@@ -2011,7 +2047,7 @@ static CK_RV cca_mk_change_finalize_cancel(STDLL_TokData_t *tokdata,
                                      cancel ?
                                          cca_reencipher_cancel_objects_cb :
                                          cca_reencipher_finalize_objects_cb,
-                                     NULL, TRUE,
+                                     NULL, NULL, TRUE,
                                      cancel ? "cancel" : "finalize");
     if (rc != CKR_OK)
         goto out;
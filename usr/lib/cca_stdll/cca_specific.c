@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <limits.h>
 #include <syslog.h>
 #include <dlfcn.h>
@@ -195,18 +196,51 @@ static CSUACFV_t dll_CSUACFV;
 
 /*
  * The CCA adapter lock is shared between all CCA token instances within the
- * same process. Users of the CCA adapter(s) should obtain a READ lock, to
- * be sure that no CCA adapter and/or domain selection is done concurrently.
- * Whenever a CCA adapter and/or domain selection is performed, a WRITE lock
- * must be obtained. This blocks all users until the selection processing is
- * finished.
+ * same process. Users of the CCA adapter(s) should use cca_adapter_lock_read(),
+ * to be sure that no CCA adapter and/or domain selection is done concurrently.
+ * Whenever a CCA adapter and/or domain selection is performed,
+ * cca_adapter_lock_write() must be used. This blocks all users until the
+ * selection processing is finished.
  * While CCA device selection has thread scope, domain selection seems to have
  * process scope. Thus, domain selection influences not only the current thread,
  * but all threads of the process.
  */
-pthread_rwlock_t cca_adapter_rwlock;
+static pthread_rwlock_t cca_adapter_rwlock;
 static unsigned long cca_adapter_rwlock_ref_count = 0;
 
+/*
+ * Adapter selections are rare (token init, MK change processing), so users of
+ * the CCA adapter(s) normally do not take the CCA adapter lock at all. Each
+ * thread is assigned round-robin to a dispatch slot at its first use of the
+ * adapter, and registers as user in that slot only. A thread performing a
+ * selection announces this in cca_adapter_selecting, obtains the WRITE lock,
+ * and then waits until all slots are drained. Users that see a selection
+ * being announced fall back to obtaining a READ lock, so they queue up behind
+ * the (writer preferring) CCA adapter lock.
+ */
+#define CCA_DISPATCH_SLOTS      64
+
+struct cca_dispatch_slot {
+    unsigned long users;
+    unsigned long requests;
+    unsigned long locked;
+} __attribute__((aligned(64)));
+
+enum cca_adapter_held {
+    CCA_ADAPTER_HELD_NONE = 0,
+    CCA_ADAPTER_HELD_SHARED,
+    CCA_ADAPTER_HELD_READ,
+    CCA_ADAPTER_HELD_WRITE,
+};
+
+static struct cca_dispatch_slot cca_dispatch_slots[CCA_DISPATCH_SLOTS];
+static unsigned int cca_dispatch_next = 0;
+static unsigned long cca_adapter_selecting = 0;
+static unsigned long cca_adapter_selections = 0;
+
+static __thread struct cca_dispatch_slot *cca_dispatch_self = NULL;
+static __thread enum cca_adapter_held cca_adapter_held = CCA_ADAPTER_HELD_NONE;
+
 /* mechanisms provided by this token */
 static const MECH_LIST_ELEMENT cca_mech_list[] = {
     {CKM_DES_KEY_GEN, {8, 8, CKF_HW | CKF_GENERATE}},
@@ -358,6 +392,8 @@ static CK_RV init_cca_adapter_lock(STDLL_TokData_t *tokdata)
     return CKR_OK;
 }
 
+static void cca_dispatch_trace_stats(void);
+
 static void destroy_cca_adapter_lock(STDLL_TokData_t *tokdata)
 {
     struct cca_private_data *cca_private = tokdata->private_data;
@@ -372,8 +408,177 @@ static void destroy_cca_adapter_lock(STDLL_TokData_t *tokdata)
 
     cnt = __sync_sub_and_fetch(&cca_adapter_rwlock_ref_count, 1);
 
-    if (cnt == 0)
+    if (cnt == 0) {
+        cca_dispatch_trace_stats();
         pthread_rwlock_destroy(&cca_adapter_rwlock);
+    }
+}
+
+static struct cca_dispatch_slot *cca_dispatch_get_slot(void)
+{
+    unsigned int idx;
+
+    if (cca_dispatch_self == NULL) {
+        idx = __atomic_fetch_add(&cca_dispatch_next, 1, __ATOMIC_RELAXED);
+        cca_dispatch_self = &cca_dispatch_slots[idx % CCA_DISPATCH_SLOTS];
+    }
+
+    return cca_dispatch_self;
+}
+
+static void cca_dispatch_trace_stats(void)
+{
+    unsigned long slot_requests, slot_locked, requests = 0, locked = 0;
+    unsigned int i, threads;
+
+    threads = __atomic_load_n(&cca_dispatch_next, __ATOMIC_RELAXED);
+    for (i = 0; i < CCA_DISPATCH_SLOTS; i++) {
+        slot_requests = __atomic_load_n(&cca_dispatch_slots[i].requests,
+                                        __ATOMIC_RELAXED);
+        slot_locked = __atomic_load_n(&cca_dispatch_slots[i].locked,
+                                      __ATOMIC_RELAXED);
+        if (slot_requests != 0)
+            TRACE_INFO("CCA dispatch slot %u: requests: %lu locked: %lu\n",
+                       i, slot_requests, slot_locked);
+        requests += slot_requests;
+        locked += slot_locked;
+    }
+
+    TRACE_INFO("CCA adapter usage: threads: %u requests: %lu locked: %lu "
+               "selections: %lu\n", threads, requests, locked,
+               __atomic_load_n(&cca_adapter_selections, __ATOMIC_RELAXED));
+}
+
+/*
+ * Start using the CCA adapter(s). Only called for DOM-ANY configurations.
+ * Must be paired with cca_adapter_unlock().
+ */
+CK_RV cca_adapter_lock_read(void)
+{
+    struct cca_dispatch_slot *slot = cca_dispatch_get_slot();
+
+    __atomic_add_fetch(&slot->requests, 1, __ATOMIC_RELAXED);
+
+    if (__atomic_load_n(&cca_adapter_selecting, __ATOMIC_SEQ_CST) == 0) {
+        __atomic_add_fetch(&slot->users, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&cca_adapter_selecting, __ATOMIC_SEQ_CST) == 0) {
+            cca_adapter_held = CCA_ADAPTER_HELD_SHARED;
+            return CKR_OK;
+        }
+        /* Selection announced concurrently, back off */
+        __atomic_sub_fetch(&slot->users, 1, __ATOMIC_SEQ_CST);
+    }
+
+    __atomic_add_fetch(&slot->locked, 1, __ATOMIC_RELAXED);
+
+    if (pthread_rwlock_rdlock(&cca_adapter_rwlock) != 0)
+        return CKR_CANT_LOCK;
+
+    cca_adapter_held = CCA_ADAPTER_HELD_READ;
+    return CKR_OK;
+}
+
+/*
+ * Obtain exclusive use of the CCA adapter(s) to perform adapter and domain
+ * selection. Must NOT be called while using the CCA adapter(s) already.
+ * Must be paired with cca_adapter_unlock().
+ */
+CK_RV cca_adapter_lock_write(void)
+{
+    unsigned int i;
+
+    __atomic_add_fetch(&cca_adapter_selecting, 1, __ATOMIC_SEQ_CST);
+
+    if (pthread_rwlock_wrlock(&cca_adapter_rwlock) != 0) {
+        __atomic_sub_fetch(&cca_adapter_selecting, 1, __ATOMIC_SEQ_CST);
+        return CKR_CANT_LOCK;
+    }
+
+    /* Wait for the users that did not take the lock */
+    for (i = 0; i < CCA_DISPATCH_SLOTS; i++) {
+        while (__atomic_load_n(&cca_dispatch_slots[i].users,
+                               __ATOMIC_SEQ_CST) != 0)
+            sched_yield();
+    }
+
+    __atomic_add_fetch(&cca_adapter_selections, 1, __ATOMIC_RELAXED);
+
+    cca_adapter_held = CCA_ADAPTER_HELD_WRITE;
+    return CKR_OK;
+}
+
+/*
+ * Stop using the CCA adapter(s), or release exclusive use, whatever the
+ * calling thread currently holds. Does nothing if nothing is held.
+ */
+CK_RV cca_adapter_unlock(void)
+{
+    enum cca_adapter_held held = cca_adapter_held;
+
+    cca_adapter_held = CCA_ADAPTER_HELD_NONE;
+
+    switch (held) {
+    case CCA_ADAPTER_HELD_NONE:
+        break;
+    case CCA_ADAPTER_HELD_SHARED:
+        __atomic_sub_fetch(&cca_dispatch_self->users, 1, __ATOMIC_SEQ_CST);
+        break;
+    case CCA_ADAPTER_HELD_READ:
+        if (pthread_rwlock_unlock(&cca_adapter_rwlock) != 0)
+            return CKR_CANT_LOCK;
+        break;
+    case CCA_ADAPTER_HELD_WRITE:
+        if (pthread_rwlock_unlock(&cca_adapter_rwlock) != 0)
+            return CKR_CANT_LOCK;
+        __atomic_sub_fetch(&cca_adapter_selecting, 1, __ATOMIC_SEQ_CST);
+        break;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Start a CCA verb, see USE_CCA_ADAPTER_START. Registers as user of the CCA
+ * adapter(s) for DOM-ANY configurations.
+ */
+CK_RV cca_adapter_use_start(STDLL_TokData_t *tokdata, struct timespec *start)
+{
+    struct cca_private_data *cca_private = tokdata->private_data;
+
+    if (cca_private->dev_stat != NULL)
+        clock_gettime(CLOCK_MONOTONIC, start);
+
+    if (!cca_private->dom_any)
+        return CKR_OK;
+
+    return cca_adapter_lock_read();
+}
+
+/*
+ * End a CCA verb started with cca_adapter_use_start(), and count it in the
+ * statistics device counters of the token.
+ */
+CK_RV cca_adapter_use_end(STDLL_TokData_t *tokdata,
+                          const struct timespec *start, long return_code)
+{
+    struct cca_private_data *cca_private = tokdata->private_data;
+    struct stat_device *dev_stat = cca_private->dev_stat;
+    struct timespec now;
+
+    if (dev_stat != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        __sync_add_and_fetch(&dev_stat->requests, 1);
+        __sync_add_and_fetch(&dev_stat->usec,
+                             (now.tv_sec - start->tv_sec) * 1000000UL +
+                             (now.tv_nsec - start->tv_nsec) / 1000);
+        if (return_code != CCA_SUCCESS)
+            __sync_add_and_fetch(&dev_stat->errors, 1);
+    }
+
+    if (!cca_private->dom_any)
+        return CKR_OK;
+
+    return cca_adapter_unlock();
 }
 
 /*
@@ -1585,7 +1790,7 @@ static CK_RV cca_iterate_domains(STDLL_TokData_t *tokdata, const char *device,
      * domain selection has been turned back to default.
      */
     if (cca_private->dom_any) {
-        if (pthread_rwlock_wrlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_lock_write() != CKR_OK) {
             TRACE_DEVEL("CCA adapter WR-Lock failed.\n");
             return CKR_CANT_LOCK;
         }
@@ -1668,7 +1873,7 @@ deallocate:
 
     /* Release the CCA adapter WRITE lock now if DOM-ANY */
     if (cca_private->dom_any) {
-        if (pthread_rwlock_unlock(&cca_adapter_rwlock) != 0) {
+        if (cca_adapter_unlock() != CKR_OK) {
             TRACE_DEVEL("CCA adapter Unlock failed.\n");
             return CKR_CANT_LOCK;
         }
@@ -4071,6 +4276,29 @@ static CK_BBOOL cca_rsa_oaep_2_1_supported(STDLL_TokData_t *tokdata)
     return ret;
 }
 
+/*
+ * Gets the statistics device counters for the CCA verbs of the token. The
+ * adapter and domain are only known if they are not auto-selected by CCA
+ * with DEV-ANY and DOM-ANY.
+ */
+static void cca_setup_device_stats(STDLL_TokData_t *tokdata)
+{
+    struct cca_private_data *cca_private = tokdata->private_data;
+    unsigned short card = STAT_DEVICE_ANY, domain = STAT_DEVICE_ANY;
+
+    if (tokdata->statistics->device_func == NULL)
+        return;
+
+    if (!cca_private->dev_any && cca_get_current_card(&card, NULL) != CKR_OK)
+        card = STAT_DEVICE_ANY;
+    if (!cca_private->dom_any && cca_get_current_domain(&domain) != CKR_OK)
+        domain = STAT_DEVICE_ANY;
+
+    cca_private->dev_stat = STAT_DEVICE(tokdata, card, domain);
+}
+
+#define CCA_ASYNC_THREADS       32
+
 CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
                           char *conf_name)
 {
@@ -4137,6 +4365,8 @@ CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
     if (rc != CKR_OK)
         goto error;
 
+    cca_setup_device_stats(tokdata);
+
     rc = cca_mk_change_check_pending_ops(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("%s Failed to check for pending HSM MK change operations "
@@ -4194,6 +4424,12 @@ CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
         goto error;
     }
 
+    /*
+     * CCA verbs block until the adapter completes the request, so let many
+     * async requests be outstanding to keep the adapter queues busy.
+     */
+    tokdata->async_threads = CCA_ASYNC_THREADS;
+
     return CKR_OK;
 
 error:
@@ -20,6 +20,7 @@
 #define __CCA_STDLL_H__
 
 #include <pthread.h>
+#include <time.h>
 
 #include "pkcs11types.h"
 #include "defs.h"
@@ -306,6 +307,7 @@ struct cca_private_data {
     int pkeyfd;
     int msa_level;
     CK_BBOOL cka_sensitive_default_true;
+    struct stat_device *dev_stat; /* NULL if statistics are disabled */
 };
 
 #define CCA_CFG_EXPECTED_MKVPS  "EXPECTED_MKVPS"
@@ -374,38 +376,40 @@ extern CSNDKTC_t dll_CSNDKTC;
 
 /*
  * Macros to enclose any usage of CCA verbs.
- * Obtains a READ lock on the CCA adapter lock, if a DOM-ANY configuration is
+ * Registers as user of the CCA adapter(s), if a DOM-ANY configuration is
  * used. This prevents CCA adapter usage concurrent to another thread performing
  * Domain selection processing. Domain selection works on process scope, so
  * it would influence all threads that currently use CCA verbs.
+ * The CCA adapter lock is only obtained while a selection is in progress.
+ * The request is counted in the statistics device counters of the token.
  */
 #define USE_CCA_ADAPTER_START(tokdata, return_code, reason_code)             \
                 do {                                                         \
-                    if (((struct cca_private_data *)                         \
-                                      (tokdata)->private_data)->dom_any) {   \
-                        if (pthread_rwlock_rdlock(&cca_adapter_rwlock)       \
-                                                                    != 0) {  \
-                            TRACE_ERROR("CCA adapter RD-Lock failed.\n");    \
-                            (return_code) = 16;                              \
-                            (reason_code) = 336;                             \
-                            break;                                           \
-                        }                                                    \
+                    struct timespec cca_use_start;                           \
+                    if (cca_adapter_use_start((tokdata),                     \
+                                              &cca_use_start) != CKR_OK) {   \
+                        TRACE_ERROR("CCA adapter RD-Lock failed.\n");        \
+                        (return_code) = 16;                                  \
+                        (reason_code) = 336;                                 \
+                        break;                                               \
                     }
 
 #define USE_CCA_ADAPTER_END(tokdata, return_code, reason_code)               \
-                    if (((struct cca_private_data *)                         \
-                                       (tokdata)->private_data)->dom_any) {  \
-                        if (pthread_rwlock_unlock(&cca_adapter_rwlock)       \
-                                                                    != 0) {  \
-                            TRACE_ERROR("CCA adapter Unlock failed.\n");     \
-                            (return_code) = 16;                              \
-                            (reason_code) = 336;                             \
-                            break;                                           \
-                        }                                                    \
+                    if (cca_adapter_use_end((tokdata), &cca_use_start,       \
+                                            (return_code)) != CKR_OK) {      \
+                        TRACE_ERROR("CCA adapter Unlock failed.\n");         \
+                        (return_code) = 16;                                  \
+                        (reason_code) = 336;                                 \
+                        break;                                               \
                     }                                                        \
                 } while (0);
 
-extern pthread_rwlock_t cca_adapter_rwlock;
+CK_RV cca_adapter_lock_read(void);
+CK_RV cca_adapter_lock_write(void);
+CK_RV cca_adapter_unlock(void);
+CK_RV cca_adapter_use_start(STDLL_TokData_t *tokdata, struct timespec *start);
+CK_RV cca_adapter_use_end(STDLL_TokData_t *tokdata,
+                          const struct timespec *start, long return_code);
 
 CK_RV build_update_attribute(TEMPLATE * tmpl,
                              CK_ATTRIBUTE_TYPE type,
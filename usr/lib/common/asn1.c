@@ -27,129 +27,273 @@
 #include "pqc_defs.h"
 
 
+// DER writer
 //
+// The encoders below build their output with a DER writer instead of
+// encoding every element into a buffer of its own and copying it into the
+// enclosing one. The writer fills its buffer from the end towards the
+// beginning: the contents of an element are written first, and its header
+// is written in front of them once their length is known. An encoder
+// function is run twice: without a buffer to compute the length of the
+// complete encoding, and then into a single buffer of exactly that length.
 //
-CK_ULONG ber_encode_INTEGER(CK_BBOOL length_only,
-                            CK_BYTE **ber_int,
-                            CK_ULONG *ber_int_len, CK_BYTE *data,
-                            CK_ULONG data_len)
+struct der_writer {
+    CK_BYTE *buf;               // NULL: only compute the length
+    CK_ULONG size;
+    CK_ULONG len;               // bytes written at the end of buf
+    CK_RV rc;
+};
+
+typedef void (*der_encode_fn)(struct der_writer *w, const void *args);
+
+static void der_put_data(struct der_writer *w, const CK_BYTE *data,
+                         CK_ULONG data_len)
 {
-    CK_BYTE *buf = NULL;
-    CK_ULONG len, padding = 0;
-
-    // ber encoded integers are alway signed. So if the msb of the first byte
-    // is set, this would indicate an negative value if we just copy the
-    // (unsigned) big integer from *data to the ber buffer. So in this case
-    // a preceding 0x00 byte is stored before the actual data. The decode
-    // function does the reverse and may skip this padding.
-
-    if ((length_only && data_len && (!data || *data & 0x80))
-        || (data_len && data && *data & 0x80))
-        padding = 1;
-
-    // if data_len < 127 use short-form length id
-    // if data_len < 256 use long-form length id with 1-byte length field
-    // if data_len < 65536 use long-form length id with 2-byte length field
-    // if data_len < 16777216 use long-form length id with 3-byte length field
-    //
-    if (data_len + padding < 128) {
-        len = 1 + 1 + padding + data_len;
-    } else if (data_len + padding < 256) {
-        len = 1 + (1 + 1) + padding + data_len;
-    } else if (data_len + padding < (1 << 16)) {
-        len = 1 + (1 + 2) + padding + data_len;
-    } else if (data_len + padding < (1 << 24)) {
-        len = 1 + (1 + 3) + padding + data_len;
+    CK_BYTE *p;
+
+    if (w->rc != CKR_OK)
+        return;
+
+    if (w->buf != NULL) {
+        if (data_len > w->size - w->len) {
+            TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+            w->rc = CKR_FUNCTION_FAILED;
+            return;
+        }
+        p = w->buf + w->size - w->len - data_len;
+        if (data != NULL && data_len > 0)
+            memcpy(p, data, data_len);
+        else if (data_len > 0)
+            memset(p, 0, data_len);
+    }
+
+    w->len += data_len;
+}
+
+// writes the identifier and length octets of an element whose contents
+// are 'len' bytes long. Lengths up to 16MB are supported.
+//
+static void der_put_header(struct der_writer *w, CK_BYTE tag, CK_ULONG len)
+{
+    CK_BYTE hdr[5];
+    CK_ULONG hdr_len;
+
+    hdr[0] = tag;
+    if (len < 128) {
+        hdr[1] = len;
+        hdr_len = 2;
+    } else if (len < 256) {
+        hdr[1] = 0x81;
+        hdr[2] = len;
+        hdr_len = 3;
+    } else if (len < (1 << 16)) {
+        hdr[1] = 0x82;
+        hdr[2] = (len >> 8) & 0xFF;
+        hdr[3] = len & 0xFF;
+        hdr_len = 4;
+    } else if (len < (1 << 24)) {
+        hdr[1] = 0x83;
+        hdr[2] = (len >> 16) & 0xFF;
+        hdr[3] = (len >> 8) & 0xFF;
+        hdr[4] = len & 0xFF;
+        hdr_len = 5;
     } else {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        return CKR_FUNCTION_FAILED;
+        if (w->rc == CKR_OK)
+            w->rc = CKR_FUNCTION_FAILED;
+        return;
     }
+
+    der_put_data(w, hdr, hdr_len);
+}
+
+// completes a constructed element around everything written since 'mark'
+//
+static void der_put_constructed(struct der_writer *w, CK_BYTE tag,
+                                CK_ULONG mark)
+{
+    der_put_header(w, tag, w->len - mark);
+}
+
+static void der_put_element(struct der_writer *w, CK_BYTE tag,
+                            const CK_BYTE *prefix, CK_ULONG prefix_len,
+                            const CK_BYTE *data, CK_ULONG data_len)
+{
+    CK_ULONG mark = w->len;
+
+    der_put_data(w, data, data_len);
+    der_put_data(w, prefix, prefix_len);
+    der_put_constructed(w, tag, mark);
+}
+
+// ber encoded integers are alway signed. So if the msb of the first byte
+// is set, this would indicate an negative value if we just copy the
+// (unsigned) big integer from *data to the ber buffer. So in this case
+// a preceding 0x00 byte is stored before the actual data. The decode
+// function does the reverse and may skip this padding.
+//
+static void der_put_integer(struct der_writer *w, const CK_BYTE *data,
+                            CK_ULONG data_len, CK_BBOOL padding)
+{
+    static const CK_BYTE zero[] = { 0x00 };
+
+    der_put_element(w, 0x02, zero, padding ? 1 : 0, data, data_len);
+}
+
+static CK_BBOOL der_integer_padding(const CK_BYTE *data, CK_ULONG data_len)
+{
+    return (data_len && data && *data & 0x80) ? TRUE : FALSE;
+}
+
+static void der_put_attr_integer(struct der_writer *w, CK_ATTRIBUTE *attr)
+{
+    der_put_integer(w, attr->pValue, attr->ulValueLen,
+                    der_integer_padding(attr->pValue, attr->ulValueLen));
+}
+
+static void der_put_bit_string(struct der_writer *w, const CK_BYTE *data,
+                               CK_ULONG data_len, CK_BYTE unused_bits)
+{
+    der_put_element(w, 0x03, &unused_bits, 1, data, data_len);
+}
+
+static void der_put_attr_bit_string(struct der_writer *w, CK_ATTRIBUTE *attr)
+{
+    der_put_bit_string(w, attr->pValue, attr->ulValueLen, 0);
+}
+
+// AlgorithmIdentifier ::= SEQUENCE {
+//    algorithm  OBJECT IDENTIFIER
+//    parameters NULL
+// }
+//
+static void der_put_algorithm_id(struct der_writer *w,
+                                 const CK_BYTE *oid, CK_ULONG oid_len)
+{
+    CK_ULONG mark = w->len;
+
+    der_put_data(w, ber_NULL, ber_NULLLen);
+    der_put_data(w, oid, oid_len);
+    der_put_constructed(w, 0x30, mark);
+}
+
+// completes a PrivateKeyInfo around the private key written since 'mark'.
+// The algorithm identifier is built from 'oid' with NULL parameters if an
+// oid is given, otherwise 'algorithm_id' holds the encoded identifier.
+//
+static void der_put_private_key_info(struct der_writer *w, CK_ULONG mark,
+                                     const CK_BYTE *algorithm_id,
+                                     CK_ULONG algorithm_id_len,
+                                     const CK_BYTE *oid, CK_ULONG oid_len)
+{
+    static const CK_BYTE version[] = { 0 };
+
+    der_put_constructed(w, 0x04, mark);
+    if (oid != NULL)
+        der_put_algorithm_id(w, oid, oid_len);
+    else
+        der_put_data(w, algorithm_id, algorithm_id_len);
+    der_put_integer(w, version, sizeof(version), FALSE);
+    der_put_constructed(w, 0x30, mark);
+}
+
+// completes a SubjectPublicKeyInfo around the public key written since
+// 'mark', which becomes the contents of the subjectPublicKey BIT STRING.
+// The algorithm identifier is passed as for der_put_private_key_info().
+//
+static void der_put_spki(struct der_writer *w, CK_ULONG mark,
+                         const CK_BYTE *algorithm_id,
+                         CK_ULONG algorithm_id_len,
+                         const CK_BYTE *oid, CK_ULONG oid_len)
+{
+    static const CK_BYTE unused_bits[] = { 0 };
+
+    der_put_data(w, unused_bits, sizeof(unused_bits));
+    der_put_constructed(w, 0x03, mark);
+    if (oid != NULL)
+        der_put_algorithm_id(w, oid, oid_len);
+    else
+        der_put_data(w, algorithm_id, algorithm_id_len);
+    der_put_constructed(w, 0x30, mark);
+}
+
+// runs 'encode' to compute the length of the encoding and, unless only the
+// length is requested, again to write it into a newly allocated buffer
+//
+static CK_RV der_encode(CK_BBOOL length_only, CK_BYTE **data,
+                        CK_ULONG *data_len, der_encode_fn encode,
+                        const void *args)
+{
+    struct der_writer w = { NULL, 0, 0, CKR_OK };
+
+    encode(&w, args);
+    if (w.rc != CKR_OK)
+        return w.rc;
+
     if (length_only == TRUE) {
-        *ber_int_len = len;
+        *data_len = w.len;
         return CKR_OK;
     }
 
-    buf = (CK_BYTE *) malloc(len);
-    if (!buf) {
+    w.buf = (CK_BYTE *) malloc(w.len);
+    if (!w.buf) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         return CKR_HOST_MEMORY;
     }
+    w.size = w.len;
+    w.len = 0;
 
-    if (data_len + padding < 128) {
-        buf[0] = 0x02;
-        buf[1] = data_len + padding;
-        if (padding) {
-            buf[2] = 0x00;
-            if (data && data_len)
-                memcpy(&buf[3], data, data_len);
-        } else {
-            if (data && data_len)
-                memcpy(&buf[2], data, data_len);
-        }
-        *ber_int_len = len;
-        *ber_int = buf;
-        return CKR_OK;
+    encode(&w, args);
+    if (w.rc == CKR_OK && w.len != w.size) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        w.rc = CKR_FUNCTION_FAILED;
     }
-
-    if (data_len + padding < 256) {
-        buf[0] = 0x02;
-        buf[1] = 0x81;
-        buf[2] = data_len + padding;
-        if (padding) {
-            buf[3] = 0x00;
-            if (data && data_len)
-                memcpy(&buf[4], data, data_len);
-        } else {
-            if (data && data_len)
-                memcpy(&buf[3], data, data_len);
-        }
-        *ber_int_len = len;
-        *ber_int = buf;
-        return CKR_OK;
+    if (w.rc != CKR_OK) {
+        free(w.buf);
+        return w.rc;
     }
 
-    if (data_len + padding < (1 << 16)) {
-        buf[0] = 0x02;
-        buf[1] = 0x82;
-        buf[2] = ((data_len + padding) >> 8) & 0xFF;
-        buf[3] = ((data_len + padding)) & 0xFF;
-        if (padding) {
-            buf[4] = 0x00;
-            if (data && data_len)
-                memcpy(&buf[5], data, data_len);
-        } else {
-            if (data && data_len)
-                memcpy(&buf[4], data, data_len);
-        }
-        *ber_int_len = len;
-        *ber_int = buf;
-        return CKR_OK;
-    }
+    *data = w.buf;
+    *data_len = w.size;
 
-    if (data_len + padding < (1 << 24)) {
-        buf[0] = 0x02;
-        buf[1] = 0x83;
-        buf[2] = ((data_len + padding) >> 16) & 0xFF;
-        buf[3] = ((data_len + padding) >> 8) & 0xFF;
-        buf[4] = ((data_len + padding)) & 0xFF;
-        if (padding) {
-            buf[5] = 0x00;
-            if (data)
-                memcpy(&buf[6], data, data_len);
-        } else {
-            if (data)
-                memcpy(&buf[5], data, data_len);
-        }
-        *ber_int_len = len;
-        *ber_int = buf;
-        return CKR_OK;
-    }
-    // we should never reach this
-    //
-    free(buf);
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+    return CKR_OK;
+}
 
-    return CKR_FUNCTION_FAILED;
+struct der_element_args {
+    CK_BYTE tag;
+    const CK_BYTE *prefix;
+    CK_ULONG prefix_len;
+    const CK_BYTE *data;
+    CK_ULONG data_len;
+};
+
+static void der_encode_element(struct der_writer *w, const void *args)
+{
+    const struct der_element_args *e = args;
+
+    der_put_element(w, e->tag, e->prefix, e->prefix_len,
+                    e->data, e->data_len);
+}
+
+
+//
+//
+CK_ULONG ber_encode_INTEGER(CK_BBOOL length_only,
+                            CK_BYTE **ber_int,
+                            CK_ULONG *ber_int_len, CK_BYTE *data,
+                            CK_ULONG data_len)
+{
+    static const CK_BYTE zero[] = { 0x00 };
+    struct der_element_args e = { 0x02, zero, 0, data, data_len };
+
+    // if only the length is requested, the data may be omitted. Reserve
+    // space for the padding byte then.
+    if (der_integer_padding(data, data_len) ||
+        (length_only && data_len && !data))
+        e.prefix_len = 1;
+
+    return der_encode(length_only, ber_int, ber_int_len,
+                      der_encode_element, &e);
 }
 
 
@@ -250,94 +394,11 @@ CK_RV ber_encode_OCTET_STRING(CK_BBOOL length_only,
                               CK_ULONG *str_len, CK_BYTE *data,
                               CK_ULONG data_len)
 {
-    CK_BYTE *buf = NULL;
-    CK_ULONG len;
+    struct der_element_args e = { 0x04, NULL, 0, data, data_len };
 
     // I only support Primitive encoding for OCTET STRINGS
     //
-
-    // if data_len < 128 use short-form length id
-    // if data_len < 256 use long-form length id with 1-byte length field
-    // if data_len < 65536 use long-form length id with 2-byte length field
-    //
-
-    if (data_len < 128) {
-        len = 1 + 1 + data_len;
-    } else if (data_len < 256) {
-        len = 1 + (1 + 1) + data_len;
-    } else if (data_len < (1 << 16)) {
-        len = 1 + (1 + 2) + data_len;
-    } else if (data_len < (1 << 24)) {
-        len = 1 + (1 + 3) + data_len;
-    } else {
-        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        return CKR_FUNCTION_FAILED;
-    }
-    if (length_only == TRUE) {
-        *str_len = len;
-        return CKR_OK;
-    }
-
-    buf = (CK_BYTE *) malloc(len);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-
-    if (data_len < 128) {
-        buf[0] = 0x04;          // primitive, OCTET STRING
-        buf[1] = data_len;
-        memcpy(&buf[2], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < 256) {
-        buf[0] = 0x04;          // primitive, OCTET STRING
-        buf[1] = 0x81;          // length header -- 1 length octets
-        buf[2] = data_len;
-
-        memcpy(&buf[3], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < (1 << 16)) {
-        buf[0] = 0x04;          // primitive, OCTET STRING
-        buf[1] = 0x82;          // length header -- 2 length octets
-        buf[2] = (data_len >> 8) & 0xFF;
-        buf[3] = (data_len) & 0xFF;
-
-        memcpy(&buf[4], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < (1 << 24)) {
-        buf[0] = 0x04;          // primitive, OCTET STRING
-        buf[1] = 0x83;          // length header -- 3 length octets
-        buf[2] = (data_len >> 16) & 0xFF;
-        buf[3] = (data_len >> 8) & 0xFF;
-        buf[4] = (data_len) & 0xFF;
-
-        memcpy(&buf[5], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-    // we should never reach this
-    //
-    free(buf);
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-
-    return CKR_FUNCTION_FAILED;
+    return der_encode(length_only, str, str_len, der_encode_element, &e);
 }
 
 
@@ -422,92 +483,10 @@ CK_ULONG ber_encode_BIT_STRING(CK_BBOOL length_only,
                             CK_ULONG data_len,
                             CK_BYTE unused_bits)
 {
-    CK_BYTE *buf = NULL;
-    CK_ULONG len;
-
-    // if data_len < 127 use short-form length id
-    // if data_len < 256 use long-form length id with 1-byte length field
-    // if data_len < 65536 use long-form length id with 2-byte length field
-    // if data_len < 16777216 use long-form length id with 3-byte length field
-
-    if (data_len + 1 < 128) {
-        len = 1 + 1 + 1 + data_len;
-    } else if (data_len + 1 < 256) {
-        len = 1 + (1 + 1) + 1 + data_len;
-    } else if (data_len + 1 < (1 << 16)) {
-        len = 1 + (1 + 2) + 1 + data_len;
-    } else if (data_len + 1 < (1 << 24)) {
-        len = 1 + (1 + 3) + 1 + data_len;
-    } else {
-        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        return CKR_FUNCTION_FAILED;
-    }
-    if (length_only == TRUE) {
-        *ber_str_len = len;
-        return CKR_OK;
-    }
-
-    buf = (CK_BYTE *) malloc(len);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-
-    if (data_len + 1 < 128) {
-        buf[0] = 0x03;
-        buf[1] = data_len + 1;
-        buf[2] = unused_bits;
-        if (data && data_len)
-            memcpy(&buf[3], data, data_len);
-        *ber_str_len = len;
-        *ber_str = buf;
-        return CKR_OK;
-    }
+    struct der_element_args e = { 0x03, &unused_bits, 1, data, data_len };
 
-    if (data_len + 1 < 256) {
-        buf[0] = 0x03;
-        buf[1] = 0x81;
-        buf[2] = data_len + 1;
-        buf[3] = unused_bits;
-        if (data && data_len)
-            memcpy(&buf[4], data, data_len);
-        *ber_str_len = len;
-        *ber_str = buf;
-        return CKR_OK;
-    }
-
-    if (data_len + 1 < (1 << 16)) {
-        buf[0] = 0x03;
-        buf[1] = 0x82;
-        buf[2] = ((data_len + 1) >> 8) & 0xFF;
-        buf[3] = ((data_len + 1)) & 0xFF;
-        buf[4] = unused_bits;
-        if (data && data_len)
-            memcpy(&buf[5], data, data_len);
-        *ber_str_len = len;
-        *ber_str = buf;
-        return CKR_OK;
-    }
-
-    if (data_len + 1 < (1 << 24)) {
-        buf[0] = 0x03;
-        buf[1] = 0x83;
-        buf[2] = ((data_len + 1) >> 16) & 0xFF;
-        buf[3] = ((data_len + 1) >> 8) & 0xFF;
-        buf[4] = ((data_len + 1)) & 0xFF;
-        buf[5] = unused_bits;
-        if (data)
-            memcpy(&buf[6], data, data_len);
-        *ber_str_len = len;
-        *ber_str = buf;
-        return CKR_OK;
-    }
-    // we should never reach this
-    //
-    free(buf);
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-
-    return CKR_FUNCTION_FAILED;
+    return der_encode(length_only, ber_str, ber_str_len,
+                      der_encode_element, &e);
 }
 
 /**
@@ -586,89 +565,9 @@ CK_RV ber_encode_SEQUENCE(CK_BBOOL length_only,
                           CK_BYTE **seq,
                           CK_ULONG *seq_len, CK_BYTE *data, CK_ULONG data_len)
 {
-    CK_BYTE *buf = NULL;
-    CK_ULONG len;
-
-    // if data_len < 127 use short-form length id
-    // if data_len < 65536 use long-form length id with 2-byte length field
-    //
-
-    if (data_len < 128) {
-        len = 1 + 1 + data_len;
-    } else if (data_len < 256) {
-        len = 1 + (1 + 1) + data_len;
-    } else if (data_len < (1 << 16)) {
-        len = 1 + (1 + 2) + data_len;
-    } else if (data_len < (1 << 24)) {
-        len = 1 + (1 + 3) + data_len;
-    } else {
-        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        return CKR_FUNCTION_FAILED;
-    }
-    if (length_only == TRUE) {
-        *seq_len = len;
-        return CKR_OK;
-    }
-
-    buf = (CK_BYTE *) malloc(len);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-
-    if (data_len < 128) {
-        buf[0] = 0x30;          // constructed, SEQUENCE
-        buf[1] = data_len;
-        memcpy(&buf[2], data, data_len);
-
-        *seq_len = len;
-        *seq = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < 256) {
-        buf[0] = 0x30;          // constructed, SEQUENCE
-        buf[1] = 0x81;          // length header -- 1 length octets
-        buf[2] = data_len;
-
-        memcpy(&buf[3], data, data_len);
-
-        *seq_len = len;
-        *seq = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < (1 << 16)) {
-        buf[0] = 0x30;          // constructed, SEQUENCE
-        buf[1] = 0x82;          // length header -- 2 length octets
-        buf[2] = (data_len >> 8) & 0xFF;
-        buf[3] = (data_len) & 0xFF;
-
-        memcpy(&buf[4], data, data_len);
-
-        *seq_len = len;
-        *seq = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < (1 << 24)) {
-        buf[0] = 0x30;          // constructed, SEQUENCE
-        buf[1] = 0x83;          // length header -- 3 length octets
-        buf[2] = (data_len >> 16) & 0xFF;
-        buf[3] = (data_len >> 8) & 0xFF;
-        buf[4] = (data_len) & 0xFF;
-
-        memcpy(&buf[5], data, data_len);
-
-        *seq_len = len;
-        *seq = buf;
-        return CKR_OK;
-    }
-
-    free(buf);
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+    struct der_element_args e = { 0x30, NULL, 0, data, data_len };
 
-    return CKR_FUNCTION_FAILED;
+    return der_encode(length_only, seq, seq_len, der_encode_element, &e);
 }
 
 
@@ -748,89 +647,9 @@ CK_RV ber_encode_CHOICE(CK_BBOOL length_only,
                         CK_BYTE **str,
                         CK_ULONG *str_len, CK_BYTE *data, CK_ULONG data_len)
 {
-    CK_BYTE *buf = NULL;
-    CK_ULONG len;
-
-    /*
-     *  if data_len < 127 use short-form length id
-     *  if data_len < 65536 use long-form length id with 2-byte length field
-     */
-
-    if (data_len < 128) {
-        len = 1 + 1 + data_len;
-    } else if (data_len < 256) {
-        len = 1 + (1 + 1) + data_len;
-    } else if (data_len < (1 << 16)) {
-        len = 1 + (1 + 2) + data_len;
-    } else if (data_len < (1 << 24)) {
-        len = 1 + (1 + 3) + data_len;
-    } else {
-        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-        return CKR_FUNCTION_FAILED;
-    }
-    if (length_only == TRUE) {
-        *str_len = len;
-        return CKR_OK;
-    }
-
-    buf = (CK_BYTE *) malloc(len);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-
-    if (data_len < 128) {
-        buf[0] = 0xA0 | option; // constructed, CHOICE
-        buf[1] = data_len;
-        memcpy(&buf[2], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-
-    if (data_len < 256) {
-        buf[0] = 0xA0 | option; // constructed, CHOICE
-        buf[1] = 0x81;          // length header -- 1 length octets
-        buf[2] = data_len;
-
-        memcpy(&buf[3], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
+    struct der_element_args e = { 0xA0 | option, NULL, 0, data, data_len };
 
-    if (data_len < (1 << 16)) {
-        buf[0] = 0xA0 | option; // constructed, CHOICE
-        buf[1] = 0x82;          // length header -- 2 length octets
-        buf[2] = (data_len >> 8) & 0xFF;
-        buf[3] = (data_len) & 0xFF;
-
-        memcpy(&buf[4], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-    if (data_len < (1 << 24)) {
-        buf[0] = 0xA0 | option; // constructed, CHOICE
-        buf[1] = 0x83;          // length header -- 3 length octets
-        buf[2] = (data_len >> 16) & 0xFF;
-        buf[3] = (data_len >> 8) & 0xFF;
-        buf[4] = (data_len) & 0xFF;
-
-        memcpy(&buf[5], data, data_len);
-
-        *str_len = len;
-        *str = buf;
-        return CKR_OK;
-    }
-
-    free(buf);
-    TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-
-    return CKR_FUNCTION_FAILED;
+    return der_encode(length_only, str, str_len, der_encode_element, &e);
 }
 
 // PrivateKeyInfo ::= SEQUENCE {
@@ -907,9 +726,27 @@ CK_RV ber_decode_CHOICE(CK_BYTE *choice,
     return CKR_FUNCTION_FAILED;
 }
 
-// PrivateKeyInfo ::= SEQUENCE {
-//    version  Version  -- always '0' for now
-//    privateKeyAlgorithm PrivateKeyAlgorithmIdentifier
+struct der_private_key_info_args {
+    const CK_BYTE *algorithm_id;
+    CK_ULONG algorithm_id_len;
+    const CK_BYTE *priv_key;
+    CK_ULONG priv_key_len;
+};
+
+static void der_encode_private_key_info(struct der_writer *w,
+                                        const void *args)
+{
+    const struct der_private_key_info_args *a = args;
+    CK_ULONG mark = w->len;
+
+    der_put_data(w, a->priv_key, a->priv_key_len);
+    der_put_private_key_info(w, mark, a->algorithm_id, a->algorithm_id_len,
+                             NULL, 0);
+}
+
+// PrivateKeyInfo ::= SEQUENCE {
+//    version  Version  -- always '0' for now
+//    privateKeyAlgorithm PrivateKeyAlgorithmIdentifier
 //    privateKey  PrivateKey
 //    attributes
 // }
@@ -921,84 +758,17 @@ CK_RV ber_encode_PrivateKeyInfo(CK_BBOOL length_only,
                                 const CK_ULONG algorithm_id_len,
                                 CK_BYTE *priv_key, CK_ULONG priv_key_len)
 {
-    CK_BYTE *buf = NULL;
-    CK_BYTE *tmp = NULL;
-    CK_BYTE version[] = { 0 };
-    CK_ULONG len, total;
+    struct der_private_key_info_args a = {
+        algorithm_id, algorithm_id_len, priv_key, priv_key_len
+    };
     CK_RV rc;
 
-    len = 0;
-
-    rc = ber_encode_INTEGER(TRUE, NULL, &total, version, sizeof(version));
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        return rc;
-    } else {
-        len += total;
-    }
-
-    len += algorithm_id_len;
-
-    rc = ber_encode_OCTET_STRING(TRUE, NULL, &total, priv_key, priv_key_len);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_OCTET_STRING failed\n");
-        return rc;
-    }
-
-    len += total;
-
     // for this stuff, attributes can be suppressed.
     //
-
-    if (length_only == TRUE) {
-        rc = ber_encode_SEQUENCE(TRUE, NULL, &total, NULL, len);
-
-        if (rc == CKR_OK)
-            *data_len = total;
-        if (rc != CKR_OK)
-            TRACE_DEVEL("ber_encode_SEQUENCE failed\n");
-        return rc;
-    }
-
-    buf = (CK_BYTE *) malloc(len);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-    len = 0;
-    rc = ber_encode_INTEGER(FALSE, &tmp, &total, version, sizeof(version));
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (tmp != NULL) {
-        memcpy(buf + len, tmp, total);
-        len += total;
-        free(tmp);
-        tmp = NULL;
-    }
-
-    memcpy(buf + len, algorithm_id, algorithm_id_len);
-    len += algorithm_id_len;
-
-    rc = ber_encode_OCTET_STRING(FALSE, &tmp, &total, priv_key, priv_key_len);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_OCTET_STRING failed\n");
-        goto error;
-    }
-    memcpy(buf + len, tmp, total);
-    len += total;
-    free(tmp);
-    tmp = NULL;
-
-    rc = ber_encode_SEQUENCE(FALSE, data, data_len, buf, len);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_private_key_info, &a);
     if (rc != CKR_OK)
-        TRACE_DEVEL("ber_encode_SEQUENCE failed\n");
-
-error:
-    if (tmp != NULL)
-        free(tmp);
-    free(buf);
+        TRACE_DEVEL("der_encode of PrivateKeyInfo failed\n");
 
     return rc;
 }
@@ -1116,6 +886,39 @@ CK_RV ber_decode_SPKI(CK_BYTE *spki, CK_BYTE **alg_oid, CK_ULONG *alg_oid_len,
 }
 
 
+struct der_rsa_private_key_args {
+    CK_ATTRIBUTE *modulus;
+    CK_ATTRIBUTE *publ_exp;
+    CK_ATTRIBUTE *priv_exp;
+    CK_ATTRIBUTE *prime1;
+    CK_ATTRIBUTE *prime2;
+    CK_ATTRIBUTE *exponent1;
+    CK_ATTRIBUTE *exponent2;
+    CK_ATTRIBUTE *coeff;
+};
+
+static void der_encode_rsa_private_key(struct der_writer *w,
+                                       const void *args)
+{
+    const struct der_rsa_private_key_args *a = args;
+    static const CK_BYTE version[] = { 0 };
+    CK_ULONG mark = w->len;
+
+    der_put_attr_integer(w, a->coeff);
+    der_put_attr_integer(w, a->exponent2);
+    der_put_attr_integer(w, a->exponent1);
+    der_put_attr_integer(w, a->prime2);
+    der_put_attr_integer(w, a->prime1);
+    der_put_attr_integer(w, a->priv_exp);
+    der_put_attr_integer(w, a->publ_exp);
+    der_put_attr_integer(w, a->modulus);
+    der_put_integer(w, version, sizeof(version), FALSE);
+    der_put_constructed(w, 0x30, mark);
+
+    der_put_private_key_info(w, mark, ber_AlgIdRSAEncryption,
+                             ber_AlgIdRSAEncryptionLen, NULL, 0);
+}
+
 // RSAPrivateKey ::= SEQUENCE {
 //    version  Version  -- always '0' for now
 //    modulus  INTEGER
@@ -1140,204 +943,16 @@ CK_RV ber_encode_RSAPrivateKey(CK_BBOOL length_only,
                                CK_ATTRIBUTE *exponent2,
                                CK_ATTRIBUTE *coeff)
 {
-    CK_BYTE *buf = NULL;
-    CK_BYTE *buf2 = NULL;
-    CK_ULONG len, offset;
-    CK_BYTE version[] = { 0 };
+    struct der_rsa_private_key_args a = {
+        modulus, publ_exp, priv_exp, prime1, prime2,
+        exponent1, exponent2, coeff
+    };
     CK_RV rc;
 
-
-    offset = 0;
-    rc = 0;
-
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, sizeof(version));
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, modulus->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, publ_exp->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, priv_exp->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, prime1->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, prime2->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, exponent1->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, exponent2->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, coeff->ulValueLen);
-    offset += len;
-
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        return CKR_FUNCTION_FAILED;
-    }
-    if (length_only == TRUE) {
-        rc = ber_encode_SEQUENCE(TRUE, NULL, &len, NULL, offset);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("ber_encode_SEQUENCE failed\n");
-            return rc;
-        }
-        rc = ber_encode_PrivateKeyInfo(TRUE,
-                                       NULL, data_len,
-                                       NULL, ber_AlgIdRSAEncryptionLen,
-                                       NULL, len);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("ber_encode_PrivateKeyInfo failed\n");
-            return rc;
-        }
-        return rc;
-    }
-
-    buf = (CK_BYTE *) malloc(offset);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-    offset = 0;
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len, version, sizeof(version));
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) modulus + sizeof(CK_ATTRIBUTE),
-                            modulus->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) publ_exp + sizeof(CK_ATTRIBUTE),
-                            publ_exp->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) priv_exp + sizeof(CK_ATTRIBUTE),
-                            priv_exp->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) prime1 + sizeof(CK_ATTRIBUTE),
-                            prime1->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) prime2 + sizeof(CK_ATTRIBUTE),
-                            prime2->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) exponent1 + sizeof(CK_ATTRIBUTE),
-                            exponent1->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) exponent2 + sizeof(CK_ATTRIBUTE),
-                            exponent2->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) coeff + sizeof(CK_ATTRIBUTE),
-                            coeff->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_INTEGER failed\n");
-        goto error;
-    }
-    if (buf2 != NULL) {
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    rc = ber_encode_SEQUENCE(FALSE, &buf2, &len, buf, offset);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_SEQUENCE failed\n");
-        goto error;
-    }
-    rc = ber_encode_PrivateKeyInfo(FALSE,
-                                   data, data_len,
-                                   ber_AlgIdRSAEncryption,
-                                   ber_AlgIdRSAEncryptionLen, buf2, len);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_PrivateKeyInfo failed\n");
-    }
-error:
-    if (buf2)
-        free(buf2);
-    if (buf)
-        free(buf);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_rsa_private_key, &a);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("der_encode of RSAPrivateKey failed\n");
 
     return rc;
 }
@@ -1645,132 +1260,46 @@ cleanup:
     return rc;
 }
 
+struct der_rsa_public_key_args {
+    CK_ATTRIBUTE *modulus;
+    CK_ATTRIBUTE *publ_exp;
+};
+
+static void der_encode_rsa_public_key(struct der_writer *w, const void *args)
+{
+    const struct der_rsa_public_key_args *a = args;
+    CK_ULONG mark = w->len;
+
+    der_put_attr_integer(w, a->publ_exp);
+    der_put_attr_integer(w, a->modulus);
+    der_put_constructed(w, 0x30, mark);
+
+    der_put_spki(w, mark, ber_AlgIdRSAEncryption, ber_AlgIdRSAEncryptionLen,
+                 NULL, 0);
+}
+
 CK_RV ber_encode_RSAPublicKey(CK_BBOOL length_only, CK_BYTE **data,
                               CK_ULONG *data_len, CK_ATTRIBUTE *modulus,
                               CK_ATTRIBUTE *publ_exp)
 {
-    CK_ULONG len = 0, offset, total, total_len;
+    struct der_rsa_public_key_args a = { modulus, publ_exp };
     CK_RV rc;
-    CK_BYTE *buf = NULL;
-    CK_BYTE *buf2 = NULL;
-    CK_BYTE *buf3 = NULL;
-    BerValue *val = NULL;
-    BerElement *ber;
 
-    UNUSED(length_only);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_rsa_public_key, &a);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("%s der_encode failed with rc=0x%lx\n", __func__, rc);
 
-    offset = 0;
-    rc = 0;
-    total_len = ber_AlgIdRSAEncryptionLen;
-    total = 0;
+    return rc;
+}
 
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, modulus->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, publ_exp->ulValueLen);
-    offset += len;
-
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        return rc;
-    }
-
-    buf = (CK_BYTE *) malloc(offset);
-    if (!buf) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        return CKR_HOST_MEMORY;
-    }
-    offset = 0;
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) modulus + sizeof(CK_ATTRIBUTE),
-                            modulus->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        free(buf);
-        return rc;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len,
-                            (CK_BYTE *) publ_exp + sizeof(CK_ATTRIBUTE),
-                            publ_exp->ulValueLen);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        free(buf);
-        return rc;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-
-    rc = ber_encode_SEQUENCE(FALSE, &buf2, &len, buf, offset);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("%s ber_encode_Seq failed with rc=0x%lx\n", __func__, rc);
-        free(buf);
-        return rc;
-    }
-    free(buf);
-
-    /* length of outer sequence */
-    rc = ber_encode_OCTET_STRING(TRUE, NULL, &total, buf2, len);
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("%s ber_encode_Oct_Str failed with rc=0x%lx\n", __func__,
-                    rc);
-        free(buf2);
-        return rc;
-    } else {
-        total_len += total + 1;
-    }
-
-    /* mem for outer sequence */
-    buf3 = (CK_BYTE *) malloc(total_len);
-    if (!buf3) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        free(buf2);
-        return CKR_HOST_MEMORY;
-    }
-    total_len = 0;
-
-    /* copy alg id */
-    memcpy(buf3 + total_len, ber_AlgIdRSAEncryption, ber_AlgIdRSAEncryptionLen);
-    total_len += ber_AlgIdRSAEncryptionLen;
-
-    /* need a bitstring */
-    ber = ber_alloc_t(LBER_USE_DER);
-    rc = (ber_put_bitstring(ber, (char *)buf2, len * 8, 0x03) <= 0 ? 1 : 0);
-    rc |= ber_flatten(ber, &val);
-    if (rc != 0) {
-        TRACE_DEVEL("%s ber_alloc_t/ber_flatten failed \n", __func__);
-        rc = CKR_FUNCTION_FAILED;
-        ber_free(ber, 1);
-        ber_bvfree(val);
-        free(buf2);
-        goto out;
-    }
-    memcpy(buf3 + total_len, val->bv_val, val->bv_len);
-    total_len += val->bv_len;
-    ber_free(ber, 1);
-    ber_bvfree(val);
-    free(buf2);
-
-    rc = ber_encode_SEQUENCE(FALSE, data, data_len, buf3, total_len);
-    if (rc != CKR_OK)
-        TRACE_DEVEL("%s ber_encode_Seq failed with rc=0x%lx\n", __func__, rc);
-
-out:
-    free(buf3);
-    return rc;
-}
-
-CK_RV ber_decode_RSAPublicKey(CK_BYTE *data,
-                              CK_ULONG data_len,
-                              CK_ATTRIBUTE **modulus,
-                              CK_ATTRIBUTE **publ_exp)
-{
-    CK_ATTRIBUTE *modulus_attr = NULL;
-    CK_ATTRIBUTE *publ_exp_attr = NULL;
+CK_RV ber_decode_RSAPublicKey(CK_BYTE *data,
+                              CK_ULONG data_len,
+                              CK_ATTRIBUTE **modulus,
+                              CK_ATTRIBUTE **publ_exp)
+{
+    CK_ATTRIBUTE *modulus_attr = NULL;
+    CK_ATTRIBUTE *publ_exp_attr = NULL;
 
     CK_BYTE *algid_RSABase = NULL;
     CK_BYTE *algid = NULL;
@@ -3626,6 +3155,26 @@ cleanup:
     return rc;
 }
 
+struct der_dilithium_public_key_args {
+    const CK_BYTE *oid;
+    CK_ULONG oid_len;
+    CK_ATTRIBUTE *rho;
+    CK_ATTRIBUTE *t1;
+};
+
+static void der_encode_dilithium_public_key(struct der_writer *w,
+                                            const void *args)
+{
+    const struct der_dilithium_public_key_args *a = args;
+    CK_ULONG mark = w->len;
+
+    der_put_attr_bit_string(w, a->t1);
+    der_put_attr_bit_string(w, a->rho);
+    der_put_constructed(w, 0x30, mark);
+
+    der_put_spki(w, mark, NULL, 0, a->oid, a->oid_len);
+}
+
 /**
  * An IBM Dilithium public key is given by:
  *
@@ -3643,158 +3192,13 @@ CK_RV ber_encode_IBM_DilithiumPublicKey(CK_BBOOL length_only,
                                         const CK_BYTE *oid, CK_ULONG oid_len,
                                         CK_ATTRIBUTE *rho, CK_ATTRIBUTE *t1)
 {
-    CK_BYTE *buf = NULL, *buf2 = NULL, *buf3 = NULL, *buf4 = NULL;
-    CK_BYTE *buf5 = NULL, *algid = NULL;
-    CK_ULONG len = 0, len4, offset, total, total_len, algid_len;
+    struct der_dilithium_public_key_args a = { oid, oid_len, rho, t1 };
     CK_RV rc;
 
-    UNUSED(length_only);
-
-    offset = 0;
-    rc = 0;
-    total_len = 0;
-    total = 0;
-
-    /* Calculate storage for AlgID sequence */
-    rc |= ber_encode_SEQUENCE(TRUE, NULL, &total_len, NULL,
-                              oid_len + ber_NULLLen);
-
-    /* Calculate storage for inner sequence */
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, rho->ulValueLen);
-    offset += len;
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, t1->ulValueLen);
-    offset += len;
-
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        return rc;
-    }
-
-    /* Allocate storage for inner sequence */
-    buf = (CK_BYTE *) malloc(offset);
-    if (!buf) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        return CKR_HOST_MEMORY;
-    }
-
-    /**
-     *    SEQUENCE (2 elem)
-     *       BIT STRING -> rho
-     *       BIT STRING -> t
-     */
-    offset = 0;
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               rho->pValue, rho->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               t1->pValue, t1->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    rc = ber_encode_SEQUENCE(FALSE, &buf2, &len, buf, offset);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Seq failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    free(buf);
-    buf = NULL;
-
-    /* Calculate length of outer sequence */
-    rc = ber_encode_BIT_STRING(TRUE, NULL, &total, buf2, len, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Oct_Str failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    } else {
-        total_len += total;
-    }
-
-    /* Allocate storage for outer sequence and bit string */
-    buf3 = (CK_BYTE *) malloc(total_len);
-    if (!buf3) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        rc = CKR_HOST_MEMORY;
-        goto error;
-    }
-
-    /*
-     * SEQUENCE (2 elem)
-     *      OBJECT IDENTIFIER 1.3.6.1.4.1.2.267.xxx
-     *      NULL  <- no parms for this oid
-     */
-    buf5 = (CK_BYTE *) malloc(oid_len + ber_NULLLen);
-    if (!buf5) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        rc = CKR_HOST_MEMORY;
-        goto error;
-    }
-    memcpy(buf5, oid, oid_len);
-    memcpy(buf5 + oid_len, ber_NULL, ber_NULLLen);
-
-    rc = ber_encode_SEQUENCE(FALSE, &algid, &algid_len, buf5,
-                             oid_len + ber_NULLLen);
-    free(buf5);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_SEQUENCE failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-
-    total_len = algid_len;
-    memcpy(buf3, algid, algid_len);
-    free(algid);
-    algid = NULL;
-
-    /*
-     * BIT STRING (1 elem)
-     *       SEQUENCE (2 elem)
-     *          BIT STRING  -> rho
-     *          BIT STRING  -> t1
-     */
-    rc = ber_encode_BIT_STRING(FALSE, &buf4, &len4, buf2, len, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_BIT_STRING failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    memcpy(buf3 + total_len, buf4, len4);
-    total_len += len4;
-    free(buf4);
-    buf4 = NULL;
-
-    /**
-     * SEQUENCE (2 elem)
-     *    SEQUENCE (2 elem)
-     *       OBJECT IDENTIFIER 1.3.6.1.4.1.2.267.1.6.5
-     *       NULL -> no parms for this oid
-     *    BIT STRING (1 elem)
-     *       SEQUENCE (2 elem)
-     *          BIT STRING  -> rho
-     *          BIT STRING  -> t1
-     */
-    rc = ber_encode_SEQUENCE(FALSE, data, data_len, buf3, total_len);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_dilithium_public_key, &a);
     if (rc != CKR_OK)
-        TRACE_ERROR("%s ber_encode_Seq failed with rc=0x%lx\n", __func__, rc);
-
-error:
-
-    if (buf)
-        free(buf);
-    if (buf2)
-        free(buf2);
-    if (buf3)
-        free(buf3);
+        TRACE_ERROR("%s der_encode failed with rc=0x%lx\n", __func__, rc);
 
     return rc;
 }
@@ -3914,6 +3318,44 @@ cleanup:
     return rc;
 }
 
+struct der_dilithium_private_key_args {
+    const CK_BYTE *oid;
+    CK_ULONG oid_len;
+    CK_ATTRIBUTE *rho;
+    CK_ATTRIBUTE *seed;
+    CK_ATTRIBUTE *tr;
+    CK_ATTRIBUTE *s1;
+    CK_ATTRIBUTE *s2;
+    CK_ATTRIBUTE *t0;
+    CK_ATTRIBUTE *t1;
+};
+
+static void der_encode_dilithium_private_key(struct der_writer *w,
+                                             const void *args)
+{
+    const struct der_dilithium_private_key_args *a = args;
+    static const CK_BYTE version[] = { 0 };
+    CK_ULONG mark = w->len, t1_mark;
+
+    /* (t1) Optional bit-string of public key */
+    if (a->t1 && a->t1->pValue) {
+        t1_mark = w->len;
+        der_put_attr_bit_string(w, a->t1);
+        der_put_constructed(w, 0xA0, t1_mark);
+    }
+
+    der_put_attr_bit_string(w, a->t0);
+    der_put_attr_bit_string(w, a->s2);
+    der_put_attr_bit_string(w, a->s1);
+    der_put_attr_bit_string(w, a->tr);
+    der_put_attr_bit_string(w, a->seed);
+    der_put_attr_bit_string(w, a->rho);
+    der_put_integer(w, version, sizeof(version), FALSE);
+    der_put_constructed(w, 0x30, mark);
+
+    der_put_private_key_info(w, mark, NULL, 0, a->oid, a->oid_len);
+}
+
 /**
  * An IBM Dilithium private key is given by:
  *
@@ -3942,207 +3384,15 @@ CK_RV ber_encode_IBM_DilithiumPrivateKey(CK_BBOOL length_only,
                                          CK_ATTRIBUTE *t0,
                                          CK_ATTRIBUTE *t1)
 {
-    CK_BYTE *buf = NULL, *buf2 = NULL, *buf3 = NULL;
-    CK_BYTE *algid = NULL, *algid_buf = NULL;
-    CK_ULONG len, len2 = 0, offset, algid_len = 0;
-    CK_BYTE version[] = { 0 };
+    struct der_dilithium_private_key_args a = {
+        oid, oid_len, rho, seed, tr, s1, s2, t0, t1
+    };
     CK_RV rc;
 
-    /* Calculate storage for sequence */
-    offset = 0;
-    rc = 0;
-
-    rc |= ber_encode_SEQUENCE(TRUE, NULL, &algid_len, NULL,
-                              oid_len + ber_NULLLen);
-
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, sizeof(version));
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, rho->ulValueLen, 0);
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, seed->ulValueLen, 0);
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, tr->ulValueLen, 0);
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, s1->ulValueLen, 0);
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, s2->ulValueLen, 0);
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, t0->ulValueLen, 0);
-    offset += len;
-    if (t1) {
-        rc |= ber_encode_BIT_STRING(TRUE, NULL, &len2, NULL, t1->ulValueLen, 0);
-        rc |= ber_encode_CHOICE(TRUE, 0, NULL, &len, NULL, len2);
-        offset += len;
-    }
-
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("Calculate storage for sequence failed\n");
-        return CKR_FUNCTION_FAILED;
-    }
-
-    if (length_only == TRUE) {
-        rc = ber_encode_SEQUENCE(TRUE, NULL, &len, NULL, offset);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("ber_encode_SEQUENCE failed\n");
-            return rc;
-        }
-        rc = ber_encode_PrivateKeyInfo(TRUE,
-                                       NULL, data_len,
-                                       NULL, algid_len,
-                                       NULL, len);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("ber_encode_PrivateKeyInfo failed\n");
-            return rc;
-        }
-        return rc;
-    }
-
-    /* Allocate storage for sequence */
-    buf = (CK_BYTE *) malloc(offset);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-    offset = 0;
-
-    /* Version */
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len, version, sizeof(version));
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_INTEGER of version failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* rho */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                            rho->pValue, rho->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of rho failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* seed */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                            seed->pValue, seed->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of seed failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* tr */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               tr->pValue, tr->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of (tr) failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* s1 */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               s1->pValue, s1->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of (s1) failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* s2 */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               s2->pValue, s2->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of (s2) failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* t0 */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               t0->pValue, t0->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of (t0) failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* (t1) Optional bit-string of public key */
-    if (t1 && t1->pValue) {
-        rc = ber_encode_BIT_STRING(FALSE, &buf3, &len2, t1->pValue, t1->ulValueLen, 0);
-        rc |= ber_encode_CHOICE(FALSE, 0, &buf2, &len, buf3, len2);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("encoding of t1 value failed\n");
-            goto error;
-        }
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    /* Encode sequence */
-    rc = ber_encode_SEQUENCE(FALSE, &buf2, &len, buf, offset);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_SEQUENCE failed\n");
-        goto error;
-    }
-
-    algid_buf = (CK_BYTE *) malloc(oid_len + ber_NULLLen);
-    if (!algid_buf) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        rc = CKR_HOST_MEMORY;
-        goto error;
-    }
-    memcpy(algid_buf, oid, oid_len);
-    memcpy(algid_buf + oid_len, ber_NULL, ber_NULLLen);
-
-    rc = ber_encode_SEQUENCE(FALSE, &algid, &algid_len, algid_buf,
-                             oid_len + ber_NULLLen);
-    free(algid_buf);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_SEQUENCE failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-
-    rc = ber_encode_PrivateKeyInfo(FALSE,
-                                   data, data_len,
-                                   algid, algid_len,
-                                   buf2, len);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_PrivateKeyInfo failed\n");
-    }
-
-error:
-    if (buf3)
-        free(buf3);
-    if (buf2)
-        free(buf2);
-    if (buf)
-        free(buf);
-    if (algid)
-        free(algid);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_dilithium_private_key, &a);
+    if (rc != CKR_OK)
+        TRACE_ERROR("der_encode of DilithiumPrivateKey failed\n");
 
     return rc;
 }
@@ -4401,6 +3651,24 @@ cleanup:
     return rc;
 }
 
+struct der_kyber_public_key_args {
+    const CK_BYTE *oid;
+    CK_ULONG oid_len;
+    CK_ATTRIBUTE *pk;
+};
+
+static void der_encode_kyber_public_key(struct der_writer *w,
+                                        const void *args)
+{
+    const struct der_kyber_public_key_args *a = args;
+    CK_ULONG mark = w->len;
+
+    der_put_attr_bit_string(w, a->pk);
+    der_put_constructed(w, 0x30, mark);
+
+    der_put_spki(w, mark, NULL, 0, a->oid, a->oid_len);
+}
+
 /**
  * An IBM Kyber public key is given by:
  *
@@ -4417,142 +3685,13 @@ CK_RV ber_encode_IBM_KyberPublicKey(CK_BBOOL length_only,
                                     const CK_BYTE *oid, CK_ULONG oid_len,
                                     CK_ATTRIBUTE *pk)
 {
-    CK_BYTE *buf = NULL, *buf2 = NULL, *buf3 = NULL, *buf4 = NULL;
-    CK_BYTE *buf5 = NULL, *algid = NULL;
-    CK_ULONG len, len4, offset, total, total_len, algid_len;
+    struct der_kyber_public_key_args a = { oid, oid_len, pk };
     CK_RV rc;
 
-    UNUSED(length_only);
-
-    offset = 0;
-    rc = 0;
-    total_len = 0;
-    total = 0;
-
-    /* Calculate storage for AlgID sequence */
-    rc |= ber_encode_SEQUENCE(TRUE, NULL, &total_len, NULL,
-                              oid_len + ber_NULLLen);
-
-    /* Calculate storage for inner sequence */
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, pk->ulValueLen);
-    offset += len;
-
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        return rc;
-    }
-
-    /* Allocate storage for inner sequence */
-    buf = (CK_BYTE *) malloc(offset);
-    if (!buf) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        return CKR_HOST_MEMORY;
-    }
-
-    /**
-     *    SEQUENCE (1 elem)
-     *       BIT STRING -> pk
-     */
-    offset = 0;
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                               pk->pValue, pk->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Int failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    rc = ber_encode_SEQUENCE(FALSE, &buf2, &len, buf, offset);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Seq failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    free(buf);
-    buf = NULL;
-
-    /* Calculate length of outer sequence */
-    rc = ber_encode_BIT_STRING(TRUE, NULL, &total, buf2, len, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_Oct_Str failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    } else {
-        total_len += total;
-    }
-
-    /* Allocate storage for outer sequence and bit string */
-    buf3 = (CK_BYTE *) malloc(total_len);
-    if (!buf3) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        rc = CKR_HOST_MEMORY;
-        goto error;
-    }
-
-    /*
-     * SEQUENCE (2 elem)
-     *      OBJECT IDENTIFIER 1.3.6.1.4.1.2.267.5.xxx
-     *      NULL  <- no parms for this oid
-     */
-    buf5 = (CK_BYTE *) malloc(oid_len + ber_NULLLen);
-    if (!buf5) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        rc = CKR_HOST_MEMORY;
-        goto error;
-    }
-    memcpy(buf5, oid, oid_len);
-    memcpy(buf5 + oid_len, ber_NULL, ber_NULLLen);
-
-    rc = ber_encode_SEQUENCE(FALSE, &algid, &algid_len, buf5,
-                             oid_len + ber_NULLLen);
-    free(buf5);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_SEQUENCE failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-
-    total_len = algid_len;
-    memcpy(buf3, algid, algid_len);
-    free(algid);
-    algid = NULL;
-
-    /*
-     * BIT STRING (1 elem)
-     *       SEQUENCE (1 elem)
-     *          BIT STRING  -> pk
-     */
-    rc = ber_encode_BIT_STRING(FALSE, &buf4, &len4, buf2, len, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_BIT_STRING failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-    memcpy(buf3 + total_len, buf4, len4);
-    total_len += len4;
-    free(buf4);
-    buf4 = NULL;
-
-    /**
-     * SEQUENCE (2 elem)
-     *    SEQUENCE (2 elem)
-     *       OBJECT IDENTIFIER 1.3.6.1.4.1.2.267.5.xxx
-     *       NULL -> no parms for this oid
-     *    BIT STRING (1 elem)
-     *       SEQUENCE (2 elem)
-     *          BIT STRING  -> pk
-     */
-    rc = ber_encode_SEQUENCE(FALSE, data, data_len, buf3, total_len);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_kyber_public_key, &a);
     if (rc != CKR_OK)
-        TRACE_ERROR("%s ber_encode_Seq failed with rc=0x%lx\n", __func__, rc);
-
-error:
-
-    if (buf)
-        free(buf);
-    if (buf2)
-        free(buf2);
-    if (buf3)
-        free(buf3);
+        TRACE_ERROR("%s der_encode failed with rc=0x%lx\n", __func__, rc);
 
     return rc;
 }
@@ -4646,6 +3785,40 @@ cleanup:
     return rc;
 }
 
+struct der_kyber_private_key_args {
+    const CK_BYTE *oid;
+    CK_ULONG oid_len;
+    CK_ATTRIBUTE *sk;
+    CK_ATTRIBUTE *pk;
+};
+
+static void der_encode_kyber_private_key(struct der_writer *w,
+                                         const void *args)
+{
+    const struct der_kyber_private_key_args *a = args;
+    static const CK_BYTE version[] = { 0 };
+    static const CK_BYTE unused_bits[] = { 0 };
+    CK_BYTE rs[64];
+    CK_ULONG mark = w->len, pk_mark;
+
+    /* (pk) Optional bit-string of public key, with rs appended */
+    if (a->pk && a->pk->pValue) {
+        memset(rs, 0x30, sizeof(rs));
+        pk_mark = w->len;
+        der_put_data(w, rs, sizeof(rs));
+        der_put_data(w, a->pk->pValue, a->pk->ulValueLen);
+        der_put_data(w, unused_bits, sizeof(unused_bits));
+        der_put_constructed(w, 0x03, pk_mark);
+        der_put_constructed(w, 0xA0, pk_mark);
+    }
+
+    der_put_attr_bit_string(w, a->sk);
+    der_put_integer(w, version, sizeof(version), FALSE);
+    der_put_constructed(w, 0x30, mark);
+
+    der_put_private_key_info(w, mark, NULL, 0, a->oid, a->oid_len);
+}
+
 /**
  * An IBM Kyber private key is given by:
  *
@@ -4664,152 +3837,13 @@ CK_RV ber_encode_IBM_KyberPrivateKey(CK_BBOOL length_only,
                                      CK_ATTRIBUTE *sk,
                                      CK_ATTRIBUTE *pk)
 {
-    CK_BYTE *buf = NULL, *buf2 = NULL, *buf3 = NULL;
-    CK_BYTE *algid = NULL, *algid_buf = NULL, *pk_rs = NULL;
-    CK_ULONG len, len2 = 0, offset, algid_len = 0;
-    CK_BYTE version[] = { 0 };
+    struct der_kyber_private_key_args a = { oid, oid_len, sk, pk };
     CK_RV rc;
 
-    /* Calculate storage for sequence */
-    offset = 0;
-    rc = 0;
-
-    rc |= ber_encode_SEQUENCE(TRUE, NULL, &algid_len, NULL,
-                              oid_len + ber_NULLLen);
-
-    rc |= ber_encode_INTEGER(TRUE, NULL, &len, NULL, sizeof(version));
-    offset += len;
-    rc |= ber_encode_BIT_STRING(TRUE, NULL, &len, NULL, sk->ulValueLen, 0);
-    offset += len;
-    if (pk) {
-        rc |= ber_encode_BIT_STRING(TRUE, NULL, &len2, NULL,
-                                    pk->ulValueLen + 64, 0);
-        rc |= ber_encode_CHOICE(TRUE, 0, NULL, &len, NULL, len2);
-        offset += len;
-    }
-
-    if (rc != CKR_OK) {
-        TRACE_DEVEL("Calculate storage for sequence failed\n");
-        return CKR_FUNCTION_FAILED;
-    }
-
-    if (length_only == TRUE) {
-        rc = ber_encode_SEQUENCE(TRUE, NULL, &len, NULL, offset);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("ber_encode_SEQUENCE failed\n");
-            return rc;
-        }
-        rc = ber_encode_PrivateKeyInfo(TRUE,
-                                       NULL, data_len,
-                                       NULL, algid_len,
-                                       NULL, len);
-        if (rc != CKR_OK) {
-            TRACE_DEVEL("ber_encode_PrivateKeyInfo failed\n");
-            return rc;
-        }
-        return rc;
-    }
-
-    /* Allocate storage for sequence */
-    buf = (CK_BYTE *) malloc(offset);
-    if (!buf) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        return CKR_HOST_MEMORY;
-    }
-    offset = 0;
-
-    /* Version */
-    rc = ber_encode_INTEGER(FALSE, &buf2, &len, version, sizeof(version));
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_INTEGER of version failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* sk */
-    rc = ber_encode_BIT_STRING(FALSE, &buf2, &len,
-                            sk->pValue, sk->ulValueLen, 0);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_BIT_STRING of sk failed\n");
-        goto error;
-    }
-    memcpy(buf + offset, buf2, len);
-    offset += len;
-    free(buf2);
-    buf2 = NULL;
-
-    /* (pk) Optional bit-string of public key */
-    if (pk && pk->pValue) {
-        /* append rs to public key */
-        pk_rs = (CK_BYTE *)malloc(pk->ulValueLen + 64);
-        if (!pk_rs) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            rc = CKR_HOST_MEMORY;
-            goto error;
-        }
-
-        memcpy(pk_rs, pk->pValue, pk->ulValueLen);
-        memset(pk_rs + pk->ulValueLen, 0x30, 64);
-
-        rc = ber_encode_BIT_STRING(FALSE, &buf3, &len2,
-                                   pk_rs, pk->ulValueLen + 64, 0);
-        rc |= ber_encode_CHOICE(FALSE, 0, &buf2, &len, buf3, len2);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("encoding of pk value failed\n");
-            goto error;
-        }
-        memcpy(buf + offset, buf2, len);
-        offset += len;
-        free(buf2);
-        buf2 = NULL;
-    }
-
-    /* Encode sequence */
-    rc = ber_encode_SEQUENCE(FALSE, &buf2, &len, buf, offset);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_SEQUENCE failed\n");
-        goto error;
-    }
-
-    algid_buf = (CK_BYTE *) malloc(oid_len + ber_NULLLen);
-    if (!algid_buf) {
-        TRACE_ERROR("%s Memory allocation failed\n", __func__);
-        rc = CKR_HOST_MEMORY;
-        goto error;
-    }
-    memcpy(algid_buf, oid, oid_len);
-    memcpy(algid_buf + oid_len, ber_NULL, ber_NULLLen);
-
-    rc = ber_encode_SEQUENCE(FALSE, &algid, &algid_len, algid_buf,
-                             oid_len + ber_NULLLen);
-    free(algid_buf);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s ber_encode_SEQUENCE failed with rc=0x%lx\n", __func__, rc);
-        goto error;
-    }
-
-    rc = ber_encode_PrivateKeyInfo(FALSE,
-                                   data, data_len,
-                                   algid, algid_len,
-                                   buf2, len);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_PrivateKeyInfo failed\n");
-    }
-
-error:
-    if (buf3)
-        free(buf3);
-    if (buf2)
-        free(buf2);
-    if (buf)
-        free(buf);
-    if (algid)
-        free(algid);
-    if (pk_rs)
-        free(pk_rs);
+    rc = der_encode(length_only, data, data_len,
+                    der_encode_kyber_private_key, &a);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("der_encode of KyberPrivateKey failed\n");
 
     return rc;
 }
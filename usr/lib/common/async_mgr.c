@@ -0,0 +1,212 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  async_mgr.c
+//
+// Executor for asynchronous requests (ST_IBM_AsyncSubmit). Jobs are queued
+// in submission order and processed by a pool of worker threads, which is
+// started on demand up to tokdata->async_threads threads. A token with
+// async_threads set to 0 processes every job synchronously when it is
+// submitted.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <openssl/crypto.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+
+CK_RV async_mgr_init(STDLL_TokData_t *tokdata)
+{
+    struct async_executor *exec = &tokdata->async_exec;
+
+    memset(exec, 0, sizeof(*exec));
+    list_init(&exec->jobs);
+
+    if (pthread_mutex_init(&exec->mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing the async executor mutex failed.\n");
+        return CKR_CANT_LOCK;
+    }
+    if (pthread_cond_init(&exec->cond, NULL) != 0) {
+        TRACE_ERROR("Initializing the async executor condition failed.\n");
+        pthread_mutex_destroy(&exec->mutex);
+        return CKR_CANT_LOCK;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Runs a job in a worker thread. The HSM master key change lock is taken
+ * like the API layer does it for synchronous calls.
+ */
+static void async_mgr_run(STDLL_TokData_t *tokdata, struct async_job *job)
+{
+    if (tokdata->hsm_mk_change_supported &&
+        pthread_rwlock_rdlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+        TRACE_DEVEL("HSM-MK-change Read-Lock failed.\n");
+        job->rc = CKR_CANT_LOCK;
+        return;
+    }
+
+    job->rc = job->run(tokdata, job);
+
+    if (tokdata->hsm_mk_change_supported &&
+        pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+        TRACE_DEVEL("HSM-MK-change Unlock failed.\n");
+        if (job->rc == CKR_OK)
+            job->rc = CKR_CANT_LOCK;
+    }
+}
+
+static void *async_mgr_worker(void *arg)
+{
+    STDLL_TokData_t *tokdata = arg;
+    struct async_executor *exec = &tokdata->async_exec;
+    struct async_job *job;
+    CK_BBOOL cancel;
+
+    pthread_mutex_lock(&exec->mutex);
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX_set0_default(exec->libctx);
+#endif
+    while (1) {
+        while (list_is_empty(&exec->jobs) && !exec->terminate) {
+            exec->idle_threads++;
+            pthread_cond_wait(&exec->cond, &exec->mutex);
+            exec->idle_threads--;
+        }
+        if (list_is_empty(&exec->jobs))
+            break;
+
+        job = container_of(exec->jobs.head, struct async_job, entry);
+        list_remove(&job->entry);
+        exec->num_jobs--;
+        /* Jobs not yet started when the token is finalized are cancelled */
+        cancel = exec->terminate;
+        pthread_mutex_unlock(&exec->mutex);
+
+        if (cancel)
+            job->rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        else
+            async_mgr_run(tokdata, job);
+        job->done(tokdata, job, TRUE);
+
+        pthread_mutex_lock(&exec->mutex);
+    }
+    pthread_mutex_unlock(&exec->mutex);
+
+    return NULL;
+}
+
+/*
+ * Submits a job. On success, job->done() is called exactly once, possibly
+ * before this function returns. On error, the job is not touched.
+ */
+CK_RV async_mgr_submit(STDLL_TokData_t *tokdata, struct async_job *job)
+{
+    struct async_executor *exec = &tokdata->async_exec;
+
+    if (tokdata->async_threads == 0) {
+        /* The caller already holds the HSM master key change lock */
+        job->rc = job->run(tokdata, job);
+        job->done(tokdata, job, TRUE);
+        return CKR_OK;
+    }
+
+    if (pthread_mutex_lock(&exec->mutex) != 0) {
+        TRACE_ERROR("Locking the async executor failed.\n");
+        return CKR_CANT_LOCK;
+    }
+
+    if (exec->terminate) {
+        pthread_mutex_unlock(&exec->mutex);
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    /* Worker threads use the library context of the submitting thread */
+    exec->libctx = OSSL_LIB_CTX_set0_default(NULL);
+#endif
+
+    list_insert_tail(&exec->jobs, &job->entry);
+    exec->num_jobs++;
+
+    if (exec->num_jobs > exec->idle_threads &&
+        exec->num_threads < tokdata->async_threads) {
+        if (exec->threads == NULL)
+            exec->threads = calloc(tokdata->async_threads, sizeof(pthread_t));
+        if (exec->threads == NULL ||
+            pthread_create(&exec->threads[exec->num_threads], NULL,
+                           async_mgr_worker, tokdata) != 0)
+            TRACE_DEVEL("Starting an async worker thread failed.\n");
+        else
+            exec->num_threads++;
+    }
+
+    if (exec->num_threads == 0) {
+        list_remove(&job->entry);
+        exec->num_jobs--;
+        pthread_mutex_unlock(&exec->mutex);
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    pthread_cond_signal(&exec->cond);
+    pthread_mutex_unlock(&exec->mutex);
+
+    return CKR_OK;
+}
+
+/*
+ * Stops the worker threads. Jobs that are still queued are completed with
+ * CKR_CRYPTOKI_NOT_INITIALIZED. In a forked child the worker threads do not
+ * exist, and the queued jobs are released without notifying the submitter.
+ */
+void async_mgr_final(STDLL_TokData_t *tokdata, CK_BBOOL in_fork_initializer)
+{
+    struct async_executor *exec = &tokdata->async_exec;
+    struct async_job *job;
+    list_entry_t *next;
+    CK_ULONG i;
+
+    if (in_fork_initializer) {
+        for_each_list_entry_safe(&exec->jobs, struct async_job, job, entry,
+                                 next) {
+            list_remove(&job->entry);
+            job->done(tokdata, job, FALSE);
+        }
+        free(exec->threads);
+        memset(exec, 0, sizeof(*exec));
+        return;
+    }
+
+    pthread_mutex_lock(&exec->mutex);
+    exec->terminate = TRUE;
+    pthread_cond_broadcast(&exec->cond);
+    pthread_mutex_unlock(&exec->mutex);
+
+    for (i = 0; i < exec->num_threads; i++)
+        pthread_join(exec->threads[i], NULL);
+
+    free(exec->threads);
+    exec->threads = NULL;
+    exec->num_threads = 0;
+
+    pthread_cond_destroy(&exec->cond);
+    pthread_mutex_destroy(&exec->mutex);
+}
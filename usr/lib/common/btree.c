@@ -21,6 +21,7 @@
 #include <malloc.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pkcs11types.h"
 #include "local_types.h"
 #include "trace.h"
@@ -28,6 +29,232 @@
 #define GET_NODE_HANDLE(n) get_node_handle(n, 1)
 #define TREE_DUMP(t)  tree_dump((t)->top, 0)
 
+/*
+ * Epoch based reclamation
+ *
+ * For trees initialized with bt_init_epoch(), bt_get_node_value() neither
+ * takes the tree mutex nor increases the value's reference counter. The
+ * calling thread enters an epoch instead, and records the value in its own
+ * epoch record, so that a lookup does not write to memory shared with other
+ * threads. bt_put_node_value() removes the value from the thread's record
+ * and leaves the epoch.
+ *
+ * When the reference counter of a value drops to zero, the value is retired
+ * with the current global epoch, and the global epoch is advanced. A retired
+ * value is deleted once no thread is in an epoch that started before the
+ * value was retired.
+ *
+ * A value obtained from an epoch tree must be put by the thread that got
+ * it. A thread holding more than BT_EPOCH_MAX_HELD values gets references
+ * counted in the value instead. So a put of a value that is not recorded for
+ * the calling thread always drops a counted reference: the one taken by
+ * bt_node_add(), or one taken by a lookup that could not be recorded.
+ *
+ * Lookups read the tree size, the node pointers, and the value and flags of
+ * a node without the tree mutex, so these are accessed with atomic builtins
+ * everywhere. The free list is chained through free_next, the value of a
+ * free node is NULL.
+ */
+#define BT_EPOCH_MAX_HELD       16
+#define BT_EPOCH_REC_ALIGN      256     /* at least one cache line */
+
+struct bt_epoch_rec {
+    unsigned long epoch;            /* global epoch at entry, 0 if inactive */
+    unsigned long nesting;
+    unsigned long num_held;
+    void *held[BT_EPOCH_MAX_HELD];
+    struct bt_epoch_rec *next;
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    struct bt_epoch_rec *recs;
+    unsigned long epoch;
+    struct bt_ref_hdr *retired;
+    unsigned long num_retired;
+    pthread_key_t key;
+    int key_created;
+} bt_epoch = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .epoch = 1,
+};
+
+static pthread_once_t bt_epoch_once = PTHREAD_ONCE_INIT;
+static __thread struct bt_epoch_rec *bt_epoch_self = NULL;
+
+static void bt_epoch_thread_exit(void *arg)
+{
+    struct bt_epoch_rec *rec = arg, **prev;
+
+    pthread_mutex_lock(&bt_epoch.mutex);
+    for (prev = &bt_epoch.recs; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == rec) {
+            *prev = rec->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&bt_epoch.mutex);
+
+    free(rec);
+}
+
+/* In a forked child only the forking thread exists */
+static void bt_epoch_atfork_child(void)
+{
+    struct bt_epoch_rec *rec;
+
+    pthread_mutex_init(&bt_epoch.mutex, NULL);
+    for (rec = bt_epoch.recs; rec != NULL; rec = rec->next) {
+        if (rec != bt_epoch_self)
+            rec->epoch = 0;
+    }
+}
+
+static void bt_epoch_init_once(void)
+{
+    if (pthread_key_create(&bt_epoch.key, bt_epoch_thread_exit) == 0)
+        bt_epoch.key_created = 1;
+    pthread_atfork(NULL, NULL, bt_epoch_atfork_child);
+}
+
+static void bt_epoch_fini(void) __attribute__ ((destructor));
+static void bt_epoch_fini(void)
+{
+    /* Do not call the destructor of this library after it is unloaded */
+    if (bt_epoch.key_created)
+        pthread_key_delete(bt_epoch.key);
+}
+
+/* Returns the calling thread's epoch record, or NULL */
+static struct bt_epoch_rec *bt_epoch_get_rec(void)
+{
+    struct bt_epoch_rec *rec;
+    size_t size;
+
+    if (bt_epoch_self != NULL)
+        return bt_epoch_self;
+
+    pthread_once(&bt_epoch_once, bt_epoch_init_once);
+    if (!bt_epoch.key_created)
+        return NULL;
+
+    size = (sizeof(*rec) + BT_EPOCH_REC_ALIGN - 1) & ~(BT_EPOCH_REC_ALIGN - 1);
+    if (posix_memalign((void **)&rec, BT_EPOCH_REC_ALIGN, size) != 0)
+        return NULL;
+    memset(rec, 0, size);
+
+    if (pthread_setspecific(bt_epoch.key, rec) != 0) {
+        free(rec);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&bt_epoch.mutex);
+    rec->next = bt_epoch.recs;
+    bt_epoch.recs = rec;
+    pthread_mutex_unlock(&bt_epoch.mutex);
+
+    bt_epoch_self = rec;
+    return rec;
+}
+
+static void bt_epoch_enter(struct bt_epoch_rec *rec)
+{
+    if (rec->nesting++ == 0) {
+        __atomic_store_n(&rec->epoch,
+                         __atomic_load_n(&bt_epoch.epoch, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+        /* Publish the epoch before reading any tree node */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+/*
+ * Deletes the retired values that no thread can still use. With @t set,
+ * all values retired from tree @t are deleted, the tree is being destroyed.
+ */
+static void bt_epoch_reclaim(struct btree *t)
+{
+    struct bt_ref_hdr *hdr, *next, **prev, *list = NULL;
+    struct bt_epoch_rec *rec;
+    unsigned long min, e;
+
+    pthread_mutex_lock(&bt_epoch.mutex);
+
+    min = __atomic_load_n(&bt_epoch.epoch, __ATOMIC_SEQ_CST);
+    for (rec = bt_epoch.recs; rec != NULL; rec = rec->next) {
+        e = __atomic_load_n(&rec->epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && e < min)
+            min = e;
+    }
+
+    prev = &bt_epoch.retired;
+    while ((hdr = *prev) != NULL) {
+        if (hdr->retired_epoch < min || hdr->retired_tree == t) {
+            *prev = hdr->retired_next;
+            hdr->retired_next = list;
+            list = hdr;
+            __atomic_sub_fetch(&bt_epoch.num_retired, 1, __ATOMIC_RELAXED);
+        } else {
+            prev = &hdr->retired_next;
+        }
+    }
+
+    pthread_mutex_unlock(&bt_epoch.mutex);
+
+    for (hdr = list; hdr != NULL; hdr = next) {
+        next = hdr->retired_next;
+
+        TRACE_DEBUG("delete_func: Btree: %p Value: %p\n",
+                    (void *)hdr->retired_tree, (void *)hdr);
+
+        hdr->retired_tree->delete_func(hdr);
+    }
+}
+
+static void bt_epoch_exit(struct bt_epoch_rec *rec)
+{
+    if (--rec->nesting == 0) {
+        /* All reads of values must be done before leaving the epoch */
+        __atomic_store_n(&rec->epoch, 0, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&bt_epoch.num_retired, __ATOMIC_RELAXED) > 0)
+            bt_epoch_reclaim(NULL);
+    }
+}
+
+#ifdef DEBUG
+static void bt_epoch_check_not_held(void *value)
+{
+    struct bt_epoch_rec *rec;
+    unsigned long i;
+
+    pthread_mutex_lock(&bt_epoch.mutex);
+    for (rec = bt_epoch.recs; rec != NULL; rec = rec->next) {
+        for (i = 0; i < __atomic_load_n(&rec->num_held, __ATOMIC_RELAXED);
+             i++) {
+            if (__atomic_load_n(&rec->held[i], __ATOMIC_RELAXED) == value)
+                TRACE_ERROR("bt_put_node_value: Value %p is held by another "
+                            "thread.\n", value);
+        }
+    }
+    pthread_mutex_unlock(&bt_epoch.mutex);
+}
+#endif
+
+static void bt_epoch_retire(struct btree *t, struct bt_ref_hdr *hdr)
+{
+    /* The value has been removed from the tree before */
+    pthread_mutex_lock(&bt_epoch.mutex);
+    hdr->retired_tree = t;
+    hdr->retired_epoch = __atomic_fetch_add(&bt_epoch.epoch, 1,
+                                            __ATOMIC_SEQ_CST);
+    hdr->retired_next = bt_epoch.retired;
+    bt_epoch.retired = hdr;
+    __atomic_add_fetch(&bt_epoch.num_retired, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&bt_epoch.mutex);
+
+    bt_epoch_reclaim(NULL);
+}
+
 /*
  * __bt_get_node() - Low level function, needs proper locking before invocation.
  */
@@ -36,29 +263,30 @@ static struct btnode *__bt_get_node(struct btree *t, unsigned long node_num)
     struct btnode *temp;
     unsigned long i;
 
-    temp = t->top;
-
-    if (!node_num || node_num > t->size)
+    if (!node_num || node_num > __atomic_load_n(&t->size, __ATOMIC_ACQUIRE))
         return NULL;
 
-    if (node_num == 1) {
-        temp = t->top;
-        return (temp->flags & BT_FLAG_FREE) ? NULL : temp;
-    }
+    temp = __atomic_load_n(&t->top, __ATOMIC_ACQUIRE);
+    if (temp == NULL)
+        return NULL;
 
     i = node_num;
     while (i != 1) {
         if (i & 1) {
             /* If the bit is 1, traverse right */
-            temp = temp->right;
+            temp = __atomic_load_n(&temp->right, __ATOMIC_ACQUIRE);
         } else {
             /* If the bit is 0, traverse left */
-            temp = temp->left;
+            temp = __atomic_load_n(&temp->left, __ATOMIC_ACQUIRE);
         }
+        /* A lookup without the mutex might not see a node being added */
+        if (temp == NULL)
+            return NULL;
         i >>= 1;
     }
 
-    return (temp->flags & BT_FLAG_FREE) ? NULL : temp;
+    return (__atomic_load_n(&temp->flags, __ATOMIC_ACQUIRE) & BT_FLAG_FREE) ?
+                                                                NULL : temp;
 }
 
 /*
@@ -83,22 +311,77 @@ struct btnode *bt_get_node(struct btree *t, unsigned long node_num)
     return temp;
 }
 
+/*
+ * Lookup in a tree initialized with bt_init_epoch(), see above. Returns NULL
+ * if the node has been deleted, or if the value could not be recorded.
+ */
+static void *bt_epoch_get_node_value(struct btree *t, unsigned long node_num,
+                                     CK_BBOOL *recorded)
+{
+    struct bt_epoch_rec *rec;
+    struct btnode *n;
+    void *v;
+
+    *recorded = FALSE;
+
+    rec = bt_epoch_get_rec();
+    if (rec == NULL || rec->num_held >= BT_EPOCH_MAX_HELD)
+        return NULL;
+
+    bt_epoch_enter(rec);
+
+    /*
+     * Read the value before the flags, and again after them. bt_node_free()
+     * sets the free flag before it clears the value, and bt_node_add() sets
+     * the value of a reused node before it clears the flag. If the value
+     * changed in between, the node has been freed and reused concurrently,
+     * and the handle is stale.
+     */
+    n = __bt_get_node(t, node_num);
+    v = ((n) ? __atomic_load_n(&n->value, __ATOMIC_ACQUIRE) : NULL);
+    if (v != NULL &&
+        ((__atomic_load_n(&n->flags, __ATOMIC_ACQUIRE) & BT_FLAG_FREE) ||
+         __atomic_load_n(&n->value, __ATOMIC_ACQUIRE) != v))
+        v = NULL;
+
+    if (v == NULL) {
+        bt_epoch_exit(rec);
+        *recorded = TRUE;
+        return NULL;
+    }
+
+    rec->held[rec->num_held++] = v;
+    *recorded = TRUE;
+
+    TRACE_DEBUG("bt_get_node_value: Btree: %p Value: %p Epoch: %lu\n",
+                (void *)t, v, rec->epoch);
+
+    return v;
+}
+
 /*
  * Get the value of the specified node. Returns NULL if the node has been
- * deleted. Increases the value's reference counter to prevent it from being
- * freed while in use. The caller needs to call bt_put_node_value() to
- * decrease the reference counter when the value is no longer used.
+ * deleted. Increases the value's reference counter (or for an epoch tree,
+ * enters an epoch) to prevent it from being freed while in use. The caller
+ * needs to call bt_put_node_value() when the value is no longer used.
  */
 void *bt_get_node_value(struct btree *t, unsigned long node_num)
 {
     struct btnode *n;
     void *v;
     unsigned long ref;
+    CK_BBOOL recorded;
 
 #ifndef DEBUG
     UNUSED(ref);
 #endif
 
+    if (t->flags & BT_EPOCH) {
+        v = bt_epoch_get_node_value(t, node_num, &recorded);
+        if (recorded)
+            return v;
+    }
+
     if (pthread_mutex_lock(&t->mutex)) {
         TRACE_ERROR("BTree Lock failed.\n");
         return NULL;
@@ -107,8 +390,7 @@ void *bt_get_node_value(struct btree *t, unsigned long node_num)
     /*
      * Get the value within the locked block, to ensure that the node
      * is not deleted after it was obtained via bt_get_node, but before the
-     * value is obtained from the node. For a deleted node, the node->value
-     * points to another node in the free list.
+     * value is obtained from the node.
      */
     n = __bt_get_node(t, node_num);
     v = ((n) ? n->value : NULL);
@@ -127,17 +409,40 @@ void *bt_get_node_value(struct btree *t, unsigned long node_num)
 /*
  * Decrease the node values reference counter.
  * If the reference counter reaches zero, then the btree's delete callback
- * function is called to delete the value.
- * Returns 1 of the value has been deleted, 0 otherwise.
+ * function is called to delete the value. For an epoch tree, a value held by
+ * the calling thread is released instead, and the deletion of a value is
+ * deferred until no thread can still use it.
+ * Returns 1 of the value has been deleted (or retired), 0 otherwise.
  */
 int bt_put_node_value(struct btree *t, void *value)
 {
+    struct bt_epoch_rec *rec = bt_epoch_self;
     int rc = 0;
-    unsigned long ref;
+    unsigned long ref, i;
 
     if (value == NULL)
         return 0;
 
+    if ((t->flags & BT_EPOCH) && rec != NULL) {
+        for (i = rec->num_held; i > 0; i--) {
+            if (rec->held[i - 1] == value) {
+                rec->held[i - 1] = rec->held[--rec->num_held];
+                bt_epoch_exit(rec);
+                return 0;
+            }
+        }
+    }
+
+    /*
+     * Not recorded for this thread, so a counted reference is dropped, see
+     * the invariant at the top. A value recorded for another thread here
+     * means that it was put by the wrong thread.
+     */
+#ifdef DEBUG
+    if (t->flags & BT_EPOCH)
+        bt_epoch_check_not_held(value);
+#endif
+
     if (((struct bt_ref_hdr *)value)->ref > 0) {
         ref = __sync_sub_and_fetch(&((struct bt_ref_hdr *)value)->ref, 1);
 
@@ -150,6 +455,11 @@ int bt_put_node_value(struct btree *t, void *value)
     }
 
     if (ref == 0 && t->delete_func) {
+        if (t->flags & BT_EPOCH) {
+            bt_epoch_retire(t, value);
+            return 1;
+        }
+
          TRACE_DEBUG("delete_func: Btree: %p Value: %p\n", (void *)t, value);
 
          t->delete_func(value);
@@ -171,8 +481,10 @@ static struct btnode *node_create(struct btnode **child_ptr,
     node->left = node->right = NULL;
     node->flags = 0;
     node->value = value;
-    *child_ptr = node;
+    node->free_next = NULL;
     node->parent = parent_ptr;
+    /* Lookups in epoch trees do not take the mutex */
+    __atomic_store_n(child_ptr, node, __ATOMIC_RELEASE);
 
     return node;
 }
@@ -217,22 +529,25 @@ unsigned long bt_node_add(struct btree *t, void *value)
     temp = t->top;
 
     if (!temp) {                /* no root node yet exists, create it */
-        t->size = 1;
         if (!node_create(&t->top, NULL, value)) {
             pthread_mutex_unlock(&t->mutex);
             return 0;
         }
+        __atomic_store_n(&t->size, 1, __ATOMIC_RELEASE);
 
         pthread_mutex_unlock(&t->mutex);
         return 1;
     } else if (t->free_list) {
         /* there's a node on the free list,
-         * use it instead of mallocing new
+         * use it instead of mallocing new.
+         * See bt_epoch_get_node_value() for the order of the stores.
          */
         temp = t->free_list;
-        t->free_list = temp->value;
-        temp->value = value;
-        temp->flags &= (~BT_FLAG_FREE);
+        t->free_list = temp->free_next;
+        temp->free_next = NULL;
+        __atomic_store_n(&temp->value, value, __ATOMIC_RELEASE);
+        __atomic_store_n(&temp->flags, temp->flags & ~BT_FLAG_FREE,
+                         __ATOMIC_RELEASE);
         t->free_nodes--;
         new_node_index = GET_NODE_HANDLE(temp);
         pthread_mutex_unlock(&t->mutex);
@@ -269,7 +584,7 @@ unsigned long bt_node_add(struct btree *t, void *value)
         new_node_index >>= 1;
     }
 
-    t->size++;
+    __atomic_store_n(&t->size, t->size + 1, __ATOMIC_RELEASE);
     new_node_index = t->size;
 
     pthread_mutex_unlock(&t->mutex);
@@ -330,13 +645,13 @@ void *bt_node_free(struct btree *t, unsigned long node_num,
          */
         value = node->value;
 
-        node->flags |= BT_FLAG_FREE;
+        /* See bt_epoch_get_node_value() for the order of the stores */
+        __atomic_store_n(&node->flags, node->flags | BT_FLAG_FREE,
+                         __ATOMIC_SEQ_CST);
+        __atomic_store_n(&node->value, NULL, __ATOMIC_RELEASE);
 
-        /* add node to the free list,
-         * which is chained by using
-         * the value pointer
-         */
-        node->value = t->free_list;
+        /* add node to the free list */
+        node->free_next = t->free_list;
         t->free_list = node;
         t->free_nodes++;
 
@@ -406,7 +721,7 @@ void bt_for_each_node(STDLL_TokData_t *tokdata, struct btree *t, void (*func)
     unsigned int i;
     void *value;
 
-    for (i = 1; i < t->size + 1; i++) {
+    for (i = 1; i < __atomic_load_n(&t->size, __ATOMIC_ACQUIRE) + 1; i++) {
         /*
          * Get the node value, not the node itself. This ensures that we either
          * get the value from a valid node, or NULL in case of a deleted node.
@@ -436,6 +751,10 @@ void bt_destroy(struct btree *t)
     unsigned long i;
     struct btnode *temp;
 
+    /* Delete the values retired from this tree, it is no longer used */
+    if (t->flags & BT_EPOCH)
+        bt_epoch_reclaim(t);
+
     if (pthread_mutex_lock(&t->mutex)) {
         TRACE_ERROR("BTree Lock failed.\n");
         return;
@@ -455,12 +774,7 @@ void bt_destroy(struct btree *t)
             i >>= 1;
         }
 
-        /*
-         * The value pointed by value in a node marked as freed points
-         * to the next node element in free_list and it shouldn't be
-         * freed here because the loop will iterate through each node,
-         * freed or not.
-         */
+        /* A node marked as freed has no value */
         if (t->delete_func && !(temp->flags & BT_FLAG_FREE)) {
 
             TRACE_DEBUG("bt_destroy: Btree: %p Value: %p Ref: %lu\n", (void *)t,
@@ -497,6 +811,7 @@ CK_RV bt_init(struct btree *t, void (*delete_func)(void *))
     t->size = 0;
     t->free_nodes = 0;
     t->delete_func = delete_func;
+    t->flags = 0;
 
     /*
      * Need a recursive mutex, because btree callback functions may call
@@ -517,3 +832,21 @@ CK_RV bt_init(struct btree *t, void (*delete_func)(void *))
 
     return CKR_OK;
 }
+
+/* bt_init_epoch
+ *
+ * Initialize a btree like bt_init(), with lookups protected by epoch based
+ * reclamation instead of reference counting.
+ */
+CK_RV bt_init_epoch(struct btree *t, void (*delete_func)(void *))
+{
+    CK_RV rc;
+
+    rc = bt_init(t, delete_func);
+    if (rc != CKR_OK)
+        return rc;
+
+    t->flags |= BT_EPOCH;
+
+    return CKR_OK;
+}
@@ -67,7 +67,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is key allowed to do general decryption?
         //
-        rc = template_attribute_get_bool(key_obj->template, CKA_DECRYPT, &flag);
+        rc = object_get_usage(key_obj, CKA_DECRYPT, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_ENCRYPT for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -90,7 +90,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is key allowed to unwrap other keys?
         //
-        rc = template_attribute_get_bool(key_obj->template, CKA_UNWRAP, &flag);
+        rc = object_get_usage(key_obj, CKA_UNWRAP, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_UNWRAP for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -120,15 +120,14 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
 
     ctx->auth_required = FALSE;
     if (checkauth) {
-        rc = key_object_is_always_authenticate(key_obj->template,
-                                               &ctx->auth_required);
+        rc = object_is_always_authenticate(key_obj, &ctx->auth_required);
         if (rc != CKR_OK) {
             TRACE_ERROR("key_object_is_always_authenticate failed\n");
             goto done;
         }
     }
 
-    if (!key_object_is_mechanism_allowed(key_obj->template, mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, key_obj, mech->mechanism)) {
         TRACE_ERROR("Mechanism not allowed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
@@ -149,8 +148,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -188,8 +186,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -227,8 +224,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -257,8 +253,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -296,8 +291,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -333,8 +327,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -358,8 +351,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -385,8 +377,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -418,8 +409,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -448,8 +438,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
         // is the key type correct?
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -488,8 +477,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             mech = &temp_mech;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -534,8 +522,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -564,8 +551,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -25,6 +25,117 @@
 #include "trace.h"
 #include "../api/statistics.h"
 
+/*
+ * A finished digest context that the token is able to reset (i.e. it has set
+ * a context_reset_func) is not freed, but kept in the session as its idle
+ * digest context. The next digest operation of that session with the same
+ * mechanism, including the digests done as part of sign and verify
+ * operations, resets and reuses it instead of allocating and initializing a
+ * new one. Only the most recently finished context is kept.
+ *
+ * Batch and async requests run several operations of one session at the same
+ * time, so the idle slot is only accessed while holding idle_digest_busy,
+ * which is taken with an atomic exchange. A thread that finds it taken does
+ * not wait, but allocates a new context or frees its finished one. A context
+ * is moved out of the slot before it is reset or freed, so that it is never
+ * owned by more than one operation.
+ */
+static CK_BBOOL digest_mgr_lock_idle(SESSION *sess)
+{
+    return __atomic_exchange_n(&sess->idle_digest_busy, TRUE,
+                               __ATOMIC_ACQUIRE) == FALSE;
+}
+
+static void digest_mgr_unlock_idle(SESSION *sess)
+{
+    __atomic_store_n(&sess->idle_digest_busy, FALSE, __ATOMIC_RELEASE);
+}
+
+static void digest_mgr_free_ctx(STDLL_TokData_t *tokdata, SESSION *sess,
+                                DIGEST_CONTEXT *ctx)
+{
+    if (ctx->context != NULL) {
+        if (ctx->context_free_func != NULL)
+            ctx->context_free_func(tokdata, sess, ctx->context,
+                                   ctx->context_len);
+        else
+            free(ctx->context);
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/*
+ * Frees the idle digest context of a session that is closed, i.e. that no
+ * other thread uses anymore.
+ */
+void digest_mgr_free_idle(STDLL_TokData_t *tokdata, SESSION *sess)
+{
+    digest_mgr_free_ctx(tokdata, sess, &sess->idle_digest_ctx);
+}
+
+static CK_BBOOL digest_mgr_keep_idle(STDLL_TokData_t *tokdata, SESSION *sess,
+                                     DIGEST_CONTEXT *ctx)
+{
+    DIGEST_CONTEXT *idle, old;
+
+    if (sess == NULL || ctx->context_reset_func == NULL)
+        return FALSE;
+
+    idle = &sess->idle_digest_ctx;
+    if (ctx == idle || !digest_mgr_lock_idle(sess))
+        return FALSE;
+
+    old = *idle;
+    memset(idle, 0, sizeof(*idle));
+    idle->mech.mechanism = ctx->mech.mechanism;
+    idle->context = ctx->context;
+    idle->context_len = ctx->context_len;
+    idle->context_free_func = ctx->context_free_func;
+    idle->context_reset_func = ctx->context_reset_func;
+    idle->state_unsaveable = ctx->state_unsaveable;
+
+    digest_mgr_unlock_idle(sess);
+
+    digest_mgr_free_ctx(tokdata, sess, &old);
+
+    return TRUE;
+}
+
+static CK_BBOOL digest_mgr_reuse_idle(STDLL_TokData_t *tokdata, SESSION *sess,
+                                      DIGEST_CONTEXT *ctx, CK_MECHANISM *mech)
+{
+    DIGEST_CONTEXT *idle = &sess->idle_digest_ctx, taken;
+
+    if (!digest_mgr_lock_idle(sess))
+        return FALSE;
+
+    if (idle->context == NULL || idle->mech.mechanism != mech->mechanism) {
+        digest_mgr_unlock_idle(sess);
+        return FALSE;
+    }
+
+    taken = *idle;
+    memset(idle, 0, sizeof(*idle));
+
+    digest_mgr_unlock_idle(sess);
+
+    if (taken.context_reset_func(tokdata, sess, taken.context,
+                                 taken.context_len) != CKR_OK) {
+        TRACE_DEVEL("Failed to reset the idle digest context.\n");
+        digest_mgr_free_ctx(tokdata, sess, &taken);
+        return FALSE;
+    }
+
+    ctx->context = taken.context;
+    ctx->context_len = taken.context_len;
+    ctx->context_free_func = taken.context_free_func;
+    ctx->context_reset_func = taken.context_reset_func;
+    ctx->state_unsaveable = taken.state_unsaveable;
+
+    return TRUE;
+}
+
 //
 //
 CK_RV digest_mgr_init(STDLL_TokData_t *tokdata,
@@ -75,7 +186,11 @@ CK_RV digest_mgr_init(STDLL_TokData_t *tokdata,
             return CKR_MECHANISM_PARAM_INVALID;
         }
 
+        if (digest_mgr_reuse_idle(tokdata, sess, ctx, mech))
+            break;
+
         ctx->context = NULL;
+        ctx->context_reset_func = NULL;
         rc = sha_init(tokdata, sess, ctx, mech);
         if (rc != CKR_OK) {
             digest_mgr_cleanup(tokdata, sess, ctx);    // to de-initialize context above
@@ -149,6 +264,19 @@ CK_RV digest_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
         TRACE_ERROR("Invalid function argument.\n");
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->context != NULL && !digest_mgr_keep_idle(tokdata, sess, ctx)) {
+        if (ctx->context_free_func != NULL)
+            ctx->context_free_func(tokdata, sess, ctx->context,
+                                   ctx->context_len);
+        else
+            free(ctx->context);
+    }
+    ctx->context = NULL;
+    ctx->context_len = 0;
+    ctx->context_free_func = NULL;
+    ctx->context_reset_func = NULL;
+
     ctx->mech.ulParameterLen = 0;
     ctx->mech.mechanism = 0;
     ctx->multi_init = FALSE;
@@ -162,17 +290,6 @@ CK_RV digest_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
         ctx->mech.pParameter = NULL;
     }
 
-    if (ctx->context != NULL) {
-        if (ctx->context_free_func != NULL)
-            ctx->context_free_func(tokdata, sess, ctx->context,
-                                   ctx->context_len);
-        else
-            free(ctx->context);
-        ctx->context = NULL;
-    }
-    ctx->context_len = 0;
-    ctx->context_free_func = NULL;
-
     return CKR_OK;
 }
 
@@ -69,7 +69,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is key allowed to do general encryption?
         //
-        rc = template_attribute_get_bool(key_obj->template, CKA_ENCRYPT, &flag);
+        rc = object_get_usage(key_obj, CKA_ENCRYPT, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_ENCRYPT for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -93,7 +93,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is key allowed to wrap other keys?
         //
-        rc = template_attribute_get_bool(key_obj->template, CKA_WRAP, &flag);
+        rc = object_get_usage(key_obj, CKA_WRAP, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_WRAP for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -120,7 +120,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
     }
-    if (!key_object_is_mechanism_allowed(key_obj->template, mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, key_obj, mech->mechanism)) {
         TRACE_ERROR("Mechanism not allwed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
@@ -141,8 +141,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -180,8 +179,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -219,8 +217,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -249,8 +246,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -288,8 +284,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -325,8 +320,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -350,8 +344,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -377,8 +370,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -410,8 +402,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         // is the key type correct?
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -440,8 +431,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
         // is the key type correct
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -480,8 +470,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             mech = &temp_mech;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -526,8 +515,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -556,8 +544,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -1147,24 +1134,23 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
             goto done;
         }
 
-        if (!key_object_is_mechanism_allowed(decr_key_obj->template,
-                                             decr_mech->mechanism)) {
+        if (!object_is_mechanism_allowed(tokdata, decr_key_obj,
+                                         decr_mech->mechanism)) {
             TRACE_ERROR("Decrypt mechanism not allwed per "
                         "CKA_ALLOWED_MECHANISMS.\n");
             rc = CKR_MECHANISM_INVALID;
             goto done;
         }
 
-        if (!key_object_is_mechanism_allowed(encr_key_obj->template,
-                                             encr_mech->mechanism)) {
+        if (!object_is_mechanism_allowed(tokdata, encr_key_obj,
+                                         encr_mech->mechanism)) {
             TRACE_ERROR("Encrypt mechanism not allwed per "
                         "CKA_ALLOWED_MECHANISMS.\n");
             rc = CKR_MECHANISM_INVALID;
             goto done;
         }
 
-        rc = template_attribute_get_bool(decr_key_obj->template, CKA_DECRYPT,
-                                         &flag);
+        rc = object_get_usage(decr_key_obj, CKA_DECRYPT, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_DECRYPT for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -1177,8 +1163,7 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
             goto done;
         }
 
-        rc = template_attribute_get_bool(encr_key_obj->template, CKA_ENCRYPT,
-                                         &flag);
+        rc = object_get_usage(encr_key_obj, CKA_ENCRYPT, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_ENCRYPT for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -1260,3 +1245,25 @@ done:
 
     return rc;
 }
+
+/*
+ * Returns TRUE if the mechanism can encrypt the elements of a batch or async
+ * request (SC_IBM_EncryptBatch, SC_IBM_AsyncSubmit). The elements are
+ * encrypted with copies of one initial context, so only mechanisms without
+ * an IV, counter or nonce are allowed, otherwise all elements would be
+ * encrypted with the same one.
+ */
+CK_BBOOL encr_mgr_batch_mech_supported(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+    case CKM_RSA_PKCS:
+    case CKM_RSA_PKCS_OAEP:
+    case CKM_RSA_X_509:
+    case CKM_AES_ECB:
+    case CKM_DES_ECB:
+    case CKM_DES3_ECB:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
@@ -436,6 +436,16 @@ CK_RV restore_private_token_object(STDLL_TokData_t *tokdata,
                                    OBJECT *pObj,
                                    const char *fname);
 
+CK_RV master_key_seal(STDLL_TokData_t *tokdata, unsigned char *out,
+                      unsigned char tag[16], const unsigned char *aad,
+                      size_t aadlen, const unsigned char *in, size_t inlen,
+                      const unsigned char iv[12]);
+CK_RV master_key_unseal(STDLL_TokData_t *tokdata, unsigned char *out,
+                        const unsigned char *aad, size_t aadlen,
+                        const unsigned char *in, size_t inlen,
+                        const unsigned char tag[16],
+                        const unsigned char iv[12]);
+
 CK_RV delete_token_object(STDLL_TokData_t *tokdata, OBJECT *ptr);
 CK_RV delete_token_data(STDLL_TokData_t *tokdata);
 
@@ -1959,6 +1969,8 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
                                 CK_BYTE *in_data, CK_ULONG in_data_len,
                                 CK_BYTE *out_data, CK_ULONG *out_data_len);
 
+CK_BBOOL encr_mgr_batch_mech_supported(CK_MECHANISM_TYPE mech);
+
 // decryption manager routines
 //
 CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
@@ -2013,6 +2025,8 @@ CK_RV decr_mgr_update_des3_cbc(STDLL_TokData_t *tokdata, SESSION *sess,
 CK_RV digest_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
                          DIGEST_CONTEXT *ctx);
 
+void digest_mgr_free_idle(STDLL_TokData_t *tokdata, SESSION *sess);
+
 CK_RV digest_mgr_init(STDLL_TokData_t *tokdata,
                       SESSION *sess,
                       DIGEST_CONTEXT *ctx, CK_MECHANISM *mech,
@@ -2178,6 +2192,40 @@ CK_RV verify_mgr_verify_final(STDLL_TokData_t *tokdata,
                               CK_BYTE *signature, CK_ULONG sig_len);
 
 
+// async manager routines
+//
+CK_RV async_mgr_init(STDLL_TokData_t *tokdata);
+CK_RV async_mgr_submit(STDLL_TokData_t *tokdata, struct async_job *job);
+void async_mgr_final(STDLL_TokData_t *tokdata, CK_BBOOL in_fork_initializer);
+
+CK_RV slab_cache_init(SLAB_CACHE *cache, const char *name, size_t size);
+void slab_cache_destroy(SLAB_CACHE *cache);
+void *slab_alloc(SLAB_CACHE *cache, size_t size);
+void slab_free(void *ptr);
+void slab_cache_get_stats(SLAB_CACHE *cache, struct slab_stats *stats);
+CK_RV slab_mgr_init(STDLL_TokData_t *tokdata);
+void slab_mgr_final(STDLL_TokData_t *tokdata);
+void slab_mgr_trace_stats(STDLL_TokData_t *tokdata);
+
+#define OBJ_CACHE_PUBLIC        0x01
+#define OBJ_CACHE_PRIVATE       0x02
+
+CK_RV obj_cache_attach(STDLL_TokData_t *tokdata);
+void obj_cache_detach(STDLL_TokData_t *tokdata, CK_BBOOL ignore_ref_count);
+CK_BYTE *obj_cache_get(STDLL_TokData_t *tokdata, const char *fname,
+                       unsigned int types, CK_ULONG *len);
+void obj_cache_put(STDLL_TokData_t *tokdata, const char *fname,
+                   CK_BBOOL priv, const CK_BYTE *data, CK_ULONG len);
+void obj_cache_remove(STDLL_TokData_t *tokdata, const CK_BYTE *name);
+void obj_cache_clear(STDLL_TokData_t *tokdata);
+
+CK_RV login_cache_get(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                      const CK_BYTE *login_key, CK_BYTE *wrap_key);
+void login_cache_put(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                     const CK_BYTE *login_key, const CK_BYTE *wrap_key);
+void login_cache_revoke(STDLL_TokData_t *tokdata, CK_USER_TYPE userType);
+
+
 // session manager routines
 //
 CK_RV session_mgr_close_all_sessions(STDLL_TokData_t *tokdata);
@@ -2341,6 +2389,7 @@ CK_BBOOL object_mgr_purge_map(STDLL_TokData_t *tokdata,
 CK_RV object_put(STDLL_TokData_t *tokdata, OBJECT *obj, CK_BBOOL unlock);
 
 CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                    const char *op_id,
                                     CK_RV (*reenc)(CK_BYTE *sec_key,
                                                    CK_BYTE *reenc_sec_key,
                                                    CK_ULONG sec_key_len,
@@ -2369,8 +2418,12 @@ CK_RV obj_mgr_iterate_key_objects(STDLL_TokData_t *tokdata,
                                   void *filter_data,
                                   CK_RV (*cb)(STDLL_TokData_t *tokdata,
                                               OBJECT *obj, void *cb_data),
-                                  void *cb_data, CK_BBOOL syslog,
-                                  const char *msg);
+                                  void *cb_data,
+                                  void (*progress)(STDLL_TokData_t *tokdata,
+                                                   CK_ULONG done,
+                                                   CK_ULONG total,
+                                                   void *cb_data),
+                                  CK_BBOOL syslog, const char *msg);
 
 /* structures used to hold arguments to callback functions triggered by either
  * bt_for_each_node or bt_node_free */
@@ -2432,7 +2485,7 @@ CK_RV object_get_attribute_values(OBJECT *obj,
 
 CK_ULONG object_get_size(OBJECT *obj);
 
-CK_RV object_restore_withSize(struct policy *policy, CK_BYTE *data,
+CK_RV object_restore_withSize(STDLL_TokData_t *tokdata, CK_BYTE *data,
                               OBJECT **obj, CK_BBOOL replace, int data_size,
                               const char *fname);
 
@@ -2451,6 +2504,14 @@ CK_BBOOL object_is_extractable(OBJECT *obj);
 CK_BBOOL object_is_pkey_extractable(OBJECT *obj);
 CK_BBOOL object_is_attr_bound(OBJECT *obj);
 
+void object_update_caps(STDLL_TokData_t *tokdata, OBJECT *obj);
+CK_RV object_get_class(OBJECT *obj, CK_OBJECT_CLASS *class);
+CK_RV object_get_key_type(OBJECT *obj, CK_KEY_TYPE *keytype);
+CK_RV object_get_usage(OBJECT *obj, CK_ATTRIBUTE_TYPE type, CK_BBOOL *flag);
+CK_RV object_is_always_authenticate(OBJECT *obj, CK_BBOOL *auth);
+CK_BBOOL object_is_mechanism_allowed(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                     CK_MECHANISM_TYPE mech);
+
 CK_RV object_init_lock(OBJECT *obj);
 CK_RV object_destroy_lock(OBJECT *obj);
 CK_RV object_lock(OBJECT *obj, OBJ_LOCK_TYPE type);
@@ -2486,7 +2547,14 @@ void template_attribute_find_multiple(TEMPLATE *tmpl,
                                       ATTRIBUTE_PARSE_LIST *parselist,
                                       CK_ULONG plcount);
 
+CK_RV template_attribute_find_all(TEMPLATE *tmpl, CK_ATTRIBUTE *types,
+                                  CK_ULONG count, CK_ATTRIBUTE **attrs);
+
 CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type);
+void template_get_export_info(TEMPLATE *tmpl,
+                              struct template_export_info *info);
+CK_BBOOL template_check_export_info(const struct template_export_info *info,
+                                    CK_ATTRIBUTE_TYPE type);
 
 CK_RV template_check_required_attributes(TEMPLATE *tmpl,
                                          CK_ULONG class,
@@ -2501,6 +2569,7 @@ CK_RV template_copy(TEMPLATE *dest, TEMPLATE *src);
 CK_RV template_flatten(TEMPLATE *tmpl, CK_BYTE *dest);
 
 CK_RV template_free(TEMPLATE *tmpl);
+void template_get_arena_stats(struct template_arena_stats *stats);
 
 CK_BBOOL template_get_class(TEMPLATE *tmpl,
                             CK_ULONG *class, CK_ULONG *subclass);
@@ -3060,6 +3129,13 @@ CK_RV openssl_get_ex_data(OBJECT *obj, void **ex_data, size_t ex_data_len,
                                                void *ex_data,
                                                size_t ex_data_len));
 
+CK_RV openssl_specific_rsa_generate_pkey(CK_ULONG mod_bits,
+                                         const CK_BYTE *publ_exp,
+                                         CK_ULONG publ_exp_len,
+                                         EVP_PKEY **pkey);
+CK_RV openssl_specific_rsa_keygen_from_pkey(EVP_PKEY *pkey,
+                                            TEMPLATE *publ_tmpl,
+                                            TEMPLATE *priv_tmpl);
 CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl);
 CK_RV openssl_specific_rsa_encrypt(STDLL_TokData_t *, CK_BYTE *in_data,
                                    CK_ULONG in_data_len,
@@ -3116,6 +3192,10 @@ CK_RV openssl_specific_rsa_oaep_decrypt(STDLL_TokData_t *, ENCR_DECR_CONTEXT *,
                                         t_rsa_decrypt);
 
 CK_RV openssl_make_ec_key_from_template(TEMPLATE *template, EVP_PKEY **pkey);
+CK_RV openssl_specific_ec_generate_pkey(int nid, EVP_PKEY **pkey);
+CK_RV openssl_specific_ec_keygen_from_pkey(EVP_PKEY *ec_pkey,
+                                           TEMPLATE *publ_tmpl,
+                                           TEMPLATE *priv_tmpl);
 CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
                                            TEMPLATE *publ_tmpl,
                                            TEMPLATE *priv_tmpl);
@@ -3284,6 +3364,12 @@ CK_RV calc_rsa_crt_from_me(CK_ATTRIBUTE *modulus, CK_ATTRIBUTE *pub_exp,
 
 #if OPENSSL_VERSION_PREREQ(3, 0)
 const char *openssl_get_pqc_oid_name(const struct pqc_oid *oid);
+CK_RV openssl_specific_ibm_dilithium_generate_pkey(const struct pqc_oid *oid,
+                                                   EVP_PKEY **pkey);
+CK_RV openssl_specific_ibm_dilithium_keygen_from_pkey(EVP_PKEY *pkey,
+                                                      const struct pqc_oid *oid,
+                                                      TEMPLATE *publ_tmpl,
+                                                      TEMPLATE *priv_tmpl);
 CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
                                                       const struct pqc_oid *oid,
                                                       TEMPLATE *publ_tmpl,
@@ -24,6 +24,7 @@
 #include <pthread.h>
 
 #include "local_types.h"
+#include "list.h"
 #include "../api/policy.h"
 #include "../api/mechtable.h"
 #include "../api/statistics.h"
@@ -32,6 +33,9 @@ struct _SESSION;
 
 typedef void (*context_free_func_t)(STDLL_TokData_t *tokdata, struct _SESSION *sess,
                                     CK_BYTE *context, CK_ULONG context_len);
+typedef CK_RV (*context_reset_func_t)(STDLL_TokData_t *tokdata,
+                                     struct _SESSION *sess,
+                                     CK_BYTE *context, CK_ULONG context_len);
 
 typedef struct _ENCR_DECR_CONTEXT {
     CK_OBJECT_HANDLE key;
@@ -55,6 +59,7 @@ typedef struct _DIGEST_CONTEXT {
     CK_BYTE *context;
     CK_ULONG context_len;
     context_free_func_t context_free_func;
+    context_reset_func_t context_reset_func; // allows to reuse the context
     CK_BBOOL multi;
     CK_BBOOL active;
     CK_BBOOL multi_init;        // multi field is initialized
@@ -96,9 +101,15 @@ typedef struct _SESSION {
     ENCR_DECR_CONTEXT encr_ctx;
     ENCR_DECR_CONTEXT decr_ctx;
     DIGEST_CONTEXT digest_ctx;
+    DIGEST_CONTEXT idle_digest_ctx;     // finished digest context for reuse
+    CK_BBOOL idle_digest_busy;          // idle_digest_ctx is in use, see
+                                        // dig_mgr.c
     SIGN_VERIFY_CONTEXT sign_ctx;
     SIGN_VERIFY_CONTEXT verify_ctx;
 
+    list_t sess_objects;        // session objects owned by this session,
+                                // protected by tokdata->sess_obj_list_mutex
+
     void *private_data;
 } SESSION;
 
@@ -200,8 +211,57 @@ typedef pthread_mutex_t MUTEX;
 
 typedef struct _TEMPLATE {
     DL_NODE *attribute_list;
+    DL_NODE *arenas;            // attribute arenas referenced, see template.c
 } TEMPLATE;
 
+/*
+ * The template attributes that the exportability of an attribute depends
+ * on, see template_get_export_info()
+ */
+struct template_export_info {
+    CK_ULONG class;
+    CK_ULONG subclass;
+    CK_BBOOL all_exportable;    // no key, or not sensitive and extractable
+    CK_BBOOL none_exportable;   // CKA_SENSITIVE or CKA_EXTRACTABLE missing
+};
+
+/* Allocation counters of the template attribute arenas */
+struct template_arena_stats {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long in_use;
+};
+
+
+/* Usage flags of struct objcaps, one per boolean key usage attribute */
+#define OBJCAPS_ENCRYPT         (1u << 0)
+#define OBJCAPS_DECRYPT         (1u << 1)
+#define OBJCAPS_SIGN            (1u << 2)
+#define OBJCAPS_SIGN_RECOVER    (1u << 3)
+#define OBJCAPS_VERIFY          (1u << 4)
+#define OBJCAPS_VERIFY_RECOVER  (1u << 5)
+#define OBJCAPS_WRAP            (1u << 6)
+#define OBJCAPS_UNWRAP          (1u << 7)
+#define OBJCAPS_DERIVE          (1u << 8)
+
+/*
+ * Summary of the attributes checked when an operation is initialized with
+ * a key. It is computed from the template when the object is created,
+ * loaded or modified (object_update_caps), so that the checks do not need
+ * to search the template. If valid is FALSE, the template is used instead.
+ */
+struct objcaps {
+    CK_BBOOL valid;
+    CK_OBJECT_CLASS class;
+    CK_BBOOL keytype_present;
+    CK_KEY_TYPE keytype;
+    CK_ULONG usage_present;     // OBJCAPS_* of the usage attributes present
+    CK_ULONG usage;             // OBJCAPS_* of the usage attributes set TRUE
+    CK_BBOOL always_auth;
+    CK_BBOOL all_mechs_allowed; // no or empty CKA_ALLOWED_MECHANISMS
+    CK_BBOOL other_mechs_allowed; // allows mechanisms not in the mechtable
+    uint8_t allowed_mechs[(MECHTABLE_NUM_ELEMS + 7) / 8]; // by mechtable index
+};
 
 typedef struct _OBJECT {
     struct bt_ref_hdr hdr;
@@ -209,15 +269,21 @@ typedef struct _OBJECT {
     CK_BYTE name[8];            // for token objects
 
     SESSION *session;           // creator; only for session objects
+    list_entry_t sess_obj_entry; // in creator's list; only for session objects
+    unsigned long sess_obj_handle; // node in sess_obj_btree
     TEMPLATE *template;
     pthread_rwlock_t template_rwlock; // Lock for object's template
     CK_ULONG count_hi;          // only significant for token objects
     CK_ULONG count_lo;          // only significant for token objects
     CK_ULONG index;             // SAB  Index into the SHM
+    uint64_t shm_gen;           // only significant for token objects:
+                                // tok_obj_gen + 1 when last checked
     CK_OBJECT_HANDLE map_handle;
 
     // policy support (set via store_object_strength_f pointer)
     struct objstrength strength;
+    // key capabilities (set via object_update_caps)
+    struct objcaps caps;
 
     /* Allow to attach external data to an object */
     void *ex_data;
@@ -387,6 +453,8 @@ struct _LW_SHM_TYPE {
     CK_BBOOL publ_loaded;
     TOK_OBJ_ENTRY publ_tok_objs[MAX_TOK_OBJS];
     TOK_OBJ_ENTRY priv_tok_objs[MAX_TOK_OBJS];
+    uint64_t tok_obj_gen;       // incremented with every change of the
+                                // entries above, see object_mgr_check_shm
 };
 
 struct tokspec_counter {
@@ -395,6 +463,60 @@ struct tokspec_counter {
     void (*decr_tokspec_count)(STDLL_TokData_t *tokdata);
 };
 
+/*
+ * A job processed by the async executor. run() is called by a worker thread
+ * and its return value is stored in rc. done() is called afterwards, also if
+ * the job was cancelled, and must release the job. If notify is FALSE, the
+ * submitter must not be notified (the process is a forked child).
+ */
+struct async_job {
+    list_entry_t entry;
+    CK_RV rc;
+    CK_RV (*run)(STDLL_TokData_t *tokdata, struct async_job *job);
+    void (*done)(STDLL_TokData_t *tokdata, struct async_job *job,
+                 CK_BBOOL notify);
+};
+
+/* Executor for requests submitted via ST_IBM_AsyncSubmit */
+struct async_executor {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    list_t jobs;                // queued jobs, in submission order
+    CK_ULONG num_jobs;
+    pthread_t *threads;
+    CK_ULONG num_threads;
+    CK_ULONG idle_threads;
+    CK_BBOOL terminate;
+    void *libctx;               // OpenSSL library context used by workers
+};
+
+/* Allocation counters of a slab cache, see slab.c */
+struct slab_stats {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long in_use;
+    unsigned long slabs;        // slabs currently allocated
+    unsigned long slab_allocs;  // slabs allocated from the heap
+    unsigned long slab_frees;   // slabs returned to the heap
+};
+
+struct slab;
+struct obj_cache_hdr;
+
+/* Per-token cache of fixed size structures, see slab.c */
+typedef struct _SLAB_CACHE {
+    pthread_mutex_t mutex;
+    const char *name;
+    size_t obj_size;            // including the per-object header
+    CK_ULONG objs_per_slab;
+    struct slab *partial;       // slabs with used and free objects
+    struct slab *full;          // slabs without free objects
+    struct slab *empty;         // one unused slab kept for reuse
+    CK_BBOOL initialized;
+    CK_BBOOL orphaned;          // slabs in use at destroy, see slab.c
+    struct slab_stats stats;
+} SLAB_CACHE;
+
 struct _STDLL_TokData_t {
     CK_SLOT_INFO slot_info;
     CK_SLOT_ID slot_id;
@@ -425,6 +547,7 @@ struct _STDLL_TokData_t {
     pthread_rwlock_t sess_list_rwlock;
     struct btree object_map_btree;
     struct btree sess_obj_btree;
+    pthread_mutex_t sess_obj_list_mutex;
     struct btree publ_token_obj_btree;
     struct btree priv_token_obj_btree;
     MECH_LIST_ELEMENT *mech_list;
@@ -435,6 +558,16 @@ struct _STDLL_TokData_t {
     struct tokstore_strength store_strength;
     CK_BBOOL hsm_mk_change_supported;
     pthread_rwlock_t hsm_mk_change_rwlock;
+    CK_ULONG batch_threads; /* max threads for a batch request, 0 = serial */
+    CK_ULONG async_threads; /* max async worker threads, 0 = synchronous */
+    CK_ULONG hsm_mk_change_threads; /* max threads to re-encipher objects */
+    struct async_executor async_exec;
+    SLAB_CACHE object_cache;    // OBJECT
+    SLAB_CACHE object_map_cache; // OBJECT_MAP
+    SLAB_CACHE session_cache;   // SESSION
+    CK_ULONG obj_cache_size;    /* shared object cache size in MB, 0 = off */
+    struct obj_cache_hdr *obj_cache; /* shared object cache, see obj_cache.c */
+    CK_ULONG login_cache_timeout; /* lifetime of cached login keys, 0 = off */
 };
 
 #endif
@@ -796,8 +796,8 @@ CK_RV key_mgr_wrap_key(STDLL_TokData_t *tokdata,
         TRACE_ERROR("POLICY VIOLATION: key wrap\n");
         goto done;
     }
-    if (!key_object_is_mechanism_allowed(wrapping_key_obj->template,
-                                         mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, wrapping_key_obj,
+                                     mech->mechanism)) {
         TRACE_ERROR("Mechanism not allowed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
@@ -826,8 +826,7 @@ CK_RV key_mgr_wrap_key(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    rc = template_attribute_get_bool(wrapping_key_obj->template, CKA_WRAP,
-                                     &flag);
+    rc = object_get_usage(wrapping_key_obj, CKA_WRAP, &flag);
     if (rc != CKR_OK) {
         TRACE_ERROR("Could not find CKA_WRAP for the wrapping key.\n");
         rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -864,7 +863,7 @@ CK_RV key_mgr_wrap_key(STDLL_TokData_t *tokdata,
     // what kind of key are we trying to wrap?  make sure the mechanism is
     // allowed to wrap this kind of key
     //
-    rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS, &class);
+    rc = object_get_class(key_obj, &class);
     if (rc != CKR_OK) {
         TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
         goto done;
@@ -942,8 +941,7 @@ CK_RV key_mgr_wrap_key(STDLL_TokData_t *tokdata,
 
     // extract the secret data to be wrapped
     //
-    rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                      &keytype);
+    rc = object_get_key_type(key_obj, &keytype);
     if (rc != CKR_OK) {
         TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
         goto done;
@@ -1195,15 +1193,14 @@ CK_RV key_mgr_unwrap_key(STDLL_TokData_t *tokdata,
         TRACE_ERROR("POLICY VIOLATION: key unwrap\n");
         goto done;
     }
-    if (!key_object_is_mechanism_allowed(unwrapping_key_obj->template,
-                                         mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, unwrapping_key_obj,
+                                     mech->mechanism)) {
         TRACE_ERROR("Mechanism not allowed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
     }
 
-    rc = template_attribute_get_bool(unwrapping_key_obj->template, CKA_UNWRAP,
-                                     &flag);
+    rc = object_get_usage(unwrapping_key_obj, CKA_UNWRAP, &flag);
     if (rc != CKR_OK) {
         TRACE_ERROR("Could not find CKA_UNWRAP for the key.\n");
         rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -1610,14 +1607,13 @@ CK_RV key_mgr_derive_key(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    if (!key_object_is_mechanism_allowed(base_key_obj->template,
-                                         mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, base_key_obj, mech->mechanism)) {
         TRACE_ERROR("Mechanism not allowed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
     }
 
-    rc = template_attribute_get_bool(base_key_obj->template, CKA_DERIVE, &flag);
+    rc = object_get_usage(base_key_obj, CKA_DERIVE, &flag);
     if (rc != CKR_OK) {
         TRACE_ERROR("Could not find CKA_DERIVE for the base key.\n");
         rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -108,7 +108,7 @@ static inline void list_insert_head(list_t *list, list_entry_t *new)
 
 /*
  * Insert a element at the end.
- * (currently unused)
+ */
 static inline void list_insert_tail(list_t *list, list_entry_t *new)
 {
     if (!list->tail) {
@@ -122,7 +122,6 @@ static inline void list_insert_tail(list_t *list, list_entry_t *new)
     }
     new->list = list;
 }
- */
 
 /*
  * Remove an element.
@@ -317,6 +317,8 @@ CK_RV delete_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     else
         unlink(fname);
 
+    obj_cache_remove(tokdata, obj->name);
+
     return CKR_OK;
 }
 
@@ -340,6 +342,11 @@ CK_RV delete_token_data(STDLL_TokData_t *tokdata)
     if (system(cmd))
         TRACE_ERROR("system() failed.\n");
 
+    if (XProcLock(tokdata) == CKR_OK) {
+        obj_cache_clear(tokdata);
+        XProcUnLock(tokdata);
+    }
+
 done:
     free(cmd);
 
@@ -1892,6 +1899,29 @@ done:
     return rc;
 }
 
+/*
+ * Seals data with AES-256-GCM under the token master key, e.g. for the
+ * object cache. The master key must be loaded.
+ */
+CK_RV master_key_seal(STDLL_TokData_t *tokdata, unsigned char *out,
+                      unsigned char tag[16], const unsigned char *aad,
+                      size_t aadlen, const unsigned char *in, size_t inlen,
+                      const unsigned char iv[12])
+{
+    return aes_256_gcm_seal(tokdata, out, tag, aad, aadlen, in, inlen,
+                            tokdata->master_key, iv);
+}
+
+CK_RV master_key_unseal(STDLL_TokData_t *tokdata, unsigned char *out,
+                        const unsigned char *aad, size_t aadlen,
+                        const unsigned char *in, size_t inlen,
+                        const unsigned char tag[16],
+                        const unsigned char iv[12])
+{
+    return aes_256_gcm_unseal(tokdata, out, aad, aadlen, in, inlen, tag,
+                              tokdata->master_key, iv);
+}
+
 static CK_RV aes_256_wrap(STDLL_TokData_t *tokdata,
                           unsigned char out[40],
                           const unsigned char in[32],
@@ -2599,6 +2629,8 @@ do_work:
     fclose(fp);
     fp = NULL;
 
+    obj_cache_put(tokdata, fname, TRUE, obj_data, obj_data_len);
+
     rc = CKR_OK;
 done:
     if (fp)
@@ -2617,11 +2649,13 @@ CK_RV load_private_token_objects(STDLL_TokData_t *tokdata)
 {
     FILE *fp1 = NULL, *fp2 = NULL;
     CK_BYTE *buf = NULL;
+    CK_BYTE *cached;
     char tmp[PATH_MAX];
     char iname[PATH_MAX];
     char fname[PATH_MAX];
     CK_BBOOL priv;
     CK_ULONG_32 size;
+    CK_ULONG cached_len;
     CK_RV rc;
     unsigned char header[HEADER_LEN], footer[FOOTER_LEN];
     uint32_t len;
@@ -2636,6 +2670,19 @@ CK_RV load_private_token_objects(STDLL_TokData_t *tokdata)
     while (fgets(tmp, 50, fp1)) {
         tmp[strlen(tmp) - 1] = 0;
 
+        /* Use the decrypted object from the object cache if possible */
+        if (get_token_object_path(fname, sizeof(fname), tokdata, tmp) >= 0) {
+            cached = obj_cache_get(tokdata, fname, OBJ_CACHE_PRIVATE,
+                                   &cached_len);
+            if (cached != NULL) {
+                rc = object_mgr_restore_obj_withSize(tokdata, cached, NULL,
+                                                     cached_len, fname);
+                free(cached);
+                if (rc == CKR_OK)
+                    continue;
+            }
+        }
+
         fp2 = open_token_object_path(fname, sizeof(fname), tokdata, tmp,"r");
         if (!fp2)
             continue;
@@ -2751,6 +2798,11 @@ CK_RV restore_private_token_object(STDLL_TokData_t *tokdata,
         goto done;
     }
 
+    if (XProcLock(tokdata) == CKR_OK) {
+        obj_cache_put(tokdata, fname, TRUE, buff, len);
+        XProcUnLock(tokdata);
+    }
+
     rc = CKR_OK;
 done:
     if (buff)
@@ -2763,6 +2815,7 @@ CK_RV reload_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     unsigned char header[HEADER_LEN], footer[FOOTER_LEN];
     FILE *fp = NULL;
     CK_BYTE *buf = NULL;
+    CK_BYTE *cached;
     char fname[PATH_MAX];
     CK_BBOOL priv;
     CK_ULONG_32 size;
@@ -2778,6 +2831,26 @@ CK_RV reload_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
     strncat(fname, (char *) obj->name, 8);
 
+    /*
+     * Use the object from the object cache if possible. Private objects are
+     * only reloaded while a user is logged in.
+     */
+    if (tokdata->obj_cache != NULL && XProcLock(tokdata) == CKR_OK) {
+        cached = obj_cache_get(tokdata, fname, OBJ_CACHE_PUBLIC |
+                               (session_mgr_user_session_exists(tokdata) ?
+                                                    OBJ_CACHE_PRIVATE : 0),
+                               &size_64);
+        rc = CKR_FUNCTION_FAILED;
+        if (cached != NULL) {
+            rc = object_mgr_restore_obj_withSize(tokdata, cached, obj,
+                                                 size_64, fname);
+            free(cached);
+        }
+        XProcUnLock(tokdata);
+        if (rc == CKR_OK)
+            return CKR_OK;
+    }
+
     fp = fopen(fname, "r");
     if (!fp) {
         TRACE_ERROR("fopen(%s): %s\n", fname, strerror(errno));
@@ -2857,6 +2930,10 @@ CK_RV reload_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
                                           footer, obj, fname);
     } else {
         rc = object_mgr_restore_obj(tokdata, buf, obj, fname);
+        if (rc == CKR_OK && XProcLock(tokdata) == CKR_OK) {
+            obj_cache_put(tokdata, fname, FALSE, buf, size_64);
+            XProcUnLock(tokdata);
+        }
     }
 done:
     if (fp)
@@ -2919,6 +2996,8 @@ CK_RV save_public_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     fclose(fp);
     fp = NULL;
 
+    obj_cache_put(tokdata, fname, FALSE, clear, clear_len);
+
     rc = CKR_OK;
 done:
     if (fp)
@@ -2935,11 +3014,14 @@ CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
 {
     FILE *fp1 = NULL, *fp2 = NULL;
     CK_BYTE *buf = NULL;
+    CK_BYTE *cached;
     char tmp[PATH_MAX];
     char iname[PATH_MAX];
     char fname[PATH_MAX];
     CK_BBOOL priv;
     CK_ULONG_32 size;
+    CK_ULONG cached_len;
+    CK_RV rc;
     unsigned char header[PUB_HEADER_LEN];
     uint32_t ver;
 
@@ -2956,6 +3038,15 @@ CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
         sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
         strcat(fname, tmp);
 
+        cached = obj_cache_get(tokdata, fname, OBJ_CACHE_PUBLIC, &cached_len);
+        if (cached != NULL) {
+            rc = object_mgr_restore_obj_withSize(tokdata, cached, NULL,
+                                                 cached_len, fname);
+            free(cached);
+            if (rc == CKR_OK)
+                continue;
+        }
+
         fp2 = fopen(fname, "r");
         if (!fp2)
             continue;
@@ -3012,6 +3103,8 @@ CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
             OCK_SYSLOG(LOG_ERR,
                        "Cannot restore token object %s "
                        "(ignoring it)", fname);
+        } else {
+            obj_cache_put(tokdata, fname, FALSE, buf, size);
         }
         free(buf);
         fclose(fp2);
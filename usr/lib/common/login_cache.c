@@ -0,0 +1,261 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  login_cache.c
+//
+// Optional cache of the wrapping key derived from the SO or user PIN at
+// login, enabled with the 'logincache' slot option. Deriving the login and
+// wrapping keys from the PIN (PBKDF2) is expensive by design, and is
+// otherwise done by every process that logs in to the token.
+//
+// After a successful login, the wrapping key is stored in the kernel's user
+// keyring of the calling user, with the configured lifetime as key timeout.
+// Thus, only processes running under the same user id can read the entry.
+// The PIN is still verified by deriving the login key from it as usual, the
+// entry holds no cheaper PIN verifier. A later login by any of those
+// processes only skips the derivation of the wrapping key, if the derived
+// login key matches the cached one, and the cached login key and wrapping
+// key parameters still match the token data. The entry is invalidated on
+// C_Logout, and when the PIN is changed or the token is re-initialized.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if !defined(_AIX)
+#include <sys/syscall.h>
+#include <linux/keyctl.h>
+#endif
+
+#include <openssl/crypto.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "tok_spec_struct.h"
+#include "trace.h"
+
+#define LOGIN_CACHE_VERSION         2
+#define LOGIN_CACHE_KEY_TYPE        "user"
+/* Possessor: all, user: view, read, write, search, setattr */
+#define LOGIN_CACHE_KEY_PERM        0x3f2f0000
+
+struct login_cache_entry {
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t wrap_it;
+    CK_BYTE wrap_salt[64];
+    CK_BYTE login_key[32];
+    CK_BYTE wrap_key[32];
+};
+
+#if !defined(_AIX)
+
+static long login_cache_keyctl(int cmd, unsigned long arg2,
+                               unsigned long arg3, unsigned long arg4)
+{
+    return syscall(__NR_keyctl, cmd, arg2, arg3, arg4, 0UL);
+}
+
+static CK_RV login_cache_desc(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                              char *desc, size_t desc_len)
+{
+    int len;
+
+    len = snprintf(desc, desc_len, "opencryptoki:login:%s:%s",
+                   userType == CKU_SO ? "so" : "user", tokdata->data_store);
+    if (len < 0 || (size_t)len >= desc_len)
+        return CKR_FUNCTION_FAILED;
+
+    return CKR_OK;
+}
+
+static long login_cache_search(STDLL_TokData_t *tokdata,
+                               CK_USER_TYPE userType)
+{
+    char desc[PATH_MAX];
+
+    if (login_cache_desc(tokdata, userType, desc, sizeof(desc)) != CKR_OK)
+        return -1;
+
+    return login_cache_keyctl(KEYCTL_SEARCH, KEY_SPEC_USER_KEYRING,
+                              (unsigned long)LOGIN_CACHE_KEY_TYPE,
+                              (unsigned long)desc);
+}
+
+static void login_cache_params(STDLL_TokData_t *tokdata,
+                               CK_USER_TYPE userType,
+                               const CK_BYTE **login_key,
+                               const CK_BYTE **wrap_salt, uint64_t *wrap_it)
+{
+    TOKEN_DATA_VERSION *dat = &tokdata->nv_token_data->dat;
+
+    if (userType == CKU_SO) {
+        *login_key = dat->so_login_key;
+        *wrap_salt = dat->so_wrap_salt;
+        *wrap_it = dat->so_wrap_it;
+    } else {
+        *login_key = dat->user_login_key;
+        *wrap_salt = dat->user_wrap_salt;
+        *wrap_it = dat->user_wrap_it;
+    }
+}
+
+/*
+ * Looks up the wrapping key cached at a previous login. The login key must
+ * have been derived from the PIN and verified against the token data by the
+ * caller. Returns CKR_OK and the wrapping key if a valid entry for this
+ * login key exists, an error otherwise. The caller must then derive the
+ * wrapping key from the PIN.
+ */
+CK_RV login_cache_get(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                      const CK_BYTE *login_key, CK_BYTE *wrap_key)
+{
+    struct login_cache_entry entry;
+    const CK_BYTE *tok_login_key, *tok_wrap_salt;
+    uint64_t tok_wrap_it;
+    long id, len;
+    CK_RV rc = CKR_FUNCTION_FAILED;
+
+    if (tokdata->login_cache_timeout == 0)
+        return CKR_FUNCTION_NOT_SUPPORTED;
+
+    id = login_cache_search(tokdata, userType);
+    if (id < 0) {
+        TRACE_DEVEL("%s no entry: %s\n", __func__, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    len = login_cache_keyctl(KEYCTL_READ, id, (unsigned long)&entry,
+                             sizeof(entry));
+    if (len != (long)sizeof(entry) || entry.version != LOGIN_CACHE_VERSION) {
+        TRACE_DEVEL("%s invalid entry\n", __func__);
+        goto out;
+    }
+
+    login_cache_params(tokdata, userType, &tok_login_key, &tok_wrap_salt,
+                       &tok_wrap_it);
+    if (CRYPTO_memcmp(entry.login_key, tok_login_key, 32) != 0 ||
+        CRYPTO_memcmp(entry.login_key, login_key, 32) != 0 ||
+        memcmp(entry.wrap_salt, tok_wrap_salt, 64) != 0 ||
+        entry.wrap_it != tok_wrap_it) {
+        TRACE_DEVEL("%s stale entry\n", __func__);
+        goto out;
+    }
+
+    memcpy(wrap_key, entry.wrap_key, 32);
+    TRACE_DEVEL("%s using cached wrapping key\n", __func__);
+    rc = CKR_OK;
+
+out:
+    OPENSSL_cleanse(&entry, sizeof(entry));
+
+    return rc;
+}
+
+/*
+ * Stores the wrapping key derived from the PIN after a successful login.
+ * Failures are not fatal, the next login derives the key again.
+ */
+void login_cache_put(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                     const CK_BYTE *login_key, const CK_BYTE *wrap_key)
+{
+    struct login_cache_entry entry;
+    const CK_BYTE *tok_login_key, *tok_wrap_salt;
+    char desc[PATH_MAX];
+    long id;
+
+    if (tokdata->login_cache_timeout == 0)
+        return;
+
+    if (login_cache_desc(tokdata, userType, desc, sizeof(desc)) != CKR_OK)
+        return;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.version = LOGIN_CACHE_VERSION;
+    login_cache_params(tokdata, userType, &tok_login_key, &tok_wrap_salt,
+                       &entry.wrap_it);
+    memcpy(entry.wrap_salt, tok_wrap_salt, 64);
+    memcpy(entry.login_key, login_key, 32);
+    memcpy(entry.wrap_key, wrap_key, 32);
+
+    id = syscall(__NR_add_key, LOGIN_CACHE_KEY_TYPE, desc, &entry,
+                 sizeof(entry), KEY_SPEC_USER_KEYRING);
+    if (id < 0) {
+        TRACE_WARNING("%s add_key failed: %s\n", __func__, strerror(errno));
+        goto out;
+    }
+
+    if (login_cache_keyctl(KEYCTL_SETPERM, id, LOGIN_CACHE_KEY_PERM, 0) < 0 ||
+        login_cache_keyctl(KEYCTL_SET_TIMEOUT, id,
+                           tokdata->login_cache_timeout, 0) < 0) {
+        TRACE_WARNING("%s keyctl failed: %s\n", __func__, strerror(errno));
+        login_cache_keyctl(KEYCTL_INVALIDATE, id, 0, 0);
+        goto out;
+    }
+
+    TRACE_DEVEL("%s cached wrapping key for %lu seconds\n", __func__,
+                tokdata->login_cache_timeout);
+
+out:
+    OPENSSL_cleanse(&entry, sizeof(entry));
+}
+
+/* Removes the cached wrapping key of the given user type, if any */
+void login_cache_revoke(STDLL_TokData_t *tokdata, CK_USER_TYPE userType)
+{
+    long id;
+
+    if (tokdata->login_cache_timeout == 0)
+        return;
+
+    id = login_cache_search(tokdata, userType);
+    if (id < 0)
+        return;
+
+    if (login_cache_keyctl(KEYCTL_INVALIDATE, id, 0, 0) < 0)
+        TRACE_WARNING("%s keyctl failed: %s\n", __func__, strerror(errno));
+}
+
+#else
+
+CK_RV login_cache_get(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                      const CK_BYTE *login_key, CK_BYTE *wrap_key)
+{
+    UNUSED(tokdata);
+    UNUSED(userType);
+    UNUSED(login_key);
+    UNUSED(wrap_key);
+
+    return CKR_FUNCTION_NOT_SUPPORTED;
+}
+
+void login_cache_put(STDLL_TokData_t *tokdata, CK_USER_TYPE userType,
+                     const CK_BYTE *login_key, const CK_BYTE *wrap_key)
+{
+    UNUSED(tokdata);
+    UNUSED(userType);
+    UNUSED(login_key);
+    UNUSED(wrap_key);
+}
+
+void login_cache_revoke(STDLL_TokData_t *tokdata, CK_USER_TYPE userType)
+{
+    UNUSED(tokdata);
+    UNUSED(userType);
+}
+
+#endif
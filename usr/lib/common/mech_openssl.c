@@ -132,56 +132,27 @@ static CK_BBOOL openssl_need_wr_lock(OBJECT *obj, void *ex_data,
     return data->pkey == NULL;
 }
 
-CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
+/*
+ * Generates an RSA key with the specified modulus size and public exponent.
+ */
+CK_RV openssl_specific_rsa_generate_pkey(CK_ULONG mod_bits,
+                                         const CK_BYTE *publ_exp,
+                                         CK_ULONG publ_exp_len,
+                                         EVP_PKEY **pkey)
 {
-    CK_ATTRIBUTE *publ_exp = NULL;
-    CK_ATTRIBUTE *attr = NULL;
-    CK_ULONG mod_bits;
-    CK_BBOOL flag;
-    CK_RV rc;
-    CK_ULONG BNLength;
-#if !OPENSSL_VERSION_PREREQ(3, 0)
-    const RSA *rsa = NULL;
-    const BIGNUM *bignum = NULL;
-#else
-    BIGNUM *bignum = NULL;
+#if OPENSSL_VERSION_PREREQ(3, 0)
     int try;
 #endif
-    CK_BYTE *ssl_ptr = NULL;
     BIGNUM *e = NULL;
-    EVP_PKEY *pkey = NULL;
     EVP_PKEY_CTX *ctx = NULL;
-
-    rc = template_attribute_get_ulong(publ_tmpl, CKA_MODULUS_BITS, &mod_bits);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
-        return CKR_TEMPLATE_INCOMPLETE; // should never happen
-    }
-
-    // we don't support less than 512 bit keys in the sw
-    if (mod_bits < 512 || mod_bits > OPENSSL_RSA_MAX_MODULUS_BITS) {
-        TRACE_ERROR("%s\n", ock_err(ERR_KEY_SIZE_RANGE));
-        return CKR_KEY_SIZE_RANGE;
-    }
-
-    rc = template_attribute_get_non_empty(publ_tmpl, CKA_PUBLIC_EXPONENT,
-                                          &publ_exp);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
-        return CKR_TEMPLATE_INCOMPLETE;
-    }
-
-    if (publ_exp->ulValueLen > sizeof(CK_ULONG)) {
-        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
-        return CKR_ATTRIBUTE_VALUE_INVALID;
-    }
+    CK_RV rc = CKR_OK;
 
     e = BN_new();
     if (e == NULL) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         return CKR_HOST_MEMORY;
     }
-    BN_bin2bn(publ_exp->pValue, publ_exp->ulValueLen, e);
+    BN_bin2bn(publ_exp, publ_exp_len, e);
 
     ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
     if (ctx == NULL) {
@@ -219,7 +190,7 @@ CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
      * fail to generate a key. Retry up to 10 times in such a case.
      */
     for (try = 1; try <= 10; try++) {
-        if (EVP_PKEY_keygen(ctx, &pkey) == 1) {
+        if (EVP_PKEY_keygen(ctx, pkey) == 1) {
             rc = CKR_OK;
             break;
         }
@@ -230,12 +201,41 @@ CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
     if (rc != CKR_OK)
         goto done;
 #else
-    if (EVP_PKEY_keygen(ctx, &pkey) != 1) {
+    if (EVP_PKEY_keygen(ctx, pkey) != 1) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 #endif
+
+done:
+    if (ctx != NULL)
+        EVP_PKEY_CTX_free(ctx);
+    if (e != NULL)
+        BN_free(e);
+    return rc;
+}
+
+/*
+ * Adds the key components of a generated RSA key to the public and private
+ * key templates.
+ */
+CK_RV openssl_specific_rsa_keygen_from_pkey(EVP_PKEY *pkey,
+                                            TEMPLATE *publ_tmpl,
+                                            TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *attr = NULL;
+    CK_BBOOL flag;
+    CK_RV rc;
+    CK_ULONG BNLength;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    const RSA *rsa = NULL;
+    const BIGNUM *bignum = NULL;
+#else
+    BIGNUM *bignum = NULL;
+#endif
+    CK_BYTE *ssl_ptr = NULL;
+
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     if ((rsa = EVP_PKEY_get0_RSA(pkey)) == NULL) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
@@ -632,12 +632,6 @@ done:
         OPENSSL_cleanse(ssl_ptr, BNLength);
         free(ssl_ptr);
     }
-    if (pkey != NULL)
-        EVP_PKEY_free(pkey);
-    if (ctx != NULL)
-        EVP_PKEY_CTX_free(ctx);
-    if (e != NULL)
-        BN_free(e);
 #if OPENSSL_VERSION_PREREQ(3, 0)
     if (bignum != NULL)
         BN_free(bignum);
@@ -645,6 +639,49 @@ done:
     return rc;
 }
 
+CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *publ_exp = NULL;
+    CK_ULONG mod_bits;
+    EVP_PKEY *pkey = NULL;
+    CK_RV rc;
+
+    rc = template_attribute_get_ulong(publ_tmpl, CKA_MODULUS_BITS, &mod_bits);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
+        return CKR_TEMPLATE_INCOMPLETE; // should never happen
+    }
+
+    // we don't support less than 512 bit keys in the sw
+    if (mod_bits < 512 || mod_bits > OPENSSL_RSA_MAX_MODULUS_BITS) {
+        TRACE_ERROR("%s\n", ock_err(ERR_KEY_SIZE_RANGE));
+        return CKR_KEY_SIZE_RANGE;
+    }
+
+    rc = template_attribute_get_non_empty(publ_tmpl, CKA_PUBLIC_EXPONENT,
+                                          &publ_exp);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    if (publ_exp->ulValueLen > sizeof(CK_ULONG)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+    }
+
+    rc = openssl_specific_rsa_generate_pkey(mod_bits, publ_exp->pValue,
+                                            publ_exp->ulValueLen, &pkey);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_rsa_keygen_from_pkey(pkey, publ_tmpl, priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
 // convert from the local PKCS11 template representation to
 // the underlying requirement
 // returns the pointer to the local key representation
@@ -2348,45 +2385,18 @@ out:
     return CKR_OK;
 }
 
-CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
-                                           TEMPLATE *publ_tmpl,
-                                           TEMPLATE *priv_tmpl)
+/*
+ * Generates an EC key on the curve specified by its OpenSSL NID.
+ */
+CK_RV openssl_specific_ec_generate_pkey(int nid, EVP_PKEY **pkey)
 {
-
-    CK_ATTRIBUTE *attr = NULL, *ec_point_attr, *value_attr, *parms_attr;
-#if !OPENSSL_VERSION_PREREQ(3, 0)
-    const EC_KEY *ec_key = NULL;
-    BN_CTX *bnctx = NULL;
-#else
-    BIGNUM *bn_d = NULL;
-    int len;
-#endif
-    CK_BYTE *ecpoint = NULL, *enc_ecpoint = NULL, *d = NULL;
-    CK_ULONG enc_ecpoint_len, d_len;
-    size_t ecpoint_len;
     EVP_PKEY_CTX *ctx = NULL;
-    EVP_PKEY *ec_pkey = NULL;
-    int nid;
-    CK_RV rc;
-
-    UNUSED(tokdata);
-
-    rc = template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS, &attr);
-    if (rc != CKR_OK)
-        goto out;
-
-    nid = curve_nid_from_params(attr->pValue, attr->ulValueLen);
-    if (nid == NID_undef) {
-        TRACE_ERROR("curve not supported by OpenSSL.\n");
-        rc = CKR_CURVE_NOT_SUPPORTED;
-        goto out;
-    }
+    CK_RV rc = CKR_OK;
 
     ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
     if (ctx == NULL) {
         TRACE_ERROR("EVP_PKEY_CTX_new failed\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
+        return CKR_FUNCTION_FAILED;
     }
 
     if (EVP_PKEY_keygen_init(ctx) <= 0) {
@@ -2401,7 +2411,7 @@ CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
         goto out;
     }
 
-    if (EVP_PKEY_keygen(ctx, &ec_pkey) <= 0) {
+    if (EVP_PKEY_keygen(ctx, pkey) <= 0) {
         TRACE_ERROR("EVP_PKEY_keygen failed\n");
         if (ERR_GET_REASON(ERR_peek_last_error()) == EC_R_INVALID_CURVE)
             rc = CKR_CURVE_NOT_SUPPORTED;
@@ -2410,6 +2420,47 @@ CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
         goto out;
     }
 
+out:
+    EVP_PKEY_CTX_free(ctx);
+
+    return rc;
+}
+
+/*
+ * Adds the key components of a generated EC key to the public and private
+ * key templates. The public key template must contain the CKA_ECDSA_PARAMS
+ * of the curve the key was generated on.
+ */
+CK_RV openssl_specific_ec_keygen_from_pkey(EVP_PKEY *ec_pkey,
+                                           TEMPLATE *publ_tmpl,
+                                           TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *attr = NULL, *ec_point_attr, *value_attr, *parms_attr;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    const EC_KEY *ec_key = NULL;
+    BN_CTX *bnctx = NULL;
+#else
+    BIGNUM *bn_d = NULL;
+    int nid, len;
+#endif
+    CK_BYTE *ecpoint = NULL, *enc_ecpoint = NULL, *d = NULL;
+    CK_ULONG enc_ecpoint_len, d_len;
+    size_t ecpoint_len;
+    CK_RV rc;
+
+    rc = template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS, &attr);
+    if (rc != CKR_OK)
+        goto out;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    nid = curve_nid_from_params(attr->pValue, attr->ulValueLen);
+    if (nid == NID_undef) {
+        TRACE_ERROR("curve not supported by OpenSSL.\n");
+        rc = CKR_CURVE_NOT_SUPPORTED;
+        goto out;
+    }
+#endif
+
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     ec_key = EVP_PKEY_get0_EC_KEY(ec_pkey);
     if (ec_key == NULL) {
@@ -2538,8 +2589,6 @@ CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
     rc = CKR_OK;
 
 out:
-    if (ctx != NULL)
-        EVP_PKEY_CTX_free(ctx);
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     if (bnctx != NULL)
         BN_CTX_free(bnctx);
@@ -2547,8 +2596,6 @@ out:
     if (bn_d != NULL)
         BN_free(bn_d);
 #endif
-    if (ec_pkey != NULL)
-        EVP_PKEY_free(ec_pkey);
     if (ecpoint != NULL)
         OPENSSL_free(ecpoint);
     if (enc_ecpoint != NULL)
@@ -2559,6 +2606,38 @@ out:
     return rc;
 }
 
+CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
+                                           TEMPLATE *publ_tmpl,
+                                           TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *attr = NULL;
+    EVP_PKEY *ec_pkey = NULL;
+    int nid;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+
+    rc = template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS, &attr);
+    if (rc != CKR_OK)
+        return rc;
+
+    nid = curve_nid_from_params(attr->pValue, attr->ulValueLen);
+    if (nid == NID_undef) {
+        TRACE_ERROR("curve not supported by OpenSSL.\n");
+        return CKR_CURVE_NOT_SUPPORTED;
+    }
+
+    rc = openssl_specific_ec_generate_pkey(nid, &ec_pkey);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_ec_keygen_from_pkey(ec_pkey, publ_tmpl, priv_tmpl);
+
+    EVP_PKEY_free(ec_pkey);
+
+    return rc;
+}
+
 CK_RV openssl_specific_ec_sign(STDLL_TokData_t *tokdata,  SESSION *sess,
                                CK_BYTE *in_data, CK_ULONG in_data_len,
                                CK_BYTE *out_data, CK_ULONG *out_data_len,
@@ -3071,6 +3150,23 @@ static void openssl_specific_sha_free(STDLL_TokData_t *tokdata, SESSION *sess,
 
     EVP_MD_CTX_free((EVP_MD_CTX *)context);
 }
+
+static CK_RV openssl_specific_sha_reset(STDLL_TokData_t *tokdata,
+                                        SESSION *sess, CK_BYTE *context,
+                                        CK_ULONG context_len)
+{
+    UNUSED(tokdata);
+    UNUSED(sess);
+    UNUSED(context_len);
+
+    /* A NULL type keeps the digest that the context already has */
+    if (!EVP_DigestInit_ex((EVP_MD_CTX *)context, NULL, NULL)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
 #endif
 
 CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
@@ -3113,6 +3209,7 @@ CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
 
     ctx->state_unsaveable = CK_TRUE;
     ctx->context_free_func = openssl_specific_sha_free;
+    ctx->context_reset_func = openssl_specific_sha_reset;
 #endif
 
     return CKR_OK;
@@ -3155,6 +3252,13 @@ CK_RV openssl_specific_sha(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
     }
 
     *out_data_len = len;
+
+out:
+    EVP_MD_CTX_free(md_ctx);
+    free(ctx->context);
+    ctx->context = NULL;
+    ctx->context_len = 0;
+    ctx->context_free_func = NULL;
 #else
     if (*out_data_len < (CK_ULONG)EVP_MD_CTX_size((EVP_MD_CTX *)ctx->context)) {
         TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
@@ -3163,24 +3267,21 @@ CK_RV openssl_specific_sha(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
 
     len = *out_data_len;
     if (!EVP_DigestUpdate((EVP_MD_CTX *)ctx->context, in_data, in_data_len) ||
-        !EVP_DigestFinal((EVP_MD_CTX *)ctx->context, out_data, &len)) {
+        !EVP_DigestFinal_ex((EVP_MD_CTX *)ctx->context, out_data, &len)) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
         return CKR_FUNCTION_FAILED;
     }
 
     *out_data_len = len;
-#endif
 
-#if !OPENSSL_VERSION_PREREQ(3, 0)
-out:
-    EVP_MD_CTX_free(md_ctx);
-    free(ctx->context);
-#else
-    EVP_MD_CTX_free((EVP_MD_CTX *)ctx->context);
+    /*
+     * The MD context is left to digest_mgr_cleanup(), which either frees it,
+     * or keeps it in the session for reuse by the next digest operation.
+     * EVP_DigestFinal_ex() is used, because EVP_DigestFinal() also resets
+     * the digest of the context, which makes openssl_specific_sha_reset()
+     * fail.
+     */
 #endif
-    ctx->context = NULL;
-    ctx->context_len = 0;
-    ctx->context_free_func = NULL;
 
     return rc;
 }
@@ -3279,17 +3380,14 @@ out:
     }
 
     len = *out_data_len;
-    if (!EVP_DigestFinal((EVP_MD_CTX *)ctx->context, out_data, &len)) {
+    if (!EVP_DigestFinal_ex((EVP_MD_CTX *)ctx->context, out_data, &len)) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
         return CKR_FUNCTION_FAILED;
     }
 
     *out_data_len = len;
 
-    EVP_MD_CTX_free((EVP_MD_CTX *)ctx->context);
-    ctx->context = NULL;
-    ctx->context_len = 0;
-    ctx->context_free_func = NULL;
+    /* The MD context is left to digest_mgr_cleanup(), see above */
 #endif
 
     return rc;
@@ -5782,36 +5880,29 @@ static CK_RV get_key_from_pkey(EVP_PKEY *pkey, const char *param,
     return CKR_OK;
 }
 
-CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
-                                                      const struct pqc_oid *oid,
-                                                      TEMPLATE *publ_tmpl,
-                                                      TEMPLATE *priv_tmpl)
+/*
+ * Generates an IBM Dilithium key of the specified key form via the
+ * oqsprovider.
+ */
+CK_RV openssl_specific_ibm_dilithium_generate_pkey(const struct pqc_oid *oid,
+                                                   EVP_PKEY **pkey)
 {
     EVP_PKEY_CTX *ctx = NULL;
-    EVP_PKEY *pkey = NULL;
     const char *alg_name;
-    CK_BYTE *spki = NULL, *pkcs8 = NULL;
-    CK_ULONG spki_len = 0, pkcs8_len = 0;
-    size_t priv_len = 0, pub_len = 0;
-    CK_BYTE *priv_key = NULL, *pub_key = NULL;
     CK_RV rc = CKR_OK;
 
-    UNUSED(tokdata);
-
     alg_name = openssl_get_pqc_oid_name(oid);
     if (alg_name == NULL) {
         TRACE_ERROR("Dilithium key form '%lu' not supported by oqsprovider\n",
                     oid->keyform);
-        rc = CKR_KEY_SIZE_RANGE;
-        goto out;
+        return CKR_KEY_SIZE_RANGE;
     }
 
     /* Generate key via oqsprovider */
     ctx = EVP_PKEY_CTX_new_from_name(NULL, alg_name, NULL);
     if (ctx == NULL) {
         TRACE_ERROR("EVP_PKEY_CTX_new_from_name failed for '%s'\n", alg_name);
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
+        return CKR_FUNCTION_FAILED;
     }
 
     if (EVP_PKEY_keygen_init(ctx) != 1) {
@@ -5820,12 +5911,33 @@ CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
         goto out;
     }
 
-    if (EVP_PKEY_generate(ctx, &pkey) != 1) {
+    if (EVP_PKEY_generate(ctx, pkey) != 1) {
         TRACE_ERROR("EVP_PKEY_generate failed for '%s'\n", alg_name);
         rc = CKR_FUNCTION_FAILED;
         goto out;
     }
 
+out:
+    EVP_PKEY_CTX_free(ctx);
+
+    return rc;
+}
+
+/*
+ * Adds the key components of a generated IBM Dilithium key to the public and
+ * private key templates.
+ */
+CK_RV openssl_specific_ibm_dilithium_keygen_from_pkey(EVP_PKEY *pkey,
+                                                      const struct pqc_oid *oid,
+                                                      TEMPLATE *publ_tmpl,
+                                                      TEMPLATE *priv_tmpl)
+{
+    CK_BYTE *spki = NULL, *pkcs8 = NULL;
+    CK_ULONG spki_len = 0, pkcs8_len = 0;
+    size_t priv_len = 0, pub_len = 0;
+    CK_BYTE *priv_key = NULL, *pub_key = NULL;
+    CK_RV rc = CKR_OK;
+
     /* Get private and public key */
     rc = get_key_from_pkey(pkey, OSSL_PKEY_PARAM_PRIV_KEY,
                            &priv_key, &priv_len);
@@ -5903,10 +6015,6 @@ CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
     }
 
 out:
-    if (ctx != NULL)
-        EVP_PKEY_CTX_free(ctx);
-    if (pkey != NULL)
-        EVP_PKEY_free(pkey);
     if (priv_key != NULL) {
         OPENSSL_cleanse(priv_key, priv_len);
         free(priv_key);
@@ -5923,6 +6031,28 @@ out:
     return rc;
 }
 
+CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
+                                                      const struct pqc_oid *oid,
+                                                      TEMPLATE *publ_tmpl,
+                                                      TEMPLATE *priv_tmpl)
+{
+    EVP_PKEY *pkey = NULL;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+
+    rc = openssl_specific_ibm_dilithium_generate_pkey(oid, &pkey);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_ibm_dilithium_keygen_from_pkey(pkey, oid, publ_tmpl,
+                                                         priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
 CK_RV openssl_make_ibm_dilithium_key_from_template(TEMPLATE *tmpl,
                                                    const struct pqc_oid *oid,
                                                    CK_BBOOL private_key,
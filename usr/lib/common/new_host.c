@@ -89,11 +89,13 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    rc = bt_init(&sltp->TokData->sess_btree, free);
-    rc |= bt_init(&sltp->TokData->object_map_btree, free);
-    rc |= bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
-    rc |= bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
-    rc |= bt_init(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    rc = slab_mgr_init(sltp->TokData);
+    rc |= bt_init_epoch(&sltp->TokData->sess_btree, slab_free);
+    rc |= bt_init_epoch(&sltp->TokData->object_map_btree, slab_free);
+    rc |= bt_init_epoch(&sltp->TokData->sess_obj_btree, call_object_free);
+    rc |= bt_init_epoch(&sltp->TokData->priv_token_obj_btree, call_object_free);
+    rc |= bt_init_epoch(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    rc |= async_mgr_init(sltp->TokData);
     if (rc != CKR_OK) {
         TRACE_ERROR("Btree init failed\n");
         rc = CKR_FUNCTION_FAILED;
@@ -122,6 +124,8 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     }
 
     sltp->TokData->version = sinfp->version;
+    sltp->TokData->obj_cache_size = sinfp->objcache;
+    sltp->TokData->login_cache_timeout = sinfp->logincache;
     TRACE_DEVEL("Token version: %u.%u\n",
                 (unsigned int)(sinfp->version >> 16),
                 (unsigned int)(sinfp->version & 0xffff));
@@ -183,6 +187,12 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
         goto done;
     }
 
+    rc = obj_cache_attach(sltp->TokData);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("Failed to attach to the object cache.\n");
+        goto done;
+    }
+
     rc = XProcLock(sltp->TokData);
     if (rc != CKR_OK)
         goto done;
@@ -214,6 +224,8 @@ done:
             bt_destroy(&sltp->TokData->sess_obj_btree);
             bt_destroy(&sltp->TokData->priv_token_obj_btree);
             bt_destroy(&sltp->TokData->publ_token_obj_btree);
+            slab_mgr_final(sltp->TokData);
+            async_mgr_final(sltp->TokData, FALSE);
         }
     }
 
@@ -240,6 +252,9 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
         return CKR_CRYPTOKI_NOT_INITIALIZED;
     }
 
+    /* Complete or cancel outstanding async requests */
+    async_mgr_final(tokdata, in_fork_initializer);
+
     tokdata->initialized = FALSE;
 
     session_mgr_close_all_sessions(tokdata);
@@ -252,6 +267,7 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
     bt_destroy(&tokdata->priv_token_obj_btree);
     bt_destroy(&tokdata->publ_token_obj_btree);
 
+    obj_cache_detach(tokdata, in_fork_initializer);
     detach_shm(tokdata, in_fork_initializer);
     /* close spin lock file */
     CloseXProcLock(tokdata);
@@ -263,6 +279,7 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
         }
     }
 
+    slab_mgr_final(tokdata);
     final_data_store(tokdata);
 
     return rc;
@@ -480,6 +497,8 @@ CK_RV SC_InitToken(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, CK_CHAR_PTR pPin,
      */
     object_mgr_destroy_token_objects(tokdata);
     delete_token_data(tokdata);
+    login_cache_revoke(tokdata, CKU_SO);
+    login_cache_revoke(tokdata, CKU_USER);
 
     load_token_data(tokdata, sid);
     init_slotInfo(&(tokdata->slot_info));
@@ -615,6 +634,8 @@ CK_RV SC_InitPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         }
     }
 
+    login_cache_revoke(tokdata, CKU_USER);
+
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to get process lock.\n");
@@ -822,6 +843,8 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             }
         }
 
+        login_cache_revoke(tokdata, CKU_USER);
+
         rc = XProcLock(tokdata);
         if (rc != CKR_OK) {
             TRACE_DEVEL("Failed to get process lock.\n");
@@ -943,6 +966,8 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             }
         }
 
+        login_cache_revoke(tokdata, CKU_SO);
+
         rc = XProcLock(tokdata);
         if (rc != CKR_OK) {
             TRACE_DEVEL("Failed to get process lock.\n");
@@ -1252,6 +1277,7 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     CK_BYTE hash_sha[SHA1_HASH_SIZE];
     CK_RV rc = CKR_OK;
     unsigned char login_key[32], wrap_key[32];
+    CK_BBOOL cached;
     TOKEN_DATA_VERSION *dat;
 
     /* In v2.11, logins should be exclusive, since token
@@ -1412,15 +1438,6 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->user_wrap_salt, 64,
-                                           dat->user_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
             if (CRYPTO_memcmp(dat->user_login_key,
                               login_key, 256 / 8) != 0) {
                 set_login_flags(userType, flags);
@@ -1429,12 +1446,29 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
+            /* Only the wrapping key is cached, the PIN is always verified */
+            cached = (login_cache_get(tokdata, CKU_USER, login_key,
+                                      wrap_key) == CKR_OK);
+            if (!cached) {
+                rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
+                                               dat->user_wrap_salt, 64,
+                                               dat->user_wrap_it, EVP_sha512(),
+                                               256 / 8, wrap_key);
+                if (rc != CKR_OK) {
+                    TRACE_DEVEL("PBKDF2 failed.\n");
+                    goto done;
+                }
+            }
+
             /* Successful login, clear flags */
             *flags &= ~(CKF_USER_PIN_LOCKED |
                         CKF_USER_PIN_FINAL_TRY | CKF_USER_PIN_COUNT_LOW);
 
             memcpy(tokdata->user_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->so_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, CKU_USER, login_key, wrap_key);
         }
 
         rc = load_masterkey_user(tokdata);
@@ -1516,15 +1550,6 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->so_wrap_salt, 64,
-                                           dat->so_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
             if (CRYPTO_memcmp(dat->so_login_key,
                               login_key, 256 / 8) != 0) {
                 set_login_flags(userType, flags);
@@ -1533,12 +1558,28 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
+            cached = (login_cache_get(tokdata, CKU_SO, login_key,
+                                      wrap_key) == CKR_OK);
+            if (!cached) {
+                rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
+                                               dat->so_wrap_salt, 64,
+                                               dat->so_wrap_it, EVP_sha512(),
+                                               256 / 8, wrap_key);
+                if (rc != CKR_OK) {
+                    TRACE_DEVEL("PBKDF2 failed.\n");
+                    goto done;
+                }
+            }
+
             /* Successful login, clear flags */
             *flags &= ~(CKF_SO_PIN_LOCKED | CKF_SO_PIN_FINAL_TRY |
                         CKF_SO_PIN_COUNT_LOW);
 
             memcpy(tokdata->so_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->user_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, CKU_SO, login_key, wrap_key);
         }
 
         rc = load_masterkey_so(tokdata);
@@ -1697,6 +1738,9 @@ CK_RV SC_Logout(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession)
         goto done;
     }
 
+    login_cache_revoke(tokdata, session_mgr_so_session_exists(tokdata) ?
+                                                        CKU_SO : CKU_USER);
+
     rc = session_mgr_logout_all(tokdata);
     if (rc != CKR_OK)
         TRACE_DEVEL("session_mgr_logout_all failed.\n");
@@ -4232,6 +4276,582 @@ done:
     return rc;
 }
 
+#define BATCH_ITEMS_PER_THREAD      16
+#define BATCH_MAX_THREADS           64
+
+enum batch_op {
+    BATCH_OP_SIGN,
+    BATCH_OP_VERIFY,
+    BATCH_OP_ENCRYPT,
+};
+
+/*
+ * A request of SC_IBM_SignBatch, SC_IBM_VerifyBatch or SC_IBM_EncryptBatch.
+ * The operation is initialized only once into the template context of the
+ * request, every element is then processed with a private copy of it. This
+ * way the key and policy checks are done once per batch, and the elements
+ * can be processed concurrently. Worker threads pick the next unprocessed
+ * element by atomically incrementing 'next'.
+ */
+struct batch_request {
+    STDLL_TokData_t *tokdata;
+    SESSION *sess;
+    enum batch_op op;
+    SIGN_VERIFY_CONTEXT sign_ctx;
+    ENCR_DECR_CONTEXT encr_ctx;
+    CK_IBM_BATCH_ITEM *items;
+    CK_ULONG count;
+    CK_ULONG next;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX *libctx;
+#endif
+};
+
+/*
+ * Duplicates the mechanism parameter and the context of a copied operation
+ * context, so that the copy can be used and cleaned up independently.
+ */
+static CK_RV batch_dup_ctx_data(CK_MECHANISM *mech, CK_BYTE **context,
+                                CK_ULONG context_len)
+{
+    CK_BYTE *param = NULL, *data = NULL;
+
+    if (mech->pParameter != NULL && mech->ulParameterLen > 0) {
+        param = malloc(mech->ulParameterLen);
+        if (param == NULL)
+            goto error;
+        memcpy(param, mech->pParameter, mech->ulParameterLen);
+    }
+
+    if (*context != NULL && context_len > 0) {
+        data = malloc(context_len);
+        if (data == NULL)
+            goto error;
+        memcpy(data, *context, context_len);
+    }
+
+    mech->pParameter = param;
+    *context = data;
+
+    return CKR_OK;
+
+error:
+    TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+    free(param);
+    return CKR_HOST_MEMORY;
+}
+
+static CK_RV batch_process_item(struct batch_request *req,
+                                CK_IBM_BATCH_ITEM *item)
+{
+    SIGN_VERIFY_CONTEXT sign_ctx;
+    ENCR_DECR_CONTEXT encr_ctx;
+    CK_BBOOL length_only = (item->pResult == NULL);
+    CK_RV rc;
+
+    if (item->pData == NULL ||
+        (req->op == BATCH_OP_VERIFY && item->pResult == NULL)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    switch (req->op) {
+    case BATCH_OP_SIGN:
+    case BATCH_OP_VERIFY:
+        sign_ctx = req->sign_ctx;
+        sign_ctx.count_statistics = FALSE;
+        rc = batch_dup_ctx_data(&sign_ctx.mech, &sign_ctx.context,
+                                sign_ctx.context_len);
+        if (rc != CKR_OK)
+            return rc;
+
+        if (req->op == BATCH_OP_SIGN) {
+            rc = sign_mgr_sign(req->tokdata, req->sess, length_only,
+                               &sign_ctx, item->pData, item->ulDataLen,
+                               item->pResult, &item->ulResultLen);
+            if (rc != CKR_OK)
+                TRACE_DEVEL("sign_mgr_sign() failed.\n");
+            sign_mgr_cleanup(req->tokdata, req->sess, &sign_ctx);
+        } else {
+            rc = verify_mgr_verify(req->tokdata, req->sess, &sign_ctx,
+                                   item->pData, item->ulDataLen,
+                                   item->pResult, item->ulResultLen);
+            if (rc != CKR_OK)
+                TRACE_DEVEL("verify_mgr_verify() failed.\n");
+            verify_mgr_cleanup(req->tokdata, req->sess, &sign_ctx);
+        }
+        break;
+    case BATCH_OP_ENCRYPT:
+        encr_ctx = req->encr_ctx;
+        encr_ctx.count_statistics = FALSE;
+        rc = batch_dup_ctx_data(&encr_ctx.mech, &encr_ctx.context,
+                                encr_ctx.context_len);
+        if (rc != CKR_OK)
+            return rc;
+
+        rc = encr_mgr_encrypt(req->tokdata, req->sess, length_only,
+                              &encr_ctx, item->pData, item->ulDataLen,
+                              item->pResult, &item->ulResultLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt() failed.\n");
+        encr_mgr_cleanup(req->tokdata, req->sess, &encr_ctx);
+        break;
+    default:
+        rc = CKR_FUNCTION_FAILED;
+        break;
+    }
+
+    return rc;
+}
+
+static void *batch_worker(void *arg)
+{
+    struct batch_request *req = arg;
+    CK_ULONG i;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX_set0_default(req->libctx);
+#endif
+
+    while ((i = __sync_fetch_and_add(&req->next, 1)) < req->count)
+        req->items[i].rv = batch_process_item(req, &req->items[i]);
+
+    return NULL;
+}
+
+/*
+ * Processes all elements of an initialized batch request. Batches with more
+ * than BATCH_ITEMS_PER_THREAD elements are spread over up to
+ * tokdata->batch_threads threads (including the calling thread), if the
+ * token allows this. Returns CKR_OK if all elements were processed
+ * successfully, or the return value of the first failed element otherwise.
+ */
+static CK_RV batch_run(struct batch_request *req)
+{
+    pthread_t threads[BATCH_MAX_THREADS];
+    CK_ULONG num_threads, started = 0, i;
+    context_free_func_t free_func;
+
+    free_func = (req->op == BATCH_OP_ENCRYPT ?
+                        req->encr_ctx.context_free_func :
+                        req->sign_ctx.context_free_func);
+    if (free_func != NULL) {
+        /* The context can not be copied for each element */
+        TRACE_ERROR("Mechanism can not be used with a batch request.\n");
+        return CKR_MECHANISM_INVALID;
+    }
+
+    num_threads = req->count / BATCH_ITEMS_PER_THREAD;
+    if (num_threads > req->tokdata->batch_threads)
+        num_threads = req->tokdata->batch_threads;
+    if (num_threads > BATCH_MAX_THREADS)
+        num_threads = BATCH_MAX_THREADS;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    /* Worker threads must use the library context of the calling thread */
+    req->libctx = OSSL_LIB_CTX_set0_default(NULL);
+#endif
+
+    for (i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, req) != 0) {
+            TRACE_DEVEL("pthread_create failed, using %lu threads\n",
+                        started + 1);
+            break;
+        }
+        started++;
+    }
+
+    batch_worker(req);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < req->count; i++) {
+        if (req->items[i].rv != CKR_OK)
+            return req->items[i].rv;
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV sign_batch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                        CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                        CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount,
+                        CK_BBOOL async)
+{
+    struct batch_request req;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism || (!pItems && ulCount != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    /*
+     * The jobs of async requests can run concurrently on the same session,
+     * its device error is reset when the request is submitted.
+     */
+    if (async)
+        sess = session_mgr_find(tokdata, sSession->sessionh);
+    else
+        sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_SIGN);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tokdata = tokdata;
+    req.sess = sess;
+    req.op = BATCH_OP_SIGN;
+    req.items = pItems;
+    req.count = ulCount;
+
+    req.sign_ctx.count_statistics = TRUE;
+    rc = sign_mgr_init(tokdata, sess, &req.sign_ctx, pMechanism, FALSE, hKey,
+                       TRUE, TRUE);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("sign_mgr_init() failed.\n");
+        goto done;
+    }
+
+    rc = batch_run(&req);
+
+    sign_mgr_cleanup(tokdata, sess, &req.sign_ctx);
+
+done:
+    TRACE_INFO("SC_IBM_SignBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_SignBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                       CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                       CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+    return sign_batch(tokdata, sSession, pMechanism, hKey, pItems, ulCount,
+                      FALSE);
+}
+
+static CK_RV verify_batch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                          CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                          CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount,
+                          CK_BBOOL async)
+{
+    struct batch_request req;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism || (!pItems && ulCount != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (async)
+        sess = session_mgr_find(tokdata, sSession->sessionh);
+    else
+        sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_VERIFY);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tokdata = tokdata;
+    req.sess = sess;
+    req.op = BATCH_OP_VERIFY;
+    req.items = pItems;
+    req.count = ulCount;
+
+    req.sign_ctx.count_statistics = TRUE;
+    rc = verify_mgr_init(tokdata, sess, &req.sign_ctx, pMechanism, FALSE,
+                         hKey, TRUE);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("verify_mgr_init() failed.\n");
+        goto done;
+    }
+
+    rc = batch_run(&req);
+
+    verify_mgr_cleanup(tokdata, sess, &req.sign_ctx);
+
+done:
+    TRACE_INFO("SC_IBM_VerifyBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_VerifyBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                         CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+    return verify_batch(tokdata, sSession, pMechanism, hKey, pItems, ulCount,
+                        FALSE);
+}
+
+static CK_RV encrypt_batch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                           CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                           CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount,
+                           CK_BBOOL async)
+{
+    struct batch_request req;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism || (!pItems && ulCount != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (!encr_mgr_batch_mech_supported(pMechanism->mechanism)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    if (async)
+        sess = session_mgr_find(tokdata, sSession->sessionh);
+    else
+        sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_ENCRYPT);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tokdata = tokdata;
+    req.sess = sess;
+    req.op = BATCH_OP_ENCRYPT;
+    req.items = pItems;
+    req.count = ulCount;
+
+    req.encr_ctx.count_statistics = TRUE;
+    rc = encr_mgr_init(tokdata, sess, &req.encr_ctx, OP_ENCRYPT_INIT,
+                       pMechanism, hKey, TRUE);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("encr_mgr_init() failed.\n");
+        goto done;
+    }
+
+    rc = batch_run(&req);
+
+    encr_mgr_cleanup(tokdata, sess, &req.encr_ctx);
+
+done:
+    TRACE_INFO("SC_IBM_EncryptBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n", rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_EncryptBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                          CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                          CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+    return encrypt_batch(tokdata, sSession, pMechanism, hKey, pItems, ulCount,
+                         FALSE);
+}
+
+/*
+ * A request submitted with SC_IBM_AsyncSubmit. It is processed by the async
+ * executor like a call to the corresponding batch function.
+ */
+struct async_request {
+    struct async_job job;
+    ST_SESSION_T session;
+    CK_IBM_ASYNC_REQUEST_PTR request;
+    ST_AsyncCompletion_t completion;
+    void *context;
+};
+
+static CK_RV async_request_run(STDLL_TokData_t *tokdata, struct async_job *job)
+{
+    struct async_request *areq = container_of(job, struct async_request, job);
+    CK_IBM_ASYNC_REQUEST_PTR req = areq->request;
+
+    switch (req->operation) {
+    case CK_IBM_ASYNC_SIGN:
+        return sign_batch(tokdata, &areq->session, req->pMechanism,
+                          req->hKey, req->pItems, req->ulCount, TRUE);
+    case CK_IBM_ASYNC_VERIFY:
+        return verify_batch(tokdata, &areq->session, req->pMechanism,
+                            req->hKey, req->pItems, req->ulCount, TRUE);
+    case CK_IBM_ASYNC_ENCRYPT:
+        return encrypt_batch(tokdata, &areq->session, req->pMechanism,
+                             req->hKey, req->pItems, req->ulCount, TRUE);
+    default:
+        return CKR_ARGUMENTS_BAD;
+    }
+}
+
+static void async_request_done(STDLL_TokData_t *tokdata, struct async_job *job,
+                               CK_BBOOL notify)
+{
+    struct async_request *areq = container_of(job, struct async_request, job);
+
+    UNUSED(tokdata);
+
+    if (notify) {
+        areq->request->rv = job->rc;
+        areq->completion(areq->request, areq->context);
+    }
+
+    free(areq);
+}
+
+CK_RV SC_IBM_AsyncSubmit(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                         CK_IBM_ASYNC_REQUEST_PTR pRequest,
+                         ST_AsyncCompletion_t completion, void *pContext)
+{
+    struct async_request *areq;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pRequest || !completion || !pRequest->pMechanism ||
+        (!pRequest->pItems && pRequest->ulCount != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    switch (pRequest->operation) {
+    case CK_IBM_ASYNC_SIGN:
+    case CK_IBM_ASYNC_VERIFY:
+        break;
+    case CK_IBM_ASYNC_ENCRYPT:
+        /* Reject it here, so that the caller gets the error synchronously */
+        if (!encr_mgr_batch_mech_supported(pRequest->pMechanism->mechanism)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+            rc = CKR_MECHANISM_INVALID;
+            goto done;
+        }
+        break;
+    default:
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    /* Fail early for an invalid session, it is looked up again later */
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    areq = calloc(1, sizeof(*areq));
+    if (areq == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    areq->job.run = async_request_run;
+    areq->job.done = async_request_done;
+    areq->session = *sSession;
+    areq->request = pRequest;
+    areq->completion = completion;
+    areq->context = pContext;
+
+    rc = async_mgr_submit(tokdata, &areq->job);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("async_mgr_submit() failed.\n");
+        free(areq);
+    }
+
+done:
+    TRACE_INFO("SC_IBM_AsyncSubmit: rc = 0x%08lx, sess = %ld, op = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pRequest ? pRequest->operation : (CK_ULONG)-1));
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
 CK_RV SC_HandleEvent(STDLL_TokData_t *tokdata, unsigned int event_type,
                      unsigned int event_flags, const char *payload,
                      unsigned int payload_len)
@@ -4316,6 +4936,10 @@ void SC_SetFunctionList(void)
     function_list.ST_SessionCancel = SC_SessionCancel;
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
+    function_list.ST_IBM_SignBatch = SC_IBM_SignBatch;
+    function_list.ST_IBM_VerifyBatch = SC_IBM_VerifyBatch;
+    function_list.ST_IBM_EncryptBatch = SC_IBM_EncryptBatch;
+    function_list.ST_IBM_AsyncSubmit = SC_IBM_AsyncSubmit;
 
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
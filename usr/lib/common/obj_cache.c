@@ -0,0 +1,450 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  obj_cache.c
+//
+// Optional cache of decoded token objects, shared by all processes using a
+// token. The cache is a shared memory segment owned by the token group,
+// enabled with the 'objcache' slot option. It holds the flattened object
+// as written by object_flatten(), so that a process restores a token object
+// without reading and parsing its file. Private objects are sealed with
+// AES-256-GCM under the token master key with a random IV and the object
+// name as AAD, so the group can not read them without the user PIN, and a
+// process only needs one decryption instead of unwrapping the object key
+// and decrypting the file.
+//
+// An entry is keyed by the object's file name and is only used as long as
+// the inode, size and modification time of the file are unchanged. Saving
+// a token object updates its entry, deleting it removes the entry. Object
+// data is allocated sequentially from a data area, and the whole cache is
+// reset when the data area or the entry table is full.
+//
+// All accesses are serialized by the token lock (XProcLock).
+//
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <syslog.h>
+#include <sys/stat.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "tok_spec_struct.h"
+#include "trace.h"
+#include "ock_syslog.h"
+#include "shared_memory.h"
+#include "slotmgr.h" // for ock_snprintf
+
+#define OBJ_CACHE_MAGIC         0x4f424a32      /* "OBJ2" */
+#define OBJ_CACHE_NUM_ENTRIES   (4 * MAX_TOK_OBJS)
+#define OBJ_CACHE_NAME_LEN      8
+#define OBJ_CACHE_ALIGN         8
+#define OBJ_CACHE_IV_LEN        12
+#define OBJ_CACHE_TAG_LEN       16
+
+#define OBJ_CACHE_ENTRY_FREE    0
+#define OBJ_CACHE_ENTRY_USED    1
+#define OBJ_CACHE_ENTRY_DELETED 2
+
+struct obj_cache_entry {
+    char name[OBJ_CACHE_NAME_LEN];
+    uint8_t state;
+    uint8_t priv;
+    uint8_t reserved[6];
+    uint64_t ino;               // identity of the token object file
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t offset;            // flattened object in the data area
+    uint64_t len;
+    uint8_t iv[OBJ_CACHE_IV_LEN];       // private objects only
+    uint8_t tag[OBJ_CACHE_TAG_LEN];
+    uint8_t reserved2[4];
+};
+
+struct obj_cache_hdr {
+    uint32_t magic;
+    uint32_t version;           // token version the cache was filled for
+    uint64_t data_size;
+    uint64_t data_used;
+    uint64_t num_used;
+    uint64_t num_deleted;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t resets;
+    struct obj_cache_entry entries[OBJ_CACHE_NUM_ENTRIES];
+    CK_BYTE data[];
+};
+
+static void obj_cache_reset(struct obj_cache_hdr *cache, uint32_t version,
+                            uint64_t data_size)
+{
+    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->magic = OBJ_CACHE_MAGIC;
+    cache->version = version;
+    cache->data_size = data_size;
+    cache->data_used = 0;
+    cache->num_used = 0;
+    cache->num_deleted = 0;
+    cache->resets++;
+}
+
+/* Returns the size of the data area as mapped by this process */
+static uint64_t obj_cache_data_size(STDLL_TokData_t *tokdata)
+{
+    return (uint64_t)tokdata->obj_cache_size * 1024 * 1024;
+}
+
+CK_RV obj_cache_attach(STDLL_TokData_t *tokdata)
+{
+    struct obj_cache_hdr *cache = NULL;
+    char buf[PATH_MAX];
+    uint64_t data_size;
+    size_t len;
+    CK_RV rc;
+    int ret;
+
+    tokdata->obj_cache = NULL;
+
+    if (tokdata->obj_cache_size == 0)
+        return CKR_OK;
+
+    /* Tokens with a remote or an old format object store are not cached */
+    if (token_specific.t_attach_shm != NULL ||
+        tokdata->version < TOK_NEW_DATA_STORE) {
+        TRACE_WARNING("The object cache is not supported by this token.\n");
+        return CKR_OK;
+    }
+
+    if (get_pk_dir(tokdata, buf, sizeof(buf)) == NULL) {
+        TRACE_ERROR("pk_dir buffer overflow");
+        return CKR_FUNCTION_FAILED;
+    }
+    len = strlen(buf);
+    if (ock_snprintf(buf + len, sizeof(buf) - len, "/objcache") != 0) {
+        TRACE_ERROR("pk_dir buffer overflow");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    data_size = obj_cache_data_size(tokdata);
+
+    rc = XProcLock(tokdata);
+    if (rc != CKR_OK)
+        return rc;
+
+    /*
+     * A token that can not attach to the cache, e.g. because the cache
+     * was created with another size, loads its objects from the files.
+     */
+    ret = sm_open(buf, 0660, (void **)&cache, sizeof(*cache) + data_size, 0,
+                  tokdata->tokgroup);
+    if (ret < 0) {
+        TRACE_WARNING("Attaching to the object cache failed, it is not "
+                      "used.\n");
+        OCK_SYSLOG(LOG_WARNING, "Slot %lu: Attaching to the object cache "
+                   "failed, it is not used", tokdata->slot_id);
+        goto out;
+    }
+
+    if (ret == 0 || cache->magic != OBJ_CACHE_MAGIC ||
+        cache->version != tokdata->version || cache->data_size != data_size)
+        obj_cache_reset(cache, tokdata->version, data_size);
+
+    tokdata->obj_cache = cache;
+    TRACE_DEVEL("Attached to the object cache (%lu MB).\n",
+                tokdata->obj_cache_size);
+
+out:
+    return XProcUnLock(tokdata);
+}
+
+void obj_cache_detach(STDLL_TokData_t *tokdata, CK_BBOOL ignore_ref_count)
+{
+    struct obj_cache_hdr *cache = tokdata->obj_cache;
+
+    if (cache == NULL)
+        return;
+
+    if (XProcLock(tokdata) != CKR_OK)
+        return;
+
+    TRACE_INFO("Object cache: hits: %lu misses: %lu entries: %lu "
+               "data used: %lu resets: %lu\n", (unsigned long)cache->hits,
+               (unsigned long)cache->misses, (unsigned long)cache->num_used,
+               (unsigned long)cache->data_used, (unsigned long)cache->resets);
+
+    if (sm_close(cache, 0, ignore_ref_count))
+        TRACE_DEVEL("sm_close failed.\n");
+    tokdata->obj_cache = NULL;
+
+    XProcUnLock(tokdata);
+}
+
+/* Returns the object name part of a token object file name */
+static const char *obj_cache_name(const char *fname)
+{
+    const char *name;
+
+    if (fname == NULL)
+        return NULL;
+
+    name = strrchr(fname, '/');
+    name = name != NULL ? name + 1 : fname;
+    if (strlen(name) != OBJ_CACHE_NAME_LEN)
+        return NULL;
+
+    return name;
+}
+
+static unsigned long obj_cache_hash(const char *name)
+{
+    unsigned long hash = 2166136261UL;
+    int i;
+
+    for (i = 0; i < OBJ_CACHE_NAME_LEN; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619UL;
+    }
+
+    return hash % OBJ_CACHE_NUM_ENTRIES;
+}
+
+/*
+ * Returns the entry of the object. If insert is TRUE and the object is not
+ * in the cache, a free entry to insert it is returned instead, or NULL if
+ * the table is full.
+ */
+static struct obj_cache_entry *obj_cache_find(struct obj_cache_hdr *cache,
+                                              const char *name,
+                                              CK_BBOOL insert)
+{
+    struct obj_cache_entry *entry, *deleted = NULL;
+    unsigned long idx, i;
+
+    idx = obj_cache_hash(name);
+    for (i = 0; i < OBJ_CACHE_NUM_ENTRIES; i++) {
+        entry = &cache->entries[(idx + i) % OBJ_CACHE_NUM_ENTRIES];
+
+        switch (entry->state) {
+        case OBJ_CACHE_ENTRY_FREE:
+            if (!insert)
+                return NULL;
+            return deleted != NULL ? deleted : entry;
+        case OBJ_CACHE_ENTRY_DELETED:
+            if (deleted == NULL)
+                deleted = entry;
+            break;
+        default:
+            if (memcmp(entry->name, name, OBJ_CACHE_NAME_LEN) == 0)
+                return entry;
+            break;
+        }
+    }
+
+    return insert ? deleted : NULL;
+}
+
+/*
+ * Returns TRUE if the data of the entry lies within the used part of the
+ * data area. The cache is writable by the whole token group, so the offset
+ * and length are checked against the size mapped by this process before
+ * they are used.
+ */
+static CK_BBOOL obj_cache_entry_valid(STDLL_TokData_t *tokdata,
+                                      struct obj_cache_hdr *cache,
+                                      struct obj_cache_entry *entry)
+{
+    uint64_t data_used = cache->data_used;
+
+    return data_used <= obj_cache_data_size(tokdata) &&
+           entry->offset <= data_used &&
+           entry->len <= data_used - entry->offset;
+}
+
+static void obj_cache_remove_entry(struct obj_cache_hdr *cache,
+                                   struct obj_cache_entry *entry)
+{
+    entry->state = OBJ_CACHE_ENTRY_DELETED;
+    cache->num_used--;
+    cache->num_deleted++;
+}
+
+/*
+ * Returns a copy of the flattened object cached for the token object file,
+ * or NULL if it is not cached, if the file has changed, or if the object is
+ * not of one of the given types (OBJ_CACHE_PUBLIC, OBJ_CACHE_PRIVATE).
+ * Private objects can only be returned while the master key is loaded.
+ * The caller must free the returned data.
+ * The token lock (XProcLock) must be held when calling this function.
+ */
+CK_BYTE *obj_cache_get(STDLL_TokData_t *tokdata, const char *fname,
+                       unsigned int types, CK_ULONG *len)
+{
+    struct obj_cache_hdr *cache = tokdata->obj_cache;
+    struct obj_cache_entry *entry;
+    const char *name;
+    struct stat sb;
+    CK_BYTE *data;
+
+    if (cache == NULL || (name = obj_cache_name(fname)) == NULL)
+        return NULL;
+
+    entry = obj_cache_find(cache, name, FALSE);
+    if (entry == NULL) {
+        cache->misses++;
+        return NULL;
+    }
+
+    if (!(types & (entry->priv ? OBJ_CACHE_PRIVATE : OBJ_CACHE_PUBLIC)))
+        return NULL;
+
+    if (stat(fname, &sb) != 0 || entry->ino != (uint64_t)sb.st_ino ||
+        entry->size != (uint64_t)sb.st_size ||
+        entry->mtime_sec != (int64_t)sb.st_mtim.tv_sec ||
+        entry->mtime_nsec != (int64_t)sb.st_mtim.tv_nsec) {
+        TRACE_DEVEL("Object cache entry for %s is stale.\n", name);
+        obj_cache_remove_entry(cache, entry);
+        cache->misses++;
+        return NULL;
+    }
+
+    if (!obj_cache_entry_valid(tokdata, cache, entry)) {
+        TRACE_DEVEL("Object cache entry for %s is invalid.\n", name);
+        obj_cache_remove_entry(cache, entry);
+        cache->misses++;
+        return NULL;
+    }
+
+    data = malloc(entry->len > 0 ? entry->len : 1);
+    if (data == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+
+    if (!entry->priv) {
+        memcpy(data, cache->data + entry->offset, entry->len);
+    } else if (master_key_unseal(tokdata, data,
+                                 (const unsigned char *)entry->name,
+                                 OBJ_CACHE_NAME_LEN,
+                                 cache->data + entry->offset, entry->len,
+                                 entry->tag, entry->iv) != CKR_OK) {
+        TRACE_DEVEL("Object cache entry for %s can not be unsealed.\n",
+                    name);
+        obj_cache_remove_entry(cache, entry);
+        cache->misses++;
+        free(data);
+        return NULL;
+    }
+
+    cache->hits++;
+    *len = entry->len;
+
+    return data;
+}
+
+/*
+ * Adds or replaces the flattened object of a token object file that has
+ * just been read or written. Private objects are sealed under the master
+ * key, which must be loaded.
+ * The token lock (XProcLock) must be held when calling this function.
+ */
+void obj_cache_put(STDLL_TokData_t *tokdata, const char *fname,
+                   CK_BBOOL priv, const CK_BYTE *data, CK_ULONG len)
+{
+    struct obj_cache_hdr *cache = tokdata->obj_cache;
+    struct obj_cache_entry *entry;
+    uint64_t data_size;
+    const char *name;
+    uint64_t size;
+    struct stat sb;
+
+    if (cache == NULL || (name = obj_cache_name(fname)) == NULL)
+        return;
+
+    entry = obj_cache_find(cache, name, FALSE);
+    if (entry != NULL)
+        obj_cache_remove_entry(cache, entry);
+
+    data_size = obj_cache_data_size(tokdata);
+    size = (len + OBJ_CACHE_ALIGN - 1) & ~((uint64_t)OBJ_CACHE_ALIGN - 1);
+    if (size > data_size || stat(fname, &sb) != 0)
+        return;
+
+    entry = obj_cache_find(cache, name, TRUE);
+    if (entry == NULL || cache->data_used > data_size ||
+        data_size - cache->data_used < size) {
+        TRACE_DEVEL("Object cache is full, resetting it.\n");
+        obj_cache_reset(cache, cache->version, data_size);
+        entry = obj_cache_find(cache, name, TRUE);
+    }
+
+    if (!priv) {
+        memcpy(cache->data + cache->data_used, data, len);
+    } else if (rng_generate(tokdata, entry->iv, OBJ_CACHE_IV_LEN) != CKR_OK ||
+               master_key_seal(tokdata, cache->data + cache->data_used,
+                               entry->tag, (const unsigned char *)name,
+                               OBJ_CACHE_NAME_LEN, data, len,
+                               entry->iv) != CKR_OK) {
+        TRACE_DEVEL("Sealing the object cache entry for %s failed.\n", name);
+        return;
+    }
+
+    if (entry->state == OBJ_CACHE_ENTRY_DELETED)
+        cache->num_deleted--;
+
+    memcpy(entry->name, name, OBJ_CACHE_NAME_LEN);
+    entry->priv = priv ? 1 : 0;
+    entry->ino = sb.st_ino;
+    entry->size = sb.st_size;
+    entry->mtime_sec = sb.st_mtim.tv_sec;
+    entry->mtime_nsec = sb.st_mtim.tv_nsec;
+    entry->offset = cache->data_used;
+    entry->len = len;
+    entry->state = OBJ_CACHE_ENTRY_USED;
+
+    cache->data_used += size;
+    cache->num_used++;
+}
+
+/*
+ * Removes a token object from the cache.
+ * The token lock (XProcLock) must be held when calling this function.
+ */
+void obj_cache_remove(STDLL_TokData_t *tokdata, const CK_BYTE *name)
+{
+    struct obj_cache_hdr *cache = tokdata->obj_cache;
+    struct obj_cache_entry *entry;
+
+    if (cache == NULL)
+        return;
+
+    entry = obj_cache_find(cache, (const char *)name, FALSE);
+    if (entry != NULL)
+        obj_cache_remove_entry(cache, entry);
+}
+
+/*
+ * Removes all token objects from the cache, e.g. when the token is
+ * re-initialized.
+ * The token lock (XProcLock) must be held when calling this function.
+ */
+void obj_cache_clear(STDLL_TokData_t *tokdata)
+{
+    struct obj_cache_hdr *cache = tokdata->obj_cache;
+
+    if (cache == NULL)
+        return;
+
+    obj_cache_reset(cache, cache->version, cache->data_size);
+}
@@ -20,6 +20,9 @@
 #include <strings.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
+
+#include <openssl/crypto.h>
 
 #include "pkcs11types.h"
 #include "defs.h"
@@ -82,6 +85,17 @@ static CK_RV object_mgr_check_session(SESSION *sess, CK_BBOOL priv_obj,
     return CKR_OK;
 }
 
+/*
+ * Must be called after every change of the token object entries in the
+ * shared memory segment, with the token lock (XProcLock) held. While the
+ * generation is unchanged, object_mgr_check_shm() does not need to take the
+ * token lock for objects it has already checked.
+ */
+static void object_mgr_shm_changed(LW_SHM_TYPE *global_shm)
+{
+    __atomic_add_fetch(&global_shm->tok_obj_gen, 1, __ATOMIC_RELEASE);
+}
+
 CK_RV object_mgr_add(STDLL_TokData_t *tokdata,
                      SESSION *sess,
                      CK_ATTRIBUTE *pTemplate,
@@ -251,7 +265,8 @@ CK_RV object_mgr_add_to_map(STDLL_TokData_t *tokdata,
     // already locked it
     //
 
-    map_node = (OBJECT_MAP *) malloc(sizeof(OBJECT_MAP));
+    map_node = (OBJECT_MAP *) slab_alloc(&tokdata->object_map_cache,
+                                         sizeof(OBJECT_MAP));
     if (!map_node) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         return CKR_HOST_MEMORY;
@@ -278,7 +293,7 @@ CK_RV object_mgr_add_to_map(STDLL_TokData_t *tokdata,
     *map_handle = bt_node_add(&tokdata->object_map_btree, map_node);
 
     if (*map_handle == 0) {
-        free(map_node);
+        slab_free(map_node);
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         return CKR_HOST_MEMORY;
     }
@@ -454,6 +469,60 @@ CK_RV object_mgr_create_skel(STDLL_TokData_t *tokdata,
     return CKR_OK;
 }
 
+/*
+ * Links a session object into the list of objects owned by its session.
+ * Fails if the session is already being closed, because the session's
+ * objects have then already been purged.
+ */
+static CK_RV object_mgr_link_sess_obj(STDLL_TokData_t *tokdata,
+                                      SESSION *sess, OBJECT *obj)
+{
+    CK_RV rc = CKR_OK;
+
+    if (pthread_mutex_lock(&tokdata->sess_obj_list_mutex)) {
+        TRACE_ERROR("Lock failed.\n");
+        return CKR_CANT_LOCK;
+    }
+
+    if (sess->handle == CK_INVALID_HANDLE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+    } else {
+        list_insert_head(&sess->sess_objects, &obj->sess_obj_entry);
+    }
+
+    pthread_mutex_unlock(&tokdata->sess_obj_list_mutex);
+
+    return rc;
+}
+
+/*
+ * Unlinks a session object from the list of objects owned by its session.
+ * Returns TRUE if the object was unlinked by this call. Only the caller that
+ * unlinked the object removes it from the session object btree, so that
+ * a concurrent destroy and purge of the same object frees it only once.
+ */
+static CK_BBOOL object_mgr_unlink_sess_obj(STDLL_TokData_t *tokdata,
+                                           OBJECT *obj)
+{
+    CK_BBOOL unlinked = FALSE;
+
+    if (pthread_mutex_lock(&tokdata->sess_obj_list_mutex)) {
+        TRACE_ERROR("Lock failed.\n");
+        return FALSE;
+    }
+
+    if (obj->sess_obj_entry.list != NULL) {
+        list_remove(&obj->sess_obj_entry);
+        obj->sess_obj_entry.list = NULL;
+        unlinked = TRUE;
+    }
+
+    pthread_mutex_unlock(&tokdata->sess_obj_list_mutex);
+
+    return unlinked;
+}
+
 /*
  * Finalizes the object creation and adds the object into the appropriate
  * btree and also the object map btree.
@@ -490,6 +559,8 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
         return rc;
     }
 
+    object_update_caps(tokdata, obj);
+
     sess_obj = object_is_session_object(obj);
     priv_obj = object_is_private(obj);
 
@@ -501,6 +572,14 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             return CKR_HOST_MEMORY;
         }
+        obj->sess_obj_handle = obj_handle;
+
+        rc = object_mgr_link_sess_obj(tokdata, sess, obj);
+        if (rc != CKR_OK) {
+            /* obj is free'd by the caller of object_mgr_create_final */
+            bt_node_free(&tokdata->sess_obj_btree, obj_handle, FALSE);
+            return rc;
+        }
     } else {
         // we'll be modifying nv_token_data so we should protect this part
         // with 'XProcLock'
@@ -580,6 +659,7 @@ CK_RV object_mgr_create_final(STDLL_TokData_t *tokdata,
             // pass NULL here, so that obj (the binary tree node's value
             // pointer) isn't touched.
             // It is free'd by the caller of object_mgr_create_final
+            object_mgr_unlink_sess_obj(tokdata, obj);
             bt_node_free(&tokdata->sess_obj_btree, obj_handle, FALSE);
         } else {
             delete_token_object(tokdata, obj);
@@ -665,7 +745,15 @@ CK_RV object_mgr_destroy_object(STDLL_TokData_t *tokdata,
     }
 
     if (map->is_session_obj) {
-        bt_node_free(&tokdata->sess_obj_btree, map->obj_handle, TRUE);
+        o = bt_get_node_value(&tokdata->sess_obj_btree, map->obj_handle);
+        if (o != NULL && object_mgr_unlink_sess_obj(tokdata, o)) {
+            bt_put_node_value(&tokdata->sess_obj_btree, o);
+            bt_node_free(&tokdata->sess_obj_btree, map->obj_handle, TRUE);
+        } else if (o != NULL) {
+            /* Concurrently purged together with its session */
+            bt_put_node_value(&tokdata->sess_obj_btree, o);
+        }
+        o = NULL;
     } else {
         if (XProcLock(tokdata)) {
             TRACE_ERROR("Failed to get Process Lock.\n");
@@ -811,6 +899,7 @@ CK_RV object_mgr_destroy_token_objects(STDLL_TokData_t *tokdata)
            MAX_TOK_OBJS * sizeof(TOK_OBJ_ENTRY));
     memset(&tokdata->global_shm->priv_tok_objs, 0x0,
            MAX_TOK_OBJS * sizeof(TOK_OBJ_ENTRY));
+    object_mgr_shm_changed(tokdata->global_shm);
 
     rc = XProcUnLock(tokdata);
     if (rc != CKR_OK) {
@@ -1370,60 +1459,59 @@ CK_RV object_mgr_get_object_size(STDLL_TokData_t *tokdata,
     return rc;
 }
 
-void purge_session_obj_cb(STDLL_TokData_t *tokdata, void *node,
-                          unsigned long obj_handle, void *p3)
-{
-    OBJECT *obj = (OBJECT *) node;
-    struct purge_args *pa = (struct purge_args *) p3;
-    CK_BBOOL del = FALSE;
-
-    UNUSED(tokdata);
-
-    if (obj->session == pa->sess) {
-        if (object_lock(obj, READ_LOCK) != CKR_OK)
-            return;
-
-        if (pa->type == PRIVATE) {
-            if (object_is_private(obj))
-                del = TRUE;
-        } else if (pa->type == PUBLIC) {
-            if (object_is_public(obj))
-                del = TRUE;
-        } else if (pa->type == ALL) {
-            del = TRUE;
-        }
-
-        object_unlock(obj);
-
-        if (del == TRUE) {
-            if (obj->map_handle)
-                bt_node_free(&tokdata->object_map_btree, obj->map_handle, TRUE);
-
-            bt_node_free(&tokdata->sess_obj_btree, obj_handle, TRUE);
-        }
-    }
-}
-
 // object_mgr_purge_session_objects()
 //
 // Args:    SESSION *
 //          SESS_OBJ_TYPE:  can be ALL, PRIVATE or PUBLIC
 //
 // Remove all session objects owned by the specified session satisfying
-// the 'type' requirements
+// the 'type' requirements. Only the session's own list of objects is
+// walked, not the session objects of all other sessions.
 //
 CK_BBOOL object_mgr_purge_session_objects(STDLL_TokData_t *tokdata,
                                           SESSION *sess, SESS_OBJ_TYPE type)
 {
-    struct purge_args pa = { sess, type };
-
-    UNUSED(tokdata);
+    list_entry_t *next;
+    OBJECT *obj;
+    CK_BBOOL del;
 
     if (!sess)
         return FALSE;
 
-    bt_for_each_node(tokdata, &tokdata->sess_obj_btree, purge_session_obj_cb,
-                     &pa);
+    if (pthread_mutex_lock(&tokdata->sess_obj_list_mutex)) {
+        TRACE_ERROR("Lock failed.\n");
+        return FALSE;
+    }
+
+    for_each_list_entry_safe(&sess->sess_objects, OBJECT, obj, sess_obj_entry,
+                             next) {
+        del = FALSE;
+
+        if (type == ALL) {
+            del = TRUE;
+        } else if (object_lock(obj, READ_LOCK) == CKR_OK) {
+            if (type == PRIVATE)
+                del = object_is_private(obj);
+            else if (type == PUBLIC)
+                del = object_is_public(obj);
+
+            object_unlock(obj);
+        }
+
+        if (del == FALSE)
+            continue;
+
+        list_remove(&obj->sess_obj_entry);
+        obj->sess_obj_entry.list = NULL;
+
+        if (obj->map_handle)
+            bt_node_free(&tokdata->object_map_btree, obj->map_handle, TRUE);
+
+        /* This may free obj */
+        bt_node_free(&tokdata->sess_obj_btree, obj->sess_obj_handle, TRUE);
+    }
+
+    pthread_mutex_unlock(&tokdata->sess_obj_list_mutex);
 
     return TRUE;
 }
@@ -1497,13 +1585,15 @@ CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata, CK_BYTE *data,
     // to many grab it now.
 
     obj = oldObj;
-    rc = object_restore_withSize(tokdata->policy,
+    rc = object_restore_withSize(tokdata,
                                  data, &obj, oldObj != NULL, data_size, fname);
     if (rc != CKR_OK) {
         TRACE_DEVEL("object_restore_withSize failed.\n");
         return rc;
     }
 
+    object_update_caps(tokdata, obj);
+
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to get Process Lock.\n");
@@ -1584,10 +1674,15 @@ unlock:
     return rc;
 }
 
-/**
- * Save the token object to disk and update the shared memory segment.
+/*
+ * Saves the token object to disk and updates the shared memory segment.
+ * If update_index is FALSE, the object must already be listed in the token
+ * object index, which is not scanned then.
+ * The token lock (XProcLock) must be held when calling this function.
  */
-CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+static CK_RV object_mgr_save_token_object_locked(STDLL_TokData_t *tokdata,
+                                                 OBJECT *obj,
+                                                 CK_BBOOL update_index)
 {
     TOK_OBJ_ENTRY *entry = NULL;
     CK_ULONG index;
@@ -1597,18 +1692,10 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     if (obj->count_lo == 0)
         obj->count_hi++;
 
-    rc = XProcLock(tokdata);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("Failed to get Process Lock.\n");
-        goto done;
-    }
-
     if (object_is_private(obj)) {
         if (tokdata->global_shm->num_priv_tok_obj == 0) {
             TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            XProcUnLock(tokdata);
-            goto done;
+            return CKR_OBJECT_HANDLE_INVALID;
         }
         rc = object_mgr_search_shm_for_obj(tokdata->global_shm->
                                            priv_tok_objs, 0,
@@ -1618,17 +1705,14 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
 
         if (rc != CKR_OK) {
             TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            XProcUnLock(tokdata);
-            goto done;
+            return rc;
         }
 
         entry = &tokdata->global_shm->priv_tok_objs[index];
     } else {
         if (tokdata->global_shm->num_publ_tok_obj == 0) {
             TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            XProcUnLock(tokdata);
-            goto done;
+            return CKR_OBJECT_HANDLE_INVALID;
         }
         rc = object_mgr_search_shm_for_obj(tokdata->global_shm->
                                            publ_tok_objs, 0,
@@ -1637,30 +1721,52 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
                                            &index);
         if (rc != CKR_OK) {
             TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            XProcUnLock(tokdata);
-            goto done;
+            return rc;
         }
 
         entry = &tokdata->global_shm->publ_tok_objs[index];
     }
 
-    rc = save_token_object(tokdata, obj);
+    if (update_index)
+        rc = save_token_object(tokdata, obj);
+    else if (object_is_private(obj))
+        rc = save_private_token_object(tokdata, obj);
+    else
+        rc = save_public_token_object(tokdata, obj);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to save token object, rc=0x%lx.\n",rc);
-        XProcUnLock(tokdata);
-        goto done;
+        return rc;
     }
 
     entry->count_lo = obj->count_lo;
     entry->count_hi = obj->count_hi;
+    object_mgr_shm_changed(tokdata->global_shm);
 
-    rc = XProcUnLock(tokdata);
+    return CKR_OK;
+}
+
+/**
+ * Save the token object to disk and update the shared memory segment.
+ */
+CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    CK_RV rc, tmp;
+
+    rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to get Process Lock.\n");
+        return rc;
+    }
+
+    rc = object_mgr_save_token_object_locked(tokdata, obj, TRUE);
+
+    tmp = XProcUnLock(tokdata);
+    if (tmp != CKR_OK) {
         TRACE_ERROR("Failed to release Process Lock.\n");
-        goto done;
+        if (rc == CKR_OK)
+            rc = tmp;
     }
 
-done:
     return rc;
 }
 
@@ -1762,6 +1868,8 @@ void object_mgr_add_to_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
     else
         global_shm->num_publ_tok_obj++;
 
+    object_mgr_shm_changed(global_shm);
+
     return;
 }
 
@@ -1862,6 +1970,8 @@ CK_RV object_mgr_del_from_shm(OBJECT *obj, LW_SHM_TYPE *global_shm)
         }
     }
 
+    object_mgr_shm_changed(global_shm);
+
     return CKR_OK;
 }
 
@@ -1917,6 +2027,7 @@ CK_RV object_mgr_check_shm(STDLL_TokData_t *tokdata, OBJECT *obj,
 {
     TOK_OBJ_ENTRY *entry = NULL;
     CK_BBOOL rd_locked = FALSE, wr_locked = FALSE;
+    uint64_t gen = 0;
     CK_RV rc;
 
     switch (lock_type) {
@@ -1931,6 +2042,16 @@ CK_RV object_mgr_check_shm(STDLL_TokData_t *tokdata, OBJECT *obj,
         return CKR_FUNCTION_FAILED;
     }
 
+    /*
+     * No token object has been added, deleted or saved by any process since
+     * the object was last found to be up to date, so there is no need to
+     * take the token lock and search the entry of the object.
+     */
+    if (__atomic_load_n(&obj->shm_gen, __ATOMIC_RELAXED) ==
+        __atomic_load_n(&tokdata->global_shm->tok_obj_gen,
+                        __ATOMIC_ACQUIRE) + 1)
+        return CKR_OK;
+
 retry:
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
@@ -1938,6 +2059,8 @@ retry:
        goto done_no_xproc_unlock;
     }
 
+    gen = tokdata->global_shm->tok_obj_gen;
+
     rc = object_mgr_get_shm_entry_for_obj(tokdata, obj, &entry);
     if (rc != CKR_OK)
         goto done;
@@ -2024,6 +2147,7 @@ retry:
 
 done:
     if (rc == CKR_OK) {
+        __atomic_store_n(&obj->shm_gen, gen + 1, __ATOMIC_RELAXED);
         rc = XProcUnLock(tokdata);
         if (rc != CKR_OK) {
             TRACE_ERROR("Failed to release Process Lock.\n");
@@ -2174,21 +2298,21 @@ CK_RV object_mgr_update_publ_tok_obj_from_shm(STDLL_TokData_t *tokdata)
 
         /* we didn't find it in the btree, so add it */
         if (fa.done == FALSE) {
-            new_obj = (OBJECT *) malloc(sizeof(OBJECT));
+            new_obj = (OBJECT *) slab_alloc(&tokdata->object_cache,
+                                            sizeof(OBJECT));
             if (new_obj == NULL)
                 return CKR_HOST_MEMORY;
-            memset(new_obj, 0x0, sizeof(OBJECT));
 
             rc = object_init_lock(new_obj);
             if (rc != CKR_OK) {
-                free(new_obj);
+                slab_free(new_obj);
                 continue;
             }
 
             rc = object_init_ex_data_lock(new_obj);
             if (rc != CKR_OK) {
                 object_destroy_lock(new_obj);
-                free(new_obj);
+                slab_free(new_obj);
                 continue;
             }
 
@@ -2238,21 +2362,21 @@ CK_RV object_mgr_update_priv_tok_obj_from_shm(STDLL_TokData_t *tokdata)
 
         /* we didn't find it in the btree, so add it */
         if (fa.done == FALSE) {
-            new_obj = (OBJECT *) malloc(sizeof(OBJECT));
+            new_obj = (OBJECT *) slab_alloc(&tokdata->object_cache,
+                                            sizeof(OBJECT));
             if (new_obj == NULL)
                 return CKR_HOST_MEMORY;
-            memset(new_obj, 0x0, sizeof(OBJECT));
 
             rc = object_init_lock(new_obj);
             if (rc != CKR_OK) {
-                free(new_obj);
+                slab_free(new_obj);
                 continue;
             }
 
             rc = object_init_ex_data_lock(new_obj);
             if (rc != CKR_OK) {
                 object_destroy_lock(new_obj);
-                free(new_obj);
+                slab_free(new_obj);
                 continue;
             }
 
@@ -2344,20 +2468,64 @@ void dump_shm(LW_SHM_TYPE *global_shm, const char *s)
 }
 #endif
 
+/* Max threads re-enciphering the objects of a tree */
+#define OBJ_MGR_ITERATE_MAX_THREADS         64
+/* Min number of objects per thread */
+#define OBJ_MGR_ITERATE_OBJS_PER_THREAD     16
+/* Number of token objects saved with one token lock */
+#define OBJ_MGR_ITERATE_SAVE_BATCH          32
+/* Min seconds between two progress reports */
+#define OBJ_MGR_ITERATE_PROGRESS_INTERVAL   1
+
+/*
+ * Token objects processed by one iterating thread that still need to be
+ * saved. They stay locked until they are saved.
+ */
+struct iterate_obj_batch {
+    STDLL_TokData_t *tokdata;
+    struct btree *tree;
+    OBJECT *obj;                /* object currently processed */
+    CK_BBOOL save_deferred;     /* obj is to be saved with the batch */
+    OBJECT *objs[OBJ_MGR_ITERATE_SAVE_BATCH];
+    CK_ULONG num_objs;
+};
+
+static __thread struct iterate_obj_batch *iterate_obj_batch = NULL;
+
+/*
+ * Saves a token object after its secure key was updated. When called from
+ * a callback of obj_mgr_iterate_key_objects() for the object being
+ * processed, the object is saved later together with other objects.
+ */
+static CK_RV obj_mgr_reencipher_save(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    struct iterate_obj_batch *batch = iterate_obj_batch;
+
+    if (batch != NULL && batch->tokdata == tokdata && batch->obj == obj) {
+        batch->save_deferred = TRUE;
+        return CKR_OK;
+    }
+
+    return object_mgr_save_token_object(tokdata, obj);
+}
+
 /*
  * Re-enciphers a key that has a secure key in attribute CKA_IBM_OPAQUE by
- * calling the reenc callback function.
+ * calling the reenc callback function. The ID of the MK change operation
+ * op_id is stored in CKA_IBM_OPAQUE_REENC_OP together with the re-enciphered
+ * secure key.
  * Returns CKR_ATTRIBUTE_TYPE_INVALID if the key does not contain a secure key.
  * The object must hold the WRITE lock when this function is called!
  */
 CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                    const char *op_id,
                                     CK_RV (*reenc)(CK_BYTE *sec_key,
                                                    CK_BYTE *reenc_sec_key,
                                                    CK_ULONG sec_key_len,
                                                    void *private),
                                     void *private)
 {
-    CK_ATTRIBUTE *opaque_attr = NULL, *reenc_attr = NULL;
+    CK_ATTRIBUTE *opaque_attr = NULL, *reenc_attr = NULL, *op_attr = NULL;
     CK_KEY_TYPE key_type;
     CK_RV rc;
 
@@ -2381,6 +2549,29 @@ CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
         goto out;
     }
 
+    /*
+     * A token object that has a re-enciphered secure key of this operation
+     * was saved by an earlier run that was interrupted, it is still valid.
+     * A re-enciphered secure key without the operation ID, e.g. of a key
+     * created while the operation is active, or of another operation that
+     * was aborted without being canceled, is replaced.
+     */
+    if (!object_is_session_object(obj) &&
+        template_attribute_find(obj->template, CKA_IBM_OPAQUE_REENC_OP,
+                                &op_attr) &&
+        op_attr->ulValueLen == strlen(op_id) &&
+        memcmp(op_attr->pValue, op_id, op_attr->ulValueLen) == 0 &&
+        template_attribute_find(obj->template, CKA_IBM_OPAQUE_REENC,
+                                &reenc_attr)) {
+        TRACE_DEVEL("%s token object %s is already re-enciphered\n",
+                    __func__, obj->name);
+        reenc_attr = NULL;
+        op_attr = NULL;
+        rc = CKR_OK;
+        goto out;
+    }
+    op_attr = NULL;
+
     rc = build_attribute(CKA_IBM_OPAQUE_REENC, opaque_attr->pValue,
                          opaque_attr->ulValueLen, &reenc_attr);
     if (rc != CKR_OK)
@@ -2414,13 +2605,23 @@ CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
         }
     }
 
+    rc = build_attribute(CKA_IBM_OPAQUE_REENC_OP, (CK_BYTE *)op_id,
+                         strlen(op_id), &op_attr);
+    if (rc != CKR_OK)
+        goto out;
+
     rc = template_update_attribute(obj->template, reenc_attr);
     if (rc != CKR_OK)
         goto out;
     reenc_attr = NULL;
 
+    rc = template_update_attribute(obj->template, op_attr);
+    if (rc != CKR_OK)
+        goto out;
+    op_attr = NULL;
+
     if (!object_is_session_object(obj)) {
-        rc = object_mgr_save_token_object(tokdata, obj);
+        rc = obj_mgr_reencipher_save(tokdata, obj);
         if (rc != CKR_OK) {
             TRACE_ERROR("Failed to save token object, rc=%lx.\n",rc);
             goto out;
@@ -2430,6 +2631,8 @@ CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
 out:
     if (reenc_attr != NULL)
         free(reenc_attr);
+    if (op_attr != NULL)
+        free(op_attr);
 
     return rc;
 }
@@ -2530,8 +2733,14 @@ remove:
     if (rc != CKR_OK)
         goto out;
 
+    rc = template_remove_attribute(obj->template, CKA_IBM_OPAQUE_REENC_OP);
+    if (rc == CKR_ATTRIBUTE_TYPE_INVALID)
+        rc = CKR_OK;
+    if (rc != CKR_OK)
+        goto out;
+
     if (!object_is_session_object(obj)) {
-        rc = object_mgr_save_token_object(tokdata, obj);
+        rc = obj_mgr_reencipher_save(tokdata, obj);
         if (rc != CKR_OK) {
             TRACE_ERROR("Failed to save token object, rc=%lx.\n", rc);
             goto out;
@@ -2579,8 +2788,14 @@ CK_RV obj_mgr_reencipher_secure_key_cancel(STDLL_TokData_t *tokdata,
     if (rc != CKR_OK)
         goto out;
 
+    rc = template_remove_attribute(obj->template, CKA_IBM_OPAQUE_REENC_OP);
+    if (rc == CKR_ATTRIBUTE_TYPE_INVALID)
+        rc = CKR_OK;
+    if (rc != CKR_OK)
+        goto out;
+
     if (!object_is_session_object(obj)) {
-        rc = object_mgr_save_token_object(tokdata, obj);
+        rc = obj_mgr_reencipher_save(tokdata, obj);
         if (rc != CKR_OK) {
             TRACE_ERROR("Failed to save token object, rc=%lx.\n",rc);
             goto out;
@@ -2592,34 +2807,139 @@ out:
 }
 
 struct iterate_obj_data {
+    STDLL_TokData_t *tokdata;
     CK_BBOOL (*filter)(STDLL_TokData_t *tokdata, OBJECT *obj,
                        void *filter_data);
     void *filter_data;
     CK_RV (*cb)(STDLL_TokData_t *tokdata, OBJECT *obj, void *cb_data);
     void *cb_data;
+    void (*progress)(STDLL_TokData_t *tokdata, CK_ULONG done,
+                     CK_ULONG total, void *cb_data);
     const char *msg;
     CK_BBOOL syslog;
     CK_RV error;
+    struct btree *tree;         /* tree currently processed */
+    unsigned long next_node;    /* next node of the tree to process */
+    CK_ULONG num_done;          /* objects processed */
+    CK_ULONG num_total;         /* objects of all trees to process */
+    time_t last_progress;
+    pthread_mutex_t progress_mutex;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX *libctx;
+#endif
 };
 
-static void obj_mgr_iterate_key_objects_cb(STDLL_TokData_t *tokdata, void *p1,
-                                           unsigned long p2, void *p3)
+static void obj_mgr_iterate_set_error(struct iterate_obj_data *iod, CK_RV rc)
 {
-    struct iterate_obj_data *iod = p3;
-    OBJECT *obj = p1;
-    CK_OBJECT_CLASS class;
-    CK_RV rc;
+    /* Keep the first error, the other threads stop after their object */
+    __sync_bool_compare_and_swap(&iod->error, CKR_OK, rc);
+}
 
-    UNUSED(p2);
+static void obj_mgr_iterate_progress(struct iterate_obj_data *iod,
+                                     CK_BBOOL final)
+{
+    time_t now;
+
+    if (iod->progress == NULL)
+        return;
+
+    /* Checked without the mutex first, other threads may update it */
+    now = time(NULL);
+    if (!final &&
+        now - __atomic_load_n(&iod->last_progress, __ATOMIC_RELAXED) <
+                                            OBJ_MGR_ITERATE_PROGRESS_INTERVAL)
+        return;
+
+    if (pthread_mutex_lock(&iod->progress_mutex) != 0)
+        return;
+
+    if (final ||
+        now - iod->last_progress >= OBJ_MGR_ITERATE_PROGRESS_INTERVAL) {
+        __atomic_store_n(&iod->last_progress, now, __ATOMIC_RELAXED);
+        iod->progress(iod->tokdata,
+                      __atomic_load_n(&iod->num_done, __ATOMIC_RELAXED),
+                      iod->num_total, iod->cb_data);
+    }
+
+    pthread_mutex_unlock(&iod->progress_mutex);
+}
+
+/*
+ * Saves the token objects of the batch with one token lock, and unlocks
+ * them.
+ */
+static void obj_mgr_iterate_save_batch(struct iterate_obj_data *iod,
+                                       struct iterate_obj_batch *batch)
+{
+    STDLL_TokData_t *tokdata = iod->tokdata;
+    OBJECT *obj;
+    CK_ULONG i;
+    CK_RV rc, lock_rc;
 
-    if (iod->error != CKR_OK) /* Skip if previous reported an error */
+    if (batch->num_objs == 0)
         return;
 
+    lock_rc = XProcLock(tokdata);
+    if (lock_rc != CKR_OK) {
+        TRACE_ERROR("Failed to get Process Lock.\n");
+        if (iod->syslog)
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get Process Lock\n",
+                       tokdata->slot_id);
+        obj_mgr_iterate_set_error(iod, lock_rc);
+    }
+
+    for (i = 0; i < batch->num_objs; i++) {
+        obj = batch->objs[i];
+
+        if (lock_rc == CKR_OK) {
+            /* Objects in the tree are already in the token object index */
+            rc = object_mgr_save_token_object_locked(tokdata, obj, FALSE);
+            if (rc == CKR_OBJECT_HANDLE_INVALID) /* Deleted by other proc */
+                rc = CKR_OK;
+            if (rc != CKR_OK) {
+                TRACE_ERROR("%s failed to save token object %s: 0x%lx\n",
+                            __func__, obj->name, rc);
+                if (iod->syslog)
+                    OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to save token "
+                               "object '%s': 0x%lx\n", tokdata->slot_id,
+                               obj->name, rc);
+                obj_mgr_iterate_set_error(iod, rc);
+            }
+        }
+
+        object_unlock(obj);
+        bt_put_node_value(batch->tree, obj);
+    }
+
+    if (lock_rc == CKR_OK && XProcUnLock(tokdata) != CKR_OK) {
+        TRACE_ERROR("Failed to release Process Lock.\n");
+        if (iod->syslog)
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to release Process Lock\n",
+                       tokdata->slot_id);
+        obj_mgr_iterate_set_error(iod, CKR_CANT_LOCK);
+    }
+
+    batch->num_objs = 0;
+}
+
+/*
+ * Processes one object obtained from the tree. The object is put back to
+ * the tree, or added to the batch if its save was deferred by the callback.
+ */
+static void obj_mgr_iterate_key_object(struct iterate_obj_data *iod,
+                                       struct iterate_obj_batch *batch,
+                                       OBJECT *obj, unsigned long node)
+{
+    STDLL_TokData_t *tokdata = iod->tokdata;
+    CK_OBJECT_CLASS class;
+    CK_RV rc;
+
     rc = object_lock(obj, WRITE_LOCK);
     if (rc != CKR_OK) {
         if (iod->syslog)
             OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get the object lock\n",
                        tokdata->slot_id);
+        bt_put_node_value(batch->tree, obj);
         return;
     }
 
@@ -2629,7 +2949,7 @@ static void obj_mgr_iterate_key_objects_cb(STDLL_TokData_t *tokdata, void *p1,
         if (iod->syslog)
             OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get object class: 0x%lx\n",
                        tokdata->slot_id, rc);
-        iod->error = rc;
+        obj_mgr_iterate_set_error(iod, rc);
         goto out;
     }
 
@@ -2649,10 +2969,10 @@ static void obj_mgr_iterate_key_objects_cb(STDLL_TokData_t *tokdata, void *p1,
 
     if (obj->session != NULL) {
         TRACE_INFO("%s %s session object 0x%lx of session 0x%lx\n",
-                   __func__, iod->msg, p2, obj->session->handle);
+                   __func__, iod->msg, node, obj->session->handle);
         if (iod->syslog)
             OCK_SYSLOG(LOG_DEBUG, "Slot %lu: %s session object 0x%lx of "
-                       "session 0x%lx\n", tokdata->slot_id, iod->msg, p2,
+                       "session 0x%lx\n", tokdata->slot_id, iod->msg, node,
                        obj->session->handle);
     } else {
         TRACE_INFO("%s %s token object %s\n", __func__, iod->msg, obj->name);
@@ -2661,7 +2981,10 @@ static void obj_mgr_iterate_key_objects_cb(STDLL_TokData_t *tokdata, void *p1,
                        tokdata->slot_id, iod->msg, obj->name);
     }
 
+    batch->obj = obj;
+    batch->save_deferred = FALSE;
     rc = iod->cb(tokdata, obj, iod->cb_data);
+    batch->obj = NULL;
     if (rc != CKR_OK) {
         if (obj->session != NULL) {
             TRACE_ERROR("%s callback failed to process session object: 0x%lx\n",
@@ -2669,7 +2992,7 @@ static void obj_mgr_iterate_key_objects_cb(STDLL_TokData_t *tokdata, void *p1,
             if (iod->syslog)
                 OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to %s session object "
                            "0x%lx of session 0x%lx: 0x%lx\n", tokdata->slot_id,
-                           iod->msg, p2, obj->session->handle, rc);
+                           iod->msg, node, obj->session->handle, rc);
         } else {
             TRACE_ERROR("%s callback failed to process token object %s: 0x%lx\n",
                         __func__, obj->name, rc);
@@ -2678,14 +3001,119 @@ static void obj_mgr_iterate_key_objects_cb(STDLL_TokData_t *tokdata, void *p1,
                            "Slot %lu: Failed to %s token object '%s': 0x%lx\n",
                            tokdata->slot_id, iod->msg, obj->name, rc);
         }
-        iod->error = rc;
+        obj_mgr_iterate_set_error(iod, rc);
         goto out;
     }
 
+    if (batch->save_deferred) {
+        batch->objs[batch->num_objs++] = obj;
+        if (batch->num_objs == OBJ_MGR_ITERATE_SAVE_BATCH)
+            obj_mgr_iterate_save_batch(iod, batch);
+        return;
+    }
+
 out:
     object_unlock(obj);
+    bt_put_node_value(batch->tree, obj);
 }
 
+static void obj_mgr_iterate_tree_objects(struct iterate_obj_data *iod)
+{
+    struct iterate_obj_batch batch;
+    unsigned long node;
+    OBJECT *obj;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.tokdata = iod->tokdata;
+    batch.tree = iod->tree;
+    iterate_obj_batch = &batch;
+
+    while (iod->error == CKR_OK) {
+        node = __sync_fetch_and_add(&iod->next_node, 1);
+        if (node > iod->tree->size)
+            break;
+
+        /* Get the node value, not the node, see bt_for_each_node() */
+        obj = bt_get_node_value(iod->tree, node);
+        if (obj == NULL)
+            continue;
+
+        obj_mgr_iterate_key_object(iod, &batch, obj, node);
+
+        __sync_fetch_and_add(&iod->num_done, 1);
+        obj_mgr_iterate_progress(iod, FALSE);
+    }
+
+    obj_mgr_iterate_save_batch(iod, &batch);
+    iterate_obj_batch = NULL;
+}
+
+static void *obj_mgr_iterate_worker(void *arg)
+{
+    struct iterate_obj_data *iod = arg;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX_set0_default(iod->libctx);
+#endif
+
+    obj_mgr_iterate_tree_objects(iod);
+
+    return NULL;
+}
+
+/*
+ * Processes the objects of a tree. Trees with more than
+ * OBJ_MGR_ITERATE_OBJS_PER_THREAD objects are spread over up to
+ * tokdata->hsm_mk_change_threads threads (including the calling thread).
+ * Returns the first error reported by any of the threads.
+ */
+static CK_RV obj_mgr_iterate_tree(struct iterate_obj_data *iod,
+                                  struct btree *tree)
+{
+    pthread_t threads[OBJ_MGR_ITERATE_MAX_THREADS];
+    CK_ULONG num_threads, started = 0, i;
+
+    iod->tree = tree;
+    iod->next_node = 1;
+
+    num_threads = (tree->size - tree->free_nodes) /
+                                        OBJ_MGR_ITERATE_OBJS_PER_THREAD;
+    if (num_threads > iod->tokdata->hsm_mk_change_threads)
+        num_threads = iod->tokdata->hsm_mk_change_threads;
+    if (num_threads > OBJ_MGR_ITERATE_MAX_THREADS)
+        num_threads = OBJ_MGR_ITERATE_MAX_THREADS;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    /* Worker threads must use the library context of the calling thread */
+    iod->libctx = OSSL_LIB_CTX_set0_default(NULL);
+#endif
+
+    for (i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], NULL, obj_mgr_iterate_worker,
+                           iod) != 0) {
+            TRACE_DEVEL("pthread_create failed, using %lu threads\n",
+                        started + 1);
+            break;
+        }
+        started++;
+    }
+
+    obj_mgr_iterate_tree_objects(iod);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    return iod->error;
+}
+
+/*
+ * Calls the callback for all key objects that pass the filter. Token objects
+ * whose secure key is updated by the callback through the
+ * obj_mgr_reencipher_secure_key* functions are saved in batches after the
+ * callback returned. If specified, the progress callback is called about
+ * every OBJ_MGR_ITERATE_PROGRESS_INTERVAL seconds, and when all objects
+ * have been processed.
+ */
 CK_RV obj_mgr_iterate_key_objects(STDLL_TokData_t *tokdata,
                                   CK_BBOOL session_objects,
                                   CK_BBOOL token_objects,
@@ -2695,32 +3123,47 @@ CK_RV obj_mgr_iterate_key_objects(STDLL_TokData_t *tokdata,
                                   void *filter_data,
                                   CK_RV (*cb)(STDLL_TokData_t *tokdata,
                                               OBJECT *obj, void *cb_data),
-                                  void *cb_data, CK_BBOOL syslog,
-                                  const char *msg)
+                                  void *cb_data,
+                                  void (*progress)(STDLL_TokData_t *tokdata,
+                                                   CK_ULONG done,
+                                                   CK_ULONG total,
+                                                   void *cb_data),
+                                  CK_BBOOL syslog, const char *msg)
 {
     struct iterate_obj_data iod;
     CK_RV rc;
 
+    memset(&iod, 0, sizeof(iod));
+    iod.tokdata = tokdata;
     iod.filter = filter;
     iod.filter_data = filter_data;
     iod.cb = cb;
     iod.cb_data = cb_data;
+    iod.progress = progress;
     iod.syslog = syslog;
     iod.msg = msg;
     iod.error = CKR_OK;
+    iod.last_progress = time(NULL);
+
+    if (pthread_mutex_init(&iod.progress_mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing the progress mutex failed.\n");
+        return CKR_CANT_LOCK;
+    }
 
     if (session_objects) {
         /* Session objects */
-        bt_for_each_node(tokdata, &tokdata->sess_obj_btree,
-                         obj_mgr_iterate_key_objects_cb, &iod);
-        if (iod.error != CKR_OK) {
+        iod.num_total += tokdata->sess_obj_btree.size -
+                                tokdata->sess_obj_btree.free_nodes;
+
+        rc = obj_mgr_iterate_tree(&iod, &tokdata->sess_obj_btree);
+        if (rc != CKR_OK) {
             TRACE_ERROR("%s failed to %s session objects: 0x%lx\n",
-                        __func__, msg, iod.error);
+                        __func__, msg, rc);
             if (syslog)
                 OCK_SYSLOG(LOG_ERR,
                            "Slot %lu: Failed to %s session objects: 0x%lx\n",
-                           tokdata->slot_id, msg, iod.error);
-            return iod.error;
+                           tokdata->slot_id, msg, rc);
+            goto out;
         }
     }
 
@@ -2732,7 +3175,7 @@ CK_RV obj_mgr_iterate_key_objects(STDLL_TokData_t *tokdata,
             if (syslog)
                 OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get Process Lock\n",
                            tokdata->slot_id);
-            return rc;
+            goto out;
         }
 
         object_mgr_update_from_shm(tokdata);
@@ -2744,35 +3187,42 @@ CK_RV obj_mgr_iterate_key_objects(STDLL_TokData_t *tokdata,
                 OCK_SYSLOG(LOG_ERR,
                            "Slot %lu: Failed to release Process Lock\n",
                            tokdata->slot_id);
-            return rc;
+            goto out;
         }
 
+        iod.num_total += tokdata->publ_token_obj_btree.size -
+                                tokdata->publ_token_obj_btree.free_nodes;
+        iod.num_total += tokdata->priv_token_obj_btree.size -
+                                tokdata->priv_token_obj_btree.free_nodes;
+
         /* Public token objects */
-        bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree,
-                         obj_mgr_iterate_key_objects_cb, &iod);
-        if (iod.error != CKR_OK) {
+        rc = obj_mgr_iterate_tree(&iod, &tokdata->publ_token_obj_btree);
+        if (rc != CKR_OK) {
             TRACE_ERROR("%s failed to %s public token objects: 0x%lx\n",
-                        __func__, msg, iod.error);
+                        __func__, msg, rc);
             if (syslog)
                 OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to %s public token "
-                           "objects: 0x%lx\n", tokdata->slot_id, msg,
-                           iod.error);
-            return iod.error;
+                           "objects: 0x%lx\n", tokdata->slot_id, msg, rc);
+            goto out;
         }
 
         /* Private token objects */
-        bt_for_each_node(tokdata, &tokdata->priv_token_obj_btree,
-                         obj_mgr_iterate_key_objects_cb, &iod);
-        if (iod.error != CKR_OK) {
+        rc = obj_mgr_iterate_tree(&iod, &tokdata->priv_token_obj_btree);
+        if (rc != CKR_OK) {
             TRACE_ERROR("%s failed to %s private token objects: 0x%lx\n",
-                        __func__, msg, iod.error);
+                        __func__, msg, rc);
             if (syslog)
                 OCK_SYSLOG(LOG_ERR,"Slot %lu: Failed to %s private token "
-                           "objects: 0x%lx\n", tokdata->slot_id, msg,
-                           iod.error);
-            return iod.error;
+                           "objects: 0x%lx\n", tokdata->slot_id, msg, rc);
+            goto out;
         }
     }
 
-    return CKR_OK;
+    obj_mgr_iterate_progress(&iod, TRUE);
+    rc = CKR_OK;
+
+out:
+    pthread_mutex_destroy(&iod.progress_mutex);
+
+    return rc;
 }
@@ -155,7 +155,7 @@ CK_RV object_copy(STDLL_TokData_t * tokdata, SESSION *sess,
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_FUNCTION_FAILED;
     }
-    o = (OBJECT *) malloc(sizeof(OBJECT));
+    o = (OBJECT *) slab_alloc(&tokdata->object_cache, sizeof(OBJECT));
     tmpl = (TEMPLATE *) malloc(sizeof(TEMPLATE));
     new_tmpl = (TEMPLATE *) malloc(sizeof(TEMPLATE));
 
@@ -163,7 +163,7 @@ CK_RV object_copy(STDLL_TokData_t * tokdata, SESSION *sess,
         rc = CKR_HOST_MEMORY;
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         if (o)
-            free(o);
+            slab_free(o);
         if (tmpl)
             free(tmpl);
         if (new_tmpl)
@@ -172,7 +172,6 @@ CK_RV object_copy(STDLL_TokData_t * tokdata, SESSION *sess,
         return rc;      // do not goto done -- memory might not be initialized
     }
 
-    memset(o, 0x0, sizeof(OBJECT));
     memset(tmpl, 0x0, sizeof(TEMPLATE));
     memset(new_tmpl, 0x0, sizeof(TEMPLATE));
     o->template = tmpl;
@@ -344,7 +343,7 @@ void object_free(OBJECT * obj)
         if (obj->template)
             template_free(obj->template);
         object_destroy_lock(obj);
-        free(obj);
+        slab_free(obj);
     }
 }
 
@@ -498,6 +497,183 @@ CK_BBOOL object_is_attr_bound(OBJECT * obj)
     return val;
 }
 
+static const struct {
+    CK_ATTRIBUTE_TYPE type;
+    CK_ULONG flag;
+} objcaps_usage_attrs[] = {
+    { CKA_ENCRYPT, OBJCAPS_ENCRYPT },
+    { CKA_DECRYPT, OBJCAPS_DECRYPT },
+    { CKA_SIGN, OBJCAPS_SIGN },
+    { CKA_SIGN_RECOVER, OBJCAPS_SIGN_RECOVER },
+    { CKA_VERIFY, OBJCAPS_VERIFY },
+    { CKA_VERIFY_RECOVER, OBJCAPS_VERIFY_RECOVER },
+    { CKA_WRAP, OBJCAPS_WRAP },
+    { CKA_UNWRAP, OBJCAPS_UNWRAP },
+    { CKA_DERIVE, OBJCAPS_DERIVE },
+};
+
+#define NUM_OBJCAPS_USAGE_ATTRS \
+    (sizeof(objcaps_usage_attrs) / sizeof(objcaps_usage_attrs[0]))
+
+// object_update_caps()
+//
+// recomputes the capability summary from the object's template. Must be
+// called whenever the template is replaced or modified, with the object
+// locked for writing (or not yet visible to other threads). If an attribute
+// has an invalid value, the summary is left invalid, so that the template
+// based checks report the error.
+//
+void object_update_caps(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    struct objcaps *caps = &obj->caps;
+    CK_ATTRIBUTE *attr = NULL;
+    CK_MECHANISM_TYPE *mechs;
+    CK_ULONG num_mechs, i;
+    CK_BBOOL flag;
+    CK_RV rc;
+    int idx;
+
+    memset(caps, 0, sizeof(*caps));
+
+    if (template_attribute_get_ulong(obj->template, CKA_CLASS,
+                                     &caps->class) != CKR_OK)
+        return;
+
+    rc = template_attribute_get_ulong(obj->template, CKA_KEY_TYPE,
+                                      &caps->keytype);
+    if (rc == CKR_OK)
+        caps->keytype_present = TRUE;
+    else if (rc != CKR_TEMPLATE_INCOMPLETE)
+        return;
+
+    for (i = 0; i < NUM_OBJCAPS_USAGE_ATTRS; i++) {
+        rc = template_attribute_get_bool(obj->template,
+                                         objcaps_usage_attrs[i].type, &flag);
+        if (rc == CKR_TEMPLATE_INCOMPLETE)
+            continue;
+        if (rc != CKR_OK)
+            return;
+        caps->usage_present |= objcaps_usage_attrs[i].flag;
+        if (flag)
+            caps->usage |= objcaps_usage_attrs[i].flag;
+    }
+
+    if (key_object_is_always_authenticate(obj->template,
+                                          &caps->always_auth) != CKR_OK)
+        return;
+
+    if (!template_attribute_find(obj->template, CKA_ALLOWED_MECHANISMS,
+                                 &attr) ||
+        attr->ulValueLen == 0 || attr->pValue == NULL) {
+        caps->all_mechs_allowed = TRUE;
+    } else {
+        /* External tools might not have a mechanism table */
+        if (tokdata == NULL || tokdata->mechtable_funcs == NULL)
+            return;
+
+        mechs = (CK_MECHANISM_TYPE *)attr->pValue;
+        num_mechs = attr->ulValueLen / sizeof(CK_MECHANISM_TYPE);
+        for (i = 0; i < num_mechs; i++) {
+            idx = tokdata->mechtable_funcs->p_idx_from_num(mechs[i]);
+            if (idx < 0)
+                caps->other_mechs_allowed = TRUE;
+            else
+                caps->allowed_mechs[idx / 8] |= 1u << (idx % 8);
+        }
+    }
+
+    caps->valid = TRUE;
+}
+
+// object_get_class()
+//
+CK_RV object_get_class(OBJECT *obj, CK_OBJECT_CLASS *class)
+{
+    if (!obj->caps.valid)
+        return template_attribute_get_ulong(obj->template, CKA_CLASS, class);
+
+    *class = obj->caps.class;
+    return CKR_OK;
+}
+
+// object_get_key_type()
+//
+// returns CKR_TEMPLATE_INCOMPLETE if the object has no CKA_KEY_TYPE,
+// like template_attribute_get_ulong() does.
+//
+CK_RV object_get_key_type(OBJECT *obj, CK_KEY_TYPE *keytype)
+{
+    if (!obj->caps.valid)
+        return template_attribute_get_ulong(obj->template, CKA_KEY_TYPE,
+                                            keytype);
+
+    if (!obj->caps.keytype_present)
+        return CKR_TEMPLATE_INCOMPLETE;
+
+    *keytype = obj->caps.keytype;
+    return CKR_OK;
+}
+
+// object_get_usage()
+//
+// gets a boolean key usage attribute (CKA_SIGN, CKA_ENCRYPT, ...). Returns
+// CKR_TEMPLATE_INCOMPLETE if the object does not have it, like
+// template_attribute_get_bool() does.
+//
+CK_RV object_get_usage(OBJECT *obj, CK_ATTRIBUTE_TYPE type, CK_BBOOL *flag)
+{
+    CK_ULONG i;
+
+    if (obj->caps.valid) {
+        for (i = 0; i < NUM_OBJCAPS_USAGE_ATTRS; i++) {
+            if (objcaps_usage_attrs[i].type != type)
+                continue;
+            if (!(obj->caps.usage_present & objcaps_usage_attrs[i].flag))
+                return CKR_TEMPLATE_INCOMPLETE;
+            *flag = (obj->caps.usage & objcaps_usage_attrs[i].flag) ?
+                                                            TRUE : FALSE;
+            return CKR_OK;
+        }
+    }
+
+    return template_attribute_get_bool(obj->template, type, flag);
+}
+
+// object_is_always_authenticate()
+//
+CK_RV object_is_always_authenticate(OBJECT *obj, CK_BBOOL *auth)
+{
+    if (!obj->caps.valid)
+        return key_object_is_always_authenticate(obj->template, auth);
+
+    *auth = obj->caps.always_auth;
+    return CKR_OK;
+}
+
+// object_is_mechanism_allowed()
+//
+// checks the mechanism against CKA_ALLOWED_MECHANISMS of the key.
+//
+CK_BBOOL object_is_mechanism_allowed(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                     CK_MECHANISM_TYPE mech)
+{
+    int idx;
+
+    if (obj->caps.valid) {
+        if (obj->caps.all_mechs_allowed)
+            return TRUE;
+
+        idx = tokdata->mechtable_funcs->p_idx_from_num(mech);
+        if (idx >= 0)
+            return (obj->caps.allowed_mechs[idx / 8] & (1u << (idx % 8))) ?
+                                                            TRUE : FALSE;
+        if (!obj->caps.other_mechs_allowed)
+            return FALSE;
+    }
+
+    return key_object_is_mechanism_allowed(obj->template, mech);
+}
+
 // object_get_size()
 //
 CK_ULONG object_get_size(OBJECT * obj)
@@ -567,6 +743,9 @@ static CK_RV object_get_attribute_array(CK_ATTRIBUTE *array_attr,
     return rc;
 }
 
+/* Requested attributes that object_get_attribute_values() resolves on stack */
+#define OBJECT_GET_ATTRS_ON_STACK       16
+
 //
 //
 CK_RV object_get_attribute_values(OBJECT * obj,
@@ -574,6 +753,9 @@ CK_RV object_get_attribute_values(OBJECT * obj,
 {
     TEMPLATE *obj_tmpl = NULL;
     CK_ATTRIBUTE *attr = NULL;
+    CK_ATTRIBUTE *found[OBJECT_GET_ATTRS_ON_STACK];
+    CK_ATTRIBUTE **attrs = found;
+    struct template_export_info export_info;
     CK_ULONG i;
     CK_BBOOL flag;
     CK_RV rc, rc2;
@@ -582,8 +764,28 @@ CK_RV object_get_attribute_values(OBJECT * obj,
 
     obj_tmpl = obj->template;
 
+    /*
+     * Look up all requested attributes with one pass over the template, and
+     * the attributes deciding about their exportability only once.
+     */
+    if (ulCount > OBJECT_GET_ATTRS_ON_STACK) {
+        attrs = malloc(ulCount * sizeof(*attrs));
+        if (attrs == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+    }
+
+    rc = template_attribute_find_all(obj_tmpl, pTemplate, ulCount, attrs);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("template_attribute_find_all failed.\n");
+        goto out;
+    }
+
+    template_get_export_info(obj_tmpl, &export_info);
+
     for (i = 0; i < ulCount; i++) {
-        flag = template_check_exportability(obj_tmpl, pTemplate[i].type);
+        flag = template_check_export_info(&export_info, pTemplate[i].type);
         if (flag == FALSE) {
             TRACE_ERROR("%s: %lx\n", ock_err(ERR_ATTRIBUTE_SENSITIVE),
                         pTemplate[i].type);
@@ -592,8 +794,8 @@ CK_RV object_get_attribute_values(OBJECT * obj,
             continue;
         }
 
-        flag = template_attribute_find(obj_tmpl, pTemplate[i].type, &attr);
-        if (flag == FALSE) {
+        attr = attrs[i];
+        if (attr == NULL) {
             TRACE_ERROR("%s: %lx\n", ock_err(ERR_ATTRIBUTE_TYPE_INVALID),
                         pTemplate[i].type);
             rc = CKR_ATTRIBUTE_TYPE_INVALID;
@@ -626,6 +828,10 @@ CK_RV object_get_attribute_values(OBJECT * obj,
         }
     }
 
+out:
+    if (attrs != found)
+        free(attrs);
+
     return rc;
 }
 
@@ -694,9 +900,12 @@ CK_RV object_set_attribute_values(STDLL_TokData_t * tokdata, SESSION *sess,
     rc = template_merge(obj->template, &new_tmpl);
     if (rc != CKR_OK) {
         TRACE_DEVEL("template_merge failed.\n");
+        obj->caps.valid = FALSE;
         return rc;
     }
 
+    object_update_caps(tokdata, obj);
+
     return CKR_OK;
 
 error:
@@ -713,7 +922,7 @@ error:
 //
 //Modified object_restore to prevent buffer overflow
 //If data_size=-1, won't do bounds checking
-CK_RV object_restore_withSize(struct policy *policy,
+CK_RV object_restore_withSize(STDLL_TokData_t *tokdata,
                               CK_BYTE * data, OBJECT ** new_obj,
                               CK_BBOOL replace, int data_size,
                               const char *fname)
@@ -730,15 +939,15 @@ CK_RV object_restore_withSize(struct policy *policy,
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_FUNCTION_FAILED;
     }
-    obj = (OBJECT *) malloc(sizeof(OBJECT));
+    /* External tools (e.g., pkcscca) might pass a NULL tokdata */
+    obj = (OBJECT *) slab_alloc(tokdata ? &tokdata->object_cache : NULL,
+                                sizeof(OBJECT));
     if (!obj) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto error;
     }
 
-    memset(obj, 0x0, sizeof(OBJECT));
-
     memcpy(&class32, data + offset, sizeof(CK_OBJECT_CLASS_32));
     obj->class = class32;
     offset += sizeof(CK_OBJECT_CLASS_32);
@@ -780,11 +989,12 @@ CK_RV object_restore_withSize(struct policy *policy,
     }
     /* External tools (e.g., pkcscca) might use this function and not
        be aware of any policy.  Allow them to pass NULL. */
-    if (policy) {
+    if (tokdata && tokdata->policy) {
         /* Ignore policy violations here since the point is to get the
            correct strength classification for the usage scenario
            which will then allow or block key usage. */
-        policy->store_object_strength(policy, &obj->strength,
+        tokdata->policy->store_object_strength(tokdata->policy,
+                                      &obj->strength,
                                       policy_get_attr_from_template,
                                       tmpl, NULL, NULL);
     }
@@ -811,7 +1021,8 @@ CK_RV object_restore_withSize(struct policy *policy,
         (*new_obj)->strength.strength = obj->strength.strength;
         (*new_obj)->strength.siglen = obj->strength.siglen;
         (*new_obj)->strength.allowed = obj->strength.allowed;
-        free(obj);              // don't want to do object_free() here!
+        (*new_obj)->caps.valid = FALSE;
+        slab_free(obj);         // don't want to do object_free() here!
     }
 
     return CKR_OK;
@@ -848,7 +1059,7 @@ CK_RV object_create_skel(STDLL_TokData_t * tokdata,
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_FUNCTION_FAILED;
     }
-    o = (OBJECT *) calloc(1, sizeof(OBJECT));
+    o = (OBJECT *) slab_alloc(&tokdata->object_cache, sizeof(OBJECT));
     tmpl = (TEMPLATE *) calloc(1, sizeof(TEMPLATE));
     tmpl2 = (TEMPLATE *) calloc(1, sizeof(TEMPLATE));
 
@@ -922,7 +1133,7 @@ CK_RV object_create_skel(STDLL_TokData_t * tokdata,
 
 done:
     if (o)
-        free(o);
+        slab_free(o);
     if (tmpl)
         template_free(tmpl);
     if (tmpl2)
@@ -92,14 +92,15 @@ CK_RV session_mgr_new(STDLL_TokData_t *tokdata, CK_ULONG flags,
     CK_RV rc = CKR_OK;
 
 
-    new_session = (SESSION *) malloc(sizeof(SESSION));
+    new_session = (SESSION *) slab_alloc(&tokdata->session_cache,
+                                         sizeof(SESSION));
     if (!new_session) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto done;
     }
 
-    memset(new_session, 0x0, sizeof(SESSION));
+    list_init(&new_session->sess_objects);
 
     // find an unused session handle. session handles will wrap automatically...
     //
@@ -153,7 +154,7 @@ CK_RV session_mgr_new(STDLL_TokData_t *tokdata, CK_ULONG flags,
 done:
     if (rc != CKR_OK && new_session != NULL) {
         TRACE_ERROR("Failed to add session to the btree.\n");
-        free(new_session);
+        slab_free(new_session);
     }
 
     return rc;
@@ -284,6 +285,10 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
         return CKR_CANT_LOCK;
     }
 
+    // Make sure this address is now invalid, this also prevents that new
+    // session objects are linked to the session while it is purged
+    sess->handle = CK_INVALID_HANDLE;
+
     object_mgr_purge_session_objects(tokdata, sess, ALL);
 
     if ((sess->session_info.state == CKS_RO_PUBLIC_SESSION) ||
@@ -291,9 +296,6 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
         tokdata->ro_session_count--;
     }
 
-    // Make sure this address is now invalid
-    sess->handle = CK_INVALID_HANDLE;
-
     if (sess->find_list)
         free(sess->find_list);
 
@@ -333,6 +335,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
     if (sess->digest_ctx.mech.pParameter)
         free(sess->digest_ctx.mech.pParameter);
 
+    digest_mgr_free_idle(tokdata, sess);
+
     if (sess->sign_ctx.context) {
         if (sess->sign_ctx.context_free_func != NULL)
             sess->sign_ctx.context_free_func(tokdata, sess,
@@ -399,8 +403,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
 
     UNUSED(p3);
 
-    object_mgr_purge_session_objects(tokdata, sess, ALL);
     sess->handle = CK_INVALID_HANDLE;
+    object_mgr_purge_session_objects(tokdata, sess, ALL);
 
     if (sess->find_list)
         free(sess->find_list);
@@ -441,6 +445,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
     if (sess->digest_ctx.mech.pParameter)
         free(sess->digest_ctx.mech.pParameter);
 
+    digest_mgr_free_idle(tokdata, sess);
+
     if (sess->sign_ctx.context) {
         if (sess->sign_ctx.context_free_func != NULL)
             sess->sign_ctx.context_free_func(tokdata, sess,
@@ -1240,6 +1246,7 @@ CK_RV session_mgr_set_op_state(STDLL_TokData_t *tokdata, SESSION *sess,
 
             sess->digest_ctx.context = context;
             sess->digest_ctx.mech.pParameter = mech_param;
+            sess->digest_ctx.context_reset_func = NULL;
             break;
         }
 
@@ -76,8 +76,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
 
     ctx->auth_required = FALSE;
     if (checkauth) {
-        rc = key_object_is_always_authenticate(key_obj->template,
-                                               &ctx->auth_required);
+        rc = object_is_always_authenticate(key_obj, &ctx->auth_required);
         if (rc != CKR_OK) {
             TRACE_ERROR("key_object_is_always_authenticate failed\n");
             goto done;
@@ -87,8 +86,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
     if (recover_mode) {
         // is key allowed to generate signatures where the data can be
         // recovered from the signature?
-        rc = template_attribute_get_bool(key_obj->template, CKA_SIGN_RECOVER,
-                                         &flag);
+        rc = object_get_usage(key_obj, CKA_SIGN_RECOVER, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_SIGN_RECOVER for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -97,7 +95,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
     } else {
         // is key allowed to generate signatures where the signature is an
         // appendix to the data?
-        rc = template_attribute_get_bool(key_obj->template, CKA_SIGN, &flag);
+        rc = object_get_usage(key_obj, CKA_SIGN, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_SIGN for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -110,7 +108,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    if (!key_object_is_mechanism_allowed(key_obj->template, mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, key_obj, mech->mechanism)) {
         TRACE_ERROR("Mechanism not allowed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
@@ -145,8 +143,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             }
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -160,8 +157,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PRIVATE key
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -195,8 +191,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             rc = CKR_MECHANISM_PARAM_INVALID;
             goto done;
         }
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -210,8 +205,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PRIVATE key
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -255,8 +249,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             rc = CKR_MECHANISM_PARAM_INVALID;
             goto done;
         }
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -270,8 +263,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PRIVATE key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -313,8 +305,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -328,8 +319,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PRIVATE key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -357,8 +347,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -372,8 +361,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PRIVATE key
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -403,8 +391,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -445,8 +432,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -503,8 +489,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
                 goto done;
             }
 
-            rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                              &keytype);
+            rc = object_get_key_type(key_obj, &keytype);
             if (rc != CKR_OK) {
                 TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
                 goto done;
@@ -565,8 +550,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
                 goto done;
             }
 
-            rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                              &keytype);
+            rc = object_get_key_type(key_obj, &keytype);
             if (rc != CKR_OK) {
                 TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
                 goto done;
@@ -623,8 +607,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
                 }
             }
 
-            rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                              &class);
+            rc = object_get_class(key_obj, &class);
             if (rc != CKR_OK) {
                 TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
                 goto done;
@@ -801,8 +784,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -814,8 +796,7 @@ CK_RV sign_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
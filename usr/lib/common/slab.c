@@ -0,0 +1,366 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  slab.c
+//
+// Per-token caches for the fixed size structures that are allocated for
+// every session and object (SESSION, OBJECT, OBJECT_MAP). Objects are
+// carved out of slabs holding SLAB_OBJS_PER_SLAB objects each, so that
+// creating and destroying short-lived objects does not go to the heap.
+//
+// Every object is preceded by a header pointing to its slab, so that
+// slab_free() does not need the cache, and can be used as btree delete
+// function. An object allocated with a NULL cache, e.g. by a tool without
+// a token, is allocated from the heap with a header pointing to NULL.
+//
+// Slabs with objects still in use when a cache is destroyed are not freed.
+// They are handed over to an orphaned copy of the cache on the heap, which
+// frees them and itself when the last object is freed.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+
+#define SLAB_OBJS_PER_SLAB      32
+
+union slab_obj_hdr {
+    struct slab *slab;
+    /* keep the object suitably aligned for any type */
+    long double ld;
+    long long ll;
+    void *ptr;
+};
+
+struct slab {
+    SLAB_CACHE *cache;
+    struct slab *prev;
+    struct slab *next;
+    CK_ULONG in_use;
+    CK_ULONG num_carved;        // objects handed out at least once
+    union slab_obj_hdr *free_list; // next pointer stored in the object
+    union slab_obj_hdr objs[];
+};
+
+#define SLAB_OBJ_NEXT(hdr)      (*(union slab_obj_hdr **)((hdr) + 1))
+
+static void slab_list_add(struct slab **list, struct slab *slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL)
+        (*list)->prev = slab;
+    *list = slab;
+}
+
+static void slab_list_remove(struct slab **list, struct slab *slab)
+{
+    if (slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
+
+CK_RV slab_cache_init(SLAB_CACHE *cache, const char *name, size_t size)
+{
+    memset(cache, 0, sizeof(*cache));
+
+    if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing the %s cache mutex failed.\n", name);
+        return CKR_CANT_LOCK;
+    }
+
+    if (size < sizeof(union slab_obj_hdr *))
+        size = sizeof(union slab_obj_hdr *);
+    size = (size + sizeof(union slab_obj_hdr) - 1) /
+                sizeof(union slab_obj_hdr) * sizeof(union slab_obj_hdr);
+
+    cache->name = name;
+    cache->obj_size = sizeof(union slab_obj_hdr) + size;
+    cache->objs_per_slab = SLAB_OBJS_PER_SLAB;
+    cache->initialized = TRUE;
+
+    return CKR_OK;
+}
+
+static void slab_free_list(SLAB_CACHE *cache, struct slab **list)
+{
+    struct slab *slab;
+
+    while (*list != NULL) {
+        slab = *list;
+        *list = slab->next;
+        free(slab);
+        cache->stats.slabs--;
+        cache->stats.slab_frees++;
+    }
+}
+
+static void slab_list_set_cache(struct slab *list, SLAB_CACHE *cache)
+{
+    for (; list != NULL; list = list->next)
+        list->cache = cache;
+}
+
+/*
+ * Moves the slabs with objects in use to an orphaned copy of the cache.
+ * Called with the cache mutex held. If the copy can not be allocated, the
+ * slabs are leaked, and a late slab_free() of their objects is unsafe.
+ */
+static void slab_cache_orphan(SLAB_CACHE *cache)
+{
+    SLAB_CACHE *orphan;
+
+    TRACE_WARNING("The %s cache still has %lu objects in use, its slabs "
+                  "are not freed.\n", cache->name, cache->stats.in_use);
+
+    orphan = malloc(sizeof(*orphan));
+    if (orphan == NULL ||
+        pthread_mutex_init(&orphan->mutex, NULL) != 0) {
+        TRACE_ERROR("Orphaning the %s cache failed, leaking %lu slabs.\n",
+                    cache->name, cache->stats.slabs);
+        free(orphan);
+        cache->partial = cache->full = NULL;
+        return;
+    }
+
+    orphan->name = cache->name;
+    orphan->obj_size = cache->obj_size;
+    orphan->objs_per_slab = cache->objs_per_slab;
+    orphan->partial = cache->partial;
+    orphan->full = cache->full;
+    orphan->empty = NULL;
+    orphan->initialized = TRUE;
+    orphan->orphaned = TRUE;
+    orphan->stats = cache->stats;
+
+    slab_list_set_cache(orphan->partial, orphan);
+    slab_list_set_cache(orphan->full, orphan);
+    cache->partial = cache->full = NULL;
+}
+
+void slab_cache_destroy(SLAB_CACHE *cache)
+{
+    if (!cache->initialized)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    if (cache->stats.in_use > 0)
+        slab_cache_orphan(cache);
+
+    slab_free_list(cache, &cache->partial);
+    slab_free_list(cache, &cache->full);
+    slab_free_list(cache, &cache->empty);
+    pthread_mutex_unlock(&cache->mutex);
+
+    pthread_mutex_destroy(&cache->mutex);
+    cache->initialized = FALSE;
+}
+
+/*
+ * Returns a zeroed object of the given size from the cache, or NULL if out
+ * of memory. The size must not be larger than the cache's object size.
+ */
+void *slab_alloc(SLAB_CACHE *cache, size_t size)
+{
+    union slab_obj_hdr *hdr;
+    struct slab *slab;
+
+    if (cache == NULL || !cache->initialized) {
+        hdr = calloc(1, sizeof(union slab_obj_hdr) + size);
+        if (hdr == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return NULL;
+        }
+        hdr->slab = NULL;
+        return hdr + 1;
+    }
+
+    if (size > cache->obj_size - sizeof(union slab_obj_hdr)) {
+        TRACE_ERROR("Object too large for the %s cache.\n", cache->name);
+        return NULL;
+    }
+
+    if (pthread_mutex_lock(&cache->mutex) != 0) {
+        TRACE_ERROR("Locking the %s cache failed.\n", cache->name);
+        return NULL;
+    }
+
+    slab = cache->partial;
+    if (slab == NULL) {
+        slab = cache->empty;
+        if (slab != NULL) {
+            cache->empty = NULL;
+        } else {
+            slab = malloc(sizeof(struct slab) +
+                          cache->objs_per_slab * cache->obj_size);
+            if (slab == NULL) {
+                pthread_mutex_unlock(&cache->mutex);
+                TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+                return NULL;
+            }
+            memset(slab, 0, sizeof(struct slab));
+            slab->cache = cache;
+            cache->stats.slabs++;
+            cache->stats.slab_allocs++;
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    if (slab->free_list != NULL) {
+        hdr = slab->free_list;
+        slab->free_list = SLAB_OBJ_NEXT(hdr);
+    } else {
+        hdr = (union slab_obj_hdr *)((CK_BYTE *)slab->objs +
+                                     slab->num_carved * cache->obj_size);
+        hdr->slab = slab;
+        slab->num_carved++;
+    }
+
+    slab->in_use++;
+    if (slab->in_use == cache->objs_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    cache->stats.allocs++;
+    cache->stats.in_use++;
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    memset(hdr + 1, 0, size);
+
+    return hdr + 1;
+}
+
+void slab_free(void *ptr)
+{
+    union slab_obj_hdr *hdr;
+    struct slab *slab;
+    SLAB_CACHE *cache;
+
+    if (ptr == NULL)
+        return;
+
+    hdr = (union slab_obj_hdr *)ptr - 1;
+    slab = hdr->slab;
+    if (slab == NULL) {
+        free(hdr);
+        return;
+    }
+
+    cache = slab->cache;
+    if (pthread_mutex_lock(&cache->mutex) != 0) {
+        TRACE_ERROR("Locking the %s cache failed.\n", cache->name);
+        return;
+    }
+
+    SLAB_OBJ_NEXT(hdr) = slab->free_list;
+    slab->free_list = hdr;
+
+    if (slab->in_use == cache->objs_per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    slab->in_use--;
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty == NULL) {
+            cache->empty = slab;
+        } else {
+            free(slab);
+            cache->stats.slabs--;
+            cache->stats.slab_frees++;
+        }
+    }
+
+    cache->stats.frees++;
+    cache->stats.in_use--;
+
+    if (cache->orphaned && cache->stats.in_use == 0) {
+        TRACE_DEVEL("The last object of the orphaned %s cache was freed.\n",
+                    cache->name);
+        slab_free_list(cache, &cache->empty);
+        pthread_mutex_unlock(&cache->mutex);
+        pthread_mutex_destroy(&cache->mutex);
+        free(cache);
+        return;
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void slab_cache_get_stats(SLAB_CACHE *cache, struct slab_stats *stats)
+{
+    if (!cache->initialized) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+CK_RV slab_mgr_init(STDLL_TokData_t *tokdata)
+{
+    CK_RV rc;
+
+    rc = slab_cache_init(&tokdata->object_cache, "OBJECT", sizeof(OBJECT));
+    rc |= slab_cache_init(&tokdata->object_map_cache, "OBJECT_MAP",
+                          sizeof(OBJECT_MAP));
+    rc |= slab_cache_init(&tokdata->session_cache, "SESSION",
+                          sizeof(SESSION));
+
+    return rc;
+}
+
+static void slab_trace_cache_stats(SLAB_CACHE *cache)
+{
+    struct slab_stats stats;
+
+    slab_cache_get_stats(cache, &stats);
+    TRACE_INFO("%s cache: allocs: %lu frees: %lu in use: %lu slabs: %lu "
+               "slab allocs: %lu slab frees: %lu\n", cache->name,
+               stats.allocs, stats.frees, stats.in_use, stats.slabs,
+               stats.slab_allocs, stats.slab_frees);
+}
+
+void slab_mgr_trace_stats(STDLL_TokData_t *tokdata)
+{
+    struct template_arena_stats arena_stats;
+
+    slab_trace_cache_stats(&tokdata->object_cache);
+    slab_trace_cache_stats(&tokdata->object_map_cache);
+    slab_trace_cache_stats(&tokdata->session_cache);
+
+    template_get_arena_stats(&arena_stats);
+    TRACE_INFO("Template arenas: allocs: %lu frees: %lu in use: %lu\n",
+               arena_stats.allocs, arena_stats.frees, arena_stats.in_use);
+}
+
+void slab_mgr_final(STDLL_TokData_t *tokdata)
+{
+    slab_mgr_trace_stats(tokdata);
+
+    slab_cache_destroy(&tokdata->object_cache);
+    slab_cache_destroy(&tokdata->object_map_cache);
+    slab_cache_destroy(&tokdata->session_cache);
+}
@@ -62,6 +62,70 @@ static CK_RV get_unique_id_str(char unique_id_str[2 * UNIQUE_ID_LEN + 1])
     return CKR_OK;
 }
 
+/*
+ * The attributes added by template_add_attributes() are allocated from one
+ * arena per call, so that an object created from a user template needs a
+ * single allocation for all its attributes. An arena is referenced by its
+ * attributes and by the templates listing it in their arenas list, and is
+ * freed when the last reference is gone.
+ */
+struct template_arena {
+    CK_BYTE *end;
+    CK_ULONG refs;
+};
+
+#define TEMPLATE_ARENA_ALIGN(len) \
+    (((len) + sizeof(CK_ULONG) - 1) & ~(sizeof(CK_ULONG) - 1))
+
+static struct template_arena_stats arena_stats;
+
+static void template_put_arena(struct template_arena *arena)
+{
+    if (--arena->refs > 0)
+        return;
+
+    free(arena);
+    __sync_add_and_fetch(&arena_stats.frees, 1);
+    __sync_sub_and_fetch(&arena_stats.in_use, 1);
+}
+
+/*
+ * Cleanses and frees an attribute owned by the template. The attribute must
+ * no longer be in the template's attribute list.
+ */
+static void template_free_attribute(TEMPLATE *tmpl, CK_ATTRIBUTE *attr)
+{
+    struct template_arena *arena;
+    DL_NODE *node;
+
+    if (is_attribute_attr_array(attr->type)) {
+        cleanse_and_free_attribute_array2((CK_ATTRIBUTE_PTR)attr->pValue,
+                                          attr->ulValueLen /
+                                                      sizeof(CK_ATTRIBUTE),
+                                          FALSE);
+    }
+    if (attr->pValue != NULL)
+        OPENSSL_cleanse(attr->pValue, attr->ulValueLen);
+
+    for (node = tmpl->arenas; node != NULL; node = node->next) {
+        arena = (struct template_arena *) node->data;
+        if ((CK_BYTE *)attr > (CK_BYTE *)arena &&
+            (CK_BYTE *)attr < arena->end) {
+            template_put_arena(arena);
+            return;
+        }
+    }
+
+    free(attr);
+}
+
+void template_get_arena_stats(struct template_arena_stats *stats)
+{
+    stats->allocs = __sync_add_and_fetch(&arena_stats.allocs, 0);
+    stats->frees = __sync_add_and_fetch(&arena_stats.frees, 0);
+    stats->in_use = __sync_add_and_fetch(&arena_stats.in_use, 0);
+}
+
 /* template_add_attributes()
  *
  * blindly add the given attributes to the template. do no sanity checking
@@ -70,10 +134,15 @@ static CK_RV get_unique_id_str(char unique_id_str[2 * UNIQUE_ID_LEN + 1])
 CK_RV template_add_attributes(TEMPLATE *tmpl, CK_ATTRIBUTE *pTemplate,
                               CK_ULONG ulCount)
 {
+    struct template_arena *arena;
     CK_ATTRIBUTE *attr = NULL;
+    DL_NODE *list;
+    CK_BYTE *ptr;
+    size_t size;
     CK_RV rc;
     unsigned int i;
 
+    size = TEMPLATE_ARENA_ALIGN(sizeof(struct template_arena));
     for (i = 0; i < ulCount; i++) {
         if (!is_attribute_defined(pTemplate[i].type)) {
             TRACE_ERROR("%s: %lx\n", ock_err(ERR_ATTRIBUTE_TYPE_INVALID),
@@ -86,12 +155,37 @@ CK_RV template_add_attributes(TEMPLATE *tmpl, CK_ATTRIBUTE *pTemplate,
             return CKR_ATTRIBUTE_VALUE_INVALID;
         }
 
-        attr = (CK_ATTRIBUTE *) malloc(sizeof(CK_ATTRIBUTE) +
-                                       pTemplate[i].ulValueLen);
-        if (!attr) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            return CKR_HOST_MEMORY;
-        }
+        size += TEMPLATE_ARENA_ALIGN(sizeof(CK_ATTRIBUTE) +
+                                     pTemplate[i].ulValueLen);
+    }
+
+    if (ulCount == 0)
+        return CKR_OK;
+
+    arena = (struct template_arena *) malloc(size);
+    if (!arena) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    arena->end = (CK_BYTE *)arena + size;
+    arena->refs = 1;
+    __sync_add_and_fetch(&arena_stats.allocs, 1);
+    __sync_add_and_fetch(&arena_stats.in_use, 1);
+
+    list = dlist_add_as_first(tmpl->arenas, arena);
+    if (list == NULL) {
+        template_put_arena(arena);
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    tmpl->arenas = list;
+
+    ptr = (CK_BYTE *)arena + TEMPLATE_ARENA_ALIGN(sizeof(struct template_arena));
+    rc = CKR_OK;
+    for (i = 0; i < ulCount; i++) {
+        attr = (CK_ATTRIBUTE *) ptr;
+        ptr += TEMPLATE_ARENA_ALIGN(sizeof(CK_ATTRIBUTE) +
+                                    pTemplate[i].ulValueLen);
         attr->type = pTemplate[i].type;
         attr->ulValueLen = pTemplate[i].ulValueLen;
 
@@ -103,11 +197,9 @@ CK_RV template_add_attributes(TEMPLATE *tmpl, CK_ATTRIBUTE *pTemplate,
                                 attr->ulValueLen / sizeof(CK_ATTRIBUTE),
                                 (CK_ATTRIBUTE_PTR)attr->pValue);
                 if (rc !=CKR_OK) {
-                    if (attr->pValue != NULL)
-                        OPENSSL_cleanse(attr->pValue, attr->ulValueLen);
-                    free(attr);
+                    OPENSSL_cleanse(attr->pValue, attr->ulValueLen);
                     TRACE_DEVEL("dup_attribute_array_no_alloc failed.\n");
-                    return rc;
+                    break;
                 }
             } else {
                 memcpy(attr->pValue, pTemplate[i].pValue, attr->ulValueLen);
@@ -116,17 +208,23 @@ CK_RV template_add_attributes(TEMPLATE *tmpl, CK_ATTRIBUTE *pTemplate,
             attr->pValue = NULL;
         }
 
+        arena->refs++;
         rc = template_update_attribute(tmpl, attr);
         if (rc != CKR_OK) {
+            arena->refs--;
+            if (is_attribute_attr_array(attr->type))
+                cleanse_and_free_attribute_array2(
+                                    (CK_ATTRIBUTE_PTR)attr->pValue,
+                                    attr->ulValueLen / sizeof(CK_ATTRIBUTE),
+                                    FALSE);
             if (attr->pValue != NULL)
                 OPENSSL_cleanse(attr->pValue, attr->ulValueLen);
-            free(attr);
             TRACE_DEVEL("template_update_attribute failed.\n");
-            return rc;
+            break;
         }
     }
 
-    return CKR_OK;
+    return rc;
 }
 
 
@@ -395,6 +493,99 @@ void template_attribute_find_multiple(TEMPLATE *tmpl,
     }
 }
 
+/*
+ * From this number of types on, template_attribute_find_all() sorts the
+ * types, instead of comparing every attribute of the template with all
+ * types.
+ */
+#define TEMPLATE_FIND_ALL_SORT_MIN      16
+
+struct template_find_req {
+    CK_ATTRIBUTE_TYPE type;
+    CK_ULONG index;
+};
+
+static int template_find_req_cmp(const void *a, const void *b)
+{
+    const struct template_find_req *r1 = a, *r2 = b;
+
+    if (r1->type < r2->type)
+        return -1;
+
+    return r1->type > r2->type ? 1 : 0;
+}
+
+/* template_attribute_find_all()
+ *
+ * find the attributes of the types of all entries of 'types' with a single
+ * pass over the attribute list. attrs[i] is set to the attribute of type
+ * types[i].type, or to NULL if the template does not have it.
+ */
+CK_RV template_attribute_find_all(TEMPLATE *tmpl, CK_ATTRIBUTE *types,
+                                  CK_ULONG count, CK_ATTRIBUTE **attrs)
+{
+    struct template_find_req *reqs = NULL;
+    CK_ULONG i, lo, hi, mid, left = count;
+    DL_NODE *node;
+    CK_ATTRIBUTE *a;
+
+    if (!tmpl || (count > 0 && (!types || !attrs))) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    for (i = 0; i < count; i++)
+        attrs[i] = NULL;
+
+    if (count >= TEMPLATE_FIND_ALL_SORT_MIN) {
+        reqs = malloc(count * sizeof(*reqs));
+        if (!reqs) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+        for (i = 0; i < count; i++) {
+            reqs[i].type = types[i].type;
+            reqs[i].index = i;
+        }
+        qsort(reqs, count, sizeof(*reqs), template_find_req_cmp);
+    }
+
+    for (node = tmpl->attribute_list; node != NULL && left > 0;
+         node = node->next) {
+        a = (CK_ATTRIBUTE *) node->data;
+
+        if (reqs == NULL) {
+            for (i = 0; i < count; i++) {
+                if (attrs[i] == NULL && types[i].type == a->type) {
+                    attrs[i] = a;
+                    left--;
+                }
+            }
+            continue;
+        }
+
+        /* first request of this type, types may be requested repeatedly */
+        lo = 0;
+        hi = count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (reqs[mid].type < a->type)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (; lo < count && reqs[lo].type == a->type; lo++) {
+            if (attrs[reqs[lo].index] == NULL) {
+                attrs[reqs[lo].index] = a;
+                left--;
+            }
+        }
+    }
+
+    free(reqs);
+
+    return CKR_OK;
+}
 
 /* template_check_required_attributes() */
 CK_RV template_check_required_attributes(TEMPLATE *tmpl, CK_ULONG class,
@@ -1175,20 +1366,15 @@ CK_RV template_free(TEMPLATE *tmpl)
     while (tmpl->attribute_list) {
         CK_ATTRIBUTE *attr = (CK_ATTRIBUTE *) tmpl->attribute_list->data;
 
-        if (attr) {
-            if (is_attribute_attr_array(attr->type)) {
-                cleanse_and_free_attribute_array2(
-                                    (CK_ATTRIBUTE_PTR)attr->pValue,
-                                    attr->ulValueLen / sizeof(CK_ATTRIBUTE),
-                                    FALSE);
-            }
-            if (attr->pValue != NULL)
-                OPENSSL_cleanse(attr->pValue, attr->ulValueLen);
-            free(attr);
-        }
-
         tmpl->attribute_list = dlist_remove_node(tmpl->attribute_list,
                                                  tmpl->attribute_list);
+        if (attr)
+            template_free_attribute(tmpl, attr);
+    }
+
+    while (tmpl->arenas) {
+        template_put_arena((struct template_arena *) tmpl->arenas->data);
+        tmpl->arenas = dlist_remove_node(tmpl->arenas, tmpl->arenas);
     }
 
     free(tmpl);
@@ -1319,38 +1505,24 @@ CK_ULONG template_get_compressed_size(TEMPLATE *tmpl)
     return size;
 }
 
-/* template_is_okay_to_reveal_attribute()
- *
- * determines whether the specified CK_ATTRIBUTE_TYPE is allowed to
- * be leave the card in the clear.  note: the specified template doesn't need
- * to actually posess an attribute of type 'type'.  The template is
- * provided mainly to determine the object class and subclass
+/* template_get_export_info()
  *
- * this routine is called by C_GetAttributeValue which exports the attributes
- * in the clear.  this routine is NOT called when wrapping a key.
+ * looks up the template attributes that the exportability of an attribute
+ * depends on, for checking several attributes with
+ * template_check_export_info()
  */
-CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
+void template_get_export_info(TEMPLATE *tmpl,
+                              struct template_export_info *info)
 {
-    CK_ULONG class = 0;
-    CK_ULONG subclass = 0;
     CK_BBOOL sensitive_val;
     CK_BBOOL extractable_val;
 
-    if (!tmpl)
-        return FALSE;
-
-    /*
-     * Early exit: A protected key shall not be exported. Otherwise an application
-     * could use the protected key outside of this environment and separately
-     * from the secure key object.
-     */
-    if (type == CKA_IBM_OPAQUE_PKEY)
-        return FALSE;
+    memset(info, 0, sizeof(*info));
 
     /* since 'tmpl' belongs to a validated object, it's safe
      * to assume that the following routine works
      */
-    template_get_class(tmpl, &class, &subclass);
+    template_get_class(tmpl, &info->class, &info->subclass);
 
     /* Early exits:
      * 1) CKA_SENSITIVE and CKA_EXTRACTABLE only apply to private key
@@ -1360,17 +1532,42 @@ CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
      * 2) If CKA_SENSITIVE = FALSE  and CKA_EXTRACTABLE = TRUE then
      * all attributes are exportable
      */
-    if (class != CKO_PRIVATE_KEY && class != CKO_SECRET_KEY)
-        return TRUE;
+    if (info->class != CKO_PRIVATE_KEY && info->class != CKO_SECRET_KEY) {
+        info->all_exportable = TRUE;
+        return;
+    }
 
     if (template_attribute_get_bool(tmpl, CKA_SENSITIVE,
-                                    &sensitive_val) != CKR_OK)
-        return FALSE;
-    if (template_attribute_get_bool(tmpl, CKA_EXTRACTABLE,
-                                    &extractable_val) != CKR_OK)
-        return FALSE;
+                                    &sensitive_val) != CKR_OK ||
+        template_attribute_get_bool(tmpl, CKA_EXTRACTABLE,
+                                    &extractable_val) != CKR_OK) {
+        info->none_exportable = TRUE;
+        return;
+    }
     if (sensitive_val == FALSE && extractable_val == TRUE)
+        info->all_exportable = TRUE;
+}
+
+/* template_check_export_info()
+ *
+ * determines whether the specified CK_ATTRIBUTE_TYPE is allowed to
+ * leave the card in the clear, see template_check_exportability()
+ */
+CK_BBOOL template_check_export_info(const struct template_export_info *info,
+                                    CK_ATTRIBUTE_TYPE type)
+{
+    /*
+     * Early exit: A protected key shall not be exported. Otherwise an application
+     * could use the protected key outside of this environment and separately
+     * from the secure key object.
+     */
+    if (type == CKA_IBM_OPAQUE_PKEY)
+        return FALSE;
+
+    if (info->all_exportable)
         return TRUE;
+    if (info->none_exportable)
+        return FALSE;
 
     /* at this point, we know the object must have CKA_SENSITIVE = TRUE
      * or CKA_EXTRACTABLE = FALSE (or both).
@@ -1378,8 +1575,8 @@ CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
      * a "sensitive" attribute.
      */
 
-    if (class == CKO_PRIVATE_KEY) {
-        switch (subclass) {
+    if (info->class == CKO_PRIVATE_KEY) {
+        switch (info->subclass) {
         case CKK_RSA:
             return rsa_priv_check_exportability(type);
         case CKK_DSA:
@@ -1395,19 +1592,45 @@ CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
             return ibm_kyber_priv_check_exportability(type);
         default:
             TRACE_ERROR("%s: %lx\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID),
-                        subclass);
+                        info->subclass);
             return TRUE;
         }
-    } else if (class == CKO_SECRET_KEY) {
+    } else if (info->class == CKO_SECRET_KEY) {
         return secret_key_check_exportability(type);
     }
 
     TRACE_ERROR("%s: %lx\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID),
-                class);
+                info->class);
 
     return TRUE;
 }
 
+/* template_is_okay_to_reveal_attribute()
+ *
+ * determines whether the specified CK_ATTRIBUTE_TYPE is allowed to
+ * be leave the card in the clear.  note: the specified template doesn't need
+ * to actually posess an attribute of type 'type'.  The template is
+ * provided mainly to determine the object class and subclass
+ *
+ * this routine is called by C_GetAttributeValue which exports the attributes
+ * in the clear.  this routine is NOT called when wrapping a key.
+ */
+CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
+{
+    struct template_export_info info;
+
+    if (!tmpl)
+        return FALSE;
+
+    /* A protected key is never exported, no need to look at the template */
+    if (type == CKA_IBM_OPAQUE_PKEY)
+        return FALSE;
+
+    template_get_export_info(tmpl, &info);
+
+    return template_check_export_info(&info, type);
+}
+
 /*  template_merge()
  *
  * Merge two templates together:  dest = dest U src
@@ -1416,13 +1639,27 @@ CK_BBOOL template_check_exportability(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
  */
 CK_RV template_merge(TEMPLATE *dest, TEMPLATE **src)
 {
-    DL_NODE *node;
+    struct template_arena *arena;
+    DL_NODE *node, *list;
     CK_RV rc;
 
     if (!dest || !src) {
         TRACE_ERROR("Invalid function arguments.\n");
         return CKR_FUNCTION_FAILED;
     }
+
+    /* dest takes references on the arenas of the attributes it receives */
+    for (node = (*src)->arenas; node != NULL; node = node->next) {
+        arena = (struct template_arena *) node->data;
+        list = dlist_add_as_first(dest->arenas, arena);
+        if (list == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+        dest->arenas = list;
+        arena->refs++;
+    }
+
     node = (*src)->attribute_list;
 
     while (node) {
@@ -1613,17 +1850,9 @@ CK_RV template_remove_attribute(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type)
 
         if (type == attr->type) {
             found = TRUE;
-            if (is_attribute_attr_array(attr->type)) {
-                 cleanse_and_free_attribute_array2(
-                                     (CK_ATTRIBUTE_PTR)attr->pValue,
-                                     attr->ulValueLen / sizeof(CK_ATTRIBUTE),
-                                     FALSE);
-            }
-            if (attr->pValue != NULL)
-                OPENSSL_cleanse(attr->pValue, attr->ulValueLen);
-            free(attr);
             tmpl->attribute_list =
                 dlist_remove_node(tmpl->attribute_list, node);
+            template_free_attribute(tmpl, attr);
             break;
         }
 
@@ -972,6 +972,12 @@ void copy_token_contents_sensibly(CK_TOKEN_INFO_PTR pInfo,
     /* pInfo->ulRwSessionCount is set at the API level */
 }
 
+/*
+ * Re-enciphering a secure key waits for the HSM, so more threads than CPUs
+ * keep the HSM busy during an HSM master key change.
+ */
+#define HSM_MK_CHANGE_THREADS       8
+
 CK_RV init_hsm_mk_change_lock(STDLL_TokData_t *tokdata)
 {
     pthread_rwlockattr_t attr;
@@ -1016,6 +1022,7 @@ CK_RV init_hsm_mk_change_lock(STDLL_TokData_t *tokdata)
     pthread_rwlockattr_destroy(&attr);
 
     tokdata->hsm_mk_change_supported = TRUE;
+    tokdata->hsm_mk_change_threads = HSM_MK_CHANGE_THREADS;
 
     return CKR_OK;
 }
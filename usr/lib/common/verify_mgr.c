@@ -77,8 +77,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
     if (recover_mode) {
         // is key allowed to verify signatures where the data can be
         // recovered from the signature?
-        rc = template_attribute_get_bool(key_obj->template, CKA_VERIFY_RECOVER,
-                                         &flag);
+        rc = object_get_usage(key_obj, CKA_VERIFY_RECOVER, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_VERIFY_RECOVER for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -87,7 +86,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
     } else {
         // is key allowed to verify signatures where the signature is an
         // appendix to the data?
-        rc = template_attribute_get_bool(key_obj->template, CKA_VERIFY, &flag);
+        rc = object_get_usage(key_obj, CKA_VERIFY, &flag);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_VERIFY for the key.\n");
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
@@ -100,7 +99,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
         goto done;
     }
 
-    if (!key_object_is_mechanism_allowed(key_obj->template, mech->mechanism)) {
+    if (!object_is_mechanism_allowed(tokdata, key_obj, mech->mechanism)) {
         TRACE_ERROR("Mechanism not allowed per CKA_ALLOWED_MECHANISMS.\n");
         rc = CKR_MECHANISM_INVALID;
         goto done;
@@ -135,8 +134,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             }
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -150,8 +148,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PUBLIC key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -182,8 +179,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             rc = CKR_MECHANISM_PARAM_INVALID;
             goto done;
         }
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -197,8 +193,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PUBLIC key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -242,8 +237,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             rc = CKR_MECHANISM_PARAM_INVALID;
             goto done;
         }
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -257,8 +251,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PUBLIC key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -300,8 +293,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -315,8 +307,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PUBLIC key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -344,8 +335,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -359,8 +349,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
 
         // must be a PUBLIC key operation
         //
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -387,8 +376,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -426,8 +414,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -480,8 +467,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
                 goto done;
             }
 
-            rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                              &keytype);
+            rc = object_get_key_type(key_obj, &keytype);
             if (rc != CKR_OK) {
                 TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
                 goto done;
@@ -542,8 +528,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
                 goto done;
             }
 
-            rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                              &keytype);
+            rc = object_get_key_type(key_obj, &keytype);
             if (rc != CKR_OK) {
                 TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
                 goto done;
@@ -600,8 +585,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
                 }
             }
 
-            rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                              &class);
+            rc = object_get_class(key_obj, &class);
             if (rc != CKR_OK) {
                 TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
                 goto done;
@@ -780,8 +764,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
-                                          &keytype);
+        rc = object_get_key_type(key_obj, &keytype);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
             goto done;
@@ -793,8 +776,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             goto done;
         }
 
-        rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS,
-                                          &class);
+        rc = object_get_class(key_obj, &class);
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
             goto done;
@@ -488,6 +488,7 @@ struct reencipher_data {
     STDLL_TokData_t *tokdata;
     SESSION *session;
     ep11_target_info_t *target_info;
+    const char *op_id;
 };
 
 static CK_RV ep11tok_reencipher_objects_reenc(CK_BYTE *sec_key,
@@ -505,21 +506,64 @@ static CK_RV ep11tok_reencipher_objects_cb(STDLL_TokData_t *tokdata,
                                            OBJECT *obj, void *cb_data)
 {
     struct reencipher_data *rd = cb_data;
-    SESSION *session_save;
+    struct reencipher_data obj_rd;
     CK_RV rc;
 
-    session_save = rd->session;
+    /*
+     * Objects are re-enciphered by multiple threads, so use a copy of the
+     * re-encipher data with an own reference to the target, which might be
+     * replaced if the single APQN goes offline.
+     */
+    obj_rd = *rd;
     if (obj->session != NULL) /* session is NULL for token objects */
-        rd->session = obj->session;
-    rc = obj_mgr_reencipher_secure_key(tokdata, obj,
-                                       ep11tok_reencipher_objects_reenc, rd);
+        obj_rd.session = obj->session;
+    obj_rd.target_info = get_target_info(tokdata);
+    if (obj_rd.target_info == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    rc = obj_mgr_reencipher_secure_key(tokdata, obj, rd->op_id,
+                                       ep11tok_reencipher_objects_reenc,
+                                       &obj_rd);
     if (rc == CKR_OBJECT_HANDLE_INVALID) /* Obj was deleted by other proc */
         rc = CKR_OK;
-    rd->session = session_save;
+
+    put_target_info(tokdata, obj_rd.target_info);
 
     return rc;
 }
 
+static void ep11tok_reencipher_progress_cb(STDLL_TokData_t *tokdata,
+                                           CK_ULONG done, CK_ULONG total,
+                                           void *cb_data)
+{
+    struct reencipher_data *rd = cb_data;
+    struct hsm_mk_change_progress progress;
+    CK_RV rc;
+
+    TRACE_INFO("%s %lu of %lu token objects processed\n", __func__,
+               done, total);
+
+    progress.done = done;
+    progress.total = total;
+
+    rc = hsm_mk_change_lock_create();
+    if (rc != CKR_OK)
+        return;
+
+    rc = hsm_mk_change_lock(true);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = hsm_mk_change_progress_save(rd->op_id, tokdata->slot_id, &progress);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("%s failed to save the progress: 0x%lx\n", __func__, rc);
+
+    hsm_mk_change_unlock();
+
+out:
+    hsm_mk_change_lock_destroy();
+}
+
 static CK_BBOOL ep11tok_reencipher_filter_cb(STDLL_TokData_t *tokdata,
                                              OBJECT *obj, void *filter_data)
 {
@@ -666,6 +710,8 @@ static CK_RV ep11tok_reencipher_sessions_cb(STDLL_TokData_t *tokdata,
             return CKR_OK;
         if (ep11tok_libica_mech_available(tokdata, mech->mechanism, key))
             return CKR_OK;
+        if (ep11tok_host_pubkey_mech_available(tokdata, mech->mechanism, key))
+            return CKR_OK;
 
         ctx_type_str = "verify";
         break;
@@ -673,6 +719,8 @@ static CK_RV ep11tok_reencipher_sessions_cb(STDLL_TokData_t *tokdata,
     case CONTEXT_TYPE_ENCRYPT:
         if (init_pending || pkey_active)
             return CKR_OK;
+        if (ep11tok_host_pubkey_mech_available(tokdata, mech->mechanism, key))
+            return CKR_OK;
 
         ctx_type_str = "encrypt";
         break;
@@ -921,9 +969,12 @@ static CK_RV ep11tok_mk_change_reencipher(STDLL_TokData_t *tokdata,
     }
 
     /* Re-encipher key objects */
+    rd.op_id = op->id;
     rc = obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
                                      NULL, NULL,
                                      ep11tok_reencipher_objects_cb, &rd,
+                                     token_objs ?
+                                        ep11tok_reencipher_progress_cb : NULL,
                                      TRUE, "re-encipher");
     if (rc != CKR_OK)
         goto out;
@@ -970,7 +1021,7 @@ out:
         obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
                                     ep11tok_reencipher_filter_cb, NULL,
                                     ep11tok_reencipher_cancel_objects_cb, NULL,
-                                    TRUE, "cancel");
+                                    NULL, TRUE, "cancel");
         /*
          * The pkcshsm_mk_change tool will send a CANCEL event, so leave the
          * operation active for now.
@@ -1287,7 +1338,7 @@ static CK_RV ep11tok_mk_change_finalize_cancel(STDLL_TokData_t *tokdata,
                                      cancel ?
                                          ep11tok_reencipher_cancel_objects_cb :
                                          ep11tok_reencipher_finalize_objects_cb,
-                                     NULL, TRUE,
+                                     NULL, NULL, TRUE,
                                      cancel ? "cancel" : "finalize");
     if (rc != CKR_OK)
         goto out;
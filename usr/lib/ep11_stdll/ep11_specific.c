@@ -55,6 +55,7 @@
 
 #include <openssl/crypto.h>
 #include <openssl/ec.h>
+#include <openssl/x509.h>
 
 #include "ep11_specific.h"
 #ifndef NO_PKEY
@@ -186,6 +187,8 @@ static CK_RV obj_opaque_2_blob(STDLL_TokData_t *tokdata, OBJECT *key_obj,
 static CK_RV obj_opaque_2_reenc_blob(STDLL_TokData_t *tokdata, OBJECT *key_obj,
                                      CK_BYTE **blob, size_t *blobsize);
 
+static void ep11tok_sched_free(struct ep11_sched *sched);
+
 /* EP11 Firmware levels that contain the HMAC min/max keysize fix */
 static const CK_VERSION cex4p_hmac_fix = { .major = 4, .minor = 20 };
 static const CK_VERSION cex5p_hmac_fix = { .major = 6, .minor = 3 };
@@ -2959,6 +2962,9 @@ static CK_RV ep11tok_load_libica(STDLL_TokData_t *tokdata)
     return CKR_OK;
 }
 
+#define EP11_BATCH_THREADS      16
+#define EP11_ASYNC_THREADS      32
+
 CK_RV ep11tok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
                    char *conf_name)
 {
@@ -3116,6 +3122,14 @@ CK_RV ep11tok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
     ep11_data->incr_session_refcount = tokdata->tokspec_counter.incr_tokspec_count;
     ep11_data->decr_session_refcount = tokdata->tokspec_counter.decr_tokspec_count;
 
+    /*
+     * EP11 requests block until the adapter completes them, so process the
+     * elements of a batch and async requests in many threads, to keep the
+     * queues of the APQNs busy.
+     */
+    tokdata->batch_threads = EP11_BATCH_THREADS;
+    tokdata->async_threads = EP11_ASYNC_THREADS;
+
     TRACE_INFO("%s init done successfully\n", __func__);
     return CKR_OK;
 
@@ -3133,6 +3147,7 @@ CK_RV ep11tok_final(STDLL_TokData_t * tokdata, CK_BBOOL in_fork_initializer)
 
     if (ep11_data != NULL) {
         if (ep11_data->target_info != NULL) {
+            ep11tok_sched_free(ep11_data->target_info->sched);
             if (dll_m_rm_module != NULL)
                 dll_m_rm_module(NULL, ep11_data->target_info->target);
             free_card_versions(ep11_data->target_info->card_versions);
@@ -5563,6 +5578,148 @@ CK_BBOOL ep11tok_libica_mech_available(STDLL_TokData_t *tokdata,
     return ep11tok_libica_digest_available(tokdata, ep11_data, digest_mech);
 }
 
+/*
+ * Returns TRUE if the HOST_PUBLIC_KEY_OPERATIONS option is set and the key
+ * object is a public key, whose operations are then performed in host
+ * software instead of on the EP11 crypto adapter.
+ */
+static CK_BBOOL ep11tok_host_pubkey_obj(STDLL_TokData_t *tokdata,
+                                        OBJECT *key_obj)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+    CK_OBJECT_CLASS class;
+
+    if (!ep11_data->host_pubkey_ops)
+        return CK_FALSE;
+
+    if (template_attribute_get_ulong(key_obj->template, CKA_CLASS,
+                                     &class) != CKR_OK)
+        return CK_FALSE;
+
+    return class == CKO_PUBLIC_KEY;
+}
+
+static CK_BBOOL ep11tok_host_pubkey_need_wr_lock(OBJECT *obj, void *ex_data,
+                                                 size_t ex_data_len)
+{
+    struct openssl_ex_data *data = ex_data;
+
+    UNUSED(obj);
+
+    if (ex_data == NULL || ex_data_len < sizeof(struct openssl_ex_data))
+        return FALSE;
+
+    return data->pkey == NULL;
+}
+
+/*
+ * Prepares a public key object for a host software operation: The public key
+ * is taken from the object's SPKI and attached to the object as OpenSSL
+ * ex_data, where the mech_openssl.c routines pick it up. The MAC appended to
+ * the SPKI by the EP11 adapter is not verified in host software.
+ * Returns CKR_FUNCTION_NOT_SUPPORTED if the operation is to be performed by
+ * the EP11 adapter.
+ */
+static CK_RV ep11tok_host_pubkey_prepare(STDLL_TokData_t *tokdata,
+                                         OBJECT *key_obj, int pkey_type)
+{
+    struct openssl_ex_data *ex_data = NULL;
+    const unsigned char *p;
+    CK_BYTE *spki;
+    size_t spki_len = 0;
+    EVP_PKEY *pkey;
+    CK_RV rc;
+
+    if (!ep11tok_host_pubkey_obj(tokdata, key_obj))
+        return CKR_FUNCTION_NOT_SUPPORTED;
+
+    rc = openssl_get_ex_data(key_obj, (void **)&ex_data,
+                             sizeof(struct openssl_ex_data),
+                             ep11tok_host_pubkey_need_wr_lock, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ex_data->pkey == NULL) {
+        rc = obj_opaque_2_blob(tokdata, key_obj, &spki, &spki_len);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("%s no blob rc=0x%lx\n", __func__, rc);
+            goto done;
+        }
+
+        /* d2i_PUBKEY ignores the MAC following the SPKI */
+        p = spki;
+        pkey = d2i_PUBKEY(NULL, &p, spki_len);
+        if (pkey == NULL) {
+            TRACE_ERROR("%s d2i_PUBKEY failed\n", __func__);
+            rc = CKR_FUNCTION_NOT_SUPPORTED;
+            goto done;
+        }
+
+        if (EVP_PKEY_base_id(pkey) != pkey_type) {
+            TRACE_ERROR("%s unexpected SPKI key type %d\n", __func__,
+                        EVP_PKEY_base_id(pkey));
+            EVP_PKEY_free(pkey);
+            rc = CKR_FUNCTION_NOT_SUPPORTED;
+            goto done;
+        }
+
+        ex_data->pkey = pkey;
+    }
+
+done:
+    object_ex_data_unlock(key_obj);
+
+    return rc;
+}
+
+/*
+ * Returns TRUE if the operation with the mechanism and key is performed in
+ * host software. The key's SPKI is parsed here already, so that an operation
+ * whose SPKI can not be used in host software is routed to the EP11 crypto
+ * adapter at init time.
+ */
+CK_BBOOL ep11tok_host_pubkey_mech_available(STDLL_TokData_t *tokdata,
+                                            CK_MECHANISM_TYPE mech,
+                                            CK_OBJECT_HANDLE hKey)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+    OBJECT *key_obj;
+    int pkey_type;
+    CK_RV rc;
+
+    if (!ep11_data->host_pubkey_ops)
+        return CK_FALSE;
+
+    switch (mech) {
+    case CKM_RSA_PKCS:
+    case CKM_RSA_X_509:
+    case CKM_RSA_PKCS_PSS:
+    case CKM_RSA_PKCS_OAEP:
+        pkey_type = EVP_PKEY_RSA;
+        break;
+    case CKM_ECDSA:
+        if (!ep11tok_ec_curve_supported(tokdata, hKey))
+            return CK_FALSE;
+        pkey_type = EVP_PKEY_EC;
+        break;
+    default:
+        return CK_FALSE;
+    }
+
+    rc = object_mgr_find_in_map1(tokdata, hKey, &key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s key 0x%lx not mapped\n", __func__, hKey);
+        return CK_FALSE;
+    }
+
+    rc = ep11tok_host_pubkey_prepare(tokdata, key_obj, pkey_type);
+
+    object_put(tokdata, key_obj, TRUE);
+    key_obj = NULL;
+
+    return rc == CKR_OK;
+}
+
 CK_RV ep11tok_libica_digest(STDLL_TokData_t *tokdata,
                             ep11_private_data_t *ep11_data,
                             CK_MECHANISM_TYPE mech, libica_sha_context_t *ctx,
@@ -5986,6 +6143,12 @@ CK_RV token_specific_rsa_verify(STDLL_TokData_t *tokdata, SESSION *session,
     CK_BYTE *useblob;
     size_t useblob_len;
 
+    if (ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_RSA) == CKR_OK)
+        return openssl_specific_rsa_pkcs_verify(tokdata, session, in_data,
+                                                in_data_len, signature,
+                                                sig_len, key_obj,
+                                                openssl_specific_rsa_encrypt);
+
     rc = obj_opaque_2_blob(tokdata, key_obj, &spki, &spki_len);
     if (rc != CKR_OK) {
         TRACE_ERROR("%s no blob rc=0x%lx\n", __func__, rc);
@@ -6014,6 +6177,96 @@ CK_RV token_specific_rsa_verify(STDLL_TokData_t *tokdata, SESSION *session,
     return rc;
 }
 
+/*
+ * The following public key operations are only available in host software,
+ * see ep11tok_host_pubkey_mech_available().
+ */
+CK_RV token_specific_rsa_encrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
+                                 CK_ULONG in_data_len, CK_BYTE *out_data,
+                                 CK_ULONG *out_data_len, OBJECT *key_obj)
+{
+    CK_RV rc;
+
+    rc = ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_RSA);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s rc=0x%lx\n", __func__, rc);
+        return rc;
+    }
+
+    return openssl_specific_rsa_pkcs_encrypt(tokdata, in_data, in_data_len,
+                                             out_data, out_data_len, key_obj,
+                                             openssl_specific_rsa_encrypt);
+}
+
+CK_RV token_specific_rsa_x509_encrypt(STDLL_TokData_t *tokdata,
+                                      CK_BYTE *in_data, CK_ULONG in_data_len,
+                                      CK_BYTE *out_data,
+                                      CK_ULONG *out_data_len, OBJECT *key_obj)
+{
+    CK_RV rc;
+
+    rc = ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_RSA);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s rc=0x%lx\n", __func__, rc);
+        return rc;
+    }
+
+    return openssl_specific_rsa_x509_encrypt(tokdata, in_data, in_data_len,
+                                             out_data, out_data_len, key_obj,
+                                             openssl_specific_rsa_encrypt);
+}
+
+CK_RV token_specific_rsa_x509_verify(STDLL_TokData_t *tokdata,
+                                     CK_BYTE *in_data, CK_ULONG in_data_len,
+                                     CK_BYTE *signature, CK_ULONG sig_len,
+                                     OBJECT *key_obj)
+{
+    CK_RV rc;
+
+    rc = ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_RSA);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s rc=0x%lx\n", __func__, rc);
+        return rc;
+    }
+
+    return openssl_specific_rsa_x509_verify(tokdata, in_data, in_data_len,
+                                            signature, sig_len, key_obj,
+                                            openssl_specific_rsa_encrypt);
+}
+
+CK_RV token_specific_rsa_oaep_encrypt(STDLL_TokData_t *tokdata,
+                                      ENCR_DECR_CONTEXT *ctx,
+                                      CK_BYTE *in_data, CK_ULONG in_data_len,
+                                      CK_BYTE *out_data,
+                                      CK_ULONG *out_data_len, CK_BYTE *hash,
+                                      CK_ULONG hlen)
+{
+    OBJECT *key_obj = NULL;
+    CK_RV rc;
+
+    rc = object_mgr_find_in_map1(tokdata, ctx->key, &key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s key 0x%lx not mapped\n", __func__, ctx->key);
+        return rc;
+    }
+
+    rc = ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_RSA);
+
+    /* Release obj lock, openssl_specific_rsa_oaep_encrypt re-acquires it */
+    object_put(tokdata, key_obj, TRUE);
+    key_obj = NULL;
+
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s rc=0x%lx\n", __func__, rc);
+        return rc;
+    }
+
+    return openssl_specific_rsa_oaep_encrypt(tokdata, ctx, in_data,
+                                             in_data_len, out_data,
+                                             out_data_len, hash, hlen,
+                                             openssl_specific_rsa_encrypt);
+}
+
 CK_RV token_specific_rsa_pss_sign(STDLL_TokData_t *tokdata, SESSION *session,
                                   SIGN_VERIFY_CONTEXT *ctx,
                                   CK_BYTE *in_data, CK_ULONG in_data_len,
@@ -6078,6 +6331,16 @@ CK_RV token_specific_rsa_pss_verify(STDLL_TokData_t *tokdata, SESSION *session,
         return rc;
     }
 
+    if (ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_RSA) == CKR_OK) {
+        /* Release obj lock, openssl_specific_rsa_pss_verify re-acquires it */
+        object_put(tokdata, key_obj, TRUE);
+        key_obj = NULL;
+
+        return openssl_specific_rsa_pss_verify(tokdata, session, ctx, in_data,
+                                               in_data_len, signature, sig_len,
+                                               openssl_specific_rsa_encrypt);
+    }
+
     mech.mechanism = CKM_RSA_PKCS_PSS;
     mech.ulParameterLen = ctx->mech.ulParameterLen;
     mech.pParameter = ctx->mech.pParameter;
@@ -6199,6 +6462,11 @@ CK_RV token_specific_ec_verify(STDLL_TokData_t *tokdata, SESSION  *session,
     }
 #endif /* NO_PKEY */
 
+    if (ep11tok_host_pubkey_prepare(tokdata, key_obj, EVP_PKEY_EC) == CKR_OK)
+        return openssl_specific_ec_verify(tokdata, session, in_data,
+                                          in_data_len, out_data, out_data_len,
+                                          key_obj);
+
     mech.mechanism = CKM_ECDSA;
     mech.pParameter = NULL;
     mech.ulParameterLen = 0;
@@ -13278,6 +13546,16 @@ static CK_RV read_adapter_config_file(STDLL_TokData_t * tokdata,
             continue;
         }
 
+        if (strcmp(bare->base.key, "HOST_PUBLIC_KEY_OPERATIONS") == 0) {
+            ep11_data->host_pubkey_ops = 1;
+            continue;
+        }
+
+        if (strcmp(bare->base.key, "APQN_LOAD_BALANCING") == 0) {
+            ep11_data->apqn_load_balancing = 1;
+            continue;
+        }
+
         if (strcmp(bare->base.key, "PKEY_MODE") == 0) {
             rc = ep11_config_next(&c, CT_BARECONST, fname, "PKEY mode");
             if (rc != CKR_OK)
@@ -15694,6 +15972,317 @@ CK_RV token_specific_handle_event(STDLL_TokData_t *tokdata,
     return CKR_OK;
 }
 
+struct sched_apqns_data {
+    unsigned int num_apqns;
+    uint_32 adapters[MAX_APQN];
+    uint_32 domains[MAX_APQN];
+};
+
+static CK_RV sched_apqns_handler(uint_32 adapter, uint_32 domain,
+                                 void *handler_data)
+{
+    struct sched_apqns_data *sad = (struct sched_apqns_data *)handler_data;
+
+    if (!is_apqn_online(adapter, domain)) {
+        TRACE_DEVEL("%s APQN %02X.%04X is offline\n", __func__,
+                    adapter, domain);
+        return CKR_OK;
+    }
+
+    if (sad->num_apqns >= MAX_APQN)
+        return CKR_OK;
+
+    sad->adapters[sad->num_apqns] = adapter;
+    sad->domains[sad->num_apqns] = domain;
+    sad->num_apqns++;
+
+    return CKR_OK;
+}
+
+static void ep11tok_sched_trace_stats(struct ep11_sched *sched)
+{
+    struct ep11_sched_apqn *apqn;
+    unsigned int i;
+
+    for (i = 0; i < sched->num_apqns; i++) {
+        apqn = &sched->apqns[i];
+        TRACE_INFO("APQN %02X.%04X: requests: %lu errors: %lu timeouts: %lu "
+                   "ejections: %lu in flight: %lu avg latency: %lu usec\n",
+                   apqn->target_info.adapter, apqn->target_info.domain,
+                   apqn->requests, apqn->errors, apqn->timeouts,
+                   apqn->ejections, apqn->inflight, apqn->ewma_usec);
+    }
+}
+
+static void ep11tok_sched_free(struct ep11_sched *sched)
+{
+    unsigned int i;
+
+    if (sched == NULL)
+        return;
+
+    ep11tok_sched_trace_stats(sched);
+
+    for (i = 0; i < sched->num_apqns; i++)
+        dll_m_rm_module(NULL, sched->apqns[i].target_info.target);
+
+    pthread_mutex_destroy(&sched->mutex);
+    free(sched);
+}
+
+/*
+ * Sets up the APQN load balancing scheduler for a group target info: For
+ * each online APQN of the group, a single APQN target is created. The per
+ * APQN target infos are copies of the group's target info, and share its
+ * card versions.
+ */
+static CK_RV ep11tok_setup_sched(STDLL_TokData_t *tokdata,
+                                 ep11_target_info_t *target_info)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+    struct sched_apqns_data *sad;
+    struct ep11_sched *sched = NULL;
+    struct ep11_sched_apqn *apqn;
+    struct XCP_Module module;
+    unsigned int i;
+    CK_RV rc;
+
+    if (dll_m_add_module == NULL) {
+        TRACE_WARNING("%s Function dll_m_add_module is not available, APQN "
+                      "load balancing is not possible\n", __func__);
+        return CKR_OK;
+    }
+
+    sad = calloc(1, sizeof(*sad));
+    if (sad == NULL) {
+        TRACE_ERROR("%s Memory allocation failed\n", __func__);
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = handle_all_ep11_cards(&ep11_data->target_list, sched_apqns_handler,
+                               sad);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s handle_all_ep11_cards failed: rc=0x%lx\n",
+                    __func__, rc);
+        goto out;
+    }
+
+    if (sad->num_apqns < 2) {
+        TRACE_DEVEL("%s %u APQN(s) online, no load balancing\n", __func__,
+                    sad->num_apqns);
+        goto out;
+    }
+
+    sched = calloc(1, sizeof(*sched) +
+                            sad->num_apqns * sizeof(struct ep11_sched_apqn));
+    if (sched == NULL) {
+        TRACE_ERROR("%s Memory allocation failed\n", __func__);
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    if (pthread_mutex_init(&sched->mutex, NULL) != 0) {
+        TRACE_ERROR("%s Initializing the scheduler mutex failed\n", __func__);
+        free(sched);
+        sched = NULL;
+        rc = CKR_CANT_LOCK;
+        goto out;
+    }
+
+    memset(&module, 0, sizeof(module));
+    module.version = ep11_data->ep11_lib_version.major >= 3 ? XCP_MOD_VERSION_2
+                                                            : XCP_MOD_VERSION_1;
+    module.flags = XCP_MFL_VIRTUAL | XCP_MFL_MODULE;
+    module.api = target_info->used_firmware_API_version;
+
+    for (i = 0; i < sad->num_apqns; i++) {
+        apqn = &sched->apqns[i];
+        apqn->target_info = *target_info;
+        apqn->target_info.ref_count = 0;
+        apqn->target_info.adapter = sad->adapters[i];
+        apqn->target_info.domain = sad->domains[i];
+        apqn->target_info.sched_apqn = apqn;
+        apqn->group = target_info;
+        apqn->stat = STAT_DEVICE(tokdata, sad->adapters[i], sad->domains[i]);
+
+        apqn->target_info.target = XCP_TGT_INIT;
+        module.module_nr = sad->adapters[i];
+        memset(module.domainmask, 0, sizeof(module.domainmask));
+        XCPTGTMASK_SET_DOM(module.domainmask, sad->domains[i]);
+
+        rc = dll_m_add_module(&module, &apqn->target_info.target);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("%s dll_m_add_module (%02x.%04x) failed: rc=%ld\n",
+                        __func__, sad->adapters[i], sad->domains[i], rc);
+            sched->num_apqns = i;
+            ep11tok_sched_free(sched);
+            sched = NULL;
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+        sched->num_apqns++;
+    }
+
+    target_info->sched = sched;
+
+    TRACE_INFO("%s APQN load balancing across %u APQNs\n", __func__,
+               sched->num_apqns);
+
+out:
+    free(sad);
+
+    return rc;
+}
+
+/*
+ * Selects the APQN for a request: the healthy APQN with the lowest number of
+ * requests in flight weighted with its average latency. Ties are broken
+ * round robin. Every EP11_SCHED_PROBE_INTERVAL-th request goes to the next
+ * healthy APQN round robin instead, so that the average latency of an APQN
+ * that is not selected otherwise is refreshed. If all APQNs are ejected, the
+ * one that returns first is used.
+ */
+static ep11_target_info_t *ep11tok_sched_select(struct ep11_sched *sched)
+{
+    struct ep11_sched_apqn *apqn, *best = NULL, *returns_first = NULL;
+    unsigned long load, best_load = ULONG_MAX;
+    time_t now = time(NULL);
+    unsigned long n;
+    unsigned int i, start;
+    CK_BBOOL probe;
+
+    n = __sync_fetch_and_add(&sched->next, 1);
+    probe = (n % EP11_SCHED_PROBE_INTERVAL == 0);
+    start = (probe ? n / EP11_SCHED_PROBE_INTERVAL : n) % sched->num_apqns;
+
+    for (i = 0; i < sched->num_apqns; i++) {
+        apqn = &sched->apqns[(start + i) % sched->num_apqns];
+
+        if (apqn->ejected_until > now) {
+            if (returns_first == NULL ||
+                apqn->ejected_until < returns_first->ejected_until)
+                returns_first = apqn;
+            continue;
+        }
+
+        if (probe) {
+            best = apqn;
+            break;
+        }
+
+        load = (apqn->inflight + 1) * (apqn->ewma_usec + 1);
+        if (load < best_load) {
+            best = apqn;
+            best_load = load;
+        }
+    }
+
+    if (best == NULL)
+        best = returns_first;
+
+    __sync_add_and_fetch(&best->inflight, 1);
+
+    return &best->target_info;
+}
+
+void ep11tok_sched_request_start(ep11_target_info_t *target_info,
+                                 struct timespec *start)
+{
+    if (target_info->sched_apqn == NULL)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+/*
+ * Accounts a request sent to an APQN selected by the scheduler. Returns TRUE
+ * if the APQN failed, and the request should be retried with another APQN.
+ */
+CK_BBOOL ep11tok_sched_request_done(STDLL_TokData_t *tokdata,
+                                    ep11_target_info_t *target_info,
+                                    CK_RV rc, const struct timespec *start)
+{
+    struct ep11_sched_apqn *apqn = target_info->sched_apqn;
+    struct ep11_sched *sched;
+    struct timespec now;
+    unsigned long usec;
+    CK_BBOOL failed, timeout, eject = FALSE;
+
+    if (apqn == NULL)
+        return CK_FALSE;
+
+    sched = apqn->group->sched;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    usec = (now.tv_sec - start->tv_sec) * 1000000UL +
+           (now.tv_nsec - start->tv_nsec) / 1000;
+
+    failed = (rc == CKR_IBM_TARGET_INVALID || rc == CKR_DEVICE_ERROR ||
+              rc == CKR_DEVICE_REMOVED ||
+              (rc == CKR_FUNCTION_FAILED &&
+               !is_apqn_online(target_info->adapter, target_info->domain)));
+    timeout = (usec > EP11_SCHED_TIMEOUT_MSEC * 1000UL);
+
+    if (pthread_mutex_lock(&sched->mutex) != 0) {
+        TRACE_DEVEL("%s Scheduler Lock failed.\n", __func__);
+        return failed;
+    }
+
+    apqn->requests++;
+
+    if (failed) {
+        apqn->errors++;
+        eject = TRUE;
+    } else {
+        if (apqn->ewma_usec == 0)
+            apqn->ewma_usec = usec;
+        else
+            apqn->ewma_usec = apqn->ewma_usec - (apqn->ewma_usec >>
+                                                    EP11_SCHED_EWMA_SHIFT) +
+                                        (usec >> EP11_SCHED_EWMA_SHIFT);
+
+        if (timeout) {
+            apqn->timeouts++;
+            apqn->consecutive_timeouts++;
+            if (apqn->consecutive_timeouts >= EP11_SCHED_MAX_TIMEOUTS)
+                eject = TRUE;
+        } else {
+            apqn->consecutive_timeouts = 0;
+        }
+    }
+
+    if (eject) {
+        apqn->ejected_until = time(NULL) + EP11_SCHED_EJECT_SECONDS;
+        apqn->consecutive_timeouts = 0;
+        apqn->ejections++;
+    }
+
+    pthread_mutex_unlock(&sched->mutex);
+
+    if (apqn->stat != NULL) {
+        __sync_add_and_fetch(&apqn->stat->requests, 1);
+        __sync_add_and_fetch(&apqn->stat->usec, usec);
+        if (failed)
+            __sync_add_and_fetch(&apqn->stat->errors, 1);
+        else if (timeout)
+            __sync_add_and_fetch(&apqn->stat->timeouts, 1);
+        if (eject)
+            __sync_add_and_fetch(&apqn->stat->ejections, 1);
+    }
+
+    if (eject) {
+        TRACE_WARNING("%s APQN %02X.%04X is not used for %d seconds, rc=0x%lx "
+                      "latency=%lu usec\n", __func__, target_info->adapter,
+                      target_info->domain, EP11_SCHED_EJECT_SECONDS, rc, usec);
+        OCK_SYSLOG(LOG_WARNING, "Slot %lu: EP11 APQN %02X.%04X %s, it is not "
+                   "used for %d seconds\n", tokdata->slot_id,
+                   target_info->adapter, target_info->domain,
+                   failed ? "failed" : "timed out", EP11_SCHED_EJECT_SECONDS);
+    }
+
+    return failed;
+}
+
 /*
  * Refreshes the target info using the currently configured and available
  * APQNs. Registers the newly allocated target info as the current one in a
@@ -15743,6 +16332,15 @@ CK_RV refresh_target_info(STDLL_TokData_t *tokdata, CK_BBOOL wait_for_new_wk)
         rc = ep11tok_setup_target(tokdata, target_info);
         if (rc != CKR_OK)
             goto error;
+
+        if (ep11_data->apqn_load_balancing) {
+            rc = ep11tok_setup_sched(tokdata, target_info);
+            if (rc != CKR_OK) {
+                if (dll_m_rm_module != NULL)
+                    dll_m_rm_module(NULL, target_info->target);
+                goto error;
+            }
+        }
     }
 
     /* Set the new one as the current one (locked against concurrent get's) */
@@ -15818,6 +16416,10 @@ ep11_target_info_t *get_target_info(STDLL_TokData_t *tokdata)
         return NULL;
     }
 
+    /* The selected APQN's target info holds the group's reference */
+    if (target_info->sched != NULL)
+        return ep11tok_sched_select(target_info->sched);
+
     return (ep11_target_info_t *)target_info;
 }
 
@@ -15833,6 +16435,11 @@ void put_target_info(STDLL_TokData_t *tokdata, ep11_target_info_t *target_info)
     if (target_info == NULL)
         return;
 
+    if (target_info->sched_apqn != NULL) {
+        __sync_sub_and_fetch(&target_info->sched_apqn->inflight, 1);
+        target_info = target_info->sched_apqn->group;
+    }
+
     if (target_info->ref_count > 0) {
         ref_count = __sync_sub_and_fetch(&target_info->ref_count, 1);
 
@@ -15848,6 +16455,7 @@ void put_target_info(STDLL_TokData_t *tokdata, ep11_target_info_t *target_info)
         TRACE_DEBUG("%s: target_info: %p is freed\n", __func__,
                     (void *)target_info);
 
+        ep11tok_sched_free(target_info->sched);
         if (dll_m_rm_module != NULL)
             dll_m_rm_module(NULL, target_info->target);
         free_card_versions(target_info->card_versions);
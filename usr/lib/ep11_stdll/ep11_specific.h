@@ -22,6 +22,7 @@
 #include <ica_api.h>
 
 #include <pthread.h>
+#include <time.h>
 
 #define EP11SHAREDLIB_NAME          "OCK_EP11_LIBRARY"
 #define EP11SHAREDLIB_V4            "libep11.so.4"
@@ -260,11 +261,46 @@ typedef struct {
     CK_CHAR serialNumber[16];
     CK_BYTE pqc_strength[PQC_BYTES];
     int single_apqn;
-    uint_32 adapter; /* set if single_apqn = 1 */
-    uint_32 domain; /* set if single_apqn = 1 */
+    uint_32 adapter; /* set if single_apqn = 1 or sched_apqn != NULL */
+    uint_32 domain; /* set if single_apqn = 1 or sched_apqn != NULL */
     volatile int single_apqn_has_new_wk;
+    struct ep11_sched *sched; /* set if APQN load balancing is active */
+    struct ep11_sched_apqn *sched_apqn; /* set for an APQN of the scheduler */
 } ep11_target_info_t;
 
+/*
+ * APQN load balancing (APQN_LOAD_BALANCING): Each request is sent to the
+ * least loaded APQN, based on the number of requests in flight and the
+ * average request latency. APQNs that fail a request, or that exceed the
+ * request timeout several times in a row, are not used for a while.
+ */
+#define EP11_SCHED_EJECT_SECONDS        30
+#define EP11_SCHED_TIMEOUT_MSEC         5000
+#define EP11_SCHED_MAX_TIMEOUTS         3
+#define EP11_SCHED_EWMA_SHIFT           3 /* weight of a new sample: 1/8 */
+#define EP11_SCHED_PROBE_INTERVAL       16 /* every 16th request round robin */
+
+struct ep11_sched_apqn {
+    ep11_target_info_t target_info; /* copy of the group's info, for this APQN */
+    ep11_target_info_t *group;
+    volatile unsigned long inflight;
+    volatile unsigned long ewma_usec;
+    volatile time_t ejected_until;
+    unsigned int consecutive_timeouts;
+    unsigned long requests;
+    unsigned long errors;
+    unsigned long timeouts;
+    unsigned long ejections;
+    struct stat_device *stat; /* NULL if statistics are disabled */
+};
+
+struct ep11_sched {
+    pthread_mutex_t mutex;
+    volatile unsigned long next;
+    unsigned int num_apqns;
+    struct ep11_sched_apqn apqns[];
+};
+
 typedef struct {
     char token_config_filename[PATH_MAX];
     ep11_target_t target_list;
@@ -279,6 +315,8 @@ typedef struct {
     int vhsm_mode;
     int fips_session_mode;
     int optimize_single_ops;
+    int host_pubkey_ops;
+    int apqn_load_balancing;
     int pkey_mode;
     volatile int pkey_combined_extract_supported;
     volatile int pkey_wrap_supported;
@@ -394,6 +432,11 @@ CK_RV ep11_login_handler(uint_32 adapter, uint_32 domain, void *handler_data);
 
 ep11_target_info_t *get_target_info(STDLL_TokData_t *tokdata);
 void put_target_info(STDLL_TokData_t *tokdata, ep11_target_info_t *target_info);
+void ep11tok_sched_request_start(ep11_target_info_t *target_info,
+                                 struct timespec *start);
+CK_BBOOL ep11tok_sched_request_done(STDLL_TokData_t *tokdata,
+                                    ep11_target_info_t *target_info,
+                                    CK_RV rc, const struct timespec *start);
 CK_RV refresh_target_info(STDLL_TokData_t *tokdata, CK_BBOOL wait_for_new_wk);
 
 CK_RV get_ep11_target_for_apqn(uint_32 adapter, uint_32 domain,
@@ -584,6 +627,10 @@ CK_BBOOL ep11tok_libica_mech_available(STDLL_TokData_t *tokdata,
                                        CK_MECHANISM_TYPE mech,
                                        CK_OBJECT_HANDLE hKey);
 
+CK_BBOOL ep11tok_host_pubkey_mech_available(STDLL_TokData_t *tokdata,
+                                            CK_MECHANISM_TYPE mech,
+                                            CK_OBJECT_HANDLE hKey);
+
 CK_RV ep11tok_copy_firmware_info(STDLL_TokData_t *tokdata,
                                  CK_TOKEN_INFO_PTR pInfo);
 
@@ -617,6 +664,7 @@ CK_RV do_LogoutExtended(XCP_LoginAlgorithm_t alg,
 #define RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)                     \
                 do {                                                     \
                     ep11_target_info_t* target_info;                     \
+                    struct timespec sched_start;                         \
                     int retry_count;                                     \
                     CK_RV rc2;                                           \
                     if (((ep11_private_data_t *)                         \
@@ -633,11 +681,28 @@ CK_RV do_LogoutExtended(XCP_LoginAlgorithm_t alg,
                     for (retry_count = 0;                                \
                          target_info != NULL &&                          \
                          retry_count < MAX_RETRY_COUNT;                  \
-                         retry_count ++) {
+                         retry_count ++) {                               \
+                         ep11tok_sched_request_start(target_info,        \
+                                                     &sched_start);
 
 #define RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)              \
                          if ((target_info) == NULL)                      \
                              break;                                      \
+                         if (ep11tok_sched_request_done((tokdata),       \
+                                                        target_info,     \
+                                                        (rc),            \
+                                                        &sched_start)) { \
+                             /* APQN failed, scheduler selects other */  \
+                             TRACE_DEVEL("%s APQN failed, select other\n",\
+                                         __func__);                      \
+                             put_target_info((tokdata), target_info);    \
+                             target_info = get_target_info((tokdata));   \
+                             if (target_info == NULL) {                  \
+                                 (rc) = CKR_FUNCTION_FAILED;             \
+                                 break;                                  \
+                             }                                           \
+                             continue;                                   \
+                         }                                               \
                          if (target_info->single_apqn &&                 \
                              ((rc) == CKR_IBM_TARGET_INVALID ||          \
                               ((rc) == CKR_FUNCTION_FAILED &&            \
@@ -681,6 +746,7 @@ CK_RV do_LogoutExtended(XCP_LoginAlgorithm_t alg,
  */
 #define RETRY_SINGLE_APQN_START(tokdata, rc)                             \
                 do {                                                     \
+                    struct timespec sched_start;                         \
                     int retry_count;                                     \
                     if (((ep11_private_data_t *)                         \
                               (tokdata)->private_data)->inconsistent) {  \
@@ -690,11 +756,27 @@ CK_RV do_LogoutExtended(XCP_LoginAlgorithm_t alg,
                     }                                                    \
                     for (retry_count = 0;                                \
                          retry_count < MAX_RETRY_COUNT;                  \
-                         retry_count ++) {
+                         retry_count ++) {                               \
+                         clock_gettime(CLOCK_MONOTONIC, &sched_start);
 
 #define RETRY_SINGLE_APQN_END(rc, tokdata, target_info)                  \
                          if ((target_info) == NULL)                      \
                              break;                                      \
+                         if (ep11tok_sched_request_done((tokdata),       \
+                                                        (target_info),   \
+                                                        (rc),            \
+                                                        &sched_start)) { \
+                             /* APQN failed, scheduler selects other */  \
+                             TRACE_DEVEL("%s APQN failed, select other\n",\
+                                         __func__);                      \
+                             put_target_info((tokdata), (target_info));  \
+                             (target_info) = get_target_info((tokdata)); \
+                             if ((target_info) == NULL) {                \
+                                 (rc) = CKR_FUNCTION_FAILED;             \
+                                 break;                                  \
+                             }                                           \
+                             continue;                                   \
+                         }                                               \
                          if ((target_info)->single_apqn &&               \
                              ((rc) == CKR_IBM_TARGET_INVALID ||          \
                               ((rc) == CKR_FUNCTION_FAILED &&            \
@@ -52,7 +52,9 @@ opencryptoki_stdll_libpkcs11_ep11_la_SOURCES = usr/lib/common/asn1.c	\
 	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l		\
 	usr/lib/common/pqc_supported.c					\
 	usr/lib/hsm_mk_change/hsm_mk_change.c				\
-	usr/lib/common/btree.c usr/lib/common/sess_mgr.c
+	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
+	usr/lib/common/slab.c usr/lib/common/obj_cache.c		\
+	usr/lib/common/login_cache.c usr/lib/common/async_mgr.c
 
 if !NO_PKEY
 opencryptoki_stdll_libpkcs11_ep11_la_SOURCES +=				\
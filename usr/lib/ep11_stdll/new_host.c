@@ -81,11 +81,13 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    rc = bt_init(&sltp->TokData->sess_btree, free);
-    rc |= bt_init(&sltp->TokData->object_map_btree, free);
-    rc |= bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
-    rc |= bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
-    rc |= bt_init(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    rc = slab_mgr_init(sltp->TokData);
+    rc |= bt_init_epoch(&sltp->TokData->sess_btree, slab_free);
+    rc |= bt_init_epoch(&sltp->TokData->object_map_btree, slab_free);
+    rc |= bt_init_epoch(&sltp->TokData->sess_obj_btree, call_object_free);
+    rc |= bt_init_epoch(&sltp->TokData->priv_token_obj_btree, call_object_free);
+    rc |= bt_init_epoch(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    rc |= async_mgr_init(sltp->TokData);
     if (rc != CKR_OK) {
         TRACE_ERROR("Btree init failed\n");
         rc = CKR_FUNCTION_FAILED;
@@ -114,6 +116,7 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     }
 
     sltp->TokData->version = sinfp->version;
+    sltp->TokData->login_cache_timeout = sinfp->logincache;
     TRACE_DEVEL("Token version: %u.%u\n",
                 (unsigned int)(sinfp->version >> 16),
                 (unsigned int)(sinfp->version & 0xffff));
@@ -206,6 +209,8 @@ done:
             bt_destroy(&sltp->TokData->sess_obj_btree);
             bt_destroy(&sltp->TokData->priv_token_obj_btree);
             bt_destroy(&sltp->TokData->publ_token_obj_btree);
+            slab_mgr_final(sltp->TokData);
+            async_mgr_final(sltp->TokData, FALSE);
         }
     }
 
@@ -232,6 +237,9 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
         return CKR_CRYPTOKI_NOT_INITIALIZED;
     }
 
+    /* Complete or cancel outstanding async requests */
+    async_mgr_final(tokdata, in_fork_initializer);
+
     tokdata->initialized = FALSE;
 
     if (session_mgr_so_session_exists(tokdata) ||
@@ -259,6 +267,7 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
         return rc;
     }
 
+    slab_mgr_final(tokdata);
     final_data_store(tokdata);
 
     return rc;
@@ -456,6 +465,8 @@ CK_RV SC_InitToken(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, CK_CHAR_PTR pPin,
      */
     object_mgr_destroy_token_objects(tokdata);
     delete_token_data(tokdata);
+    login_cache_revoke(tokdata, CKU_SO);
+    login_cache_revoke(tokdata, CKU_USER);
 
     load_token_data(tokdata, sid);
     init_slotInfo(&(tokdata->slot_info));
@@ -573,6 +584,8 @@ CK_RV SC_InitPIN(STDLL_TokData_t * tokdata, ST_SESSION_HANDLE * sSession,
         }
     }
 
+    login_cache_revoke(tokdata, CKU_USER);
+
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to get process lock.\n");
@@ -775,6 +788,8 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             }
         }
 
+        login_cache_revoke(tokdata, CKU_USER);
+
         rc = XProcLock(tokdata);
         if (rc != CKR_OK) {
             TRACE_DEVEL("Failed to get process lock.\n");
@@ -896,6 +911,8 @@ CK_RV SC_SetPIN(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
             }
         }
 
+        login_cache_revoke(tokdata, CKU_SO);
+
         rc = XProcLock(tokdata);
         if (rc != CKR_OK) {
             TRACE_DEVEL("Failed to get process lock.\n");
@@ -1269,6 +1286,7 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     CK_BYTE hash_sha[SHA1_HASH_SIZE];
     CK_RV rc = CKR_OK;
     unsigned char login_key[32], wrap_key[32];
+    CK_BBOOL cached;
     TOKEN_DATA_VERSION *dat;
 
     /* In v2.11, logins should be exclusive, since token
@@ -1412,15 +1430,6 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->user_wrap_salt, 64,
-                                           dat->user_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
             if (CRYPTO_memcmp(dat->user_login_key,
                               login_key, 256 / 8) != 0) {
                 set_login_flags(userType, flags);
@@ -1429,12 +1438,29 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
+            /* Only the wrapping key is cached, the PIN is always verified */
+            cached = (login_cache_get(tokdata, CKU_USER, login_key,
+                                      wrap_key) == CKR_OK);
+            if (!cached) {
+                rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
+                                               dat->user_wrap_salt, 64,
+                                               dat->user_wrap_it, EVP_sha512(),
+                                               256 / 8, wrap_key);
+                if (rc != CKR_OK) {
+                    TRACE_DEVEL("PBKDF2 failed.\n");
+                    goto done;
+                }
+            }
+
             /* Successful login, clear flags */
             *flags &= ~(CKF_USER_PIN_LOCKED |
                         CKF_USER_PIN_FINAL_TRY | CKF_USER_PIN_COUNT_LOW);
 
             memcpy(tokdata->user_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->so_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, CKU_USER, login_key, wrap_key);
         }
 
         rc = load_masterkey_user(tokdata);
@@ -1499,15 +1525,6 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
-            rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
-                                           dat->so_wrap_salt, 64,
-                                           dat->so_wrap_it, EVP_sha512(),
-                                           256 / 8, wrap_key);
-            if (rc != CKR_OK) {
-                TRACE_DEVEL("PBKDF2 failed.\n");
-                goto done;
-            }
-
             if (CRYPTO_memcmp(dat->so_login_key,
                               login_key, 256 / 8) != 0) {
                 set_login_flags(userType, flags);
@@ -1516,12 +1533,28 @@ CK_RV SC_Login(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
                 goto done;
             }
 
+            cached = (login_cache_get(tokdata, CKU_SO, login_key,
+                                      wrap_key) == CKR_OK);
+            if (!cached) {
+                rc = compute_PKCS5_PBKDF2_HMAC(tokdata, pPin, ulPinLen,
+                                               dat->so_wrap_salt, 64,
+                                               dat->so_wrap_it, EVP_sha512(),
+                                               256 / 8, wrap_key);
+                if (rc != CKR_OK) {
+                    TRACE_DEVEL("PBKDF2 failed.\n");
+                    goto done;
+                }
+            }
+
             /* Successful login, clear flags */
             *flags &= ~(CKF_SO_PIN_LOCKED | CKF_SO_PIN_FINAL_TRY |
                         CKF_SO_PIN_COUNT_LOW);
 
             memcpy(tokdata->so_wrap_key, wrap_key, 256 / 8);
             memset(tokdata->user_wrap_key, 0, 256 / 8);
+
+            if (!cached)
+                login_cache_put(tokdata, CKU_SO, login_key, wrap_key);
         }
 
         rc = load_masterkey_so(tokdata);
@@ -1672,6 +1705,9 @@ CK_RV SC_Logout(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession)
     bt_for_each_node(tokdata, &tokdata->sess_btree, _ep11tok_logout_session,
                      NULL);
 
+    login_cache_revoke(tokdata, session_mgr_so_session_exists(tokdata) ?
+                                                        CKU_SO : CKU_USER);
+
     rc = session_mgr_logout_all(tokdata);
     if (rc != CKR_OK)
         TRACE_DEVEL("session_mgr_logout_all failed.\n");
@@ -2192,6 +2228,17 @@ CK_RV SC_EncryptInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
+    if (ep11tok_host_pubkey_mech_available(tokdata, pMechanism->mechanism,
+                                           hKey)) {
+        sess->encr_ctx.count_statistics = TRUE;
+        rc = encr_mgr_init(tokdata, sess, &sess->encr_ctx, OP_ENCRYPT_INIT,
+                           pMechanism, hKey, TRUE);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_init() failed.\n");
+
+        goto done;
+    }
+
     sess->encr_ctx.multi_init = FALSE;
     sess->encr_ctx.multi = FALSE;
 
@@ -2289,6 +2336,18 @@ CK_RV SC_Encrypt(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     if (!pEncryptedData)
         length_only = TRUE;
 
+    if (ep11tok_host_pubkey_mech_available(tokdata,
+                                           sess->encr_ctx.mech.mechanism,
+                                           sess->encr_ctx.key)) {
+        rc = encr_mgr_encrypt(tokdata, sess, length_only, &sess->encr_ctx,
+                              pData, ulDataLen, pEncryptedData,
+                              pulEncryptedDataLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt() failed.\n");
+
+        goto done;
+    }
+
     if (sess->encr_ctx.multi_init == FALSE) {
         sess->encr_ctx.multi = FALSE;
         sess->encr_ctx.multi_init = TRUE;
@@ -2373,6 +2432,18 @@ CK_RV SC_EncryptUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
+    if (ep11tok_host_pubkey_mech_available(tokdata,
+                                           sess->encr_ctx.mech.mechanism,
+                                           sess->encr_ctx.key)) {
+        rc = encr_mgr_encrypt_update(tokdata, sess, !pEncryptedPart,
+                                     &sess->encr_ctx, pPart, ulPartLen,
+                                     pEncryptedPart, pulEncryptedPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt_update() failed.\n");
+
+        goto done;
+    }
+
     if (sess->encr_ctx.multi_init == FALSE) {
         sess->encr_ctx.multi = TRUE;
         sess->encr_ctx.multi_init = TRUE;
@@ -2464,6 +2535,18 @@ CK_RV SC_EncryptFinal(STDLL_TokData_t * tokdata, ST_SESSION_HANDLE * sSession,
     if (!pLastEncryptedPart)
         length_only = TRUE;
 
+    if (ep11tok_host_pubkey_mech_available(tokdata,
+                                           sess->encr_ctx.mech.mechanism,
+                                           sess->encr_ctx.key)) {
+        rc = encr_mgr_encrypt_final(tokdata, sess, length_only,
+                                    &sess->encr_ctx, pLastEncryptedPart,
+                                    pulLastEncryptedPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt_final() failed.\n");
+
+        goto done;
+    }
+
     if (sess->encr_ctx.init_pending) {
         /* EncryptInit without Update, no EncryptFinal necessary */
         sess->encr_ctx.init_pending = 0;
@@ -3564,7 +3647,9 @@ CK_RV SC_VerifyInit(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
         goto done;
     }
 
-    if (ep11tok_libica_mech_available(tokdata, pMechanism->mechanism, hKey)) {
+    if (ep11tok_libica_mech_available(tokdata, pMechanism->mechanism, hKey) ||
+        ep11tok_host_pubkey_mech_available(tokdata, pMechanism->mechanism,
+                                           hKey)) {
         sess->verify_ctx.count_statistics = TRUE;
         rc = verify_mgr_init(tokdata, sess, &sess->verify_ctx, pMechanism,
                              FALSE, hKey, TRUE);
@@ -3669,7 +3754,10 @@ CK_RV SC_Verify(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     }
 
     if (ep11tok_libica_mech_available(tokdata, sess->verify_ctx.mech.mechanism,
-                                      sess->verify_ctx.key)) {
+                                      sess->verify_ctx.key) ||
+        ep11tok_host_pubkey_mech_available(tokdata,
+                                           sess->verify_ctx.mech.mechanism,
+                                           sess->verify_ctx.key)) {
         rc = verify_mgr_verify(tokdata, sess, &sess->verify_ctx, pData,
                            ulDataLen, pSignature, ulSignatureLen);
         if (rc != CKR_OK)
@@ -3758,7 +3846,10 @@ CK_RV SC_VerifyUpdate(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     }
 
     if (ep11tok_libica_mech_available(tokdata, sess->verify_ctx.mech.mechanism,
-                                      sess->verify_ctx.key)) {
+                                      sess->verify_ctx.key) ||
+        ep11tok_host_pubkey_mech_available(tokdata,
+                                           sess->verify_ctx.mech.mechanism,
+                                           sess->verify_ctx.key)) {
         rc = verify_mgr_verify_update(tokdata, sess, &sess->verify_ctx, pPart,
                                       ulPartLen);
         if (rc != CKR_OK)
@@ -3840,7 +3931,10 @@ CK_RV SC_VerifyFinal(STDLL_TokData_t *tokdata, ST_SESSION_HANDLE *sSession,
     }
 
     if (ep11tok_libica_mech_available(tokdata, sess->verify_ctx.mech.mechanism,
-                                      sess->verify_ctx.key)) {
+                                      sess->verify_ctx.key) ||
+        ep11tok_host_pubkey_mech_available(tokdata,
+                                           sess->verify_ctx.mech.mechanism,
+                                           sess->verify_ctx.key)) {
         rc = verify_mgr_verify_final(tokdata, sess, &sess->verify_ctx,
                                      pSignature, ulSignatureLen);
         if (rc != CKR_OK)
@@ -4582,6 +4676,400 @@ done:
     return rc;
 }
 
+#define BATCH_ITEMS_PER_THREAD      16
+#define BATCH_MAX_THREADS           64
+
+enum batch_op {
+    BATCH_OP_SIGN,
+    BATCH_OP_VERIFY,
+    BATCH_OP_ENCRYPT,
+};
+
+/*
+ * A request of SC_IBM_SignBatch, SC_IBM_VerifyBatch or SC_IBM_EncryptBatch.
+ * The key and the mechanism are checked once per batch. Every element is
+ * then processed with a single-part EP11 operation, which needs no state,
+ * so the elements can be processed concurrently. Worker threads pick the
+ * next unprocessed element by atomically incrementing 'next'.
+ */
+struct batch_request {
+    STDLL_TokData_t *tokdata;
+    SESSION *sess;
+    enum batch_op op;
+    CK_MECHANISM *mech;
+    CK_OBJECT_HANDLE key;
+    CK_IBM_BATCH_ITEM *items;
+    CK_ULONG count;
+    CK_ULONG next;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX *libctx;
+#endif
+};
+
+static CK_RV batch_process_item(struct batch_request *req,
+                                CK_IBM_BATCH_ITEM *item)
+{
+    CK_BBOOL length_only = (item->pResult == NULL);
+    CK_RV rc;
+
+    if (item->pData == NULL ||
+        (req->op == BATCH_OP_VERIFY && item->pResult == NULL)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    switch (req->op) {
+    case BATCH_OP_SIGN:
+        rc = ep11tok_sign_single(req->tokdata, req->sess, req->mech,
+                                 length_only, req->key, item->pData,
+                                 item->ulDataLen, item->pResult,
+                                 &item->ulResultLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("ep11tok_sign_single() failed.\n");
+        break;
+    case BATCH_OP_VERIFY:
+        rc = ep11tok_verify_single(req->tokdata, req->sess, req->mech,
+                                   req->key, item->pData, item->ulDataLen,
+                                   item->pResult, item->ulResultLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("ep11tok_verify_single() failed.\n");
+        break;
+    case BATCH_OP_ENCRYPT:
+        rc = ep11tok_encrypt_single(req->tokdata, req->sess, req->mech,
+                                    length_only, req->key, item->pData,
+                                    item->ulDataLen, item->pResult,
+                                    &item->ulResultLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("ep11tok_encrypt_single() failed.\n");
+        break;
+    default:
+        rc = CKR_FUNCTION_FAILED;
+        break;
+    }
+
+    return rc;
+}
+
+static void *batch_worker(void *arg)
+{
+    struct batch_request *req = arg;
+    CK_ULONG i;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX_set0_default(req->libctx);
+#endif
+
+    while ((i = __sync_fetch_and_add(&req->next, 1)) < req->count)
+        req->items[i].rv = batch_process_item(req, &req->items[i]);
+
+    return NULL;
+}
+
+/*
+ * Checks the key and the mechanism of a batch request, and processes all
+ * its elements. Batches with more than BATCH_ITEMS_PER_THREAD elements are
+ * spread over up to tokdata->batch_threads threads (including the calling
+ * thread). Returns CKR_OK if all elements were processed successfully, or
+ * the return value of the first failed element otherwise.
+ */
+static CK_RV batch_run(struct batch_request *req)
+{
+    pthread_t threads[BATCH_MAX_THREADS];
+    CK_ULONG num_threads, started = 0, i, operation;
+    CK_BBOOL auth_required = FALSE;
+    CK_RV rc;
+
+    switch (req->op) {
+    case BATCH_OP_SIGN:
+        operation = OP_SIGN_INIT;
+        break;
+    case BATCH_OP_VERIFY:
+        operation = OP_VERIFY_INIT;
+        break;
+    default:
+        operation = OP_ENCRYPT_INIT;
+        break;
+    }
+
+    rc = ep11tok_check_single_mech_key(req->tokdata, req->sess, req->mech,
+                                       req->key, operation, &auth_required);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("ep11tok_check_single_mech_key() failed.\n");
+        return rc;
+    }
+    /* There is no context specific login for a batch */
+    if (auth_required) {
+        TRACE_ERROR("%s\n", ock_err(ERR_USER_NOT_LOGGED_IN));
+        return CKR_USER_NOT_LOGGED_IN;
+    }
+
+    num_threads = req->count / BATCH_ITEMS_PER_THREAD;
+    if (num_threads > req->tokdata->batch_threads)
+        num_threads = req->tokdata->batch_threads;
+    if (num_threads > BATCH_MAX_THREADS)
+        num_threads = BATCH_MAX_THREADS;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    /* Worker threads must use the library context of the calling thread */
+    req->libctx = OSSL_LIB_CTX_set0_default(NULL);
+#endif
+
+    for (i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, req) != 0) {
+            TRACE_DEVEL("pthread_create failed, using %lu threads\n",
+                        started + 1);
+            break;
+        }
+        started++;
+    }
+
+    batch_worker(req);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < req->count; i++) {
+        if (req->items[i].rv != CKR_OK)
+            return req->items[i].rv;
+    }
+
+    return CKR_OK;
+}
+
+static const char *batch_op_name[] = {
+    [BATCH_OP_SIGN] = "SC_IBM_SignBatch",
+    [BATCH_OP_VERIFY] = "SC_IBM_VerifyBatch",
+    [BATCH_OP_ENCRYPT] = "SC_IBM_EncryptBatch",
+};
+
+static CK_RV batch_call(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                        enum batch_op op, CK_MECHANISM_PTR pMechanism,
+                        CK_OBJECT_HANDLE hKey, CK_IBM_BATCH_ITEM_PTR pItems,
+                        CK_ULONG ulCount, CK_BBOOL async)
+{
+    struct batch_request req;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism || (!pItems && ulCount != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (op == BATCH_OP_ENCRYPT &&
+        !encr_mgr_batch_mech_supported(pMechanism->mechanism)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    /*
+     * The jobs of async requests can run concurrently on the same session,
+     * its device error is reset when the request is submitted.
+     */
+    if (async)
+        sess = session_mgr_find(tokdata, sSession->sessionh);
+    else
+        sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tokdata = tokdata;
+    req.sess = sess;
+    req.op = op;
+    req.mech = pMechanism;
+    req.key = hKey;
+    req.items = pItems;
+    req.count = ulCount;
+
+    rc = batch_run(&req);
+
+done:
+    TRACE_INFO("%s: rc = 0x%08lx, sess = %ld, mech = 0x%lx, count = %lu\n",
+               batch_op_name[op], rc,
+               (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_SignBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                       CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                       CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+    return batch_call(tokdata, sSession, BATCH_OP_SIGN, pMechanism, hKey,
+                      pItems, ulCount, FALSE);
+}
+
+CK_RV SC_IBM_VerifyBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                         CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+    return batch_call(tokdata, sSession, BATCH_OP_VERIFY, pMechanism, hKey,
+                      pItems, ulCount, FALSE);
+}
+
+CK_RV SC_IBM_EncryptBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                          CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+                          CK_IBM_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+    return batch_call(tokdata, sSession, BATCH_OP_ENCRYPT, pMechanism, hKey,
+                      pItems, ulCount, FALSE);
+}
+
+/*
+ * A request submitted with SC_IBM_AsyncSubmit. It is processed by the async
+ * executor like a call to the corresponding batch function.
+ */
+struct async_request {
+    struct async_job job;
+    ST_SESSION_T session;
+    CK_IBM_ASYNC_REQUEST_PTR request;
+    ST_AsyncCompletion_t completion;
+    void *context;
+};
+
+static CK_RV async_request_run(STDLL_TokData_t *tokdata, struct async_job *job)
+{
+    struct async_request *areq = container_of(job, struct async_request, job);
+    CK_IBM_ASYNC_REQUEST_PTR req = areq->request;
+
+    switch (req->operation) {
+    case CK_IBM_ASYNC_SIGN:
+        return batch_call(tokdata, &areq->session, BATCH_OP_SIGN,
+                          req->pMechanism, req->hKey, req->pItems,
+                          req->ulCount, TRUE);
+    case CK_IBM_ASYNC_VERIFY:
+        return batch_call(tokdata, &areq->session, BATCH_OP_VERIFY,
+                          req->pMechanism, req->hKey, req->pItems,
+                          req->ulCount, TRUE);
+    case CK_IBM_ASYNC_ENCRYPT:
+        return batch_call(tokdata, &areq->session, BATCH_OP_ENCRYPT,
+                          req->pMechanism, req->hKey, req->pItems,
+                          req->ulCount, TRUE);
+    default:
+        return CKR_ARGUMENTS_BAD;
+    }
+}
+
+static void async_request_done(STDLL_TokData_t *tokdata, struct async_job *job,
+                               CK_BBOOL notify)
+{
+    struct async_request *areq = container_of(job, struct async_request, job);
+
+    UNUSED(tokdata);
+
+    if (notify) {
+        areq->request->rv = job->rc;
+        areq->completion(areq->request, areq->context);
+    }
+
+    free(areq);
+}
+
+CK_RV SC_IBM_AsyncSubmit(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                         CK_IBM_ASYNC_REQUEST_PTR pRequest,
+                         ST_AsyncCompletion_t completion, void *pContext)
+{
+    struct async_request *areq;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pRequest || !completion || !pRequest->pMechanism ||
+        (!pRequest->pItems && pRequest->ulCount != 0)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    switch (pRequest->operation) {
+    case CK_IBM_ASYNC_SIGN:
+    case CK_IBM_ASYNC_VERIFY:
+        break;
+    case CK_IBM_ASYNC_ENCRYPT:
+        /* Reject it here, so that the caller gets the error synchronously */
+        if (!encr_mgr_batch_mech_supported(pRequest->pMechanism->mechanism)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+            rc = CKR_MECHANISM_INVALID;
+            goto done;
+        }
+        break;
+    default:
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    /* Fail early for an invalid session, it is looked up again later */
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    areq = calloc(1, sizeof(*areq));
+    if (areq == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    areq->job.run = async_request_run;
+    areq->job.done = async_request_done;
+    areq->session = *sSession;
+    areq->request = pRequest;
+    areq->completion = completion;
+    areq->context = pContext;
+
+    rc = async_mgr_submit(tokdata, &areq->job);
+    if (rc != CKR_OK) {
+        TRACE_DEVEL("async_mgr_submit() failed.\n");
+        free(areq);
+    }
+
+done:
+    TRACE_INFO("SC_IBM_AsyncSubmit: rc = 0x%08lx, sess = %ld, op = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pRequest ? pRequest->operation : (CK_ULONG)-1));
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
 CK_RV SC_HandleEvent(STDLL_TokData_t *tokdata, unsigned int event_type,
                      unsigned int event_flags, const char *payload,
                      unsigned int payload_len)
@@ -4666,6 +5154,10 @@ void SC_SetFunctionList(void)
     function_list.ST_SessionCancel = SC_SessionCancel;
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
+    function_list.ST_IBM_SignBatch = SC_IBM_SignBatch;
+    function_list.ST_IBM_VerifyBatch = SC_IBM_VerifyBatch;
+    function_list.ST_IBM_EncryptBatch = SC_IBM_EncryptBatch;
+    function_list.ST_IBM_AsyncSubmit = SC_IBM_AsyncSubmit;
 
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
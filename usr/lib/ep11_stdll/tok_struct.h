@@ -75,17 +75,17 @@ token_spec_t token_specific = {
     NULL,                       // des3_cmac
     // RSA
     NULL,                       // rsa_decrypt
-    NULL,                       // rsa_encrypt
+    &token_specific_rsa_encrypt,
     &token_specific_rsa_sign,
     &token_specific_rsa_verify,
     NULL,                       // rsa_verify_recover
     NULL,                       // rsa_x509_decrypt
-    NULL,                       // rsa_x509_encrypt
+    &token_specific_rsa_x509_encrypt,
     NULL,                       // rsa_x509_sign
-    NULL,                       // rsa_x509_verify
+    &token_specific_rsa_x509_verify,
     NULL,                       // rsa_x509_verify_recover
     NULL,                       // rsa_oaep_decrypt
-    NULL,                       // rsa_oaep_encrypt
+    &token_specific_rsa_oaep_encrypt,
     &token_specific_rsa_pss_sign,
     &token_specific_rsa_pss_verify,
     NULL,                       // rsa_generate_keypair
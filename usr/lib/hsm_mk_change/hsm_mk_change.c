@@ -41,6 +41,11 @@ struct hsm_mkvp_hdr {
     /* Followed by mkvp_len bytes MKVP. */
 };
 
+struct hsm_mk_change_progress_hdr {
+    uint32_t done; /* stored in big endian */
+    uint32_t total; /* stored in big endian */
+};
+
 static int hsm_mk_change_lock_fd = -1;
 
 CK_RV hsm_mk_change_lock_create(void)
@@ -894,6 +899,81 @@ out:
     return rc;
 }
 
+static FILE* hsm_mk_change_progress_open(const char *id, CK_SLOT_ID slot_id,
+                                         const char *mode)
+{
+    char hsm_mk_change_file[PATH_MAX];
+    FILE *fp;
+
+    if (ock_snprintf(hsm_mk_change_file, PATH_MAX, "%s/%s-%lu-progress",
+                     OCK_HSM_MK_CHANGE_PATH, id, slot_id) != 0) {
+        TRACE_ERROR("HSM_MK_CHANGE directory path buffer overflow\n");
+        return NULL;
+    }
+
+    TRACE_DEVEL("file to open: %s mode: %s\n", hsm_mk_change_file, mode);
+
+    fp = fopen(hsm_mk_change_file, mode);
+    if (fp == NULL) {
+        TRACE_DEVEL("%s fopen(%s, %s): %s\n", __func__,
+                    hsm_mk_change_file, mode, strerror(errno));
+    }
+
+    return fp;
+}
+
+CK_RV hsm_mk_change_progress_save(const char *id, CK_SLOT_ID slot_id,
+                                  const struct hsm_mk_change_progress *progress)
+{
+    struct hsm_mk_change_progress_hdr hdr;
+    FILE *fp;
+    CK_RV rc = CKR_OK;
+
+    hdr.done = htobe32(progress->done);
+    hdr.total = htobe32(progress->total);
+
+    fp = hsm_mk_change_progress_open(id, slot_id, "w");
+    if (fp == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    hsm_mk_change_op_set_perm(fileno(fp));
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        TRACE_ERROR("fwrite(%s-%lu-progress): %s\n", id, slot_id,
+                    strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+    }
+
+    fclose(fp);
+    return rc;
+}
+
+CK_RV hsm_mk_change_progress_load(const char *id, CK_SLOT_ID slot_id,
+                                  struct hsm_mk_change_progress *progress)
+{
+    struct hsm_mk_change_progress_hdr hdr;
+    FILE *fp;
+    CK_RV rc = CKR_OK;
+
+    fp = hsm_mk_change_progress_open(id, slot_id, "r");
+    if (fp == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    /* The file is rewritten while the token re-enciphers its objects */
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1) {
+        TRACE_DEVEL("fread(%s-%lu-progress) failed\n", id, slot_id);
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    progress->done = be32toh(hdr.done);
+    progress->total = be32toh(hdr.total);
+
+out:
+    fclose(fp);
+    return rc;
+}
+
 CK_RV hsm_mk_change_op_remove(const char *id)
 {
     char hsm_mk_change_file[PATH_MAX];
@@ -47,6 +47,12 @@ struct hsm_mk_change_info {
     struct hsm_mkvp *mkvps;
 };
 
+/* Re-enciphering progress of the token objects of a token */
+struct hsm_mk_change_progress {
+    unsigned int done;
+    unsigned int total;
+};
+
 struct hsm_mk_change_op {
     char id[7];
     enum hsm_mk_change_state state;
@@ -105,6 +111,11 @@ CK_RV hsm_mk_change_token_mkvps_load(const char *id, CK_SLOT_ID slot_id,
                                      struct hsm_mkvp **mkvps,
                                      unsigned int *num_mkvps);
 
+CK_RV hsm_mk_change_progress_save(const char *id, CK_SLOT_ID slot_id,
+                                  const struct hsm_mk_change_progress *progress);
+CK_RV hsm_mk_change_progress_load(const char *id, CK_SLOT_ID slot_id,
+                                  struct hsm_mk_change_progress *progress);
+
 CK_RV hsm_mk_change_lock_create(void);
 void hsm_mk_change_lock_destroy(void);
 CK_RV hsm_mk_change_lock(int exclusive);
@@ -39,7 +39,10 @@ opencryptoki_stdll_libpkcs11_ica_la_SOURCES =				\
 	usr/lib/common/mech_openssl.c usr/lib/common/mech_pqc.c		\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
 	usr/lib/api/policyhelper.c usr/lib/common/pqc_supported.c	\
-	usr/lib/common/btree.c usr/lib/common/sess_mgr.c
+	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
+	usr/lib/common/slab.c usr/lib/common/obj_cache.c		\
+	usr/lib/common/login_cache.c					\
+	usr/lib/common/async_mgr.c
 
 if !HAVE_ALT_FIX_FOR_CVE_2022_4304
 opencryptoki_stdll_libpkcs11_ica_la_SOURCES +=				\
@@ -2285,7 +2285,7 @@ int icsf_get_attribute(LDAP * ld, int *reason,
     char handle[ICSF_HANDLE_LEN];
     BerElement *msg = NULL;
     BerElement *result = NULL;
-    int rc = 0, allocated = 0;
+    int rc = 0, allocated = 0, shared = 0;
 
     CHECK_ARG_NON_NULL(ld);
     CHECK_ARG_NON_NULL(attrs);
@@ -2322,16 +2322,20 @@ int icsf_get_attribute(LDAP * ld, int *reason,
             *cached_result = ber_dup(result);
             if (*cached_result == NULL) {
                 TRACE_ERROR("ber_dup failed.\n");
+                rc = -1;
                 goto cleanup;
             }
             allocated = 1;
+            shared = 1;
         }
     } else {
         result = ber_dup(*cached_result);
         if (result == NULL) {
             TRACE_DEVEL("ber_dup failed.\n");
+            rc = -1;
             goto cleanup;
         }
+        shared = 1;
     }
 
     /* Decode the result:
@@ -2353,8 +2357,9 @@ cleanup:
     if (msg)
         ber_free(msg, 1);
 
+    /* A duplicated element shares its buffer with the cached result */
     if (result)
-        ber_free(result, cached_result == NULL ? 1 : 0);
+        ber_free(result, shared ? 0 : 1);
 
     if (rc != 0 && allocated &&
         cached_result != NULL && *cached_result != NULL) {
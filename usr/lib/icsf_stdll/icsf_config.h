@@ -18,6 +18,8 @@
 #define ICSF_CFG_MECH_SIMPLE 0
 #define ICSF_CFG_MECH_SASL   1
 
+#define ICSF_CFG_ATTR_CACHE_TTL_DEFAULT 30
+
 /* ICSF specific slot data */
 struct icsf_config {
     char name[ICSF_TOKEN_NAME_LEN + 1];
@@ -30,6 +32,8 @@ struct icsf_config {
     char cert_file[PATH_MAX + 1];
     char key_file[PATH_MAX + 1];
     int mech;
+    unsigned long attr_cache_size;
+    unsigned long attr_cache_ttl;
 };
 
 static CK_RV parse_config_file(const char *conf_name, CK_SLOT_ID slot_id,
@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 #include "pkcs11types.h"
 #include "defs.h"
 #include "host_defs.h"
@@ -155,12 +156,29 @@ struct session_state {
 };
 
 
+struct icsf_attr_cache_entry;
+
 /* Each element of the btree objects should have this type: */
 struct icsf_object_mapping {
     struct bt_ref_hdr hdr;
     CK_SESSION_HANDLE session_id;
     struct icsf_object_record icsf_object;
     struct objstrength strength;
+    struct icsf_attr_cache_entry *attr_cache;
+    icsf_private_data_t *attr_cache_owner;
+};
+
+/*
+ * Cached attribute list of an ICSF object. The BER element holds the
+ * complete response of the get attribute value service and is shared by
+ * all readers; the reference counter keeps it alive while it is decoded.
+ */
+struct icsf_attr_cache_entry {
+    struct icsf_object_mapping *mapping;
+    unsigned long ref;
+    time_t expires;
+    BerElement *result;
+    list_entry_t lru;
 };
 
 /*
@@ -290,6 +308,179 @@ done:
     return found;
 }
 
+static time_t attr_cache_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/*
+ * Drop a reference of a cache entry. Must be called with attr_cache_mutex
+ * locked.
+ */
+static void attr_cache_entry_put(struct icsf_attr_cache_entry *entry)
+{
+    if (--entry->ref > 0)
+        return;
+
+    if (entry->result != NULL)
+        ber_free(entry->result, 1);
+    free(entry);
+}
+
+/*
+ * Remove a cache entry from the cache and from its object mapping. Must be
+ * called with attr_cache_mutex locked.
+ */
+static void attr_cache_unlink(icsf_private_data_t *icsf_data,
+                              struct icsf_attr_cache_entry *entry)
+{
+    list_remove(&entry->lru);
+    icsf_data->attr_cache_count--;
+    entry->mapping->attr_cache = NULL;
+    entry->mapping = NULL;
+    attr_cache_entry_put(entry);
+}
+
+/*
+ * Look up the cached attribute list of an object. On a hit, the BER element
+ * of the cached response is returned, and @entry is set to the referenced
+ * cache entry. Expired entries are dropped. Returns NULL on a miss.
+ * The result must be handed back via attr_cache_release().
+ */
+static BerElement *attr_cache_get(icsf_private_data_t *icsf_data,
+                                  struct icsf_object_mapping *mapping,
+                                  struct icsf_attr_cache_entry **entry)
+{
+    struct icsf_attr_cache_entry *e;
+
+    *entry = NULL;
+
+    if (icsf_data->attr_cache_max == 0)
+        return NULL;
+
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        return NULL;
+    }
+
+    e = mapping->attr_cache;
+    if (e != NULL && icsf_data->attr_cache_ttl != 0 &&
+        e->expires <= attr_cache_now()) {
+        TRACE_DEVEL("Attribute cache entry of %s/%lu/%c expired\n",
+                    mapping->icsf_object.token_name,
+                    mapping->icsf_object.sequence, mapping->icsf_object.id);
+        attr_cache_unlink(icsf_data, e);
+        e = NULL;
+    }
+
+    if (e != NULL) {
+        /* Move to the head of the LRU list */
+        list_remove(&e->lru);
+        list_insert_head(&icsf_data->attr_cache, &e->lru);
+        e->ref++;
+        *entry = e;
+    }
+
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+
+    return e != NULL ? e->result : NULL;
+}
+
+/*
+ * Hand back the result obtained by attr_cache_get(). If it was a cache hit,
+ * the cache entry reference is dropped. Otherwise @result (if any) is the
+ * response of a successful get attribute value call that was done by the
+ * caller. It is added to the cache, or freed if the cache is disabled.
+ * In any case the caller must no longer use @result afterwards.
+ */
+static void attr_cache_release(icsf_private_data_t *icsf_data,
+                               struct icsf_object_mapping *mapping,
+                               struct icsf_attr_cache_entry *entry,
+                               BerElement *result)
+{
+    struct icsf_attr_cache_entry *e;
+
+    if (entry == NULL && result == NULL)
+        return;
+
+    if (icsf_data->attr_cache_max == 0) {
+        if (result != NULL)
+            ber_free(result, 1);
+        return;
+    }
+
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        if (entry == NULL)
+            ber_free(result, 1);
+        return;
+    }
+
+    if (entry != NULL) {
+        attr_cache_entry_put(entry);
+        goto out;
+    }
+
+    /* Another thread may have cached the object concurrently */
+    if (mapping->attr_cache != NULL ||
+        (e = calloc(1, sizeof(*e))) == NULL) {
+        ber_free(result, 1);
+        goto out;
+    }
+
+    e->mapping = mapping;
+    e->ref = 1;
+    e->expires = attr_cache_now() + icsf_data->attr_cache_ttl;
+    e->result = result;
+    list_insert_head(&icsf_data->attr_cache, &e->lru);
+    icsf_data->attr_cache_count++;
+    mapping->attr_cache = e;
+    mapping->attr_cache_owner = icsf_data;
+
+    /* Evict the least recently used entries */
+    while (icsf_data->attr_cache_count > icsf_data->attr_cache_max)
+        attr_cache_unlink(icsf_data,
+                          container_of(icsf_data->attr_cache.tail,
+                                       struct icsf_attr_cache_entry, lru));
+
+out:
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+}
+
+/*
+ * Drop the cached attribute list of an object, e.g. because the object's
+ * attributes were modified.
+ */
+static void attr_cache_invalidate(icsf_private_data_t *icsf_data,
+                                  struct icsf_object_mapping *mapping)
+{
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        return;
+    }
+
+    if (mapping->attr_cache != NULL)
+        attr_cache_unlink(icsf_data, mapping->attr_cache);
+
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+}
+
+/*
+ * Delete callback of the objects btree.
+ */
+static void free_object_mapping(void *value)
+{
+    struct icsf_object_mapping *mapping = value;
+
+    if (mapping->attr_cache_owner != NULL)
+        attr_cache_invalidate(mapping->attr_cache_owner, mapping);
+
+    free(mapping);
+}
+
 static void purge_object_mapping_cb(STDLL_TokData_t * tokdata, void *value,
                                     unsigned long node_num, void *p3)
 {
@@ -395,6 +586,7 @@ CK_RV icsftok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id,
 {
     CK_RV rc;
     struct slot_data *data;
+    struct icsf_config config;
     icsf_private_data_t *icsf_data;
 
     TRACE_INFO("icsf %s slot=%lu running\n", __func__, slot_id);
@@ -424,8 +616,16 @@ CK_RV icsftok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id,
         free(icsf_data);
         return CKR_CANT_LOCK;
     }
-    if (bt_init(&icsf_data->objects, free) != CKR_OK) {
+    list_init(&icsf_data->attr_cache);
+    if (pthread_mutex_init(&icsf_data->attr_cache_mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing attribute cache lock failed.\n");
+        pthread_mutex_destroy(&icsf_data->sess_list_mutex);
+        free(icsf_data);
+        return CKR_CANT_LOCK;
+    }
+    if (bt_init(&icsf_data->objects, free_object_mapping) != CKR_OK) {
         TRACE_ERROR("BTree init failed.\n");
+        pthread_mutex_destroy(&icsf_data->attr_cache_mutex);
         pthread_mutex_destroy(&icsf_data->sess_list_mutex);
         free(icsf_data);
         return CKR_FUNCTION_FAILED;
@@ -447,6 +647,21 @@ CK_RV icsftok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id,
     strncpy(data->conf_name, conf_name, sizeof(data->conf_name) - 1);
     data->conf_name[sizeof(data->conf_name) - 1] = '\0';
 
+    /*
+     * The attribute cache settings are per process and are not part of the
+     * persistent slot data, so read them from the config file every time.
+     */
+    if (data->conf_name[0] != '\0' &&
+        parse_config_file(data->conf_name, slot_id, &config) == CKR_OK) {
+        icsf_data->attr_cache_max = config.attr_cache_size;
+        icsf_data->attr_cache_ttl = config.attr_cache_ttl;
+        TRACE_DEVEL("Attribute cache: size %lu, ttl %lu\n",
+                    icsf_data->attr_cache_max, icsf_data->attr_cache_ttl);
+    } else {
+        TRACE_WARNING("Failed to parse file \"%s\" for slot %lu, attribute "
+                      "cache disabled.\n", data->conf_name, slot_id);
+    }
+
 done:
     if (rc == CKR_OK)
         rc = XProcUnLock(tokdata);
@@ -486,6 +701,17 @@ static struct ref refs[] = {
 };
 static const size_t refs_len = sizeof(refs)/sizeof(*refs);
 
+struct num_ref {
+    char *key;
+    unsigned long *addr;
+};
+
+static struct num_ref num_refs[] = {
+    { "attr_cache_size",   &out_config.attr_cache_size },
+    { "attr_cache_ttl",    &out_config.attr_cache_ttl },
+};
+static const size_t num_refs_len = sizeof(num_refs)/sizeof(*num_refs);
+
 static int check_keys(const char *conf_name)
 {
     size_t i;
@@ -515,6 +741,17 @@ static CK_RV config_parse_slot(const char *config_file,
         TRACE_DEVEL("Config node: '%s' type: %u line: %u\n",
                     c->key, c->type, c->line);
 
+        if (confignode_hastype(c, CT_INTVAL)) {
+            for (k = 0; k < num_refs_len; k++) {
+                if (!strcasecmp(num_refs[k].key, c->key)) {
+                    *num_refs[k].addr = confignode_to_intval(c)->value;
+                    break;
+                }
+            }
+            if (k < num_refs_len)
+                continue;
+        }
+
         str = confignode_getstr(c);
         if (str != NULL) {
             for (k = 0; k < refs_len; k++) {
@@ -550,6 +787,9 @@ static CK_RV parse_config_file(const char *conf_name, CK_SLOT_ID slot_id,
     CK_RV ret = CKR_OK;
     int i;
 
+    out_config.attr_cache_size = 0;
+    out_config.attr_cache_ttl = ICSF_CFG_ATTR_CACHE_TTL_DEFAULT;
+
     file = fopen(conf_name, "r");
     if (file == NULL) {
         TRACE_ERROR("Error opening config file '%s': %s\n", conf_name,
@@ -1581,6 +1821,7 @@ CK_RV icsftok_final(STDLL_TokData_t * tokdata, CK_BBOOL finalize,
 
     if (finalize) {
         bt_destroy(&icsf_data->objects);
+        pthread_mutex_destroy(&icsf_data->attr_cache_mutex);
         pthread_mutex_destroy(&icsf_data->sess_list_mutex);
         free(icsf_data);
         tokdata->private_data = NULL;
@@ -1781,6 +2022,8 @@ CK_RV icsftok_copy_object(STDLL_TokData_t * tokdata,
     struct session_state *session_state;
     struct icsf_object_mapping *mapping_dst = NULL;
     struct icsf_object_mapping *mapping_src = NULL;
+    struct icsf_attr_cache_entry *cache_entry = NULL;
+    BerElement *cached_result = NULL;
     CK_ULONG node_number;
     int reason = 0;
 
@@ -1812,7 +2055,7 @@ CK_RV icsftok_copy_object(STDLL_TokData_t * tokdata,
     }
 
     /* Allocate structure for new object */
-    if (!(mapping_dst = malloc(sizeof(*mapping_dst)))) {
+    if (!(mapping_dst = calloc(1, sizeof(*mapping_dst)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto done;
@@ -1825,8 +2068,10 @@ CK_RV icsftok_copy_object(STDLL_TokData_t * tokdata,
         goto done;
     }
 
-    rc = icsf_get_attribute(session_state->ld, &reason, NULL,
+    cached_result = attr_cache_get(icsf_data, mapping_src, &cache_entry);
+    rc = icsf_get_attribute(session_state->ld, &reason, &cached_result,
                             &mapping_src->icsf_object, priv_attrs, 2);
+    attr_cache_release(icsf_data, mapping_src, cache_entry, cached_result);
     if (rc != CKR_OK) {
         TRACE_ERROR("icsf_get_attribute failed\n");
         goto done;
@@ -1927,7 +2172,7 @@ CK_RV icsftok_create_object(STDLL_TokData_t * tokdata, SESSION * session,
     }
 
     /* Allocate structure to keep ICSF object information */
-    if (!(mapping = malloc(sizeof(*mapping)))) {
+    if (!(mapping = calloc(1, sizeof(*mapping)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         return CKR_HOST_MEMORY;
     }
@@ -2165,8 +2410,8 @@ CK_RV icsftok_generate_key_pair(STDLL_TokData_t * tokdata, SESSION * session,
     }
 
     /* Allocate structure to keep ICSF objects information */
-    if (!(pub_key_mapping = malloc(sizeof(*pub_key_mapping))) ||
-        !(priv_key_mapping = malloc(sizeof(*priv_key_mapping)))) {
+    if (!(pub_key_mapping = calloc(1, sizeof(*pub_key_mapping))) ||
+        !(priv_key_mapping = calloc(1, sizeof(*priv_key_mapping)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto done;
@@ -2287,7 +2532,7 @@ CK_RV icsftok_generate_key(STDLL_TokData_t * tokdata, SESSION * session,
     }
 
     /* Allocate structure to keep ICSF object information */
-    if (!(mapping = malloc(sizeof(*mapping)))) {
+    if (!(mapping = calloc(1, sizeof(*mapping)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         goto done;
     }
@@ -3537,6 +3782,7 @@ CK_RV icsftok_get_attribute_value(STDLL_TokData_t * tokdata,
     CK_BBOOL priv_obj;
     struct session_state *session_state;
     struct icsf_object_mapping *mapping = NULL;
+    struct icsf_attr_cache_entry *cache_entry = NULL;
     BerElement *cached_result = NULL;
     int reason = 0;
 
@@ -3566,6 +3812,9 @@ CK_RV icsftok_get_attribute_value(STDLL_TokData_t * tokdata,
         goto done;
     }
 
+    /* use the cached attribute list of the object, if available */
+    cached_result = attr_cache_get(icsf_data, mapping, &cache_entry);
+
     /* get the private attribute so we can check the permissions */
     rc = icsf_get_attribute(session_state->ld, &reason, &cached_result,
                             &mapping->icsf_object, priv_attr, 1);
@@ -3606,13 +3855,11 @@ CK_RV icsftok_get_attribute_value(STDLL_TokData_t * tokdata,
 
 done:
     if (mapping) {
+        attr_cache_release(icsf_data, mapping, cache_entry, cached_result);
         bt_put_node_value(&icsf_data->objects, mapping);
         mapping = NULL;
     }
 
-    if (cached_result != NULL)
-        ber_free(cached_result, 1);
-
     return rc;
 }
 
@@ -3626,6 +3873,8 @@ CK_RV icsftok_set_attribute_value(STDLL_TokData_t * tokdata,
     icsf_private_data_t *icsf_data = tokdata->private_data;
     struct session_state *session_state;
     struct icsf_object_mapping *mapping = NULL;
+    struct icsf_attr_cache_entry *cache_entry = NULL;
+    BerElement *cached_result = NULL;
     CK_BBOOL is_priv;
     CK_BBOOL is_token;
     CK_RV rc = CKR_OK;
@@ -3663,8 +3912,10 @@ CK_RV icsftok_set_attribute_value(STDLL_TokData_t * tokdata,
      * first get CKA_PRIVATE since we need to check againse session
      * icsf will check if the attributes are modifiable
      */
-    rc = icsf_get_attribute(session_state->ld, &reason, NULL,
+    cached_result = attr_cache_get(icsf_data, mapping, &cache_entry);
+    rc = icsf_get_attribute(session_state->ld, &reason, &cached_result,
                             &mapping->icsf_object, priv_attrs, 2);
+    attr_cache_release(icsf_data, mapping, cache_entry, cached_result);
     if (rc != CKR_OK) {
         TRACE_DEVEL("icsf_get_attribute failed\n");
         rc = icsf_to_ock_err(rc, reason);
@@ -3681,6 +3932,7 @@ CK_RV icsftok_set_attribute_value(STDLL_TokData_t * tokdata,
     /* Now call into icsf to set the attribute values */
     rc = icsf_set_attribute(session_state->ld, &reason,
                             &mapping->icsf_object, pTemplate, ulCount);
+    attr_cache_invalidate(icsf_data, mapping);
     if (rc != CKR_OK) {
         TRACE_ERROR("icsf_set_attribute failed\n");
         rc = icsf_to_ock_err(rc, reason);
@@ -3827,7 +4079,7 @@ CK_RV icsftok_find_objects_init(STDLL_TokData_t * tokdata, SESSION * sess,
             if (!node_number) {
                 struct icsf_object_mapping *new_mapping;
 
-                if (!(new_mapping = malloc(sizeof(*new_mapping)))) {
+                if (!(new_mapping = calloc(1, sizeof(*new_mapping)))) {
                     TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
                     rv = CKR_HOST_MEMORY;
                     goto done;
@@ -5403,7 +5655,7 @@ CK_RV icsftok_unwrap_key(STDLL_TokData_t * tokdata,
 
 
     /* Allocate structure to keep ICSF object information */
-    if (!(key_mapping = malloc(sizeof(*key_mapping)))) {
+    if (!(key_mapping = calloc(1, sizeof(*key_mapping)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto done;
@@ -5554,7 +5806,7 @@ CK_RV icsftok_derive_key(STDLL_TokData_t * tokdata, SESSION * session,
 
     /* Allocate structure to keep ICSF object information */
     for (i = 0; i < sizeof(mappings) / sizeof(*mappings); i++) {
-        if (!(mappings[i] = malloc(sizeof(*mappings[i])))) {
+        if (!(mappings[i] = calloc(1, sizeof(*mappings[i])))) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
             goto done;
@@ -38,6 +38,19 @@ typedef struct {
      * object handles. The tree index is used as the PKCS#11 handle.
      */
     struct btree objects;
+
+    /*
+     * Client side cache of the attribute lists returned by ICSF for the
+     * mapped objects. The list keeps the cache entries in LRU order (most
+     * recently used at the head). The list, the entry counter and the cache
+     * entry pointers of the object mappings are protected by
+     * attr_cache_mutex. A maximum of zero entries disables the cache.
+     */
+    list_t attr_cache;
+    unsigned long attr_cache_count;
+    unsigned long attr_cache_max;
+    unsigned long attr_cache_ttl;
+    pthread_mutex_t attr_cache_mutex;
 } icsf_private_data_t;
 
 CK_RV icsftok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id,
@@ -78,11 +78,12 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    rc = bt_init(&sltp->TokData->sess_btree, free);
-    rc |= bt_init(&sltp->TokData->object_map_btree, free);
-    rc |= bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
-    rc |= bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
-    rc |= bt_init(&sltp->TokData->publ_token_obj_btree, call_object_free);
+    rc = slab_mgr_init(sltp->TokData);
+    rc |= bt_init_epoch(&sltp->TokData->sess_btree, slab_free);
+    rc |= bt_init_epoch(&sltp->TokData->object_map_btree, slab_free);
+    rc |= bt_init_epoch(&sltp->TokData->sess_obj_btree, call_object_free);
+    rc |= bt_init_epoch(&sltp->TokData->priv_token_obj_btree, call_object_free);
+    rc |= bt_init_epoch(&sltp->TokData->publ_token_obj_btree, call_object_free);
     if (rc != CKR_OK) {
         TRACE_ERROR("Btree init failed\n");
         rc = CKR_FUNCTION_FAILED;
@@ -203,6 +204,7 @@ done:
             bt_destroy(&sltp->TokData->sess_obj_btree);
             bt_destroy(&sltp->TokData->priv_token_obj_btree);
             bt_destroy(&sltp->TokData->publ_token_obj_btree);
+            slab_mgr_final(sltp->TokData);
         }
     }
 
@@ -251,6 +253,7 @@ CK_RV SC_Finalize(STDLL_TokData_t *tokdata, CK_SLOT_ID sid, SLOT_INFO *sinfp,
         return rc;
     }
 
+    slab_mgr_final(tokdata);
     final_data_store(tokdata);
 
     return rc;
@@ -0,0 +1,500 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+// File:  soft_keygen_pool.c
+//
+// Pool of pre-generated key pairs for the Soft token. The key kinds and the
+// number of keys to keep ready for each kind are configured in the
+// KEYGEN_POOL section of the token configuration file. Background threads
+// refill the pool whenever a key has been taken from it, so that
+// C_GenerateKeyPair does not have to wait for the (RSA prime) generation.
+//
+// The pool is private to the process that initialized the token. Pool keys
+// are never handed out twice: a forked child drops the keys inherited from
+// its parent.
+//
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+#include <openssl/crypto.h>
+#include <openssl/objects.h>
+#include <openssl/rsa.h>
+
+#include "platform.h"
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+#include "ock_syslog.h"
+#include "soft_keygen_pool.h"
+
+/* Pool keys are generated with the default public exponent 65537 */
+static const CK_BYTE soft_keygen_pool_rsa_exp[] = { 0x01, 0x00, 0x01 };
+
+static const struct {
+    const char *name;
+    CK_ULONG keyform;
+} soft_keygen_pool_dilithium_names[] = {
+    { "R2_65", CK_IBM_DILITHIUM_KEYFORM_ROUND2_65 },
+    { "R2_87", CK_IBM_DILITHIUM_KEYFORM_ROUND2_87 },
+    { "R3_44", CK_IBM_DILITHIUM_KEYFORM_ROUND3_44 },
+    { "R3_65", CK_IBM_DILITHIUM_KEYFORM_ROUND3_65 },
+    { "R3_87", CK_IBM_DILITHIUM_KEYFORM_ROUND3_87 },
+};
+
+static CK_RV soft_keygen_pool_parse_entry(struct soft_keygen_pool_entry *entry,
+                                          const char *key)
+{
+    const char *name;
+    char *end;
+    int nid;
+    CK_ULONG i;
+
+    if (strncasecmp(key, SOFT_CFG_KEYGEN_POOL_RSA,
+                    strlen(SOFT_CFG_KEYGEN_POOL_RSA)) == 0) {
+        name = key + strlen(SOFT_CFG_KEYGEN_POOL_RSA);
+        entry->key_type = CKK_RSA;
+        entry->mod_bits = strtoul(name, &end, 10);
+        if (*name == '\0' || *end != '\0' || entry->mod_bits < 512 ||
+            entry->mod_bits > OPENSSL_RSA_MAX_MODULUS_BITS)
+            return CKR_KEY_SIZE_RANGE;
+        return CKR_OK;
+    }
+
+    if (strncasecmp(key, SOFT_CFG_KEYGEN_POOL_EC,
+                    strlen(SOFT_CFG_KEYGEN_POOL_EC)) == 0) {
+        name = key + strlen(SOFT_CFG_KEYGEN_POOL_EC);
+        entry->key_type = CKK_EC;
+        nid = OBJ_sn2nid(name);
+        if (nid == NID_undef)
+            nid = OBJ_ln2nid(name);
+        for (i = 0; nid != NID_undef && i < NUMEC; i++) {
+            if (der_ec_supported[i].nid == nid) {
+                entry->curve = &der_ec_supported[i];
+                return CKR_OK;
+            }
+        }
+        return CKR_CURVE_NOT_SUPPORTED;
+    }
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    if (strncasecmp(key, SOFT_CFG_KEYGEN_POOL_DILITHIUM,
+                    strlen(SOFT_CFG_KEYGEN_POOL_DILITHIUM)) == 0) {
+        name = key + strlen(SOFT_CFG_KEYGEN_POOL_DILITHIUM);
+        entry->key_type = CKK_IBM_PQC_DILITHIUM;
+        for (i = 0; i < sizeof(soft_keygen_pool_dilithium_names) /
+                            sizeof(soft_keygen_pool_dilithium_names[0]); i++) {
+            if (strcasecmp(name,
+                           soft_keygen_pool_dilithium_names[i].name) == 0) {
+                entry->oid = find_pqc_by_keyform(dilithium_oids,
+                                  soft_keygen_pool_dilithium_names[i].keyform);
+                break;
+            }
+        }
+        return entry->oid != NULL ? CKR_OK : CKR_KEY_SIZE_RANGE;
+    }
+#endif
+
+    return CKR_KEY_TYPE_INCONSISTENT;
+}
+
+/*
+ * Parses the KEYGEN_POOL section of the token configuration file, e.g.:
+ *
+ *   KEYGEN_POOL
+ *   {
+ *     THREADS = 2
+ *     RSA_4096 = 4
+ *     EC_prime256v1 = 16
+ *   }
+ */
+CK_RV soft_keygen_pool_parse_config(struct soft_keygen_pool *pool,
+                                    const char *fname,
+                                    struct ConfigStructNode *pool_node)
+{
+    struct soft_keygen_pool_entry *entry, *tmp;
+    struct ConfigBaseNode *c;
+    unsigned long val;
+    CK_ULONG i;
+    CK_RV rc;
+    int f;
+
+    pool->num_threads = 1;
+
+    confignode_foreach(c, pool_node->value, f) {
+        TRACE_DEBUG("Config node: '%s' type: %u line: %u\n",
+                    c->key, c->type, c->line);
+
+        if (confignode_hastype(c, CT_EOC))
+            continue;
+
+        if (!confignode_hastype(c, CT_INTVAL)) {
+            OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': unexpected "
+                       "token '%s' at line %d\n", fname, c->key, c->line);
+            TRACE_ERROR("Error parsing config file '%s': unexpected token "
+                        "'%s' at line %d\n", fname, c->key, c->line);
+            return CKR_FUNCTION_FAILED;
+        }
+
+        val = confignode_to_intval(c)->value;
+
+        if (strcasecmp(c->key, SOFT_CFG_KEYGEN_POOL_THREADS) == 0) {
+            if (val < 1 || val > SOFT_KEYGEN_POOL_MAX_THREADS) {
+                OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': "
+                           "invalid number of threads %lu at line %d\n",
+                           fname, val, c->line);
+                TRACE_ERROR("Error parsing config file '%s': invalid number "
+                            "of threads %lu at line %d\n", fname, val,
+                            c->line);
+                return CKR_FUNCTION_FAILED;
+            }
+            pool->num_threads = val;
+            continue;
+        }
+
+        if (val > SOFT_KEYGEN_POOL_MAX_DEPTH) {
+            OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': invalid "
+                       "pool depth %lu at line %d\n", fname, val, c->line);
+            TRACE_ERROR("Error parsing config file '%s': invalid pool depth "
+                        "%lu at line %d\n", fname, val, c->line);
+            return CKR_FUNCTION_FAILED;
+        }
+
+        tmp = realloc(pool->entries,
+                      (pool->num_entries + 1) * sizeof(*pool->entries));
+        if (tmp == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+        pool->entries = tmp;
+
+        entry = &pool->entries[pool->num_entries];
+        memset(entry, 0, sizeof(*entry));
+
+        rc = soft_keygen_pool_parse_entry(entry, c->key);
+        if (rc != CKR_OK) {
+            OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': unsupported "
+                       "key kind '%s' at line %d\n", fname, c->key, c->line);
+            TRACE_ERROR("Error parsing config file '%s': unsupported key kind "
+                        "'%s' at line %d\n", fname, c->key, c->line);
+            return CKR_FUNCTION_FAILED;
+        }
+
+        for (i = 0; i < pool->num_entries; i++) {
+            if (pool->entries[i].key_type == entry->key_type &&
+                pool->entries[i].mod_bits == entry->mod_bits &&
+                pool->entries[i].curve == entry->curve &&
+                pool->entries[i].oid == entry->oid) {
+                OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': "
+                           "duplicate key kind '%s' at line %d\n", fname,
+                           c->key, c->line);
+                TRACE_ERROR("Error parsing config file '%s': duplicate key "
+                            "kind '%s' at line %d\n", fname, c->key, c->line);
+                return CKR_FUNCTION_FAILED;
+            }
+        }
+
+        if (val == 0)
+            continue;
+
+        entry->depth = val;
+        entry->keys = calloc(val, sizeof(EVP_PKEY *));
+        if (entry->keys == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+        pool->num_entries++;
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV soft_keygen_pool_generate(struct soft_keygen_pool_entry *entry,
+                                       EVP_PKEY **pkey)
+{
+    switch (entry->key_type) {
+    case CKK_RSA:
+        return openssl_specific_rsa_generate_pkey(entry->mod_bits,
+                                                  soft_keygen_pool_rsa_exp,
+                                              sizeof(soft_keygen_pool_rsa_exp),
+                                                  pkey);
+    case CKK_EC:
+        return openssl_specific_ec_generate_pkey(entry->curve->nid, pkey);
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    case CKK_IBM_PQC_DILITHIUM:
+        return openssl_specific_ibm_dilithium_generate_pkey(entry->oid, pkey);
+#endif
+    default:
+        return CKR_KEY_TYPE_INCONSISTENT;
+    }
+}
+
+/*
+ * Returns the entry that is the least filled relative to its depth, or NULL
+ * if all entries are full. Must be called with the pool mutex held.
+ */
+static struct soft_keygen_pool_entry *
+                soft_keygen_pool_next(struct soft_keygen_pool *pool)
+{
+    struct soft_keygen_pool_entry *entry, *next = NULL;
+    CK_ULONG i, fill;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        entry = &pool->entries[i];
+        fill = entry->num_keys + entry->in_progress;
+        if (entry->disabled || fill >= entry->depth)
+            continue;
+        if (next == NULL ||
+            fill * next->depth <
+                    (next->num_keys + next->in_progress) * entry->depth)
+            next = entry;
+    }
+
+    return next;
+}
+
+static void *soft_keygen_pool_worker(void *arg)
+{
+    struct soft_keygen_pool *pool = arg;
+    struct soft_keygen_pool_entry *entry;
+    EVP_PKEY *pkey;
+    CK_RV rc;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX_set0_default(pool->libctx);
+#endif
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->terminate) {
+        entry = soft_keygen_pool_next(pool);
+        if (entry == NULL) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+
+        entry->in_progress++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        pkey = NULL;
+        rc = soft_keygen_pool_generate(entry, &pkey);
+
+        pthread_mutex_lock(&pool->mutex);
+        entry->in_progress--;
+
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Key generation for the keygen pool failed, "
+                        "rc=0x%lx, key type 0x%lx is no longer pooled\n",
+                        rc, entry->key_type);
+            entry->disabled = TRUE;
+            continue;
+        }
+
+        if (pool->terminate) {
+            EVP_PKEY_free(pkey);
+            break;
+        }
+
+        entry->keys[entry->num_keys++] = pkey;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/*
+ * Starts the threads that fill the pool. Called from token_specific_init,
+ * thus the OpenSSL library context of the API layer is the current default.
+ */
+CK_RV soft_keygen_pool_start(struct soft_keygen_pool *pool)
+{
+    CK_ULONG i;
+
+    if (pool->num_entries == 0)
+        return CKR_OK;
+
+    if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing the keygen pool mutex failed.\n");
+        return CKR_CANT_LOCK;
+    }
+    if (pthread_cond_init(&pool->cond, NULL) != 0) {
+        TRACE_ERROR("Initializing the keygen pool condition failed.\n");
+        pthread_mutex_destroy(&pool->mutex);
+        return CKR_CANT_LOCK;
+    }
+    pool->initialized = TRUE;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    pool->libctx = OSSL_LIB_CTX_set0_default(NULL);
+#endif
+
+    pool->threads = calloc(pool->num_threads, sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    for (i = 0; i < pool->num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, soft_keygen_pool_worker,
+                           pool) != 0) {
+            TRACE_ERROR("Starting a keygen pool thread failed.\n");
+            return CKR_FUNCTION_FAILED;
+        }
+        pool->threads_started++;
+    }
+
+    TRACE_INFO("Keygen pool started with %lu entries and %lu threads\n",
+               pool->num_entries, pool->num_threads);
+
+    return CKR_OK;
+}
+
+/*
+ * Stops the pool threads and frees the pool keys. OpenSSL clears the private
+ * key components when a key is freed. In a forked child the threads do not
+ * exist, and the mutex may have been held by a thread of the parent.
+ */
+void soft_keygen_pool_final(struct soft_keygen_pool *pool,
+                            CK_BBOOL in_fork_initializer)
+{
+    struct soft_keygen_pool_entry *entry;
+    CK_ULONG i, k;
+
+    if (pool->initialized && !in_fork_initializer) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->terminate = TRUE;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+
+        for (i = 0; i < pool->threads_started; i++)
+            pthread_join(pool->threads[i], NULL);
+
+        pthread_cond_destroy(&pool->cond);
+        pthread_mutex_destroy(&pool->mutex);
+    }
+
+    for (i = 0; i < pool->num_entries; i++) {
+        entry = &pool->entries[i];
+        TRACE_INFO("Keygen pool entry %lu: key type 0x%lx, hits %lu, "
+                   "misses %lu\n", i, entry->key_type, entry->hits,
+                   entry->misses);
+        for (k = 0; k < entry->num_keys; k++)
+            EVP_PKEY_free(entry->keys[k]);
+        free(entry->keys);
+    }
+
+    free(pool->entries);
+    free(pool->threads);
+    memset(pool, 0, sizeof(*pool));
+}
+
+static EVP_PKEY *soft_keygen_pool_take(struct soft_keygen_pool *pool,
+                                       struct soft_keygen_pool_entry *entry)
+{
+    EVP_PKEY *pkey = NULL;
+
+    if (pthread_mutex_lock(&pool->mutex) != 0) {
+        TRACE_ERROR("Locking the keygen pool failed.\n");
+        return NULL;
+    }
+
+    if (entry->num_keys > 0) {
+        pkey = entry->keys[--entry->num_keys];
+        entry->keys[entry->num_keys] = NULL;
+        entry->hits++;
+        /* Wake up a thread to generate a replacement */
+        pthread_cond_signal(&pool->cond);
+    } else {
+        entry->misses++;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return pkey;
+}
+
+/*
+ * Returns a pre-generated RSA key, or NULL if the pool has no key with the
+ * requested modulus size and public exponent ready. The caller owns the key.
+ */
+EVP_PKEY *soft_keygen_pool_get_rsa(struct soft_keygen_pool *pool,
+                                   CK_ULONG mod_bits,
+                                   const CK_BYTE *publ_exp,
+                                   CK_ULONG publ_exp_len)
+{
+    CK_ULONG i;
+
+    if (!pool->initialized)
+        return NULL;
+
+    /* Skip leading zero bytes of the public exponent */
+    while (publ_exp_len > 0 && *publ_exp == 0) {
+        publ_exp++;
+        publ_exp_len--;
+    }
+    if (publ_exp_len != sizeof(soft_keygen_pool_rsa_exp) ||
+        memcmp(publ_exp, soft_keygen_pool_rsa_exp, publ_exp_len) != 0)
+        return NULL;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        if (pool->entries[i].key_type == CKK_RSA &&
+            pool->entries[i].mod_bits == mod_bits)
+            return soft_keygen_pool_take(pool, &pool->entries[i]);
+    }
+
+    return NULL;
+}
+
+/*
+ * Returns a pre-generated EC key on the curve specified by the DER encoded
+ * EC parameters, or NULL if the pool has no such key ready.
+ */
+EVP_PKEY *soft_keygen_pool_get_ec(struct soft_keygen_pool *pool,
+                                  const CK_BYTE *params, CK_ULONG params_len)
+{
+    const struct _ec *curve;
+    CK_ULONG i;
+
+    if (!pool->initialized)
+        return NULL;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        curve = pool->entries[i].curve;
+        if (pool->entries[i].key_type == CKK_EC &&
+            curve->data_size == params_len &&
+            memcmp(curve->data, params, params_len) == 0)
+            return soft_keygen_pool_take(pool, &pool->entries[i]);
+    }
+
+    return NULL;
+}
+
+/*
+ * Returns a pre-generated IBM Dilithium key of the specified key form, or NULL
+ * if the pool has no such key ready.
+ */
+EVP_PKEY *soft_keygen_pool_get_ibm_dilithium(struct soft_keygen_pool *pool,
+                                             const struct pqc_oid *oid)
+{
+    CK_ULONG i;
+
+    if (!pool->initialized)
+        return NULL;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        if (pool->entries[i].key_type == CKK_IBM_PQC_DILITHIUM &&
+            pool->entries[i].oid == oid)
+            return soft_keygen_pool_take(pool, &pool->entries[i]);
+    }
+
+    return NULL;
+}
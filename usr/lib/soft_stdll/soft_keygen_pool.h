@@ -0,0 +1,79 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2026
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef SOFT_KEYGEN_POOL_H
+#define SOFT_KEYGEN_POOL_H
+
+#include <pthread.h>
+
+#include <openssl/evp.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "ec_defs.h"
+#include "pqc_defs.h"
+#include "configuration.h"
+
+#define SOFT_CFG_KEYGEN_POOL            "KEYGEN_POOL"
+#define SOFT_CFG_KEYGEN_POOL_THREADS    "THREADS"
+#define SOFT_CFG_KEYGEN_POOL_RSA        "RSA_"
+#define SOFT_CFG_KEYGEN_POOL_EC         "EC_"
+#define SOFT_CFG_KEYGEN_POOL_DILITHIUM  "IBM_DILITHIUM_"
+
+#define SOFT_KEYGEN_POOL_MAX_DEPTH      1024
+#define SOFT_KEYGEN_POOL_MAX_THREADS    64
+
+/* Pre-generated keys of one kind, e.g. RSA keys with a 4096 bit modulus */
+struct soft_keygen_pool_entry {
+    CK_KEY_TYPE key_type;
+    CK_ULONG mod_bits;                  /* CKK_RSA */
+    const struct _ec *curve;            /* CKK_EC */
+    const struct pqc_oid *oid;          /* CKK_IBM_PQC_DILITHIUM */
+    CK_ULONG depth;                     /* number of keys to keep ready */
+    EVP_PKEY **keys;                    /* ready keys */
+    CK_ULONG num_keys;
+    CK_ULONG in_progress;               /* keys currently being generated */
+    CK_BBOOL disabled;                  /* key generation failed */
+    unsigned long hits;
+    unsigned long misses;
+};
+
+struct soft_keygen_pool {
+    struct soft_keygen_pool_entry *entries;
+    CK_ULONG num_entries;
+    CK_ULONG num_threads;
+    pthread_t *threads;
+    CK_ULONG threads_started;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    CK_BBOOL initialized;
+    CK_BBOOL terminate;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX *libctx;
+#endif
+};
+
+CK_RV soft_keygen_pool_parse_config(struct soft_keygen_pool *pool,
+                                    const char *fname,
+                                    struct ConfigStructNode *pool_node);
+CK_RV soft_keygen_pool_start(struct soft_keygen_pool *pool);
+void soft_keygen_pool_final(struct soft_keygen_pool *pool,
+                            CK_BBOOL in_fork_initializer);
+
+EVP_PKEY *soft_keygen_pool_get_rsa(struct soft_keygen_pool *pool,
+                                   CK_ULONG mod_bits,
+                                   const CK_BYTE *publ_exp,
+                                   CK_ULONG publ_exp_len);
+EVP_PKEY *soft_keygen_pool_get_ec(struct soft_keygen_pool *pool,
+                                  const CK_BYTE *params, CK_ULONG params_len);
+EVP_PKEY *soft_keygen_pool_get_ibm_dilithium(struct soft_keygen_pool *pool,
+                                             const struct pqc_oid *oid);
+
+#endif
@@ -21,8 +21,10 @@
 
 #include <pthread.h>
 #include <string.h>             // for memcmp() et al
+#include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <limits.h>
 
 #include <openssl/opensslv.h>
 
@@ -35,6 +37,9 @@
 #include "tok_specific.h"
 #include "tok_struct.h"
 #include "trace.h"
+#include "ock_syslog.h"
+#include "cfgparser.h"
+#include "soft_keygen_pool.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -267,19 +272,98 @@ static const CK_ULONG soft_mech_list_len =
 struct soft_private_data {
 #if OPENSSL_VERSION_PREREQ(3, 0)
     OSSL_PROVIDER *oqs_provider;
-#else
-    void *dummy;
 #endif
+    struct soft_keygen_pool keygen_pool;
 };
 
+static void soft_config_parse_error(int line, int col, const char *msg)
+{
+    OCK_SYSLOG(LOG_ERR, "Error parsing config file: line %d column %d: %s\n",
+               line, col, msg);
+    TRACE_ERROR("Error parsing config file: line %d column %d: %s\n", line, col,
+                msg);
+}
+
+static CK_RV soft_load_config_file(STDLL_TokData_t *tokdata, char *conf_name)
+{
+    struct soft_private_data *soft_private = tokdata->private_data;
+    char fname[PATH_MAX];
+    FILE *file;
+    struct ConfigBaseNode *c, *config = NULL;
+    struct ConfigStructNode *struct_node;
+    CK_RV rc = CKR_OK;
+    int ret, i;
+
+    if (conf_name == NULL || strlen(conf_name) == 0)
+        return CKR_OK;
+
+    if (conf_name[0] == '/') {
+        /* Absolute path name */
+        strncpy(fname, conf_name, sizeof(fname) - 1);
+        fname[sizeof(fname) - 1] = '\0';
+    } else {
+        /* relative path name */
+        snprintf(fname, sizeof(fname), "%s/%s", OCK_CONFDIR, conf_name);
+        fname[sizeof(fname) - 1] = '\0';
+    }
+
+    file = fopen(fname, "r");
+    if (file == NULL) {
+        TRACE_ERROR("%s fopen('%s') failed with errno: %s\n", __func__, fname,
+                    strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    ret = parse_configlib_file(file, &config, soft_config_parse_error, 0);
+    if (ret != 0) {
+        TRACE_ERROR("Error parsing config file '%s'\n", fname);
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+
+    confignode_foreach(c, config, i) {
+        TRACE_DEBUG("Config node: '%s' type: %u line: %u\n",
+                    c->key, c->type, c->line);
+
+        if (confignode_hastype(c, CT_FILEVERSION)) {
+            TRACE_DEBUG("Config file version: '%s'\n",
+                        confignode_to_fileversion(c)->base.key);
+            continue;
+        }
+
+        if (confignode_hastype(c, CT_STRUCT)) {
+            struct_node = confignode_to_struct(c);
+            if (strcasecmp(struct_node->base.key, SOFT_CFG_KEYGEN_POOL) == 0) {
+                rc = soft_keygen_pool_parse_config(&soft_private->keygen_pool,
+                                                   fname, struct_node);
+                if (rc != CKR_OK)
+                    break;
+                continue;
+            }
+        }
+
+        OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': unexpected token "
+                   "'%s' at line %d\n", fname, c->key, c->line);
+        TRACE_ERROR("Error parsing config file '%s': unexpected token '%s' "
+                    "at line %d\n", fname, c->key, c->line);
+        rc = CKR_FUNCTION_FAILED;
+        break;
+    }
+
+done:
+    confignode_deepfree(config);
+    fclose(file);
+
+    return rc;
+}
+
 CK_RV token_specific_init(STDLL_TokData_t *tokdata, CK_SLOT_ID SlotNumber,
                           char *conf_name)
 {
     struct soft_private_data *soft_private;
+    long cpus;
     CK_RV rc;
 
-    UNUSED(conf_name);
-
     TRACE_INFO("soft %s slot=%lu running\n", __func__, SlotNumber);
 
     rc = ock_generic_filter_mechanism_list(tokdata,
@@ -315,6 +399,24 @@ CK_RV token_specific_init(STDLL_TokData_t *tokdata, CK_SLOT_ID SlotNumber,
 
     tokdata->private_data = soft_private;
 
+    rc = soft_load_config_file(tokdata, conf_name);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Error loading config file '%s'\n", conf_name);
+        goto error;
+    }
+
+    rc = soft_keygen_pool_start(&soft_private->keygen_pool);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Starting the keygen pool failed\n");
+        goto error;
+    }
+
+    /* Spread large batch requests over all online CPUs */
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    tokdata->batch_threads = (cpus > 0 ? (CK_ULONG)cpus : 1);
+    /* Process async requests on a worker pool of the same size */
+    tokdata->async_threads = tokdata->batch_threads;
+
     return CKR_OK;
 
 error:
@@ -327,14 +429,14 @@ CK_RV token_specific_final(STDLL_TokData_t *tokdata,
 {
     struct soft_private_data *soft_private = tokdata->private_data;
 
-    UNUSED(in_fork_initializer);
-
     TRACE_INFO("soft %s running\n", __func__);
 
     if (tokdata->mech_list != NULL)
         free(tokdata->mech_list);
     
     if (soft_private != NULL) {
+        soft_keygen_pool_final(&soft_private->keygen_pool,
+                               in_fork_initializer);
 #if OPENSSL_VERSION_PREREQ(3, 0)
         if (soft_private->oqs_provider != NULL)
             OSSL_PROVIDER_unload(soft_private->oqs_provider);
@@ -482,9 +584,27 @@ CK_RV token_specific_rsa_generate_keypair(STDLL_TokData_t *tokdata,
                                           TEMPLATE *publ_tmpl,
                                           TEMPLATE *priv_tmpl)
 {
-    UNUSED(tokdata);
+    struct soft_private_data *soft_private = tokdata->private_data;
+    CK_ATTRIBUTE *publ_exp = NULL;
+    CK_ULONG mod_bits;
+    EVP_PKEY *pkey = NULL;
+    CK_RV rc;
+
+    if (template_attribute_get_ulong(publ_tmpl, CKA_MODULUS_BITS,
+                                     &mod_bits) == CKR_OK &&
+        template_attribute_get_non_empty(publ_tmpl, CKA_PUBLIC_EXPONENT,
+                                         &publ_exp) == CKR_OK)
+        pkey = soft_keygen_pool_get_rsa(&soft_private->keygen_pool, mod_bits,
+                                        publ_exp->pValue,
+                                        publ_exp->ulValueLen);
+    if (pkey == NULL)
+        return openssl_specific_rsa_keygen(publ_tmpl, priv_tmpl);
 
-    return openssl_specific_rsa_keygen(publ_tmpl, priv_tmpl);
+    rc = openssl_specific_rsa_keygen_from_pkey(pkey, publ_tmpl, priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
 }
 
 CK_RV token_specific_rsa_encrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
@@ -1382,7 +1502,24 @@ CK_RV token_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
                                          TEMPLATE *publ_tmpl,
                                          TEMPLATE *priv_tmpl)
 {
-    return openssl_specific_ec_generate_keypair(tokdata, publ_tmpl, priv_tmpl);
+    struct soft_private_data *soft_private = tokdata->private_data;
+    CK_ATTRIBUTE *params = NULL;
+    EVP_PKEY *pkey = NULL;
+    CK_RV rc;
+
+    if (template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS,
+                                         &params) == CKR_OK)
+        pkey = soft_keygen_pool_get_ec(&soft_private->keygen_pool,
+                                       params->pValue, params->ulValueLen);
+    if (pkey == NULL)
+        return openssl_specific_ec_generate_keypair(tokdata, publ_tmpl,
+                                                    priv_tmpl);
+
+    rc = openssl_specific_ec_keygen_from_pkey(pkey, publ_tmpl, priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
 }
 
 CK_RV token_specific_ec_sign(STDLL_TokData_t *tokdata,  SESSION *sess,
@@ -1678,15 +1815,26 @@ CK_RV token_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
                                                     TEMPLATE *priv_tmpl)
 {
     struct soft_private_data *soft_private = tokdata->private_data;
+    EVP_PKEY *pkey;
+    CK_RV rc;
 
     if (soft_private->oqs_provider == NULL) {
         TRACE_ERROR("The oqsprovider is not loaded\n");
         return CKR_MECHANISM_INVALID;
     }
 
-    return openssl_specific_ibm_dilithium_generate_keypair(tokdata, oid,
-                                                           publ_tmpl,
-                                                           priv_tmpl);
+    pkey = soft_keygen_pool_get_ibm_dilithium(&soft_private->keygen_pool, oid);
+    if (pkey == NULL)
+        return openssl_specific_ibm_dilithium_generate_keypair(tokdata, oid,
+                                                               publ_tmpl,
+                                                               priv_tmpl);
+
+    rc = openssl_specific_ibm_dilithium_keygen_from_pkey(pkey, oid, publ_tmpl,
+                                                         priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
 }
 
 CK_RV token_specific_ibm_dilithium_sign(STDLL_TokData_t *tokdata,
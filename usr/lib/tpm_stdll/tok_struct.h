@@ -126,7 +126,7 @@ struct token_specific_struct token_specific = {
     &token_specific_key_wrap,
     &token_specific_key_unwrap,
     NULL,                       // reencrypt_single
-    NULL,                       // set_attribute_values
+    &token_specific_set_attribute_values,
     NULL,                       // set_attrs_for_new_object
     NULL,                       // handle_event
     NULL,                       // check_obj_access
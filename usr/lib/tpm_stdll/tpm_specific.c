@@ -61,6 +61,32 @@
 
 #include "../api/apiproto.h"
 
+/*
+ * Cache of RSA keys loaded into the TPM, so that not every sign, verify,
+ * encrypt and decrypt operation has to load the key blob again. Entries are
+ * identified by an id that is attached to the key object as ex_data, and are
+ * replaced in least recently used order. An entry that is in use is never
+ * replaced; if it is invalidated while in use, it is unloaded when released.
+ */
+struct tpm_key_cache_entry {
+    unsigned long id;           // 0 if the entry is free
+    TSS_HKEY hKey;
+    unsigned long last_used;
+    unsigned long refs;
+    CK_BBOOL stale;
+};
+
+struct tpm_key_cache {
+    pthread_mutex_t mutex;
+    struct tpm_key_cache_entry *entries;
+    unsigned long num_entries;
+    unsigned long next_id;
+    unsigned long tick;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
 typedef struct {
     /* The context we'll use globally to connect to the TSP */
     TSS_HCONTEXT tspContext;
@@ -85,8 +111,16 @@ typedef struct {
 
     CK_BYTE current_user_pin_sha[SHA1_HASH_SIZE];
     CK_BYTE current_so_pin_sha[SHA1_HASH_SIZE];
+
+    struct tpm_key_cache key_cache;
 } tpm_private_data_t;
 
+/* Attached to RSA key objects that have been loaded into the TPM */
+typedef struct {
+    tpm_private_data_t *tpm_data;
+    unsigned long cache_id;
+} tpm_ex_data_t;
+
 TSS_RESULT util_set_public_modulus(TSS_HCONTEXT tspContext, TSS_HKEY,
                                   unsigned long, unsigned char *);
 
@@ -147,6 +181,290 @@ static void clear_internal_structures(STDLL_TokData_t * tokdata)
     memset(tpm_data->current_user_pin_sha, 0, SHA1_HASH_SIZE);
 }
 
+/*
+ * Unloads a key loaded by token_rsa_load_key_blob() and closes its handle
+ * and the usage policy that was created for it, if any.
+ */
+static void tpm_unload_key(tpm_private_data_t *tpm_data, TSS_HKEY hKey)
+{
+    TSS_HPOLICY hPolicy = NULL_HPOLICY;
+    TSS_RESULT result;
+
+    result = Tspi_GetPolicyObject(hKey, TSS_POLICY_USAGE, &hPolicy);
+    if (result == TSS_SUCCESS && hPolicy != NULL_HPOLICY &&
+        hPolicy != tpm_data->hDefaultPolicy)
+        Tspi_Context_CloseObject(tpm_data->tspContext, hPolicy);
+
+    result = Tspi_Key_UnloadKey(hKey);
+    if (result)
+        TRACE_DEVEL("Tspi_Key_UnloadKey failed. rc=0x%x\n", result);
+
+    Tspi_Context_CloseObject(tpm_data->tspContext, hKey);
+}
+
+static CK_RV tpm_key_cache_init(tpm_private_data_t *tpm_data)
+{
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+    UINT32 subcap = TSS_TPMCAP_PROP_SLOTS, len = 0;
+    unsigned long slots = TPMTOK_KEY_CACHE_DEFAULT_SLOTS;
+    TSS_RESULT result;
+    TSS_HTPM hTPM;
+    BYTE *buf = NULL;
+
+    result = Tspi_Context_GetTpmObject(tpm_data->tspContext, &hTPM);
+    if (result == TSS_SUCCESS)
+        result = Tspi_TPM_GetCapability(hTPM, TSS_TPMCAP_PROPERTY,
+                                        sizeof(subcap), (BYTE *)&subcap,
+                                        &len, &buf);
+    if (result == TSS_SUCCESS && len >= sizeof(UINT32))
+        slots = *(UINT32 *)buf;
+    else
+        TRACE_WARNING("Can not get the number of TPM key slots, assuming "
+                      "%d. rc=0x%x\n", TPMTOK_KEY_CACHE_DEFAULT_SLOTS, result);
+    if (buf != NULL)
+        Tspi_Context_FreeMemory(tpm_data->tspContext, buf);
+
+    memset(cache, 0, sizeof(*cache));
+    cache->num_entries = slots > TPMTOK_KEY_CACHE_RESERVED_SLOTS ?
+                            slots - TPMTOK_KEY_CACHE_RESERVED_SLOTS : 1;
+    cache->entries = calloc(cache->num_entries,
+                            sizeof(struct tpm_key_cache_entry));
+    if (cache->entries == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing the key cache mutex failed.\n");
+        free(cache->entries);
+        cache->entries = NULL;
+        return CKR_CANT_LOCK;
+    }
+
+    TRACE_INFO("TPM key slots: %lu, key cache entries: %lu\n", slots,
+               cache->num_entries);
+
+    return CKR_OK;
+}
+
+/*
+ * Drops all cached keys, e.g. because the parent key changes at login and
+ * logout. Keys that are in use are unloaded when they are released. The keys
+ * are not unloaded if 'unload' is FALSE, e.g. in a forked child process where
+ * the TSP context still belongs to the parent.
+ */
+static void tpm_key_cache_flush(tpm_private_data_t *tpm_data, CK_BBOOL unload)
+{
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+    unsigned long i;
+
+    if (cache->entries == NULL)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].id == 0)
+            continue;
+
+        if (cache->entries[i].refs > 0) {
+            cache->entries[i].stale = TRUE;
+            continue;
+        }
+
+        if (unload)
+            tpm_unload_key(tpm_data, cache->entries[i].hKey);
+        memset(&cache->entries[i], 0, sizeof(struct tpm_key_cache_entry));
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+static void tpm_key_cache_final(tpm_private_data_t *tpm_data,
+                                CK_BBOOL in_fork_initializer)
+{
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+
+    if (cache->entries == NULL)
+        return;
+
+    tpm_key_cache_flush(tpm_data, !in_fork_initializer);
+
+    TRACE_INFO("TPM key cache: hits: %lu misses: %lu evictions: %lu\n",
+               cache->hits, cache->misses, cache->evictions);
+
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->entries);
+    cache->entries = NULL;
+}
+
+/*
+ * Looks up the key with the specified cache id. If found, the entry is
+ * marked as in use and must be released with token_rsa_release_key().
+ */
+static CK_BBOOL tpm_key_cache_get(tpm_private_data_t *tpm_data,
+                                  unsigned long id, TSS_HKEY *phKey)
+{
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+    CK_BBOOL found = FALSE;
+    unsigned long i;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].id == id && !cache->entries[i].stale) {
+            cache->entries[i].refs++;
+            cache->entries[i].last_used = ++cache->tick;
+            *phKey = cache->entries[i].hKey;
+            found = TRUE;
+            break;
+        }
+    }
+    if (found)
+        cache->hits++;
+    else
+        cache->misses++;
+    pthread_mutex_unlock(&cache->mutex);
+
+    return found;
+}
+
+/*
+ * Adds a freshly loaded key as in use entry, replacing the least recently
+ * used entry that is not in use. Returns FALSE if the key is not cached,
+ * because all entries are in use, or another thread has cached the same key
+ * meanwhile. Such a key is unloaded when it is released.
+ */
+static CK_BBOOL tpm_key_cache_add(tpm_private_data_t *tpm_data,
+                                  unsigned long id, TSS_HKEY hKey)
+{
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+    struct tpm_key_cache_entry *entry = NULL;
+    TSS_HKEY hEvicted = NULL_HKEY;
+    unsigned long i;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].id == id && !cache->entries[i].stale) {
+            pthread_mutex_unlock(&cache->mutex);
+            return FALSE;
+        }
+        if (cache->entries[i].refs > 0)
+            continue;
+        if (entry == NULL || cache->entries[i].id == 0 ||
+            (entry->id != 0 &&
+             cache->entries[i].last_used < entry->last_used))
+            entry = &cache->entries[i];
+    }
+
+    if (entry == NULL) {
+        pthread_mutex_unlock(&cache->mutex);
+        return FALSE;
+    }
+
+    if (entry->id != 0) {
+        hEvicted = entry->hKey;
+        cache->evictions++;
+    }
+
+    entry->id = id;
+    entry->hKey = hKey;
+    entry->refs = 1;
+    entry->stale = FALSE;
+    entry->last_used = ++cache->tick;
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (hEvicted != NULL_HKEY)
+        tpm_unload_key(tpm_data, hEvicted);
+
+    return TRUE;
+}
+
+static void tpm_key_cache_remove(tpm_private_data_t *tpm_data,
+                                 unsigned long id)
+{
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+    TSS_HKEY hKey = NULL_HKEY;
+    unsigned long i;
+
+    if (cache->entries == NULL)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].id != id || cache->entries[i].stale)
+            continue;
+
+        if (cache->entries[i].refs > 0) {
+            cache->entries[i].stale = TRUE;
+        } else {
+            hKey = cache->entries[i].hKey;
+            memset(&cache->entries[i], 0, sizeof(struct tpm_key_cache_entry));
+        }
+        break;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (hKey != NULL_HKEY)
+        tpm_unload_key(tpm_data, hKey);
+}
+
+/*
+ * Called when the key object is freed, or when it is reloaded because another
+ * process has changed it.
+ */
+static void tpm_free_ex_data(OBJECT *obj, void *ex_data, size_t ex_data_len)
+{
+    tpm_ex_data_t *data = ex_data;
+
+    if (ex_data == NULL || ex_data_len < sizeof(tpm_ex_data_t))
+        return;
+
+    if (data->cache_id != 0)
+        tpm_key_cache_remove(data->tpm_data, data->cache_id);
+
+    free(data);
+    obj->ex_data = NULL;
+    obj->ex_data_len = 0;
+}
+
+static CK_BBOOL tpm_need_wr_lock(OBJECT *obj, void *ex_data,
+                                 size_t ex_data_len)
+{
+    tpm_ex_data_t *data = ex_data;
+
+    UNUSED(obj);
+
+    if (ex_data == NULL || ex_data_len < sizeof(tpm_ex_data_t))
+        return FALSE;
+
+    return data->cache_id == 0;
+}
+
+/*
+ * Returns the key cache id of the key object, and assigns a new one if the
+ * key object does not have one yet. Ids are never reused, so a stale id of
+ * a destroyed object can not match another key.
+ */
+static CK_RV tpm_get_key_cache_id(tpm_private_data_t *tpm_data,
+                                  OBJECT *key_obj, unsigned long *id)
+{
+    tpm_ex_data_t *ex_data = NULL;
+    CK_RV rc;
+
+    rc = openssl_get_ex_data(key_obj, (void **)&ex_data, sizeof(tpm_ex_data_t),
+                             tpm_need_wr_lock, tpm_free_ex_data);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ex_data->cache_id == 0) {
+        pthread_mutex_lock(&tpm_data->key_cache.mutex);
+        ex_data->cache_id = ++tpm_data->key_cache.next_id;
+        pthread_mutex_unlock(&tpm_data->key_cache.mutex);
+        ex_data->tpm_data = tpm_data;
+    }
+    *id = ex_data->cache_id;
+
+    return object_ex_data_unlock(key_obj);
+}
+
 CK_RV token_specific_rng(STDLL_TokData_t * tokdata, CK_BYTE * output,
                          CK_ULONG bytes)
 {
@@ -180,6 +498,7 @@ CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
     TSS_RESULT result;
     char path_buf[PATH_MAX], fname[PATH_MAX];
     struct stat statbuf;
+    CK_RV rc;
 
     UNUSED(conf_name);
 
@@ -245,6 +564,13 @@ CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
         return CKR_FUNCTION_FAILED;
     }
 
+    rc = tpm_key_cache_init(tpm_data);
+    if (rc != CKR_OK) {
+        Tspi_Context_Close(tpm_data->tspContext);
+        free(tpm_data);
+        return rc;
+    }
+
     OpenSSL_add_all_algorithms();
 
     return CKR_OK;
@@ -1719,6 +2045,9 @@ CK_RV token_specific_login(STDLL_TokData_t * tokdata, SESSION * sess,
 
     UNUSED(sess);
 
+    /* Keys loaded so far have the public root key as parent */
+    tpm_key_cache_flush(tpm_data, TRUE);
+
     result = token_load_srk(tokdata);
     if (result) {
         TRACE_DEVEL("token_load_srk failed. rc=0x%x\n", result);
@@ -1899,6 +2228,8 @@ CK_RV token_specific_logout(STDLL_TokData_t *tokdata)
 {
     tpm_private_data_t *tpm_data = (tpm_private_data_t *)tokdata->private_data;
 
+    tpm_key_cache_flush(tpm_data, TRUE);
+
     if (tpm_data->hPrivateLeafKey != NULL_HKEY) {
         Tspi_Key_UnloadKey(tpm_data->hPrivateLeafKey);
     } else if (tpm_data->hPublicLeafKey != NULL_HKEY) {
@@ -2356,6 +2687,8 @@ CK_RV token_specific_final(STDLL_TokData_t *tokdata,
 
     TRACE_INFO("tpm %s running\n", __func__);
 
+    tpm_key_cache_final(tpm_data, in_fork_initializer);
+
     /*
      * Only close the context if not in in_fork_initializer. If we close the
      * context in a forked child process, this also closes the parent's context.
@@ -2782,8 +3115,8 @@ CK_RV token_specific_rsa_generate_keypair(STDLL_TokData_t * tokdata,
     return rc;
 }
 
-CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
-                         TSS_HKEY * phKey)
+static CK_RV token_rsa_load_key_blob(STDLL_TokData_t * tokdata,
+                                     OBJECT * key_obj, TSS_HKEY * phKey)
 {
     tpm_private_data_t *tpm_data = (tpm_private_data_t *)tokdata->private_data;
     TSS_RESULT result;
@@ -2858,7 +3191,8 @@ CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
         if ((tpm_data->hPrivateLeafKey == NULL_HKEY) &&
             (tpm_data->hPublicLeafKey == NULL_HKEY)) {
             TRACE_ERROR("Shouldn't be in a public session here\n");
-            return CKR_FUNCTION_FAILED;
+            rc = CKR_FUNCTION_FAILED;
+            goto error;
         } else if (tpm_data->hPublicLeafKey != NULL_HKEY) {
             hParentKey = tpm_data->hPublicLeafKey;
         } else {
@@ -2869,13 +3203,15 @@ CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
                                         hParentKey, &authData);
         if (result) {
             TRACE_DEVEL("token_unwrap_auth_data: 0x%x\n", result);
-            return CKR_FUNCTION_FAILED;
+            rc = CKR_FUNCTION_FAILED;
+            goto error;
         }
 
         result = Tspi_GetPolicyObject(*phKey, TSS_POLICY_USAGE, &hPolicy);
         if (result) {
             TRACE_ERROR("Tspi_GetPolicyObject: 0x%x\n", result);
-            return CKR_FUNCTION_FAILED;
+            rc = CKR_FUNCTION_FAILED;
+            goto error;
         }
 
         /* If the policy handle returned is the same as the context's default
@@ -2887,7 +3223,8 @@ CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
                                                TSS_POLICY_USAGE, &hPolicy);
             if (result) {
                 TRACE_ERROR("Tspi_Context_CreateObject: 0x%x\n", result);
-                return CKR_FUNCTION_FAILED;
+                rc = CKR_FUNCTION_FAILED;
+                goto error;
             }
 
             result = Tspi_Policy_SetSecret(hPolicy, TSS_SECRET_MODE_SHA1,
@@ -2895,21 +3232,24 @@ CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
             if (result) {
                 TRACE_ERROR("Tspi_Policy_SetSecret failed. "
                             "rc=0x%x\n", result);
-                return CKR_FUNCTION_FAILED;
+                rc = CKR_FUNCTION_FAILED;
+                goto error;
             }
 
             result = Tspi_Policy_AssignToObject(hPolicy, *phKey);
             if (result) {
                 TRACE_ERROR("Tspi_Policy_AssignToObject failed."
                             " rc=0x%x\n", result);
-                return CKR_FUNCTION_FAILED;
+                rc = CKR_FUNCTION_FAILED;
+                goto error;
             }
         } else {
             result = Tspi_Policy_SetSecret(hPolicy, TSS_SECRET_MODE_SHA1,
                                            SHA1_HASH_SIZE, authData);
             if (result) {
                 TRACE_ERROR("Tspi_Policy_SetSecret failed. rc=0x%x\n", result);
-                return CKR_FUNCTION_FAILED;
+                rc = CKR_FUNCTION_FAILED;
+                goto error;
             }
         }
 
@@ -2917,6 +3257,94 @@ CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
     }
 
     return CKR_OK;
+
+error:
+    if (authData != NULL)
+        Tspi_Context_FreeMemory(tpm_data->tspContext, authData);
+    tpm_unload_key(tpm_data, *phKey);
+
+    return rc;
+}
+
+/*
+ * Returns the loaded TSS key for the RSA key object, loading it into the TPM
+ * if it is not cached. The key must be released with token_rsa_release_key()
+ * when the operation is done.
+ */
+CK_RV token_rsa_load_key(STDLL_TokData_t * tokdata, OBJECT * key_obj,
+                         TSS_HKEY * phKey)
+{
+    tpm_private_data_t *tpm_data = (tpm_private_data_t *)tokdata->private_data;
+    unsigned long id;
+    CK_RV rc;
+
+    rc = tpm_get_key_cache_id(tpm_data, key_obj, &id);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (tpm_key_cache_get(tpm_data, id, phKey))
+        return CKR_OK;
+
+    rc = token_rsa_load_key_blob(tokdata, key_obj, phKey);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (!tpm_key_cache_add(tpm_data, id, *phKey))
+        TRACE_DEVEL("Key not cached, all cached keys are in use\n");
+
+    return CKR_OK;
+}
+
+void token_rsa_release_key(STDLL_TokData_t * tokdata, TSS_HKEY hKey)
+{
+    tpm_private_data_t *tpm_data = (tpm_private_data_t *)tokdata->private_data;
+    struct tpm_key_cache *cache = &tpm_data->key_cache;
+    CK_BBOOL unload = TRUE;
+    unsigned long i;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].id == 0 || cache->entries[i].hKey != hKey)
+            continue;
+
+        cache->entries[i].refs--;
+        if (cache->entries[i].stale && cache->entries[i].refs == 0)
+            memset(&cache->entries[i], 0, sizeof(struct tpm_key_cache_entry));
+        else
+            unload = FALSE;
+        break;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (unload)
+        tpm_unload_key(tpm_data, hKey);
+}
+
+/*
+ * The key blob or its auth data may be changed by the update, so drop the
+ * loaded key of the object, if any.
+ */
+CK_RV token_specific_set_attribute_values(STDLL_TokData_t *tokdata,
+                                          SESSION *sess, OBJECT *obj,
+                                          TEMPLATE *new_tmpl)
+{
+    tpm_private_data_t *tpm_data = (tpm_private_data_t *)tokdata->private_data;
+    tpm_ex_data_t *ex_data;
+    CK_RV rc;
+
+    UNUSED(sess);
+    UNUSED(new_tmpl);
+
+    rc = object_ex_data_lock(obj, READ_LOCK);
+    if (rc != CKR_OK)
+        return rc;
+
+    ex_data = obj->ex_data;
+    if (ex_data != NULL && obj->ex_data_free == tpm_free_ex_data &&
+        ex_data->cache_id != 0)
+        tpm_key_cache_remove(tpm_data, ex_data->cache_id);
+
+    return object_ex_data_unlock(obj);
 }
 
 CK_RV token_specific_rsa_decrypt(STDLL_TokData_t * tokdata,
@@ -2945,7 +3373,8 @@ CK_RV token_specific_rsa_decrypt(STDLL_TokData_t * tokdata,
                                        TSS_ENCDATA_BIND, &hEncData);
     if (result) {
         TRACE_ERROR("Tspi_Context_CreateObject failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     result = Tspi_SetAttribData(hEncData, TSS_TSPATTRIB_ENCDATA_BLOB,
@@ -2953,7 +3382,8 @@ CK_RV token_specific_rsa_decrypt(STDLL_TokData_t * tokdata,
                                 in_data_len, in_data);
     if (result) {
         TRACE_ERROR("Tspi_SetAttribData failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     /* unbind the data, receiving the plaintext back */
@@ -2962,13 +3392,15 @@ CK_RV token_specific_rsa_decrypt(STDLL_TokData_t * tokdata,
     result = Tspi_Data_Unbind(hEncData, hKey, &buf_size, &buf);
     if (result) {
         TRACE_ERROR("Tspi_Data_Unbind failed: 0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     if (*out_data_len < buf_size) {
         TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
         Tspi_Context_FreeMemory(tpm_data->tspContext, buf);
-        return CKR_BUFFER_TOO_SMALL;
+        rc = CKR_BUFFER_TOO_SMALL;
+        goto done;
     }
 
     memcpy(out_data, buf, buf_size);
@@ -2976,7 +3408,12 @@ CK_RV token_specific_rsa_decrypt(STDLL_TokData_t * tokdata,
 
     Tspi_Context_FreeMemory(tpm_data->tspContext, buf);
 
-    return CKR_OK;
+    rc = CKR_OK;
+
+done:
+    token_rsa_release_key(tokdata, hKey);
+
+    return rc;
 }
 
 CK_RV token_specific_rsa_verify(STDLL_TokData_t * tokdata,
@@ -3006,14 +3443,16 @@ CK_RV token_specific_rsa_verify(STDLL_TokData_t * tokdata,
                                        TSS_HASH_OTHER, &hHash);
     if (result) {
         TRACE_ERROR("Tspi_Context_CreateObject failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     /* Insert the data into the hash object */
     result = Tspi_Hash_SetHashValue(hHash, in_data_len, in_data);
     if (result) {
         TRACE_ERROR("Tspi_Hash_SetHashValue failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     /* Verify */
@@ -3028,6 +3467,9 @@ CK_RV token_specific_rsa_verify(STDLL_TokData_t * tokdata,
         rc = CKR_OK;
     }
 
+done:
+    token_rsa_release_key(tokdata, hKey);
+
     return rc;
 }
 
@@ -3060,34 +3502,43 @@ CK_RV token_specific_rsa_sign(STDLL_TokData_t * tokdata,
                                        TSS_HASH_OTHER, &hHash);
     if (result) {
         TRACE_ERROR("Tspi_Context_CreateObject failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     /* Insert the data into the hash object */
     result = Tspi_Hash_SetHashValue(hHash, in_data_len, in_data);
     if (result) {
         TRACE_ERROR("Tspi_Hash_SetHashValue failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     /* Sign */
     result = Tspi_Hash_Sign(hHash, hKey, &sig_len, &sig);
     if (result) {
         TRACE_ERROR("Tspi_Hash_Sign failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     if (sig_len > *out_data_len) {
         TRACE_ERROR("Buffer too small to hold result.\n");
         Tspi_Context_FreeMemory(tpm_data->tspContext, sig);
-        return CKR_BUFFER_TOO_SMALL;
+        rc = CKR_BUFFER_TOO_SMALL;
+        goto done;
     }
 
     memcpy(out_data, sig, sig_len);
     *out_data_len = sig_len;
     Tspi_Context_FreeMemory(tpm_data->tspContext, sig);
 
-    return CKR_OK;
+    rc = CKR_OK;
+
+done:
+    token_rsa_release_key(tokdata, hKey);
+
+    return rc;
 }
 
 
@@ -3116,13 +3567,15 @@ CK_RV token_specific_rsa_encrypt(STDLL_TokData_t * tokdata,
                                        TSS_ENCDATA_BIND, &hEncData);
     if (result) {
         TRACE_ERROR("Tspi_Context_CreateObject failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     result = Tspi_Data_Bind(hEncData, hKey, in_data_len, in_data);
     if (result) {
         TRACE_ERROR("Tspi_Data_Bind failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     result = Tspi_GetAttribData(hEncData, TSS_TSPATTRIB_ENCDATA_BLOB,
@@ -3130,20 +3583,27 @@ CK_RV token_specific_rsa_encrypt(STDLL_TokData_t * tokdata,
                                 &dataBlobSize, &dataBlob);
     if (result) {
         TRACE_ERROR("Tspi_SetAttribData failed. rc=0x%x\n", result);
-        return CKR_FUNCTION_FAILED;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
     }
 
     if (dataBlobSize > *out_data_len) {
         TRACE_ERROR("%s\n", ock_err(ERR_DATA_LEN_RANGE));
         Tspi_Context_FreeMemory(tpm_data->tspContext, dataBlob);
-        return CKR_DATA_LEN_RANGE;
+        rc = CKR_DATA_LEN_RANGE;
+        goto done;
     }
 
     memcpy(out_data, dataBlob, dataBlobSize);
     *out_data_len = dataBlobSize;
     Tspi_Context_FreeMemory(tpm_data->tspContext, dataBlob);
 
-    return CKR_OK;
+    rc = CKR_OK;
+
+done:
+    token_rsa_release_key(tokdata, hKey);
+
+    return rc;
 }
 
 CK_RV token_specific_rsa_verify_recover(STDLL_TokData_t * tokdata,
@@ -56,6 +56,11 @@
 /* retry count for generating software RSA keys */
 #define KEYGEN_RETRY    5
 
+/* loaded key handle cache: key slots assumed if the TPM can't be queried,
+ * and slots kept free for the token's root and leaf keys */
+#define TPMTOK_KEY_CACHE_DEFAULT_SLOTS  10
+#define TPMTOK_KEY_CACHE_RESERVED_SLOTS 2
+
 EVP_PKEY *openssl_gen_key(STDLL_TokData_t *);
 int openssl_write_key(STDLL_TokData_t *, EVP_PKEY *, char *, CK_BYTE *);
 CK_RV openssl_read_key(STDLL_TokData_t *, char *, CK_BYTE *, EVP_PKEY **);
@@ -40,4 +40,6 @@ opencryptoki_stdll_libpkcs11_tpm_la_SOURCES =				\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
 	usr/lib/api/policyhelper.c usr/lib/common/pqc_supported.c	\
 	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
-	usr/lib/common/mech_pqc.c
+	usr/lib/common/slab.c usr/lib/common/obj_cache.c		\
+	usr/lib/common/login_cache.c					\
+	usr/lib/common/mech_pqc.c usr/lib/common/async_mgr.c
@@ -23,6 +23,7 @@
 #include <dlfcn.h>
 #include <pwd.h>
 #include <ctype.h>
+#include <time.h>
 #include "platform.h"
 
 #if !defined(_AIX)
@@ -68,10 +69,12 @@ static CK_RV p11sak_copy_key(void);
 static CK_RV p11sak_import_key(void);
 static CK_RV p11sak_export_key(void);
 static CK_RV p11sak_extract_key_pubkey(void);
+static CK_RV p11sak_batch_key(void);
 static void print_generate_import_key_attr_help(void);
 static void print_list_key_attr_help(void);
 static void print_set_copy_extract_key_attr_help(void);
 static void print_remove_key_help(void);
+static void print_batch_key_help(void);
 static CK_RV p11sak_list_cert(void);
 static CK_RV p11sak_remove_cert(void);
 static CK_RV p11sak_set_cert_attr(void);
@@ -136,6 +139,8 @@ static bool opt_uri_pin_value = false;
 static char *opt_uri_pin_source = NULL;
 static bool opt_oqsprovider_pem = false;
 static bool opt_hsm_mkvp = false;
+static char *opt_manifest = NULL;
+static CK_ULONG opt_threads = 0;
 
 static bool opt_slot_is_set(const struct p11sak_arg *arg);
 static CK_RV generic_get_key_size(const struct p11sak_objtype *keytype,
@@ -1873,6 +1878,28 @@ static const struct p11sak_arg p11sak_import_key_args[] = {
     { .name = NULL },
 };
 
+static const struct p11sak_opt p11sak_batch_key_opts[] = {
+    PKCS11_OPTS,
+    { .short_opt = 'F', .long_opt = "file", .required = true,
+      .arg =  { .type = ARG_TYPE_STRING, .required = true,
+                .value.string = &opt_manifest, .name = "FILENAME", },
+      .description = "The file name of the manifest file that lists the keys "
+                     "to be generated or imported. Specify '-' to read the "
+                     "manifest from standard input. See below for the format "
+                     "of the manifest file.", },
+    { .short_opt = 't', .long_opt = "threads", .required = false,
+      .arg =  { .type = ARG_TYPE_NUMBER, .required = true,
+                .value.number = &opt_threads, .name = "NUM", },
+      .description = "The number of threads used to generate or import the "
+                     "keys (optional). Each thread uses its own session. "
+                     "Default is 1.", },
+    { .short_opt = 0, .long_opt = NULL, },
+};
+
+static const struct p11sak_arg p11sak_batch_key_args[] = {
+    { .name = NULL },
+};
+
 static const struct p11sak_arg p11sak_import_cert_args[] = {
     { .name = "CERTTYPE", .type = ARG_TYPE_ENUM, .required = true,
       .enum_values = p11sak_import_cert_certtypes,
@@ -2177,6 +2204,12 @@ static const struct p11sak_cmd p11sak_commands[] = {
       .description = "Extract the public key from private keys in the repository.",
       .help = print_set_copy_extract_key_attr_help,
       .session_flags = CKF_SERIAL_SESSION | CKF_RW_SESSION, },
+    { .cmd = "batch-key", .cmd_short1 = "batch", .cmd_short2 = "bat",
+      .func = p11sak_batch_key,
+      .opts = p11sak_batch_key_opts, .args = p11sak_batch_key_args,
+      .description = "Generate or import keys listed in a manifest file.",
+      .help = print_batch_key_help,
+      .session_flags = CKF_SERIAL_SESSION | CKF_RW_SESSION, },
     { .cmd = "list-cert", .cmd_short1 = "ls-cert", .cmd_short2 = "lsc",
       .func = p11sak_list_cert,
       .opts = p11sak_list_cert_opts, .args = p11sak_list_cert_args,
@@ -3002,6 +3035,24 @@ static void print_remove_key_help(void)
     printf("\n");
 }
 
+static void print_batch_key_help(void)
+{
+    printf("MANIFEST:\n");
+    printf("    ");
+    print_indented("Each line of the manifest file specifies one key to be "
+                   "generated or imported, using the same arguments and "
+                   "options as the 'generate-key' and 'import-key' commands, "
+                   "for example:\n"
+                   "  generate-key aes 256 --label \"my aes key\"\n"
+                   "  import-key rsa private --label rsa1 --file rsa1.pem\n"
+                   "The slot, PIN and login options must not be specified in "
+                   "the manifest, they are taken from the 'batch-key' "
+                   "command. Empty lines and lines starting with '#' are "
+                   "ignored. Arguments containing blanks can be enclosed in "
+                   "single or double quotes.", 4);
+    printf("\n");
+}
+
 static void print_set_copy_extract_key_attr_help(void)
 {
     const struct p11sak_attr *attr;
@@ -4468,11 +4519,31 @@ done:
     return rc;
 }
 
-static CK_RV get_keysize_value(CK_OBJECT_HANDLE obj, char *label,
-                              const struct p11sak_objtype *objtype_val,
-                              CK_ULONG *keysize_val)
+/*
+ * The attributes the key size of all key types is derived from. These are
+ * fetched by get_obj_basic_infos(), either the value (value_len = false) or
+ * only the length (value_len = true).
+ */
+static const struct {
+    CK_ATTRIBUTE_TYPE type;
+    bool value_len;
+} keysize_attrs[OBJ_KEYSIZE_ATTRS] = {
+    { CKA_VALUE_LEN, false },
+    { CKA_MODULUS, true },
+    { CKA_PRIME, true },
+};
+
+/*
+ * Gets the key size of a key object. The key size attribute has usually been
+ * fetched already by get_obj_basic_infos(), a separate C_GetAttributeValue
+ * call is only made for a key size attribute not in keysize_attrs.
+ */
+static CK_RV get_keysize_value(struct p11sak_obj_info *info,
+                               const struct p11sak_objtype *objtype_val,
+                               CK_ULONG *keysize_val)
 {
     CK_ATTRIBUTE keysize_attr;
+    CK_ULONG i;
     CK_RV rc;
 
     if (objtype_val->keysize_attr == (CK_ATTRIBUTE_TYPE)-1) {
@@ -4480,26 +4551,41 @@ static CK_RV get_keysize_value(CK_OBJECT_HANDLE obj, char *label,
         return CKR_OK;
     }
 
-    keysize_attr.type = objtype_val->keysize_attr;
-    if (!objtype_val->keysize_attr_value_len) {
-        keysize_attr.ulValueLen = sizeof(*keysize_val);
-        keysize_attr.pValue = keysize_val;
-    } else {
-        /* Query attribute length only */
-        keysize_attr.ulValueLen = 0;
-        keysize_attr.pValue = NULL;
+    for (i = 0; i < OBJ_KEYSIZE_ATTRS; i++) {
+        if (keysize_attrs[i].type == objtype_val->keysize_attr &&
+            keysize_attrs[i].value_len == objtype_val->keysize_attr_value_len)
+            break;
     }
 
-    rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, obj,
-                                           &keysize_attr, 1);
-    if (rc != CKR_OK) {
-        warnx("Attribute %s is not available in object \"%s\"",
-              p11_get_cka(keysize_attr.type), label);
-        return rc;
-    }
+    if (i < OBJ_KEYSIZE_ATTRS) {
+        if (info->keysize_vals[i] == CK_UNAVAILABLE_INFORMATION) {
+            warnx("Attribute %s is not available in object \"%s\"",
+                  p11_get_cka(keysize_attrs[i].type), info->label);
+            return CKR_ATTRIBUTE_TYPE_INVALID;
+        }
+        *keysize_val = info->keysize_vals[i];
+    } else {
+        keysize_attr.type = objtype_val->keysize_attr;
+        if (!objtype_val->keysize_attr_value_len) {
+            keysize_attr.ulValueLen = sizeof(*keysize_val);
+            keysize_attr.pValue = keysize_val;
+        } else {
+            /* Query attribute length only */
+            keysize_attr.ulValueLen = 0;
+            keysize_attr.pValue = NULL;
+        }
+
+        rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, info->obj,
+                                               &keysize_attr, 1);
+        if (rc != CKR_OK) {
+            warnx("Attribute %s is not available in object \"%s\"",
+                  p11_get_cka(keysize_attr.type), info->label);
+            return rc;
+        }
 
-    if (objtype_val->keysize_attr_value_len)
-        *keysize_val = keysize_attr.ulValueLen;
+        if (objtype_val->keysize_attr_value_len)
+            *keysize_val = keysize_attr.ulValueLen;
+    }
 
     if (objtype_val->key_keysize_adjust != NULL)
         *keysize_val = objtype_val->key_keysize_adjust(objtype_val,
@@ -4551,50 +4637,6 @@ static CK_RV get_typestr_value(CK_OBJECT_CLASS class_val, CK_ULONG keysize_val,
     return CKR_OK;
 }
 
-static CK_RV get_class_and_type_values(CK_OBJECT_HANDLE obj, char *label,
-                                       CK_OBJECT_CLASS *class_val,
-                                       CK_ULONG *otype_val)
-{
-    CK_RV rc;
-    CK_KEY_TYPE ktype_val = 0;
-    CK_CERTIFICATE_TYPE ctype_val = 0;
-    CK_ATTRIBUTE attrs[] = {
-        { CKA_CLASS, class_val, sizeof(class_val) },
-        { CKA_KEY_TYPE, &ktype_val, sizeof(ktype_val) },
-        { CKA_CERTIFICATE_TYPE, &ctype_val, sizeof(ctype_val) },
-    };
-    const CK_ULONG num_attrs = sizeof(attrs) / sizeof(CK_ATTRIBUTE);
-
-    rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, obj,
-                                           attrs, num_attrs);
-    if (rc != CKR_OK && rc != CKR_ATTRIBUTE_TYPE_INVALID &&
-        rc != CKR_ATTRIBUTE_SENSITIVE) {
-        warnx("Failed to get attributes: C_GetAttributeValue: 0x%lX: %s",
-              rc, p11_get_ckr(rc));
-        return rc;
-    }
-
-    /* Class attribute must be available in any case. Others
-       depend on object type: key or certificate */
-    if (attrs[0].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
-        warnx("Class attribute %s is not available in object \"%s\"",
-              p11_get_cka(attrs[0].type), label);
-        return CKR_TEMPLATE_INCOMPLETE;
-    }
-
-    if (attrs[1].ulValueLen != CK_UNAVAILABLE_INFORMATION)
-        *otype_val = ktype_val;
-    else if (attrs[2].ulValueLen != CK_UNAVAILABLE_INFORMATION)
-        *otype_val = ctype_val;
-    else {
-        warnx("At least one of CKA_KEY_TYPE or CKA_CERTIFICATE_TYPE must "
-              "be available in object \"%s\"", label);
-        return CKR_TEMPLATE_INCOMPLETE;
-    }
-
-    return CKR_OK;
-}
-
 static CK_RV get_label_value(CK_OBJECT_HANDLE obj, char** label_value)
 {
     CK_ATTRIBUTE attr = { CKA_LABEL, NULL, 0 };
@@ -4642,115 +4684,162 @@ done:
     return CKR_OK;
 }
 
-static CK_RV get_obj_infos(CK_OBJECT_HANDLE obj, CK_OBJECT_CLASS *class,
-                           CK_ULONG *otype, CK_ULONG *keysize,
-                           char** label, char** typestr,
-                           const struct p11sak_objtype **objtype,
-                           char **common_name)
+/*
+ * Gets the label, the class, the key or certificate type, and the attributes
+ * the key size is derived from of an object with a single
+ * C_GetAttributeValue call. Attributes that the object does not have are
+ * returned as CK_UNAVAILABLE_INFORMATION. The label is retrieved separately
+ * only if it does not fit into the local buffer. If the object has neither a
+ * key type nor a certificate type, otype is set to CK_UNAVAILABLE_INFORMATION.
+ */
+static CK_RV get_obj_basic_infos(CK_OBJECT_HANDLE obj,
+                                 struct p11sak_obj_info *info)
 {
+    char label_buf[OBJ_LABEL_BUFFER_SIZE];
+    CK_KEY_TYPE ktype_val = 0;
+    CK_CERTIFICATE_TYPE ctype_val = 0;
+    CK_ATTRIBUTE attrs[4 + OBJ_KEYSIZE_ATTRS] = {
+        { CKA_LABEL, label_buf, sizeof(label_buf) },
+        { CKA_CLASS, &info->class, sizeof(info->class) },
+        { CKA_KEY_TYPE, &ktype_val, sizeof(ktype_val) },
+        { CKA_CERTIFICATE_TYPE, &ctype_val, sizeof(ctype_val) },
+    };
+    const CK_ULONG num_attrs = sizeof(attrs) / sizeof(CK_ATTRIBUTE);
+    CK_ULONG i;
     CK_RV rc;
-    CK_OBJECT_CLASS class_val = 0;
-    CK_ULONG otype_val = 0;
-    const struct p11sak_objtype *objtype_val;
-    CK_ULONG keysize_val = 0;
-    char *label_val = NULL;
-    char *common_name_val = NULL;
-
-    rc = get_label_value(obj, &label_val);
-    if (rc != CKR_OK)
-        return rc;
 
-    rc = get_class_and_type_values(obj, label_val, &class_val, &otype_val);
-    if (rc != CKR_OK) {
-        free(label_val);
+    info->obj = obj;
+
+    for (i = 0; i < OBJ_KEYSIZE_ATTRS; i++) {
+        attrs[4 + i].type = keysize_attrs[i].type;
+        if (!keysize_attrs[i].value_len) {
+            attrs[4 + i].pValue = &info->keysize_vals[i];
+            attrs[4 + i].ulValueLen = sizeof(info->keysize_vals[i]);
+        }
+    }
+
+    rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, obj,
+                                           attrs, num_attrs);
+    if (rc != CKR_OK && rc != CKR_ATTRIBUTE_TYPE_INVALID &&
+        rc != CKR_ATTRIBUTE_SENSITIVE && rc != CKR_BUFFER_TOO_SMALL) {
+        warnx("Failed to get attributes: C_GetAttributeValue: 0x%lX: %s",
+              rc, p11_get_ckr(rc));
         return rc;
     }
 
-    switch (class_val) {
+    if (attrs[0].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
+        /* Label is too long for the buffer, or not available at all */
+        rc = get_label_value(obj, &info->label);
+        if (rc != CKR_OK)
+            return rc;
+    } else {
+        info->label = strndup(label_buf, attrs[0].ulValueLen);
+    }
+    if (info->label == NULL) {
+        warnx("Failed to allocate memory for label attribute");
+        return CKR_HOST_MEMORY;
+    }
+
+    /* Class attribute must be available in any case. Others
+       depend on object type: key or certificate */
+    if (attrs[1].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
+        warnx("Class attribute %s is not available in object \"%s\"",
+              p11_get_cka(attrs[1].type), info->label);
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    if (attrs[2].ulValueLen != CK_UNAVAILABLE_INFORMATION)
+        info->otype = ktype_val;
+    else if (attrs[3].ulValueLen != CK_UNAVAILABLE_INFORMATION)
+        info->otype = ctype_val;
+    else
+        info->otype = CK_UNAVAILABLE_INFORMATION;
+
+    for (i = 0; i < OBJ_KEYSIZE_ATTRS; i++) {
+        if (attrs[4 + i].ulValueLen == CK_UNAVAILABLE_INFORMATION)
+            info->keysize_vals[i] = CK_UNAVAILABLE_INFORMATION;
+        else if (keysize_attrs[i].value_len)
+            info->keysize_vals[i] = attrs[4 + i].ulValueLen;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Completes the object information obtained by get_obj_basic_infos() with
+ * the object type, the key size or the common name, and the type string.
+ */
+static CK_RV get_obj_infos(struct p11sak_obj_info *info)
+{
+    CK_RV rc;
+
+    if (info->otype == CK_UNAVAILABLE_INFORMATION) {
+        warnx("At least one of CKA_KEY_TYPE or CKA_CERTIFICATE_TYPE must "
+              "be available in object \"%s\"", info->label);
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    switch (info->class) {
     case CKO_SECRET_KEY:
     case CKO_PUBLIC_KEY:
     case CKO_PRIVATE_KEY:
-        objtype_val = find_keytype(otype_val);
-        if (objtype_val == NULL) {
+        info->objtype = find_keytype(info->otype);
+        if (info->objtype == NULL) {
             warnx("Object \"%s\" has an unsupported type: %lu",
-                  label_val, otype_val);
-            free(label_val);
+                  info->label, info->otype);
             return CKR_KEY_TYPE_INCONSISTENT;
         }
-        if (keysize != NULL) {
-            rc = get_keysize_value(obj, label_val, objtype_val, &keysize_val);
-            if (rc != CKR_OK) {
-                free(label_val);
-                return rc;
-            }
-            *keysize = keysize_val;
-        }
+        rc = get_keysize_value(info, info->objtype, &info->keysize);
+        if (rc != CKR_OK)
+            return rc;
         break;
     case CKO_CERTIFICATE:
-        objtype_val = find_certtype(otype_val);
-        if (objtype_val == NULL) {
+        info->objtype = find_certtype(info->otype);
+        if (info->objtype == NULL) {
             warnx("Object \"%s\" has an unsupported type: %lu",
-                  label_val, otype_val);
-            free(label_val);
+                  info->label, info->otype);
             return CKR_KEY_TYPE_INCONSISTENT;
         }
-        if (common_name != NULL) {
-            rc = get_common_name_value(obj, label_val, &common_name_val);
-            if (rc != CKR_OK) {
-                free(label_val);
-                free(common_name_val);
-                return rc;
-            }
-            *common_name = common_name_val;
-        }
+        rc = get_common_name_value(info->obj, info->label,
+                                   &info->common_name);
+        if (rc != CKR_OK)
+            return rc;
         break;
     default:
         /* Should not occur */
         warnx("Object \"%s\" has an unsupported class: %lu",
-              label_val, class_val);
-        free(label_val);
+              info->label, info->class);
         return CKR_KEY_TYPE_INCONSISTENT;
-        break;
     }
 
-    if (class != NULL)
-        *class = class_val;
-
-    if (otype != NULL)
-        *otype = otype_val;
-
-    if (objtype != NULL)
-        *objtype = objtype_val;
-
-    if (typestr != NULL) {
-        rc = get_typestr_value(class_val, keysize_val, objtype_val,
-                               label_val, typestr);
-        if (rc != CKR_OK) {
-            free(label_val);
-            return rc;
-        }
-    }
+    return get_typestr_value(info->class, info->keysize, info->objtype,
+                             info->label, &info->typestr);
+}
 
-    if (label != NULL)
-        *label = label_val;
-    else
-        free(label_val);
+static void free_obj_info(struct p11sak_obj_info *info)
+{
+    if (info->label != NULL)
+        free(info->label);
+    if (info->typestr != NULL)
+        free(info->typestr);
+    if (info->common_name != NULL)
+        free(info->common_name);
 
-    return CKR_OK;
+    memset(info, 0, sizeof(*info));
 }
 
 static int iterate_compare(const void *a, const void *b, void *private)
 {
     struct p11sak_iterate_compare_data *data = private;
-    const CK_OBJECT_HANDLE *obj1 = a;
-    const CK_OBJECT_HANDLE *obj2 = b;
+    const struct p11sak_obj_info *info1 = a;
+    const struct p11sak_obj_info *info2 = b;
     int result = 0;
     CK_RV rc;
 
     if (data->rc != CKR_OK)
         return 0;
 
-    rc = data->compare_obj(*obj1, *obj2, &result, data->private);
+    rc = data->compare_obj(info1, info2, &result, data->private);
     if (rc != CKR_OK)
         data->rc = rc;
 
@@ -4764,19 +4853,9 @@ static int iterate_compare_aix(const void *a, const void *b)
 }
 #endif
 
-static CK_BBOOL objclass_expected(CK_OBJECT_HANDLE obj, enum p11sak_objclass objclass)
+static CK_BBOOL objclass_expected(CK_OBJECT_CLASS class_val,
+                                  enum p11sak_objclass objclass)
 {
-    CK_OBJECT_CLASS class_val = 0;
-    CK_ATTRIBUTE attr = { CKA_CLASS, &class_val, sizeof(class_val) };
-    CK_RV rv;
-
-    rv = get_attribute(obj, &attr);
-    if (rv != CKR_OK) {
-        warnx("Failed to get CKA_CLASS attribute: get_attribute: 0x%lX: %s",
-              rv, p11_get_ckr(rv));
-        return rv;
-    }
-
     switch (objclass) {
     case OBJCLASS_KEY:
         if (class_val == CKO_SECRET_KEY || class_val == CKO_PUBLIC_KEY ||
@@ -4794,15 +4873,26 @@ static CK_BBOOL objclass_expected(CK_OBJECT_HANDLE obj, enum p11sak_objclass obj
     return CK_FALSE;
 }
 
+/*
+ * Iterates over all token objects of the specified class that match the
+ * filters. Filters are passed to C_FindObjectsInit as far as possible, so
+ * that the token does the filtering. If compare_obj is specified, the
+ * matching objects are sorted before handle_obj is called for them.
+ * Otherwise, if stream is true, handle_obj is called for each matching object
+ * while the find operation is still active. This must only be used with
+ * handlers that do not create or destroy objects.
+ */
 static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
                              const char *label_filter,
                              const char *id_filter,
                              const char *attr_filter,
                              enum p11sak_objclass objclass,
-                             CK_RV (*compare_obj)(CK_OBJECT_HANDLE obj1,
-                                                  CK_OBJECT_HANDLE obj2,
-                                                  int *result,
-                                                  void *private),
+                             bool stream,
+                             CK_RV (*compare_obj)(
+                                        const struct p11sak_obj_info *info1,
+                                        const struct p11sak_obj_info *info2,
+                                        int *result,
+                                        void *private),
                              CK_RV (*handle_obj)(CK_OBJECT_HANDLE obj,
                                                  CK_OBJECT_CLASS class,
                                                  const struct p11sak_objtype *objtype,
@@ -4817,21 +4907,19 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
     CK_ATTRIBUTE *attrs = NULL;
     CK_ULONG num_attrs = 0;
     const CK_BBOOL ck_true = CK_TRUE;
+    const CK_OBJECT_CLASS cert_class = CKO_CERTIFICATE;
     CK_OBJECT_HANDLE objs[FIND_OBJECTS_COUNT];
     CK_ULONG i, num_objs;
     bool manual_filtering = false;
-    CK_OBJECT_CLASS class;
-    CK_KEY_TYPE ktype;
-    CK_ULONG keysize = 0;
-    char *label = NULL;
-    char *typestr = NULL;
-    char *common_name = NULL;
-    const struct p11sak_objtype *type;
-    CK_OBJECT_HANDLE *matched_objs = NULL, *tmp;
+    struct p11sak_obj_info info = { 0 };
+    struct p11sak_obj_info *matched_objs = NULL, *tmp;
     CK_ULONG num_matched_objs = 0;
     CK_ULONG alloc_matched_objs = 0;
     struct p11sak_iterate_compare_data data;
 
+    if (compare_obj != NULL)
+        stream = false;
+
     rc = add_attribute(CKA_TOKEN, &ck_true, sizeof(ck_true), &attrs, &num_attrs);
     if (rc != CKR_OK)
         goto done;
@@ -4843,6 +4931,14 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
             goto done;
     }
 
+    if (objclass == OBJCLASS_CERTIFICATE &&
+        (objtype == NULL || objtype->filter_attr != CKA_CLASS)) {
+        rc = add_attribute(CKA_CLASS, &cert_class, sizeof(cert_class),
+                           &attrs, &num_attrs);
+        if (rc != CKR_OK)
+            goto done;
+    }
+
     if (label_filter != NULL) {
         manual_filtering = (strpbrk(label_filter, "*?\\") != NULL);
         if (!manual_filtering) {
@@ -4890,22 +4986,34 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
             break;
 
         for (i = 0; i < num_objs; i++) {
-            if (!objclass_expected(objs[i], objclass))
-                continue;
+            rc = get_obj_basic_infos(objs[i], &info);
+            if (rc != CKR_OK)
+                goto done_find;
+
+            if (!objclass_expected(info.class, objclass))
+                goto next;
+
+            if (manual_filtering && fnmatch(label_filter, info.label, 0) != 0)
+                goto next;
 
-            if (manual_filtering) {
-                rc = get_label_value(objs[i], &label);
+            if (stream) {
+                rc = get_obj_infos(&info);
                 if (rc != CKR_OK)
-                    break;
+                    goto done_find;
+
+                rc = handle_obj(info.obj, info.class, info.objtype,
+                                info.keysize, info.typestr, info.label,
+                                info.common_name, private);
+                if (rc != CKR_OK)
+                    goto done_find;
 
-                if (fnmatch(label_filter, label, 0) != 0)
-                    goto next;
+                goto next;
             }
 
             if (num_matched_objs >= alloc_matched_objs) {
                 tmp = realloc(matched_objs,
                               (alloc_matched_objs + FIND_OBJECTS_COUNT) *
-                                                  sizeof(CK_OBJECT_HANDLE));
+                                            sizeof(struct p11sak_obj_info));
                 if (tmp == NULL) {
                     warnx("Failed to allocate a list of matched objects.");
                     rc = CKR_HOST_MEMORY;
@@ -4916,12 +5024,13 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
                 alloc_matched_objs += FIND_OBJECTS_COUNT;
             }
 
-            matched_objs[num_matched_objs++] = objs[i];
+            /* The object infos are moved to the list of matched objects */
+            matched_objs[num_matched_objs++] = info;
+            memset(&info, 0, sizeof(info));
+            continue;
 
 next:
-            if (label != NULL)
-                free(label);
-            label = NULL;
+            free_obj_info(&info);
         }
     }
 
@@ -4937,6 +5046,15 @@ done_find:
     if (rc != CKR_OK)
         goto done;
 
+    if (compare_obj != NULL) {
+        /* Get the infos once per object, not for every comparison */
+        for (i = 0; i < num_matched_objs; i++) {
+            rc = get_obj_infos(&matched_objs[i]);
+            if (rc != CKR_OK)
+                goto done;
+        }
+    }
+
     if (compare_obj != NULL && num_matched_objs > 0) {
         data.compare_obj = compare_obj;
         data.private = private;
@@ -4944,10 +5062,10 @@ done_find:
 
 #if defined(_AIX)
         global_private = &data;
-        qsort(matched_objs, num_matched_objs, sizeof(CK_OBJECT_HANDLE),
+        qsort(matched_objs, num_matched_objs, sizeof(struct p11sak_obj_info),
                 iterate_compare_aix);
 #else
-        qsort_r(matched_objs, num_matched_objs, sizeof(CK_OBJECT_HANDLE),
+        qsort_r(matched_objs, num_matched_objs, sizeof(struct p11sak_obj_info),
                 iterate_compare, &data);
 #endif
         rc = data.rc;
@@ -4956,62 +5074,45 @@ done_find:
     }
 
     for (i = 0; i < num_matched_objs; i++) {
-        rc = get_obj_infos(matched_objs[i], &class, &ktype, &keysize,
-                           &label, &typestr, &type, &common_name);
-        if (rc != CKR_OK)
-            break;
+        if (compare_obj == NULL) {
+            rc = get_obj_infos(&matched_objs[i]);
+            if (rc != CKR_OK)
+                break;
+        }
 
-        rc = handle_obj(matched_objs[i], class, type, keysize, typestr, label,
-                        common_name, private);
+        rc = handle_obj(matched_objs[i].obj, matched_objs[i].class,
+                        matched_objs[i].objtype, matched_objs[i].keysize,
+                        matched_objs[i].typestr, matched_objs[i].label,
+                        matched_objs[i].common_name, private);
         if (rc != CKR_OK)
             break;
-
-        if (label != NULL)
-            free(label);
-        label = NULL;
-        if (typestr != NULL)
-            free(typestr);
-        typestr = NULL;
-        if (common_name != NULL)
-            free(common_name);
-        common_name = NULL;
     }
 
 done:
     free_attributes(attrs, num_attrs);
+    free_obj_info(&info);
 
-    if (label != NULL)
-        free(label);
-    if (typestr != NULL)
-        free(typestr);
-    if (common_name != NULL)
-        free(common_name);
+    for (i = 0; i < num_matched_objs; i++)
+        free_obj_info(&matched_objs[i]);
     if (matched_objs != NULL)
         free(matched_objs);
 
     return rc;
 }
 
-static CK_RV p11sak_generate_key(void)
+static CK_RV prepare_generate_key(struct p11sak_key_job *job)
 {
     const struct p11sak_objtype *keytype;
     void *private = NULL;
     CK_RV rc = CKR_OK;
-    CK_ULONG keysize = 0;
-    char *pub_label = NULL, *priv_label = NULL;
     char *pub_attrs = NULL, *priv_attrs = NULL;
-    CK_ATTRIBUTE *secret_attrs = NULL;
-    CK_ULONG num_secret_attrs = 0;
-    CK_ATTRIBUTE *public_attrs = NULL;
-    CK_ULONG num_public_attrs = 0;
-    CK_ATTRIBUTE *private_attrs = NULL;
-    CK_ULONG num_private_attrs = 0;
-    CK_OBJECT_HANDLE pub_key, priv_key, secret_key;
 
     if (opt_keytype == NULL || opt_keytype->private.ptr == NULL)
         return CKR_ARGUMENTS_BAD;
 
     keytype = opt_keytype->private.ptr;
+    job->keytype = keytype;
+    job->import = false;
 
     if (keytype->keygen_prepare != NULL) {
         rc = keytype->keygen_prepare(keytype, &private);
@@ -5023,7 +5124,7 @@ static CK_RV p11sak_generate_key(void)
     }
 
     if (keytype->keygen_get_key_size != NULL) {
-        rc = keytype->keygen_get_key_size(keytype, private, &keysize);
+        rc = keytype->keygen_get_key_size(keytype, private, &job->keysize);
         if (rc != CKR_OK) {
             warnx("Failed to get key size for key type %s: 0x%lX: %s",
                   keytype->name, rc, p11_get_ckr(rc));
@@ -5031,12 +5132,13 @@ static CK_RV p11sak_generate_key(void)
         }
     }
 
-    rc = check_mech_supported(keytype, keysize);
+    rc = check_mech_supported(keytype, job->keysize);
     if (rc != CKR_OK)
         goto done;
 
     if (keytype->is_asymmetric) {
-        rc = parse_key_pair_label(opt_label, &pub_label, &priv_label);
+        rc = parse_key_pair_label(opt_label, &job->pub_label,
+                                  &job->priv_label);
         if (rc != CKR_OK)
             goto done;
 
@@ -5044,21 +5146,28 @@ static CK_RV p11sak_generate_key(void)
         if (rc != CKR_OK)
             goto done;
 
-        rc = add_attributes(keytype, &public_attrs, &num_public_attrs,
-                            pub_label, pub_attrs, opt_id, false,
+        rc = add_attributes(keytype, &job->attrs, &job->num_attrs,
+                            job->pub_label, pub_attrs, opt_id, false,
                             keytype->keygen_add_public_attrs, private,
                             public_attr_applicable);
         if (rc != CKR_OK)
             goto done;
 
-        rc = add_attributes(keytype, &private_attrs, &num_private_attrs,
-                            priv_label, priv_attrs, opt_id, true,
+        rc = add_attributes(keytype, &job->priv_attrs, &job->num_priv_attrs,
+                            job->priv_label, priv_attrs, opt_id, true,
                             keytype->keygen_add_private_attrs, private,
                             private_attr_applicable);
         if (rc != CKR_OK)
             goto done;
     } else {
-        rc = add_attributes(keytype, &secret_attrs, &num_secret_attrs,
+        job->label = strdup(opt_label);
+        if (job->label == NULL) {
+            warnx("Failed to allocate memory for the key label");
+            rc = CKR_HOST_MEMORY;
+            goto done;
+        }
+
+        rc = add_attributes(keytype, &job->attrs, &job->num_attrs,
                             opt_label, opt_attr, opt_id, true,
                             keytype->keygen_add_secret_attrs, private,
                             secret_attr_applicable);
@@ -5066,59 +5175,125 @@ static CK_RV p11sak_generate_key(void)
             goto done;
     }
 
-    if (keytype->is_asymmetric)
-        rc = pkcs11_funcs->C_GenerateKeyPair(pkcs11_session,
-                                             (CK_MECHANISM *)&keytype->keygen_mech,
-                                             public_attrs, num_public_attrs,
-                                             private_attrs, num_private_attrs,
-                                             &pub_key, &priv_key);
-     else
-         rc = pkcs11_funcs->C_GenerateKey(pkcs11_session,
-                                          (CK_MECHANISM *)&keytype->keygen_mech,
-                                          secret_attrs, num_secret_attrs,
-                                          &secret_key);
-    if (rc != CKR_OK) {
-        if (is_rejected_by_policy(rc, pkcs11_session)) {
-            if (keysize == 0)
-                warnx("Key generation of a %s key is rejected by policy",
-                      keytype->name);
-            else
-                warnx("Key generation of a %s key of size %lu is rejected by policy",
-                      keytype->name, keysize);
-        } else {
-            if (keysize == 0)
-                warnx("Key generation of a %s key failed: 0x%lX: %s",
-                      keytype->name, rc, p11_get_ckr(rc));
-            else
-                warnx("Key generation of a %s key of size %lu failed: 0x%lX: %s",
-                      keytype->name, keysize, rc, p11_get_ckr(rc));
-        }
-        goto done;
-    }
-
-    if (keytype->is_asymmetric)
-        printf("Successfully generated a %s key pair with labels \"%s\":\"%s\".\n",
-               keytype->name, pub_label, priv_label);
-    else
-        printf("Successfully generated a %s key with label \"%s\".\n",
-               keytype->name, opt_label);
+    job->prepared = true;
 
 done:
     if (keytype->keygen_cleanup != NULL)
         keytype->keygen_cleanup(keytype, private);
 
-    if (pub_label != NULL)
-        free(pub_label);
-    if (priv_label != NULL)
-        free(priv_label);
     if (pub_attrs != NULL)
         free(pub_attrs);
     if (priv_attrs != NULL)
         free(priv_attrs);
 
-    free_attributes(secret_attrs, num_secret_attrs);
-    free_attributes(public_attrs, num_public_attrs);
-    free_attributes(private_attrs, num_private_attrs);
+    return rc;
+}
+
+static CK_RV perform_key_job(struct p11sak_key_job *job,
+                             CK_SESSION_HANDLE session)
+{
+    const struct p11sak_objtype *keytype = job->keytype;
+    CK_OBJECT_HANDLE pub_key, priv_key, key;
+    struct timespec start, end;
+    CK_RV rc;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (job->import)
+        rc = pkcs11_funcs->C_CreateObject(session, job->attrs, job->num_attrs,
+                                          &key);
+    else if (keytype->is_asymmetric)
+        rc = pkcs11_funcs->C_GenerateKeyPair(session,
+                                             (CK_MECHANISM *)&keytype->keygen_mech,
+                                             job->attrs, job->num_attrs,
+                                             job->priv_attrs,
+                                             job->num_priv_attrs,
+                                             &pub_key, &priv_key);
+    else
+        rc = pkcs11_funcs->C_GenerateKey(session,
+                                         (CK_MECHANISM *)&keytype->keygen_mech,
+                                         job->attrs, job->num_attrs, &key);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->elapsed = (end.tv_sec - start.tv_sec) +
+                   (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    job->rc = rc;
+    job->done = true;
+
+    if (rc == CKR_OK)
+        return CKR_OK;
+
+    if (job->import) {
+        if (is_rejected_by_policy(rc, session))
+            warnx("Key import of a %s key is rejected by policy",
+                  keytype->name);
+        else
+            warnx("Key import of a %s key failed: 0x%lX: %s", keytype->name,
+                  rc, p11_get_ckr(rc));
+    } else if (is_rejected_by_policy(rc, session)) {
+        if (job->keysize == 0)
+            warnx("Key generation of a %s key is rejected by policy",
+                  keytype->name);
+        else
+            warnx("Key generation of a %s key of size %lu is rejected by policy",
+                  keytype->name, job->keysize);
+    } else {
+        if (job->keysize == 0)
+            warnx("Key generation of a %s key failed: 0x%lX: %s",
+                  keytype->name, rc, p11_get_ckr(rc));
+        else
+            warnx("Key generation of a %s key of size %lu failed: 0x%lX: %s",
+                  keytype->name, job->keysize, rc, p11_get_ckr(rc));
+    }
+
+    return rc;
+}
+
+static void print_key_job_result(const struct p11sak_key_job *job)
+{
+    if (job->import)
+        printf("Successfully imported a %s key with label \"%s\".\n",
+               job->keytype->name, job->label);
+    else if (job->keytype->is_asymmetric)
+        printf("Successfully generated a %s key pair with labels \"%s\":\"%s\".\n",
+               job->keytype->name, job->pub_label, job->priv_label);
+    else
+        printf("Successfully generated a %s key with label \"%s\".\n",
+               job->keytype->name, job->label);
+}
+
+static void free_key_job(struct p11sak_key_job *job)
+{
+    if (job->label != NULL)
+        free(job->label);
+    if (job->pub_label != NULL)
+        free(job->pub_label);
+    if (job->priv_label != NULL)
+        free(job->priv_label);
+
+    free_attributes(job->attrs, job->num_attrs);
+    free_attributes(job->priv_attrs, job->num_priv_attrs);
+
+    memset(job, 0, sizeof(*job));
+}
+
+static CK_RV p11sak_generate_key(void)
+{
+    struct p11sak_key_job job = { 0 };
+    CK_RV rc;
+
+    rc = prepare_generate_key(&job);
+    if (rc != CKR_OK)
+        goto done;
+
+    rc = perform_key_job(&job, pkcs11_session);
+    if (rc != CKR_OK)
+        goto done;
+
+    print_key_job_result(&job);
+
+done:
+    free_key_job(&job);
 
     return rc;
 }
@@ -5834,24 +6009,17 @@ static void print_obj_attrs(CK_OBJECT_HANDLE key, CK_OBJECT_CLASS class,
     print_custom_attrs(key, attrs, indent);
 }
 
-static CK_RV print_boolean_attrs(CK_OBJECT_HANDLE obj, CK_OBJECT_CLASS class,
-                                 const struct p11sak_objtype *objtype,
-                                 const char *typestr, const char* label,
-                                 struct p11sak_list_data *data)
+/*
+ * Prints the boolean attributes already retrieved into data->bool_attrs by
+ * handle_obj_list().
+ */
+static void print_boolean_attrs(CK_OBJECT_CLASS class,
+                                const struct p11sak_objtype *objtype,
+                                struct p11sak_list_data *data)
 {
     const struct p11sak_attr *attr;
     bool applicable;
     CK_ULONG i;
-    CK_RV rc;
-
-    rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, obj,
-                                           data->bool_attrs,
-                                           data->num_bool_attrs);
-    if (rc != CKR_OK && rc != CKR_ATTRIBUTE_TYPE_INVALID) {
-        warnx("Failed to get boolean attributes for %s %s \"%s\": 0x%lX: %s",
-              typestr, objtype->obj_typestr, label, rc, p11_get_ckr(rc));
-        return rc;
-    }
 
     for (attr = data->attrs, i = 0; attr->name != NULL; attr++, i++) {
         switch (class) {
@@ -5884,8 +6052,6 @@ static CK_RV print_boolean_attrs(CK_OBJECT_HANDLE obj, CK_OBJECT_CLASS class,
             attr->print_short(&data->bool_attrs[i], applicable);
         }
     }
-
-    return CKR_OK;
 }
 
 static CK_RV prepare_uri(CK_OBJECT_HANDLE key, CK_OBJECT_CLASS *class,
@@ -6213,9 +6379,7 @@ static CK_RV handle_obj_list(CK_OBJECT_HANDLE key, CK_OBJECT_CLASS class,
                             token_info->mktype_cell_size), "-");
         printf(" ");
     } else {
-        rc = print_boolean_attrs(key, class, objtype, typestr, label, data);
-        if (rc != CKR_OK)
-            goto done;
+        print_boolean_attrs(class, objtype, data);
     }
 
     if (opt_long)
@@ -6252,49 +6416,35 @@ done:
     return rc;
 }
 
-static CK_RV p11sak_list_obj_compare(CK_OBJECT_HANDLE obj1,
-                                     CK_OBJECT_HANDLE obj2,
+static CK_RV p11sak_list_obj_compare(const struct p11sak_obj_info *info1,
+                                     const struct p11sak_obj_info *info2,
                                      int *result, void *private)
 {
     struct p11sak_list_data *data = private;
-    CK_OBJECT_CLASS class1, class2;
-    CK_KEY_TYPE ktype1, ktype2;
-    CK_ULONG keysize1 = 0, keysize2 = 0;
-    char *label1 = NULL, *label2 = NULL;
-    char *cn1 = NULL, *cn2 = NULL;
-    CK_RV rc;
     int i;
 
     *result = 0;
 
-    rc = get_obj_infos(obj1, &class1, &ktype1, &keysize1, &label1, NULL, NULL, &cn1);
-    if (rc != CKR_OK)
-        goto done;
-
-    rc = get_obj_infos(obj2, &class2, &ktype2, &keysize2, &label2, NULL, NULL, &cn2);
-    if (rc != CKR_OK)
-        goto done;
-
     for (i = 0; i < MAX_SORT_FIELDS; i++) {
         switch (data->sort_info[i].field) {
         case SORT_LABEL:
-            if (label1 == NULL || label2 == NULL)
+            if (info1->label == NULL || info2->label == NULL)
                 break;
-            *result = strcmp(label1, label2);
+            *result = strcmp(info1->label, info2->label);
             break;
         case SORT_KEYTYPE:
-            *result = (long)ktype1 - (long)ktype2;
+            *result = (long)info1->otype - (long)info2->otype;
             break;
         case SORT_CLASS:
-            *result = (long)class1 - (long)class2;
+            *result = (long)info1->class - (long)info2->class;
             break;
         case SORT_KEYSIZE:
-            *result = (long)keysize1 - (long)keysize2;
+            *result = (long)info1->keysize - (long)info2->keysize;
             break;
         case SORT_CN:
-            if (cn1 == NULL || cn2 == NULL)
+            if (info1->common_name == NULL || info2->common_name == NULL)
                 break;
-            *result = strcmp(cn1, cn2);
+            *result = strcmp(info1->common_name, info2->common_name);
             break;
         case SORT_NONE:
         default:
@@ -6308,17 +6458,7 @@ static CK_RV p11sak_list_obj_compare(CK_OBJECT_HANDLE obj1,
             break;
     }
 
-done:
-    if (label1 != NULL)
-        free(label1);
-    if (label2 != NULL)
-        free(label2);
-    if (cn1 != NULL)
-        free(cn1);
-    if (cn2 != NULL)
-        free(cn2);
-
-    return rc;
+    return CKR_OK;
 }
 
 static CK_RV parse_sort_specification(const char *sort_spec,
@@ -6503,7 +6643,7 @@ static CK_RV p11sak_list_key(void)
     }
 
     rc = iterate_objects(keytype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_KEY,
+                         OBJCLASS_KEY, true,
                          opt_sort != NULL ? p11sak_list_obj_compare : NULL,
                          handle_obj_list, &data);
     if (rc != CKR_OK) {
@@ -6575,7 +6715,7 @@ static CK_RV p11sak_list_cert(void)
     }
 
     rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE,
+                         OBJCLASS_CERTIFICATE, true,
                          opt_sort != NULL ? p11sak_list_obj_compare : NULL,
                          handle_obj_list, &data);
     if (rc != CKR_OK) {
@@ -6697,7 +6837,7 @@ static CK_RV p11sak_remove_key(void)
     data.remove_all = opt_force;
 
     rc = iterate_objects(keytype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_KEY, NULL,
+                         OBJCLASS_KEY, false, NULL,
                          handle_obj_remove, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over key objects for key type %s: 0x%lX: %s",
@@ -6726,7 +6866,7 @@ static CK_RV p11sak_remove_cert(void)
     data.remove_all = opt_force;
 
     rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE, NULL,
+                         OBJCLASS_CERTIFICATE, false, NULL,
                          handle_obj_remove, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over certificate objects for type %s: 0x%lX: %s",
@@ -6882,7 +7022,7 @@ static CK_RV p11sak_set_key_attr(void)
     data.set_all = opt_force;
 
     rc = iterate_objects(keytype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_KEY, NULL,
+                         OBJCLASS_KEY, false, NULL,
                          handle_obj_set_attr, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over key objects for key type %s: 0x%lX: %s",
@@ -6917,7 +7057,7 @@ static CK_RV p11sak_set_cert_attr(void)
     data.set_all = opt_force;
 
     rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE, NULL,
+                         OBJCLASS_CERTIFICATE, false, NULL,
                          handle_obj_set_attr, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over certificate objects for cert type %s: 0x%lX: %s",
@@ -7064,7 +7204,7 @@ static CK_RV p11sak_copy_key(void)
     data.copy_all = opt_force;
 
     rc = iterate_objects(keytype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_KEY, NULL,
+                         OBJCLASS_KEY, false, NULL,
                          handle_obj_copy, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over key objects for key type %s: 0x%lX: %s",
@@ -7093,7 +7233,7 @@ static CK_RV p11sak_copy_cert(void)
     data.copy_all = opt_force;
 
     rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE, NULL,
+                         OBJCLASS_CERTIFICATE, false, NULL,
                          handle_obj_copy, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over certificate objects for type %s: 0x%lX: %s",
@@ -8655,19 +8795,18 @@ static CK_RV p11sak_import_sym_key(const struct p11sak_objtype *keytype,
     return rc;
 }
 
-static CK_RV p11sak_import_key(void)
+static CK_RV prepare_import_key(struct p11sak_key_job *job)
 {
     const struct p11sak_objtype *keytype;
-    CK_ATTRIBUTE *attrs = NULL;
-    CK_ULONG num_attrs = 0;
     CK_OBJECT_CLASS class;
-    CK_OBJECT_HANDLE key;
     CK_RV rc;
 
     if (opt_keytype == NULL || opt_keytype->private.ptr == NULL)
         return CKR_ARGUMENTS_BAD;
 
     keytype = opt_keytype->private.ptr;
+    job->keytype = keytype;
+    job->import = true;
 
     if (opt_oqsprovider_pem && !keytype->supports_oqsprovider_pem) {
         warnx("Option '--oqsprovider-pem' is not supported for keytype '%s'.",
@@ -8675,19 +8814,26 @@ static CK_RV p11sak_import_key(void)
         return CKR_ARGUMENTS_BAD;
     }
 
+    job->label = strdup(opt_label);
+    if (job->label == NULL) {
+        warnx("Failed to allocate memory for the key label");
+        return CKR_HOST_MEMORY;
+    }
+
     class = keytype->is_asymmetric ?
             (opt_asym_kind->private.num ? CKO_PRIVATE_KEY : CKO_PUBLIC_KEY) :
             CKO_SECRET_KEY;
-    rc = add_attribute(CKA_CLASS, &class, sizeof(class), &attrs, &num_attrs);
+    rc = add_attribute(CKA_CLASS, &class, sizeof(class),
+                       &job->attrs, &job->num_attrs);
     if (rc != CKR_OK)
-        goto done;
+        return rc;
 
     rc = add_attribute(CKA_KEY_TYPE, &keytype->type, sizeof(keytype->type),
-                       &attrs, &num_attrs);
+                       &job->attrs, &job->num_attrs);
     if (rc != CKR_OK)
-        goto done;
+        return rc;
 
-    rc = add_attributes(keytype, &attrs, &num_attrs,
+    rc = add_attributes(keytype, &job->attrs, &job->num_attrs,
                         opt_label, opt_attr, opt_id,
                         !keytype->is_asymmetric ||
                         (keytype->is_asymmetric && opt_asym_kind->private.num),
@@ -8698,32 +8844,362 @@ static CK_RV p11sak_import_key(void)
                                         public_attr_applicable) :
                                 secret_attr_applicable);
     if (rc != CKR_OK)
-        goto done;
+        return rc;
 
     if (opt_opaque)
-        rc = p11sak_import_opaque_key(keytype, &attrs, &num_attrs);
+        rc = p11sak_import_opaque_key(keytype, &job->attrs, &job->num_attrs);
     else if (keytype->is_asymmetric)
-        rc = p11sak_import_asym_key(keytype, &attrs, &num_attrs);
+        rc = p11sak_import_asym_key(keytype, &job->attrs, &job->num_attrs);
     else
-        rc = p11sak_import_sym_key(keytype, &attrs, &num_attrs);
+        rc = p11sak_import_sym_key(keytype, &job->attrs, &job->num_attrs);
+    if (rc != CKR_OK)
+        return rc;
+
+    job->prepared = true;
+
+    return CKR_OK;
+}
+
+static CK_RV p11sak_import_key(void)
+{
+    struct p11sak_key_job job = { 0 };
+    CK_RV rc;
+
+    rc = prepare_import_key(&job);
+    if (rc != CKR_OK)
+        goto done;
+
+    rc = perform_key_job(&job, pkcs11_session);
     if (rc != CKR_OK)
         goto done;
 
-    rc = pkcs11_funcs->C_CreateObject(pkcs11_session, attrs, num_attrs, &key);
+    print_key_job_result(&job);
+
+done:
+    free_key_job(&job);
+
+    return rc;
+}
+
+static void reset_key_job_opts(void)
+{
+    opt_help = false;
+    opt_version = false;
+    opt_keytype = NULL;
+    opt_keybits_num = 0;
+    opt_keybits = NULL;
+    opt_group = NULL;
+    opt_pem_file = NULL;
+    opt_curve = NULL;
+    opt_pqc_version = NULL;
+    opt_label = NULL;
+    opt_exponent = 0;
+    opt_attr = NULL;
+    opt_id = NULL;
+    opt_file = NULL;
+    opt_pem_password = NULL;
+    opt_force_pem_pwd_prompt = false;
+    opt_opaque = false;
+    opt_asym_kind = NULL;
+    opt_oqsprovider_pem = false;
+}
+
+/*
+ * Splits a manifest line into its arguments. The line is modified in place,
+ * quotes are removed. Returns the number of arguments, or -1 on error.
+ */
+static int split_manifest_line(char *line, char *argv[], int max_args)
+{
+    char *p = line, *out, quote;
+    int argc = 0;
+
+    while (1) {
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0' || (argc == 0 && *p == '#'))
+            break;
+
+        if (argc >= max_args)
+            return -1;
+
+        argv[argc++] = out = p;
+        quote = 0;
+        while (*p != '\0') {
+            if (quote != 0 && *p == quote) {
+                quote = 0;
+                p++;
+                continue;
+            }
+            if (quote == 0 && (*p == '"' || *p == '\'')) {
+                quote = *p++;
+                continue;
+            }
+            if (quote == 0 && isspace((unsigned char)*p)) {
+                p++;
+                break;
+            }
+            *out++ = *p++;
+        }
+        if (quote != 0)
+            return -1;
+        *out = '\0';
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+static CK_RV prepare_manifest_line(int argc, char *argv[],
+                                   struct p11sak_key_job *job)
+{
+    const struct p11sak_cmd *cmd;
+    CK_SLOT_ID slot = opt_slot;
+    char *pin = opt_pin;
+    bool force_pin_prompt = opt_force_pin_prompt;
+    bool no_login = opt_no_login, so = opt_so;
+    CK_RV rc;
+
+    cmd = find_command(argv[0]);
+    if (cmd == NULL ||
+        (cmd->func != p11sak_generate_key && cmd->func != p11sak_import_key)) {
+        warnx("Invalid command '%s', only commands 'generate-key' and "
+              "'import-key' are allowed", argv[0]);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    reset_key_job_opts();
+
+    rc = parse_cmd_arguments(cmd, &argc, &argv);
+    if (rc != CKR_OK)
+        return rc;
+
+#ifdef LINUX
+    optind = 0; /* Force a full re-initialization of getopt_long */
+#else
+    optind = 1;
+#endif
+    rc = parse_cmd_options(cmd, argc, argv);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (opt_slot != slot || opt_pin != pin ||
+        opt_force_pin_prompt != force_pin_prompt ||
+        opt_no_login != no_login || opt_so != so) {
+        warnx("The slot, PIN and login options are not allowed in a "
+              "manifest");
+        opt_slot = slot;
+        opt_pin = pin;
+        opt_force_pin_prompt = force_pin_prompt;
+        opt_no_login = no_login;
+        opt_so = so;
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    rc = check_required_args(cmd->args);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = check_required_cmd_opts(cmd->opts);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (cmd->func == p11sak_generate_key)
+        return prepare_generate_key(job);
+    else
+        return prepare_import_key(job);
+}
+
+static struct p11sak_key_job *batch_next_job(struct p11sak_batch_data *data)
+{
+    struct p11sak_key_job *job = NULL;
+
+    pthread_mutex_lock(&data->mutex);
+    while (data->next_job < data->num_jobs) {
+        job = &data->jobs[data->next_job++];
+        if (job->prepared)
+            break;
+        job = NULL;
+    }
+    pthread_mutex_unlock(&data->mutex);
+
+    return job;
+}
+
+static void batch_run_jobs(struct p11sak_batch_data *data,
+                           CK_SESSION_HANDLE session)
+{
+    struct p11sak_key_job *job;
+
+    while ((job = batch_next_job(data)) != NULL)
+        perform_key_job(job, session);
+}
+
+static void *batch_key_thread(void *arg)
+{
+    struct p11sak_batch_data *data = arg;
+    CK_SESSION_HANDLE session;
+    CK_RV rc;
+
+    rc = pkcs11_funcs->C_OpenSession(opt_slot, data->session_flags, NULL,
+                                     NULL, &session);
     if (rc != CKR_OK) {
-       if (is_rejected_by_policy(rc, pkcs11_session))
-           warnx("Key import of a %s key is rejected by policy", keytype->name);
-       else
-           warnx("Key import of a %s key failed: 0x%lX: %s", keytype->name,
-                 rc, p11_get_ckr(rc));
-       goto done;
+        warnx("Opening a session failed: C_OpenSession: 0x%lX: %s", rc,
+              p11_get_ckr(rc));
+        return NULL;
     }
 
-    printf("Successfully imported a %s key with label \"%s\".\n",
-           keytype->name, opt_label);
+    batch_run_jobs(data, session);
+
+    rc = pkcs11_funcs->C_CloseSession(session);
+    if (rc != CKR_OK)
+        warnx("C_CloseSession failed: 0x%lX: %s", rc, p11_get_ckr(rc));
+
+    return NULL;
+}
+
+static CK_RV p11sak_batch_key(void)
+{
+    struct p11sak_batch_data data = { 0 };
+    struct p11sak_key_job *job, *tmp;
+    pthread_t threads[BATCH_MAX_THREADS];
+    char *argv[BATCH_MAX_LINE_ARGS + 1];
+    unsigned long num_threads, num_started = 0, max_jobs = 0, i;
+    unsigned long line_no = 0, num_ok = 0, num_failed = 0;
+    struct timespec start, end;
+    char *line = NULL;
+    size_t line_size = 0;
+    double elapsed;
+    FILE *fp;
+    int argc, ret;
+    CK_RV rc = CKR_OK;
+
+    num_threads = opt_threads != 0 ? opt_threads : 1;
+    if (num_threads > BATCH_MAX_THREADS) {
+        warnx("The number of threads must not exceed %u",
+              BATCH_MAX_THREADS);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (strcmp(opt_manifest, "-") == 0)
+        fp = stdin;
+    else
+        fp = fopen(opt_manifest, "r");
+    if (fp == NULL) {
+        warnx("Failed to open manifest file '%s': %s", opt_manifest,
+              strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    while (getline(&line, &line_size, fp) != -1) {
+        line_no++;
+
+        argc = split_manifest_line(line, argv, BATCH_MAX_LINE_ARGS);
+        if (argc == 0)
+            continue;
+
+        if (data.num_jobs >= max_jobs) {
+            tmp = realloc(data.jobs, (max_jobs + 64) * sizeof(*data.jobs));
+            if (tmp == NULL) {
+                warnx("Failed to allocate memory for the key list");
+                rc = CKR_HOST_MEMORY;
+                goto done;
+            }
+            data.jobs = tmp;
+            max_jobs += 64;
+        }
+
+        job = &data.jobs[data.num_jobs++];
+        memset(job, 0, sizeof(*job));
+        job->line = line_no;
+
+        if (argc < 0) {
+            warnx("Line %lu of manifest '%s' is malformed", line_no,
+                  opt_manifest);
+            job->rc = CKR_ARGUMENTS_BAD;
+            continue;
+        }
+
+        job->rc = prepare_manifest_line(argc, argv, job);
+        if (job->rc != CKR_OK)
+            warnx("Line %lu of manifest '%s' is skipped", line_no,
+                  opt_manifest);
+    }
+
+    if (data.num_jobs == 0) {
+        warnx("No keys found in manifest '%s'", opt_manifest);
+        goto done;
+    }
+
+    if (num_threads > data.num_jobs)
+        num_threads = data.num_jobs;
+
+    pthread_mutex_init(&data.mutex, NULL);
+    data.session_flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* The main thread uses the already opened session */
+    for (i = 1; i < num_threads; i++) {
+        ret = pthread_create(&threads[num_started], NULL, batch_key_thread,
+                             &data);
+        if (ret != 0) {
+            warnx("Failed to create thread: %s", strerror(ret));
+            break;
+        }
+        num_started++;
+    }
+
+    batch_run_jobs(&data, pkcs11_session);
+
+    for (i = 0; i < num_started; i++)
+        pthread_join(threads[i], NULL);
+
+    /* Process jobs left over by threads that failed to open a session */
+    for (i = 0; i < data.num_jobs; i++) {
+        if (data.jobs[i].prepared && !data.jobs[i].done)
+            perform_key_job(&data.jobs[i], pkcs11_session);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) +
+              (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    pthread_mutex_destroy(&data.mutex);
+
+    for (i = 0; i < data.num_jobs; i++) {
+        job = &data.jobs[i];
+
+        if (job->done)
+            printf("Line %lu [%.3f s]: ", job->line, job->elapsed);
+        else
+            printf("Line %lu: ", job->line);
+        if (job->rc != CKR_OK) {
+            printf("Failed: 0x%lX: %s\n", job->rc, p11_get_ckr(job->rc));
+            if (rc == CKR_OK)
+                rc = job->rc;
+            num_failed++;
+            continue;
+        }
+
+        print_key_job_result(job);
+        num_ok++;
+    }
+
+    printf("Processed %lu keys (%lu successful, %lu failed) in %.3f seconds "
+           "using %lu thread(s): %.1f keys per second.\n", data.num_jobs,
+           num_ok, num_failed, elapsed, num_threads,
+           elapsed > 0 ? num_ok / elapsed : 0.0);
 
 done:
-    free_attributes(attrs, num_attrs);
+    if (fp != stdin)
+        fclose(fp);
+    if (line != NULL)
+        free(line);
+
+    for (i = 0; i < data.num_jobs; i++)
+        free_key_job(&data.jobs[i]);
+    if (data.jobs != NULL)
+        free(data.jobs);
 
     return rc;
 }
@@ -11129,7 +11605,7 @@ static CK_RV p11sak_export_key(void)
     }
 
     rc = iterate_objects(keytype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_KEY, NULL,
+                         OBJCLASS_KEY, false, NULL,
                          handle_key_export, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over key objects for key type %s: 0x%lX: %s",
@@ -11164,7 +11640,7 @@ static CK_RV p11sak_extract_key_pubkey(void)
     data.export_all = opt_force;
 
     rc = iterate_objects(keytype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_KEY, NULL,
+                         OBJCLASS_KEY, false, NULL,
                          handle_key_pubkey_extract, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over key objects for type %s: 0x%lX: %s",
@@ -11229,7 +11705,7 @@ static CK_RV p11sak_export_cert(void)
     }
 
     rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE, NULL,
+                         OBJCLASS_CERTIFICATE, false, NULL,
                          handle_cert_export, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over certificate objects for type %s: 0x%lX: %s",
@@ -11353,7 +11829,7 @@ static CK_RV p11sak_extract_cert_pubkey(void)
     data.export_all = opt_force;
 
     rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE, NULL,
+                         OBJCLASS_CERTIFICATE, false, NULL,
                          handle_cert_pubkey_extract, &data);
     if (rc != CKR_OK) {
         warnx("Failed to iterate over certificate objects for type %s: 0x%lX: %s",
@@ -11475,6 +11951,7 @@ static CK_RV init_pkcs11(const struct p11sak_cmd *command)
     CK_RV rc;
     char *buf_user_pin = NULL;
     const char *pin = opt_pin;
+    CK_C_INITIALIZE_ARGS init_args = { .flags = CKF_OS_LOCKING_OK };
 
     if (command == NULL || command->session_flags == 0)
         return CKR_OK;
@@ -11518,7 +11995,8 @@ static CK_RV init_pkcs11(const struct p11sak_cmd *command)
     if (rc != CKR_OK)
         goto done;
 
-    rc = pkcs11_funcs->C_Initialize(NULL);
+    /* The batch-key command uses multiple threads */
+    rc = pkcs11_funcs->C_Initialize(&init_args);
     if (rc != CKR_OK) {
         warnx("C_Initialize failed: 0x%lX: %s", rc, p11_get_ckr(rc));
         goto done;
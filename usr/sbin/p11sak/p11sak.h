@@ -11,6 +11,8 @@
 #ifndef P11SAK_H_
 #define P11SAK_H_
 
+#include <pthread.h>
+
 #include "pkcs11types.h"
 #include "ec_curves.h"
 
@@ -47,6 +49,7 @@
 #define PRINT_INDENT_POS        35
 
 #define FIND_OBJECTS_COUNT      64
+#define OBJ_LABEL_BUFFER_SIZE   256
 #define LIST_KEYTYPE_CELL_SIZE  22
 #define LIST_MKVP_MIN_CELL_SIZE 32
 #define LIST_MKTYPE_MIN_CELL_SIZE 8
@@ -55,6 +58,9 @@
 
 #define MAX_SYM_CLEAR_KEY_SIZE  64
 
+#define BATCH_MAX_THREADS       256
+#define BATCH_MAX_LINE_ARGS     64
+
 #define PKCS11_URI_PEM_NAME     "PKCS#11 PROVIDER URI"
 #define PKCS11_URI_DESCRIPTION  "PKCS#11 Provider URI v1.0"
 
@@ -212,9 +218,23 @@ struct p11sak_custom_attr_type {
                        int indent, bool sensitive);
 };
 
+#define OBJ_KEYSIZE_ATTRS       3
+
+struct p11sak_obj_info {
+    CK_OBJECT_HANDLE obj;
+    CK_OBJECT_CLASS class;
+    CK_ULONG otype;
+    CK_ULONG keysize;
+    CK_ULONG keysize_vals[OBJ_KEYSIZE_ATTRS]; // see get_obj_basic_infos()
+    const struct p11sak_objtype *objtype;
+    char *label;
+    char *typestr;
+    char *common_name;
+};
+
 struct p11sak_iterate_compare_data {
-    CK_RV (*compare_obj)(CK_OBJECT_HANDLE obj1,
-                         CK_OBJECT_HANDLE obj2,
+    CK_RV (*compare_obj)(const struct p11sak_obj_info *info1,
+                         const struct p11sak_obj_info *info2,
                          int *result,
                          void *private);
     void *private;
@@ -285,6 +305,32 @@ struct p11sak_export_data {
     bool last_was_binary;
 };
 
+struct p11sak_key_job {
+    unsigned long line;
+    bool import;
+    const struct p11sak_objtype *keytype;
+    CK_ULONG keysize;
+    char *label;
+    char *pub_label;
+    char *priv_label;
+    CK_ATTRIBUTE *attrs;
+    CK_ULONG num_attrs;
+    CK_ATTRIBUTE *priv_attrs;
+    CK_ULONG num_priv_attrs;
+    bool prepared;
+    bool done;
+    CK_RV rc;
+    double elapsed;
+};
+
+struct p11sak_batch_data {
+    struct p11sak_key_job *jobs;
+    unsigned long num_jobs;
+    unsigned long next_job;
+    pthread_mutex_t mutex;
+    CK_FLAGS session_flags;
+};
+
 struct curve_info {
     const CK_BYTE *oid;
     CK_ULONG oid_len;
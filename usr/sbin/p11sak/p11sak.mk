@@ -3,7 +3,7 @@ noinst_HEADERS += usr/sbin/p11sak/p11sak.h
 
 EXTRA_DIST += usr/sbin/p11sak/p11sak_defined_attrs.conf
 
-usr_sbin_p11sak_p11sak_LDFLAGS = -ldl -lcrypto
+usr_sbin_p11sak_p11sak_LDFLAGS = -ldl -lcrypto -lpthread
 
 if AIX
 usr_sbin_p11sak_p11sak_LDFLAGS += -Wl,-blibpath:$(libdir)/opencryptoki:$(libdir)/opencryptoki/stdll:/usr/lib:/usr/lib64
@@ -47,6 +47,8 @@ usr_sbin_pkcscca_pkcscca_SOURCES = usr/lib/common/asn1.c		\
 	usr/lib/common/pin_prompt.c usr/lib/common/mech_openssl.c	\
 	usr/lib/api/policyhelper.c usr/lib/common/pqc_supported.c	\
 	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
+	usr/lib/common/slab.c usr/lib/common/obj_cache.c		\
+	usr/lib/common/login_cache.c					\
 	usr/lib/common/mech_pqc.c
 
 nodist_usr_sbin_pkcscca_pkcscca_SOURCES = usr/lib/api/mechtable.c
@@ -22,6 +22,8 @@
 #include <dlfcn.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "pkcs11types.h"
 #include "p11util.h"
@@ -44,6 +46,8 @@
 #define CCA_MKVP_LENGTH             8
 #define EP11_WKVP_LENGTH            16
 
+#define PROGRESS_INTERVAL           5   /* seconds */
+
 #define UNUSED(var)            ((void)(var))
 
 pkcs_trace_level_t trace_level = TRACE_LEVEL_NONE;
@@ -71,6 +75,7 @@ struct token_info {
     CK_TOKEN_INFO info;
     bool affected;
     CK_SESSION_HANDLE session;
+    unsigned int progress_done;
 };
 
 CK_ULONG num_affected_slots = 0;
@@ -655,6 +660,57 @@ static void logout_tokens(void)
     }
 }
 
+struct progress_data {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stop;
+};
+
+static void show_progress(void)
+{
+    struct hsm_mk_change_progress progress;
+    unsigned int i;
+    CK_RV rv;
+
+    for (i = 0; i < num_tokens; i++) {
+        if (tokens[i].affected == false)
+            continue;
+
+        rv = hsm_mk_change_lock(false);
+        if (rv != CKR_OK)
+            return;
+
+        rv = hsm_mk_change_progress_load(op.id, tokens[i].id, &progress);
+
+        hsm_mk_change_unlock();
+
+        if (rv != CKR_OK || progress.done == tokens[i].progress_done)
+            continue;
+
+        printf("Slot %lu: %u of %u token objects processed\n",
+               tokens[i].id, progress.done, progress.total);
+        tokens[i].progress_done = progress.done;
+    }
+}
+
+static void *progress_thread(void *arg)
+{
+    struct progress_data *pd = arg;
+    struct timespec ts;
+
+    pthread_mutex_lock(&pd->mutex);
+    while (pd->stop == false) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += PROGRESS_INTERVAL;
+        pthread_cond_timedwait(&pd->cond, &pd->mutex, &ts);
+        if (pd->stop == false)
+            show_progress();
+    }
+    pthread_mutex_unlock(&pd->mutex);
+
+    return NULL;
+}
+
 static int reencipher_tokens(void)
 {
     size_t payload_len;
@@ -662,6 +718,9 @@ static int reencipher_tokens(void)
     event_mk_change_data_t *hdr;
     struct event_destination dest;
     struct event_reply reply;
+    struct progress_data pd;
+    pthread_t thread;
+    bool progress_started = false;
     int rc = 0;
 
     rc = build_event_payload(&payload, &payload_len);
@@ -712,9 +771,33 @@ static int reencipher_tokens(void)
 
     memset(&reply, 0, sizeof(reply));
 
+    /* Report the progress of the tokens while they re-encipher */
+    memset(&pd, 0, sizeof(pd));
+    if (pthread_mutex_init(&pd.mutex, NULL) == 0) {
+        if (pthread_cond_init(&pd.cond, NULL) == 0) {
+            if (pthread_create(&thread, NULL, progress_thread, &pd) == 0)
+                progress_started = true;
+            else
+                pthread_cond_destroy(&pd.cond);
+        }
+        if (progress_started == false)
+            pthread_mutex_destroy(&pd.mutex);
+    }
+
     rc = send_event(event_fd, EVENT_TYPE_MK_CHANGE_REENCIPHER,
                     EVENT_FLAGS_REPLY_REQ, payload_len, (char *)payload,
                     &dest, &reply);
+
+    if (progress_started) {
+        pthread_mutex_lock(&pd.mutex);
+        pd.stop = true;
+        pthread_cond_signal(&pd.cond);
+        pthread_mutex_unlock(&pd.mutex);
+        pthread_join(thread, NULL);
+        pthread_cond_destroy(&pd.cond);
+        pthread_mutex_destroy(&pd.mutex);
+    }
+
     if (rc != 0) {
         warnx("Failed to send event: %d", rc);
         rc = EIO;
@@ -1161,6 +1244,7 @@ static CK_RV perform_list_cb(struct hsm_mk_change_op *op, void *private)
     int *first = private;
     struct hsm_mkvp *mkvps = NULL;
     unsigned int num_mkvps = 0;
+    struct hsm_mk_change_progress progress;
     CK_RV rc;
 
     if (*first)
@@ -1237,6 +1321,12 @@ static CK_RV perform_list_cb(struct hsm_mk_change_op *op, void *private)
         }
         printf("\n");
 
+        if (op->state == HSM_MK_CH_STATE_REENCIPHERING &&
+            hsm_mk_change_progress_load(op->id, op->slots[i],
+                                        &progress) == CKR_OK)
+            printf("            Token objects processed: %u of %u\n",
+                   progress.done, progress.total);
+
         rc = hsm_mk_change_token_mkvps_load(op->id, op->slots[i],
                                             &mkvps, &num_mkvps);
         if (rc == CKR_OK && num_mkvps > 0) {
@@ -1,6 +1,6 @@
 sbin_PROGRAMS += usr/sbin/pkcshsm_mk_change/pkcshsm_mk_change
 
-usr_sbin_pkcshsm_mk_change_pkcshsm_mk_change_LDFLAGS = -lcrypto -ldl -lrt
+usr_sbin_pkcshsm_mk_change_pkcshsm_mk_change_LDFLAGS = -lcrypto -ldl -lrt -lpthread
 
 if AIX
 usr_sbin_pkcshsm_mk_change_pkcshsm_mk_change_LDFLAGS += -lbsd -Wl,-blibpath:$(libdir)/opencryptoki:$(libdir)/opencryptoki/stdll:/usr/lib:/usr/lib64
@@ -38,6 +38,7 @@ int Stat2Proc(int pid, proc_t *p);
 
 pthread_t GCThread;             /* Garbage Collection thread's handle */
 static BOOL ThreadRunning = FALSE;      /* If we're already running or not */
+static BOOL UntrackedProcesses = FALSE; /* Exit of a process not tracked */
 
 #if THREADED
 static void *GCMain(void *Ptr);
@@ -205,7 +206,8 @@ void *GCMain(void *Ptr)
 
 #endif
 
-        CheckForGarbage(MemPtr);
+        if (GCPeriodicScanRequired())
+            CheckForGarbage(MemPtr);
 
 #if THREADED
         /* re-enable cancellations */
@@ -255,6 +257,124 @@ void GCCancel(void *Ptr)
 
 
 
+/*****************************************************************************
+ * SubtractSessionCount -
+ *
+ *       The global session counters are updated by the processes with
+ *       atomic operations, without holding the XProcLock. Subtract the
+ *       count of a defunct process atomically as well, but not below zero.
+ *
+ ******************************************************************************/
+
+static void SubtractSessionCount(unsigned int *pGlobal, unsigned int Count)
+{
+    unsigned int Old, New;
+
+    do {
+        Old = __sync_fetch_and_add(pGlobal, 0);
+        New = (Count > Old) ? 0 : Old - Count;
+    } while (!__sync_bool_compare_and_swap(pGlobal, Old, New));
+}
+
+
+
+/*****************************************************************************
+ * ReleaseProcEntry -
+ *
+ *       Gives back the session counts held by a defunct process and frees
+ *       its process table entry. Must be called with the XProcLock held.
+ *
+ ******************************************************************************/
+
+static void ReleaseProcEntry(Slot_Mgr_Shr_t *MemPtr, Slot_Mgr_Proc_t_64 *pProc,
+                             int ProcIndex)
+{
+    int SlotIndex;
+
+    UNUSED(ProcIndex);
+
+#ifdef DEV
+    DbgLog(DL1, "Garbage collection routine found bad entry for pid "
+           "%d (Index: %d); removing from table",
+           pProc->proc_id, ProcIndex);
+#endif                          /* DEV */
+
+    /*                         */
+    /* Clean up session counts */
+    /*                         */
+    for (SlotIndex = 0; SlotIndex < NUMBER_SLOTS_MANAGED; SlotIndex++) {
+
+        unsigned int *pGlobalSessions =
+            &(MemPtr->slot_global_sessions[SlotIndex]);
+        unsigned int *pGlobalRWSessions =
+            &(MemPtr->slot_global_rw_sessions[SlotIndex]);
+        unsigned int *pGlobalTokspecCount =
+            &(MemPtr->slot_global_tokspec_count[SlotIndex]);
+        unsigned int *pProcSessions =
+            &(pProc->slot_session_count[SlotIndex]);
+        unsigned int *pProcRWSessions =
+            &(pProc->slot_rw_session_count[SlotIndex]);
+        unsigned int *pProcTokspecCount =
+            &(pProc->slot_tokspec_count[SlotIndex]);
+
+        if (*pProcSessions > 0) {
+
+#ifdef DEV
+            DbgLog(DL2, "GC: Invalid pid (%d) is holding %u sessions "
+                   "open on slot %d.  Global session count for this "
+                   "slot is %u",
+                   pProc->proc_id, *pProcSessions, SlotIndex,
+                   *pGlobalSessions);
+#endif                          /* DEV */
+
+            if (*pProcSessions > *pGlobalSessions) {
+#ifdef DEV
+                WarnLog("Garbage Collection: Illegal values in table "
+                        "for defunct process");
+                DbgLog(DL0, "Garbage collection: A process "
+                       "( Index: %d, pid: %d ) showed %u sessions "
+                       "open on slot %d, but the global count for this "
+                       "slot is only %u",
+                       ProcIndex, pProc->proc_id, *pProcSessions,
+                       SlotIndex, *pGlobalSessions);
+#endif                          /* DEV */
+            }
+
+            SubtractSessionCount(pGlobalSessions, *pProcSessions);
+            SubtractSessionCount(pGlobalRWSessions, *pProcRWSessions);
+
+            *pProcSessions = 0;
+            *pProcRWSessions = 0;
+
+        }
+        /* end if *pProcSessions */
+
+        if (*pGlobalTokspecCount > 0) {
+            if (*pProcTokspecCount > *pGlobalTokspecCount)
+                *pGlobalTokspecCount = 0;
+            else
+                *pGlobalTokspecCount -= *pProcTokspecCount;
+            *pProcTokspecCount = 0;
+        }
+    }                   /* end for SlotIndex */
+
+
+    /*                                      */
+    /* NULL out everything except the mutex */
+    /*                                      */
+
+    memset(&(pProc->inuse), '\0', sizeof(pProc->inuse));
+    memset(&(pProc->proc_id), '\0', sizeof(pProc->proc_id));
+    memset(&(pProc->slotmap), '\0', sizeof(pProc->slotmap));
+    memset(&(pProc->blocking), '\0', sizeof(pProc->blocking));
+    memset(&(pProc->error), '\0', sizeof(pProc->error));
+    memset(&(pProc->slot_session_count), '\0',
+           sizeof(pProc->slot_session_count));
+    memset(&(pProc->reg_time), '\0', sizeof(pProc->reg_time));
+}
+
+
+
 /*****************************************************************************
  * CheckForGarbage -
  *
@@ -264,7 +384,6 @@ void GCCancel(void *Ptr)
 
 BOOL CheckForGarbage(Slot_Mgr_Shr_t *MemPtr)
 {
-    int SlotIndex;
     int ProcIndex;
     int Err;
     BOOL ValidPid;
@@ -308,101 +427,105 @@ BOOL CheckForGarbage(Slot_Mgr_Shr_t *MemPtr)
                     && (pProc->proc_id != 0));
 
 
-        if ((pProc->inuse) && (!ValidPid)) {
+        if ((pProc->inuse) && (!ValidPid))
+            ReleaseProcEntry(MemPtr, pProc, ProcIndex);
+    }                           /* end for ProcIndex */
 
-#ifdef DEV
-            DbgLog(DL1, "Garbage collection routine found bad entry for pid "
-                   "%d (Index: %d); removing from table",
-                   pProc->proc_id, ProcIndex);
-#endif                          /* DEV */
+    XProcUnLock();
+    DbgLog(DL5, "Garbage collection: Released global shared memory lock");
 
-            /*                         */
-            /* Clean up session counts */
-            /*                         */
-            for (SlotIndex = 0; SlotIndex < NUMBER_SLOTS_MANAGED; SlotIndex++) {
-
-                unsigned int *pGlobalSessions =
-                    &(MemPtr->slot_global_sessions[SlotIndex]);
-                unsigned int *pGlobalRWSessions =
-                    &(MemPtr->slot_global_rw_sessions[SlotIndex]);
-                unsigned int *pGlobalTokspecCount =
-                    &(MemPtr->slot_global_tokspec_count[SlotIndex]);
-                unsigned int *pProcSessions =
-                    &(pProc->slot_session_count[SlotIndex]);
-                unsigned int *pProcRWSessions =
-                    &(pProc->slot_rw_session_count[SlotIndex]);
-                unsigned int *pProcTokspecCount =
-                    &(pProc->slot_tokspec_count[SlotIndex]);
-
-                if (*pProcSessions > 0) {
+    return TRUE;
+}
 
-#ifdef DEV
-                    DbgLog(DL2, "GC: Invalid pid (%d) is holding %u sessions "
-                           "open on slot %d.  Global session count for this "
-                           "slot is %u",
-                           pProc->proc_id, *pProcSessions, SlotIndex,
-                           *pGlobalSessions);
-#endif                          /* DEV */
 
-                    if (*pProcSessions > *pGlobalSessions) {
-#ifdef DEV
-                        WarnLog("Garbage Collection: Illegal values in table "
-                                "for defunct process");
-                        DbgLog(DL0, "Garbage collection: A process "
-                               "( Index: %d, pid: %d ) showed %u sessions "
-                               "open on slot %d, but the global count for this "
-                               "slot is only %u",
-                               ProcIndex, pProc->proc_id, *pProcSessions,
-                               SlotIndex, *pGlobalSessions);
-#endif                          /* DEV */
-                        *pGlobalSessions = 0;
-                        *pGlobalRWSessions = 0;
-                    } else {
-                        *pGlobalSessions -= *pProcSessions;
-                        *pGlobalRWSessions -= *pProcRWSessions;
-                    }
-
-                    *pProcSessions = 0;
-                    *pProcRWSessions = 0;
-
-                }
-                /* end if *pProcSessions */
-
-                if (*pGlobalTokspecCount > 0) {
-                    if (*pProcTokspecCount > *pGlobalTokspecCount)
-                        *pGlobalTokspecCount = 0;
-                    else
-                        *pGlobalTokspecCount -= *pProcTokspecCount;
-                    *pProcTokspecCount = 0;
-                }
-            }                   /* end for SlotIndex */
-
-
-            /*                                      */
-            /* NULL out everything except the mutex */
-            /*                                      */
-
-            memset(&(pProc->inuse), '\0', sizeof(pProc->inuse));
-            memset(&(pProc->proc_id), '\0', sizeof(pProc->proc_id));
-            memset(&(pProc->slotmap), '\0', sizeof(pProc->slotmap));
-            memset(&(pProc->blocking), '\0', sizeof(pProc->blocking));
-            memset(&(pProc->error), '\0', sizeof(pProc->error));
-            memset(&(pProc->slot_session_count), '\0',
-                   sizeof(pProc->slot_session_count));
-            memset(&(pProc->reg_time), '\0', sizeof(pProc->reg_time));
 
+/*****************************************************************************
+ * CheckForGarbageProcess -
+ *
+ *       Cleans up the process table entries of a single process that is
+ *       known to have exited (e.g. signalled via its pidfd). Only the
+ *       entries registered for that pid are checked, so /proc is not read
+ *       for any other process.
+ *
+ ******************************************************************************/
+
+BOOL CheckForGarbageProcess(Slot_Mgr_Shr_t *MemPtr, pid_t pid)
+{
+    int ProcIndex;
+    int Err;
+
+    ASSERT(MemPtr != NULL_PTR);
+
+    if (pid == 0)
+        return FALSE;
+
+    Err = XProcLock();
+    if (Err != TRUE) {
+        DbgLog(DL0, "Garbage collection: Locking attempt for global "
+               "shmem mutex returned %s",
+               SysConst(Err));
+        return FALSE;
+    }
+
+    for (ProcIndex = 0; ProcIndex < NUMBER_PROCESSES_ALLOWED; ProcIndex++) {
+
+        Slot_Mgr_Proc_t_64 *pProc = &(MemPtr->proc_table[ProcIndex]);
+
+        if (!(pProc->inuse) || pProc->proc_id != pid)
+            continue;
+
+        /*
+         * The pid may already have been reused by a new process that
+         * registered in the meantime, so still verify the entry.
+         */
+        if (!IsValidProcessEntry(pProc->proc_id, pProc->reg_time)) {
+            DbgLog(DL3, "Garbage collection: process %d exited, "
+                   "releasing entry %d", pid, ProcIndex);
+            ReleaseProcEntry(MemPtr, pProc, ProcIndex);
         }
-        /* end if inuse && ValidPid */
-    }                           /* end for ProcIndex */
+    }
 
     XProcUnLock();
-    DbgLog(DL5, "Garbage collection: Released global shared memory lock");
 
     return TRUE;
 }
 
 
 
+/*****************************************************************************
+ * GCUntrackedProcess -
+ *
+ *       Called when the exit of a connecting process can not be tracked
+ *       via a pidfd (e.g. the kernel does not support pidfd_open). From
+ *       then on, the periodic scan of the process table is used.
+ *
+ ******************************************************************************/
+
+void GCUntrackedProcess(void)
+{
+    if (!UntrackedProcesses)
+        InfoLog("Process exit tracking not available, using periodic "
+                "garbage collection");
+    UntrackedProcesses = TRUE;
+}
+
+
+
+/*****************************************************************************
+ * GCPeriodicScanRequired -
+ *
+ *       Returns TRUE if the process table must be scanned periodically,
+ *       because not all registered processes are tracked via a pidfd.
+ *
+ ******************************************************************************/
+
+BOOL GCPeriodicScanRequired(void)
+{
+    return UntrackedProcesses;
+}
+
+
+
 /******************************************************************************
  * Stat2Proc -
  *
@@ -562,6 +685,13 @@ BOOL IsValidProcessEntry(pid_t_64 pid, time_t_64 RegTime)
     if (!Stat2Proc((int) pid, p))
         return FALSE;
 
+    /* A zombie has already exited, it just was not yet reaped by its parent */
+    if (p->state == 'Z' || p->state == 'X') {
+        DbgLog(DL3, "IsValidProcessEntry: PID %lld has exited (state %c)",
+               pid, p->state);
+        return FALSE;
+    }
+
     if (p->pid == pid) {
         if (RegTime >= p->start_time) { // checking for matching start times
             return TRUE;
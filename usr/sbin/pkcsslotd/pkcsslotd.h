@@ -70,6 +70,9 @@ BOOL IsDaemon(void);
 BOOL StopGCThread(void *Ptr);
 BOOL StartGCThread(Slot_Mgr_Shr_t *MemPtr);
 BOOL CheckForGarbage(Slot_Mgr_Shr_t *MemPtr);
+BOOL CheckForGarbageProcess(Slot_Mgr_Shr_t *MemPtr, pid_t pid);
+void GCUntrackedProcess(void);
+BOOL GCPeriodicScanRequired(void);
 int InitializeMutexes(void);
 int DestroyMutexes(void);
 int CreateSharedMemory(void);
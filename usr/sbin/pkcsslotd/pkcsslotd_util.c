@@ -105,6 +105,8 @@ void PopulateSlotInfo(Slot_Info_t_64 *slot_info, unsigned int *processed)
                    sizeof(sinfo[id].pk_slot.firmwareVersion));
 
             slot_info[id].version = sinfo[id].version;
+            slot_info[id].objcache = sinfo[id].objcache;
+            slot_info[id].logincache = sinfo[id].logincache;
 
             memcpy(slot_info[id].usergroup, sinfo[id].usergroup,
                    strlen(sinfo[id].usergroup));
@@ -30,6 +30,8 @@
 #define MD5_HASH_SIZE 16
 
 #define DEF_MANUFID "IBM"
+#define MAX_OBJ_CACHE_SIZE 1024 /* MB */
+#define MAX_LOGIN_CACHE_TIME 86400 /* seconds */
 
 #if defined(_AIX)
     #define DEF_SLOTDESC    "AIX"
@@ -808,6 +810,30 @@ static int config_parse_slot(const char *config_file,
             continue;
         }
 
+        if (strcmp(c->key, "objcache") == 0 &&
+            confignode_hastype(c, CT_INTVAL)) {
+            if (confignode_to_intval(c)->value > MAX_OBJ_CACHE_SIZE) {
+                ErrLog("Error parsing config file '%s': objcache must not be "
+                       "larger than %d at line %d\n", config_file,
+                       MAX_OBJ_CACHE_SIZE, c->line);
+                return 1;
+            }
+            sinfo[slot_no].objcache = confignode_to_intval(c)->value;
+            continue;
+        }
+
+        if (strcmp(c->key, "logincache") == 0 &&
+            confignode_hastype(c, CT_INTVAL)) {
+            if (confignode_to_intval(c)->value > MAX_LOGIN_CACHE_TIME) {
+                ErrLog("Error parsing config file '%s': logincache must not "
+                       "be larger than %d at line %d\n", config_file,
+                       MAX_LOGIN_CACHE_TIME, c->line);
+                return 1;
+            }
+            sinfo[slot_no].logincache = confignode_to_intval(c)->value;
+            continue;
+        }
+
         ErrLog("Error parsing config file '%s': unexpected token '%s' "
                "at line %d: \n", config_file, c->key, c->line);
         return 1;
@@ -1211,7 +1237,13 @@ int main(int argc, char *argv[], char *envp[])
 
     while (1) {
 #if !(THREADED) && !(NOGARBAGE)
-        CheckForGarbage(shmp);
+        /*
+         * Exited processes are normally cleaned up right away when their
+         * pidfd signals the exit. Only scan the whole process table if that
+         * is not available for all processes.
+         */
+        if (GCPeriodicScanRequired())
+            CheckForGarbage(shmp);
 #endif
         socket_connection_handler(10);
     }
@@ -29,6 +29,8 @@
 #else
     #include <sys/select.h>
     #include <sys/epoll.h>
+    #include <sys/syscall.h>
+    #include <poll.h>
 #endif
 
 #if defined(__GNUC__) && __GNUC__ >= 7 || defined(__clang__) && __clang_major__ >= 12
@@ -62,6 +64,10 @@
 #define UDEV_PROPERTY_ONLINE        "ONLINE"
 #endif
 
+#if !defined(_AIX) && !defined(NOGARBAGE) && defined(SYS_pidfd_open)
+#define PROC_EXIT_TRACKING
+#endif
+
 #if defined(_AIX)
     #define EPOLLHUP POLLHUP
     #define EPOLLERR POLLERR
@@ -138,6 +144,19 @@ struct admin_conn_info {
     struct event_info *event;
 };
 
+#ifdef PROC_EXIT_TRACKING
+/*
+ * Watches for the exit of a process that connected to the daemon. The pidfd
+ * becomes readable when the process exits, independent of whether the process
+ * still has its socket connection open or not.
+ */
+struct proc_watch {
+    pid_t pid;
+    int pidfd;
+    struct epoll_info ep_info;
+};
+#endif
+
 #ifdef WITH_LIBUDEV
 struct udev_mon {
     struct udev *udev;
@@ -165,6 +184,9 @@ static struct listener_info proc_listener = { .socket = -1 };
 static DL_NODE *proc_connections = NULL;
 static struct listener_info admin_listener = { .socket = -1 };
 static DL_NODE *admin_connections = NULL;
+#ifdef PROC_EXIT_TRACKING
+static DL_NODE *proc_watches = NULL;
+#endif
 #ifdef WITH_LIBUDEV
 static struct udev_mon udev_mon = { .socket = -1 };
 #endif
@@ -231,6 +253,10 @@ static inline void admin_get(struct admin_conn_info *conn);
 static inline void admin_put(struct admin_conn_info *conn);
 static void admin_hangup(void *client);
 static void admin_free(void *client);
+#ifdef PROC_EXIT_TRACKING
+static void proc_watch_term(struct proc_watch *watch);
+static int proc_watch_notify(int events, void *private);
+#endif
 #ifdef WITH_LIBUDEV
 static void udev_mon_term(struct udev_mon *udev_mon);
 static int udev_mon_notify(int events, void *private);
@@ -692,6 +718,117 @@ static void event_delivered(struct event_info *event)
     }
 }
 
+#ifdef PROC_EXIT_TRACKING
+static int proc_watch_add(pid_t pid)
+{
+    struct proc_watch *watch;
+    struct epoll_event evt;
+    struct pollfd pfd;
+    DL_NODE *node, *list;
+    int rc, err;
+
+    node = dlist_get_first(proc_watches);
+    while (node != NULL) {
+        watch = node->data;
+        node = dlist_next(node);
+
+        if (watch->pid != pid)
+            continue;
+
+        /*
+         * The process is already watched, unless the watched process has
+         * exited and the pid got reused, before the exit was handled.
+         */
+        pfd.fd = watch->pidfd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 0) == 0)
+            return 0;
+
+        proc_watch_notify(EPOLLIN, watch);
+    }
+
+    watch = calloc(1, sizeof(struct proc_watch));
+    if (watch == NULL) {
+        ErrLog("%s: Failed to to allocate memory for the process watch",
+               __func__);
+        return -ENOMEM;
+    }
+
+    watch->pid = pid;
+    watch->pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (watch->pidfd < 0) {
+        err = errno;
+        InfoLog("%s: pidfd_open for process %d failed, errno %d (%s).",
+                __func__, pid, err, strerror(err));
+        free(watch);
+        return -err;
+    }
+
+    epoll_info_init(&watch->ep_info, proc_watch_notify, NULL, watch);
+
+    evt.events = EPOLLIN;
+    evt.data.ptr = &watch->ep_info;
+    rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watch->pidfd, &evt);
+    if (rc != 0) {
+        err = errno;
+        InfoLog("%s: Failed to add pidfd %d to epoll, errno %d (%s).",
+                __func__, watch->pidfd, err, strerror(err));
+        close(watch->pidfd);
+        free(watch);
+        return -err;
+    }
+
+    list = dlist_add_as_first(proc_watches, watch);
+    if (list == NULL) {
+        proc_watch_term(watch);
+        return -ENOMEM;
+    }
+    proc_watches = list;
+
+    DbgLog(DL3, "%s: watching process %d via pidfd %d", __func__, pid,
+           watch->pidfd);
+
+    return 0;
+}
+
+static void proc_watch_term(struct proc_watch *watch)
+{
+    DL_NODE *node;
+
+    node = dlist_find(proc_watches, watch);
+    if (node != NULL)
+        proc_watches = dlist_remove_node(proc_watches, node);
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, watch->pidfd, NULL);
+    close(watch->pidfd);
+    watch->pidfd = -1;
+
+    /* The epoll_info may still be referenced by socket_connection_handler */
+    watch->ep_info.free = free;
+    epoll_info_put(&watch->ep_info);
+}
+
+static int proc_watch_notify(int events, void *private)
+{
+    struct proc_watch *watch = private;
+
+    DbgLog(DL3, "%s: Epoll event on pidfd %d of process %d: events: 0x%x",
+           __func__, watch->pidfd, watch->pid, events);
+
+    if (watch->pidfd < 0)
+        return 0;
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        /* The process has exited, release its process table entries */
+        CheckForGarbageProcess(shmp, watch->pid);
+        proc_watch_term(watch);
+    }
+
+    return 0;
+}
+#endif
+
 static int proc_new_conn(int socket, struct listener_info *listener)
 {
     struct proc_conn_info *conn;
@@ -749,6 +886,14 @@ static int proc_new_conn(int socket, struct listener_info *listener)
     conn->client_cred.real_uid = ucred.uid;
     conn->client_cred.real_gid = ucred.gid;
 #endif
+
+#ifdef PROC_EXIT_TRACKING
+    if (proc_watch_add(ucred.pid) != 0)
+        GCUntrackedProcess();
+#elif !defined(NOGARBAGE)
+    GCUntrackedProcess();
+#endif
+
     /* Add currently pending events to this connection */
     node = dlist_get_first(pending_events);
     while (node != NULL) {
@@ -1930,6 +2075,11 @@ int term_socket_server(void)
     listener_term(&proc_listener);
     listener_term(&admin_listener);
 
+#ifdef PROC_EXIT_TRACKING
+    while ((node = dlist_get_first(proc_watches)) != NULL)
+        proc_watch_term(node->data);
+#endif
+
     node = dlist_get_first(proc_connections);
     while (node != NULL) {
         next = dlist_next(node);
@@ -46,7 +46,7 @@
 static void usage(char *progname)
 {
     printf("Usage: %s [OPTIONS]\n\n", progname);
-    printf("Display mechanism usage statistics for openCryptoki.\n\n");
+    printf("Display mechanism and device usage statistics for openCryptoki.\n\n");
     printf("OPTIONS:\n");
     printf(" -U, --user USERID  show the statistics from one user. (root user only)\n");
     printf(" -S, --summary      show the accumulated statistics from all users. (root user only)\n");
@@ -122,7 +122,7 @@ static int open_shm(uid_t user_id, const char *user_name,
         return 1;
     }
 
-    *shm_size = num_slots * STAT_SLOT_SIZE;
+    *shm_size = num_slots * (STAT_SLOT_SIZE + STAT_DEV_SIZE);
 
     if ((CK_ULONG)stat_buf.st_size != *shm_size) {
         warnx("Failed to open statistics for user '%s': SHM '%s' has wrong size",
@@ -196,8 +196,10 @@ static int for_all_users(user_f user_cb, void *cb_private)
 #endif
 }
 
+/* dev_data is NULL if no device counters are available */
 typedef int (*slot_f)(CK_SLOT_ID slot_id, CK_BYTE *slot_data,
-                      CK_ULONG slot_size, void *private);
+                      CK_ULONG slot_size, struct stat_device *dev_data,
+                      void *private);
 
 static int for_all_slots(slot_f slot_cb, void *cb_private,
                          CK_BYTE *shm_data, CK_ULONG shm_size,
@@ -205,8 +207,9 @@ static int for_all_slots(slot_f slot_cb, void *cb_private,
                          bool slot_id_specified, CK_SLOT_ID slot_id)
 {
     int rc = 0;
-    CK_ULONG i;
+    CK_ULONG i, dev_ofs;
     bool slot_found = false;
+    struct stat_device *dev_data;
 
     for (i = 0; i < num_slots; i++) {
         if (slot_id_specified && slots[i] != slot_id)
@@ -217,8 +220,14 @@ static int for_all_slots(slot_f slot_cb, void *cb_private,
         if ((i * STAT_SLOT_SIZE) + STAT_SLOT_SIZE > shm_size)
             break;
 
+        dev_ofs = num_slots * STAT_SLOT_SIZE + i * STAT_DEV_SIZE;
+        if (dev_ofs + STAT_DEV_SIZE <= shm_size)
+            dev_data = (struct stat_device *)&shm_data[dev_ofs];
+        else
+            dev_data = NULL;
+
         rc = slot_cb(slots[i], &shm_data[i * STAT_SLOT_SIZE],  STAT_SLOT_SIZE,
-                     cb_private);
+                     dev_data, cb_private);
         if (rc != 0)
             break;
     }
@@ -301,13 +310,25 @@ static int delete_all_cb(int user_id, const char *user_name, void *private)
 }
 
 static int reset_slot_cb(CK_SLOT_ID slot_id, CK_BYTE *slot_data,
-                         CK_ULONG slot_size, void *private)
+                         CK_ULONG slot_size, struct stat_device *dev_data,
+                         void *private)
 {
+    int i;
+
     UNUSED(slot_id);
     UNUSED(private);
 
     memset(slot_data, 0, slot_size);
 
+    /* Keep the device ids, running processes still use their blocks */
+    for (i = 0; dev_data != NULL && i < STAT_MAX_DEVICES; i++) {
+        dev_data[i].requests = 0;
+        dev_data[i].errors = 0;
+        dev_data[i].timeouts = 0;
+        dev_data[i].ejections = 0;
+        dev_data[i].usec = 0;
+    }
+
     return 0;
 }
 
@@ -503,8 +524,72 @@ static void print_footer(void)
 }
 
 
+static void print_device_id(counter_t id)
+{
+    if (STAT_DEVICE_ADAPTER(id) == STAT_DEVICE_ANY)
+        printf("any.");
+    else
+        printf("%02lX.", STAT_DEVICE_ADAPTER(id));
+    if (STAT_DEVICE_DOMAIN(id) == STAT_DEVICE_ANY)
+        printf("any    ");
+    else
+        printf("%04lX   ", STAT_DEVICE_DOMAIN(id));
+}
+
+static void display_devices(struct stat_device *dev_data, bool json)
+{
+    bool first = true;
+    int i;
+
+    if (json)
+        printf(",\n\t\t\t\t\t\"devices\": [");
+
+    for (i = 0; dev_data != NULL && i < STAT_MAX_DEVICES; i++) {
+        if (dev_data[i].id == 0)
+            continue;
+
+        if (json) {
+            printf("%s\n\t\t\t\t\t\t{\n", first ? "" : ",");
+            if (STAT_DEVICE_ADAPTER(dev_data[i].id) != STAT_DEVICE_ANY)
+                printf("\t\t\t\t\t\t\t\"adapter\": %lu,\n",
+                       STAT_DEVICE_ADAPTER(dev_data[i].id));
+            if (STAT_DEVICE_DOMAIN(dev_data[i].id) != STAT_DEVICE_ANY)
+                printf("\t\t\t\t\t\t\t\"domain\": %lu,\n",
+                       STAT_DEVICE_DOMAIN(dev_data[i].id));
+            printf("\t\t\t\t\t\t\t\"requests\": %lu,\n",
+                   dev_data[i].requests);
+            printf("\t\t\t\t\t\t\t\"errors\": %lu,\n", dev_data[i].errors);
+            printf("\t\t\t\t\t\t\t\"timeouts\": %lu,\n",
+                   dev_data[i].timeouts);
+            printf("\t\t\t\t\t\t\t\"ejections\": %lu,\n",
+                   dev_data[i].ejections);
+            printf("\t\t\t\t\t\t\t\"usec\": %lu\n", dev_data[i].usec);
+            printf("\t\t\t\t\t\t}");
+        } else {
+            if (first) {
+                printf("device     | requests        errors          "
+                       "timeouts        ejections       avg usec\n");
+                printf("-----------+--------------------------------"
+                       "----------------------------------------------\n");
+            }
+            print_device_id(dev_data[i].id);
+            printf(" | %15lu %15lu %15lu %15lu %15lu\n", dev_data[i].requests,
+                   dev_data[i].errors, dev_data[i].timeouts,
+                   dev_data[i].ejections, dev_data[i].requests != 0 ?
+                            dev_data[i].usec / dev_data[i].requests : 0);
+        }
+        first = false;
+    }
+
+    if (json)
+        printf("\n\t\t\t\t\t]");
+    else if (!first)
+        printf("\n");
+}
+
 static int display_slot_stats(CK_FUNCTION_LIST *func_list, CK_SLOT_ID slot,
                               CK_BYTE *slot_data, CK_ULONG slot_size,
+                              struct stat_device *dev_data,
                               bool all_mechs, bool json, bool *first)
 {
     char label[33], model[33];
@@ -552,10 +637,14 @@ static int display_slot_stats(CK_FUNCTION_LIST *func_list, CK_SLOT_ID slot,
         return rc;
     }
 
-    if (json)
-        printf("\n\t\t\t\t\t]\n\t\t\t\t}");
-    else
+    if (json) {
+        printf("\n\t\t\t\t\t]");
+        display_devices(dev_data, json);
+        printf("\n\t\t\t\t}");
+    } else {
         print_footer();
+        display_devices(dev_data, json);
+    }
 
     *first = false;
 
@@ -563,12 +652,14 @@ static int display_slot_stats(CK_FUNCTION_LIST *func_list, CK_SLOT_ID slot,
 }
 
 static int display_slot_cb(CK_SLOT_ID slot_id, CK_BYTE *slot_data,
-                           CK_ULONG slot_size, void *private)
+                           CK_ULONG slot_size, struct stat_device *dev_data,
+                           void *private)
 {
     struct display_data *dd = private;
 
     return display_slot_stats(dd->func_list, slot_id, slot_data, slot_size,
-                              dd->all_mechs, dd->json, &dd->first_slot);
+                              dev_data, dd->all_mechs, dd->json,
+                              &dd->first_slot);
 }
 
 static int display_stats(int user_id, const char *user_name,
@@ -645,11 +736,14 @@ static int summary_mech_cb(CK_MECHANISM_TYPE mech, const char *mech_name,
 }
 
 static int summary_slot_cb(CK_SLOT_ID slot_id, CK_BYTE *slot_data,
-                           CK_ULONG slot_size, void *private)
+                           CK_ULONG slot_size, struct stat_device *dev_data,
+                           void *private)
 {
     int rc;
     struct summary_data *sd = private;
 
+    UNUSED(dev_data);
+
     sd->slot_id = slot_id;
 
     rc = for_each_mech(summary_mech_cb, sd, slot_data, slot_size, true);